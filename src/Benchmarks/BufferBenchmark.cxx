@@ -0,0 +1,240 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file BufferBenchmark.cxx
+  \brief Benchmarks of adding video frames and poses to buffers and looking up buffer items by time
+*/
+
+// Local includes
+#include "PlusBenchmarkCommon.h"
+#include "PlusConfigure.h"
+#include "vtkPlusBuffer.h"
+#include "vtkPlusTrackerBuffer.h"
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+
+// Google Benchmark includes
+#include <benchmark/benchmark.h>
+
+// STL includes
+#include <array>
+#include <string>
+#include <vector>
+
+namespace
+{
+  const int BUFFER_SIZE = 150;
+  const int NUMBER_OF_QUERY_TIMESTAMPS = 1024;
+
+  //----------------------------------------------------------------------------
+  PlusStatus SetUpVideoBuffer(vtkPlusBuffer* buffer, unsigned int width, unsigned int height)
+  {
+    if (buffer->SetBufferSize(BUFFER_SIZE) != PLUS_SUCCESS
+        || buffer->SetImageOrientation(US_IMG_ORIENT_MF) != PLUS_SUCCESS
+        || buffer->SetImageType(US_IMG_BRIGHTNESS) != PLUS_SUCCESS
+        || buffer->SetPixelType(VTK_UNSIGNED_CHAR) != PLUS_SUCCESS
+        || buffer->SetNumberOfScalarComponents(1) != PLUS_SUCCESS
+        || buffer->SetFrameSize(width, height, 1) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus AddVideoItem(vtkPlusBuffer* buffer, std::vector<unsigned char>& frame, const FrameSizeType& frameSize, long frameNumber)
+  {
+    static const std::array<int, 3> noClip = {igsioCommon::NO_CLIP, igsioCommon::NO_CLIP, igsioCommon::NO_CLIP};
+    double timestamp = PlusBenchmark::START_TIMESTAMP + frameNumber * PlusBenchmark::FRAME_PERIOD_SEC;
+    return buffer->AddItem(&frame[0], US_IMG_ORIENT_MF, frameSize, VTK_UNSIGNED_CHAR, 1, US_IMG_BRIGHTNESS, 0, frameNumber,
+                           noClip, noClip, timestamp, timestamp);
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus AddPoseItem(vtkPlusBuffer* buffer, vtkMatrix4x4* matrix, long frameNumber)
+  {
+    double timestamp = PlusBenchmark::START_TIMESTAMP + frameNumber * PlusBenchmark::FRAME_PERIOD_SEC;
+    // Moving pose, so that interpolation has to blend different transforms
+    matrix->SetElement(0, 3, frameNumber % 100);
+    matrix->SetElement(1, 3, 0.5 * (frameNumber % 60));
+    return buffer->AddTimeStampedItem(matrix, TOOL_OK, frameNumber, timestamp, timestamp);
+  }
+
+  //----------------------------------------------------------------------------
+  std::vector<double> GetQueryTimestamps(vtkPlusBuffer* buffer)
+  {
+    double oldestTimestamp(0);
+    double latestTimestamp(0);
+    buffer->GetOldestTimeStamp(oldestTimestamp);
+    buffer->GetLatestTimeStamp(latestTimestamp);
+    return PlusBenchmark::GetQueryTimestamps(oldestTimestamp, latestTimestamp, NUMBER_OF_QUERY_TIMESTAMPS);
+  }
+
+  //----------------------------------------------------------------------------
+  std::string GetInterpolationName(int interpolation)
+  {
+    switch (interpolation)
+    {
+      case vtkPlusBuffer::EXACT_TIME:
+        return "EXACT_TIME";
+      case vtkPlusBuffer::INTERPOLATED:
+        return "INTERPOLATED";
+      case vtkPlusBuffer::CLOSEST_TIME:
+        return "CLOSEST_TIME";
+      default:
+        return "UNKNOWN";
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+// Arguments: frame width, frame height
+static void BM_BufferAddVideoItem(benchmark::State& state)
+{
+  FrameSizeType frameSize = {static_cast<unsigned int>(state.range(0)), static_cast<unsigned int>(state.range(1)), 1};
+  vtkSmartPointer<vtkPlusBuffer> buffer = vtkSmartPointer<vtkPlusBuffer>::New();
+  if (SetUpVideoBuffer(buffer, frameSize[0], frameSize[1]) != PLUS_SUCCESS)
+  {
+    state.SkipWithError("Failed to set up video buffer");
+    return;
+  }
+  std::vector<unsigned char> frame(frameSize[0] * frameSize[1], 128);
+
+  long frameNumber = 0;
+  for (auto _ : state)
+  {
+    if (AddVideoItem(buffer, frame, frameSize, frameNumber++) != PLUS_SUCCESS)
+    {
+      state.SkipWithError("Failed to add video item");
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(frame.size()));
+}
+BENCHMARK(BM_BufferAddVideoItem)->Args({640, 480})->Args({1024, 1024});
+
+//----------------------------------------------------------------------------
+template <class BufferType>
+static void BM_BufferAddPoseItem(benchmark::State& state)
+{
+  vtkSmartPointer<BufferType> buffer = vtkSmartPointer<BufferType>::New();
+  buffer->SetBufferSize(BUFFER_SIZE);
+  vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+
+  long frameNumber = 0;
+  for (auto _ : state)
+  {
+    if (AddPoseItem(buffer, matrix, frameNumber++) != PLUS_SUCCESS)
+    {
+      state.SkipWithError("Failed to add pose item");
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_BufferAddPoseItem, vtkPlusBuffer);
+BENCHMARK_TEMPLATE(BM_BufferAddPoseItem, vtkPlusTrackerBuffer);
+
+//----------------------------------------------------------------------------
+// Arguments: lock-free timestamp queries enabled (0/1)
+template <class BufferType>
+static void BM_BufferGetItemUidFromTime(benchmark::State& state)
+{
+  vtkSmartPointer<BufferType> buffer = vtkSmartPointer<BufferType>::New();
+  buffer->SetBufferSize(BUFFER_SIZE);
+  buffer->SetLockFreeTimestampQueries(state.range(0) != 0);
+  vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  for (long frameNumber = 0; frameNumber < BUFFER_SIZE; ++frameNumber)
+  {
+    AddPoseItem(buffer, matrix, frameNumber);
+  }
+  std::vector<double> queryTimestamps = GetQueryTimestamps(buffer);
+
+  unsigned int queryIndex = 0;
+  for (auto _ : state)
+  {
+    BufferItemUidType uid = 0;
+    if (buffer->GetItemUidFromTime(queryTimestamps[queryIndex++ % NUMBER_OF_QUERY_TIMESTAMPS], uid) != ITEM_OK)
+    {
+      state.SkipWithError("Failed to get item UID from time");
+      break;
+    }
+    benchmark::DoNotOptimize(uid);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_BufferGetItemUidFromTime, vtkPlusBuffer)->Arg(0)->Arg(1);
+BENCHMARK_TEMPLATE(BM_BufferGetItemUidFromTime, vtkPlusTrackerBuffer)->Arg(0)->Arg(1);
+
+//----------------------------------------------------------------------------
+// Arguments: interpolation type (vtkPlusBuffer::DataItemTemporalInterpolationType)
+template <class BufferType>
+static void BM_BufferGetPoseItemFromTime(benchmark::State& state)
+{
+  vtkPlusBuffer::DataItemTemporalInterpolationType interpolation = static_cast<vtkPlusBuffer::DataItemTemporalInterpolationType>(state.range(0));
+  state.SetLabel(GetInterpolationName(interpolation));
+
+  vtkSmartPointer<BufferType> buffer = vtkSmartPointer<BufferType>::New();
+  buffer->SetBufferSize(BUFFER_SIZE);
+  vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  for (long frameNumber = 0; frameNumber < BUFFER_SIZE; ++frameNumber)
+  {
+    AddPoseItem(buffer, matrix, frameNumber);
+  }
+  std::vector<double> queryTimestamps = GetQueryTimestamps(buffer);
+
+  StreamBufferItem bufferItem;
+  unsigned int queryIndex = 0;
+  for (auto _ : state)
+  {
+    if (buffer->GetStreamBufferItemFromTime(queryTimestamps[queryIndex++ % NUMBER_OF_QUERY_TIMESTAMPS], &bufferItem, interpolation) != ITEM_OK)
+    {
+      state.SkipWithError("Failed to get pose item from time");
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_BufferGetPoseItemFromTime, vtkPlusBuffer)->Arg(vtkPlusBuffer::INTERPOLATED)->Arg(vtkPlusBuffer::CLOSEST_TIME);
+BENCHMARK_TEMPLATE(BM_BufferGetPoseItemFromTime, vtkPlusTrackerBuffer)->Arg(vtkPlusBuffer::INTERPOLATED)->Arg(vtkPlusBuffer::CLOSEST_TIME);
+
+//----------------------------------------------------------------------------
+// Arguments: frame width, frame height
+static void BM_BufferGetVideoItemFromTime(benchmark::State& state)
+{
+  FrameSizeType frameSize = {static_cast<unsigned int>(state.range(0)), static_cast<unsigned int>(state.range(1)), 1};
+  vtkSmartPointer<vtkPlusBuffer> buffer = vtkSmartPointer<vtkPlusBuffer>::New();
+  if (SetUpVideoBuffer(buffer, frameSize[0], frameSize[1]) != PLUS_SUCCESS)
+  {
+    state.SkipWithError("Failed to set up video buffer");
+    return;
+  }
+  std::vector<unsigned char> frame(frameSize[0] * frameSize[1], 128);
+  for (long frameNumber = 0; frameNumber < BUFFER_SIZE; ++frameNumber)
+  {
+    AddVideoItem(buffer, frame, frameSize, frameNumber);
+  }
+  std::vector<double> queryTimestamps = GetQueryTimestamps(buffer);
+
+  // Video frames cannot be interpolated, the closest frame is copied to the item
+  StreamBufferItem bufferItem;
+  unsigned int queryIndex = 0;
+  for (auto _ : state)
+  {
+    if (buffer->GetStreamBufferItemFromTime(queryTimestamps[queryIndex++ % NUMBER_OF_QUERY_TIMESTAMPS], &bufferItem, vtkPlusBuffer::CLOSEST_TIME) != ITEM_OK)
+    {
+      state.SkipWithError("Failed to get video item from time");
+      break;
+    }
+  }
+  state.SetLabel(GetInterpolationName(vtkPlusBuffer::CLOSEST_TIME));
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(frame.size()));
+}
+BENCHMARK(BM_BufferGetVideoItemFromTime)->Args({640, 480})->Args({1024, 1024});
@@ -0,0 +1,158 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file ChannelBenchmark.cxx
+  \brief Benchmarks of assembling tracked frames from the video and tool buffers of a channel
+*/
+
+// Local includes
+#include "PlusBenchmarkCommon.h"
+#include "PlusConfigure.h"
+#include "vtkPlusChannel.h"
+#include "vtkPlusDataSource.h"
+
+// IGSIO includes
+#include <igsioTrackedFrame.h>
+#include <vtkIGSIOTrackedFrameList.h>
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+
+// Google Benchmark includes
+#include <benchmark/benchmark.h>
+
+namespace
+{
+  const int BUFFER_SIZE = 150;
+  const int NUMBER_OF_QUERY_TIMESTAMPS = 1024;
+  const unsigned int FRAME_WIDTH = 640;
+  const unsigned int FRAME_HEIGHT = 480;
+  const char* TOOL_IDS[] = { "ProbeToTracker", "StylusToTracker", "ReferenceToTracker", "NeedleToTracker" };
+  const int MAX_NUMBER_OF_TOOLS = sizeof(TOOL_IDS) / sizeof(TOOL_IDS[0]);
+
+  /*! Channel with a video source and tools, all of their buffers are filled with items acquired at the same time */
+  struct ChannelFixture
+  {
+    vtkSmartPointer<vtkPlusChannel> Channel;
+    std::vector<vtkSmartPointer<vtkPlusDataSource> > Sources;
+    double OldestTimestamp;
+    double LatestTimestamp;
+
+    PlusStatus SetUp(bool hasVideo, int numberOfTools)
+    {
+      this->Channel = vtkSmartPointer<vtkPlusChannel>::New();
+      this->Channel->SetChannelId("BenchmarkChannel");
+      this->OldestTimestamp = PlusBenchmark::START_TIMESTAMP;
+      this->LatestTimestamp = PlusBenchmark::START_TIMESTAMP + (BUFFER_SIZE - 1) * PlusBenchmark::FRAME_PERIOD_SEC;
+
+      FrameSizeType frameSize = {FRAME_WIDTH, FRAME_HEIGHT, 1};
+      std::vector<unsigned char> frame(FRAME_WIDTH * FRAME_HEIGHT, 128);
+      if (hasVideo)
+      {
+        vtkSmartPointer<vtkPlusDataSource> videoSource = vtkSmartPointer<vtkPlusDataSource>::New();
+        videoSource->SetId("Video");
+        videoSource->SetType(DATA_SOURCE_TYPE_VIDEO);
+        videoSource->SetBufferSize(BUFFER_SIZE);
+        videoSource->SetInputImageOrientation(US_IMG_ORIENT_MF);
+        videoSource->SetOutputImageOrientation(US_IMG_ORIENT_MF);
+        videoSource->SetImageType(US_IMG_BRIGHTNESS);
+        videoSource->SetPixelType(VTK_UNSIGNED_CHAR);
+        videoSource->SetNumberOfScalarComponents(1);
+        videoSource->SetInputFrameSize(frameSize);
+        for (long frameNumber = 0; frameNumber < BUFFER_SIZE; ++frameNumber)
+        {
+          double timestamp = PlusBenchmark::START_TIMESTAMP + frameNumber * PlusBenchmark::FRAME_PERIOD_SEC;
+          if (videoSource->AddItem(&frame[0], US_IMG_ORIENT_MF, frameSize, VTK_UNSIGNED_CHAR, 1, US_IMG_BRIGHTNESS, 0, frameNumber, timestamp, timestamp) != PLUS_SUCCESS)
+          {
+            return PLUS_FAIL;
+          }
+        }
+        this->Channel->SetVideoSource(videoSource);
+        this->Sources.push_back(videoSource);
+      }
+
+      vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+      for (int toolIndex = 0; toolIndex < numberOfTools && toolIndex < MAX_NUMBER_OF_TOOLS; ++toolIndex)
+      {
+        vtkSmartPointer<vtkPlusDataSource> tool = vtkSmartPointer<vtkPlusDataSource>::New();
+        tool->SetId(TOOL_IDS[toolIndex]);
+        tool->SetType(DATA_SOURCE_TYPE_TOOL);
+        tool->SetBufferSize(BUFFER_SIZE);
+        for (long frameNumber = 0; frameNumber < BUFFER_SIZE; ++frameNumber)
+        {
+          double timestamp = PlusBenchmark::START_TIMESTAMP + frameNumber * PlusBenchmark::FRAME_PERIOD_SEC;
+          matrix->SetElement(0, 3, frameNumber % 100);
+          matrix->SetElement(2, 3, toolIndex);
+          if (tool->AddTimeStampedItem(matrix, TOOL_OK, frameNumber, timestamp, timestamp) != PLUS_SUCCESS)
+          {
+            return PLUS_FAIL;
+          }
+        }
+        if (this->Channel->AddTool(tool) != PLUS_SUCCESS)
+        {
+          return PLUS_FAIL;
+        }
+        this->Sources.push_back(tool);
+      }
+      return PLUS_SUCCESS;
+    }
+  };
+}
+
+//----------------------------------------------------------------------------
+// Arguments: video source enabled (0/1), number of tools
+static void BM_ChannelGetTrackedFrame(benchmark::State& state)
+{
+  ChannelFixture fixture;
+  if (fixture.SetUp(state.range(0) != 0, static_cast<int>(state.range(1))) != PLUS_SUCCESS)
+  {
+    state.SkipWithError("Failed to set up channel");
+    return;
+  }
+  std::vector<double> queryTimestamps = PlusBenchmark::GetQueryTimestamps(fixture.OldestTimestamp, fixture.LatestTimestamp, NUMBER_OF_QUERY_TIMESTAMPS);
+
+  igsioTrackedFrame trackedFrame;
+  unsigned int queryIndex = 0;
+  for (auto _ : state)
+  {
+    if (fixture.Channel->GetTrackedFrame(queryTimestamps[queryIndex++ % NUMBER_OF_QUERY_TIMESTAMPS], trackedFrame) != PLUS_SUCCESS)
+    {
+      state.SkipWithError("Failed to get tracked frame");
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ChannelGetTrackedFrame)->Args({1, 0})->Args({0, 1})->Args({1, 1})->Args({1, MAX_NUMBER_OF_TOOLS});
+
+//----------------------------------------------------------------------------
+// Arguments: video source enabled (0/1), number of tools, maximum number of frames in the list
+static void BM_ChannelGetTrackedFrameList(benchmark::State& state)
+{
+  ChannelFixture fixture;
+  if (fixture.SetUp(state.range(0) != 0, static_cast<int>(state.range(1))) != PLUS_SUCCESS)
+  {
+    state.SkipWithError("Failed to set up channel");
+    return;
+  }
+  int maxNumberOfFrames = static_cast<int>(state.range(2));
+
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> trackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  for (auto _ : state)
+  {
+    // Request all frames acquired since the oldest one, the most recent ones are returned
+    double timestampOfLastFrameAlreadyGot = fixture.OldestTimestamp;
+    trackedFrameList->Clear();
+    if (fixture.Channel->GetTrackedFrameList(timestampOfLastFrameAlreadyGot, trackedFrameList, maxNumberOfFrames) != PLUS_SUCCESS)
+    {
+      state.SkipWithError("Failed to get tracked frame list");
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * maxNumberOfFrames);
+}
+BENCHMARK(BM_ChannelGetTrackedFrameList)->Args({1, MAX_NUMBER_OF_TOOLS, 10})->Args({0, MAX_NUMBER_OF_TOOLS, 10});
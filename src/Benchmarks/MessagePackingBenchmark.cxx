@@ -0,0 +1,127 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file MessagePackingBenchmark.cxx
+  \brief Benchmarks of packing OpenIGTLink messages from a tracked frame, for each message type
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusIgtlClientInfo.h"
+#include "vtkPlusIgtlMessageFactory.h"
+
+// IGSIO includes
+#include <igsioTrackedFrame.h>
+#include <vtkIGSIOTransformRepository.h>
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+
+// Google Benchmark includes
+#include <benchmark/benchmark.h>
+
+namespace
+{
+  const unsigned int FRAME_WIDTH = 640;
+  const unsigned int FRAME_HEIGHT = 480;
+  const char* TOOL_IDS[] = { "ProbeToTracker", "StylusToTracker", "ReferenceToTracker" };
+  const int NUMBER_OF_TOOLS = sizeof(TOOL_IDS) / sizeof(TOOL_IDS[0]);
+  const char* STRING_FIELD_NAME = "ProbeDepth";
+
+  //----------------------------------------------------------------------------
+  PlusStatus SetUpTrackedFrame(igsioTrackedFrame& trackedFrame)
+  {
+    FrameSizeType frameSize = {FRAME_WIDTH, FRAME_HEIGHT, 1};
+    if (trackedFrame.GetImageData()->AllocateFrame(frameSize, VTK_UNSIGNED_CHAR, 1) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    trackedFrame.GetImageData()->SetImageOrientation(US_IMG_ORIENT_MF);
+    trackedFrame.GetImageData()->SetImageType(US_IMG_BRIGHTNESS);
+    memset(trackedFrame.GetImageData()->GetScalarPointer(), 128, trackedFrame.GetImageData()->GetFrameSizeInBytes());
+    trackedFrame.SetTimestamp(100.0);
+
+    vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    for (int toolIndex = 0; toolIndex < NUMBER_OF_TOOLS; ++toolIndex)
+    {
+      matrix->SetElement(0, 3, 10.0 * toolIndex);
+      igsioTransformName toolToTracker(TOOL_IDS[toolIndex]);
+      trackedFrame.SetFrameTransform(toolToTracker, matrix);
+      trackedFrame.SetFrameTransformStatus(toolToTracker, TOOL_OK);
+    }
+    // Image is streamed with the ImageToTracker transform embedded, which is computed through the probe
+    igsioTransformName imageToProbe("Image", "Probe");
+    trackedFrame.SetFrameTransform(imageToProbe, matrix);
+    trackedFrame.SetFrameTransformStatus(imageToProbe, TOOL_OK);
+
+    trackedFrame.SetFrameField(STRING_FIELD_NAME, "40");
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  void SetUpClientInfo(PlusIgtlClientInfo& clientInfo, const std::string& messageType)
+  {
+    clientInfo.IgtlMessageTypes.push_back(messageType);
+    for (int toolIndex = 0; toolIndex < NUMBER_OF_TOOLS; ++toolIndex)
+    {
+      clientInfo.TransformNames.push_back(igsioTransformName(TOOL_IDS[toolIndex]));
+    }
+    PlusIgtlClientInfo::ImageStream imageStream;
+    imageStream.Name = "Image";
+    imageStream.EmbeddedTransformToFrame = "Tracker";
+    clientInfo.ImageStreams.push_back(imageStream);
+    clientInfo.StringNames.push_back(STRING_FIELD_NAME);
+    // Send TDATA with every frame
+    clientInfo.SetTDATARequested(true);
+    clientInfo.SetTDATAResolution(0);
+    clientInfo.SetLastTDATASentTimeStamp(0);
+  }
+}
+
+//----------------------------------------------------------------------------
+// Arguments: number of clients that receive the same tracked frame (messages are shared between them through the packed message cache)
+static void BM_PackMessages(benchmark::State& state, const std::string& messageType)
+{
+  igsioTrackedFrame trackedFrame;
+  if (SetUpTrackedFrame(trackedFrame) != PLUS_SUCCESS)
+  {
+    state.SkipWithError("Failed to set up tracked frame");
+    return;
+  }
+  PlusIgtlClientInfo clientInfo;
+  SetUpClientInfo(clientInfo, messageType);
+  int numberOfClients = static_cast<int>(state.range(0));
+
+  vtkSmartPointer<vtkPlusIgtlMessageFactory> messageFactory = vtkSmartPointer<vtkPlusIgtlMessageFactory>::New();
+  vtkSmartPointer<vtkIGSIOTransformRepository> transformRepository = vtkSmartPointer<vtkIGSIOTransformRepository>::New();
+  std::vector<igtl::MessageBase::Pointer> igtlMessages;
+  for (auto _ : state)
+  {
+    vtkPlusIgtlMessageFactory::PackedMessageCache messageCache;
+    for (int clientId = 0; clientId < numberOfClients; ++clientId)
+    {
+      if (messageFactory->PackMessages(clientId, clientInfo, igtlMessages, trackedFrame, false, transformRepository, numberOfClients > 1 ? &messageCache : NULL) != PLUS_SUCCESS)
+      {
+        state.SkipWithError("Failed to pack messages");
+        break;
+      }
+      if (igtlMessages.empty())
+      {
+        state.SkipWithError("No messages are packed");
+        break;
+      }
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * numberOfClients);
+}
+BENCHMARK_CAPTURE(BM_PackMessages, IMAGE, std::string("IMAGE"))->Arg(1)->Arg(4);
+BENCHMARK_CAPTURE(BM_PackMessages, TRANSFORM, std::string("TRANSFORM"))->Arg(1)->Arg(4);
+BENCHMARK_CAPTURE(BM_PackMessages, POSITION, std::string("POSITION"))->Arg(1)->Arg(4);
+BENCHMARK_CAPTURE(BM_PackMessages, TDATA, std::string("TDATA"))->Arg(1)->Arg(4);
+BENCHMARK_CAPTURE(BM_PackMessages, TRACKEDFRAME, std::string("TRACKEDFRAME"))->Arg(1)->Arg(4);
+BENCHMARK_CAPTURE(BM_PackMessages, USMESSAGE, std::string("USMESSAGE"))->Arg(1)->Arg(4);
+BENCHMARK_CAPTURE(BM_PackMessages, STRING, std::string("STRING"))->Arg(1)->Arg(4);
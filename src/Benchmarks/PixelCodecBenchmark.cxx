@@ -0,0 +1,100 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PixelCodecBenchmark.cxx
+  \brief Benchmarks of the pixel encoding conversions that video devices apply to each acquired frame
+*/
+
+// Local includes
+#include "PixelCodec.h"
+#include "PlusConfigure.h"
+
+// Google Benchmark includes
+#include <benchmark/benchmark.h>
+
+// STL includes
+#include <vector>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  int GetBytesPerPixel(PixelCodec::PixelEncoding encoding)
+  {
+    switch (encoding)
+    {
+      case PixelCodec::PixelEncoding_YUY2:
+        return 2;
+      case PixelCodec::PixelEncoding_RGB24:
+      case PixelCodec::PixelEncoding_BGR24:
+        return 3;
+      case PixelCodec::PixelEncoding_RGBA32:
+        return 4;
+      default:
+        return 0;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  std::vector<unsigned char> GetInputFrame(PixelCodec::PixelEncoding encoding, int width, int height)
+  {
+    // Non-uniform content, so that the conversion cannot be short-circuited
+    std::vector<unsigned char> frame(width * height * GetBytesPerPixel(encoding));
+    for (size_t i = 0; i < frame.size(); ++i)
+    {
+      frame[i] = static_cast<unsigned char>((i * 7) & 0xFF);
+    }
+    return frame;
+  }
+}
+
+//----------------------------------------------------------------------------
+// Arguments: frame width, frame height
+static void BM_PixelCodecConvertToGray(benchmark::State& state, PixelCodec::PixelEncoding encoding)
+{
+  int width = static_cast<int>(state.range(0));
+  int height = static_cast<int>(state.range(1));
+  std::vector<unsigned char> input = GetInputFrame(encoding, width, height);
+  std::vector<unsigned char> output(width * height);
+  for (auto _ : state)
+  {
+    if (PixelCodec::ConvertToGray(encoding, width, height, &input[0], &output[0]) != PLUS_SUCCESS)
+    {
+      state.SkipWithError("Conversion failed");
+      break;
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(input.size()));
+}
+BENCHMARK_CAPTURE(BM_PixelCodecConvertToGray, YUY2, PixelCodec::PixelEncoding_YUY2)->Args({640, 480})->Args({1920, 1080});
+BENCHMARK_CAPTURE(BM_PixelCodecConvertToGray, RGB24, PixelCodec::PixelEncoding_RGB24)->Args({640, 480})->Args({1920, 1080});
+BENCHMARK_CAPTURE(BM_PixelCodecConvertToGray, RGBA32, PixelCodec::PixelEncoding_RGBA32)->Args({640, 480})->Args({1920, 1080});
+
+//----------------------------------------------------------------------------
+// Arguments: frame width, frame height
+static void BM_PixelCodecConvertToBmp24(benchmark::State& state, PixelCodec::PixelEncoding encoding, PixelCodec::ComponentOrdering outputOrdering)
+{
+  int width = static_cast<int>(state.range(0));
+  int height = static_cast<int>(state.range(1));
+  std::vector<unsigned char> input = GetInputFrame(encoding, width, height);
+  std::vector<unsigned char> output(width * height * 3);
+  for (auto _ : state)
+  {
+    if (PixelCodec::ConvertToBmp24(outputOrdering, encoding, width, height, &input[0], &output[0]) != PLUS_SUCCESS)
+    {
+      state.SkipWithError("Conversion failed");
+      break;
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(input.size()));
+}
+BENCHMARK_CAPTURE(BM_PixelCodecConvertToBmp24, YUY2ToRGB, PixelCodec::PixelEncoding_YUY2, PixelCodec::ComponentOrder_RGB)->Args({640, 480})->Args({1920, 1080});
+BENCHMARK_CAPTURE(BM_PixelCodecConvertToBmp24, BGR24ToRGB, PixelCodec::PixelEncoding_BGR24, PixelCodec::ComponentOrder_RGB)->Args({640, 480})->Args({1920, 1080});
+BENCHMARK_CAPTURE(BM_PixelCodecConvertToBmp24, RGBA32ToRGB, PixelCodec::PixelEncoding_RGBA32, PixelCodec::ComponentOrder_RGBA)->Args({640, 480})->Args({1920, 1080});
@@ -0,0 +1,45 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusBenchmarkCommon_h
+#define __PlusBenchmarkCommon_h
+
+// STL includes
+#include <vector>
+
+/*!
+  \file PlusBenchmarkCommon.h
+  \brief Helper functions shared by the benchmarks
+*/
+namespace PlusBenchmark
+{
+  /*! Period of the generated video frames and poses (30 fps) */
+  const double FRAME_PERIOD_SEC = 1.0 / 30.0;
+
+  /*! Timestamp of the first generated item */
+  const double START_TIMESTAMP = 100.0;
+
+  /*!
+    Get timestamps spread pseudo-randomly between fromTimestamp and toTimestamp.
+    The sequence is deterministic, so that results of different runs are comparable.
+    Timestamps do not coincide with item timestamps, so that lookups exercise the search and interpolation.
+  */
+  inline std::vector<double> GetQueryTimestamps(double fromTimestamp, double toTimestamp, int numberOfTimestamps)
+  {
+    std::vector<double> timestamps(numberOfTimestamps);
+    unsigned int randomState = 12345;
+    for (int i = 0; i < numberOfTimestamps; ++i)
+    {
+      // Linear congruential generator, uniform in [0, 1)
+      randomState = randomState * 1103515245u + 12345u;
+      double fraction = static_cast<double>((randomState >> 8) & 0xFFFFFF) / static_cast<double>(0x1000000);
+      timestamps[i] = fromTimestamp + fraction * (toTimestamp - fromTimestamp);
+    }
+    return timestamps;
+  }
+}
+
+#endif
@@ -0,0 +1,35 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PlusBenchmarkMain.cxx
+  \brief Runs the microbenchmarks of performance-critical code paths
+
+  All Google Benchmark command-line options are supported. Use --benchmark_out=<file> --benchmark_out_format=json
+  to save the results in a machine-readable format, which can be compared between releases (e.g., by Google Benchmark's compare.py).
+  The RunBenchmarks build target runs all benchmarks this way.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+
+// Google Benchmark includes
+#include <benchmark/benchmark.h>
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  // Only errors are logged, so that logging does not distort the measurements
+  vtkPlusLogger::Instance()->SetLogLevel(vtkPlusLogger::LOG_LEVEL_ERROR);
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+  {
+    return EXIT_FAILURE;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,105 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file ScanConversionBenchmark.cxx
+  \brief Benchmarks of curvilinear scan conversion, with the scalar and with the vectorized (SSE4.1/AVX2) kernel
+
+  The filter runs in a single thread, so that the kernels are compared and not the thread scheduling.
+  On processors without SSE4.1 the vectorized benchmarks run the scalar kernel.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkPlusUsScanConvertCurvilinear.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkSmartPointer.h>
+#include <vtkXMLDataElement.h>
+
+// Google Benchmark includes
+#include <benchmark/benchmark.h>
+
+namespace
+{
+  const int NUMBER_OF_SAMPLES = 512;
+  const int NUMBER_OF_LINES = 128;
+
+  //----------------------------------------------------------------------------
+  vtkSmartPointer<vtkImageData> CreateEnvelope(int scalarType)
+  {
+    vtkSmartPointer<vtkImageData> envelope = vtkSmartPointer<vtkImageData>::New();
+    envelope->SetExtent(0, NUMBER_OF_SAMPLES - 1, 0, NUMBER_OF_LINES - 1, 0, 0);
+    envelope->AllocateScalars(scalarType, 1);
+    // Non-uniform content, the same in all runs
+    unsigned int seed = 12345;
+    int numberOfScalars = NUMBER_OF_SAMPLES * NUMBER_OF_LINES;
+    for (int i = 0; i < numberOfScalars; ++i)
+    {
+      seed = seed * 1103515245 + 12345;
+      int value = static_cast<int>((seed >> 16) & 0xFFFF);
+      if (scalarType == VTK_UNSIGNED_CHAR)
+      {
+        static_cast<unsigned char*>(envelope->GetScalarPointer())[i] = static_cast<unsigned char>(value & 0xFF);
+      }
+      else
+      {
+        static_cast<short*>(envelope->GetScalarPointer())[i] = static_cast<short>(value - 32768);
+      }
+    }
+    return envelope;
+  }
+}
+
+//----------------------------------------------------------------------------
+// Arguments: output image width, output image height
+static void BM_ScanConvertCurvilinear(benchmark::State& state, int scalarType, bool vectorizationEnabled)
+{
+  int width = static_cast<int>(state.range(0));
+  int height = static_cast<int>(state.range(1));
+
+  // Sector of a typical abdominal probe, the output spacing is chosen so that the sector fills the image
+  vtkSmartPointer<vtkXMLDataElement> scanConversionElement = vtkSmartPointer<vtkXMLDataElement>::New();
+  scanConversionElement->SetName("ScanConversion");
+  scanConversionElement->SetAttribute("TransducerGeometry", "CURVILINEAR");
+  scanConversionElement->SetDoubleAttribute("RadiusStartMm", 10.0);
+  scanConversionElement->SetDoubleAttribute("RadiusStopMm", 70.0);
+  scanConversionElement->SetDoubleAttribute("ThetaStartDeg", -35.0);
+  scanConversionElement->SetDoubleAttribute("ThetaStopDeg", 35.0);
+  int outputImageSizePixel[2] = { width, height };
+  scanConversionElement->SetVectorAttribute("OutputImageSizePixel", 2, outputImageSizePixel);
+  double outputImageSpacingMmPerPixel[2] = { 82.0 / width, 70.0 / height };
+  scanConversionElement->SetVectorAttribute("OutputImageSpacingMmPerPixel", 2, outputImageSpacingMmPerPixel);
+
+  vtkSmartPointer<vtkPlusUsScanConvertCurvilinear> scanConverter = vtkSmartPointer<vtkPlusUsScanConvertCurvilinear>::New();
+  if (scanConverter->ReadConfiguration(scanConversionElement) != PLUS_SUCCESS)
+  {
+    state.SkipWithError("Failed to read scan conversion configuration");
+    return;
+  }
+  scanConverter->SetNumberOfThreads(1);
+  scanConverter->SetVectorizationEnabled(vectorizationEnabled);
+  vtkSmartPointer<vtkImageData> envelope = CreateEnvelope(scalarType);
+  scanConverter->SetInputData(envelope);
+
+  // The interpolation table is computed in the first update, it is not part of the measurement
+  scanConverter->Update();
+
+  for (auto _ : state)
+  {
+    // Each acquired frame is a new input
+    envelope->Modified();
+    scanConverter->Update();
+    benchmark::DoNotOptimize(scanConverter->GetOutput()->GetScalarPointer());
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["InterpolatedPoints"] = scanConverter->GetInterpolatedPoints().GetNumberOfPoints();
+}
+BENCHMARK_CAPTURE(BM_ScanConvertCurvilinear, UCharScalar, VTK_UNSIGNED_CHAR, false)->Args({640, 480})->Args({1024, 768});
+BENCHMARK_CAPTURE(BM_ScanConvertCurvilinear, UCharVectorized, VTK_UNSIGNED_CHAR, true)->Args({640, 480})->Args({1024, 768});
+BENCHMARK_CAPTURE(BM_ScanConvertCurvilinear, ShortScalar, VTK_SHORT, false)->Args({640, 480})->Args({1024, 768});
+BENCHMARK_CAPTURE(BM_ScanConvertCurvilinear, ShortVectorized, VTK_SHORT, true)->Args({640, 480})->Args({1024, 768});
@@ -0,0 +1,234 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file SpatialModelIntersectionBenchmark.cxx
+  \brief Benchmarks of the scanline/surface intersection computation of the ultrasound simulator
+
+  The surface models of the ultrasound simulator tests are intersected with a fan of scanlines, once with the
+  cell locator (one line at a time) and once with the triangle hierarchy (packets of neighbor lines).
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusTriangleBvh.h"
+#include "vtkPlusConfig.h"
+
+// VTK includes
+#include <vtkIdList.h>
+#include <vtkModifiedBSPTree.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSTLReader.h>
+#include <vtkXMLDataElement.h>
+#include <vtkXMLPolyDataReader.h>
+#include <vtksys/SystemTools.hxx>
+
+// Google Benchmark includes
+#include <benchmark/benchmark.h>
+
+// STL includes
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+  /*! Device set configuration of the ultrasound simulator test, the spatial models are read from it */
+  const char* US_SIMULATOR_CONFIG_FILE = PLUSLIB_DATA_DIR "/ConfigFiles/Testing/PlusDeviceSet_UsSimulatorAlgoTestLinear.xml";
+  const char* US_SIMULATOR_MODEL_DIR = PLUSLIB_DATA_DIR "/TestImages";
+
+  //----------------------------------------------------------------------------
+  void FindModelFiles(vtkXMLDataElement* element, std::vector<std::string>& modelFiles)
+  {
+    if (element->GetName() != NULL && STRCASECMP(element->GetName(), "SpatialModel") == 0 && element->GetAttribute("ModelFile") != NULL)
+    {
+      modelFiles.push_back(element->GetAttribute("ModelFile"));
+    }
+    for (int i = 0; i < element->GetNumberOfNestedElements(); ++i)
+    {
+      FindModelFiles(element->GetNestedElement(i), modelFiles);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Read the surface models of the simulator test (the same way as PlusSpatialModel does). Models are read only once. */
+  const std::vector<vtkSmartPointer<vtkPolyData> >& GetModels()
+  {
+    static std::vector<vtkSmartPointer<vtkPolyData> > models;
+    static bool modelsRead = false;
+    if (modelsRead)
+    {
+      return models;
+    }
+    modelsRead = true;
+
+    vtkSmartPointer<vtkXMLDataElement> configRootElement = vtkSmartPointer<vtkXMLDataElement>::New();
+    if (PlusXmlUtils::ReadDeviceSetConfigurationFromFile(configRootElement, US_SIMULATOR_CONFIG_FILE) == PLUS_FAIL)
+    {
+      return models;
+    }
+    std::vector<std::string> modelFiles;
+    FindModelFiles(configRootElement, modelFiles);
+
+    vtkPlusConfig::GetInstance()->SetImageDirectory(US_SIMULATOR_MODEL_DIR);
+    for (std::vector<std::string>::iterator modelFileIt = modelFiles.begin(); modelFileIt != modelFiles.end(); ++modelFileIt)
+    {
+      std::string modelFilePath;
+      if (vtkPlusConfig::GetInstance()->FindImagePath(*modelFileIt, modelFilePath) != PLUS_SUCCESS)
+      {
+        continue;
+      }
+      vtkSmartPointer<vtkPolyData> polyData;
+      if (igsioCommon::IsEqualInsensitive(vtksys::SystemTools::GetFilenameLastExtension(modelFilePath), ".stl"))
+      {
+        vtkSmartPointer<vtkSTLReader> modelReader = vtkSmartPointer<vtkSTLReader>::New();
+        modelReader->SetFileName(modelFilePath.c_str());
+        modelReader->Update();
+        polyData = modelReader->GetOutput();
+      }
+      else
+      {
+        vtkSmartPointer<vtkXMLPolyDataReader> modelReader = vtkSmartPointer<vtkXMLPolyDataReader>::New();
+        modelReader->SetFileName(modelFilePath.c_str());
+        modelReader->Update();
+        polyData = modelReader->GetOutput();
+      }
+      if (polyData.GetPointer() != NULL && polyData->GetNumberOfCells() > 0)
+      {
+        models.push_back(polyData);
+      }
+    }
+    return models;
+  }
+
+  //----------------------------------------------------------------------------
+  /*!
+    Get a fan of scanlines that goes through the whole model: lines start above the model (along the Y axis)
+    and end at evenly spaced points below the model. 6 values (start and end point) per line.
+  */
+  std::vector<double> GetScanLineFan(vtkPolyData* model, int numberOfScanLines)
+  {
+    double bounds[6] = {0, 0, 0, 0, 0, 0};
+    model->GetBounds(bounds);
+    double size[3] = {bounds[1] - bounds[0], bounds[3] - bounds[2], bounds[5] - bounds[4]};
+    double center[3] = {0.5 * (bounds[0] + bounds[1]), 0.5 * (bounds[2] + bounds[3]), 0.5 * (bounds[4] + bounds[5])};
+    std::vector<double> scanLines(6 * numberOfScanLines);
+    for (int i = 0; i < numberOfScanLines; ++i)
+    {
+      double fraction = (numberOfScanLines > 1 ? static_cast<double>(i) / (numberOfScanLines - 1) : 0.5);
+      double* scanLine = &scanLines[6 * i];
+      scanLine[0] = center[0];
+      scanLine[1] = bounds[2] - 0.1 * size[1];
+      scanLine[2] = center[2];
+      scanLine[3] = bounds[0] - 0.1 * size[0] + 1.2 * size[0] * fraction;
+      scanLine[4] = bounds[3] + 0.1 * size[1];
+      scanLine[5] = center[2];
+    }
+    return scanLines;
+  }
+}
+
+//----------------------------------------------------------------------------
+// Arguments: number of scanlines
+static void BM_SpatialModelIntersectionLocator(benchmark::State& state)
+{
+  const std::vector<vtkSmartPointer<vtkPolyData> >& models = GetModels();
+  if (models.empty())
+  {
+    state.SkipWithError("Ultrasound simulator test models are not available");
+    return;
+  }
+  int numberOfScanLines = static_cast<int>(state.range(0));
+  std::vector<vtkSmartPointer<vtkModifiedBSPTree> > locators;
+  std::vector<std::vector<double> > scanLineFans;
+  for (std::vector<vtkSmartPointer<vtkPolyData> >::const_iterator modelIt = models.begin(); modelIt != models.end(); ++modelIt)
+  {
+    // Same settings as in PlusSpatialModel
+    vtkSmartPointer<vtkModifiedBSPTree> locator = vtkSmartPointer<vtkModifiedBSPTree>::New();
+    locator->SetDataSet(*modelIt);
+    locator->SetMaxLevel(24);
+    locator->SetNumberOfCellsPerNode(32);
+    locator->BuildLocator();
+    locators.push_back(locator);
+    scanLineFans.push_back(GetScanLineFan(*modelIt, numberOfScanLines));
+  }
+
+  vtkSmartPointer<vtkPoints> intersectionPoints = vtkSmartPointer<vtkPoints>::New();
+  vtkSmartPointer<vtkIdList> intersectionCellIds = vtkSmartPointer<vtkIdList>::New();
+  int64_t numberOfIntersections = 0;
+  for (auto _ : state)
+  {
+    for (size_t modelIndex = 0; modelIndex < models.size(); ++modelIndex)
+    {
+      for (int i = 0; i < numberOfScanLines; ++i)
+      {
+        double* scanLine = &scanLineFans[modelIndex][6 * i];
+        intersectionPoints->Reset();
+        intersectionCellIds->Reset();
+        locators[modelIndex]->IntersectWithLine(scanLine, scanLine + 3, 0.0, intersectionPoints, intersectionCellIds);
+        numberOfIntersections += intersectionPoints->GetNumberOfPoints();
+      }
+    }
+  }
+  benchmark::DoNotOptimize(numberOfIntersections);
+  state.SetItemsProcessed(state.iterations() * numberOfScanLines * static_cast<int64_t>(models.size()));
+}
+BENCHMARK(BM_SpatialModelIntersectionLocator)->Arg(128)->Arg(512)->Unit(benchmark::kMicrosecond);
+
+//----------------------------------------------------------------------------
+// Arguments: number of scanlines
+static void BM_SpatialModelIntersectionBvhPacket(benchmark::State& state)
+{
+  const std::vector<vtkSmartPointer<vtkPolyData> >& models = GetModels();
+  if (models.empty())
+  {
+    state.SkipWithError("Ultrasound simulator test models are not available");
+    return;
+  }
+  int numberOfScanLines = static_cast<int>(state.range(0));
+  std::vector<PlusTriangleBvh> hierarchies(models.size());
+  std::vector<std::vector<double> > scanLineFans;
+  for (size_t modelIndex = 0; modelIndex < models.size(); ++modelIndex)
+  {
+    if (hierarchies[modelIndex].Build(models[modelIndex]) != PLUS_SUCCESS)
+    {
+      state.SkipWithError("Failed to build triangle hierarchy");
+      return;
+    }
+    scanLineFans.push_back(GetScanLineFan(models[modelIndex], numberOfScanLines));
+  }
+
+  PlusTriangleBvh::RayPacket rays;
+  PlusTriangleBvh::PacketHits hits;
+  int64_t numberOfIntersections = 0;
+  for (auto _ : state)
+  {
+    for (size_t modelIndex = 0; modelIndex < models.size(); ++modelIndex)
+    {
+      for (int firstLine = 0; firstLine < numberOfScanLines; firstLine += PlusTriangleBvh::PACKET_SIZE)
+      {
+        rays.NumberOfRays = std::min(static_cast<int>(PlusTriangleBvh::PACKET_SIZE), numberOfScanLines - firstLine);
+        for (int i = 0; i < rays.NumberOfRays; ++i)
+        {
+          const double* scanLine = &scanLineFans[modelIndex][6 * (firstLine + i)];
+          for (int axis = 0; axis < 3; ++axis)
+          {
+            rays.Origin[axis][i] = scanLine[axis];
+            rays.Direction[axis][i] = scanLine[3 + axis] - scanLine[axis];
+          }
+        }
+        hierarchies[modelIndex].IntersectPacket(rays, hits);
+        for (int i = 0; i < rays.NumberOfRays; ++i)
+        {
+          numberOfIntersections += hits.Hits[i].size();
+        }
+      }
+    }
+  }
+  benchmark::DoNotOptimize(numberOfIntersections);
+  state.SetItemsProcessed(state.iterations() * numberOfScanLines * static_cast<int64_t>(models.size()));
+}
+BENCHMARK(BM_SpatialModelIntersectionBvhPacket)->Arg(128)->Arg(512)->Unit(benchmark::kMicrosecond);
@@ -7,18 +7,64 @@ See License.txt for details.
 #include "PlusConfigure.h"
 #include "PlusFidPatternRecognition.h"
 #include "vtkMath.h"
+#include "vtkMultiThreader.h"
 #include "vtkPoints.h"
 #include "vtkLine.h"
 
 #include "vtkIGSIOTrackedFrameList.h"
 #include "igsioTrackedFrame.h"
 
+#include <algorithm>
+#include <atomic>
+
 static const double DOT_STEPS  = 4.0;
 static const double DOT_RADIUS = 6.0;
 
+namespace
+{
+  /*! Data shared by all the threads that segment the frames of a tracked frame list */
+  struct FrameListRecognitionJob
+  {
+    vtkIGSIOTrackedFrameList* TrackedFrameList;
+    /*! Indices of the frames that are segmented */
+    std::vector<unsigned int> FrameIndices;
+    /*! Result of each segmented frame, in the same order as FrameIndices */
+    std::vector<PlusStatus> Statuses;
+    std::vector<PlusFidPatternRecognition::PatternRecognitionError> Errors;
+    /*! Pattern recognition object of each thread */
+    std::vector<PlusFidPatternRecognition>* Recognizers;
+    /*! Index of the pattern recognition object that segmented the last frame */
+    int LastFrameRecognizerIndex;
+    std::atomic<int> NextFrameIndex;
+    std::atomic<int> NextRecognizerIndex;
+  };
+
+  //-----------------------------------------------------------------------------
+  void* RecognizePatternThread(vtkMultiThreader::ThreadInfo* data)
+  {
+    FrameListRecognitionJob* job = static_cast<FrameListRecognitionJob*>(data->UserData);
+    const int recognizerIndex = job->NextRecognizerIndex++;
+    PlusFidPatternRecognition& recognizer = (*job->Recognizers)[recognizerIndex];
+
+    // Frames are distributed dynamically, as the segmentation time depends on the number of candidate dots
+    const int numberOfFrames = static_cast<int>(job->FrameIndices.size());
+    for (int i = job->NextFrameIndex++; i < numberOfFrames; i = job->NextFrameIndex++)
+    {
+      job->Statuses[i] = recognizer.RecognizePattern(job->TrackedFrameList->GetTrackedFrame(job->FrameIndices[i]), job->Errors[i], job->FrameIndices[i]);
+      if (i == numberOfFrames - 1)
+      {
+        job->LastFrameRecognizerIndex = recognizerIndex;
+      }
+    }
+
+    return NULL;
+  }
+}
+
 //-----------------------------------------------------------------------------
 
 PlusFidPatternRecognition::PlusFidPatternRecognition()
+  : m_NumberOfThreads(0)
 {
 
 }
@@ -46,6 +92,12 @@ PlusStatus PlusFidPatternRecognition::ReadConfiguration(vtkXMLDataElement* rootC
   m_FidLineFinder.ReadConfiguration(rootConfigElement);
   m_FidLabeling.ReadConfiguration(rootConfigElement, m_FidLineFinder.GetMinThetaRad(), m_FidLineFinder.GetMaxThetaRad());
 
+  vtkXMLDataElement* segmentationParameters = rootConfigElement->FindNestedElementWithName("Segmentation");
+  if (segmentationParameters != NULL)
+  {
+    XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfThreads, segmentationParameters);
+  }
+
   return PLUS_SUCCESS;
 }
 
@@ -178,17 +230,60 @@ PlusStatus PlusFidPatternRecognition::RecognizePattern(vtkIGSIOTrackedFrameList*
     *numberOfSuccessfullySegmentedImages = 0;
   }
 
+  FrameListRecognitionJob job;
+  job.TrackedFrameList = trackedFrameList;
   for (unsigned int currentFrameIndex = 0; currentFrameIndex < trackedFrameList->GetNumberOfTrackedFrames(); currentFrameIndex++)
   {
-    igsioTrackedFrame* trackedFrame = trackedFrameList->GetTrackedFrame(currentFrameIndex);
-
     // segment only non segmented frames
-    if (trackedFrame->GetFiducialPointsCoordinatePx() != NULL)
+    if (trackedFrameList->GetTrackedFrame(currentFrameIndex)->GetFiducialPointsCoordinatePx() == NULL)
     {
-      continue;
+      job.FrameIndices.push_back(currentFrameIndex);
     }
+  }
+  job.Statuses.resize(job.FrameIndices.size(), PLUS_SUCCESS);
+  job.Errors.resize(job.FrameIndices.size(), PATTERN_RECOGNITION_ERROR_NO_ERROR);
+
+  int numberOfThreads = (m_NumberOfThreads > 0 ? m_NumberOfThreads : vtkMultiThreader::GetGlobalDefaultNumberOfThreads());
+  numberOfThreads = std::max(1, std::min(std::min(numberOfThreads, static_cast<int>(job.FrameIndices.size())), VTK_MAX_THREADS));
+  if (m_FidSegmentation.GetDebugOutput())
+  {
+    // debug images of all the frames are written to the same files
+    numberOfThreads = 1;
+  }
+
+  if (numberOfThreads == 1)
+  {
+    for (unsigned int i = 0; i < job.FrameIndices.size(); i++)
+    {
+      job.Statuses[i] = RecognizePattern(trackedFrameList->GetTrackedFrame(job.FrameIndices[i]), job.Errors[i], job.FrameIndices[i]);
+    }
+  }
+  else
+  {
+    // Each thread works on its own copy of the segmentation images and results
+    std::vector<PlusFidPatternRecognition> recognizers(numberOfThreads, *this);
+    job.Recognizers = &recognizers;
+    job.LastFrameRecognizerIndex = 0;
+    job.NextFrameIndex = 0;
+    job.NextRecognizerIndex = 0;
+
+    vtkSmartPointer<vtkMultiThreader> threader = vtkSmartPointer<vtkMultiThreader>::New();
+    threader->SetNumberOfThreads(numberOfThreads);
+    threader->SetSingleMethod((vtkThreadFunctionType)&RecognizePatternThread, &job);
+    threader->SingleMethodExecute();
+
+    // Keep the results of the last frame, as if the frames were segmented one by one
+    *this = recognizers[job.LastFrameRecognizerIndex];
+  }
+
+  // Collect the results in frame order
+  for (unsigned int i = 0; i < job.FrameIndices.size(); i++)
+  {
+    const unsigned int currentFrameIndex = job.FrameIndices[i];
+    igsioTrackedFrame* trackedFrame = trackedFrameList->GetTrackedFrame(currentFrameIndex);
 
-    if (RecognizePattern(trackedFrame, patternRecognitionError, currentFrameIndex) != PLUS_SUCCESS)
+    patternRecognitionError = job.Errors[i];
+    if (job.Statuses[i] != PLUS_SUCCESS)
     {
       if (patternRecognitionError != PATTERN_RECOGNITION_ERROR_TOO_MANY_CANDIDATES)
       {
@@ -44,7 +44,10 @@ public:
 
   /*!
   Run pattern recognition on a tracked frame list.
-  It only segments the tracked frames which were not already segmented
+  It only segments the tracked frames which were not already segmented.
+  The frames are processed in parallel by NumberOfThreads threads, each using a copy of this object.
+  Results (segmented frame indices, returned error) are the same as if the frames were processed one by one in order
+  and the object is left in the state that processing of the last segmented frame produced.
   \param trackedFrameList Tracked frame list to segment
   \param numberOfSuccessfullySegmentedImages Out parameter holding the number of segmented images in this call (it is only equals the number of all segmented images in the tracked frame if it was not segmented at all)
   \param segmentedFramesIndices Indices of the frames that were properly segmented
@@ -95,6 +98,15 @@ public:
   /*! Reads the phantom definition and computes the NWires intersection if needed */
   PlusStatus ReadPhantomDefinition(vtkXMLDataElement* rootConfigElement);
 
+  /*!
+    Set the number of threads that segment the frames of a tracked frame list in parallel.
+    If the value is 0 (default) then the number of threads is determined automatically from the number of processor cores.
+    Frames are always processed by a single thread if debug output of the segmentation is enabled.
+  */
+  void SetNumberOfThreads(int numberOfThreads) { m_NumberOfThreads = numberOfThreads; };
+  /*! Get the number of threads that segment the frames of a tracked frame list in parallel (0 means automatic) */
+  int GetNumberOfThreads() { return m_NumberOfThreads; };
+
 protected:
 
   PlusFidSegmentation           m_FidSegmentation;
@@ -103,6 +115,9 @@ protected:
   std::vector<PlusFidPattern*>  m_Patterns;
 
   double                        m_MaxLineLengthToleranceMm;
+
+  /*! Number of threads that segment the frames of a tracked frame list. 0 means automatic (number of processor cores). */
+  int                           m_NumberOfThreads;
 };
 
 //-----------------------------------------------------------------------------
@@ -52,10 +52,10 @@ PlusFidSegmentation::PlusFidSegmentation()
   , m_ApproximateSpacingMmPerPixel(-1)
   , m_DotsFound(false)
   , m_NumDots(-1.0)
-  , m_Working(new PlusFidSegmentation::PixelType[1])
-  , m_Dilated(new PlusFidSegmentation::PixelType[1])
-  , m_Eroded(new PlusFidSegmentation::PixelType[1])
-  , m_UnalteredImage(new PlusFidSegmentation::PixelType[1])
+  , m_Working(1)
+  , m_Dilated(1)
+  , m_Eroded(1)
+  , m_UnalteredImage(1)
   , m_DebugOutput(false)
 {
   //Initialization of member variables
@@ -93,10 +93,6 @@ PlusFidSegmentation::PlusFidSegmentation()
 
 PlusFidSegmentation::~PlusFidSegmentation()
 {
-  delete[] m_Dilated;
-  delete[] m_Eroded;
-  delete[] m_Working;
-  delete[] m_UnalteredImage;
 }
 
 //-----------------------------------------------------------------------------
@@ -223,24 +219,16 @@ void PlusFidSegmentation::SetFrameSize(const FrameSizeType& frameSize)
     return;
   }
 
-  if ((m_FrameSize[0] != 0) && (m_FrameSize[1] != 0))
-  {
-    delete[] m_Dilated;
-    delete[] m_Eroded;
-    delete[] m_Working;
-    delete[] m_UnalteredImage;
-  }
-
   m_FrameSize[0] = frameSize[0];
   m_FrameSize[1] = frameSize[1];
   m_FrameSize[2] = 1;
 
-  // Create working images (after deleting them in case they were already created)
-  long size = m_FrameSize[0] * m_FrameSize[1];
-  m_Dilated = new PlusFidSegmentation::PixelType[size];
-  m_Eroded = new PlusFidSegmentation::PixelType[size];
-  m_Working = new PlusFidSegmentation::PixelType[size];
-  m_UnalteredImage = new PlusFidSegmentation::PixelType[size];
+  // Create working images
+  long size = std::max<long>(m_FrameSize[0] * m_FrameSize[1], 1);
+  m_Dilated.resize(size);
+  m_Eroded.resize(size);
+  m_Working.resize(size);
+  m_UnalteredImage.resize(size);
 
   // Set ROI to the largest possible if not already set
   if ((m_RegionOfInterest[0] == 0) || (m_RegionOfInterest[1] == 0) || (m_RegionOfInterest[2] == 0) || (m_RegionOfInterest[3] == 0))
@@ -255,12 +243,12 @@ void PlusFidSegmentation::SetFrameSize(const FrameSizeType& frameSize)
   {
     // Check the search region in case it was set to too big (with the additional bar size it would go out of image)
     unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-    if (m_RegionOfInterest[0] - barSize <= 0)
+    if (m_RegionOfInterest[0] <= barSize)
     {
       m_RegionOfInterest[0] = barSize + 1;
       LOG_WARNING("The region of interest is too big, bar size is " << barSize);
     }
-    if (m_RegionOfInterest[1] - barSize <= 0)
+    if (m_RegionOfInterest[1] <= barSize)
     {
       m_RegionOfInterest[1] = barSize + 1;
       LOG_WARNING("The region of interest is too big, bar size is " << barSize);
@@ -299,589 +287,254 @@ unsigned int PlusFidSegmentation::GetMorphologicalOpeningBarSizePx()
 
 //-----------------------------------------------------------------------------
 
-inline PlusFidSegmentation::PixelType PlusFidSegmentation::ErodePoint0(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic)
+namespace
 {
-  //LOG_TRACE("FidSegmentation::ErodePoint0");
-
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-  PlusFidSegmentation::PixelType dval = UCHAR_MAX;
-  unsigned int p = ir * m_FrameSize[0] + ic - barSize; // current pixel - bar size (position of the start of the bar)
-  unsigned int p_max = ir * m_FrameSize[0] + ic + barSize; // current pixel +  bar size (position of the end  of the bar)
-
-  //find lowest intensity in bar shaped area in image
-  for (; p <= p_max; p++)
+  /*! Erosion operator of the morphological filters */
+  struct MinimumOperator
   {
-    if (image[p] < dval)
-    {
-      dval = image[p];
-    }
-    if (image[p] == 0)
-    {
-      break;
-    }
-  }
+    static inline PlusFidSegmentation::PixelType Identity() { return UCHAR_MAX; }
+    static inline PlusFidSegmentation::PixelType Apply(PlusFidSegmentation::PixelType a, PlusFidSegmentation::PixelType b) { return a < b ? a : b; }
+  };
 
-  return dval;
+  /*! Dilation operator of the morphological filters */
+  struct MaximumOperator
+  {
+    static inline PlusFidSegmentation::PixelType Identity() { return 0; }
+    static inline PlusFidSegmentation::PixelType Apply(PlusFidSegmentation::PixelType a, PlusFidSegmentation::PixelType b) { return a > b ? a : b; }
+  };
 }
 
 //-----------------------------------------------------------------------------
 
-void PlusFidSegmentation::Erode0(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
+template<class Operator>
+void PlusFidSegmentation::FilterWithHorizontalBar(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
 {
-  //LOG_TRACE("FidSegmentation::Erode0");
-
   memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
 
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-
-  for (unsigned int ir = m_RegionOfInterest[1]; ir < m_RegionOfInterest[3]; ir++)
+  const int roiWidth = static_cast<int>(m_RegionOfInterest[2]) - static_cast<int>(m_RegionOfInterest[0]);
+  if (roiWidth <= 0 || m_RegionOfInterest[3] <= m_RegionOfInterest[1])
   {
-    unsigned int ic = m_RegionOfInterest[0];
-    unsigned int p_base = ir * m_FrameSize[0];
-
-    PlusFidSegmentation::PixelType dval = ErodePoint0(image, ir, ic);   // find lowest pixel intensity in surrounding region ( positions +/- 8 of current pixel position)
-    dest[p_base + ic] = dval; // p_base+ic = current pixel
-
-    for (ic++; ic < m_RegionOfInterest[2]; ic++)
-    {
-      PlusFidSegmentation::PixelType new_val = image[p_base + ic + barSize];
-      PlusFidSegmentation::PixelType del_val = image[p_base + ic - 1 - barSize];
-
-      dval = new_val <= dval ? new_val  : // dval = new val if new val is less than or equal to dval
-             del_val > dval ? std::min(dval, new_val) :   // if del val is greater than dval, dval= min of dval and new val
-             ErodePoint0(image, ir, ic);   //else dval = result of erode function
-
-      dest[ir * m_FrameSize[0] + ic] = dval; // update new "eroded" picture
-    }
+    return;
   }
-}
-
-//-----------------------------------------------------------------------------
-
-inline PlusFidSegmentation::PixelType PlusFidSegmentation::ErodePoint45(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic)
-{
-  //LOG_TRACE("FidSegmentation::ErodePoint45");
 
   const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
+  const int barLength = 2 * barSize + 1;
 
-  PlusFidSegmentation::PixelType dval = UCHAR_MAX;
-  unsigned int p = (ir + barSize) * m_FrameSize[0] + ic - barSize;
-  unsigned int p_max = (ir - barSize) * m_FrameSize[0] + ic + barSize;
+  // Pixels of a row that are covered by the bar when it is centered on any pixel of the region of interest
+  const int lineLength = roiWidth + barLength - 1;
+  m_BarForwardExtrema.resize(lineLength);
+  m_BarBackwardExtrema.resize(lineLength);
+  PlusFidSegmentation::PixelType* forward = &m_BarForwardExtrema[0];
+  PlusFidSegmentation::PixelType* backward = &m_BarBackwardExtrema[0];
 
-  for (; p >= p_max; p = p - m_FrameSize[0] + 1)
+  for (unsigned int ir = m_RegionOfInterest[1]; ir < m_RegionOfInterest[3]; ir++)
   {
-    if (image[p] < dval)
+    const PlusFidSegmentation::PixelType* line = image + ir * m_FrameSize[0] + m_RegionOfInterest[0] - barSize;
+
+    // Running extrema from the start (forward) and from the end (backward) of each block of bar length
+    for (int blockStart = 0; blockStart < lineLength; blockStart += barLength)
     {
-      dval = image[p];
+      const int blockEnd = std::min(blockStart + barLength, lineLength);
+      forward[blockStart] = line[blockStart];
+      for (int i = blockStart + 1; i < blockEnd; i++)
+      {
+        forward[i] = Operator::Apply(forward[i - 1], line[i]);
+      }
+      backward[blockEnd - 1] = line[blockEnd - 1];
+      for (int i = blockEnd - 2; i >= blockStart; i--)
+      {
+        backward[i] = Operator::Apply(backward[i + 1], line[i]);
+      }
     }
-    if (image[p] == 0)
+
+    // The bar is either a whole block or the end of a block followed by the start of the next one
+    PlusFidSegmentation::PixelType* destLine = dest + ir * m_FrameSize[0] + m_RegionOfInterest[0];
+    for (int i = 0; i < roiWidth; i++)
     {
-      break;
+      destLine[i] = Operator::Apply(backward[i], forward[i + barLength - 1]);
     }
   }
-  return dval;
 }
 
 //-----------------------------------------------------------------------------
 
-void PlusFidSegmentation::Erode45(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
+template<class Operator>
+void PlusFidSegmentation::FilterWithSlantedBar(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image, int columnStepPerRow)
 {
-  //LOG_TRACE("FidSegmentation::Erode45");
-
   memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
 
-  /* Down the left side. */
-  for (unsigned int sr = m_RegionOfInterest[1]; sr < m_RegionOfInterest[3]; sr++)
+  const int roiWidth = static_cast<int>(m_RegionOfInterest[2]) - static_cast<int>(m_RegionOfInterest[0]);
+  const int roiHeight = static_cast<int>(m_RegionOfInterest[3]) - static_cast<int>(m_RegionOfInterest[1]);
+  if (roiWidth <= 0 || roiHeight <= 0)
   {
-    unsigned int ir = sr;
-    unsigned int ic = m_RegionOfInterest[0];
-
-    PlusFidSegmentation::PixelType dval = ErodePoint45(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval;
-
-    for (ir--, ic++; ir >= m_RegionOfInterest[1] && ic < m_RegionOfInterest[2]; ir--, ic++)
-    {
-      PlusFidSegmentation::PixelType new_val = image[(ir - barSize) * m_FrameSize[0] + (ic + barSize)];
-      PlusFidSegmentation::PixelType del_val = image[(ir + 1 + barSize) * m_FrameSize[0] + (ic - 1 - barSize)];
-
-      dval = new_val <= dval ? new_val :
-             del_val > dval ? std::min(dval, new_val) :
-             ErodePoint45(image, ir, ic);
-
-      dest[ir * m_FrameSize[0] + ic] = dval;
-    }
-  }
-
-  /* Across the bottom */
-  for (unsigned int sc = m_RegionOfInterest[0]; sc < m_RegionOfInterest[2]; sc++)
-  {
-    unsigned int ic = sc;
-    unsigned int ir = m_RegionOfInterest[3] - 1;
-
-    PlusFidSegmentation::PixelType dval = ErodePoint45(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval;
-
-    for (ir--, ic++; ir >= m_RegionOfInterest[1] && ic < m_RegionOfInterest[2]; ir--, ic++)
-    {
-      PlusFidSegmentation::PixelType new_val = image[(ir - barSize) * m_FrameSize[0] + (ic + barSize)];
-      PlusFidSegmentation::PixelType del_val = image[(ir + 1 + barSize) * m_FrameSize[0] + (ic - 1 - barSize)];
-
-      dval = new_val <= dval ? new_val :
-             del_val > dval ? std::min(dval, new_val) :
-             ErodePoint45(image, ir, ic);
-
-      dest[ir * m_FrameSize[0] + ic] = dval;
-    }
+    return;
   }
-}
-
-//-----------------------------------------------------------------------------
-
-inline PlusFidSegmentation::PixelType PlusFidSegmentation::ErodePoint90(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic)
-{
-  //LOG_TRACE("FidSegmentation::ErodePoint90");
 
   const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-  PlusFidSegmentation::PixelType dval = UCHAR_MAX;
-  unsigned int p = (ir - barSize) * m_FrameSize[0] + ic;
-  unsigned int p_max = (ir + barSize) * m_FrameSize[0] + ic;
-
-  for (; p <= p_max; p += m_FrameSize[0])
-  {
-    if (image[p] < dval)
+  const int barLength = 2 * barSize + 1;
+
+  // Image region that is covered by the bar when it is centered on any pixel of the region of interest.
+  // Blocks of bar length are formed along the bar direction by the rows of the region. A bar that crosses
+  // the left or right side of the region is never centered on the region of interest, so running extrema can
+  // simply restart there.
+  const int regionWidth = roiWidth + barLength - 1;
+  const int regionHeight = roiHeight + barLength - 1;
+  const PlusFidSegmentation::PixelType* regionOrigin = image + (m_RegionOfInterest[1] - barSize) * m_FrameSize[0] + m_RegionOfInterest[0] - barSize;
+  m_BarForwardExtrema.resize(regionWidth * regionHeight);
+  m_BarBackwardExtrema.resize(regionWidth * regionHeight);
+  PlusFidSegmentation::PixelType* forward = &m_BarForwardExtrema[0];
+  PlusFidSegmentation::PixelType* backward = &m_BarBackwardExtrema[0];
+
+  // Running extrema from the first row of each block, the previous pixel of the bar is in column (ic - columnStepPerRow) of the previous row
+  const int forwardStartColumn = std::max(0, columnStepPerRow);
+  const int forwardEndColumn = std::min(regionWidth, regionWidth + columnStepPerRow);
+  for (int k = 0; k < regionHeight; k++)
+  {
+    PlusFidSegmentation::PixelType* forwardLine = forward + k * regionWidth;
+    memcpy(forwardLine, regionOrigin + k * m_FrameSize[0], regionWidth * sizeof(PlusFidSegmentation::PixelType));
+    if (k % barLength == 0)
     {
-      dval = image[p];
+      continue;
     }
-    if (image[p] == 0)
+    const PlusFidSegmentation::PixelType* previousForwardLine = forwardLine - regionWidth;
+    for (int ic = forwardStartColumn; ic < forwardEndColumn; ic++)
     {
-      break;
+      forwardLine[ic] = Operator::Apply(forwardLine[ic], previousForwardLine[ic - columnStepPerRow]);
     }
   }
-  return dval;
-}
-
-//-----------------------------------------------------------------------------
-
-void PlusFidSegmentation::Erode90(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
-{
-  //LOG_TRACE("FidSegmentation::Erode90");
-
-  memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
-
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
 
-  for (unsigned int ic = m_RegionOfInterest[0]; ic < m_RegionOfInterest[2]; ic++)
+  // Running extrema from the last row of each block, the next pixel of the bar is in column (ic + columnStepPerRow) of the next row
+  const int backwardStartColumn = std::max(0, -columnStepPerRow);
+  const int backwardEndColumn = std::min(regionWidth, regionWidth - columnStepPerRow);
+  for (int k = regionHeight - 1; k >= 0; k--)
   {
-    unsigned int ir = m_RegionOfInterest[1];
-
-    PlusFidSegmentation::PixelType dval = ErodePoint90(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval;
-
-    for (ir++; ir < m_RegionOfInterest[3]; ir++)
+    PlusFidSegmentation::PixelType* backwardLine = backward + k * regionWidth;
+    memcpy(backwardLine, regionOrigin + k * m_FrameSize[0], regionWidth * sizeof(PlusFidSegmentation::PixelType));
+    if (k % barLength == barLength - 1 || k == regionHeight - 1)
     {
-      PlusFidSegmentation::PixelType new_val = image[(ir + barSize) * m_FrameSize[0] + ic];
-      PlusFidSegmentation::PixelType del_val = image[(ir - 1 - barSize) * m_FrameSize[0] + ic];
-
-      dval = new_val <= dval ? new_val :
-             del_val > dval ? std::min(dval, new_val) :
-             ErodePoint90(image, ir, ic);
-
-      dest[ir * m_FrameSize[0] + ic] = dval;
+      continue;
+    }
+    const PlusFidSegmentation::PixelType* nextBackwardLine = backwardLine + regionWidth;
+    for (int ic = backwardStartColumn; ic < backwardEndColumn; ic++)
+    {
+      backwardLine[ic] = Operator::Apply(backwardLine[ic], nextBackwardLine[ic + columnStepPerRow]);
     }
   }
-}
-
-//-----------------------------------------------------------------------------
 
-inline PlusFidSegmentation::PixelType PlusFidSegmentation::ErodePoint135(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic)
-{
-  //LOG_TRACE("FidSegmentation::ErodePoint135");
-
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-  PlusFidSegmentation::PixelType dval = UCHAR_MAX;
-  unsigned int p = (ir - barSize) * m_FrameSize[0] + ic - barSize;
-  unsigned int p_max = (ir + barSize) * m_FrameSize[0] + ic + barSize;
-
-  for (; p <= p_max; p = p + m_FrameSize[0] + 1)
+  // The bar centered on row (k + barSize) of the region starts in row k and ends in row (k + barLength - 1)
+  const int barColumnOffset = barSize * columnStepPerRow;
+  for (int k = 0; k < roiHeight; k++)
   {
-    if (image[p] < dval)
+    const PlusFidSegmentation::PixelType* barStartLine = backward + k * regionWidth + barSize - barColumnOffset;
+    const PlusFidSegmentation::PixelType* barEndLine = forward + (k + barLength - 1) * regionWidth + barSize + barColumnOffset;
+    PlusFidSegmentation::PixelType* destLine = dest + (m_RegionOfInterest[1] + k) * m_FrameSize[0] + m_RegionOfInterest[0];
+    for (int ic = 0; ic < roiWidth; ic++)
     {
-      dval = image[p];
-    }
-    if (image[p] == 0)
-    {
-      break;
+      destLine[ic] = Operator::Apply(barStartLine[ic], barEndLine[ic]);
     }
   }
-  return dval;
 }
 
 //-----------------------------------------------------------------------------
 
-void PlusFidSegmentation::Erode135(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
+template<class Operator>
+void PlusFidSegmentation::FilterWithCircle(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
 {
-  //LOG_TRACE("FidSegmentation::Erode135");
-
   memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
 
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-
-  /* Up the left side. */
-  for (unsigned int sr = m_RegionOfInterest[3] - 1; sr >= m_RegionOfInterest[1]; sr--)
-  {
-    unsigned int ir = sr;
-    unsigned int ic = m_RegionOfInterest[0];
-
-    PlusFidSegmentation::PixelType dval = ErodePoint135(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval;
-
-    for (ir++, ic++; ir < m_RegionOfInterest[3] && ic < m_RegionOfInterest[2]; ir++, ic++)
-    {
-      PlusFidSegmentation::PixelType new_val = image[(ir + barSize) * m_FrameSize[0] + (ic + barSize)];
-      PlusFidSegmentation::PixelType del_val = image[(ir - 1 - barSize) * m_FrameSize[0] + (ic - 1 - barSize)];
-
-      dval = new_val <= dval ? new_val :
-             del_val > dval ? std::min(dval, new_val) :
-             ErodePoint135(image, ir, ic);
-
-      dest[ir * m_FrameSize[0] + ic] = dval;
-    }
-  }
-
-  /* Across the top. */
-  for (unsigned int sc = m_RegionOfInterest[0]; sc < m_RegionOfInterest[2]; sc++)
+  const int roiWidth = static_cast<int>(m_RegionOfInterest[2]) - static_cast<int>(m_RegionOfInterest[0]);
+  if (roiWidth <= 0)
   {
-    unsigned int ic = sc;
-    unsigned int ir = m_RegionOfInterest[1];
-
-    PlusFidSegmentation::PixelType dval = ErodePoint135(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval;
-
-    for (ir++, ic++; ir < m_RegionOfInterest[3] && ic < m_RegionOfInterest[2]; ir++, ic++)
-    {
-      PlusFidSegmentation::PixelType new_val = image[(ir + barSize) * m_FrameSize[0] + (ic + barSize)];
-      PlusFidSegmentation::PixelType del_val = image[(ir - 1 - barSize) * m_FrameSize[0] + (ic - 1 - barSize)];
-
-      dval = new_val <= dval ? new_val :
-             del_val > dval ? std::min(dval, new_val) :
-             ErodePoint135(image, ir, ic);
-
-      dest[ir * m_FrameSize[0] + ic] = dval;
-    }
+    return;
   }
-}
-
-//-----------------------------------------------------------------------------
-
-void PlusFidSegmentation::ErodeCircle(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
-{
-  //LOG_TRACE("FidSegmentation::ErodeCircle");
-
-  unsigned int slen = m_MorphologicalCircle.size();
-
-  memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
 
   for (unsigned int ir = m_RegionOfInterest[1]; ir < m_RegionOfInterest[3]; ir++)
   {
-    for (unsigned int ic = m_RegionOfInterest[0]; ic < m_RegionOfInterest[2]; ic++)
+    PlusFidSegmentation::PixelType* destLine = dest + ir * m_FrameSize[0] + m_RegionOfInterest[0];
+    std::fill(destLine, destLine + roiWidth, Operator::Identity());
+
+    // Combine the shifted source row of each element of the structuring element with the whole destination row
+    for (std::vector<PlusCoordinate2D>::const_iterator shapeIt = m_MorphologicalCircle.begin(); shapeIt != m_MorphologicalCircle.end(); ++shapeIt)
     {
-      PlusFidSegmentation::PixelType dval = UCHAR_MAX;
-      for (unsigned int sp = 0; sp < slen; sp++)
+      const PlusFidSegmentation::PixelType* line = image + (ir + shapeIt->Y) * m_FrameSize[0] + m_RegionOfInterest[0] + shapeIt->X;
+      for (int ic = 0; ic < roiWidth; ic++)
       {
-        int sr = ir + m_MorphologicalCircle[sp].X;
-        int sc = ic + m_MorphologicalCircle[sp].Y;
-        PlusFidSegmentation::PixelType pixSrc = image[sr * m_FrameSize[0] + sc];
-
-        if (pixSrc < dval)
-        {
-          dval = pixSrc;
-        }
-
-        if (pixSrc == 0)
-        {
-          break;
-        }
+        destLine[ic] = Operator::Apply(destLine[ic], line[ic]);
       }
-
-      dest[ir * m_FrameSize[0] + ic] = dval;
     }
   }
 }
 
 //-----------------------------------------------------------------------------
 
-inline PlusFidSegmentation::PixelType PlusFidSegmentation::DilatePoint0(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic)
+void PlusFidSegmentation::Erode0(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
 {
-  //LOG_TRACE("FidSegmentation::DilatePoint0");
-
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-  PlusFidSegmentation::PixelType dval = 0;
-  unsigned int p = ir * m_FrameSize[0] + ic - barSize;
-  unsigned int p_max = ir * m_FrameSize[0] + ic + barSize;
-
-  for (; p <= p_max; p++)
-  {
-    if (image[p] > dval)
-    {
-      dval = image[p];
-    }
-  }
-
-  return dval;
+  //LOG_TRACE("FidSegmentation::Erode0");
+  FilterWithHorizontalBar<MinimumOperator>(dest, image);
 }
 
 //-----------------------------------------------------------------------------
 
-void PlusFidSegmentation::Dilate0(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
+void PlusFidSegmentation::Erode45(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
 {
-  //LOG_TRACE("FidSegmentation::Dilate0");
-
-  memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
-
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-
-  for (unsigned int ir = m_RegionOfInterest[1]; ir < m_RegionOfInterest[3]; ir++)
-  {
-    unsigned int ic = m_RegionOfInterest[0];
-    unsigned int p_base = ir * m_FrameSize[0];
-
-    PlusFidSegmentation::PixelType dval = DilatePoint0(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval;
-
-    for (ic++; ic < m_RegionOfInterest[2]; ic++)
-    {
-      PlusFidSegmentation::PixelType new_val = image[p_base + ic + barSize];
-      PlusFidSegmentation::PixelType del_val = image[p_base + ic - 1 - barSize];
-
-      dval = new_val >= dval ? new_val :
-             (del_val < dval ? std::max(dval, new_val) :
-              DilatePoint0(image, ir, ic));
-      dest[ir * m_FrameSize[0] + ic] = dval;
-    }
-  }
+  //LOG_TRACE("FidSegmentation::Erode45");
+  FilterWithSlantedBar<MinimumOperator>(dest, image, -1);
 }
 
 //-----------------------------------------------------------------------------
 
-inline PlusFidSegmentation::PixelType PlusFidSegmentation::DilatePoint45(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic)
+void PlusFidSegmentation::Erode90(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
 {
-  //LOG_TRACE("FidSegmentation::DilatePoint45");
-
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-  PlusFidSegmentation::PixelType dval = 0;
-  unsigned int p = (ir + barSize) * m_FrameSize[0] + ic - barSize;
-  unsigned int p_max = (ir - barSize) * m_FrameSize[0] + ic + barSize;
-
-  while (p >= p_max)
-  {
-    if (image[p] > dval)
-    {
-      dval = image[p];
-    }
-    if (p - m_FrameSize[0] + 1 > p)
-    {
-      // unsigned int underflow, adjust
-      p = 0;
-    }
-    else
-    {
-      p = p - m_FrameSize[0] + 1;
-    }
-  }
-
-  return dval;
+  //LOG_TRACE("FidSegmentation::Erode90");
+  FilterWithSlantedBar<MinimumOperator>(dest, image, 0);
 }
 
 //-----------------------------------------------------------------------------
 
-void PlusFidSegmentation::Dilate45(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
+void PlusFidSegmentation::Erode135(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
 {
-  //LOG_TRACE("FidSegmentation::Dilate45");
-
-  memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-
-  /* Down the left side. */
-  for (unsigned int sr = m_RegionOfInterest[1]; sr < m_RegionOfInterest[3]; sr++)
-  {
-    unsigned int ir = sr;
-    unsigned int ic = m_RegionOfInterest[0];
-
-    PlusFidSegmentation::PixelType dval = DilatePoint45(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval ;
-    for (ir--, ic++; ir >= m_RegionOfInterest[1] && ic < m_RegionOfInterest[2]; ir--, ic++)
-    {
-      PlusFidSegmentation::PixelType new_val = image[(ir - barSize) * m_FrameSize[0] + (ic + barSize)];
-      PlusFidSegmentation::PixelType del_val = image[(ir + 1 + barSize) * m_FrameSize[0] + (ic - 1 - barSize)];
-
-      dval = new_val >= dval ? new_val :
-             (del_val < dval ? std::max(dval, new_val) :
-              DilatePoint45(image, ir, ic));
-      dest[ir * m_FrameSize[0] + ic] = dval ;
-    }
-  }
-
-  /* Across the bottom */
-  for (unsigned int sc = m_RegionOfInterest[0]; sc < m_RegionOfInterest[2]; sc++)
-  {
-    unsigned int ic = sc;
-    unsigned int ir = m_RegionOfInterest[3] - 1;
-
-    PlusFidSegmentation::PixelType dval = DilatePoint45(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval ;
-    for (ir--, ic++; ir >= m_RegionOfInterest[1] && ic < m_RegionOfInterest[2]; ir--, ic++)
-    {
-      PlusFidSegmentation::PixelType new_val = image[(ir - barSize) * m_FrameSize[0] + (ic + barSize)];
-      PlusFidSegmentation::PixelType del_val = image[(ir + 1 + barSize) * m_FrameSize[0] + (ic - 1 - barSize)];
-
-      dval = new_val >= dval ? new_val :
-             (del_val < dval ? std::max(dval, new_val) :
-              DilatePoint45(image, ir, ic));
-      dest[ir * m_FrameSize[0] + ic] = dval ;
-    }
-  }
+  //LOG_TRACE("FidSegmentation::Erode135");
+  FilterWithSlantedBar<MinimumOperator>(dest, image, 1);
 }
 
 //-----------------------------------------------------------------------------
 
-inline PlusFidSegmentation::PixelType PlusFidSegmentation::DilatePoint90(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic)
+void PlusFidSegmentation::ErodeCircle(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
 {
-  //LOG_TRACE("FidSegmentation::DilatePoint90");
-
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-  PlusFidSegmentation::PixelType dval = 0;
-  unsigned int p = (ir - barSize) * m_FrameSize[0] + ic;
-  unsigned int p_max = (ir + barSize) * m_FrameSize[0] + ic;
-
-  for (; p <= p_max; p += m_FrameSize[0])
-  {
-    if (image[p] > dval)
-    {
-      dval = image[p];
-    }
-  }
-  return dval;
+  //LOG_TRACE("FidSegmentation::ErodeCircle");
+  FilterWithCircle<MinimumOperator>(dest, image);
 }
 
 //-----------------------------------------------------------------------------
 
-void PlusFidSegmentation::Dilate90(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
+void PlusFidSegmentation::Dilate0(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
 {
-  //LOG_TRACE("FidSegmentation::Dilate90");
-
-  memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-
-  for (unsigned int ic = m_RegionOfInterest[0]; ic < m_RegionOfInterest[2]; ic++)
-  {
-    unsigned int ir = m_RegionOfInterest[1];
-
-    PlusFidSegmentation::PixelType dval = DilatePoint90(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval ;
-    for (ir++; ir < m_RegionOfInterest[3]; ir++)
-    {
-      PlusFidSegmentation::PixelType new_val = image[(ir + barSize) * m_FrameSize[0] + ic];
-      PlusFidSegmentation::PixelType del_val = image[(ir - 1 - barSize) * m_FrameSize[0] + ic];
-
-      dval = new_val >= dval ? new_val :
-             (del_val < dval ? std::max(dval, new_val) :
-              DilatePoint90(image, ir, ic));
-
-      dest[ir * m_FrameSize[0] + ic] = dval ;
-    }
-  }
+  //LOG_TRACE("FidSegmentation::Dilate0");
+  FilterWithHorizontalBar<MaximumOperator>(dest, image);
 }
 
 //-----------------------------------------------------------------------------
 
-inline PlusFidSegmentation::PixelType PlusFidSegmentation::DilatePoint135(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic)
+void PlusFidSegmentation::Dilate45(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
 {
-  //LOG_TRACE("FidSegmentation::DilatePoint135");
-
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-  PlusFidSegmentation::PixelType dval = 0;
-  unsigned int p = (ir - barSize) * m_FrameSize[0] + ic - barSize;
-  unsigned int p_max = (ir + barSize) * m_FrameSize[0] + ic + barSize;
-
-  for (; p <= p_max; p = p + m_FrameSize[0] + 1)
-  {
-    if (image[p] > dval)
-    {
-      dval = image[p];
-    }
-  }
-  return dval;
+  //LOG_TRACE("FidSegmentation::Dilate45");
+  FilterWithSlantedBar<MaximumOperator>(dest, image, -1);
 }
 
 //-----------------------------------------------------------------------------
 
-void PlusFidSegmentation::Dilate135(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
+void PlusFidSegmentation::Dilate90(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
 {
-  //LOG_TRACE("FidSegmentation::Dilate135");
-
-  memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-
-  /* Up the left side. */
-  for (unsigned int sr = m_RegionOfInterest[3] - 1; sr >= m_RegionOfInterest[1]; sr--)
-  {
-    unsigned int ir = sr;
-    unsigned int ic = m_RegionOfInterest[0];
-
-    PlusFidSegmentation::PixelType dval = DilatePoint135(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval ;
-    for (ir++, ic++; ir < m_RegionOfInterest[3] && ic < m_RegionOfInterest[2]; ir++, ic++)
-    {
-      PlusFidSegmentation::PixelType new_val = image[(ir + barSize) * m_FrameSize[0] + (ic + barSize)];
-      PlusFidSegmentation::PixelType del_val = image[(ir - 1 - barSize) * m_FrameSize[0] + (ic - 1 - barSize)];
-
-      dval = new_val >= dval ? new_val :
-             (del_val < dval ? std::max(dval, new_val) :
-              DilatePoint135(image, ir, ic));
-      dest[ir * m_FrameSize[0] + ic] = dval;
-    }
-  }
-
-  /* Across the top. */
-  for (unsigned int sc = m_RegionOfInterest[0]; sc < m_RegionOfInterest[2]; sc++)
-  {
-    unsigned int ic = sc;
-    unsigned int ir = m_RegionOfInterest[1];
-
-    PlusFidSegmentation::PixelType dval = DilatePoint135(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval;
-    for (ir++, ic++; ir < m_RegionOfInterest[3] && ic < m_RegionOfInterest[2]; ir++, ic++)
-    {
-      PlusFidSegmentation::PixelType new_val = image[(ir + barSize) * m_FrameSize[0] + (ic + barSize)];
-      PlusFidSegmentation::PixelType del_val = image[(ir - 1 - barSize) * m_FrameSize[0] + (ic - 1 - barSize)];
-
-      dval = new_val >= dval ? new_val :
-             (del_val < dval ? std::max(dval, new_val) :
-              DilatePoint135(image, ir, ic));
-      dest[ir * m_FrameSize[0] + ic] = dval;
-    }
-  }
+  //LOG_TRACE("FidSegmentation::Dilate90");
+  FilterWithSlantedBar<MaximumOperator>(dest, image, 0);
 }
 
 //-----------------------------------------------------------------------------
 
-inline PlusFidSegmentation::PixelType PlusFidSegmentation::DilatePoint(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic, PlusCoordinate2D* shape, int slen)
+void PlusFidSegmentation::Dilate135(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
 {
-  //LOG_TRACE("FidSegmentation::DilatePoint");
-
-  PlusFidSegmentation::PixelType dval = 0;
-  for (int sp = 0; sp < slen; sp++)
-  {
-    unsigned int sr = ir + shape[sp].Y;
-    unsigned int sc = ic + shape[sp].X;
-
-    if (image[sr * m_FrameSize[0] + sc] > dval)
-    {
-      dval = image[sr * m_FrameSize[0] + sc];
-    }
-  }
-  return dval;
+  //LOG_TRACE("FidSegmentation::Dilate135");
+  FilterWithSlantedBar<MaximumOperator>(dest, image, 1);
 }
 
 //-----------------------------------------------------------------------------
@@ -889,86 +542,7 @@ inline PlusFidSegmentation::PixelType PlusFidSegmentation::DilatePoint(PlusFidSe
 void PlusFidSegmentation::DilateCircle(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
 {
   //LOG_TRACE("FidSegmentation::DilateCircle");
-
-  unsigned int slen = m_MorphologicalCircle.size();
-
-  PlusCoordinate2D* shape = new PlusCoordinate2D[slen];
-
-  for (unsigned int i = 0; i < slen; i++)
-  {
-    shape[i] = m_MorphologicalCircle[i];
-  }
-
-  /* Which elements stick around when you shift right? */
-  int n = 0;
-
-  bool* sr_exist = new bool[slen];
-
-  memset(sr_exist, 0, slen * sizeof(bool));
-  for (unsigned int si = 0; si < slen; si++)
-  {
-    PlusCoordinate2D dot;
-    dot.X = m_MorphologicalCircle[si].X + 1;
-    dot.Y = m_MorphologicalCircle[si].Y;
-
-    if (ShapeContains(m_MorphologicalCircle, dot))
-    {
-      sr_exist[si] = true, n++;
-    }
-  }
-  //cout << "shift_exist: " << n << endl;
-
-  PlusCoordinate2D* newDots = new PlusCoordinate2D[slen];
-  PlusCoordinate2D* oldDots = new PlusCoordinate2D[slen];
-
-  int nNewDots = 0, nOldDots = 0;
-  for (unsigned int si = 0; si < slen; si++)
-  {
-    if (sr_exist[si])
-    {
-      oldDots[nOldDots++] = shape[si];
-    }
-    else
-    {
-      newDots[nNewDots++] = shape[si];
-    }
-  }
-
-  delete [] sr_exist;
-
-  memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
-  for (unsigned int ir = m_RegionOfInterest[1]; ir < m_RegionOfInterest[3]; ir++)
-  {
-    unsigned int ic = m_RegionOfInterest[0];
-
-    PlusFidSegmentation::PixelType dval = DilatePoint(image, ir, ic, shape, slen);
-    PlusFidSegmentation::PixelType last = dest[ir * m_FrameSize[0] + ic] = dval;
-
-    for (ic++; ic < m_RegionOfInterest[2]; ic++)
-    {
-      PlusFidSegmentation::PixelType dval = DilatePoint(image, ir, ic, newDots, nNewDots);
-
-      if (dval < last)
-      {
-        for (int sp = 0; sp < nOldDots; sp++)
-        {
-          unsigned int sr = ir + oldDots[sp].Y;
-          unsigned int sc = ic + oldDots[sp].X;
-          if (image[sr * m_FrameSize[0] + sc] > dval)
-          {
-            dval = image[sr * m_FrameSize[0] + sc];
-          }
-          if (image[sr * m_FrameSize[0] + sc] == last)
-          {
-            break;
-          }
-        }
-      }
-      last = dest[ir * m_FrameSize[0] + ic] = dval ;
-    }
-  }
-  delete [] newDots;
-  delete [] oldDots;
+  FilterWithCircle<MaximumOperator>(dest, image);
 }
 
 //-----------------------------------------------------------------------------
@@ -1326,16 +900,16 @@ bool PlusFidSegmentation::Cluster(bool& tooManyCandidates)
           PlusFidDot dot = testPosition.back();
           testPosition.pop_back();
 
-          ClusteringAddNeighbors(m_Working, dot.GetY() - 1, dot.GetX() - 1, testPosition, setPosition, valuesOfPosition);
-          ClusteringAddNeighbors(m_Working, dot.GetY() - 1, dot.GetX(), testPosition, setPosition, valuesOfPosition);
-          ClusteringAddNeighbors(m_Working, dot.GetY() - 1, dot.GetX() + 1, testPosition, setPosition, valuesOfPosition);
+          ClusteringAddNeighbors(&m_Working[0], dot.GetY() - 1, dot.GetX() - 1, testPosition, setPosition, valuesOfPosition);
+          ClusteringAddNeighbors(&m_Working[0], dot.GetY() - 1, dot.GetX(), testPosition, setPosition, valuesOfPosition);
+          ClusteringAddNeighbors(&m_Working[0], dot.GetY() - 1, dot.GetX() + 1, testPosition, setPosition, valuesOfPosition);
 
-          ClusteringAddNeighbors(m_Working, dot.GetY(), dot.GetX() - 1, testPosition, setPosition, valuesOfPosition);
-          ClusteringAddNeighbors(m_Working, dot.GetY(), dot.GetX() + 1, testPosition, setPosition, valuesOfPosition);
+          ClusteringAddNeighbors(&m_Working[0], dot.GetY(), dot.GetX() - 1, testPosition, setPosition, valuesOfPosition);
+          ClusteringAddNeighbors(&m_Working[0], dot.GetY(), dot.GetX() + 1, testPosition, setPosition, valuesOfPosition);
 
-          ClusteringAddNeighbors(m_Working, dot.GetY() + 1, dot.GetX() - 1, testPosition, setPosition, valuesOfPosition);
-          ClusteringAddNeighbors(m_Working, dot.GetY() + 1, dot.GetX(), testPosition, setPosition, valuesOfPosition);
-          ClusteringAddNeighbors(m_Working, dot.GetY() + 1, dot.GetX() + 1, testPosition, setPosition, valuesOfPosition);
+          ClusteringAddNeighbors(&m_Working[0], dot.GetY() + 1, dot.GetX() - 1, testPosition, setPosition, valuesOfPosition);
+          ClusteringAddNeighbors(&m_Working[0], dot.GetY() + 1, dot.GetX(), testPosition, setPosition, valuesOfPosition);
+          ClusteringAddNeighbors(&m_Working[0], dot.GetY() + 1, dot.GetX() + 1, testPosition, setPosition, valuesOfPosition);
         }
 
         double dest_r = 0, dest_c = 0, total = 0;
@@ -1406,95 +980,99 @@ void PlusFidSegmentation::MorphologicalOperations()
     return;
   }
 
+  PlusFidSegmentation::PixelType* working = &m_Working[0];
+  PlusFidSegmentation::PixelType* eroded = &m_Eroded[0];
+  PlusFidSegmentation::PixelType* dilated = &m_Dilated[0];
+
   // Morphological operations with a stick-like structuring element
   if (m_DebugOutput)
   {
-    WritePng(m_Working, "seg01-initial.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(working, "seg01-initial.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Erode0(m_Eroded, m_Working);
+  Erode0(eroded, working);
   if (m_DebugOutput)
   {
-    WritePng(m_Eroded, "seg02-morph-bar-deg0-erode.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(eroded, "seg02-morph-bar-deg0-erode.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Dilate0(m_Dilated, m_Eroded);
+  Dilate0(dilated, eroded);
   if (m_DebugOutput)
   {
-    WritePng(m_Dilated, "seg03-morph-bar-deg0-dilated.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(dilated, "seg03-morph-bar-deg0-dilated.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Subtract(m_Working, m_Dilated);
+  Subtract(working, dilated);
   if (m_DebugOutput)
   {
-    WritePng(m_Working, "seg04-morph-bar-deg0-final.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(working, "seg04-morph-bar-deg0-final.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Erode45(m_Eroded, m_Working);
+  Erode45(eroded, working);
   if (m_DebugOutput)
   {
-    WritePng(m_Eroded, "seg05-morph-bar-deg45-erode.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(eroded, "seg05-morph-bar-deg45-erode.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Dilate45(m_Dilated, m_Eroded);
+  Dilate45(dilated, eroded);
   if (m_DebugOutput)
   {
-    WritePng(m_Dilated, "seg06-morph-bar-deg45-dilated.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(dilated, "seg06-morph-bar-deg45-dilated.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Subtract(m_Working, m_Dilated);
+  Subtract(working, dilated);
   if (m_DebugOutput)
   {
-    WritePng(m_Working, "seg07-morph-bar-deg45-final.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(working, "seg07-morph-bar-deg45-final.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Erode90(m_Eroded, m_Working);
+  Erode90(eroded, working);
   if (m_DebugOutput)
   {
-    WritePng(m_Eroded, "seg08-morph-bar-deg90-erode.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(eroded, "seg08-morph-bar-deg90-erode.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Dilate90(m_Dilated, m_Eroded);
+  Dilate90(dilated, eroded);
   if (m_DebugOutput)
   {
-    WritePng(m_Dilated, "seg09-morph-bar-deg90-dilated.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(dilated, "seg09-morph-bar-deg90-dilated.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Subtract(m_Working, m_Dilated);
+  Subtract(working, dilated);
   if (m_DebugOutput)
   {
-    WritePng(m_Working, "seg10-morph-bar-deg90-final.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(working, "seg10-morph-bar-deg90-final.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Erode135(m_Eroded, m_Working);
+  Erode135(eroded, working);
   if (m_DebugOutput)
   {
-    WritePng(m_Eroded, "seg11-morph-bar-deg135-erode.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(eroded, "seg11-morph-bar-deg135-erode.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Dilate135(m_Dilated, m_Eroded);
+  Dilate135(dilated, eroded);
   if (m_DebugOutput)
   {
-    WritePng(m_Dilated, "seg12-morph-bar-deg135-dilated.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(dilated, "seg12-morph-bar-deg135-dilated.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Subtract(m_Working, m_Dilated);
+  Subtract(working, dilated);
   if (m_DebugOutput)
   {
-    WritePng(m_Working, "seg13-morph-bar-deg135-final.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(working, "seg13-morph-bar-deg135-final.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
   /* Circle operation. */
-  ErodeCircle(m_Eroded, m_Working);
+  ErodeCircle(eroded, working);
   if (m_DebugOutput)
   {
-    WritePng(m_Eroded, "seg14-morph-circle-erode.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(eroded, "seg14-morph-circle-erode.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  DilateCircle(m_Working, m_Eroded);
+  DilateCircle(working, eroded);
   if (m_DebugOutput)
   {
-    WritePng(m_Working, "seg15-morph-circle-final.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(working, "seg15-morph-circle-final.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
 }
@@ -1551,7 +1129,7 @@ void PlusFidSegmentation::ValidateRegionOfInterest()
   }
 
   // xmin
-  if (m_RegionOfInterest[0] - barSize <= 0)
+  if (m_RegionOfInterest[0] <= barSize)
   {
     m_RegionOfInterest[0] = barSize + 1;
   }
@@ -1571,7 +1149,7 @@ void PlusFidSegmentation::ValidateRegionOfInterest()
   }
 
   // ymin
-  if (m_RegionOfInterest[1] - barSize <= 0)
+  if (m_RegionOfInterest[1] <= barSize)
   {
     m_RegionOfInterest[1] = barSize + 1;
   }
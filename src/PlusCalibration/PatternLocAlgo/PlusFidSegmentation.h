@@ -36,6 +36,8 @@ public:
 /*!
   \class FidSegmentation
   \brief Algorithm for segmenting dots in an image. The dots correspond to the fiducial lines that are orthogonal to the image plane
+
+  The object owns its working images, so a copy can segment images independently of the original (e.g., in another thread).
   \ingroup PlusLibPatternRecognition
 */
 class vtkPlusCalibrationExport PlusFidSegmentation
@@ -86,25 +88,21 @@ public:
   /*! Check and modify if necessary the region of interest */
   void ValidateRegionOfInterest();
 
-  /*! Morphological operations performed by the algorithm */
-  inline PlusFidSegmentation::PixelType ErodePoint0(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic);
+  /*!
+    Morphological operations performed by the algorithm.
+    Only the region of interest of the destination image is computed, the rest of it is set to 0.
+    The bar operations use the van Herk/Gil-Werman algorithm (3 comparisons per pixel, independently of the bar size),
+    the circle operations process whole rows of the region of interest for each element of the structuring element.
+  */
   void Erode0(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image);
-  inline PlusFidSegmentation::PixelType ErodePoint45(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic);
   void Erode45(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image);
-  inline PlusFidSegmentation::PixelType ErodePoint90(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic);
   void Erode90(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image);
-  inline PlusFidSegmentation::PixelType ErodePoint135(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic);
   void Erode135(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image);
   void ErodeCircle(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image);
-  inline PlusFidSegmentation::PixelType DilatePoint0(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic);
   void Dilate0(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image);
-  inline PlusFidSegmentation::PixelType DilatePoint45(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic);
   void Dilate45(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image);
-  inline PlusFidSegmentation::PixelType DilatePoint90(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic);
   void Dilate90(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image);
-  inline PlusFidSegmentation::PixelType DilatePoint135(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic);
   void Dilate135(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image);
-  inline PlusFidSegmentation::PixelType DilatePoint(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic, PlusCoordinate2D* shape, int slen);
   void DilateCircle(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image);
   void Subtract(PlusFidSegmentation::PixelType* image, PlusFidSegmentation::PixelType* vals);
 
@@ -190,10 +188,10 @@ public:
   FiducialGeometryType  GetFiducialGeometry() { return m_FiducialGeometry; };
 
   /*! Get the working copy of the image */
-  PlusFidSegmentation::PixelType* GetWorking() {return m_Working; };
+  PlusFidSegmentation::PixelType* GetWorking() {return &m_Working[0]; };
 
   /*! Get the unaltered copy of the image */
-  PlusFidSegmentation::PixelType* GetUnalteredImage() {return m_UnalteredImage; };
+  PlusFidSegmentation::PixelType* GetUnalteredImage() {return &m_UnalteredImage[0]; };
 
   /*! Set the Approximate spacing, this is in Mm per pixel */
   void  SetApproximateSpacingMmPerPixel(double value) { m_ApproximateSpacingMmPerPixel = value; };
@@ -217,6 +215,22 @@ public:
   void  SetUseOriginalImageIntensityForDotIntensityScore(bool value) { m_UseOriginalImageIntensityForDotIntensityScore = value; };
 
 protected:
+  /*!
+    Erosion (Operator is minimum) or dilation (Operator is maximum) with a horizontal bar structuring element
+    using the van Herk/Gil-Werman algorithm
+  */
+  template<class Operator> void FilterWithHorizontalBar(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image);
+
+  /*!
+    Erosion (Operator is minimum) or dilation (Operator is maximum) with a vertical or diagonal bar structuring element
+    using the van Herk/Gil-Werman algorithm. The running extrema are computed along the bar direction for a whole image row at a time.
+    \param columnStepPerRow Column offset of the next pixel of the bar in the next row (0: vertical, -1: 45 deg, 1: 135 deg)
+  */
+  template<class Operator> void FilterWithSlantedBar(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image, int columnStepPerRow);
+
+  /*! Erosion (Operator is minimum) or dilation (Operator is maximum) with the morphological circle */
+  template<class Operator> void FilterWithCircle(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image);
+
   FrameSizeType m_FrameSize;
   std::array<unsigned int, 4> m_RegionOfInterest; // xmin, ymin; xmax, ymax
   bool m_UseOriginalImageIntensityForDotIntensityScore;
@@ -253,10 +267,14 @@ protected:
   /*! Pointer to the fiducial candidates coordinates */
   std::vector<PlusFidDot> m_CandidateFidValues;
 
-  PlusFidSegmentation::PixelType* m_Working;
-  PlusFidSegmentation::PixelType* m_Dilated;
-  PlusFidSegmentation::PixelType* m_Eroded;
-  PlusFidSegmentation::PixelType* m_UnalteredImage;
+  std::vector<PlusFidSegmentation::PixelType> m_Working;
+  std::vector<PlusFidSegmentation::PixelType> m_Dilated;
+  std::vector<PlusFidSegmentation::PixelType> m_Eroded;
+  std::vector<PlusFidSegmentation::PixelType> m_UnalteredImage;
+
+  /*! Running extrema of the van Herk/Gil-Werman algorithm, kept between frames to avoid reallocations */
+  std::vector<PlusFidSegmentation::PixelType> m_BarForwardExtrema;
+  std::vector<PlusFidSegmentation::PixelType> m_BarBackwardExtrema;
 
   std::vector<PlusFidDot> m_DotsVector;
 
@@ -0,0 +1,164 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PatternRecognitionMultithreadingTest.cxx
+  \brief This test segments a sequence with a single thread and with multiple threads
+  and checks that the results are identical
+*/
+
+#include "PlusConfigure.h"
+
+#include "PlusFidPatternRecognition.h"
+#include "igsioTrackedFrame.h"
+#include "vtkIGSIOSequenceIO.h"
+#include "vtkIGSIOTrackedFrameList.h"
+#include "vtkPoints.h"
+#include "vtkXMLDataElement.h"
+#include "vtksys/CommandLineArguments.hxx"
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  int numberOfFailures(0);
+
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  bool printHelp(false);
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  std::string inputSequenceMetafile("");
+  std::string inputConfigFileName("");
+  int numberOfThreads = 4;
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+  args.AddArgument("--source-seq-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputSequenceMetafile, "Input sequence metafile name with path");
+  args.AddArgument("--config-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputConfigFileName, "Input xml config file name with path");
+  args.AddArgument("--number-of-threads", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfThreads, "Number of threads used for the multithreaded segmentation (default: 4)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (inputSequenceMetafile.empty() || inputConfigFileName.empty())
+  {
+    std::cerr << "source-seq-file and config-file are required arguments!" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  // Read configuration
+  vtkSmartPointer<vtkXMLDataElement> configRootElement = vtkSmartPointer<vtkXMLDataElement>::New();
+  if (PlusXmlUtils::ReadDeviceSetConfigurationFromFile(configRootElement, inputConfigFileName.c_str()) == PLUS_FAIL)
+  {
+    LOG_ERROR("Unable to read configuration from file " << inputConfigFileName.c_str());
+    return EXIT_FAILURE;
+  }
+
+  PlusFidPatternRecognition singleThreadedPatternRecognition;
+  singleThreadedPatternRecognition.ReadConfiguration(configRootElement);
+  singleThreadedPatternRecognition.SetNumberOfThreads(1);
+
+  PlusFidPatternRecognition multiThreadedPatternRecognition;
+  multiThreadedPatternRecognition.ReadConfiguration(configRootElement);
+  multiThreadedPatternRecognition.SetNumberOfThreads(numberOfThreads);
+
+  // Each pattern recognition segments its own copy of the frames
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> singleThreadedTrackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> multiThreadedTrackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  if (vtkIGSIOSequenceIO::Read(inputSequenceMetafile, singleThreadedTrackedFrameList) != PLUS_SUCCESS
+      || vtkIGSIOSequenceIO::Read(inputSequenceMetafile, multiThreadedTrackedFrameList) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to read sequence metafile: " << inputSequenceMetafile);
+    return EXIT_FAILURE;
+  }
+
+  PlusFidPatternRecognition::PatternRecognitionError singleThreadedError;
+  int singleThreadedNumberOfSegmentedImages = 0;
+  std::vector<unsigned int> singleThreadedSegmentedFramesIndices;
+  PlusStatus singleThreadedStatus = singleThreadedPatternRecognition.RecognizePattern(singleThreadedTrackedFrameList, singleThreadedError,
+                                    &singleThreadedNumberOfSegmentedImages, &singleThreadedSegmentedFramesIndices);
+
+  PlusFidPatternRecognition::PatternRecognitionError multiThreadedError;
+  int multiThreadedNumberOfSegmentedImages = 0;
+  std::vector<unsigned int> multiThreadedSegmentedFramesIndices;
+  PlusStatus multiThreadedStatus = multiThreadedPatternRecognition.RecognizePattern(multiThreadedTrackedFrameList, multiThreadedError,
+                                   &multiThreadedNumberOfSegmentedImages, &multiThreadedSegmentedFramesIndices);
+
+  LOG_INFO("Segmentation success rate: " << singleThreadedNumberOfSegmentedImages << " out of " << singleThreadedTrackedFrameList->GetNumberOfTrackedFrames());
+
+  if (singleThreadedStatus != multiThreadedStatus || singleThreadedError != multiThreadedError)
+  {
+    LOG_ERROR("Segmentation status mismatch: single-threaded " << singleThreadedStatus << " (error " << singleThreadedError
+              << "), multi-threaded " << multiThreadedStatus << " (error " << multiThreadedError << ")");
+    numberOfFailures++;
+  }
+
+  if (singleThreadedNumberOfSegmentedImages != multiThreadedNumberOfSegmentedImages
+      || singleThreadedSegmentedFramesIndices != multiThreadedSegmentedFramesIndices)
+  {
+    LOG_ERROR("Segmented frames mismatch: single-threaded " << singleThreadedNumberOfSegmentedImages << " frames, multi-threaded " << multiThreadedNumberOfSegmentedImages << " frames");
+    numberOfFailures++;
+  }
+
+  for (unsigned int frameIndex = 0; frameIndex < singleThreadedTrackedFrameList->GetNumberOfTrackedFrames(); frameIndex++)
+  {
+    vtkPoints* singleThreadedPoints = singleThreadedTrackedFrameList->GetTrackedFrame(frameIndex)->GetFiducialPointsCoordinatePx();
+    vtkPoints* multiThreadedPoints = multiThreadedTrackedFrameList->GetTrackedFrame(frameIndex)->GetFiducialPointsCoordinatePx();
+    if ((singleThreadedPoints == NULL) != (multiThreadedPoints == NULL))
+    {
+      LOG_ERROR("Frame " << frameIndex << " is segmented only by one of the pattern recognitions");
+      numberOfFailures++;
+      continue;
+    }
+    if (singleThreadedPoints == NULL)
+    {
+      continue;
+    }
+    if (singleThreadedPoints->GetNumberOfPoints() != multiThreadedPoints->GetNumberOfPoints())
+    {
+      LOG_ERROR("Number of fiducial points mismatch in frame " << frameIndex << ": single-threaded " << singleThreadedPoints->GetNumberOfPoints()
+                << ", multi-threaded " << multiThreadedPoints->GetNumberOfPoints());
+      numberOfFailures++;
+      continue;
+    }
+    for (vtkIdType pointIndex = 0; pointIndex < singleThreadedPoints->GetNumberOfPoints(); pointIndex++)
+    {
+      double singleThreadedPoint[3] = {0};
+      double multiThreadedPoint[3] = {0};
+      singleThreadedPoints->GetPoint(pointIndex, singleThreadedPoint);
+      multiThreadedPoints->GetPoint(pointIndex, multiThreadedPoint);
+      // The same computations are performed on the same data, so the results must be exactly the same
+      if (singleThreadedPoint[0] != multiThreadedPoint[0] || singleThreadedPoint[1] != multiThreadedPoint[1])
+      {
+        LOG_ERROR("Fiducial point " << pointIndex << " mismatch in frame " << frameIndex << ": single-threaded (" << singleThreadedPoint[0] << ", " << singleThreadedPoint[1]
+                  << "), multi-threaded (" << multiThreadedPoint[0] << ", " << multiThreadedPoint[1] << ")");
+        numberOfFailures++;
+      }
+    }
+  }
+
+  if (numberOfFailures > 0)
+  {
+    LOG_ERROR("Test failed!");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test finished successfully!");
+  return EXIT_SUCCESS;
+}
@@ -193,6 +193,7 @@ int main(int argc, char** argv)
   std::vector<int> clipRectOrigin;
   std::vector<int> clipRectSize;
   std::string inputBaselineFileName;
+  std::string lagSearchMethod("SWEEP");
 
   vtksys::CommandLineArguments args;
   args.Initialize(argc, argv);
@@ -211,6 +212,7 @@ int main(int argc, char** argv)
   args.AddArgument("--clip-rect-origin", vtksys::CommandLineArguments::MULTI_ARGUMENT, &clipRectOrigin, "Origin of the clipping rectangle");
   args.AddArgument("--clip-rect-size", vtksys::CommandLineArguments::MULTI_ARGUMENT, &clipRectSize, "Size of the clipping rectangle");
   args.AddArgument("--baseline-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputBaselineFileName, "Input xml baseline file name with path");
+  args.AddArgument("--lag-search-method", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &lagSearchMethod, "Method of searching the time offset: SWEEP (compute the alignment for each offset, default) or FFT (compute the alignment for all offsets by FFT-based cross-correlation, faster for long recordings)");
 
   if (!args.Parse())
   {
@@ -306,6 +308,19 @@ int main(int argc, char** argv)
   testTemporalCalibrationObject->SetSaveIntermediateImages(saveIntermediateImages);
   testTemporalCalibrationObject->SetIntermediateFilesOutputDirectory(intermediateFileOutputDirectory);
   testTemporalCalibrationObject->SetMaximumMovingLagSec(maxTimeOffsetSec);
+  if (igsioCommon::IsEqualInsensitive(lagSearchMethod, "FFT"))
+  {
+    testTemporalCalibrationObject->SetLagSearchMethod(vtkPlusTemporalCalibrationAlgo::LAG_SEARCH_METHOD_FFT);
+  }
+  else if (igsioCommon::IsEqualInsensitive(lagSearchMethod, "SWEEP"))
+  {
+    testTemporalCalibrationObject->SetLagSearchMethod(vtkPlusTemporalCalibrationAlgo::LAG_SEARCH_METHOD_SWEEP);
+  }
+  else
+  {
+    LOG_ERROR("Invalid lag search method: " << lagSearchMethod << ". Valid values: SWEEP, FFT");
+    exit(EXIT_FAILURE);
+  }
 
   if (clipRectOrigin.size() > 0 || clipRectSize.size() > 0)
   {
@@ -5,6 +5,7 @@
 =========================================================Plus=header=end*/
 
 #include "PlusConfigure.h"
+#include "PlusFft.h"
 #include "igsioTrackedFrame.h"
 #include "vtkObjectFactory.h"
 #include "vtkDoubleArray.h"
@@ -68,6 +69,7 @@ vtkPlusTemporalCalibrationAlgo::vtkPlusTemporalCalibrationAlgo()
   , SaveIntermediateImages(false)
   , IntermediateFilesOutputDirectory(vtkPlusConfig::GetInstance()->GetOutputDirectory())
   , SamplingResolutionSec(DEFAULT_SAMPLING_RESOLUTION_SEC)
+  , LagSearchMethod(LAG_SEARCH_METHOD_SWEEP)
   , BestCorrelationValue(0.0)
   , BestCorrelationLagIndex(-1)
   , BestCorrelationTimeOffset(0.0)
@@ -180,6 +182,18 @@ void vtkPlusTemporalCalibrationAlgo::SetMaximumMovingLagSec(double maxLagSec)
   this->MaxMovingLagSec = maxLagSec;
 }
 
+//-----------------------------------------------------------------------------
+void vtkPlusTemporalCalibrationAlgo::SetLagSearchMethod(LAG_SEARCH_METHOD lagSearchMethod)
+{
+  this->LagSearchMethod = lagSearchMethod;
+}
+
+//-----------------------------------------------------------------------------
+vtkPlusTemporalCalibrationAlgo::LAG_SEARCH_METHOD vtkPlusTemporalCalibrationAlgo::GetLagSearchMethod() const
+{
+  return this->LagSearchMethod;
+}
+
 //-----------------------------------------------------------------------------
 void vtkPlusTemporalCalibrationAlgo::SetIntermediateFilesOutputDirectory(const std::string& outputDirectory)
 {
@@ -509,6 +523,229 @@ void vtkPlusTemporalCalibrationAlgo::ComputeCorrelationBetweenFixedAndMovingSign
   LOG_DEBUG("numberOfSamples=" << corrValues.size());
 }
 
+//-----------------------------------------------------------------------------
+void vtkPlusTemporalCalibrationAlgo::ResampleSignalUniformly(const std::deque<double>& signalTimestamps, const std::deque<double>& signalValues,
+    double startTime, double stepSec, int numberOfSamples, std::vector<double>& resampledSignalValues)
+{
+  resampledSignalValues.resize(numberOfSamples);
+  if (signalTimestamps.empty())
+  {
+    std::fill(resampledSignalValues.begin(), resampledSignalValues.end(), 0.0);
+    return;
+  }
+  // Sample times are increasing, so the interval that contains the sample time is searched from the previous interval
+  const unsigned int lastIndex = signalTimestamps.size() - 1;
+  unsigned int intervalStartIndex = 0;
+  for (int i = 0; i < numberOfSamples; ++i)
+  {
+    double t = startTime + i * stepSec;
+    if (t <= signalTimestamps[0])
+    {
+      resampledSignalValues[i] = signalValues[0];
+      continue;
+    }
+    if (t >= signalTimestamps[lastIndex])
+    {
+      resampledSignalValues[i] = signalValues[lastIndex];
+      continue;
+    }
+    while (signalTimestamps[intervalStartIndex + 1] < t)
+    {
+      ++intervalStartIndex;
+    }
+    double intervalLength = signalTimestamps[intervalStartIndex + 1] - signalTimestamps[intervalStartIndex];
+    double weight = (intervalLength > 0 ? (t - signalTimestamps[intervalStartIndex]) / intervalLength : 0.0);
+    resampledSignalValues[i] = (1.0 - weight) * signalValues[intervalStartIndex] + weight * signalValues[intervalStartIndex + 1];
+  }
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusTemporalCalibrationAlgo::ComputeCorrelationBetweenFixedAndMovingSignalFft(double maxTrackerLagSec, double& bestCorrelationTimeOffset,
+    std::deque<double>& corrTimeOffsets, std::deque<double>& corrValues)
+{
+  corrTimeOffsets.clear();
+  corrValues.clear();
+
+  if (SIGNAL_ALIGNMENT_METRIC != SSD && SIGNAL_ALIGNMENT_METRIC != CORRELATION)
+  {
+    LOG_WARNING("FFT-based lag search is not available for alignment metric " << SIGNAL_ALIGNMENT_METRIC);
+    return PLUS_FAIL;
+  }
+  if (this->MovingSignal.signalTimestamps.size() < 2 || this->FixedSignal.signalTimestamps.size() < 2)
+  {
+    LOG_ERROR("Not enough samples for FFT-based lag search");
+    return PLUS_FAIL;
+  }
+
+  // The moving signal is compared to the fixed signal at times shifted by the time offset: Fixed(t) <-> Moving(t + offset).
+  // Both signals are resampled uniformly: the moving signal in its own time range, the fixed signal in a range
+  // that is larger by the maximum lag on both sides (the fixed signal time range is larger than that, see ComputeCommonTimeRange).
+  const double stepSec = this->SamplingResolutionSec;
+  const int maxLagSteps = static_cast<int>(ceil(maxTrackerLagSec / stepSec - 1e-6));
+  const double movingStartTime = this->MovingSignal.signalTimestamps.front();
+  const int numberOfMovingSamples = static_cast<int>(floor((this->MovingSignal.signalTimestamps.back() - movingStartTime) / stepSec)) + 1;
+  const int numberOfFixedSamples = numberOfMovingSamples + 2 * maxLagSteps;
+  if (numberOfMovingSamples < 3 || maxLagSteps < 1)
+  {
+    LOG_ERROR("Not enough samples for FFT-based lag search (" << numberOfMovingSamples << " samples, " << maxLagSteps << " lag steps)");
+    return PLUS_FAIL;
+  }
+
+  std::vector<double> movingValues;
+  ResampleSignalUniformly(this->MovingSignal.signalTimestamps, this->MovingSignal.signalValues, movingStartTime, stepSec, numberOfMovingSamples, movingValues);
+  std::vector<double> fixedValues;
+  ResampleSignalUniformly(this->FixedSignal.signalTimestamps, this->FixedSignal.signalValues, movingStartTime - maxLagSteps * stepSec, stepSec, numberOfFixedSamples, fixedValues);
+
+  // Normalize the moving signal to zero mean and unit standard deviation (same normalization as in NormalizeMetricValues).
+  // As the normalized moving signal has zero mean, the mean of the fixed signal in the overlapping window does not
+  // affect the cross-correlation, so the fixed signal is only normalized by its standard deviation in each window.
+  double movingMean = 0;
+  for (int i = 0; i < numberOfMovingSamples; ++i)
+  {
+    movingMean += movingValues[i];
+  }
+  movingMean /= numberOfMovingSamples;
+  double movingStdev = 0;
+  for (int i = 0; i < numberOfMovingSamples; ++i)
+  {
+    movingStdev += (movingValues[i] - movingMean) * (movingValues[i] - movingMean);
+  }
+  movingStdev = std::sqrt(movingStdev / (numberOfMovingSamples - 1));
+  if (movingStdev < 1e-10)
+  {
+    LOG_ERROR("Cannot normalize data, stdev is too small");
+    return PLUS_FAIL;
+  }
+  double fixedMean = 0;
+  for (int i = 0; i < numberOfFixedSamples; ++i)
+  {
+    fixedMean += fixedValues[i];
+  }
+  fixedMean /= numberOfFixedSamples;
+
+  // Cross-correlation of the two real signals is computed by one complex transform:
+  // fixed signal in the real part, normalized moving signal in the imaginary part
+  PlusFft fft;
+  if (fft.SetSize(PlusFft::GetNextPowerOfTwo(numberOfFixedSamples)) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  const unsigned int fftSize = fft.GetSize();
+  std::vector<PlusFft::ComplexType> spectrum(fftSize, PlusFft::ComplexType(0.0, 0.0));
+  for (int i = 0; i < numberOfFixedSamples; ++i)
+  {
+    double movingValue = (i < numberOfMovingSamples ? (movingValues[i] - movingMean) / movingStdev : 0.0);
+    spectrum[i] = PlusFft::ComplexType(fixedValues[i] - fixedMean, movingValue);
+  }
+  fft.Forward(&spectrum[0]);
+  // Separate the spectra of the two signals (F = (Z[k] + conj(Z[-k]))/2, M = (Z[k] - conj(Z[-k]))/2i) and compute F * conj(M)
+  std::vector<PlusFft::ComplexType> crossSpectrum(fftSize);
+  for (unsigned int k = 0; k < fftSize; ++k)
+  {
+    PlusFft::ComplexType z = spectrum[k];
+    PlusFft::ComplexType zMirroredConj = std::conj(spectrum[(fftSize - k) & (fftSize - 1)]);
+    PlusFft::ComplexType fixedSpectrum = 0.5 * (z + zMirroredConj);
+    PlusFft::ComplexType movingSpectrum = PlusFft::ComplexType(0.0, -0.5) * (z - zMirroredConj);
+    crossSpectrum[k] = fixedSpectrum * std::conj(movingSpectrum);
+  }
+  fft.Inverse(&crossSpectrum[0]);
+  // crossSpectrum[d] = sum_j Fixed[j+d] * Moving[j], which corresponds to time offset (maxLagSteps - d) * stepSec
+
+  // Sums of the fixed signal values for computing the standard deviation in each window
+  std::vector<double> fixedSum(numberOfFixedSamples + 1, 0.0);
+  std::vector<double> fixedSquareSum(numberOfFixedSamples + 1, 0.0);
+  for (int i = 0; i < numberOfFixedSamples; ++i)
+  {
+    double value = fixedValues[i] - fixedMean;
+    fixedSum[i + 1] = fixedSum[i] + value;
+    fixedSquareSum[i + 1] = fixedSquareSum[i] + value * value;
+  }
+
+  const int numberOfOffsets = 2 * maxLagSteps + 1;
+  std::vector<double> metricValues(numberOfOffsets, 0.0);
+  int bestOffsetIndex = 0;
+  for (int offsetIndex = 0; offsetIndex < numberOfOffsets; ++offsetIndex)
+  {
+    // Offsets are stored in increasing order
+    const int d = 2 * maxLagSteps - offsetIndex;
+    double windowSum = fixedSum[d + numberOfMovingSamples] - fixedSum[d];
+    double windowSquareSum = fixedSquareSum[d + numberOfMovingSamples] - fixedSquareSum[d];
+    double fixedVariance = (windowSquareSum - windowSum * windowSum / numberOfMovingSamples) / (numberOfMovingSamples - 1);
+    // Sum of the products of the normalized signals
+    double normalizedCorrelation = (fixedVariance > 1e-20 ? crossSpectrum[d].real() / std::sqrt(fixedVariance) : 0.0);
+    if (SIGNAL_ALIGNMENT_METRIC == SSD)
+    {
+      // Both normalized signals have sum of squares = N-1, so SSD = 2*(N-1) - 2*correlation
+      metricValues[offsetIndex] = -2.0 * (numberOfMovingSamples - 1 - normalizedCorrelation);
+    }
+    else
+    {
+      metricValues[offsetIndex] = normalizedCorrelation;
+    }
+    corrTimeOffsets.push_back((offsetIndex - maxLagSteps) * stepSec);
+    corrValues.push_back(metricValues[offsetIndex]);
+    if (metricValues[offsetIndex] > metricValues[bestOffsetIndex])
+    {
+      bestOffsetIndex = offsetIndex;
+    }
+  }
+
+  // Sub-sample refinement: the peak of the parabola that goes through the best value and its neighbors
+  double refinedOffsetIndex = bestOffsetIndex;
+  if (bestOffsetIndex > 0 && bestOffsetIndex < numberOfOffsets - 1)
+  {
+    double previousValue = metricValues[bestOffsetIndex - 1];
+    double bestValue = metricValues[bestOffsetIndex];
+    double nextValue = metricValues[bestOffsetIndex + 1];
+    double curvature = previousValue - 2 * bestValue + nextValue;
+    if (curvature < 0)
+    {
+      refinedOffsetIndex += std::max(-0.5, std::min(0.5, 0.5 * (previousValue - nextValue) / curvature));
+    }
+  }
+  bestCorrelationTimeOffset = (refinedOffsetIndex - maxLagSteps) * stepSec;
+
+  LOG_DEBUG("FFT lag search: numberOfSamples=" << numberOfMovingSamples << ", fftSize=" << fftSize << ", bestCorrelationTimeOffset=" << bestCorrelationTimeOffset);
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusTemporalCalibrationAlgo::FindBestTimeOffset(double coarseStepSec, double& bestCorrelationValue, double& bestCorrelationTimeOffset, double& bestCorrelationNormalizationFactor,
+    std::deque<double>& corrTimeOffsets, std::deque<double>& corrValues, std::deque<double>& corrTimeOffsetsFine, std::deque<double>& corrValuesFine)
+{
+  double searchRangeFineStep = coarseStepSec * 3;
+
+  if (this->LagSearchMethod == LAG_SEARCH_METHOD_FFT)
+  {
+    if (ComputeCorrelationBetweenFixedAndMovingSignalFft(this->MaxMovingLagSec, bestCorrelationTimeOffset, corrTimeOffsets, corrValues) == PLUS_SUCCESS)
+    {
+      // The fine correlation signal is the part of the computed curve around the best offset
+      corrTimeOffsetsFine.clear();
+      corrValuesFine.clear();
+      for (unsigned int i = 0; i < corrTimeOffsets.size(); ++i)
+      {
+        if (fabs(corrTimeOffsets[i] - bestCorrelationTimeOffset) <= searchRangeFineStep)
+        {
+          corrTimeOffsetsFine.push_back(corrTimeOffsets[i]);
+          corrValuesFine.push_back(corrValues[i]);
+        }
+      }
+      // Evaluate the alignment metric at the best offset the same way as the sweep does, so that the
+      // correlation value, normalization factor and calibration errors are comparable between the methods
+      double bestOffset = bestCorrelationTimeOffset;
+      std::deque<double> bestOffsetTimeOffsets;
+      std::deque<double> bestOffsetValues;
+      ComputeCorrelationBetweenFixedAndMovingSignal(bestOffset, bestOffset, this->SamplingResolutionSec, bestCorrelationValue, bestCorrelationTimeOffset, bestCorrelationNormalizationFactor, bestOffsetTimeOffsets, bestOffsetValues);
+      return;
+    }
+    LOG_WARNING("FFT-based lag search failed, time offsets are searched by computing the alignment metric for each offset");
+  }
+
+  ComputeCorrelationBetweenFixedAndMovingSignal(-this->MaxMovingLagSec, this->MaxMovingLagSec, coarseStepSec, bestCorrelationValue, bestCorrelationTimeOffset, bestCorrelationNormalizationFactor, corrTimeOffsets, corrValues);
+  ComputeCorrelationBetweenFixedAndMovingSignal(bestCorrelationTimeOffset - searchRangeFineStep, bestCorrelationTimeOffset + searchRangeFineStep, this->SamplingResolutionSec, bestCorrelationValue, bestCorrelationTimeOffset, bestCorrelationNormalizationFactor, corrTimeOffsetsFine, corrValuesFine);
+}
+
+//-----------------------------------------------------------------------------
 double vtkPlusTemporalCalibrationAlgo::ComputeAlignmentMetric(const std::deque<double>& signalA, const std::deque<double>& signalB)
 {
   if (signalA.size() != signalB.size())
@@ -697,8 +934,6 @@ PlusStatus vtkPlusTemporalCalibrationAlgo::ComputeMovingSignalLagSec(TEMPORAL_CA
   }
   double imageFramePeriodSec = (fixedTimestampMax - fixedTimestampMin) / (this->FixedSignal.signalTimestamps.size() - 1);
 
-  double searchRangeFineStep = imageFramePeriodSec * 3;
-
   //  Compute cross correlation with sign convention #1
   LOG_DEBUG("ComputeCorrelationBetweenFixedAndMovingSignal(sign convention #1)");
   double bestCorrelationValue = 0;
@@ -706,10 +941,9 @@ PlusStatus vtkPlusTemporalCalibrationAlgo::ComputeMovingSignalLagSec(TEMPORAL_CA
   double bestCorrelationNormalizationFactor = 1.0;
   std::deque<double> corrTimeOffsets;
   std::deque<double> corrValues;
-  ComputeCorrelationBetweenFixedAndMovingSignal(-this->MaxMovingLagSec, this->MaxMovingLagSec, imageFramePeriodSec, bestCorrelationValue, bestCorrelationTimeOffset, bestCorrelationNormalizationFactor, corrTimeOffsets, corrValues);
   std::deque<double> corrTimeOffsetsFine;
   std::deque<double> corrValuesFine;
-  ComputeCorrelationBetweenFixedAndMovingSignal(bestCorrelationTimeOffset - searchRangeFineStep, bestCorrelationTimeOffset + searchRangeFineStep, this->SamplingResolutionSec, bestCorrelationValue, bestCorrelationTimeOffset, bestCorrelationNormalizationFactor, corrTimeOffsetsFine, corrValuesFine);
+  FindBestTimeOffset(imageFramePeriodSec, bestCorrelationValue, bestCorrelationTimeOffset, bestCorrelationNormalizationFactor, corrTimeOffsets, corrValues, corrTimeOffsetsFine, corrValuesFine);
   LOG_DEBUG("Time offset with sign convention #1: " << bestCorrelationTimeOffset);
 
   //  Compute cross correlation with sign convention #2
@@ -724,24 +958,15 @@ PlusStatus vtkPlusTemporalCalibrationAlgo::ComputeMovingSignalLagSec(TEMPORAL_CA
   double bestCorrelationNormalizationFactorInvertedTracker(1.0);
   std::deque<double> corrTimeOffsetsInvertedTracker;
   std::deque<double> corrValuesInvertedTracker;
-  ComputeCorrelationBetweenFixedAndMovingSignal(
-    -this->MaxMovingLagSec,
-    this->MaxMovingLagSec,
+  std::deque<double> corrTimeOffsetsInvertedTrackerFine;
+  std::deque<double> corrValuesInvertedTrackerFine;
+  FindBestTimeOffset(
     imageFramePeriodSec,
     bestCorrelationValueInvertedTracker,
     bestCorrelationTimeOffsetInvertedTracker,
     bestCorrelationNormalizationFactorInvertedTracker,
     corrTimeOffsetsInvertedTracker,
-    corrValuesInvertedTracker
-  );
-  std::deque<double> corrTimeOffsetsInvertedTrackerFine;
-  std::deque<double> corrValuesInvertedTrackerFine;
-  ComputeCorrelationBetweenFixedAndMovingSignal(
-    bestCorrelationTimeOffsetInvertedTracker - searchRangeFineStep,
-    bestCorrelationTimeOffsetInvertedTracker + searchRangeFineStep,
-    this->SamplingResolutionSec, bestCorrelationValueInvertedTracker,
-    bestCorrelationTimeOffsetInvertedTracker,
-    bestCorrelationNormalizationFactorInvertedTracker,
+    corrValuesInvertedTracker,
     corrTimeOffsetsInvertedTrackerFine,
     corrValuesInvertedTrackerFine
   );
@@ -894,6 +1119,7 @@ PlusStatus vtkPlusTemporalCalibrationAlgo::ReadConfiguration(vtkXMLDataElement*
   }
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(SaveIntermediateImages, calibrationParameters);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, MaximumMovingLagSec, calibrationParameters);
+  XML_READ_ENUM2_ATTRIBUTE_OPTIONAL(LagSearchMethod, calibrationParameters, "SWEEP", LAG_SEARCH_METHOD_SWEEP, "FFT", LAG_SEARCH_METHOD_FFT);
 
   if (calibrationParameters != NULL)
   {
@@ -11,6 +11,7 @@
 #include "vtkPlusCalibrationExport.h"
 
 #include <deque>
+#include <vector>
 
 #include "vtkObject.h"
 
@@ -62,6 +63,12 @@ public:
     // (e.g., bottom of water tank)
   };
 
+  enum LAG_SEARCH_METHOD
+  {
+    LAG_SEARCH_METHOD_SWEEP, // The alignment metric is computed for each time offset (with the frame period, then around the best offset with the sampling resolution)
+    LAG_SEARCH_METHOD_FFT    // The alignment metric is computed for all time offsets at once by FFT-based cross-correlation, then the peak is refined
+  };
+
   struct SignalType
   {
     vtkIGSIOTrackedFrameList* frameList;
@@ -105,6 +112,14 @@ public:
   /*! Sets the maximum allowable time lag between the corresponding tracker and video frames. Default is 2 seconds */
   void SetMaximumMovingLagSec(double maxLagSec);
 
+  /*!
+    Sets how the time offset with the best alignment is searched. Default is LAG_SEARCH_METHOD_SWEEP.
+    LAG_SEARCH_METHOD_FFT resamples both signals once to a uniform grid (with the sampling resolution) and computes the alignment
+    metric for all offsets by cross-correlation, which is much faster for long recordings and large lag ranges.
+  */
+  void SetLagSearchMethod(LAG_SEARCH_METHOD lagSearchMethod);
+  LAG_SEARCH_METHOD GetLagSearchMethod() const;
+
   /*! Enable/disable saving of intermediate images for debugging. Need to call before SetVideoFrames. */
   void SetSaveIntermediateImages(bool saveIntermediateImages);
 
@@ -151,12 +166,32 @@ protected:
   PlusStatus NormalizeMetricValues(std::deque<double>& signal, double& normalizationFactor, double startTime, double stopTime, const std::deque<double>& timestamps);
   void ComputeCorrelationBetweenFixedAndMovingSignal(double minTrackerLagSec, double maxTrackerLagSec, double stepSizeSec, double& bestCorrelationValue, double& bestCorrelationTimeOffset, double& bestCorrelationNormalizationFactor, std::deque<double>& corrTimeOffsets, std::deque<double>& corrValues);
 
+  /*!
+    Compute the alignment metric between the fixed and moving signal for all time offsets in [-maxTrackerLagSec, maxTrackerLagSec]
+    (with SamplingResolutionSec steps) by FFT-based cross-correlation of the uniformly resampled signals.
+    The best time offset is refined to sub-sample accuracy by fitting a parabola to the metric values around the peak.
+  */
+  PlusStatus ComputeCorrelationBetweenFixedAndMovingSignalFft(double maxTrackerLagSec, double& bestCorrelationTimeOffset, std::deque<double>& corrTimeOffsets, std::deque<double>& corrValues);
+
+  /*!
+    Find the time offset with the best alignment metric for the current sign convention of the moving signal, using the selected lag search method.
+    \param coarseStepSec Step size of the coarse search (the fine search is performed in the +/-3 coarse step range around the coarse optimum)
+  */
+  void FindBestTimeOffset(double coarseStepSec, double& bestCorrelationValue, double& bestCorrelationTimeOffset, double& bestCorrelationNormalizationFactor,
+                          std::deque<double>& corrTimeOffsets, std::deque<double>& corrValues, std::deque<double>& corrTimeOffsetsFine, std::deque<double>& corrValuesFine);
+
   double ComputeAlignmentMetric(const std::deque<double>& signalA, const std::deque<double>& signalB);
 
   PlusStatus ConstructTableSignal(std::deque<double>& x, std::deque<double>& y, vtkTable* table, double timeCorrection);
 
   PlusStatus ResampleSignalLinearly(const std::deque<double>& templateSignalTimestamps, const vtkSmartPointer<vtkPiecewiseFunction>& signalFunction, std::deque<double>& resampledSignalValues);
 
+  /*!
+    Resample a signal at uniformly spaced time points (startTime + i*stepSec) by linear interpolation. Values outside the signal time range
+    are clamped to the first/last value (same as vtkPiecewiseFunction does). Timestamps must be in increasing order.
+  */
+  static void ResampleSignalUniformly(const std::deque<double>& signalTimestamps, const std::deque<double>& signalValues, double startTime, double stepSec, int numberOfSamples, std::vector<double>& resampledSignalValues);
+
 protected:
   SignalType FixedSignal;
   SignalType MovingSignal;
@@ -174,6 +209,9 @@ protected:
   /*! Resolution used for re-sampling [s]*/
   double SamplingResolutionSec;
 
+  /*! Method used for finding the time offset with the best alignment */
+  LAG_SEARCH_METHOD LagSearchMethod;
+
   /*! The computed signal correlation values (corresponding to the better sign convention) */
   std::deque<double> CorrelationValues;
   /*! The time-offsets used to compute the correlations */
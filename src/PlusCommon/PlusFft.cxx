@@ -0,0 +1,147 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusFft.h"
+
+#include "vtkMath.h"
+
+#include <cmath>
+
+//----------------------------------------------------------------------------
+PlusFft::PlusFft()
+  : Size(0)
+{
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusFft::SetSize(unsigned int size)
+{
+  if (size == this->Size)
+  {
+    // plan is already prepared for this size
+    return PLUS_SUCCESS;
+  }
+  if (size == 0 || (size & (size - 1)) != 0)
+  {
+    LOG_ERROR("FFT size must be a power of two, requested size: " << size);
+    return PLUS_FAIL;
+  }
+
+  this->Size = size;
+
+  unsigned int numberOfBits = 0;
+  while ((1u << numberOfBits) < size)
+  {
+    numberOfBits++;
+  }
+  this->BitReversalSwaps.clear();
+  for (unsigned int i = 0; i < size; ++i)
+  {
+    unsigned int reversed = 0;
+    for (unsigned int bit = 0; bit < numberOfBits; ++bit)
+    {
+      reversed |= ((i >> bit) & 1u) << (numberOfBits - 1 - bit);
+    }
+    if (i < reversed)
+    {
+      this->BitReversalSwaps.push_back(std::make_pair(i, reversed));
+    }
+  }
+
+  this->TwiddleReal.resize(size > 1 ? size - 1 : 0);
+  this->TwiddleImag.resize(size > 1 ? size - 1 : 0);
+  for (unsigned int halfLength = 1; halfLength < size; halfLength <<= 1)
+  {
+    for (unsigned int k = 0; k < halfLength; ++k)
+    {
+      double angle = -vtkMath::Pi() * k / halfLength;
+      this->TwiddleReal[halfLength - 1 + k] = cos(angle);
+      this->TwiddleImag[halfLength - 1 + k] = sin(angle);
+    }
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+unsigned int PlusFft::GetNextPowerOfTwo(unsigned int n)
+{
+  unsigned int powerOfTwo = 1;
+  while (powerOfTwo < n)
+  {
+    powerOfTwo <<= 1;
+  }
+  return powerOfTwo;
+}
+
+//----------------------------------------------------------------------------
+void PlusFft::Forward(ComplexType* data) const
+{
+  Transform(data, false);
+}
+
+//----------------------------------------------------------------------------
+void PlusFft::Inverse(ComplexType* data) const
+{
+  Transform(data, true);
+  const double scale = 1.0 / this->Size;
+  for (unsigned int i = 0; i < this->Size; ++i)
+  {
+    data[i] *= scale;
+  }
+}
+
+//----------------------------------------------------------------------------
+void PlusFft::Transform(ComplexType* data, bool inverse) const
+{
+  for (std::vector< std::pair<unsigned int, unsigned int> >::const_iterator swapIt = this->BitReversalSwaps.begin(); swapIt != this->BitReversalSwaps.end(); ++swapIt)
+  {
+    std::swap(data[swapIt->first], data[swapIt->second]);
+  }
+
+  // std::complex is layout-compatible with double[2], butterflies are computed on the components
+  // to avoid the overhead of the standard complex multiplication (NaN/infinity handling)
+  double* values = reinterpret_cast<double*>(data);
+  const double imagSign = (inverse ? -1.0 : 1.0);
+
+  // First stage: all twiddle factors are 1
+  for (unsigned int start = 0; start + 1 < this->Size; start += 2)
+  {
+    double* even = values + 2 * start;
+    double* odd = even + 2;
+    const double tr = odd[0];
+    const double ti = odd[1];
+    odd[0] = even[0] - tr;
+    odd[1] = even[1] - ti;
+    even[0] += tr;
+    even[1] += ti;
+  }
+
+  for (unsigned int halfLength = 2; halfLength < this->Size; halfLength <<= 1)
+  {
+    const double* twiddleReal = &this->TwiddleReal[halfLength - 1];
+    const double* twiddleImag = &this->TwiddleImag[halfLength - 1];
+    for (unsigned int start = 0; start < this->Size; start += 2 * halfLength)
+    {
+      double* evenValues = values + 2 * start;
+      double* oddValues = evenValues + 2 * halfLength;
+      for (unsigned int k = 0; k < halfLength; ++k)
+      {
+        const double wr = twiddleReal[k];
+        const double wi = imagSign * twiddleImag[k];
+        double* even = evenValues + 2 * k;
+        double* odd = oddValues + 2 * k;
+        const double tr = wr * odd[0] - wi * odd[1];
+        const double ti = wr * odd[1] + wi * odd[0];
+        odd[0] = even[0] - tr;
+        odd[1] = even[1] - ti;
+        even[0] += tr;
+        even[1] += ti;
+      }
+    }
+  }
+}
@@ -0,0 +1,70 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PLUSFFT_H
+#define __PLUSFFT_H
+
+#include "PlusConfigure.h"
+#include "vtkPlusCommonExport.h"
+
+#include <complex>
+#include <vector>
+
+/*!
+  \class PlusFft
+  \brief Fast Fourier transform of complex signals
+
+  Radix-2 decimation-in-time transform. The twiddle factors and the bit reversal permutation
+  are computed once for a transform size (the plan) and reused for all subsequent transforms
+  of the same size. Transforms do not modify the plan, so a plan can be shared by multiple
+  threads as long as its size is not changed while transforms are running.
+
+  Two real signals can be transformed with one complex transform by storing one of them
+  in the real part and the other in the imaginary part of the input.
+
+  \ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport PlusFft
+{
+public:
+  typedef std::complex<double> ComplexType;
+
+  PlusFft();
+
+  /*!
+    Prepare the plan for transforms of the specified size. The plan is kept if the size is not changed.
+    \param size Number of samples in the transformed signals, must be a power of two
+  */
+  PlusStatus SetSize(unsigned int size);
+  unsigned int GetSize() const { return this->Size; }
+
+  /*! In-place forward transform of GetSize() samples. The result is not scaled. */
+  void Forward(ComplexType* data) const;
+
+  /*! In-place inverse transform of GetSize() samples. The result is scaled by 1/GetSize(), so Inverse(Forward(x))=x. */
+  void Inverse(ComplexType* data) const;
+
+  /*! Returns the smallest power of two that is greater than or equal to n (minimum 1) */
+  static unsigned int GetNextPowerOfTwo(unsigned int n);
+
+protected:
+  void Transform(ComplexType* data, bool inverse) const;
+
+  unsigned int Size;
+
+  /*! Index pairs that are swapped by the bit reversal permutation */
+  std::vector< std::pair<unsigned int, unsigned int> > BitReversalSwaps;
+
+  /*!
+    Twiddle factors of all butterfly stages, stored contiguously for each stage to allow sequential access:
+    for the stage with half-length h the factors exp(-pi*i*k/h), k=0..h-1 start at index h-1.
+    Stored as separate real and imaginary arrays.
+  */
+  std::vector<double> TwiddleReal;
+  std::vector<double> TwiddleImag;
+};
+
+#endif
@@ -0,0 +1,318 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusSignalLagEstimator.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+  /*! Tolerance (relative to the sampling resolution) for deciding if a timestamp is on a grid point */
+  const double GRID_TIMESTAMP_TOLERANCE = 1e-6;
+}
+
+//----------------------------------------------------------------------------
+PlusSignalLagEstimator::ResampledSignal::ResampledSignal()
+{
+  this->Clear();
+}
+
+//----------------------------------------------------------------------------
+void PlusSignalLagEstimator::ResampledSignal::Clear()
+{
+  this->HasSample = false;
+  this->LastTimestamp = 0.0;
+  this->LastValue = 0.0;
+  this->NextGridIndex = 0;
+  this->QueuedValues.clear();
+  this->FirstQueuedGridIndex = 0;
+}
+
+//----------------------------------------------------------------------------
+PlusSignalLagEstimator::PlusSignalLagEstimator()
+  : SamplingResolutionSec(0.01)
+  , MemoryTimeSec(20.0)
+  , MaximumLagSteps(100)
+  , ForgettingFactor(1.0)
+  , GridOriginDefined(false)
+  , GridOriginTimestamp(0.0)
+  , FixedReferenceValue(0.0)
+  , MovingReferenceValue(0.0)
+  , NumberOfPairedSamples(0)
+  , SumWeights(0.0)
+  , SumFixed(0.0)
+  , SumFixedSquared(0.0)
+{
+  this->SetParameters(this->SamplingResolutionSec, this->MaximumLagSteps * this->SamplingResolutionSec, this->MemoryTimeSec);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusSignalLagEstimator::SetParameters(double samplingResolutionSec, double maximumLagSec, double memoryTimeSec)
+{
+  if (samplingResolutionSec <= 0 || maximumLagSec < samplingResolutionSec || memoryTimeSec <= 0)
+  {
+    LOG_ERROR("Invalid lag estimation parameters: sampling resolution = " << samplingResolutionSec << " sec, maximum lag = " << maximumLagSec
+              << " sec, memory time = " << memoryTimeSec << " sec. All values must be positive and the maximum lag must not be smaller than the sampling resolution.");
+    return PLUS_FAIL;
+  }
+
+  this->SamplingResolutionSec = samplingResolutionSec;
+  this->MemoryTimeSec = memoryTimeSec;
+  this->MaximumLagSteps = static_cast<int>(std::floor(maximumLagSec / samplingResolutionSec + GRID_TIMESTAMP_TOLERANCE));
+  this->ForgettingFactor = std::exp(-samplingResolutionSec / memoryTimeSec);
+
+  int numberOfLags = 2 * this->MaximumLagSteps + 1;
+  this->FixedHistory.resize(numberOfLags);
+  this->MovingHistory.resize(numberOfLags);
+  this->SumMoving.resize(numberOfLags);
+  this->SumMovingSquared.resize(numberOfLags);
+  this->SumProduct.resize(numberOfLags);
+
+  this->Reset();
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void PlusSignalLagEstimator::Reset()
+{
+  this->GridOriginDefined = false;
+  this->GridOriginTimestamp = 0.0;
+  this->FixedSignal.Clear();
+  this->MovingSignal.Clear();
+  this->FixedReferenceValue = 0.0;
+  this->MovingReferenceValue = 0.0;
+  std::fill(this->FixedHistory.begin(), this->FixedHistory.end(), 0.0);
+  std::fill(this->MovingHistory.begin(), this->MovingHistory.end(), 0.0);
+  this->NumberOfPairedSamples = 0;
+  this->SumWeights = 0.0;
+  this->SumFixed = 0.0;
+  this->SumFixedSquared = 0.0;
+  std::fill(this->SumMoving.begin(), this->SumMoving.end(), 0.0);
+  std::fill(this->SumMovingSquared.begin(), this->SumMovingSquared.end(), 0.0);
+  std::fill(this->SumProduct.begin(), this->SumProduct.end(), 0.0);
+}
+
+//----------------------------------------------------------------------------
+void PlusSignalLagEstimator::AddFixedSample(double timestamp, double value)
+{
+  this->AddSample(this->FixedSignal, timestamp, value);
+}
+
+//----------------------------------------------------------------------------
+void PlusSignalLagEstimator::AddMovingSample(double timestamp, double value)
+{
+  this->AddSample(this->MovingSignal, timestamp, value);
+}
+
+//----------------------------------------------------------------------------
+void PlusSignalLagEstimator::AddSample(ResampledSignal& signal, double timestamp, double value)
+{
+  if (signal.HasSample && timestamp <= signal.LastTimestamp)
+  {
+    return;
+  }
+  if (!this->GridOriginDefined)
+  {
+    this->GridOriginTimestamp = timestamp;
+    this->GridOriginDefined = true;
+  }
+
+  if (!signal.HasSample)
+  {
+    // The first grid point of the signal is the first one that is not earlier than the first sample
+    signal.NextGridIndex = static_cast<long long>(std::ceil((timestamp - this->GridOriginTimestamp) / this->SamplingResolutionSec - GRID_TIMESTAMP_TOLERANCE));
+  }
+
+  const double gridTimestampTolerance = GRID_TIMESTAMP_TOLERANCE * this->SamplingResolutionSec;
+  for (;;)
+  {
+    double gridTimestamp = this->GridOriginTimestamp + signal.NextGridIndex * this->SamplingResolutionSec;
+    if (gridTimestamp > timestamp + gridTimestampTolerance)
+    {
+      break;
+    }
+    double gridValue = value;
+    if (signal.HasSample && gridTimestamp < timestamp)
+    {
+      gridValue = signal.LastValue + (value - signal.LastValue) * (gridTimestamp - signal.LastTimestamp) / (timestamp - signal.LastTimestamp);
+    }
+    if (signal.QueuedValues.empty())
+    {
+      signal.FirstQueuedGridIndex = signal.NextGridIndex;
+    }
+    signal.QueuedValues.push_back(gridValue);
+    signal.NextGridIndex++;
+  }
+  signal.HasSample = true;
+  signal.LastTimestamp = timestamp;
+  signal.LastValue = value;
+
+  // If the other signal stopped then old values would be queued forever, keep only the ones that may still get paired
+  size_t maximumNumberOfQueuedValues = std::max<size_t>(this->FixedHistory.size(), static_cast<size_t>(std::ceil(this->MemoryTimeSec / this->SamplingResolutionSec)));
+  while (signal.QueuedValues.size() > maximumNumberOfQueuedValues)
+  {
+    signal.QueuedValues.pop_front();
+    signal.FirstQueuedGridIndex++;
+  }
+
+  this->ProcessPairedSamples();
+}
+
+//----------------------------------------------------------------------------
+void PlusSignalLagEstimator::ProcessPairedSamples()
+{
+  while (!this->FixedSignal.QueuedValues.empty() && !this->MovingSignal.QueuedValues.empty())
+  {
+    if (this->FixedSignal.FirstQueuedGridIndex < this->MovingSignal.FirstQueuedGridIndex)
+    {
+      this->FixedSignal.QueuedValues.pop_front();
+      this->FixedSignal.FirstQueuedGridIndex++;
+      continue;
+    }
+    if (this->MovingSignal.FirstQueuedGridIndex < this->FixedSignal.FirstQueuedGridIndex)
+    {
+      this->MovingSignal.QueuedValues.pop_front();
+      this->MovingSignal.FirstQueuedGridIndex++;
+      continue;
+    }
+    this->UpdateSums(this->FixedSignal.QueuedValues.front(), this->MovingSignal.QueuedValues.front());
+    this->FixedSignal.QueuedValues.pop_front();
+    this->FixedSignal.FirstQueuedGridIndex++;
+    this->MovingSignal.QueuedValues.pop_front();
+    this->MovingSignal.FirstQueuedGridIndex++;
+  }
+}
+
+//----------------------------------------------------------------------------
+void PlusSignalLagEstimator::UpdateSums(double fixedValue, double movingValue)
+{
+  if (this->NumberOfPairedSamples == 0)
+  {
+    this->FixedReferenceValue = fixedValue;
+    this->MovingReferenceValue = movingValue;
+  }
+
+  const int numberOfLags = static_cast<int>(this->FixedHistory.size());
+  int newestPosition = static_cast<int>(this->NumberOfPairedSamples % numberOfLags);
+  this->FixedHistory[newestPosition] = fixedValue - this->FixedReferenceValue;
+  this->MovingHistory[newestPosition] = movingValue - this->MovingReferenceValue;
+  this->NumberOfPairedSamples++;
+  if (this->NumberOfPairedSamples < numberOfLags)
+  {
+    // Not enough moving samples yet for pairing the fixed sample with all the lags
+    return;
+  }
+
+  // The newest pair belongs to grid point n. The fixed sample of grid point n-K (K = MaximumLagSteps) is paired with
+  // moving samples of grid points n-2K ... n (lag index j: n-2K+j, lag = (j-K) * resolution).
+  // With ring buffer size 2K+1, grid point n-2K is stored at the position after the newest one.
+  int oldestPosition = (newestPosition + 1) % numberOfLags;
+  double fixed = this->FixedHistory[(oldestPosition + this->MaximumLagSteps) % numberOfLags];
+  const double lambda = this->ForgettingFactor;
+  this->SumWeights = lambda * this->SumWeights + 1.0;
+  this->SumFixed = lambda * this->SumFixed + fixed;
+  this->SumFixedSquared = lambda * this->SumFixedSquared + fixed * fixed;
+
+  const double* movingHistory = &this->MovingHistory[0];
+  double* sumMoving = &this->SumMoving[0];
+  double* sumMovingSquared = &this->SumMovingSquared[0];
+  double* sumProduct = &this->SumProduct[0];
+  // Process the ring buffer in two contiguous parts to avoid computing the modulo for each lag
+  int numberOfLagsBeforeWrap = numberOfLags - oldestPosition;
+  for (int part = 0; part < 2; ++part)
+  {
+    int firstLag = (part == 0 ? 0 : numberOfLagsBeforeWrap);
+    int lastLag = (part == 0 ? numberOfLagsBeforeWrap : numberOfLags);
+    int historyOffset = (part == 0 ? oldestPosition : oldestPosition - numberOfLags);
+    for (int j = firstLag; j < lastLag; ++j)
+    {
+      double movingValueAtLag = movingHistory[j + historyOffset];
+      sumMoving[j] = lambda * sumMoving[j] + movingValueAtLag;
+      sumMovingSquared[j] = lambda * sumMovingSquared[j] + movingValueAtLag * movingValueAtLag;
+      sumProduct[j] = lambda * sumProduct[j] + fixed * movingValueAtLag;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+double PlusSignalLagEstimator::GetCorrelation(int lagIndex) const
+{
+  double fixedVariance = this->SumWeights * this->SumFixedSquared - this->SumFixed * this->SumFixed;
+  double movingVariance = this->SumWeights * this->SumMovingSquared[lagIndex] - this->SumMoving[lagIndex] * this->SumMoving[lagIndex];
+  if (fixedVariance <= 0 || movingVariance <= 0)
+  {
+    return 0.0;
+  }
+  double covariance = this->SumWeights * this->SumProduct[lagIndex] - this->SumFixed * this->SumMoving[lagIndex];
+  return covariance / std::sqrt(fixedVariance * movingVariance);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusSignalLagEstimator::GetLag(double& lagSec, double& correlation) const
+{
+  const int numberOfLags = static_cast<int>(this->FixedHistory.size());
+  if (this->NumberOfPairedSamples < numberOfLags)
+  {
+    return PLUS_FAIL;
+  }
+
+  // Variances are computed from differences of large sums, consider a signal constant if its variance is at the rounding error level
+  const double relativeVarianceTolerance = 1e-12;
+  double fixedVariance = this->SumWeights * this->SumFixedSquared - this->SumFixed * this->SumFixed;
+  if (fixedVariance <= relativeVarianceTolerance * this->SumWeights * this->SumFixedSquared)
+  {
+    return PLUS_FAIL;
+  }
+
+  std::vector<double> absCorrelations(numberOfLags, 0.0);
+  int bestLagIndex = -1;
+  for (int j = 0; j < numberOfLags; ++j)
+  {
+    double movingVariance = this->SumWeights * this->SumMovingSquared[j] - this->SumMoving[j] * this->SumMoving[j];
+    if (movingVariance <= relativeVarianceTolerance * this->SumWeights * this->SumMovingSquared[j])
+    {
+      continue;
+    }
+    absCorrelations[j] = std::fabs(this->GetCorrelation(j));
+    if (bestLagIndex < 0 || absCorrelations[j] > absCorrelations[bestLagIndex])
+    {
+      bestLagIndex = j;
+    }
+  }
+  if (bestLagIndex < 0)
+  {
+    return PLUS_FAIL;
+  }
+
+  lagSec = (bestLagIndex - this->MaximumLagSteps) * this->SamplingResolutionSec;
+  if (bestLagIndex == 0 || bestLagIndex == numberOfLags - 1)
+  {
+    // The correlation may increase further outside the search range, the peak is not found
+    correlation = 0.0;
+    return PLUS_SUCCESS;
+  }
+
+  correlation = std::min(absCorrelations[bestLagIndex], 1.0);
+  double before = absCorrelations[bestLagIndex - 1];
+  double peak = absCorrelations[bestLagIndex];
+  double after = absCorrelations[bestLagIndex + 1];
+  double curvature = before - 2.0 * peak + after;
+  if (curvature < 0)
+  {
+    double peakOffset = 0.5 * (before - after) / curvature;
+    lagSec += std::max(-0.5, std::min(0.5, peakOffset)) * this->SamplingResolutionSec;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+double PlusSignalLagEstimator::GetPairedSignalDurationSec() const
+{
+  long long numberOfSummedSamples = this->NumberOfPairedSamples - static_cast<long long>(this->FixedHistory.size()) + 1;
+  return std::max<long long>(numberOfSummedSamples, 0) * this->SamplingResolutionSec;
+}
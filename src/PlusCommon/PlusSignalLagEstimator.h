@@ -0,0 +1,127 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PLUSSIGNALLAGESTIMATOR_H
+#define __PLUSSIGNALLAGESTIMATOR_H
+
+#include "PlusConfigure.h"
+#include "vtkPlusCommonExport.h"
+
+#include <deque>
+#include <vector>
+
+/*!
+  \class PlusSignalLagEstimator
+  \brief Incremental estimation of the time lag between two streamed scalar signals
+
+  Samples of the fixed and the moving signal can be added in any order and at any (irregular) rate.
+  Both signals are linearly resampled onto a common uniform time grid with the sampling resolution.
+  For each time offset in [-MaximumLagSec, MaximumLagSec] (with the sampling resolution as step size)
+  exponentially weighted sums of the paired fixed and moving samples are kept, from which the Pearson
+  correlation of the signals at that offset can be computed. Older samples are forgotten with the
+  memory time constant, so the estimate follows slow changes of the lag.
+
+  Adding a sample costs O(number of offsets), independently of the length of the signal history,
+  so the estimator can be updated at the acquisition rate.
+
+  \ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport PlusSignalLagEstimator
+{
+public:
+  PlusSignalLagEstimator();
+
+  /*!
+    Set the estimation parameters and clear all stored samples
+    \param samplingResolutionSec Time step of the resampled signals and the resolution of the lag search
+    \param maximumLagSec Maximum absolute value of the searched lag
+    \param memoryTimeSec Time constant of the exponential forgetting of old samples
+  */
+  PlusStatus SetParameters(double samplingResolutionSec, double maximumLagSec, double memoryTimeSec);
+  double GetSamplingResolutionSec() const { return this->SamplingResolutionSec; }
+  double GetMaximumLagSec() const { return this->MaximumLagSteps * this->SamplingResolutionSec; }
+  double GetMemoryTimeSec() const { return this->MemoryTimeSec; }
+
+  /*! Remove all stored samples (parameters are kept) */
+  void Reset();
+
+  /*! Add a sample of the fixed signal. Samples that are not newer than the previous sample are ignored. */
+  void AddFixedSample(double timestamp, double value);
+
+  /*! Add a sample of the moving signal. Samples that are not newer than the previous sample are ignored. */
+  void AddMovingSample(double timestamp, double value);
+
+  /*!
+    Get the current lag estimate
+    \param lagSec Time [s] by which the moving signal lags the fixed signal: fixed(t) ~ moving(t+lag).
+      The value is refined between the sampled offsets by fitting a parabola to the correlation peak.
+    \param correlation Absolute value of the Pearson correlation at the best offset (between 0 and 1).
+      It is 0 if the best offset is at the boundary of the search range (the actual lag may be outside the range).
+    \return PLUS_FAIL if the signals have not been paired for the whole search range yet or any of them is constant
+  */
+  PlusStatus GetLag(double& lagSec, double& correlation) const;
+
+  /*! Duration of the paired signals that contributed to the estimate. Samples older than the memory time have little weight. */
+  double GetPairedSignalDurationSec() const;
+
+protected:
+  /*! Signal resampled onto the common time grid */
+  struct ResampledSignal
+  {
+    ResampledSignal();
+    void Clear();
+
+    bool HasSample;
+    double LastTimestamp;
+    double LastValue;
+    /*! Index of the next grid point that is to be computed */
+    long long NextGridIndex;
+    /*! Resampled values that are not paired yet, the first one belongs to grid point FirstQueuedGridIndex */
+    std::deque<double> QueuedValues;
+    long long FirstQueuedGridIndex;
+  };
+
+  void AddSample(ResampledSignal& signal, double timestamp, double value);
+
+  /*! Pair the queued samples of the fixed and moving signals that belong to the same grid points and update the sums */
+  void ProcessPairedSamples();
+
+  void UpdateSums(double fixedValue, double movingValue);
+
+  double GetCorrelation(int lagIndex) const;
+
+  double SamplingResolutionSec;
+  double MemoryTimeSec;
+  int MaximumLagSteps;
+
+  /*! Weight of the previous sums when a new pair of samples is added */
+  double ForgettingFactor;
+
+  bool GridOriginDefined;
+  double GridOriginTimestamp;
+
+  ResampledSignal FixedSignal;
+  ResampledSignal MovingSignal;
+
+  /*! Values are stored relative to the first paired value to reduce rounding errors in the sums */
+  double FixedReferenceValue;
+  double MovingReferenceValue;
+
+  /*! The last 2*MaximumLagSteps+1 paired samples of each signal (ring buffers) */
+  std::vector<double> FixedHistory;
+  std::vector<double> MovingHistory;
+  long long NumberOfPairedSamples;
+
+  /*! Exponentially weighted sums. Fixed signal sums are common for all lags, moving signal sums are stored for each lag. */
+  double SumWeights;
+  double SumFixed;
+  double SumFixedSquared;
+  std::vector<double> SumMoving;
+  std::vector<double> SumMovingSquared;
+  std::vector<double> SumProduct;
+};
+
+#endif
@@ -0,0 +1,249 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PlusFftTest.cxx
+  \brief Compares the forward transform to the direct computation of the discrete Fourier transform and verifies that
+  the inverse transform restores the original signal for all power of two sizes. Computes the envelope of amplitude
+  modulated sine signals by Hilbert transform, two real signals packed in one complex transform the same way as the
+  RF to brightness conversion does, and compares it to the known modulation.
+*/
+
+#include "PlusConfigure.h"
+#include "PlusFft.h"
+#include "vtksys/CommandLineArguments.hxx"
+
+#include <cmath>
+#include <vector>
+
+namespace
+{
+  const double PI = 3.14159265358979323846;
+  const unsigned int MAX_FFT_SIZE = 4096;
+  const unsigned int MAX_DFT_SIZE = 256;
+  const double TRANSFORM_TOLERANCE = 1e-9;
+  const double ROUND_TRIP_TOLERANCE = 1e-12;
+  const double ENVELOPE_TOLERANCE = 1e-9;
+  const double PADDED_ENVELOPE_TOLERANCE = 0.01;
+
+  //----------------------------------------------------------------------------
+  // Pseudo-random number in [-1, 1], the same on all platforms
+  double GetRandom(unsigned int& seed)
+  {
+    seed = seed * 1103515245 + 12345;
+    return static_cast<double>((seed >> 8) & 0xFFFF) / 32767.5 - 1.0;
+  }
+
+  //----------------------------------------------------------------------------
+  double GetMaxDifference(const std::vector<PlusFft::ComplexType>& first, const std::vector<PlusFft::ComplexType>& second)
+  {
+    double maxDifference = 0;
+    for (size_t i = 0; i < first.size(); ++i)
+    {
+      maxDifference = std::max(maxDifference, std::abs(first[i] - second[i]));
+    }
+    return maxDifference;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestTransform(PlusFft& fft, unsigned int size)
+  {
+    if (fft.SetSize(size) != PLUS_SUCCESS || fft.GetSize() != size)
+    {
+      LOG_ERROR("Failed to set FFT size " << size);
+      return 1;
+    }
+
+    unsigned int seed = size;
+    std::vector<PlusFft::ComplexType> signal(size);
+    for (unsigned int i = 0; i < size; ++i)
+    {
+      signal[i] = PlusFft::ComplexType(GetRandom(seed), GetRandom(seed));
+    }
+
+    int numberOfErrors = 0;
+    std::vector<PlusFft::ComplexType> transformed(signal);
+    fft.Forward(&transformed[0]);
+    if (size <= MAX_DFT_SIZE)
+    {
+      std::vector<PlusFft::ComplexType> dft(size);
+      for (unsigned int k = 0; k < size; ++k)
+      {
+        for (unsigned int n = 0; n < size; ++n)
+        {
+          // The index product is reduced modulo size to keep the angle accurate
+          double angle = -2 * PI * ((k * n) % size) / size;
+          dft[k] += signal[n] * PlusFft::ComplexType(cos(angle), sin(angle));
+        }
+      }
+      double maxDifference = GetMaxDifference(transformed, dft);
+      if (!(maxDifference <= TRANSFORM_TOLERANCE))
+      {
+        LOG_ERROR("Forward transform of size " << size << " differs from the discrete Fourier transform by " << maxDifference);
+        numberOfErrors++;
+      }
+    }
+
+    fft.Inverse(&transformed[0]);
+    double maxDifference = GetMaxDifference(transformed, signal);
+    if (!(maxDifference <= ROUND_TRIP_TOLERANCE))
+    {
+      LOG_ERROR("Inverse of the forward transform of size " << size << " differs from the original signal by " << maxDifference);
+      numberOfErrors++;
+    }
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  // Carrier with the specified frequency (cycles per sample), modulated by a slowly changing envelope
+  void GenerateModulatedSine(std::vector<double>& signal, std::vector<double>& envelope, int numberOfSamples, double carrierFrequency, double modulationFrequency, double phase)
+  {
+    signal.resize(numberOfSamples);
+    envelope.resize(numberOfSamples);
+    for (int i = 0; i < numberOfSamples; ++i)
+    {
+      envelope[i] = 1.0 + 0.5 * cos(2 * PI * modulationFrequency * i + phase);
+      signal[i] = envelope[i] * cos(2 * PI * carrierFrequency * i + phase);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Envelope of two real signals: the first signal is in the real part, the second signal is in the imaginary part
+  // of the transformed data. The Hilbert transform maps real signals to real signals, so they remain separated.
+  void ComputeEnvelopes(const PlusFft& fft, const std::vector<double>& firstSignal, const std::vector<double>& secondSignal, std::vector<double>& firstEnvelope, std::vector<double>& secondEnvelope)
+  {
+    const unsigned int fftSize = fft.GetSize();
+    std::vector<PlusFft::ComplexType> buffer(fftSize, 0.0);
+    for (size_t i = 0; i < firstSignal.size(); ++i)
+    {
+      buffer[i] = PlusFft::ComplexType(firstSignal[i], secondSignal[i]);
+    }
+
+    fft.Forward(&buffer[0]);
+    buffer[0] = 0.0;
+    buffer[fftSize / 2] = 0.0;
+    for (unsigned int k = 1; k < fftSize / 2; ++k)
+    {
+      buffer[k] = PlusFft::ComplexType(buffer[k].imag(), -buffer[k].real());
+      buffer[fftSize - k] = PlusFft::ComplexType(-buffer[fftSize - k].imag(), buffer[fftSize - k].real());
+    }
+    fft.Inverse(&buffer[0]);
+
+    firstEnvelope.resize(firstSignal.size());
+    secondEnvelope.resize(secondSignal.size());
+    for (size_t i = 0; i < firstSignal.size(); ++i)
+    {
+      firstEnvelope[i] = sqrt(firstSignal[i] * firstSignal[i] + buffer[i].real() * buffer[i].real());
+      secondEnvelope[i] = sqrt(secondSignal[i] * secondSignal[i] + buffer[i].imag() * buffer[i].imag());
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  int VerifyEnvelope(const std::vector<double>& envelope, const std::vector<double>& expectedEnvelope, int firstSample, int lastSample, double tolerance, const char* description)
+  {
+    double maxDifference = 0;
+    for (int i = firstSample; i <= lastSample; ++i)
+    {
+      maxDifference = std::max(maxDifference, fabs(envelope[i] - expectedEnvelope[i]));
+    }
+    if (!(maxDifference <= tolerance))
+    {
+      LOG_ERROR(description << ": envelope differs from the modulation by " << maxDifference);
+      return 1;
+    }
+    return 0;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestHilbertEnvelope(PlusFft& fft)
+  {
+    int numberOfErrors = 0;
+    std::vector<double> firstSignal, firstExpectedEnvelope, firstEnvelope;
+    std::vector<double> secondSignal, secondExpectedEnvelope, secondEnvelope;
+
+    // Signals are periodic in the transform size: the envelope is exact
+    const int fftSize = 1024;
+    fft.SetSize(fftSize);
+    GenerateModulatedSine(firstSignal, firstExpectedEnvelope, fftSize, 100.0 / fftSize, 3.0 / fftSize, 0.3);
+    GenerateModulatedSine(secondSignal, secondExpectedEnvelope, fftSize, 170.0 / fftSize, 5.0 / fftSize, 1.2);
+    ComputeEnvelopes(fft, firstSignal, secondSignal, firstEnvelope, secondEnvelope);
+    numberOfErrors += VerifyEnvelope(firstEnvelope, firstExpectedEnvelope, 0, fftSize - 1, ENVELOPE_TOLERANCE, "Periodic first signal");
+    numberOfErrors += VerifyEnvelope(secondEnvelope, secondExpectedEnvelope, 0, fftSize - 1, ENVELOPE_TOLERANCE, "Periodic second signal");
+
+    // Scanline that is zero padded to the next power of two: the envelope is only approximate near the ends
+    const int numberOfSamples = 900;
+    fft.SetSize(PlusFft::GetNextPowerOfTwo(numberOfSamples));
+    GenerateModulatedSine(firstSignal, firstExpectedEnvelope, numberOfSamples, 0.1, 0.002, 0.0);
+    GenerateModulatedSine(secondSignal, secondExpectedEnvelope, numberOfSamples, 0.23, 0.004, 2.0);
+    ComputeEnvelopes(fft, firstSignal, secondSignal, firstEnvelope, secondEnvelope);
+    numberOfErrors += VerifyEnvelope(firstEnvelope, firstExpectedEnvelope, 100, numberOfSamples - 101, PADDED_ENVELOPE_TOLERANCE, "Zero padded first signal");
+    numberOfErrors += VerifyEnvelope(secondEnvelope, secondExpectedEnvelope, 100, numberOfSamples - 101, PADDED_ENVELOPE_TOLERANCE, "Zero padded second signal");
+
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "\n\nPlusFftTest help:" << args.GetHelp() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (printHelp)
+  {
+    std::cout << "\n\nPlusFftTest help:" << args.GetHelp() << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  int numberOfErrors = 0;
+
+  const unsigned int nextPowerOfTwoInputs[] = { 0, 1, 2, 5, 1024, 1025 };
+  const unsigned int nextPowerOfTwoOutputs[] = { 1, 1, 2, 8, 1024, 2048 };
+  for (unsigned int i = 0; i < sizeof(nextPowerOfTwoInputs) / sizeof(nextPowerOfTwoInputs[0]); ++i)
+  {
+    if (PlusFft::GetNextPowerOfTwo(nextPowerOfTwoInputs[i]) != nextPowerOfTwoOutputs[i])
+    {
+      LOG_ERROR("Next power of two of " << nextPowerOfTwoInputs[i] << " is " << PlusFft::GetNextPowerOfTwo(nextPowerOfTwoInputs[i]) << " instead of " << nextPowerOfTwoOutputs[i]);
+      numberOfErrors++;
+    }
+  }
+
+  // The same object is used for all sizes, so the plan is recomputed for each size
+  PlusFft fft;
+  for (unsigned int size = 1; size <= MAX_FFT_SIZE; size *= 2)
+  {
+    numberOfErrors += TestTransform(fft, size);
+  }
+  // Switching back to a smaller size after a larger one
+  numberOfErrors += TestTransform(fft, 16);
+
+  numberOfErrors += TestHilbertEnvelope(fft);
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully.");
+  return EXIT_SUCCESS;
+}
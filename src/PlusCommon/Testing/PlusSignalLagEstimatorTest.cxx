@@ -0,0 +1,189 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PlusSignalLagEstimatorTest.cxx
+  \brief Adds samples of a synthetic signal and a delayed copy of it to the lag estimator at irregular timestamps
+  and different rates, and verifies that the known lag is found. Verifies that after Reset() no estimate is available
+  until enough new samples are added and that a different lag is found then, without any influence of the old samples.
+*/
+
+#include "PlusConfigure.h"
+#include "PlusSignalLagEstimator.h"
+#include "vtksys/CommandLineArguments.hxx"
+
+#include <cmath>
+
+namespace
+{
+  const double SAMPLING_RESOLUTION_SEC = 0.01;
+  const double MAXIMUM_LAG_SEC = 0.5;
+  const double MEMORY_TIME_SEC = 10.0;
+  const double SIGNAL_DURATION_SEC = 20.0;
+  const double LAG_TOLERANCE_SEC = 0.005;
+  const double MINIMUM_CORRELATION = 0.95;
+
+  //----------------------------------------------------------------------------
+  // Pseudo-random number in [0, 1], the same on all platforms
+  double GetRandom(unsigned int& seed)
+  {
+    seed = seed * 1103515245 + 12345;
+    return static_cast<double>((seed >> 8) & 0xFFFF) / 65535.0;
+  }
+
+  //----------------------------------------------------------------------------
+  // Probe motion: sum of sinusoids with incommensurate frequencies, so it is not periodic within the lag search range
+  double GetPosition(double time)
+  {
+    const double pi = 3.14159265358979323846;
+    return 20.0 * sin(2 * pi * 0.31 * time) + 8.0 * sin(2 * pi * 0.83 * time + 0.4) + 3.0 * sin(2 * pi * 1.73 * time + 1.1);
+  }
+
+  //----------------------------------------------------------------------------
+  // Add the fixed signal sampled at about fixedRateHz and the moving signal, which lags the fixed signal by lagSec,
+  // sampled at about movingRateHz. Sample intervals vary randomly by +/-40%.
+  void AddSignals(PlusSignalLagEstimator& estimator, double startTime, double durationSec, double lagSec, double fixedRateHz, double movingRateHz, unsigned int seed)
+  {
+    double fixedTime = startTime;
+    double movingTime = startTime;
+    while (fixedTime < startTime + durationSec || movingTime < startTime + durationSec)
+    {
+      // Samples are added in timestamp order, alternating between the two signals as they would arrive from the devices
+      if (fixedTime <= movingTime)
+      {
+        estimator.AddFixedSample(fixedTime, GetPosition(fixedTime));
+        fixedTime += (0.6 + 0.8 * GetRandom(seed)) / fixedRateHz;
+      }
+      else
+      {
+        // fixed(t) = moving(t + lag)
+        estimator.AddMovingSample(movingTime, GetPosition(movingTime - lagSec));
+        movingTime += (0.6 + 0.8 * GetRandom(seed)) / movingRateHz;
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  int VerifyLag(const PlusSignalLagEstimator& estimator, double expectedLagSec, const std::string& caseName)
+  {
+    double lagSec(0);
+    double correlation(0);
+    if (estimator.GetLag(lagSec, correlation) != PLUS_SUCCESS)
+    {
+      LOG_ERROR(caseName << ": lag is not available");
+      return 1;
+    }
+    int numberOfErrors = 0;
+    if (fabs(lagSec - expectedLagSec) > LAG_TOLERANCE_SEC)
+    {
+      LOG_ERROR(caseName << ": estimated lag is " << lagSec << " sec, expected " << expectedLagSec << " sec");
+      numberOfErrors++;
+    }
+    if (correlation < MINIMUM_CORRELATION)
+    {
+      LOG_ERROR(caseName << ": correlation at the estimated lag is " << correlation << ", expected at least " << MINIMUM_CORRELATION);
+      numberOfErrors++;
+    }
+    LOG_INFO(caseName << ": estimated lag is " << lagSec << " sec (expected: " << expectedLagSec << " sec), correlation: " << correlation);
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "\n\nPlusSignalLagEstimatorTest help:" << args.GetHelp() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (printHelp)
+  {
+    std::cout << "\n\nPlusSignalLagEstimatorTest help:" << args.GetHelp() << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  int numberOfErrors = 0;
+
+  PlusSignalLagEstimator estimator;
+  if (estimator.SetParameters(SAMPLING_RESOLUTION_SEC, MAXIMUM_LAG_SEC, MEMORY_TIME_SEC) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to set lag estimation parameters");
+    return EXIT_FAILURE;
+  }
+
+  double lagSec(0);
+  double correlation(0);
+  if (estimator.GetLag(lagSec, correlation) == PLUS_SUCCESS)
+  {
+    LOG_ERROR("Lag is available before any samples are added");
+    numberOfErrors++;
+  }
+
+  // Known lag that is not a multiple of the sampling resolution, tracker-like and video-like irregular sampling rates
+  const double firstLagSec = 0.137;
+  AddSignals(estimator, 1000.0, SIGNAL_DURATION_SEC, firstLagSec, 60.0, 23.0, 1);
+  numberOfErrors += VerifyLag(estimator, firstLagSec, "Positive lag");
+
+  // Samples with old timestamps are ignored
+  estimator.AddMovingSample(1000.0, 1e6);
+  estimator.AddFixedSample(1000.0, -1e6);
+  numberOfErrors += VerifyLag(estimator, firstLagSec, "Positive lag after adding old samples");
+
+  // After Reset() the old samples must not contribute: no estimate until the search range is filled again,
+  // then the new lag is found (with the old samples the correlation at the old lag would still be high)
+  estimator.Reset();
+  if (estimator.GetLag(lagSec, correlation) == PLUS_SUCCESS || estimator.GetPairedSignalDurationSec() != 0.0)
+  {
+    LOG_ERROR("Lag is available after Reset()");
+    numberOfErrors++;
+  }
+  const double secondLagSec = -0.213;
+  AddSignals(estimator, 500.0, 0.5 * MAXIMUM_LAG_SEC, secondLagSec, 60.0, 23.0, 2);
+  if (estimator.GetLag(lagSec, correlation) == PLUS_SUCCESS)
+  {
+    LOG_ERROR("Lag is available after Reset() before the signals are paired for the whole search range");
+    numberOfErrors++;
+  }
+  AddSignals(estimator, 500.0 + 0.5 * MAXIMUM_LAG_SEC, SIGNAL_DURATION_SEC, secondLagSec, 50.0, 30.0, 3);
+  numberOfErrors += VerifyLag(estimator, secondLagSec, "Negative lag after Reset()");
+
+  // A constant signal has no lag
+  estimator.Reset();
+  for (double time = 0; time < SIGNAL_DURATION_SEC; time += 0.02)
+  {
+    estimator.AddFixedSample(time, GetPosition(time));
+    estimator.AddMovingSample(time, 5.0);
+  }
+  if (estimator.GetLag(lagSec, correlation) == PLUS_SUCCESS)
+  {
+    LOG_ERROR("Lag is available for a constant moving signal: " << lagSec << " sec");
+    numberOfErrors++;
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully.");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,247 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkPlusChunkedSequenceIOTest.cxx
+  \brief Writes a chunked sequence file chunk by chunk and simulates a crash by truncating it inside the last chunk
+  and inside the frame index. Verifies that the complete chunks are read back (the index is rebuilt), that Recover()
+  writes a valid index and that frames with decreasing timestamps are rejected.
+*/
+
+#include "PlusConfigure.h"
+#include "igsioTrackedFrame.h"
+#include "vtkIGSIOTrackedFrameList.h"
+#include "vtkPlusChunkedSequenceIO.h"
+#include "vtksys/CommandLineArguments.hxx"
+#include "vtksys/SystemTools.hxx"
+
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+namespace
+{
+  const int NUMBER_OF_CHUNKS = 5;
+  const int NUMBER_OF_FRAMES_PER_CHUNK = 3;
+  const char FRAME_NUMBER_FIELD_NAME[] = "FrameNumber";
+
+  //----------------------------------------------------------------------------
+  double GetTimestamp(int frameNumber)
+  {
+    return 10.0 + 0.1 * frameNumber;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus AddFrame(vtkIGSIOTrackedFrameList* frameList, int frameNumber, double timestamp)
+  {
+    igsioTrackedFrame frame;
+    FrameSizeType frameSize = {32, 24, 1};
+    if (frame.GetImageData()->AllocateFrame(frameSize, VTK_UNSIGNED_CHAR, 1) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to allocate frame " << frameNumber);
+      return PLUS_FAIL;
+    }
+    unsigned char* pixel = static_cast<unsigned char*>(frame.GetImageData()->GetScalarPointer());
+    for (unsigned long i = 0; i < frame.GetImageData()->GetFrameSizeInBytes(); ++i)
+    {
+      pixel[i] = static_cast<unsigned char>(i * 7 + frameNumber);
+    }
+    std::ostringstream frameNumberStr;
+    frameNumberStr << frameNumber;
+    frame.SetFrameField(FRAME_NUMBER_FIELD_NAME, frameNumberStr.str());
+    frame.SetTimestamp(timestamp);
+    frameList->AddTrackedFrame(&frame);
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  // Copy the first numberOfBytes bytes of the file, as if writing had stopped there
+  PlusStatus WriteTruncatedCopy(const std::string& sourceFilename, const std::string& truncatedFilename, unsigned long numberOfBytes)
+  {
+    std::ifstream source(sourceFilename.c_str(), std::ios::binary);
+    std::string content((std::istreambuf_iterator<char>(source)), std::istreambuf_iterator<char>());
+    if (!source.is_open() || content.size() < numberOfBytes)
+    {
+      LOG_ERROR("Failed to read " << sourceFilename);
+      return PLUS_FAIL;
+    }
+    std::ofstream truncated(truncatedFilename.c_str(), std::ios::binary | std::ios::trunc);
+    truncated.write(content.data(), numberOfBytes);
+    return truncated.good() ? PLUS_SUCCESS : PLUS_FAIL;
+  }
+
+  //----------------------------------------------------------------------------
+  // Verify that the file contains exactly the first expectedNumberOfFrames frames and the index is rebuilt if expected
+  int VerifyFile(const std::string& filename, unsigned int expectedNumberOfFrames, bool expectedIndexRecovered)
+  {
+    vtkSmartPointer<vtkPlusChunkedSequenceIO> reader = vtkSmartPointer<vtkPlusChunkedSequenceIO>::New();
+    if (reader->OpenForReading(filename) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to open " << filename);
+      return 1;
+    }
+    int numberOfErrors = 0;
+    if (reader->GetIndexRecovered() != expectedIndexRecovered)
+    {
+      LOG_ERROR(filename << ": the frame index is " << (reader->GetIndexRecovered() ? "rebuilt" : "read") << ", expected it to be " << (expectedIndexRecovered ? "rebuilt" : "read"));
+      numberOfErrors++;
+    }
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> frameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    if (reader->ReadAllFrames(frameList) != PLUS_SUCCESS)
+    {
+      LOG_ERROR(filename << ": failed to read the frames");
+      reader->Close();
+      return numberOfErrors + 1;
+    }
+    reader->Close();
+    if (frameList->GetNumberOfTrackedFrames() != expectedNumberOfFrames)
+    {
+      LOG_ERROR(filename << ": number of frames is " << frameList->GetNumberOfTrackedFrames() << ", expected " << expectedNumberOfFrames);
+      return numberOfErrors + 1;
+    }
+    for (unsigned int frameNumber = 0; frameNumber < expectedNumberOfFrames; ++frameNumber)
+    {
+      igsioTrackedFrame* frame = frameList->GetTrackedFrame(frameNumber);
+      std::ostringstream frameNumberStr;
+      frameNumberStr << frameNumber;
+      const unsigned char* pixel = static_cast<const unsigned char*>(frame->GetImageData()->GetScalarPointer());
+      if (frame->GetTimestamp() != GetTimestamp(frameNumber) || frame->GetFrameField(FRAME_NUMBER_FIELD_NAME) != frameNumberStr.str()
+          || pixel == NULL || pixel[1] != static_cast<unsigned char>(7 + frameNumber))
+      {
+        LOG_ERROR(filename << ": frame " << frameNumber << " content mismatch");
+        numberOfErrors++;
+      }
+    }
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "\n\nvtkPlusChunkedSequenceIOTest help:" << args.GetHelp() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (printHelp)
+  {
+    std::cout << "\n\nvtkPlusChunkedSequenceIOTest help:" << args.GetHelp() << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  const std::string filename = vtkPlusConfig::GetInstance()->GetOutputPath("ChunkedSequenceIOTest.pseq");
+  const std::string chunkTruncatedFilename = vtkPlusConfig::GetInstance()->GetOutputPath("ChunkedSequenceIOTest_TruncatedChunk.pseq");
+  const std::string indexTruncatedFilename = vtkPlusConfig::GetInstance()->GetOutputPath("ChunkedSequenceIOTest_TruncatedIndex.pseq");
+
+  int numberOfErrors = 0;
+
+  // Write the chunks, the file size is recorded after each chunk (each chunk is flushed to the file)
+  std::vector<unsigned long> chunkEndOffsets;
+  {
+    vtkSmartPointer<vtkPlusChunkedSequenceIO> writer = vtkSmartPointer<vtkPlusChunkedSequenceIO>::New();
+    if (writer->OpenForWriting(filename) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to open " << filename << " for writing");
+      return EXIT_FAILURE;
+    }
+    for (int chunkIndex = 0; chunkIndex < NUMBER_OF_CHUNKS; ++chunkIndex)
+    {
+      vtkSmartPointer<vtkIGSIOTrackedFrameList> frameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+      for (int i = 0; i < NUMBER_OF_FRAMES_PER_CHUNK; ++i)
+      {
+        int frameNumber = chunkIndex * NUMBER_OF_FRAMES_PER_CHUNK + i;
+        if (AddFrame(frameList, frameNumber, GetTimestamp(frameNumber)) != PLUS_SUCCESS)
+        {
+          return EXIT_FAILURE;
+        }
+      }
+      if (writer->AppendFrames(frameList) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to append chunk " << chunkIndex);
+        return EXIT_FAILURE;
+      }
+      chunkEndOffsets.push_back(vtksys::SystemTools::FileLength(filename));
+    }
+
+    // Frames that are acquired earlier than the last written frame must be rejected, without writing anything
+    LOG_INFO("Appending frames with decreasing timestamps, an error is expected");
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> outOfOrderFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    AddFrame(outOfOrderFrameList, 0, GetTimestamp(0));
+    if (writer->AppendFrames(outOfOrderFrameList) == PLUS_SUCCESS)
+    {
+      LOG_ERROR("Frame with a timestamp earlier than the last written frame was accepted");
+      numberOfErrors++;
+    }
+    if (writer->GetNumberOfFrames() != NUMBER_OF_CHUNKS * NUMBER_OF_FRAMES_PER_CHUNK
+        || vtksys::SystemTools::FileLength(filename) != chunkEndOffsets.back())
+    {
+      LOG_ERROR("Rejected frames are written to the file");
+      numberOfErrors++;
+    }
+
+    if (writer->Close() != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to close " << filename);
+      return EXIT_FAILURE;
+    }
+  }
+  const unsigned long fileSize = vtksys::SystemTools::FileLength(filename);
+  const unsigned int numberOfFrames = NUMBER_OF_CHUNKS * NUMBER_OF_FRAMES_PER_CHUNK;
+  numberOfErrors += VerifyFile(filename, numberOfFrames, false);
+
+  // Crash while writing the last chunk: the frames of the complete chunks are available
+  unsigned long lastChunkStart = chunkEndOffsets[NUMBER_OF_CHUNKS - 2];
+  unsigned long lastChunkEnd = chunkEndOffsets[NUMBER_OF_CHUNKS - 1];
+  if (WriteTruncatedCopy(filename, chunkTruncatedFilename, (lastChunkStart + lastChunkEnd) / 2) != PLUS_SUCCESS)
+  {
+    return EXIT_FAILURE;
+  }
+  const unsigned int numberOfFramesInCompleteChunks = (NUMBER_OF_CHUNKS - 1) * NUMBER_OF_FRAMES_PER_CHUNK;
+  numberOfErrors += VerifyFile(chunkTruncatedFilename, numberOfFramesInCompleteChunks, true);
+  if (vtkPlusChunkedSequenceIO::Recover(chunkTruncatedFilename) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to recover " << chunkTruncatedFilename);
+    numberOfErrors++;
+  }
+  numberOfErrors += VerifyFile(chunkTruncatedFilename, numberOfFramesInCompleteChunks, false);
+
+  // Crash while writing the frame index: all the frames are available
+  if (WriteTruncatedCopy(filename, indexTruncatedFilename, (lastChunkEnd + fileSize) / 2) != PLUS_SUCCESS)
+  {
+    return EXIT_FAILURE;
+  }
+  numberOfErrors += VerifyFile(indexTruncatedFilename, numberOfFrames, true);
+  if (vtkPlusChunkedSequenceIO::Recover(indexTruncatedFilename) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to recover " << indexTruncatedFilename);
+    numberOfErrors++;
+  }
+  numberOfErrors += VerifyFile(indexTruncatedFilename, numberOfFrames, false);
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully.");
+  return EXIT_SUCCESS;
+}
@@ -8,6 +8,8 @@ See License.txt for details.
 #include "PlusConfigure.h"
 #include "PlusMath.h"
 #include "igsioTrackedFrame.h"
+#include "vtkPlusChunkedSequenceIO.h"
+#include "vtkPlusConfig.h"
 #include "vtkPlusSequenceIO.h"
 #include "vtkIGSIOTrackedFrameList.h"
 #include "vtkIGSIOTransformRepository.h"
@@ -15,12 +17,19 @@ See License.txt for details.
 // VTK includes
 #include <vtkImageData.h>
 #include <vtkMatrix4x4.h>
+#include <vtkMultiThreader.h>
 #include <vtkSmartPointer.h>
 #include <vtkTransform.h>
 #include <vtkXMLDataElement.h>
 #include <vtkXMLUtilities.h>
 #include <vtksys/CommandLineArguments.hxx>
 #include <vtksys/RegularExpression.hxx>
+#include <vtksys/SystemTools.hxx>
+
+// STL includes
+#include <algorithm>
+#include <array>
+#include <atomic>
 
 enum OperationType
 {
@@ -66,19 +75,197 @@ public:
   std::string               FrameTransformIndexFieldName;
 };
 
+// Image editing operation that is applied to each frame independently (FILL_IMAGE_RECTANGLE or CROP)
+class FrameImageEdit
+{
+public:
+  FrameImageEdit()
+  {
+    Operation = NO_OPERATION;
+    FillGrayLevel = 0;
+    CropRectOrigin.fill(0);
+    CropRectSize.fill(0);
+  }
+
+  OperationType                 Operation;
+  std::vector<unsigned int>     FillRectOrigin;
+  std::vector<unsigned int>     FillRectSize;
+  unsigned char                 FillGrayLevel;
+  igsioVideoFrame::FlipInfoType FlipInfo;
+  std::array<int, 3>            CropRectOrigin;
+  std::array<int, 3>            CropRectSize;
+  vtkSmartPointer<vtkMatrix4x4> ImageToCroppedImageMatrix;
+};
+
+// Editing of chunked sequence files frame by frame, without loading all the frames into memory
+class SequenceStreamingEdit
+{
+public:
+  SequenceStreamingEdit()
+  {
+    Operation = NO_OPERATION;
+    FirstFrameIndex = 0;
+    LastFrameIndex = 0;
+    DecimationFactor = 2;
+    IncrementTimestamps = false;
+    UseCompression = false;
+    NumberOfThreads = 0;
+  }
+
+  std::vector<std::string>  InputFileNames;
+  std::string               OutputFileName;
+  OperationType             Operation;
+  unsigned int              FirstFrameIndex;
+  unsigned int              LastFrameIndex;
+  unsigned int              DecimationFactor;
+  bool                      IncrementTimestamps;
+  bool                      UseCompression;
+  FrameImageEdit            ImageEdit;
+  int                       NumberOfThreads;
+};
+
 PlusStatus TrimSequenceFile(vtkIGSIOTrackedFrameList* trackedFrameList, unsigned int firstFrameIndex, unsigned int lastFrameIndex);
 PlusStatus DecimateSequenceFile(vtkIGSIOTrackedFrameList* trackedFrameList, unsigned int decimationFactor);
 PlusStatus UpdateFrameFieldValue(FrameFieldUpdate& fieldUpdate);
 PlusStatus DeleteFrameField(vtkIGSIOTrackedFrameList* trackedFrameList, std::string fieldName);
 PlusStatus ConvertStringToMatrix(std::string& strMatrix, vtkMatrix4x4* matrix);
 PlusStatus AddTransform(vtkIGSIOTrackedFrameList* trackedFrameList, std::vector<std::string> transformNamesToAdd, std::string deviceSetConfigurationFileName);
-PlusStatus FillRectangle(vtkIGSIOTrackedFrameList* trackedFrameList, const std::vector<unsigned int>& fillRectOrigin, const std::vector<unsigned int>& fillRectSize, int fillGrayLevel);
-PlusStatus CropRectangle(vtkIGSIOTrackedFrameList* trackedFrameList, igsioVideoFrame::FlipInfoType& flipInfo, const std::vector<int>& cropRectOrigin, const std::vector<int>& cropRectSize);
+PlusStatus SetupFillRectangle(FrameImageEdit& imageEdit, const std::vector<int>& fillRectOrigin, const std::vector<int>& fillRectSize, int fillGrayLevel);
+PlusStatus SetupCropRectangle(FrameImageEdit& imageEdit, igsioVideoFrame::FlipInfoType& flipInfo, const std::vector<int>& cropRectOrigin, const std::vector<int>& cropRectSize);
+PlusStatus FillFrameRectangle(igsioTrackedFrame* trackedFrame, unsigned int frameIndex, const FrameImageEdit& imageEdit);
+PlusStatus CropFrameRectangle(igsioTrackedFrame* trackedFrame, unsigned int frameIndex, const FrameImageEdit& imageEdit);
+PlusStatus EditFrameImages(vtkIGSIOTrackedFrameList* trackedFrameList, unsigned int firstFrameIndex, const FrameImageEdit& imageEdit, int numberOfThreads);
+bool CanStreamFrames(OperationType operation, const std::vector<std::string>& inputFileNames, const std::string& outputFileName);
+PlusStatus StreamSequenceFiles(const SequenceStreamingEdit& streamingEdit);
 
 namespace
 {
   const std::string FIELD_VALUE_FRAME_SCALAR = "{frame-scalar}";
   const std::string FIELD_VALUE_FRAME_TRANSFORM = "{frame-transform}";
+
+  // Number of frames in each chunk of chunked sequence files that are written frame by frame
+  const unsigned int STREAMING_FRAMES_PER_CHUNK = 32;
+
+  // Data shared by all the threads that edit the images of a tracked frame list
+  struct FrameImageEditJob
+  {
+    vtkIGSIOTrackedFrameList* TrackedFrameList;
+    // Index of the first frame of the list in the output sequence (used in log messages)
+    unsigned int FirstFrameIndex;
+    const FrameImageEdit* ImageEdit;
+    std::atomic<int> NextFrameIndex;
+  };
+
+  //----------------------------------------------------------------------------
+  void* EditFrameImagesThread(vtkMultiThreader::ThreadInfo* data)
+  {
+    FrameImageEditJob* job = static_cast<FrameImageEditJob*>(data->UserData);
+    const int numberOfFrames = static_cast<int>(job->TrackedFrameList->GetNumberOfTrackedFrames());
+    for (int i = job->NextFrameIndex++; i < numberOfFrames; i = job->NextFrameIndex++)
+    {
+      // Frames that cannot be edited are logged and kept unchanged
+      igsioTrackedFrame* trackedFrame = job->TrackedFrameList->GetTrackedFrame(i);
+      if (job->ImageEdit->Operation == CROP)
+      {
+        CropFrameRectangle(trackedFrame, job->FirstFrameIndex + i, *job->ImageEdit);
+      }
+      else
+      {
+        FillFrameRectangle(trackedFrame, job->FirstFrameIndex + i, *job->ImageEdit);
+      }
+    }
+    return NULL;
+  }
+
+  // Additional sequence file whose frame fields are mixed into the frames of the master sequence file
+  struct MixedSequenceFile
+  {
+    vtkPlusChunkedSequenceIO* Reader;
+    // Index of the frame that is closest to the current master frame
+    unsigned int FrameIndex;
+    // Frame fields of the frame at FrameIndex (valid if FrameRead is true)
+    igsioTrackedFrame Frame;
+    bool FrameRead;
+  };
+
+  //----------------------------------------------------------------------------
+  PlusStatus MixFrameFields(igsioTrackedFrame* masterTrackedFrame, MixedSequenceFile& mixedFile)
+  {
+    const unsigned int numberOfFrames = mixedFile.Reader->GetNumberOfFrames();
+    if (numberOfFrames == 0)
+    {
+      return PLUS_SUCCESS;
+    }
+
+    // Determine which additional frame belongs to this master frame: use the same frame until the timestamp
+    // of the next frame is closer to the master frame timestamp. All remaining frames are assigned to the last frame.
+    bool frameChanged = !mixedFile.FrameRead;
+    while (mixedFile.FrameIndex + 1 < numberOfFrames)
+    {
+      double currentTimestamp = 0;
+      double nextTimestamp = 0;
+      if (mixedFile.Reader->GetFrameTimestamp(mixedFile.FrameIndex, currentTimestamp) != PLUS_SUCCESS
+          || mixedFile.Reader->GetFrameTimestamp(mixedFile.FrameIndex + 1, nextTimestamp) != PLUS_SUCCESS)
+      {
+        return PLUS_FAIL;
+      }
+      if (masterTrackedFrame->GetTimestamp() <= (currentTimestamp + nextTimestamp) / 2.0)
+      {
+        break;
+      }
+      mixedFile.FrameIndex++;
+      frameChanged = true;
+    }
+
+    if (frameChanged)
+    {
+      mixedFile.Frame = igsioTrackedFrame();
+      if (mixedFile.Reader->ReadFrame(mixedFile.FrameIndex, mixedFile.Frame, false) != PLUS_SUCCESS)
+      {
+        return PLUS_FAIL;
+      }
+      mixedFile.FrameRead = true;
+    }
+
+    // Copy frame fields
+    auto customFrameFields = mixedFile.Frame.GetCustomFields();
+    for (auto fieldIter = customFrameFields.begin(); fieldIter != customFrameFields.end(); ++fieldIter)
+    {
+      if (!fieldIter->first.compare("FrameNumber") ||
+          !fieldIter->first.compare("Timestamp") ||
+          !fieldIter->first.compare("UnfilteredTimestamp") ||
+          !fieldIter->first.compare("ImageStatus"))
+      {
+        // Timing and image information is taken from the first sequence
+        continue;
+      }
+      masterTrackedFrame->SetFrameField(fieldIter->first, fieldIter->second.second, fieldIter->second.first);
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  // Sequence files are searched in the current directory and in the image directory
+  std::string GetInputSequenceFilePath(const std::string& fileName)
+  {
+    std::string filePath = fileName;
+    if (!vtksys::SystemTools::FileExists(filePath.c_str(), true))
+    {
+      vtkPlusConfig::GetInstance()->FindImagePath(fileName, filePath);
+    }
+    return filePath;
+  }
+
+  //----------------------------------------------------------------------------
+  // Relative output file paths are relative to the output directory
+  std::string GetOutputSequenceFilePath(const std::string& fileName)
+  {
+    if (vtksys::SystemTools::FileIsFullPath(fileName))
+    {
+      return fileName;
+    }
+    return vtkPlusConfig::GetInstance()->GetOutputDirectory() + "/" + fileName;
+  }
 }
 
 // Fuse all fields in sequence files into the first sequence
@@ -249,6 +436,8 @@ int main(int argc, char** argv)
   bool                            flipY(false);
   bool                            flipZ(false);
 
+  int                             numberOfThreads = 0; // Number of threads used for editing images and compressing chunked sequence files (0 = automatic)
+
   args.Initialize(argc, argv);
   args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
   args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
@@ -294,6 +483,8 @@ int main(int argc, char** argv)
   args.AddArgument("--flipZ", vtksys::CommandLineArguments::NO_ARGUMENT, &flipZ, "Flip image along Z axis.");
   args.AddArgument("--fill-gray-level", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &fillGrayLevel, "Rectangle fill gray level. 0 = black, 255 = white. (Default: 0)");
 
+  args.AddArgument("--number-of-threads", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfThreads, "Number of threads used for filling/cropping images and for compressing chunked sequence files (.pseq). 0 = number of processor cores. (Default: 0)");
+
   if (!args.Parse())
   {
     std::cerr << "Problem parsing arguments" << std::endl;
@@ -341,6 +532,10 @@ int main(int argc, char** argv)
 
     std::cout << "- REMOVE_IMAGE_DATA: Remove image data from a meta file that has both image and tracker data, and keep only the tracker data." << std::endl;
 
+    std::cout << std::endl << "If all the input files and the output file are chunked sequence files (.pseq) then TRIM, DECIMATE, APPEND, MIX," << std::endl;
+    std::cout << "FILL_IMAGE_RECTANGLE, CROP, REMOVE_IMAGE_DATA, and conversion without operation are performed frame by frame," << std::endl;
+    std::cout << "without loading all the frames into memory. Custom fields of the first input file are copied to the output file." << std::endl;
+
     return EXIT_SUCCESS;
   }
 
@@ -451,10 +646,28 @@ int main(int argc, char** argv)
     return EXIT_FAILURE;
   }
 
-  ///////////////////////////////////////////////////////////////////
-  // Read input files
-
-  vtkSmartPointer<vtkIGSIOTrackedFrameList> trackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  // Image editing operations are applied to each frame independently
+  FrameImageEdit imageEdit;
+  if (operation == FILL_IMAGE_RECTANGLE)
+  {
+    if (SetupFillRectangle(imageEdit, rectOriginPix, rectSizePix, fillGrayLevel) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to fill rectangle");
+      return EXIT_FAILURE;
+    }
+  }
+  else if (operation == CROP)
+  {
+    igsioVideoFrame::FlipInfoType flipInfo;
+    flipInfo.hFlip = flipX;
+    flipInfo.vFlip = flipY;
+    flipInfo.eFlip = flipZ;
+    if (SetupCropRectangle(imageEdit, flipInfo, rectOriginPix, rectSizePix) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to crop rectangle");
+      return EXIT_FAILURE;
+    }
+  }
 
   if (!inputFileName.empty())
   {
@@ -462,6 +675,37 @@ int main(int argc, char** argv)
     inputFileNames.insert(inputFileNames.begin(), inputFileName);
   }
 
+  ///////////////////////////////////////////////////////////////////
+  // Edit chunked sequence files frame by frame
+
+  if (strUpdatedReferenceTransformName.empty() && CanStreamFrames(operation, inputFileNames, outputFileName))
+  {
+    SequenceStreamingEdit streamingEdit;
+    streamingEdit.InputFileNames = inputFileNames;
+    streamingEdit.OutputFileName = outputFileName;
+    streamingEdit.Operation = operation;
+    streamingEdit.FirstFrameIndex = static_cast<unsigned int>(std::max(firstFrameIndex, 0));
+    streamingEdit.LastFrameIndex = static_cast<unsigned int>(std::max(lastFrameIndex, 0));
+    streamingEdit.DecimationFactor = static_cast<unsigned int>(std::max(decimationFactor, 0));
+    streamingEdit.IncrementTimestamps = incrementTimestamps;
+    streamingEdit.UseCompression = useCompression;
+    streamingEdit.ImageEdit = imageEdit;
+    streamingEdit.NumberOfThreads = numberOfThreads;
+    if (StreamSequenceFiles(streamingEdit) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Couldn't write sequence file: " << outputFileName);
+      return EXIT_FAILURE;
+    }
+
+    LOG_INFO("Sequence file editing was successful!");
+    return EXIT_SUCCESS;
+  }
+
+  ///////////////////////////////////////////////////////////////////
+  // Read input files
+
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> trackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+
   // Multiple input files are appended unless sequences are mixed
   PlusStatus status = PLUS_SUCCESS;
   if (operation == MIX)
@@ -621,20 +865,8 @@ int main(int argc, char** argv)
       break;
     case FILL_IMAGE_RECTANGLE:
       {
-        if (rectOriginPix.size() != 2 || rectSizePix.size() != 2)
-        {
-          LOG_ERROR("Incorrect size of vector for rectangle origin or size. Aborting.");
-          return PLUS_FAIL;
-        }
-        if (rectOriginPix[0] < 0 || rectOriginPix[1] < 0 || rectSizePix[0] < 0 || rectSizePix[1] < 0)
-        {
-          LOG_ERROR("Negative value for rectangle origin or size entered. Aborting.");
-          return PLUS_FAIL;
-        }
-        std::vector<unsigned int> rectOriginPixUint(rectOriginPix.begin(), rectOriginPix.end());
-        std::vector<unsigned int> rectSizePixUint(rectSizePix.begin(), rectSizePix.end());
         // Fill a rectangular region in the image with a solid color
-        if (FillRectangle(trackedFrameList, rectOriginPixUint, rectSizePixUint, fillGrayLevel) != PLUS_SUCCESS)
+        if (EditFrameImages(trackedFrameList, 0, imageEdit, numberOfThreads) != PLUS_SUCCESS)
         {
           LOG_ERROR("Failed to fill rectangle");
           return EXIT_FAILURE;
@@ -644,13 +876,9 @@ int main(int argc, char** argv)
     case CROP:
       {
         // Crop a rectangular region from the image
-        igsioVideoFrame::FlipInfoType flipInfo;
-        flipInfo.hFlip = flipX;
-        flipInfo.vFlip = flipY;
-        flipInfo.eFlip = flipZ;
-        if (CropRectangle(trackedFrameList, flipInfo, rectOriginPix, rectSizePix) != PLUS_SUCCESS)
+        if (EditFrameImages(trackedFrameList, 0, imageEdit, numberOfThreads) != PLUS_SUCCESS)
         {
-          LOG_ERROR("Failed to fill rectangle");
+          LOG_ERROR("Failed to crop rectangle");
           return EXIT_FAILURE;
         }
       }
@@ -1061,106 +1289,371 @@ PlusStatus AddTransform(vtkIGSIOTrackedFrameList* trackedFrameList, std::vector<
 }
 
 //-------------------------------------------------------
-PlusStatus FillRectangle(vtkIGSIOTrackedFrameList* trackedFrameList, const std::vector<unsigned int>& fillRectOrigin, const std::vector<unsigned int>& fillRectSize, int fillGrayLevel)
+PlusStatus SetupFillRectangle(FrameImageEdit& imageEdit, const std::vector<int>& fillRectOrigin, const std::vector<int>& fillRectSize, int fillGrayLevel)
+{
+  if (fillRectOrigin.size() != 2 || fillRectSize.size() != 2)
+  {
+    LOG_ERROR("Fill rectangle origin or size is not specified correctly");
+    return PLUS_FAIL;
+  }
+  if (fillRectOrigin[0] < 0 || fillRectOrigin[1] < 0 || fillRectSize[0] < 0 || fillRectSize[1] < 0)
+  {
+    LOG_ERROR("Negative value for rectangle origin or size entered. Aborting.");
+    return PLUS_FAIL;
+  }
+
+  imageEdit.Operation = FILL_IMAGE_RECTANGLE;
+  imageEdit.FillRectOrigin.assign(fillRectOrigin.begin(), fillRectOrigin.end());
+  imageEdit.FillRectSize.assign(fillRectSize.begin(), fillRectSize.end());
+  if (fillGrayLevel < 0)
+  {
+    imageEdit.FillGrayLevel = 0;
+  }
+  else if (fillGrayLevel > 255)
+  {
+    imageEdit.FillGrayLevel = 255;
+  }
+  else
+  {
+    imageEdit.FillGrayLevel = fillGrayLevel;
+  }
+  return PLUS_SUCCESS;
+}
+
+//-------------------------------------------------------
+PlusStatus SetupCropRectangle(FrameImageEdit& imageEdit, igsioVideoFrame::FlipInfoType& flipInfo, const std::vector<int>& cropRectOrigin, const std::vector<int>& cropRectSize)
+{
+  if (cropRectOrigin.size() < 2 || cropRectSize.size() < 2)
+  {
+    LOG_ERROR("Crop rectangle origin or size is not specified correctly");
+    return PLUS_FAIL;
+  }
+
+  imageEdit.Operation = CROP;
+  imageEdit.FlipInfo = flipInfo;
+  imageEdit.CropRectOrigin = { cropRectOrigin[0], cropRectOrigin[1], cropRectOrigin.size() == 3 ? cropRectOrigin[2] : 0 };
+  imageEdit.CropRectSize = { cropRectSize[0], cropRectSize[1], cropRectSize.size() == 3 ? cropRectSize[2] : 1 };
+
+  imageEdit.ImageToCroppedImageMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  imageEdit.ImageToCroppedImageMatrix->Identity();
+  imageEdit.ImageToCroppedImageMatrix->SetElement(0, 3, -imageEdit.CropRectOrigin[0]);
+  imageEdit.ImageToCroppedImageMatrix->SetElement(1, 3, -imageEdit.CropRectOrigin[1]);
+  imageEdit.ImageToCroppedImageMatrix->SetElement(2, 3, -imageEdit.CropRectOrigin[2]);
+  return PLUS_SUCCESS;
+}
+
+//-------------------------------------------------------
+PlusStatus FillFrameRectangle(igsioTrackedFrame* trackedFrame, unsigned int frameIndex, const FrameImageEdit& imageEdit)
+{
+  const std::vector<unsigned int>& fillRectOrigin = imageEdit.FillRectOrigin;
+  const std::vector<unsigned int>& fillRectSize = imageEdit.FillRectSize;
+
+  igsioVideoFrame* videoFrame = trackedFrame->GetImageData();
+  FrameSizeType frameSize = { 0, 0, 0 };
+  if (videoFrame == NULL || videoFrame->GetFrameSize(frameSize) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to retrieve pixel data from frame " << frameIndex << ". Fill rectangle failed.");
+    return PLUS_FAIL;
+  }
+  if (fillRectOrigin[0] >= frameSize[0] ||
+      fillRectOrigin[1] >= frameSize[1])
+  {
+    LOG_ERROR("Invalid fill rectangle origin is specified (" << fillRectOrigin[0] << ", " << fillRectOrigin[1] << "). The image size is ("
+              << frameSize[0] << ", " << frameSize[1] << ").");
+    return PLUS_FAIL;
+  }
+  if (fillRectSize[0] <= 0 || fillRectOrigin[0] + fillRectSize[0] > frameSize[0] ||
+      fillRectSize[1] <= 0 || fillRectOrigin[1] + fillRectSize[1] > frameSize[1])
+  {
+    LOG_ERROR("Invalid fill rectangle size is specified (" << fillRectSize[0] << ", " << fillRectSize[1] << "). The specified fill rectangle origin is ("
+              << fillRectOrigin[0] << ", " << fillRectOrigin[1] << ") and the image size is (" << frameSize[0] << ", " << frameSize[1] << ").");
+    return PLUS_FAIL;
+  }
+  if (videoFrame->GetVTKScalarPixelType() != VTK_UNSIGNED_CHAR)
+  {
+    LOG_ERROR("Fill rectangle is supported only for B-mode images (unsigned char type)");
+    return PLUS_FAIL;
+  }
+  for (unsigned int y = 0; y < fillRectSize[1]; y++)
+  {
+    memset(static_cast<unsigned char*>(videoFrame->GetScalarPointer()) + (fillRectOrigin[1] + y)*frameSize[0] + fillRectOrigin[0], imageEdit.FillGrayLevel, fillRectSize[0]);
+  }
+  return PLUS_SUCCESS;
+}
+
+//-------------------------------------------------------
+PlusStatus CropFrameRectangle(igsioTrackedFrame* trackedFrame, unsigned int frameIndex, const FrameImageEdit& imageEdit)
+{
+  igsioVideoFrame* videoFrame = trackedFrame->GetImageData();
+
+  FrameSizeType frameSize = { 0, 0, 0 };
+  if (videoFrame == NULL || videoFrame->GetFrameSize(frameSize) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to retrieve pixel data from frame " << frameIndex << ". Crop rectangle failed.");
+    return PLUS_FAIL;
+  }
+
+  vtkSmartPointer<vtkImageData> croppedImage = vtkSmartPointer<vtkImageData>::New();
+
+  igsioVideoFrame::FlipInfoType flipInfo = imageEdit.FlipInfo;
+  std::array<int, 3> rectOrigin = imageEdit.CropRectOrigin;
+  std::array<int, 3> rectSize = imageEdit.CropRectSize;
+  igsioVideoFrame::FlipClipImage(videoFrame->GetImage(), flipInfo, rectOrigin, rectSize, croppedImage);
+  videoFrame->DeepCopyFrom(croppedImage);
+  igsioTransformName imageToCroppedImage("Image", "CroppedImage");
+  trackedFrame->SetFrameTransform(imageToCroppedImage, imageEdit.ImageToCroppedImageMatrix);
+  trackedFrame->SetFrameTransformStatus(imageToCroppedImage, TOOL_OK);
+  return PLUS_SUCCESS;
+}
+
+//-------------------------------------------------------
+PlusStatus EditFrameImages(vtkIGSIOTrackedFrameList* trackedFrameList, unsigned int firstFrameIndex, const FrameImageEdit& imageEdit, int numberOfThreads)
 {
   if (trackedFrameList == NULL)
   {
     LOG_ERROR("Tracked frame list is NULL!");
     return PLUS_FAIL;
   }
-  if (fillRectOrigin.size() != 2 || fillRectSize.size() != 2)
+  if (imageEdit.Operation != FILL_IMAGE_RECTANGLE && imageEdit.Operation != CROP)
   {
-    LOG_ERROR("Fill rectangle origin or size is not specified correctly");
+    LOG_ERROR("Image editing operation is not specified");
     return PLUS_FAIL;
   }
 
-  for (unsigned int i = 0; i < trackedFrameList->GetNumberOfTrackedFrames(); ++i)
+  FrameImageEditJob job;
+  job.TrackedFrameList = trackedFrameList;
+  job.FirstFrameIndex = firstFrameIndex;
+  job.ImageEdit = &imageEdit;
+  job.NextFrameIndex = 0;
+
+  // Frames are independent, so they are edited in parallel
+  numberOfThreads = (numberOfThreads > 0 ? numberOfThreads : vtkMultiThreader::GetGlobalDefaultNumberOfThreads());
+  numberOfThreads = std::max(1, std::min(std::min(numberOfThreads, static_cast<int>(trackedFrameList->GetNumberOfTrackedFrames())), VTK_MAX_THREADS));
+  if (numberOfThreads == 1)
   {
-    igsioTrackedFrame* trackedFrame = trackedFrameList->GetTrackedFrame(i);
-    igsioVideoFrame* videoFrame = trackedFrame->GetImageData();
-    FrameSizeType frameSize = { 0, 0, 0 };
-    if (videoFrame == NULL || videoFrame->GetFrameSize(frameSize) != PLUS_SUCCESS)
+    vtkMultiThreader::ThreadInfo threadInfo;
+    threadInfo.UserData = &job;
+    EditFrameImagesThread(&threadInfo);
+  }
+  else
+  {
+    vtkSmartPointer<vtkMultiThreader> threader = vtkSmartPointer<vtkMultiThreader>::New();
+    threader->SetNumberOfThreads(numberOfThreads);
+    threader->SetSingleMethod((vtkThreadFunctionType)&EditFrameImagesThread, &job);
+    threader->SingleMethodExecute();
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//-------------------------------------------------------
+bool CanStreamFrames(OperationType operation, const std::vector<std::string>& inputFileNames, const std::string& outputFileName)
+{
+  switch (operation)
+  {
+    case NO_OPERATION:
+    case TRIM:
+    case DECIMATE:
+    case APPEND:
+    case MIX:
+    case FILL_IMAGE_RECTANGLE:
+    case CROP:
+    case REMOVE_IMAGE_DATA:
+      break;
+    default:
+      // Operations that modify the custom fields or need the transform repository are performed on the whole frame list
+      return false;
+  }
+
+  if (inputFileNames.empty() || !vtkPlusChunkedSequenceIO::CanReadWriteFile(outputFileName))
+  {
+    return false;
+  }
+  std::string outputFilePath = vtksys::SystemTools::CollapseFullPath(GetOutputSequenceFilePath(outputFileName));
+  for (std::vector<std::string>::const_iterator it = inputFileNames.begin(); it != inputFileNames.end(); ++it)
+  {
+    if (!vtkPlusChunkedSequenceIO::CanReadWriteFile(*it))
     {
-      LOG_ERROR("Failed to retrieve pixel data from frame " << i << ". Fill rectangle failed.");
-      continue;
+      return false;
     }
-    if (fillRectOrigin[0] >= frameSize[0] ||
-        fillRectOrigin[1] >= frameSize[1])
+    if (vtksys::SystemTools::ComparePath(vtksys::SystemTools::CollapseFullPath(GetInputSequenceFilePath(*it)), outputFilePath))
     {
-      LOG_ERROR("Invalid fill rectangle origin is specified (" << fillRectOrigin[0] << ", " << fillRectOrigin[1] << "). The image size is ("
-                << frameSize[0] << ", " << frameSize[1] << ").");
-      continue;
+      // The input file would be overwritten while its frames are being read
+      return false;
     }
-    if (fillRectSize[0] <= 0 || fillRectOrigin[0] + fillRectSize[0] > frameSize[0] ||
-        fillRectSize[1] <= 0 || fillRectOrigin[1] + fillRectSize[1] > frameSize[1])
+  }
+  return true;
+}
+
+//-------------------------------------------------------
+PlusStatus WriteFrameBatch(vtkPlusChunkedSequenceIO* writer, vtkIGSIOTrackedFrameList* frameBatch, unsigned int firstFrameIndex, const SequenceStreamingEdit& streamingEdit)
+{
+  if (streamingEdit.Operation == FILL_IMAGE_RECTANGLE || streamingEdit.Operation == CROP)
+  {
+    if (EditFrameImages(frameBatch, firstFrameIndex, streamingEdit.ImageEdit, streamingEdit.NumberOfThreads) != PLUS_SUCCESS)
     {
-      LOG_ERROR("Invalid fill rectangle size is specified (" << fillRectSize[0] << ", " << fillRectSize[1] << "). The specified fill rectangle origin is ("
-                << fillRectOrigin[0] << ", " << fillRectOrigin[1] << ") and the image size is (" << frameSize[0] << ", " << frameSize[1] << ").");
-      continue;
+      return PLUS_FAIL;
     }
-    if (videoFrame->GetVTKScalarPixelType() != VTK_UNSIGNED_CHAR)
+  }
+  return writer->AppendFramesInChunks(frameBatch, STREAMING_FRAMES_PER_CHUNK);
+}
+
+//-------------------------------------------------------
+PlusStatus StreamSequenceFiles(const SequenceStreamingEdit& streamingEdit)
+{
+  LOG_INFO("All sequence files are chunked sequence files, frames are edited without loading the whole sequence into memory");
+
+  // Open input files, only the frame indices are loaded into memory
+  std::vector<vtkSmartPointer<vtkPlusChunkedSequenceIO> > readers;
+  unsigned int totalNumberOfFrames = 0;
+  for (std::vector<std::string>::const_iterator it = streamingEdit.InputFileNames.begin(); it != streamingEdit.InputFileNames.end(); ++it)
+  {
+    LOG_INFO("Read input sequence file: " << *it);
+    vtkSmartPointer<vtkPlusChunkedSequenceIO> reader = vtkSmartPointer<vtkPlusChunkedSequenceIO>::New();
+    reader->UseMemoryMappingOn();
+    if (reader->OpenForReading(GetInputSequenceFilePath(*it)) != PLUS_SUCCESS)
     {
-      LOG_ERROR("Fill rectangle is supported only for B-mode images (unsigned char type)");
-      continue;
+      LOG_ERROR("Couldn't read sequence file: " << *it);
+      return PLUS_FAIL;
     }
-    unsigned char fillData = 0;
-    if (fillGrayLevel < 0)
+    readers.push_back(reader);
+    totalNumberOfFrames += reader->GetNumberOfFrames();
+  }
+
+  // Frames of the master file are mixed with the fields of the other files, otherwise the files are appended
+  std::vector<MixedSequenceFile> mixedFiles;
+  unsigned int numberOfInputFrames = totalNumberOfFrames;
+  if (streamingEdit.Operation == MIX)
+  {
+    numberOfInputFrames = readers[0]->GetNumberOfFrames();
+    if (numberOfInputFrames == 0)
     {
-      fillData = 0;
+      LOG_ERROR("No frames in sequence file: " << streamingEdit.InputFileNames[0]);
+      return PLUS_FAIL;
     }
-    else if (fillGrayLevel > 255)
+    for (unsigned int i = 1; i < readers.size(); ++i)
     {
-      fillData = 255;
+      MixedSequenceFile mixedFile;
+      mixedFile.Reader = readers[i];
+      mixedFile.FrameIndex = 0;
+      mixedFile.FrameRead = false;
+      mixedFiles.push_back(mixedFile);
     }
-    else
+  }
+
+  // Range of the frames that are written (indices of the frames of the appended input files)
+  unsigned int firstFrameIndex = 0;
+  unsigned int lastFrameIndex = (numberOfInputFrames > 0 ? numberOfInputFrames - 1 : 0);
+  unsigned int frameIndexIncrement = 1;
+  if (streamingEdit.Operation == TRIM)
+  {
+    LOG_INFO("Trim sequence file from frame #: " << streamingEdit.FirstFrameIndex << " to frame #" << streamingEdit.LastFrameIndex);
+    if (streamingEdit.LastFrameIndex >= numberOfInputFrames || streamingEdit.FirstFrameIndex > streamingEdit.LastFrameIndex)
     {
-      fillData = fillGrayLevel;
+      LOG_ERROR("Invalid input range: (" << streamingEdit.FirstFrameIndex << ", " << streamingEdit.LastFrameIndex << ")" << " Permitted range within (0, " << static_cast<int>(numberOfInputFrames) - 1 << ")");
+      return PLUS_FAIL;
     }
-    for (unsigned int y = 0; y < fillRectSize[1]; y++)
+    firstFrameIndex = streamingEdit.FirstFrameIndex;
+    lastFrameIndex = streamingEdit.LastFrameIndex;
+  }
+  else if (streamingEdit.Operation == DECIMATE)
+  {
+    LOG_INFO("Decimate sequence file: keep 1 frame out of every " << streamingEdit.DecimationFactor << " frames");
+    if (streamingEdit.DecimationFactor < 2)
     {
-      memset(static_cast<unsigned char*>(videoFrame->GetScalarPointer()) + (fillRectOrigin[1] + y)*frameSize[0] + fillRectOrigin[0], fillData, fillRectSize[0]);
+      LOG_ERROR("Invalid decimation factor: " << streamingEdit.DecimationFactor << ". It must be an integer larger or equal than 2.");
+      return PLUS_FAIL;
     }
+    frameIndexIncrement = streamingEdit.DecimationFactor;
   }
-  return PLUS_SUCCESS;
-}
 
-//-------------------------------------------------------
-PlusStatus CropRectangle(vtkIGSIOTrackedFrameList* trackedFrameList, igsioVideoFrame::FlipInfoType& flipInfo, const std::vector<int>& cropRectOrigin, const std::vector<int>& cropRectSize)
-{
-  if (trackedFrameList == NULL)
+  std::string outputFilePath = GetOutputSequenceFilePath(streamingEdit.OutputFileName);
+  LOG_INFO("Save output sequence file to: " << outputFilePath);
+  vtkSmartPointer<vtkPlusChunkedSequenceIO> writer = vtkSmartPointer<vtkPlusChunkedSequenceIO>::New();
+  writer->SetUseCompression(streamingEdit.UseCompression);
+  writer->SetEnableImageDataWrite(streamingEdit.Operation != REMOVE_IMAGE_DATA);
+  writer->SetNumberOfCompressionThreads(streamingEdit.NumberOfThreads);
+  if (writer->OpenForWriting(outputFilePath) != PLUS_SUCCESS)
   {
-    LOG_ERROR("Tracked frame list is NULL!");
     return PLUS_FAIL;
   }
-  std::array<int, 3> rectOrigin = { cropRectOrigin[0], cropRectOrigin[1], cropRectOrigin.size() == 3 ? cropRectOrigin[2] : 0 };
-  std::array<int, 3> rectSize = { cropRectSize[0], cropRectSize[1], cropRectSize.size() == 3 ? cropRectSize[2] : 1 };
-
-  vtkSmartPointer<vtkMatrix4x4> tfmMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-  tfmMatrix->Identity();
-  tfmMatrix->SetElement(0, 3, -rectOrigin[0]);
-  tfmMatrix->SetElement(1, 3, -rectOrigin[1]);
-  tfmMatrix->SetElement(2, 3, -rectOrigin[2]);
-  igsioTransformName imageToCroppedImage("Image", "CroppedImage");
 
-  for (unsigned int i = 0; i < trackedFrameList->GetNumberOfTrackedFrames(); ++i)
+  // Frames are read, edited, and written in batches, so that each thread can edit and compress a whole chunk
+  int numberOfThreads = (streamingEdit.NumberOfThreads > 0 ? streamingEdit.NumberOfThreads : vtkMultiThreader::GetGlobalDefaultNumberOfThreads());
+  const unsigned int numberOfFramesPerBatch = STREAMING_FRAMES_PER_CHUNK * static_cast<unsigned int>(std::max(1, std::min(numberOfThreads, VTK_MAX_THREADS)));
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> frameBatch = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  readers[0]->GetCustomFields(frameBatch);
+  unsigned int numberOfWrittenFrames = 0;
+
+  unsigned int readerIndex = 0;
+  unsigned int readerFirstFrameIndex = 0; // index of the first frame of the current input file
+  double timestampOffset = 0;
+  for (unsigned int frameIndex = firstFrameIndex; numberOfInputFrames > 0 && frameIndex <= lastFrameIndex; frameIndex += frameIndexIncrement)
   {
-    igsioTrackedFrame* trackedFrame = trackedFrameList->GetTrackedFrame(i);
-    igsioVideoFrame* videoFrame = trackedFrame->GetImageData();
+    // Find the input file that contains the frame
+    while (frameIndex >= readerFirstFrameIndex + readers[readerIndex]->GetNumberOfFrames())
+    {
+      unsigned int numberOfReaderFrames = readers[readerIndex]->GetNumberOfFrames();
+      double lastTimestamp = 0;
+      if (streamingEdit.IncrementTimestamps && numberOfReaderFrames > 0 && readers[readerIndex]->GetFrameTimestamp(numberOfReaderFrames - 1, lastTimestamp) == PLUS_SUCCESS)
+      {
+        // Timestamps of the next file start from the last (incremented) timestamp of this file
+        timestampOffset += lastTimestamp;
+      }
+      readerFirstFrameIndex += numberOfReaderFrames;
+      readerIndex++;
+    }
 
-    FrameSizeType frameSize = { 0, 0, 0 };
-    if (videoFrame == NULL || videoFrame->GetFrameSize(frameSize) != PLUS_SUCCESS)
+    igsioTrackedFrame* trackedFrame = new igsioTrackedFrame;
+    if (readers[readerIndex]->ReadFrame(frameIndex - readerFirstFrameIndex, *trackedFrame, streamingEdit.Operation != REMOVE_IMAGE_DATA) != PLUS_SUCCESS)
     {
-      LOG_ERROR("Failed to retrieve pixel data from frame " << i << ". Crop rectangle failed.");
-      continue;
+      LOG_ERROR("Couldn't read frame " << frameIndex - readerFirstFrameIndex << " from sequence file: " << streamingEdit.InputFileNames[readerIndex]);
+      delete trackedFrame;
+      return PLUS_FAIL;
+    }
+    if (streamingEdit.IncrementTimestamps && streamingEdit.Operation != MIX)
+    {
+      trackedFrame->SetTimestamp(timestampOffset + trackedFrame->GetTimestamp());
+    }
+    for (std::vector<MixedSequenceFile>::iterator mixedFileIt = mixedFiles.begin(); mixedFileIt != mixedFiles.end(); ++mixedFileIt)
+    {
+      if (MixFrameFields(trackedFrame, *mixedFileIt) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Couldn't read frame " << mixedFileIt->FrameIndex << " from sequence file: " << mixedFileIt->Reader->GetFileName());
+        delete trackedFrame;
+        return PLUS_FAIL;
+      }
+    }
+
+    if (frameBatch->TakeTrackedFrame(trackedFrame, vtkIGSIOTrackedFrameList::ADD_INVALID_FRAME) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Unable to add frame " << frameIndex << " to the list!");
+      return PLUS_FAIL;
     }
 
-    vtkSmartPointer<vtkImageData> croppedImage = vtkSmartPointer<vtkImageData>::New();
+    if (frameBatch->GetNumberOfTrackedFrames() >= numberOfFramesPerBatch)
+    {
+      if (WriteFrameBatch(writer, frameBatch, numberOfWrittenFrames, streamingEdit) != PLUS_SUCCESS)
+      {
+        return PLUS_FAIL;
+      }
+      numberOfWrittenFrames += frameBatch->GetNumberOfTrackedFrames();
+      frameBatch = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+      readers[0]->GetCustomFields(frameBatch);
+    }
+  }
 
-    igsioVideoFrame::FlipClipImage(videoFrame->GetImage(), flipInfo, rectOrigin, rectSize, croppedImage);
-    videoFrame->DeepCopyFrom(croppedImage);
-    trackedFrame->SetFrameTransform(imageToCroppedImage, tfmMatrix);
-    trackedFrame->SetFrameTransformStatus(imageToCroppedImage, TOOL_OK);
+  // Custom fields are written even if there are no frames
+  if (WriteFrameBatch(writer, frameBatch, numberOfWrittenFrames, streamingEdit) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
   }
+  numberOfWrittenFrames += frameBatch->GetNumberOfTrackedFrames();
 
+  if (writer->Close() != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  LOG_INFO(numberOfWrittenFrames << " frames are written to " << outputFilePath);
   return PLUS_SUCCESS;
 }
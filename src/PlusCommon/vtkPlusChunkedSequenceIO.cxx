@@ -0,0 +1,1357 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "vtkPlusChunkedSequenceIO.h"
+
+// IGSIO includes
+#include <igsioTrackedFrame.h>
+#include <vtkIGSIOTrackedFrameList.h>
+
+// VTK includes
+#include <vtkMultiThreader.h>
+#include <vtkObjectFactory.h>
+#include <vtksys/SystemTools.hxx>
+
+// STL includes
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <limits>
+
+#ifdef PLUS_USE_SYSTEM_ZLIB
+  #include <zlib.h>
+#else
+  #include <vtk_zlib.h>
+#endif
+
+#ifdef _WIN32
+  #include <fcntl.h>
+  #include <io.h>
+  #include <share.h>
+  #include <sys/stat.h>
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <unistd.h>
+#endif
+
+//----------------------------------------------------------------------------
+
+vtkStandardNewMacro(vtkPlusChunkedSequenceIO);
+
+//----------------------------------------------------------------------------
+
+namespace
+{
+  // All numbers are stored in little-endian byte order
+  const char FILE_MAGIC[8] = { 'P', 'L', 'U', 'S', 'S', 'E', 'Q', '\0' };
+  const uint32_t FILE_FORMAT_VERSION = 1;
+  const unsigned int FILE_HEADER_SIZE = 16; // magic, version, reserved
+
+  const char CHUNK_MAGIC[4] = { 'P', 'S', 'C', 'K' };
+  const unsigned int CHUNK_HEADER_SIZE = 36; // magic, type, flags, number of frames, data size, stored size, checksum
+  enum ChunkType
+  {
+    CHUNK_FRAMES = 1,
+    CHUNK_CUSTOM_FIELDS = 2
+  };
+  const uint32_t CHUNK_FLAG_COMPRESSED = 0x0001;
+  const uint64_t MAX_COMPRESSION_RATIO = 1032; // maximum compression ratio of deflate, used for detecting corrupted chunk headers
+
+  const char INDEX_MAGIC[4] = { 'P', 'S', 'I', 'X' };
+  const char INDEX_FOOTER_MAGIC[4] = { 'P', 'S', 'I', 'E' };
+  const unsigned int INDEX_FOOTER_SIZE = 24; // index offset, index size, checksum, magic
+
+  const unsigned int NUMBER_OF_FRAMES_PER_CHUNK = 32; // used when a whole frame list is written at once
+
+  //----------------------------------------------------------------------------
+  void AppendUint32(std::vector<unsigned char>& buffer, uint32_t value)
+  {
+    for (int i = 0; i < 4; ++i)
+    {
+      buffer.push_back(static_cast<unsigned char>((value >> (8 * i)) & 0xff));
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void AppendUint64(std::vector<unsigned char>& buffer, uint64_t value)
+  {
+    for (int i = 0; i < 8; ++i)
+    {
+      buffer.push_back(static_cast<unsigned char>((value >> (8 * i)) & 0xff));
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void AppendDouble(std::vector<unsigned char>& buffer, double value)
+  {
+    uint64_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+    AppendUint64(buffer, bits);
+  }
+
+  //----------------------------------------------------------------------------
+  void AppendString(std::vector<unsigned char>& buffer, const std::string& value)
+  {
+    AppendUint32(buffer, static_cast<uint32_t>(value.size()));
+    buffer.insert(buffer.end(), value.begin(), value.end());
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Reads values from a buffer, all methods return false if the end of the buffer is reached */
+  class ByteReader
+  {
+  public:
+    ByteReader(const unsigned char* data, size_t size)
+      : Data(data)
+      , Size(size)
+      , Position(0)
+    {
+    }
+
+    bool ReadUint32(uint32_t& value)
+    {
+      if (this->Size - this->Position < 4)
+      {
+        return false;
+      }
+      value = 0;
+      for (int i = 0; i < 4; ++i)
+      {
+        value |= static_cast<uint32_t>(this->Data[this->Position++]) << (8 * i);
+      }
+      return true;
+    }
+
+    bool ReadUint64(uint64_t& value)
+    {
+      if (this->Size - this->Position < 8)
+      {
+        return false;
+      }
+      value = 0;
+      for (int i = 0; i < 8; ++i)
+      {
+        value |= static_cast<uint64_t>(this->Data[this->Position++]) << (8 * i);
+      }
+      return true;
+    }
+
+    bool ReadDouble(double& value)
+    {
+      uint64_t bits = 0;
+      if (!this->ReadUint64(bits))
+      {
+        return false;
+      }
+      memcpy(&value, &bits, sizeof(value));
+      return true;
+    }
+
+    bool ReadString(std::string& value)
+    {
+      uint32_t length = 0;
+      if (!this->ReadUint32(length) || this->Size - this->Position < length)
+      {
+        return false;
+      }
+      value.assign(reinterpret_cast<const char*>(this->Data + this->Position), length);
+      this->Position += length;
+      return true;
+    }
+
+    bool ReadMagic(const char magic[4])
+    {
+      if (this->Size - this->Position < 4 || memcmp(this->Data + this->Position, magic, 4) != 0)
+      {
+        return false;
+      }
+      this->Position += 4;
+      return true;
+    }
+
+    /*! Returns a pointer to the next numberOfBytes bytes and skips them */
+    const unsigned char* ReadBytes(uint64_t numberOfBytes)
+    {
+      if (this->Size - this->Position < numberOfBytes)
+      {
+        return NULL;
+      }
+      const unsigned char* bytes = this->Data + this->Position;
+      this->Position += static_cast<size_t>(numberOfBytes);
+      return bytes;
+    }
+
+    bool Seek(uint64_t position)
+    {
+      if (position > this->Size)
+      {
+        return false;
+      }
+      this->Position = static_cast<size_t>(position);
+      return true;
+    }
+
+    size_t GetPosition() const { return this->Position; }
+
+  protected:
+    const unsigned char* Data;
+    size_t Size;
+    size_t Position;
+  };
+
+  //----------------------------------------------------------------------------
+  uint32_t ComputeChecksum(const unsigned char* data, uint64_t size)
+  {
+    uLong crc = crc32(0L, Z_NULL, 0);
+    const uint64_t maxBlockSize = 1 << 30; // crc32 processes at most 4GB at once
+    while (size > 0)
+    {
+      uInt blockSize = static_cast<uInt>((std::min)(size, maxBlockSize));
+      crc = crc32(crc, data, blockSize);
+      data += blockSize;
+      size -= blockSize;
+    }
+    return static_cast<uint32_t>(crc);
+  }
+
+  //----------------------------------------------------------------------------
+  void AppendCustomFields(std::vector<unsigned char>& buffer, const std::vector<std::pair<std::string, std::string> >& fields)
+  {
+    AppendUint32(buffer, static_cast<uint32_t>(fields.size()));
+    for (std::vector<std::pair<std::string, std::string> >::const_iterator it = fields.begin(); it != fields.end(); ++it)
+    {
+      AppendString(buffer, it->first);
+      AppendString(buffer, it->second);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  bool ReadCustomFields(ByteReader& reader, std::vector<std::pair<std::string, std::string> >& fields)
+  {
+    fields.clear();
+    uint32_t numberOfFields = 0;
+    if (!reader.ReadUint32(numberOfFields))
+    {
+      return false;
+    }
+    for (uint32_t i = 0; i < numberOfFields; ++i)
+    {
+      std::pair<std::string, std::string> field;
+      if (!reader.ReadString(field.first) || !reader.ReadString(field.second))
+      {
+        return false;
+      }
+      fields.push_back(field);
+    }
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Serialize timestamp, frame fields and image data of a frame */
+  PlusStatus SerializeFrame(std::vector<unsigned char>& buffer, igsioTrackedFrame* frame, bool enableImageDataWrite)
+  {
+    AppendDouble(buffer, frame->GetTimestamp());
+
+    igsioFieldMapType fields = frame->GetFrameFields();
+    AppendUint32(buffer, static_cast<uint32_t>(fields.size()));
+    for (igsioFieldMapType::iterator it = fields.begin(); it != fields.end(); ++it)
+    {
+      AppendUint32(buffer, static_cast<uint32_t>(it->second.first));
+      AppendString(buffer, it->first);
+      AppendString(buffer, it->second.second);
+    }
+
+    igsioVideoFrame* image = frame->GetImageData();
+    bool hasImage = enableImageDataWrite && image->IsImageValid();
+    AppendUint32(buffer, hasImage ? 1 : 0);
+    if (!hasImage)
+    {
+      return PLUS_SUCCESS;
+    }
+
+    unsigned int numberOfScalarComponents(1);
+    if (image->GetNumberOfScalarComponents(numberOfScalarComponents) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Unable to retrieve number of scalar components.");
+      return PLUS_FAIL;
+    }
+    FrameSizeType frameSize = frame->GetFrameSize();
+    AppendUint32(buffer, frameSize[0]);
+    AppendUint32(buffer, frameSize[1]);
+    AppendUint32(buffer, frameSize[2]);
+    AppendUint32(buffer, static_cast<uint32_t>(image->GetVTKScalarPixelType()));
+    AppendUint32(buffer, numberOfScalarComponents);
+    AppendUint32(buffer, static_cast<uint32_t>(image->GetImageType()));
+    AppendUint32(buffer, static_cast<uint32_t>(image->GetImageOrientation()));
+    uint64_t imageDataSizeInBytes = image->GetFrameSizeInBytes();
+    AppendUint64(buffer, imageDataSizeInBytes);
+    const unsigned char* imageData = static_cast<const unsigned char*>(image->GetScalarPointer());
+    buffer.insert(buffer.end(), imageData, imageData + imageDataSizeInBytes);
+
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  /*!
+    Deserialize a frame. If frame is NULL then only the timestamp is read and the rest of the frame is skipped.
+    If readImageData is false then the image data is skipped.
+  */
+  bool DeserializeFrame(ByteReader& reader, igsioTrackedFrame* frame, double& timestamp, bool readImageData = true)
+  {
+    uint32_t numberOfFields = 0;
+    if (!reader.ReadDouble(timestamp) || !reader.ReadUint32(numberOfFields))
+    {
+      return false;
+    }
+    for (uint32_t i = 0; i < numberOfFields; ++i)
+    {
+      uint32_t flags = 0;
+      std::string name;
+      std::string value;
+      if (!reader.ReadUint32(flags) || !reader.ReadString(name) || !reader.ReadString(value))
+      {
+        return false;
+      }
+      if (frame != NULL)
+      {
+        frame->SetFrameField(name, value, static_cast<igsioFrameFieldFlags>(flags));
+      }
+    }
+    if (frame != NULL)
+    {
+      frame->SetTimestamp(timestamp);
+    }
+
+    uint32_t hasImage = 0;
+    if (!reader.ReadUint32(hasImage))
+    {
+      return false;
+    }
+    if (!hasImage)
+    {
+      return true;
+    }
+
+    uint32_t frameSize[3] = { 0, 0, 0 };
+    uint32_t pixelType = 0;
+    uint32_t numberOfScalarComponents = 0;
+    uint32_t imageType = 0;
+    uint32_t imageOrientation = 0;
+    uint64_t imageDataSizeInBytes = 0;
+    if (!reader.ReadUint32(frameSize[0]) || !reader.ReadUint32(frameSize[1]) || !reader.ReadUint32(frameSize[2])
+        || !reader.ReadUint32(pixelType) || !reader.ReadUint32(numberOfScalarComponents)
+        || !reader.ReadUint32(imageType) || !reader.ReadUint32(imageOrientation) || !reader.ReadUint64(imageDataSizeInBytes))
+    {
+      return false;
+    }
+    const unsigned char* imageData = reader.ReadBytes(imageDataSizeInBytes);
+    if (imageData == NULL)
+    {
+      return false;
+    }
+    if (frame == NULL || !readImageData)
+    {
+      return true;
+    }
+
+    igsioVideoFrame* image = frame->GetImageData();
+    FrameSizeType size = { frameSize[0], frameSize[1], frameSize[2] };
+    if (image->AllocateFrame(size, static_cast<igsioCommon::VTKScalarPixelType>(pixelType), numberOfScalarComponents) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to allocate memory for frame of size " << frameSize[0] << "x" << frameSize[1] << "x" << frameSize[2]);
+      return false;
+    }
+    if (image->GetFrameSizeInBytes() != imageDataSizeInBytes)
+    {
+      LOG_ERROR("Image data size mismatch: expected " << image->GetFrameSizeInBytes() << " bytes, found " << imageDataSizeInBytes);
+      return false;
+    }
+    image->SetImageType(static_cast<US_IMAGE_TYPE>(imageType));
+    image->SetImageOrientation(static_cast<US_IMAGE_ORIENTATION>(imageOrientation));
+    memcpy(image->GetScalarPointer(), imageData, static_cast<size_t>(imageDataSizeInBytes));
+    image->GetImage()->Modified();
+
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TruncateFile(const std::string& filename, uint64_t size)
+  {
+#ifdef _WIN32
+    int fd = -1;
+    if (_sopen_s(&fd, filename.c_str(), _O_RDWR | _O_BINARY, _SH_DENYNO, _S_IREAD | _S_IWRITE) != 0)
+    {
+      return PLUS_FAIL;
+    }
+    int result = _chsize_s(fd, static_cast<__int64>(size));
+    _close(fd);
+    return result == 0 ? PLUS_SUCCESS : PLUS_FAIL;
+#else
+    return truncate(filename.c_str(), static_cast<off_t>(size)) == 0 ? PLUS_SUCCESS : PLUS_FAIL;
+#endif
+  }
+
+  //----------------------------------------------------------------------------
+  /*!
+    Compress chunk data. Returns false if compression failed. If the compressed data is not smaller than
+    the original data then compressed is set to false and the original data has to be stored.
+  */
+  bool CompressChunkData(const std::vector<unsigned char>& data, std::vector<unsigned char>& compressedData, bool& compressed)
+  {
+    compressed = false;
+    if (data.empty())
+    {
+      return true;
+    }
+    uLongf compressedSize = compressBound(static_cast<uLong>(data.size()));
+    compressedData.resize(compressedSize);
+    if (compress2(&compressedData[0], &compressedSize, &data[0], static_cast<uLong>(data.size()), Z_BEST_SPEED) != Z_OK)
+    {
+      return false;
+    }
+    compressedData.resize(compressedSize);
+    compressed = (compressedSize < data.size());
+    return true;
+  }
+
+  /*! Data shared by all the threads that compress the chunks of a frame list */
+  struct ChunkCompressionJob
+  {
+    /*! Uncompressed data of each chunk */
+    const std::vector<std::vector<unsigned char> >* ChunkData;
+    /*! Compressed data of each chunk, in the same order as ChunkData */
+    std::vector<std::vector<unsigned char> > CompressedData;
+    /*! Nonzero if the compressed data of the chunk is smaller than the uncompressed data */
+    std::vector<char> Compressed;
+    std::atomic<int> NextChunkIndex;
+    std::atomic<bool> Failed;
+  };
+
+  //----------------------------------------------------------------------------
+  void* CompressChunksThread(vtkMultiThreader::ThreadInfo* data)
+  {
+    ChunkCompressionJob* job = static_cast<ChunkCompressionJob*>(data->UserData);
+    const int numberOfChunks = static_cast<int>(job->ChunkData->size());
+    for (int i = job->NextChunkIndex++; i < numberOfChunks; i = job->NextChunkIndex++)
+    {
+      bool compressed = false;
+      if (!CompressChunkData((*job->ChunkData)[i], job->CompressedData[i], compressed))
+      {
+        job->Failed = true;
+      }
+      job->Compressed[i] = compressed ? 1 : 0;
+    }
+    return NULL;
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkPlusChunkedSequenceIO::vtkPlusChunkedSequenceIO()
+  : FileName("")
+  , OpenedForWriting(false)
+  , UseCompression(true)
+  , EnableImageDataWrite(true)
+  , IndexRecovered(false)
+  , UseMemoryMapping(false)
+  , NumberOfCompressionThreads(1)
+  , MappedData(NULL)
+  , MappedSize(0)
+  , DataEndOffset(0)
+  , ChunkDataPointer(NULL)
+  , ChunkDataSize(0)
+  , ChunkDataOffset(0)
+  , ChunkDataValid(false)
+{
+}
+
+//----------------------------------------------------------------------------
+vtkPlusChunkedSequenceIO::~vtkPlusChunkedSequenceIO()
+{
+  this->Close();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusChunkedSequenceIO::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "FileName: " << this->FileName << std::endl;
+  os << indent << "OpenedForWriting: " << (this->OpenedForWriting ? "TRUE" : "FALSE") << std::endl;
+  os << indent << "UseCompression: " << (this->UseCompression ? "TRUE" : "FALSE") << std::endl;
+  os << indent << "EnableImageDataWrite: " << (this->EnableImageDataWrite ? "TRUE" : "FALSE") << std::endl;
+  os << indent << "IndexRecovered: " << (this->IndexRecovered ? "TRUE" : "FALSE") << std::endl;
+  os << indent << "UseMemoryMapping: " << (this->UseMemoryMapping ? "TRUE" : "FALSE") << std::endl;
+  os << indent << "NumberOfCompressionThreads: " << this->NumberOfCompressionThreads << std::endl;
+  os << indent << "MemoryMapped: " << (this->IsMemoryMapped() ? "TRUE" : "FALSE") << std::endl;
+  os << indent << "NumberOfFrames: " << this->FrameIndex.size() << std::endl;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusChunkedSequenceIO::CanReadWriteFile(const std::string& filename)
+{
+  return vtksys::SystemTools::LowerCase(vtksys::SystemTools::GetFilenameLastExtension(filename)) == ".pseq";
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChunkedSequenceIO::Write(const std::string& filename, vtkIGSIOTrackedFrameList* frameList, bool useCompression /*= true*/, bool enableImageDataWrite /*= true*/, int numberOfCompressionThreads /*= 1*/)
+{
+  vtkSmartPointer<vtkPlusChunkedSequenceIO> writer = vtkSmartPointer<vtkPlusChunkedSequenceIO>::New();
+  writer->SetUseCompression(useCompression);
+  writer->SetEnableImageDataWrite(enableImageDataWrite);
+  writer->SetNumberOfCompressionThreads(numberOfCompressionThreads);
+  if (writer->OpenForWriting(filename) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  PlusStatus status = writer->AppendFramesInChunks(frameList, NUMBER_OF_FRAMES_PER_CHUNK);
+
+  if (writer->Close() != PLUS_SUCCESS)
+  {
+    status = PLUS_FAIL;
+  }
+  return status;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChunkedSequenceIO::Read(const std::string& filename, vtkIGSIOTrackedFrameList* frameList)
+{
+  vtkSmartPointer<vtkPlusChunkedSequenceIO> reader = vtkSmartPointer<vtkPlusChunkedSequenceIO>::New();
+  if (reader->OpenForReading(filename) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  PlusStatus status = reader->ReadAllFrames(frameList);
+  reader->Close();
+  return status;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChunkedSequenceIO::Recover(const std::string& filename)
+{
+  vtkSmartPointer<vtkPlusChunkedSequenceIO> recovery = vtkSmartPointer<vtkPlusChunkedSequenceIO>::New();
+  if (recovery->OpenForReading(filename) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  if (!recovery->IndexRecovered)
+  {
+    LOG_INFO("Sequence file " << filename << " is complete, it does not need recovery");
+    recovery->Close();
+    return PLUS_SUCCESS;
+  }
+
+  // Remove the incomplete data after the last valid chunk, then write the index as if the file was closed normally
+  recovery->FileStream.close();
+  if (TruncateFile(filename, recovery->DataEndOffset) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to remove incomplete data from the end of sequence file " << filename);
+    recovery->Close();
+    return PLUS_FAIL;
+  }
+  recovery->FileStream.open(filename.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+  if (!recovery->FileStream.is_open())
+  {
+    LOG_ERROR("Failed to open sequence file " << filename << " for writing");
+    recovery->Close();
+    return PLUS_FAIL;
+  }
+  recovery->OpenedForWriting = true;
+  LOG_INFO("Sequence file " << filename << " is recovered, it contains " << recovery->GetNumberOfFrames() << " frames");
+  return recovery->Close();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChunkedSequenceIO::OpenForWriting(const std::string& filename)
+{
+  this->Close();
+
+  this->FileStream.open(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!this->FileStream.is_open())
+  {
+    LOG_ERROR("Failed to open sequence file " << filename << " for writing");
+    return PLUS_FAIL;
+  }
+  this->FileName = filename;
+
+  std::vector<unsigned char> header(FILE_MAGIC, FILE_MAGIC + sizeof(FILE_MAGIC));
+  AppendUint32(header, FILE_FORMAT_VERSION);
+  AppendUint32(header, 0); // reserved
+  this->FileStream.write(reinterpret_cast<const char*>(&header[0]), header.size());
+  this->FileStream.flush();
+  if (!this->FileStream.good())
+  {
+    LOG_ERROR("Failed to write sequence file " << filename);
+    this->FileStream.close();
+    return PLUS_FAIL;
+  }
+
+  this->OpenedForWriting = true;
+  this->DataEndOffset = FILE_HEADER_SIZE;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChunkedSequenceIO::AppendFrames(vtkIGSIOTrackedFrameList* frameList)
+{
+  return this->AppendFrames(frameList, 0, frameList->GetNumberOfTrackedFrames());
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChunkedSequenceIO::AppendFrames(vtkIGSIOTrackedFrameList* frameList, unsigned int firstFrameIndex, unsigned int numberOfFrames)
+{
+  if (!this->OpenedForWriting)
+  {
+    LOG_ERROR("Cannot append frames, the sequence file is not opened for writing");
+    return PLUS_FAIL;
+  }
+
+  if (this->VerifyTimestampOrder(frameList, firstFrameIndex, numberOfFrames) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  if (this->WriteCustomFieldsIfChanged(frameList) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  if (numberOfFrames == 0)
+  {
+    return PLUS_SUCCESS;
+  }
+
+  std::vector<FrameIndexEntry> chunkFrameIndex;
+  this->WriteBuffer.clear();
+  for (unsigned int frameIndex = firstFrameIndex; frameIndex < firstFrameIndex + numberOfFrames; ++frameIndex)
+  {
+    igsioTrackedFrame* frame = frameList->GetTrackedFrame(frameIndex);
+    FrameIndexEntry entry;
+    entry.Timestamp = frame->GetTimestamp();
+    entry.ChunkOffset = this->DataEndOffset;
+    entry.FrameOffset = this->WriteBuffer.size();
+    if (SerializeFrame(this->WriteBuffer, frame, this->EnableImageDataWrite) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to write frame " << frameIndex << " to sequence file " << this->FileName);
+      return PLUS_FAIL;
+    }
+    chunkFrameIndex.push_back(entry);
+  }
+
+  if (this->WriteChunk(CHUNK_FRAMES, numberOfFrames, this->WriteBuffer) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  this->FrameIndex.insert(this->FrameIndex.end(), chunkFrameIndex.begin(), chunkFrameIndex.end());
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChunkedSequenceIO::VerifyTimestampOrder(vtkIGSIOTrackedFrameList* frameList, unsigned int firstFrameIndex, unsigned int numberOfFrames) const
+{
+  bool previousTimestampValid = !this->FrameIndex.empty();
+  double previousTimestamp = previousTimestampValid ? this->FrameIndex.back().Timestamp : 0.0;
+  for (unsigned int frameIndex = firstFrameIndex; frameIndex < firstFrameIndex + numberOfFrames; ++frameIndex)
+  {
+    double timestamp = frameList->GetTrackedFrame(frameIndex)->GetTimestamp();
+    if (previousTimestampValid && timestamp < previousTimestamp)
+    {
+      LOG_ERROR("Cannot append frames to sequence file " << this->FileName << ": frame " << frameIndex << " timestamp (" << std::fixed << timestamp
+                << ") is earlier than the previous frame timestamp (" << previousTimestamp << ")");
+      return PLUS_FAIL;
+    }
+    previousTimestamp = timestamp;
+    previousTimestampValid = true;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChunkedSequenceIO::AppendFramesInChunks(vtkIGSIOTrackedFrameList* frameList, unsigned int numberOfFramesPerChunk)
+{
+  if (!this->OpenedForWriting)
+  {
+    LOG_ERROR("Cannot append frames, the sequence file is not opened for writing");
+    return PLUS_FAIL;
+  }
+  if (numberOfFramesPerChunk == 0)
+  {
+    LOG_ERROR("Cannot append frames, the number of frames per chunk must be positive");
+    return PLUS_FAIL;
+  }
+
+  if (this->VerifyTimestampOrder(frameList, 0, frameList->GetNumberOfTrackedFrames()) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  if (this->WriteCustomFieldsIfChanged(frameList) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  const unsigned int numberOfFrames = frameList->GetNumberOfTrackedFrames();
+  const unsigned int numberOfChunks = (numberOfFrames + numberOfFramesPerChunk - 1) / numberOfFramesPerChunk;
+  if (numberOfChunks == 0)
+  {
+    return PLUS_SUCCESS;
+  }
+
+  int numberOfThreads = 1;
+  if (this->UseCompression)
+  {
+    numberOfThreads = (this->NumberOfCompressionThreads > 0 ? this->NumberOfCompressionThreads : vtkMultiThreader::GetGlobalDefaultNumberOfThreads());
+    numberOfThreads = std::max(1, std::min(numberOfThreads, VTK_MAX_THREADS));
+  }
+
+  // Chunks are serialized, compressed and written in batches of one chunk per thread, so that only a batch
+  // (and not the whole frame list) has to be kept in memory in serialized and compressed form
+  const unsigned int numberOfChunksPerBatch = static_cast<unsigned int>(numberOfThreads);
+  for (unsigned int batchFirstChunkIndex = 0; batchFirstChunkIndex < numberOfChunks; batchFirstChunkIndex += numberOfChunksPerBatch)
+  {
+    const unsigned int numberOfBatchChunks = std::min(numberOfChunksPerBatch, numberOfChunks - batchFirstChunkIndex);
+    const unsigned int batchFirstFrameIndex = batchFirstChunkIndex * numberOfFramesPerChunk;
+    const unsigned int numberOfBatchFrames = std::min(numberOfBatchChunks * numberOfFramesPerChunk, numberOfFrames - batchFirstFrameIndex);
+
+    // Serialize the chunks of the batch (chunk offsets are only known when the chunks are written)
+    std::vector<std::vector<unsigned char> > chunkData(numberOfBatchChunks);
+    std::vector<FrameIndexEntry> chunksFrameIndex;
+    chunksFrameIndex.reserve(numberOfBatchFrames);
+    for (unsigned int frameIndex = batchFirstFrameIndex; frameIndex < batchFirstFrameIndex + numberOfBatchFrames; ++frameIndex)
+    {
+      std::vector<unsigned char>& buffer = chunkData[(frameIndex - batchFirstFrameIndex) / numberOfFramesPerChunk];
+      igsioTrackedFrame* frame = frameList->GetTrackedFrame(frameIndex);
+      FrameIndexEntry entry;
+      entry.Timestamp = frame->GetTimestamp();
+      entry.ChunkOffset = 0;
+      entry.FrameOffset = buffer.size();
+      if (SerializeFrame(buffer, frame, this->EnableImageDataWrite) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to write frame " << frameIndex << " to sequence file " << this->FileName);
+        return PLUS_FAIL;
+      }
+      chunksFrameIndex.push_back(entry);
+    }
+
+    // Compress the chunks in parallel, compression is the most expensive part of writing
+    ChunkCompressionJob job;
+    job.ChunkData = &chunkData;
+    job.CompressedData.resize(numberOfBatchChunks);
+    job.Compressed.resize(numberOfBatchChunks, 0);
+    job.NextChunkIndex = 0;
+    job.Failed = false;
+    if (this->UseCompression)
+    {
+      const int numberOfBatchThreads = std::min(numberOfThreads, static_cast<int>(numberOfBatchChunks));
+      if (numberOfBatchThreads == 1)
+      {
+        vtkMultiThreader::ThreadInfo threadInfo;
+        threadInfo.UserData = &job;
+        CompressChunksThread(&threadInfo);
+      }
+      else
+      {
+        vtkSmartPointer<vtkMultiThreader> threader = vtkSmartPointer<vtkMultiThreader>::New();
+        threader->SetNumberOfThreads(numberOfBatchThreads);
+        threader->SetSingleMethod((vtkThreadFunctionType)&CompressChunksThread, &job);
+        threader->SingleMethodExecute();
+      }
+      if (job.Failed)
+      {
+        LOG_ERROR("Failed to compress chunk of sequence file " << this->FileName);
+        return PLUS_FAIL;
+      }
+    }
+
+    // Write the chunks in frame order
+    for (unsigned int chunkIndex = 0; chunkIndex < numberOfBatchChunks; ++chunkIndex)
+    {
+      const unsigned int firstFrameIndex = chunkIndex * numberOfFramesPerChunk;
+      const unsigned int numberOfChunkFrames = std::min(numberOfFramesPerChunk, numberOfBatchFrames - firstFrameIndex);
+      for (unsigned int frameIndex = firstFrameIndex; frameIndex < firstFrameIndex + numberOfChunkFrames; ++frameIndex)
+      {
+        chunksFrameIndex[frameIndex].ChunkOffset = this->DataEndOffset;
+      }
+      const std::vector<unsigned char>& data = chunkData[chunkIndex];
+      const bool compressed = (job.Compressed[chunkIndex] != 0);
+      const std::vector<unsigned char>& storedData = compressed ? job.CompressedData[chunkIndex] : data;
+      if (this->WriteStoredChunk(CHUNK_FRAMES, numberOfChunkFrames, data.size(), compressed, storedData.empty() ? NULL : &storedData[0], storedData.size()) != PLUS_SUCCESS)
+      {
+        return PLUS_FAIL;
+      }
+      this->FrameIndex.insert(this->FrameIndex.end(), chunksFrameIndex.begin() + firstFrameIndex, chunksFrameIndex.begin() + firstFrameIndex + numberOfChunkFrames);
+    }
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChunkedSequenceIO::WriteCustomFieldsIfChanged(vtkIGSIOTrackedFrameList* frameList)
+{
+  // Custom fields of the frame list (written only if they have changed, as each custom fields chunk replaces all the previous values)
+  std::vector<std::string> fieldNames;
+  frameList->GetCustomFieldNameList(fieldNames);
+  CustomFieldList customFields;
+  for (std::vector<std::string>::iterator it = fieldNames.begin(); it != fieldNames.end(); ++it)
+  {
+    const char* fieldValue = frameList->GetCustomString(it->c_str());
+    if (fieldValue != NULL)
+    {
+      customFields.push_back(std::make_pair(*it, std::string(fieldValue)));
+    }
+  }
+  if (customFields != this->CustomFields)
+  {
+    this->WriteBuffer.clear();
+    AppendCustomFields(this->WriteBuffer, customFields);
+    if (this->WriteChunk(CHUNK_CUSTOM_FIELDS, 0, this->WriteBuffer) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    this->CustomFields = customFields;
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChunkedSequenceIO::WriteChunk(unsigned int chunkType, unsigned int numberOfFrames, const std::vector<unsigned char>& data)
+{
+  bool compressed = false;
+  if (this->UseCompression && !CompressChunkData(data, this->CompressedBuffer, compressed))
+  {
+    LOG_ERROR("Failed to compress chunk of sequence file " << this->FileName);
+    return PLUS_FAIL;
+  }
+
+  // only store the compressed data if it is actually smaller
+  if (compressed)
+  {
+    return this->WriteStoredChunk(chunkType, numberOfFrames, data.size(), true, &this->CompressedBuffer[0], this->CompressedBuffer.size());
+  }
+  return this->WriteStoredChunk(chunkType, numberOfFrames, data.size(), false, data.empty() ? NULL : &data[0], data.size());
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChunkedSequenceIO::WriteStoredChunk(unsigned int chunkType, unsigned int numberOfFrames, uint64_t dataSize, bool compressed, const unsigned char* storedData, uint64_t storedSize)
+{
+  std::vector<unsigned char> header(CHUNK_MAGIC, CHUNK_MAGIC + sizeof(CHUNK_MAGIC));
+  AppendUint32(header, chunkType);
+  AppendUint32(header, compressed ? CHUNK_FLAG_COMPRESSED : 0);
+  AppendUint32(header, numberOfFrames);
+  AppendUint64(header, dataSize);
+  AppendUint64(header, storedSize);
+  AppendUint32(header, ComputeChecksum(storedData, storedSize));
+
+  this->FileStream.seekp(static_cast<std::streamoff>(this->DataEndOffset));
+  this->FileStream.write(reinterpret_cast<const char*>(&header[0]), header.size());
+  if (storedSize > 0)
+  {
+    this->FileStream.write(reinterpret_cast<const char*>(storedData), static_cast<std::streamsize>(storedSize));
+  }
+  // The chunk must be in the file before the next one is started, so that it can be recovered after a crash
+  this->FileStream.flush();
+  if (!this->FileStream.good())
+  {
+    LOG_ERROR("Failed to write chunk to sequence file " << this->FileName);
+    return PLUS_FAIL;
+  }
+
+  this->DataEndOffset += CHUNK_HEADER_SIZE + storedSize;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChunkedSequenceIO::OpenForReading(const std::string& filename)
+{
+  this->Close();
+
+  this->FileStream.open(filename.c_str(), std::ios::in | std::ios::binary);
+  if (!this->FileStream.is_open())
+  {
+    LOG_ERROR("Failed to open sequence file " << filename << " for reading");
+    return PLUS_FAIL;
+  }
+  this->FileName = filename;
+
+  this->FileStream.seekg(0, std::ios::end);
+  uint64_t fileSize = static_cast<uint64_t>(this->FileStream.tellg());
+  this->FileStream.seekg(0, std::ios::beg);
+
+  unsigned char header[FILE_HEADER_SIZE];
+  this->FileStream.read(reinterpret_cast<char*>(header), FILE_HEADER_SIZE);
+  ByteReader headerReader(header, FILE_HEADER_SIZE);
+  uint32_t version = 0;
+  if (!this->FileStream.good() || memcmp(header, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0
+      || !headerReader.Seek(sizeof(FILE_MAGIC)) || !headerReader.ReadUint32(version))
+  {
+    LOG_ERROR("File " << filename << " is not a chunked sequence file");
+    this->Close();
+    return PLUS_FAIL;
+  }
+  if (version > FILE_FORMAT_VERSION)
+  {
+    LOG_ERROR("Sequence file " << filename << " has unsupported format version " << version);
+    this->Close();
+    return PLUS_FAIL;
+  }
+
+  if (this->ReadIndex(fileSize) != PLUS_SUCCESS)
+  {
+    // The file was not closed properly (e.g., the application crashed during recording)
+    this->FileStream.clear();
+    this->ScanChunks(fileSize);
+    this->IndexRecovered = true;
+    LOG_WARNING("Sequence file " << filename << " has no valid frame index (recording may have been interrupted). "
+                << this->FrameIndex.size() << " frames are recovered.");
+  }
+
+  if (this->UseMemoryMapping && this->MapFile(fileSize) != PLUS_SUCCESS)
+  {
+    LOG_WARNING("Failed to memory-map sequence file " << filename << ", it is read without memory mapping");
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChunkedSequenceIO::MapFile(uint64_t fileSize)
+{
+  this->UnmapFile();
+  if (fileSize == 0 || fileSize > static_cast<uint64_t>((std::numeric_limits<size_t>::max)()))
+  {
+    return PLUS_FAIL;
+  }
+
+#ifdef _WIN32
+  HANDLE fileHandle = CreateFileA(this->FileName.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (fileHandle == INVALID_HANDLE_VALUE)
+  {
+    return PLUS_FAIL;
+  }
+  HANDLE mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle(fileHandle);
+  if (mappingHandle == NULL)
+  {
+    return PLUS_FAIL;
+  }
+  // The view keeps the file mapping alive, the handle is not needed anymore
+  void* mappedData = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, static_cast<SIZE_T>(fileSize));
+  CloseHandle(mappingHandle);
+  if (mappedData == NULL)
+  {
+    return PLUS_FAIL;
+  }
+#else
+  int fd = open(this->FileName.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    return PLUS_FAIL;
+  }
+  // The mapping keeps the file open, the descriptor is not needed anymore
+  void* mappedData = mmap(NULL, static_cast<size_t>(fileSize), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mappedData == MAP_FAILED)
+  {
+    return PLUS_FAIL;
+  }
+#endif
+
+  this->MappedData = static_cast<const unsigned char*>(mappedData);
+  this->MappedSize = fileSize;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusChunkedSequenceIO::UnmapFile()
+{
+  if (this->MappedData == NULL)
+  {
+    return;
+  }
+#ifdef _WIN32
+  UnmapViewOfFile(this->MappedData);
+#else
+  munmap(const_cast<unsigned char*>(this->MappedData), static_cast<size_t>(this->MappedSize));
+#endif
+  this->MappedData = NULL;
+  this->MappedSize = 0;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusChunkedSequenceIO::IsMemoryMapped() const
+{
+  return this->MappedData != NULL;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChunkedSequenceIO::ReadIndex(uint64_t fileSize)
+{
+  if (fileSize < FILE_HEADER_SIZE + INDEX_FOOTER_SIZE)
+  {
+    return PLUS_FAIL;
+  }
+
+  unsigned char footer[INDEX_FOOTER_SIZE];
+  this->FileStream.seekg(static_cast<std::streamoff>(fileSize - INDEX_FOOTER_SIZE));
+  this->FileStream.read(reinterpret_cast<char*>(footer), INDEX_FOOTER_SIZE);
+  ByteReader footerReader(footer, INDEX_FOOTER_SIZE);
+  uint64_t indexOffset = 0;
+  uint64_t indexSize = 0;
+  uint32_t indexChecksum = 0;
+  if (!this->FileStream.good() || !footerReader.ReadUint64(indexOffset) || !footerReader.ReadUint64(indexSize)
+      || !footerReader.ReadUint32(indexChecksum) || !footerReader.ReadMagic(INDEX_FOOTER_MAGIC))
+  {
+    return PLUS_FAIL;
+  }
+  if (indexOffset < FILE_HEADER_SIZE || indexOffset + indexSize != fileSize - INDEX_FOOTER_SIZE)
+  {
+    return PLUS_FAIL;
+  }
+
+  std::vector<unsigned char> index(static_cast<size_t>(indexSize));
+  this->FileStream.seekg(static_cast<std::streamoff>(indexOffset));
+  if (indexSize > 0)
+  {
+    this->FileStream.read(reinterpret_cast<char*>(&index[0]), static_cast<std::streamsize>(indexSize));
+  }
+  if (!this->FileStream.good() || ComputeChecksum(index.empty() ? NULL : &index[0], indexSize) != indexChecksum)
+  {
+    return PLUS_FAIL;
+  }
+
+  ByteReader reader(index.empty() ? NULL : &index[0], index.size());
+  uint32_t numberOfFrames = 0;
+  if (!reader.ReadMagic(INDEX_MAGIC) || !reader.ReadUint32(numberOfFrames))
+  {
+    return PLUS_FAIL;
+  }
+  std::vector<FrameIndexEntry> frameIndex(numberOfFrames);
+  for (uint32_t i = 0; i < numberOfFrames; ++i)
+  {
+    if (!reader.ReadDouble(frameIndex[i].Timestamp) || !reader.ReadUint64(frameIndex[i].ChunkOffset) || !reader.ReadUint64(frameIndex[i].FrameOffset)
+        || frameIndex[i].ChunkOffset >= indexOffset)
+    {
+      return PLUS_FAIL;
+    }
+  }
+  CustomFieldList customFields;
+  if (!ReadCustomFields(reader, customFields))
+  {
+    return PLUS_FAIL;
+  }
+
+  this->FrameIndex.swap(frameIndex);
+  this->CustomFields.swap(customFields);
+  this->DataEndOffset = indexOffset;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChunkedSequenceIO::ScanChunks(uint64_t fileSize)
+{
+  this->FrameIndex.clear();
+  this->CustomFields.clear();
+
+  uint64_t chunkOffset = FILE_HEADER_SIZE;
+  while (chunkOffset + CHUNK_HEADER_SIZE <= fileSize)
+  {
+    unsigned int chunkType = 0;
+    unsigned int numberOfFrames = 0;
+    uint64_t chunkSize = 0;
+    if (this->ReadChunk(chunkOffset, fileSize, true, chunkType, numberOfFrames, chunkSize) != PLUS_SUCCESS)
+    {
+      // Incomplete chunk (or the frame index of a file that was closed properly), the rest of the file is ignored
+      break;
+    }
+
+    if (chunkType == CHUNK_FRAMES)
+    {
+      std::vector<FrameIndexEntry> chunkFrameIndex;
+      ByteReader reader(this->ChunkDataPointer, static_cast<size_t>(this->ChunkDataSize));
+      bool valid = true;
+      for (unsigned int i = 0; i < numberOfFrames && valid; ++i)
+      {
+        FrameIndexEntry entry;
+        entry.ChunkOffset = chunkOffset;
+        entry.FrameOffset = reader.GetPosition();
+        valid = DeserializeFrame(reader, NULL, entry.Timestamp);
+        chunkFrameIndex.push_back(entry);
+      }
+      if (!valid)
+      {
+        break;
+      }
+      this->FrameIndex.insert(this->FrameIndex.end(), chunkFrameIndex.begin(), chunkFrameIndex.end());
+    }
+    else if (chunkType == CHUNK_CUSTOM_FIELDS)
+    {
+      ByteReader reader(this->ChunkDataPointer, static_cast<size_t>(this->ChunkDataSize));
+      CustomFieldList customFields;
+      if (!ReadCustomFields(reader, customFields))
+      {
+        break;
+      }
+      this->CustomFields.swap(customFields);
+    }
+    // Unknown chunk types are skipped
+
+    chunkOffset += chunkSize;
+  }
+
+  this->DataEndOffset = chunkOffset;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChunkedSequenceIO::ReadChunk(uint64_t chunkOffset, uint64_t fileSize, bool verifyChecksum, unsigned int& chunkType, unsigned int& numberOfFrames, uint64_t& chunkSize)
+{
+  this->ChunkDataValid = false;
+  if (chunkOffset + CHUNK_HEADER_SIZE > fileSize)
+  {
+    return PLUS_FAIL;
+  }
+
+  unsigned char header[CHUNK_HEADER_SIZE];
+  if (this->MappedData != NULL)
+  {
+    memcpy(header, this->MappedData + chunkOffset, CHUNK_HEADER_SIZE);
+  }
+  else
+  {
+    this->FileStream.seekg(static_cast<std::streamoff>(chunkOffset));
+    this->FileStream.read(reinterpret_cast<char*>(header), CHUNK_HEADER_SIZE);
+  }
+  ByteReader headerReader(header, CHUNK_HEADER_SIZE);
+  uint32_t type = 0;
+  uint32_t flags = 0;
+  uint32_t frames = 0;
+  uint64_t dataSize = 0;
+  uint64_t storedSize = 0;
+  uint32_t checksum = 0;
+  if (!this->FileStream.good() || !headerReader.ReadMagic(CHUNK_MAGIC) || !headerReader.ReadUint32(type) || !headerReader.ReadUint32(flags)
+      || !headerReader.ReadUint32(frames) || !headerReader.ReadUint64(dataSize) || !headerReader.ReadUint64(storedSize) || !headerReader.ReadUint32(checksum))
+  {
+    this->FileStream.clear();
+    return PLUS_FAIL;
+  }
+  if (storedSize > fileSize - chunkOffset - CHUNK_HEADER_SIZE)
+  {
+    // truncated chunk
+    return PLUS_FAIL;
+  }
+  bool compressed = (flags & CHUNK_FLAG_COMPRESSED) != 0;
+  if ((!compressed && storedSize != dataSize) || (compressed && dataSize > storedSize * MAX_COMPRESSION_RATIO))
+  {
+    return PLUS_FAIL;
+  }
+
+  const unsigned char* storedData = NULL;
+  if (this->MappedData != NULL)
+  {
+    // The data is accessed in the mapped file, it is only loaded from the disk when it is used
+    storedData = this->MappedData + chunkOffset + CHUNK_HEADER_SIZE;
+    if (verifyChecksum && ComputeChecksum(storedData, storedSize) != checksum)
+    {
+      return PLUS_FAIL;
+    }
+  }
+  else
+  {
+    std::vector<unsigned char>& storedDataBuffer = compressed ? this->CompressedBuffer : this->ChunkData;
+    storedDataBuffer.resize(static_cast<size_t>(storedSize));
+    if (storedSize > 0)
+    {
+      this->FileStream.read(reinterpret_cast<char*>(&storedDataBuffer[0]), static_cast<std::streamsize>(storedSize));
+    }
+    storedData = storedDataBuffer.empty() ? NULL : &storedDataBuffer[0];
+    if (!this->FileStream.good() || ComputeChecksum(storedData, storedSize) != checksum)
+    {
+      this->FileStream.clear();
+      return PLUS_FAIL;
+    }
+  }
+
+  if (compressed)
+  {
+    this->ChunkData.resize(static_cast<size_t>(dataSize));
+    uLongf uncompressedSize = static_cast<uLongf>(dataSize);
+    if (dataSize == 0
+        || uncompress(&this->ChunkData[0], &uncompressedSize, storedData, static_cast<uLong>(storedSize)) != Z_OK
+        || uncompressedSize != dataSize)
+    {
+      LOG_ERROR("Failed to uncompress chunk at position " << chunkOffset << " of sequence file " << this->FileName);
+      return PLUS_FAIL;
+    }
+    this->ChunkDataPointer = &this->ChunkData[0];
+  }
+  else
+  {
+    this->ChunkDataPointer = storedData;
+  }
+  this->ChunkDataSize = dataSize;
+
+  chunkType = type;
+  numberOfFrames = frames;
+  chunkSize = CHUNK_HEADER_SIZE + storedSize;
+  this->ChunkDataOffset = chunkOffset;
+  this->ChunkDataValid = true;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChunkedSequenceIO::Close()
+{
+  PlusStatus status = PLUS_SUCCESS;
+  if (this->FileStream.is_open() && this->OpenedForWriting)
+  {
+    // Append the frame index and the footer that points to it
+    std::vector<unsigned char> index(INDEX_MAGIC, INDEX_MAGIC + sizeof(INDEX_MAGIC));
+    AppendUint32(index, static_cast<uint32_t>(this->FrameIndex.size()));
+    for (std::vector<FrameIndexEntry>::iterator it = this->FrameIndex.begin(); it != this->FrameIndex.end(); ++it)
+    {
+      AppendDouble(index, it->Timestamp);
+      AppendUint64(index, it->ChunkOffset);
+      AppendUint64(index, it->FrameOffset);
+    }
+    AppendCustomFields(index, this->CustomFields);
+
+    std::vector<unsigned char> footer;
+    AppendUint64(footer, this->DataEndOffset);
+    AppendUint64(footer, index.size());
+    AppendUint32(footer, ComputeChecksum(&index[0], index.size()));
+    footer.insert(footer.end(), INDEX_FOOTER_MAGIC, INDEX_FOOTER_MAGIC + sizeof(INDEX_FOOTER_MAGIC));
+
+    this->FileStream.seekp(static_cast<std::streamoff>(this->DataEndOffset));
+    this->FileStream.write(reinterpret_cast<const char*>(&index[0]), index.size());
+    this->FileStream.write(reinterpret_cast<const char*>(&footer[0]), footer.size());
+    this->FileStream.flush();
+    if (!this->FileStream.good())
+    {
+      LOG_ERROR("Failed to write frame index to sequence file " << this->FileName);
+      status = PLUS_FAIL;
+    }
+  }
+  this->UnmapFile();
+  if (this->FileStream.is_open())
+  {
+    this->FileStream.close();
+  }
+  this->FileStream.clear();
+
+  this->OpenedForWriting = false;
+  this->IndexRecovered = false;
+  this->FrameIndex.clear();
+  this->CustomFields.clear();
+  this->DataEndOffset = 0;
+  this->ChunkData.clear();
+  this->ChunkDataPointer = NULL;
+  this->ChunkDataSize = 0;
+  this->ChunkDataValid = false;
+  return status;
+}
+
+//----------------------------------------------------------------------------
+unsigned int vtkPlusChunkedSequenceIO::GetNumberOfFrames() const
+{
+  return static_cast<unsigned int>(this->FrameIndex.size());
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChunkedSequenceIO::GetFrameTimestamp(unsigned int frameIndex, double& timestamp) const
+{
+  if (frameIndex >= this->FrameIndex.size())
+  {
+    LOG_ERROR("Frame index " << frameIndex << " is out of range (number of frames: " << this->FrameIndex.size() << ")");
+    return PLUS_FAIL;
+  }
+  timestamp = this->FrameIndex[frameIndex].Timestamp;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChunkedSequenceIO::GetFrameIndexForTimestamp(double timestamp, unsigned int& frameIndex) const
+{
+  if (this->FrameIndex.empty())
+  {
+    LOG_ERROR("Cannot find frame by timestamp, the sequence file contains no frames");
+    return PLUS_FAIL;
+  }
+  std::vector<FrameIndexEntry>::const_iterator it = std::upper_bound(this->FrameIndex.begin(), this->FrameIndex.end(), timestamp,
+      [](double value, const FrameIndexEntry & entry) { return value < entry.Timestamp; });
+  frameIndex = (it == this->FrameIndex.begin()) ? 0 : static_cast<unsigned int>(it - this->FrameIndex.begin() - 1);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChunkedSequenceIO::ReadFrame(unsigned int frameIndex, igsioTrackedFrame& frame, bool readImageData /*= true*/)
+{
+  if (this->OpenedForWriting)
+  {
+    LOG_ERROR("Cannot read frames, the sequence file is opened for writing");
+    return PLUS_FAIL;
+  }
+  if (frameIndex >= this->FrameIndex.size())
+  {
+    LOG_ERROR("Frame index " << frameIndex << " is out of range (number of frames: " << this->FrameIndex.size() << ")");
+    return PLUS_FAIL;
+  }
+
+  const FrameIndexEntry& entry = this->FrameIndex[frameIndex];
+  if (!this->ChunkDataValid || this->ChunkDataOffset != entry.ChunkOffset)
+  {
+    unsigned int chunkType = 0;
+    unsigned int numberOfFrames = 0;
+    uint64_t chunkSize = 0;
+    // Chunks were already verified when the index was built by scanning, otherwise the index is protected by its own checksum
+    if (this->ReadChunk(entry.ChunkOffset, this->DataEndOffset, !this->IsMemoryMapped(), chunkType, numberOfFrames, chunkSize) != PLUS_SUCCESS || chunkType != CHUNK_FRAMES)
+    {
+      LOG_ERROR("Failed to read frame " << frameIndex << " from sequence file " << this->FileName << ": chunk is corrupted");
+      this->ChunkDataValid = false;
+      return PLUS_FAIL;
+    }
+  }
+
+  ByteReader reader(this->ChunkDataPointer, static_cast<size_t>(this->ChunkDataSize));
+  double timestamp = 0;
+  if (!reader.Seek(entry.FrameOffset) || !DeserializeFrame(reader, &frame, timestamp, readImageData))
+  {
+    LOG_ERROR("Failed to read frame " << frameIndex << " from sequence file " << this->FileName << ": frame data is corrupted");
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChunkedSequenceIO::ReadAllFrames(vtkIGSIOTrackedFrameList* frameList, bool readImageData /*= true*/)
+{
+  this->GetCustomFields(frameList);
+
+  for (unsigned int frameIndex = 0; frameIndex < this->FrameIndex.size(); ++frameIndex)
+  {
+    igsioTrackedFrame frame;
+    if (this->ReadFrame(frameIndex, frame, readImageData) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    frameList->AddTrackedFrame(&frame);
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusChunkedSequenceIO::GetCustomFields(vtkIGSIOTrackedFrameList* frameList) const
+{
+  for (CustomFieldList::const_iterator it = this->CustomFields.begin(); it != this->CustomFields.end(); ++it)
+  {
+    frameList->SetCustomString(it->first.c_str(), it->second.c_str());
+  }
+}
@@ -0,0 +1,240 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusChunkedSequenceIO_h
+#define __vtkPlusChunkedSequenceIO_h
+
+#include "vtkPlusCommonExport.h"
+
+#include "igsioCommon.h"
+
+// VTK includes
+#include <vtkObject.h>
+
+// STL includes
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+class igsioTrackedFrame;
+class vtkIGSIOTrackedFrameList;
+
+/*!
+  \class vtkPlusChunkedSequenceIO
+  \brief Reads and writes tracked frame sequences in the append-only chunked sequence format (.pseq)
+
+  The file is a sequence of self-describing chunks, each containing a number of frames (timestamp, frame fields
+  including transforms, and image data). Each chunk is protected by a checksum and may be compressed (zlib).
+  Chunks are only appended, the already written data is never modified, therefore if the recording is interrupted
+  (e.g., the application crashes) then all the chunks that were completely written remain readable.
+
+  When the file is closed, an index of the frames (timestamp and location of each frame) is appended to the end of the file.
+  The index allows finding frames by timestamp (binary search) and reading any frame without parsing the rest of the file.
+  If the index is missing or corrupted then it is rebuilt by scanning the chunks when the file is opened, and the file can be
+  repaired by Recover().
+
+  Files that are opened for reading can be memory-mapped (see UseMemoryMapping), so that frames of uncompressed chunks
+  are read directly from the mapped file and only the accessed parts of the file are loaded into memory.
+
+  \ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport vtkPlusChunkedSequenceIO : public vtkObject
+{
+public:
+  static vtkPlusChunkedSequenceIO* New();
+  vtkTypeMacro(vtkPlusChunkedSequenceIO, vtkObject);
+  virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
+
+  /*! Returns true if the file name has the extension of the chunked sequence format (.pseq) */
+  static bool CanReadWriteFile(const std::string& filename);
+
+  /*! Write all the frames of the list to a file */
+  static PlusStatus Write(const std::string& filename, vtkIGSIOTrackedFrameList* frameList, bool useCompression = true, bool enableImageDataWrite = true, int numberOfCompressionThreads = 1);
+
+  /*! Read all the frames of a file into the list */
+  static PlusStatus Read(const std::string& filename, vtkIGSIOTrackedFrameList* frameList);
+
+  /*!
+    Remove the incompletely written data from the end of the file and write the frame index,
+    so that the file can be opened without scanning all the chunks
+  */
+  static PlusStatus Recover(const std::string& filename);
+
+  /*! Create a new file for writing. An existing file with the same name is overwritten. */
+  PlusStatus OpenForWriting(const std::string& filename);
+
+  /*!
+    Append all the frames of the list to the file as one chunk. The chunk is flushed to the file
+    before returning, so that the frames are not lost if the application is terminated unexpectedly.
+    Custom fields of the frame list are written if they have changed since the last call.
+    Frames must be in timestamp order: if a frame is acquired earlier than the previous frame then no frames are written and PLUS_FAIL is returned.
+  */
+  PlusStatus AppendFrames(vtkIGSIOTrackedFrameList* frameList);
+
+  /*!
+    Append all the frames of the list to the file, in chunks of numberOfFramesPerChunk frames.
+    The chunks are compressed in parallel (see NumberOfCompressionThreads) and written in frame order. Chunks are processed
+    in batches of one chunk per thread, so memory need does not grow with the number of frames in the list.
+    Custom fields of the frame list are written if they have changed since the last call.
+    Frames must be in timestamp order, the same way as for AppendFrames.
+  */
+  PlusStatus AppendFramesInChunks(vtkIGSIOTrackedFrameList* frameList, unsigned int numberOfFramesPerChunk);
+
+  /*! Open a file for reading. If the file has no valid frame index then the index is rebuilt by scanning the chunks. */
+  PlusStatus OpenForReading(const std::string& filename);
+
+  /*! Write the frame index (if the file was opened for writing) and close the file */
+  PlusStatus Close();
+
+  /*! Number of frames in the file that is opened for reading or writing */
+  unsigned int GetNumberOfFrames() const;
+
+  /*! Timestamp of a frame in the file that is opened for reading */
+  PlusStatus GetFrameTimestamp(unsigned int frameIndex, double& timestamp) const;
+
+  /*!
+    Index of the last frame that is acquired not later than the timestamp (the first frame if all the frames are acquired later).
+    Timestamps of the frames must be increasing.
+  */
+  PlusStatus GetFrameIndexForTimestamp(double timestamp, unsigned int& frameIndex) const;
+
+  /*! Read a single frame from the file that is opened for reading. If readImageData is false then only the timestamp and frame fields are read. */
+  PlusStatus ReadFrame(unsigned int frameIndex, igsioTrackedFrame& frame, bool readImageData = true);
+
+  /*! Read all the frames and the custom fields from the file that is opened for reading. If readImageData is false then images are not read. */
+  PlusStatus ReadAllFrames(vtkIGSIOTrackedFrameList* frameList, bool readImageData = true);
+
+  /*! Copy the custom fields of the file that is opened for reading to the frame list */
+  void GetCustomFields(vtkIGSIOTrackedFrameList* frameList) const;
+
+  /*! If enabled then chunks are compressed by zlib */
+  vtkSetMacro(UseCompression, bool);
+  vtkGetMacro(UseCompression, bool);
+  vtkBooleanMacro(UseCompression, bool);
+
+  /*! If disabled then only the timestamps and frame fields are written (image data is omitted) */
+  vtkSetMacro(EnableImageDataWrite, bool);
+  vtkGetMacro(EnableImageDataWrite, bool);
+  vtkBooleanMacro(EnableImageDataWrite, bool);
+
+  /*!
+    Number of threads that compress the chunks written by AppendFramesInChunks and Write.
+    If 0 then the number of threads is determined automatically. Default is 1.
+  */
+  vtkSetMacro(NumberOfCompressionThreads, int);
+  vtkGetMacro(NumberOfCompressionThreads, int);
+
+  /*!
+    If enabled then the file is memory-mapped when it is opened for reading. Frames of uncompressed chunks are then
+    read directly from the mapped memory without reading the whole chunk, and the checksum of such chunks is only verified
+    when the chunks are scanned (when the file has no valid index). If the file cannot be mapped (e.g., it is larger than
+    the address space) then it is read normally.
+  */
+  vtkSetMacro(UseMemoryMapping, bool);
+  vtkGetMacro(UseMemoryMapping, bool);
+  vtkBooleanMacro(UseMemoryMapping, bool);
+
+  /*! True if the file that is opened for reading is memory-mapped */
+  bool IsMemoryMapped() const;
+
+  /*! True if the frame index of the file that is opened for reading was rebuilt by scanning the chunks */
+  vtkGetMacro(IndexRecovered, bool);
+
+  /*! Name of the file that is currently open */
+  vtkGetStdStringMacro(FileName);
+
+protected:
+  vtkPlusChunkedSequenceIO();
+  virtual ~vtkPlusChunkedSequenceIO();
+
+  /*! Location of a frame in the file */
+  struct FrameIndexEntry
+  {
+    double Timestamp;
+    /*! Position of the chunk in the file */
+    uint64_t ChunkOffset;
+    /*! Position of the frame in the uncompressed data of the chunk */
+    uint64_t FrameOffset;
+  };
+
+  /*! Name and value of a custom field of the frame list */
+  typedef std::vector<std::pair<std::string, std::string> > CustomFieldList;
+
+  /*! Read the frame index from the end of the file. Returns PLUS_FAIL if there is no valid index. */
+  PlusStatus ReadIndex(uint64_t fileSize);
+
+  /*! Rebuild the frame index by reading all the chunks. Reading stops at the first incomplete or corrupted chunk. */
+  PlusStatus ScanChunks(uint64_t fileSize);
+
+  /*!
+    Read and uncompress a chunk, the data is available in ChunkDataPointer. Returns PLUS_FAIL if the chunk is incomplete or corrupted.
+    If verifyChecksum is false then the checksum of memory-mapped uncompressed chunks is not computed.
+  */
+  PlusStatus ReadChunk(uint64_t chunkOffset, uint64_t fileSize, bool verifyChecksum, unsigned int& chunkType, unsigned int& numberOfFrames, uint64_t& chunkSize);
+
+  /*! Map the file that is opened for reading into memory */
+  PlusStatus MapFile(uint64_t fileSize);
+
+  /*! Release the memory mapping of the file */
+  void UnmapFile();
+
+  /*! Append frames of the list to the file as one chunk */
+  PlusStatus AppendFrames(vtkIGSIOTrackedFrameList* frameList, unsigned int firstFrameIndex, unsigned int numberOfFrames);
+
+  /*!
+    Returns PLUS_FAIL if the timestamps of the frames are not increasing (including the last frame that is already in the file),
+    as the frames could not be found by timestamp in the file
+  */
+  PlusStatus VerifyTimestampOrder(vtkIGSIOTrackedFrameList* frameList, unsigned int firstFrameIndex, unsigned int numberOfFrames) const;
+
+  /*! Write a custom fields chunk if the custom fields of the frame list differ from the last written ones */
+  PlusStatus WriteCustomFieldsIfChanged(vtkIGSIOTrackedFrameList* frameList);
+
+  /*! Write a chunk from the uncompressed data */
+  PlusStatus WriteChunk(unsigned int chunkType, unsigned int numberOfFrames, const std::vector<unsigned char>& data);
+
+  /*! Write a chunk from the data as it is stored in the file (compressed if the compressed flag is set) */
+  PlusStatus WriteStoredChunk(unsigned int chunkType, unsigned int numberOfFrames, uint64_t dataSize, bool compressed, const unsigned char* storedData, uint64_t storedSize);
+
+  std::string FileName;
+  std::fstream FileStream;
+  bool OpenedForWriting;
+
+  bool UseCompression;
+  bool EnableImageDataWrite;
+  bool IndexRecovered;
+  bool UseMemoryMapping;
+  int NumberOfCompressionThreads;
+
+  /*! Memory-mapped content of the file that is opened for reading (NULL if the file is not mapped) */
+  const unsigned char* MappedData;
+  uint64_t MappedSize;
+
+  std::vector<FrameIndexEntry> FrameIndex;
+  CustomFieldList CustomFields;
+
+  /*! Position of the end of the last complete chunk */
+  uint64_t DataEndOffset;
+
+  /*! Uncompressed data of the chunk that was read last (reading frames of the same chunk does not need reading the file again) */
+  std::vector<unsigned char> ChunkData;
+  /*! Points to ChunkData or directly into the mapped file (for uncompressed chunks of memory-mapped files) */
+  const unsigned char* ChunkDataPointer;
+  uint64_t ChunkDataSize;
+  uint64_t ChunkDataOffset;
+  bool ChunkDataValid;
+
+  /*! Temporary buffers for writing chunks */
+  std::vector<unsigned char> WriteBuffer;
+  std::vector<unsigned char> CompressedBuffer;
+
+private:
+  vtkPlusChunkedSequenceIO(const vtkPlusChunkedSequenceIO&);   // Not implemented.
+  void operator=(const vtkPlusChunkedSequenceIO&);   // Not implemented.
+};
+
+#endif // __vtkPlusChunkedSequenceIO_h
@@ -5,12 +5,15 @@
 =========================================================Plus=header=end*/
 
 #include "PlusConfigure.h"
+#include "vtkPlusChunkedSequenceIO.h"
 #include "vtkPlusSequenceIO.h"
 
 #include <vtkIGSIOSequenceIO.h>
+#include <vtkIGSIOTrackedFrameList.h>
 
 /// VTK includes
 #include <vtkNew.h>
+#include <vtkSmartPointer.h>
 
 //----------------------------------------------------------------------------
 igsioStatus vtkPlusSequenceIO::Write(const std::string& filename, vtkIGSIOTrackedFrameList* frameList, US_IMAGE_ORIENTATION orientationInFile/*=US_IMG_ORIENT_MF*/, bool useCompression/*=true*/, bool enableImageDataWrite/*=true*/)
@@ -20,6 +23,12 @@ igsioStatus vtkPlusSequenceIO::Write(const std::string& filename, vtkIGSIOTracke
   {
     outputDirectory = vtkPlusConfig::GetInstance()->GetOutputDirectory();
   }
+  if (vtkPlusChunkedSequenceIO::CanReadWriteFile(filename))
+  {
+    // Frames are stored in their current orientation
+    std::string path = outputDirectory.empty() ? filename : outputDirectory + "/" + filename;
+    return vtkPlusChunkedSequenceIO::Write(path, frameList, useCompression, enableImageDataWrite);
+  }
   return vtkIGSIOSequenceIO::Write(filename, outputDirectory, frameList, orientationInFile, useCompression, enableImageDataWrite);
 }
 
@@ -31,6 +40,13 @@ igsioStatus vtkPlusSequenceIO::Write(const std::string& filename, igsioTrackedFr
   {
     outputDirectory = vtkPlusConfig::GetInstance()->GetOutputDirectory();
   }
+  if (vtkPlusChunkedSequenceIO::CanReadWriteFile(filename))
+  {
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> frameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    frameList->AddTrackedFrame(frame);
+    std::string path = outputDirectory.empty() ? filename : outputDirectory + "/" + filename;
+    return vtkPlusChunkedSequenceIO::Write(path, frameList, useCompression, enableImageDataWrite);
+  }
   return vtkIGSIOSequenceIO::Write(filename, outputDirectory, frame, orientationInFile, useCompression, enableImageDataWrite);
 }
 
@@ -48,5 +64,9 @@ igsioStatus vtkPlusSequenceIO::Read(const std::string& trackedSequenceDataFileNa
       return PLUS_FAIL;
     }
   }
+  if (vtkPlusChunkedSequenceIO::CanReadWriteFile(trackedSequenceDataFilePath))
+  {
+    return vtkPlusChunkedSequenceIO::Read(trackedSequenceDataFilePath, frameList);
+  }
   return vtkIGSIOSequenceIO::Read(trackedSequenceDataFilePath, frameList);
 }
@@ -63,6 +63,10 @@ void vtkPlusOpenIGTLinkDevice::PrintSelf(ostream& os, vtkIndent indent)
   {
     os << indent << "Image stream: " << this->ImageMessageEmbeddedTransformName.GetTransformName() << "\n";
   }
+  if (!this->ImageMessageCompression.empty())
+  {
+    os << indent << "Image compression: " << this->ImageMessageCompression << "\n";
+  }
 }
 //----------------------------------------------------------------------------
 std::string vtkPlusOpenIGTLinkDevice::GetSdkVersion()
@@ -185,6 +189,10 @@ PlusStatus vtkPlusOpenIGTLinkDevice::SendRequestedMessageTypes()
     PlusIgtlClientInfo::ImageStream is;
     is.Name = this->ImageMessageEmbeddedTransformName.From();
     is.EmbeddedTransformToFrame = this->ImageMessageEmbeddedTransformName.To();
+    if (!this->ImageMessageCompression.empty())
+    {
+      is.Compression = igtl::PlusCompressedImageMessage::GetCompressionMethodFromString(this->ImageMessageCompression);
+    }
     clientInfo.ImageStreams.push_back(is);
   }
 
@@ -62,6 +62,11 @@ public:
   /*! Get image streams to be sent when message type is a type that sends an image */
   vtkGetMacro(ImageMessageEmbeddedTransformName, igsioTransformName);
 
+  /*! Set lossless compression of the requested image stream ("None" or "DeltaZlib") */
+  vtkSetStdStringMacro(ImageMessageCompression);
+  /*! Get lossless compression of the requested image stream */
+  vtkGetStdStringMacro(ImageMessageCompression);
+
   /*! Set OpenIGTLink server address */
   vtkSetStdStringMacro(ServerAddress);
   /*! Get OpenIGTLink server address */
@@ -129,6 +134,9 @@ protected:
   /*! Image stream to send when message type wants to send an image */
   igsioTransformName ImageMessageEmbeddedTransformName;
 
+  /*! Lossless compression requested for the image stream. If empty then the images are not compressed. */
+  std::string ImageMessageCompression;
+
   /*! OpenIGTLink server address */
   std::string ServerAddress;
 
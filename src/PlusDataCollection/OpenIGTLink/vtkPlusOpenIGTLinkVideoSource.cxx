@@ -82,6 +82,14 @@ PlusStatus vtkPlusOpenIGTLinkVideoSource::InternalUpdate()
       return PLUS_FAIL;
     }
   }
+  else if (typeid(*bodyMsg) == typeid(igtl::PlusCompressedImageMessage))
+  {
+    if (vtkPlusIgtlMessageCommon::UnpackCompressedImageMessage(bodyMsg, this->ClientSocket, trackedFrame, this->ImageMessageEmbeddedTransformName, this->ImageDecompressionState, this->IgtlMessageCrcCheckEnabled) != PLUS_SUCCESS)
+    {
+      // Errors are already logged. If a frame has been dropped then frames cannot be decoded until the next key frame, skip them.
+      return PLUS_SUCCESS;
+    }
+  }
   else if (typeid(*bodyMsg) == typeid(igtl::PlusTrackedFrameMessage))
   {
     if (vtkPlusIgtlMessageCommon::UnpackTrackedFrameMessage(bodyMsg, this->ClientSocket, trackedFrame, this->ImageMessageEmbeddedTransformName, this->IgtlMessageCrcCheckEnabled) != PLUS_SUCCESS)
@@ -152,6 +160,7 @@ PlusStatus vtkPlusOpenIGTLinkVideoSource::ReadConfiguration(vtkXMLDataElement* r
 {
   XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_READING(deviceConfig, rootConfigElement);
   XML_READ_STRING_ATTRIBUTE_OPTIONAL(ImageMessageEmbeddedTransformName, deviceConfig);
+  XML_READ_STRING_ATTRIBUTE_OPTIONAL(ImageMessageCompression, deviceConfig);
   return PLUS_SUCCESS;
 }
 
@@ -160,6 +169,7 @@ PlusStatus vtkPlusOpenIGTLinkVideoSource::WriteConfiguration(vtkXMLDataElement*
 {
   XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_WRITING(deviceConfig, rootConfigElement);
   deviceConfig->SetAttribute("ImageMessageEmbeddedTransformName", this->ImageMessageEmbeddedTransformName.GetTransformName().c_str());
+  XML_WRITE_STRING_ATTRIBUTE_IF_NOT_EMPTY(ImageMessageCompression, deviceConfig);
   return PLUS_SUCCESS;
 }
 
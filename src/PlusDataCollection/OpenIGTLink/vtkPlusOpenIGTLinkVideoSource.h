@@ -11,6 +11,7 @@
 #include "vtkPlusDataCollectionExport.h"
 #include "vtkPlusOpenIGTLinkDevice.h"
 #include "vtkPlusIgtlMessageFactory.h"
+#include "igtlPlusCompressedImageMessage.h"
 
 /*!
   \class vtkPlusOpenIGTLinkVideoSource
@@ -48,6 +49,9 @@ protected:
   vtkPlusOpenIGTLinkVideoSource();
   virtual ~vtkPlusOpenIGTLinkVideoSource();
 
+  /*! Previous frame of the received compressed image stream */
+  igtl::PlusCompressedImageMessage::CompressionState ImageDecompressionState;
+
 private:
   vtkPlusOpenIGTLinkVideoSource(const vtkPlusOpenIGTLinkVideoSource&);   // Not implemented.
   void operator=(const vtkPlusOpenIGTLinkVideoSource&);   // Not implemented.
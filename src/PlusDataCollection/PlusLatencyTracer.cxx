@@ -0,0 +1,281 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusLatencyTracer.h"
+
+// STL includes
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+
+namespace
+{
+  // Latencies are collected with 0.1ms resolution up to 1 sec, longer latencies are counted in the last bin
+  const double HISTOGRAM_BIN_WIDTH_SEC = 0.0001;
+  const unsigned int HISTOGRAM_NUMBER_OF_BINS = 10000;
+
+  const unsigned int DEFAULT_MAX_NUMBER_OF_TRACE_EVENTS = 100000;
+
+  //----------------------------------------------------------------------------
+  std::string EscapeJsonString(const std::string& str)
+  {
+    std::string escaped;
+    for (std::string::const_iterator it = str.begin(); it != str.end(); ++it)
+    {
+      if (*it == '"' || *it == '\\')
+      {
+        escaped += '\\';
+      }
+      escaped += *it;
+    }
+    return escaped;
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusLatencyTracer::Histogram::Histogram()
+  : BinCounts(HISTOGRAM_NUMBER_OF_BINS, 0)
+  , NumberOfSamples(0)
+  , MaxSec(0.0)
+{
+}
+
+//----------------------------------------------------------------------------
+PlusLatencyTracer::PlusLatencyTracer()
+  : Enabled(false)
+  , MaxNumberOfTraceEvents(DEFAULT_MAX_NUMBER_OF_TRACE_EVENTS)
+  , NextTraceEventIndex(0)
+{
+}
+
+//----------------------------------------------------------------------------
+PlusLatencyTracer* PlusLatencyTracer::GetInstance()
+{
+  static PlusLatencyTracer instance;
+  return &instance;
+}
+
+//----------------------------------------------------------------------------
+std::string PlusLatencyTracer::GetStageName(Stage stage)
+{
+  switch (stage)
+  {
+    case STAGE_ACQUIRED:
+      return "Acquired";
+    case STAGE_TIMESTAMP_FILTERED:
+      return "TimestampFiltered";
+    case STAGE_CHANNEL_READ:
+      return "ChannelRead";
+    case STAGE_PROCESSED:
+      return "Processed";
+    case STAGE_PACKED:
+      return "Packed";
+    case STAGE_SENT:
+      return "Sent";
+    default:
+      return "Unknown";
+  }
+}
+
+//----------------------------------------------------------------------------
+void PlusLatencyTracer::SetEnabled(bool enabled)
+{
+  this->Enabled.store(enabled);
+}
+
+//----------------------------------------------------------------------------
+void PlusLatencyTracer::SetMaxNumberOfTraceEvents(unsigned int maxNumberOfTraceEvents)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->MaxNumberOfTraceEvents = maxNumberOfTraceEvents;
+  this->TraceEvents.clear();
+  this->NextTraceEventIndex = 0;
+}
+
+//----------------------------------------------------------------------------
+unsigned int PlusLatencyTracer::GetMaxNumberOfTraceEvents()
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  return this->MaxNumberOfTraceEvents;
+}
+
+//----------------------------------------------------------------------------
+int PlusLatencyTracer::GetTrackIndex(Stage stage, const std::string& component)
+{
+  std::pair<int, std::string> track(stage, component);
+  std::map<std::pair<int, std::string>, int>::iterator trackIt = this->TrackIndices.find(track);
+  if (trackIt != this->TrackIndices.end())
+  {
+    return trackIt->second;
+  }
+  int trackIndex = static_cast<int>(this->Tracks.size());
+  this->Tracks.push_back(track);
+  this->Histograms.push_back(Histogram());
+  this->TrackIndices[track] = trackIndex;
+  return trackIndex;
+}
+
+//----------------------------------------------------------------------------
+void PlusLatencyTracer::AddEvent(Stage stage, double itemTimestamp, const std::string& component/*=""*/)
+{
+  if (!this->GetEnabled())
+  {
+    return;
+  }
+  double eventTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  double latencySec = eventTime - itemTimestamp;
+
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  int trackIndex = this->GetTrackIndex(stage, component);
+
+  Histogram& histogram = this->Histograms[trackIndex];
+  // Timestamps of some devices may be slightly in the future (e.g., due to timestamp filtering), count them as zero latency
+  unsigned int binIndex = (latencySec > 0 ? static_cast<unsigned int>(std::min<double>(latencySec / HISTOGRAM_BIN_WIDTH_SEC, HISTOGRAM_NUMBER_OF_BINS - 1)) : 0);
+  histogram.BinCounts[binIndex]++;
+  histogram.NumberOfSamples++;
+  histogram.MaxSec = std::max(histogram.MaxSec, latencySec);
+
+  if (this->MaxNumberOfTraceEvents == 0)
+  {
+    return;
+  }
+  TraceEvent traceEvent;
+  traceEvent.TrackIndex = trackIndex;
+  traceEvent.ItemTimestamp = itemTimestamp;
+  traceEvent.EventTime = eventTime;
+  if (this->TraceEvents.size() < this->MaxNumberOfTraceEvents)
+  {
+    this->TraceEvents.push_back(traceEvent);
+  }
+  else
+  {
+    this->TraceEvents[this->NextTraceEventIndex] = traceEvent;
+  }
+  this->NextTraceEventIndex = (this->NextTraceEventIndex + 1) % this->MaxNumberOfTraceEvents;
+}
+
+//----------------------------------------------------------------------------
+void PlusLatencyTracer::Reset()
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->TrackIndices.clear();
+  this->Tracks.clear();
+  this->Histograms.clear();
+  this->TraceEvents.clear();
+  this->NextTraceEventIndex = 0;
+}
+
+//----------------------------------------------------------------------------
+double PlusLatencyTracer::GetPercentile(const Histogram& histogram, double fraction)
+{
+  if (histogram.NumberOfSamples == 0)
+  {
+    return 0.0;
+  }
+  unsigned long rank = static_cast<unsigned long>(std::ceil(fraction * histogram.NumberOfSamples));
+  rank = std::max<unsigned long>(rank, 1);
+  unsigned long cumulativeCount = 0;
+  for (unsigned int binIndex = 0; binIndex < histogram.BinCounts.size(); ++binIndex)
+  {
+    cumulativeCount += histogram.BinCounts[binIndex];
+    if (cumulativeCount >= rank)
+    {
+      // The maximum is exact, do not report more than that
+      return std::min((binIndex + 1) * HISTOGRAM_BIN_WIDTH_SEC, histogram.MaxSec);
+    }
+  }
+  return histogram.MaxSec;
+}
+
+//----------------------------------------------------------------------------
+void PlusLatencyTracer::GetStatistics(std::vector<StageStatistics>& statistics)
+{
+  statistics.clear();
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  // TrackIndices is ordered by stage, then by component
+  for (std::map<std::pair<int, std::string>, int>::iterator trackIt = this->TrackIndices.begin(); trackIt != this->TrackIndices.end(); ++trackIt)
+  {
+    const Histogram& histogram = this->Histograms[trackIt->second];
+    StageStatistics stageStatistics;
+    stageStatistics.Name = GetStageName(static_cast<Stage>(trackIt->first.first));
+    if (!trackIt->first.second.empty())
+    {
+      stageStatistics.Name += " (" + trackIt->first.second + ")";
+    }
+    stageStatistics.NumberOfSamples = histogram.NumberOfSamples;
+    stageStatistics.MedianSec = GetPercentile(histogram, 0.5);
+    stageStatistics.Percentile99Sec = GetPercentile(histogram, 0.99);
+    stageStatistics.MaxSec = histogram.MaxSec;
+    statistics.push_back(stageStatistics);
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusLatencyTracer::WriteChromeTrace(const std::string& fileName)
+{
+  std::ofstream traceFile(fileName.c_str());
+  if (!traceFile.is_open())
+  {
+    LOG_ERROR("Failed to open latency trace file for writing: " << fileName);
+    return PLUS_FAIL;
+  }
+
+  std::lock_guard<std::mutex> lock(this->Mutex);
+
+  // Times are written in microseconds, relative to the earliest item timestamp
+  double startTime = 0.0;
+  for (std::vector<TraceEvent>::iterator eventIt = this->TraceEvents.begin(); eventIt != this->TraceEvents.end(); ++eventIt)
+  {
+    if (eventIt == this->TraceEvents.begin() || eventIt->ItemTimestamp < startTime)
+    {
+      startTime = eventIt->ItemTimestamp;
+    }
+  }
+
+  traceFile << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl;
+  bool firstEvent = true;
+
+  // Each stage and component is shown as a separate named track
+  for (unsigned int trackIndex = 0; trackIndex < this->Tracks.size(); ++trackIndex)
+  {
+    std::string trackName = GetStageName(static_cast<Stage>(this->Tracks[trackIndex].first));
+    if (!this->Tracks[trackIndex].second.empty())
+    {
+      trackName += " (" + this->Tracks[trackIndex].second + ")";
+    }
+    traceFile << (firstEvent ? "" : ",\n")
+              << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << trackIndex
+              << ",\"args\":{\"name\":\"" << EscapeJsonString(trackName) << "\"}},\n"
+              << "{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":" << trackIndex
+              << ",\"args\":{\"sort_index\":" << this->Tracks[trackIndex].first << "}}";
+    firstEvent = false;
+  }
+
+  // Write events in chronological order: oldest event is at NextTraceEventIndex if the circular buffer is full
+  unsigned int numberOfEvents = static_cast<unsigned int>(this->TraceEvents.size());
+  unsigned int oldestEventIndex = (numberOfEvents < this->MaxNumberOfTraceEvents ? 0 : this->NextTraceEventIndex);
+  traceFile << std::fixed << std::setprecision(1);
+  for (unsigned int i = 0; i < numberOfEvents; ++i)
+  {
+    const TraceEvent& traceEvent = this->TraceEvents[(oldestEventIndex + i) % numberOfEvents];
+    double durationUs = std::max(0.0, (traceEvent.EventTime - traceEvent.ItemTimestamp) * 1e6);
+    traceFile << (firstEvent ? "" : ",\n")
+              << "{\"name\":\"" << GetStageName(static_cast<Stage>(this->Tracks[traceEvent.TrackIndex].first)) << "\",\"cat\":\"latency\",\"ph\":\"X\",\"pid\":1,\"tid\":" << traceEvent.TrackIndex
+              << ",\"ts\":" << (traceEvent.ItemTimestamp - startTime) * 1e6 << ",\"dur\":" << durationUs << "}";
+    firstEvent = false;
+  }
+  traceFile << "\n]}" << std::endl;
+
+  if (!traceFile.good())
+  {
+    LOG_ERROR("Failed to write latency trace file: " << fileName);
+    return PLUS_FAIL;
+  }
+  LOG_INFO("Latency trace with " << numberOfEvents << " events is written to " << fileName);
+  return PLUS_SUCCESS;
+}
@@ -0,0 +1,130 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusLatencyTracer_h
+#define __PlusLatencyTracer_h
+
+#include "PlusConfigure.h"
+#include "vtkPlusDataCollectionExport.h"
+
+// STL includes
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*!
+  \class PlusLatencyTracer
+  \brief Collects the latency of data items at the stages of the acquisition-to-OpenIGTLink pipeline
+
+  Each stage reports when an item reached it, together with the timestamp of the item (system time).
+  The latency of the stage is the difference between the two. Latencies are aggregated into a histogram
+  for each stage (and component, such as the ID of the virtual device that processed the item), and the
+  most recent events are kept for exporting them as a Chrome trace (chrome://tracing, Perfetto).
+
+  Tracing is disabled by default. When disabled, reporting an event costs only an atomic flag check.
+  The acquisition stages are reported where the buffers add items to the timestamp report
+  (see vtkPlusTimestampedCircularBuffer::AddToTimeStampReport).
+
+  \ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport PlusLatencyTracer
+{
+public:
+  enum Stage
+  {
+    STAGE_ACQUIRED,           ///< Item is added to a device buffer, latency is measured from the unfiltered timestamp
+    STAGE_TIMESTAMP_FILTERED, ///< Filtered timestamp of the item is computed, latency is measured from here on from the filtered timestamp
+    STAGE_CHANNEL_READ,       ///< Tracked frame is read from a channel
+    STAGE_PROCESSED,          ///< Item is processed by a virtual device (component: device ID)
+    STAGE_PACKED,             ///< OpenIGTLink messages are packed from the tracked frame
+    STAGE_SENT,               ///< OpenIGTLink message is sent to a client
+    NUMBER_OF_STAGES
+  };
+
+  struct StageStatistics
+  {
+    /*! Name of the stage, followed by the component in parentheses if there is one */
+    std::string Name;
+    unsigned long NumberOfSamples;
+    double MedianSec;
+    double Percentile99Sec;
+    double MaxSec;
+  };
+
+  static PlusLatencyTracer* GetInstance();
+
+  /*! Enable or disable collecting events. Collected data is kept until Reset is called. */
+  void SetEnabled(bool enabled);
+  bool GetEnabled() const { return this->Enabled.load(std::memory_order_relaxed); }
+
+  /*!
+    Record that an item reached a stage. Does nothing if tracing is disabled.
+    \param stage Stage that the item reached
+    \param itemTimestamp Timestamp of the item in system time, the latency is measured from this time
+    \param component Optional name of the component that the item passed through (e.g., device ID)
+  */
+  void AddEvent(Stage stage, double itemTimestamp, const std::string& component = "");
+
+  /*! Remove all collected histograms and events */
+  void Reset();
+
+  /*! Get latency statistics of all the stages that have been reached by at least one item, in pipeline order */
+  void GetStatistics(std::vector<StageStatistics>& statistics);
+
+  /*! Write the collected events to a file in Chrome trace event format (JSON) */
+  PlusStatus WriteChromeTrace(const std::string& fileName);
+
+  /*! Maximum number of most recent events that are kept for the Chrome trace */
+  void SetMaxNumberOfTraceEvents(unsigned int maxNumberOfTraceEvents);
+  unsigned int GetMaxNumberOfTraceEvents();
+
+  static std::string GetStageName(Stage stage);
+
+protected:
+  PlusLatencyTracer();
+
+  struct Histogram
+  {
+    Histogram();
+    std::vector<unsigned long> BinCounts;
+    unsigned long NumberOfSamples;
+    double MaxSec;
+  };
+
+  struct TraceEvent
+  {
+    int TrackIndex;
+    double ItemTimestamp;
+    double EventTime;
+  };
+
+  /*! Returns the value below which the requested fraction of the samples fall (upper edge of the histogram bin) */
+  static double GetPercentile(const Histogram& histogram, double fraction);
+
+  /*! Get the index of a stage and component in Tracks, add it if it is not found yet. The caller must lock Mutex. */
+  int GetTrackIndex(Stage stage, const std::string& component);
+
+  std::atomic<bool> Enabled;
+  std::mutex Mutex;
+
+  /*! Stage and component pairs that have been reached, the histogram and trace events refer to them by index */
+  std::map<std::pair<int, std::string>, int> TrackIndices;
+  std::vector<std::pair<int, std::string> > Tracks;
+  std::vector<Histogram> Histograms;
+
+  /*! Circular buffer of the most recent events */
+  std::vector<TraceEvent> TraceEvents;
+  unsigned int MaxNumberOfTraceEvents;
+  unsigned int NextTraceEventIndex;
+
+private:
+  PlusLatencyTracer(const PlusLatencyTracer&);
+  void operator=(const PlusLatencyTracer&);
+};
+
+#endif
@@ -0,0 +1,45 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusNewItemSignal.h"
+
+// STL includes
+#include <chrono>
+
+//----------------------------------------------------------------------------
+PlusNewItemSignal::PlusNewItemSignal()
+  : NotificationCount(0)
+  , LastSeenNotificationCount(0)
+{
+}
+
+//----------------------------------------------------------------------------
+void PlusNewItemSignal::Notify()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    this->NotificationCount++;
+  }
+  this->NewItemAdded.notify_all();
+}
+
+//----------------------------------------------------------------------------
+bool PlusNewItemSignal::Wait(double timeoutSec)
+{
+  std::unique_lock<std::mutex> lock(this->Mutex);
+  // Compare to the count at the start of this call and not to LastSeenNotificationCount, because another waiting
+  // thread may update LastSeenNotificationCount before this thread wakes up
+  const unsigned long notificationCountAtStart = this->NotificationCount;
+  bool newItemAdded = (notificationCountAtStart != this->LastSeenNotificationCount);
+  if (!newItemAdded)
+  {
+    newItemAdded = this->NewItemAdded.wait_for(lock, std::chrono::duration<double>(timeoutSec > 0 ? timeoutSec : 0.0),
+                   [this, notificationCountAtStart] { return this->NotificationCount != notificationCountAtStart; });
+  }
+  this->LastSeenNotificationCount = this->NotificationCount;
+  return newItemAdded;
+}
@@ -0,0 +1,52 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusNewItemSignal_h
+#define __PlusNewItemSignal_h
+
+#include "vtkPlusDataCollectionExport.h"
+
+// STL includes
+#include <condition_variable>
+#include <mutex>
+
+/*!
+  \class PlusNewItemSignal
+  \brief Wakes up a waiting thread when new items are added to the buffers that it observes
+
+  The signal can be added to any number of buffers (see vtkPlusBuffer::AddNewItemSignal), so one thread
+  can wait for new data in all of its input buffers at once. If multiple threads wait on the same signal then
+  all of them are woken up by a notification.
+
+  \ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport PlusNewItemSignal
+{
+public:
+  PlusNewItemSignal();
+
+  /*! Called by the buffers when a new item has been added */
+  void Notify();
+
+  /*!
+    Wait until a new item is added to any of the observed buffers or the timeout expires.
+    Returns immediately if an item has been added since the previous Wait call (of any thread) returned.
+    \return true if an item has been added, false if the timeout expired
+  */
+  bool Wait(double timeoutSec);
+
+protected:
+  std::mutex Mutex;
+  std::condition_variable NewItemAdded;
+  unsigned long NotificationCount;
+  unsigned long LastSeenNotificationCount;
+
+private:
+  PlusNewItemSignal(const PlusNewItemSignal&);
+  void operator=(const PlusNewItemSignal&);
+};
+
+#endif
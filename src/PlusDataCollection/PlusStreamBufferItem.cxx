@@ -6,7 +6,10 @@
 
 #include "PlusConfigure.h"
 #include "PlusStreamBufferItem.h"
+#include "vtkDataArray.h"
+#include "vtkImageData.h"
 #include "vtkMatrix4x4.h"
+#include "vtkPointData.h"
 
 //----------------------------------------------------------------------------
 //            DataBufferItem
@@ -44,6 +47,8 @@ StreamBufferItem& StreamBufferItem::operator=(StreamBufferItem const& dataItem)
     return *this;
   }
 
+  // The frame is copied into the existing pixel storage, which must not be visible to other items
+  this->DetachFrameStorage();
   this->Frame = dataItem.Frame;
   this->FilteredTimeStamp = dataItem.FilteredTimeStamp;
   this->UnfilteredTimeStamp = dataItem.UnfilteredTimeStamp;
@@ -121,6 +126,84 @@ PlusStatus StreamBufferItem::DeepCopy(StreamBufferItem* dataItem)
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus StreamBufferItem::ShallowCopy(StreamBufferItem* dataItem)
+{
+  if (dataItem == NULL)
+  {
+    LOG_ERROR("Failed to shallow copy data buffer item - buffer item NULL!");
+    return PLUS_FAIL;
+  }
+
+  if (this == dataItem)
+  {
+    return PLUS_SUCCESS;
+  }
+
+  if (!dataItem->HasValidVideoData() || dataItem->Frame.IsFrameEncoded())
+  {
+    // No raw pixel storage to share
+    (*this) = (*dataItem);
+    return PLUS_SUCCESS;
+  }
+
+  vtkImageData* sourceImage = dataItem->Frame.GetImage();
+  if (this->Frame.GetImage() == NULL)
+  {
+    // Minimal allocation, just to have an image object that can reference the shared storage
+    FrameSizeType minimalFrameSize = { 1, 1, 1 };
+    if (this->Frame.AllocateFrame(minimalFrameSize, sourceImage->GetScalarType(), sourceImage->GetNumberOfScalarComponents()) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to shallow copy data buffer item - cannot create output image!");
+      return PLUS_FAIL;
+    }
+  }
+  this->Frame.GetImage()->ShallowCopy(sourceImage);
+  this->Frame.SetImageType(dataItem->Frame.GetImageType());
+  this->Frame.SetImageOrientation(dataItem->Frame.GetImageOrientation());
+
+  this->FilteredTimeStamp = dataItem->FilteredTimeStamp;
+  this->UnfilteredTimeStamp = dataItem->UnfilteredTimeStamp;
+  this->Index = dataItem->Index;
+  this->Uid = dataItem->Uid;
+  this->FrameFields = dataItem->FrameFields;
+  this->Status = dataItem->Status;
+  this->Matrix->DeepCopy(dataItem->Matrix);
+  this->ValidTransformData = dataItem->ValidTransformData;
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+bool StreamBufferItem::IsFrameStorageShared() const
+{
+  vtkImageData* image = this->Frame.GetImage();
+  if (image == NULL || image->GetPointData()->GetScalars() == NULL)
+  {
+    return false;
+  }
+  return image->GetPointData()->GetScalars()->GetReferenceCount() > 1;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus StreamBufferItem::DetachFrameStorage()
+{
+  if (!this->IsFrameStorageShared())
+  {
+    return PLUS_SUCCESS;
+  }
+
+  // Other items still reference the current storage, leave it to them and allocate a new one with the same layout
+  vtkDataArray* sharedScalars = this->Frame.GetImage()->GetPointData()->GetScalars();
+  vtkSmartPointer<vtkDataArray> ownScalars = vtkSmartPointer<vtkDataArray>::Take(sharedScalars->NewInstance());
+  ownScalars->SetName(sharedScalars->GetName());
+  ownScalars->SetNumberOfComponents(sharedScalars->GetNumberOfComponents());
+  ownScalars->SetNumberOfTuples(sharedScalars->GetNumberOfTuples());
+  this->Frame.GetImage()->GetPointData()->SetScalars(ownScalars);
+
+  return PLUS_SUCCESS;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus StreamBufferItem::SetMatrix(vtkMatrix4x4* matrix)
 {
@@ -151,6 +234,18 @@ PlusStatus StreamBufferItem::GetMatrix(vtkMatrix4x4* outputMatrix)
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+void StreamBufferItem::GetPose(double pose[12]) const
+{
+  for (int row = 0; row < 3; ++row)
+  {
+    for (int column = 0; column < 4; ++column)
+    {
+      pose[row * 4 + column] = this->Matrix->Element[row][column];
+    }
+  }
+}
+
 //----------------------------------------------------------------------------
 void StreamBufferItem::SetStatus(ToolStatus status)
 {
@@ -85,12 +85,32 @@ public:
   /*! Copy stream buffer item */
   PlusStatus DeepCopy(StreamBufferItem* dataItem);
 
+  /*!
+    Copy stream buffer item, but reference the pixel storage of the video frame instead of copying it.
+    The pixel storage is reference counted, so it remains valid after the source item is overwritten:
+    the owner of the source item has to call DetachFrameStorage before modifying the pixels.
+    The pixel data of the resulting item must be treated as read-only.
+    Encoded frames are deep copied.
+  */
+  PlusStatus ShallowCopy(StreamBufferItem* dataItem);
+
+  /*! Returns true if the pixel storage of the video frame is referenced by other items as well */
+  bool IsFrameStorageShared() const;
+
+  /*!
+    Make the video frame use its own pixel storage if the storage is currently shared with other items.
+    The content of the new storage is undefined, the caller is expected to overwrite it.
+  */
+  PlusStatus DetachFrameStorage();
+
   igsioVideoFrame& GetFrame() { return this->Frame; };
 
   /*! Set tracker matrix */
   PlusStatus SetMatrix(vtkMatrix4x4* matrix);
   /*! Get tracker matrix */
   PlusStatus GetMatrix(vtkMatrix4x4* outputMatrix);
+  /*! Get the first 3 rows of the tracker matrix (row-major, 12 values) without creating a matrix object */
+  void GetPose(double pose[12]) const;
 
   /*! Set tracker item status */
   void SetStatus(ToolStatus status);
@@ -0,0 +1,341 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusTimestampPublisher.h"
+
+namespace
+{
+  /*! Registers a lock-free query, so that the published rings that it may use are not deleted while it is running */
+  class LockFreeReaderGuard
+  {
+  public:
+    explicit LockFreeReaderGuard(std::atomic<int>& activeReaders)
+      : ActiveReaders(activeReaders)
+    {
+      this->ActiveReaders.fetch_add(1, std::memory_order_seq_cst);
+    }
+    ~LockFreeReaderGuard()
+    {
+      this->ActiveReaders.fetch_sub(1, std::memory_order_seq_cst);
+    }
+  private:
+    std::atomic<int>& ActiveReaders;
+  };
+}
+
+//----------------------------------------------------------------------------
+PlusTimestampPublisher::PublishedItemRing::PublishedItemRing(int size)
+  : Items(size > 0 ? size : 1)
+{
+  for (std::vector<PublishedItem>::iterator it = this->Items.begin(); it != this->Items.end(); ++it)
+  {
+    it->Sequence.store(1, std::memory_order_relaxed);
+    it->FilteredTimestamp.store(0.0, std::memory_order_relaxed);
+  }
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+//----------------------------------------------------------------------------
+void PlusTimestampPublisher::PublishedItemRing::Invalidate()
+{
+  for (std::vector<PublishedItem>::iterator it = this->Items.begin(); it != this->Items.end(); ++it)
+  {
+    // odd sequence number never matches a valid item
+    it->Sequence.store(1, std::memory_order_release);
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusTimestampPublisher::PlusTimestampPublisher()
+  : PublishedItems(NULL)
+  , ActiveLockFreeReaders(0)
+  , PublishedLatestItemUid(0)
+  , PublishedOldestItemUid(1)
+{
+}
+
+//----------------------------------------------------------------------------
+PlusTimestampPublisher::~PlusTimestampPublisher()
+{
+  delete this->PublishedItems.load();
+  this->PublishedItems.store(NULL);
+  for (std::vector<PublishedItemRing*>::iterator it = this->RetiredPublishedItems.begin(); it != this->RetiredPublishedItems.end(); ++it)
+  {
+    delete *it;
+  }
+  this->RetiredPublishedItems.clear();
+}
+
+//----------------------------------------------------------------------------
+void PlusTimestampPublisher::Publish(BufferItemUidType uid, double filteredTimestamp, BufferItemUidType oldestItemUid)
+{
+  // the caller must have locked the buffer, so there is only one writer
+  if (!this->RetiredPublishedItems.empty())
+  {
+    this->DeleteRetiredPublishedItems();
+  }
+
+  PublishedItemRing* ring = this->PublishedItems.load(std::memory_order_relaxed);
+  if (ring == NULL)
+  {
+    return;
+  }
+
+  // Readers must not look for the item that is overwritten now
+  this->PublishedOldestItemUid.store(oldestItemUid, std::memory_order_release);
+
+  PublishedItem& item = ring->Items[uid % ring->Items.size()];
+  item.Sequence.store(2 * uid - 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  item.FilteredTimestamp.store(filteredTimestamp, std::memory_order_relaxed);
+  item.Sequence.store(2 * uid, std::memory_order_release);
+
+  this->PublishedLatestItemUid.store(uid, std::memory_order_release);
+}
+
+//----------------------------------------------------------------------------
+void PlusTimestampPublisher::Rebuild(bool enabled, int bufferSize, BufferItemUidType latestItemUid, int numberOfItems, const FilteredTimestampGetterType& getFilteredTimestamp)
+{
+  // the caller must have locked the buffer
+  PublishedItemRing* oldRing = this->PublishedItems.load(std::memory_order_relaxed);
+  PublishedItemRing* newRing = NULL;
+  if (enabled)
+  {
+    size_t ringSize = (bufferSize > 0 ? bufferSize : 1);
+    if (oldRing != NULL && oldRing->Items.size() == ringSize)
+    {
+      // Same size (Clear, DeepCopy): refill the current ring in place, readers see each item either invalid or up-to-date
+      oldRing->Invalidate();
+      newRing = oldRing;
+    }
+    else
+    {
+      newRing = new PublishedItemRing(bufferSize);
+    }
+  }
+
+  this->PublishedLatestItemUid.store(latestItemUid, std::memory_order_release);
+  this->PublishedOldestItemUid.store(latestItemUid - (numberOfItems - 1), std::memory_order_release);
+
+  if (newRing != NULL && numberOfItems > 0)
+  {
+    for (BufferItemUidType uid = latestItemUid - (numberOfItems - 1); uid <= latestItemUid; ++uid)
+    {
+      double filteredTimestamp(0);
+      if (!getFilteredTimestamp(uid, filteredTimestamp))
+      {
+        continue;
+      }
+      PublishedItem& item = newRing->Items[uid % newRing->Items.size()];
+      item.FilteredTimestamp.store(filteredTimestamp, std::memory_order_relaxed);
+      item.Sequence.store(2 * uid, std::memory_order_release);
+    }
+  }
+
+  if (newRing != oldRing)
+  {
+    this->PublishedItems.store(newRing, std::memory_order_seq_cst);
+    if (oldRing != NULL)
+    {
+      oldRing->Invalidate();
+      this->RetiredPublishedItems.push_back(oldRing);
+    }
+  }
+  this->DeleteRetiredPublishedItems();
+}
+
+//----------------------------------------------------------------------------
+void PlusTimestampPublisher::DeleteRetiredPublishedItems()
+{
+  // the caller must have locked the buffer.
+  // Readers register themselves before they load the ring pointer, so if there are no active readers now then
+  // all the readers that come later will see the current ring.
+  if (this->RetiredPublishedItems.empty() || this->ActiveLockFreeReaders.load(std::memory_order_seq_cst) != 0)
+  {
+    return;
+  }
+  for (std::vector<PublishedItemRing*>::iterator it = this->RetiredPublishedItems.begin(); it != this->RetiredPublishedItems.end(); ++it)
+  {
+    delete *it;
+  }
+  this->RetiredPublishedItems.clear();
+}
+
+//----------------------------------------------------------------------------
+bool PlusTimestampPublisher::ReadPublishedTimestamp(PublishedItemRing* ring, BufferItemUidType uid, double& filteredTimestamp)
+{
+  const PublishedItem& item = ring->Items[uid % ring->Items.size()];
+  BufferItemUidType sequenceBefore = item.Sequence.load(std::memory_order_acquire);
+  if (sequenceBefore != 2 * uid)
+  {
+    return false;
+  }
+  filteredTimestamp = item.FilteredTimestamp.load(std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  BufferItemUidType sequenceAfter = item.Sequence.load(std::memory_order_relaxed);
+  return sequenceAfter == sequenceBefore;
+}
+
+//----------------------------------------------------------------------------
+bool PlusTimestampPublisher::IsEnabled() const
+{
+  return this->PublishedItems.load(std::memory_order_acquire) != NULL;
+}
+
+//----------------------------------------------------------------------------
+BufferItemUidType PlusTimestampPublisher::GetLatestItemUid() const
+{
+  return this->PublishedLatestItemUid.load(std::memory_order_acquire);
+}
+
+//----------------------------------------------------------------------------
+BufferItemUidType PlusTimestampPublisher::GetOldestItemUid() const
+{
+  return this->PublishedOldestItemUid.load(std::memory_order_acquire);
+}
+
+//----------------------------------------------------------------------------
+bool PlusTimestampPublisher::GetFilteredTimestamp(BufferItemUidType uid, double& filteredTimestamp, ItemStatus& status)
+{
+  LockFreeReaderGuard readerGuard(this->ActiveLockFreeReaders);
+  for (int attempt = 0; attempt < MAX_LOCK_FREE_READ_ATTEMPTS; ++attempt)
+  {
+    PublishedItemRing* ring = this->PublishedItems.load(std::memory_order_seq_cst);
+    if (ring == NULL)
+    {
+      return false;
+    }
+    if (ReadPublishedTimestamp(ring, uid, filteredTimestamp))
+    {
+      status = ITEM_OK;
+      return true;
+    }
+    if (uid > this->PublishedLatestItemUid.load(std::memory_order_acquire))
+    {
+      filteredTimestamp = 0;
+      status = ITEM_NOT_AVAILABLE_YET;
+      return true;
+    }
+    if (uid < this->PublishedOldestItemUid.load(std::memory_order_acquire))
+    {
+      filteredTimestamp = 0;
+      status = ITEM_NOT_AVAILABLE_ANYMORE;
+      return true;
+    }
+    // the item was being written, try again
+  }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+bool PlusTimestampPublisher::GetOldestFilteredTimestamp(double& filteredTimestamp)
+{
+  // The oldest item may be overwritten between getting its UID and its timestamp, so retry a few times
+  for (int attempt = 0; attempt < MAX_LOCK_FREE_READ_ATTEMPTS && this->IsEnabled(); ++attempt)
+  {
+    ItemStatus status = ITEM_UNKNOWN_ERROR;
+    if (this->GetFilteredTimestamp(this->GetOldestItemUid(), filteredTimestamp, status) && status == ITEM_OK)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+// Divide-and-conquer search for the item that best matches the given timestamp, with the timestamps read from the
+// published item ring. If any of the visited items is overwritten during the search then the search is restarted.
+bool PlusTimestampPublisher::GetItemUidFromTime(double time, double localTimeOffsetSec, double negligibleTimeDifferenceSec, BufferItemUidType& uid, ItemStatus& status)
+{
+  LockFreeReaderGuard readerGuard(this->ActiveLockFreeReaders);
+  for (int attempt = 0; attempt < MAX_LOCK_FREE_READ_ATTEMPTS; ++attempt)
+  {
+    PublishedItemRing* ring = this->PublishedItems.load(std::memory_order_seq_cst);
+    if (ring == NULL)
+    {
+      return false;
+    }
+
+    BufferItemUidType hi = this->PublishedLatestItemUid.load(std::memory_order_acquire);
+    BufferItemUidType lo = this->PublishedOldestItemUid.load(std::memory_order_acquire);
+    if (hi == 0)
+    {
+      // buffer is empty
+      status = ITEM_NOT_AVAILABLE_YET;
+      return true;
+    }
+    if (lo > hi)
+    {
+      // oldest and latest UID were read while a new item was added
+      continue;
+    }
+
+    double tlo(0);
+    double thi(0);
+    if (!ReadPublishedTimestamp(ring, lo, tlo) || !ReadPublishedTimestamp(ring, hi, thi))
+    {
+      continue;
+    }
+
+    if (lo == hi)
+    {
+      // There is only one item, it's the closest one to any timestamp
+      uid = hi;
+      status = ITEM_OK;
+      return true;
+    }
+
+    tlo += localTimeOffsetSec;
+    thi += localTimeOffsetSec;
+
+    // If the timestamp is slightly out of range then still accept it
+    // (due to errors in conversions there could be slight differences)
+    if (time < tlo - negligibleTimeDifferenceSec)
+    {
+      status = ITEM_NOT_AVAILABLE_ANYMORE;
+      return true;
+    }
+    else if (time > thi + negligibleTimeDifferenceSec)
+    {
+      status = ITEM_NOT_AVAILABLE_YET;
+      return true;
+    }
+
+    bool itemOverwritten = false;
+    while (hi - lo > 1)
+    {
+      BufferItemUidType mid = (lo + hi) / 2;
+      double tmid(0);
+      if (!ReadPublishedTimestamp(ring, mid, tmid))
+      {
+        itemOverwritten = true;
+        break;
+      }
+      tmid += localTimeOffsetSec;
+      if (time < tmid)
+      {
+        hi = mid;
+        thi = tmid;
+      }
+      else
+      {
+        lo = mid;
+        tlo = tmid;
+      }
+    }
+    if (itemOverwritten)
+    {
+      continue;
+    }
+
+    uid = (time - tlo > thi - time) ? hi : lo;
+    status = ITEM_OK;
+    return true;
+  }
+
+  return false;
+}
@@ -0,0 +1,130 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusTimestampPublisher_h
+#define __PlusTimestampPublisher_h
+
+#include "vtkPlusDataCollectionExport.h"
+#include "vtkPlusTimestampedCircularBuffer.h"
+
+// STL includes
+#include <atomic>
+#include <functional>
+#include <vector>
+
+/*!
+  \class PlusTimestampPublisher
+  \brief Publishes the UID and filtered timestamp of buffer items for lock-free readers
+
+  The buffer publishes each new item in a sequence-locked ring while it holds its own lock, so there is only
+  one writer. Readers get the latest and oldest item UID, the timestamp of an item and the item that is closest
+  to a time without locking, so they never block the acquisition thread (and are not blocked by other readers
+  that copy items while holding the buffer lock). If a query cannot be completed because the items are
+  overwritten too fast or publishing is disabled then the query returns false and the buffer has to answer
+  it with locking.
+
+  Used by vtkPlusTimestampedCircularBuffer and vtkPlusTrackerBuffer.
+
+  \ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport PlusTimestampPublisher
+{
+public:
+  /*! Gets the filtered timestamp (in local time) of an item from the buffer, returns false if the item is not available */
+  typedef std::function<bool(BufferItemUidType, double&)> FilteredTimestampGetterType;
+
+  PlusTimestampPublisher();
+  ~PlusTimestampPublisher();
+
+  /*!
+    Refill the published items from the buffer content, or stop publishing if enabled is false.
+    The ring is reused if the buffer size has not changed. The caller must have locked the buffer.
+  */
+  void Rebuild(bool enabled, int bufferSize, BufferItemUidType latestItemUid, int numberOfItems, const FilteredTimestampGetterType& getFilteredTimestamp);
+
+  /*!
+    Publish a new item. oldestItemUid is the UID of the oldest item that remains in the buffer after the new item is added.
+    The caller must have locked the buffer.
+  */
+  void Publish(BufferItemUidType uid, double filteredTimestamp, BufferItemUidType oldestItemUid);
+
+  /*! Returns true if items are published. The UIDs returned by GetLatestItemUid and GetOldestItemUid are only valid then. */
+  bool IsEnabled() const;
+  BufferItemUidType GetLatestItemUid() const;
+  BufferItemUidType GetOldestItemUid() const;
+
+  /*!
+    Get the filtered timestamp (in local time) of an item without locking.
+    Returns false if the timestamp could not be read, status is only set if true is returned.
+  */
+  bool GetFilteredTimestamp(BufferItemUidType uid, double& filteredTimestamp, ItemStatus& status);
+
+  /*!
+    Get the filtered timestamp (in local time) of the oldest item without locking.
+    Returns false if the timestamp could not be read (for example because the oldest item is overwritten during each attempt).
+  */
+  bool GetOldestFilteredTimestamp(double& filteredTimestamp);
+
+  /*!
+    Find the item that is closest to the specified time without locking. localTimeOffsetSec is added to the
+    published timestamps before comparing them to the time. Returns false if the items changed too much during
+    the search, status is only set if true is returned.
+  */
+  bool GetItemUidFromTime(double time, double localTimeOffsetSec, double negligibleTimeDifferenceSec, BufferItemUidType& uid, ItemStatus& status);
+
+protected:
+  /*! Number of times a lock-free query is retried (because the items were overwritten during the query) before giving up */
+  static const int MAX_LOCK_FREE_READ_ATTEMPTS = 5;
+
+  /*! Item UID and filtered timestamp as seen by lock-free readers */
+  struct PublishedItem
+  {
+    /*! 2*UID when the item is readable, odd value while it is being written */
+    std::atomic<BufferItemUidType> Sequence;
+    /*! Filtered timestamp in local time */
+    std::atomic<double> FilteredTimestamp;
+  };
+
+  /*! Ring of published items, item with UID n is stored at position n % size */
+  struct PublishedItemRing
+  {
+    explicit PublishedItemRing(int size);
+    /*! Make all items unreadable, so that readers that still use this ring retry with the current one */
+    void Invalidate();
+    std::vector<PublishedItem> Items;
+  };
+
+  /*! Delete the retired rings if no lock-free reader is active. The caller must have locked the buffer. */
+  void DeleteRetiredPublishedItems();
+
+  /*!
+    Read the filtered timestamp (local time) of an item from the published ring.
+    Returns false if the item is not in the ring (not available yet, not available anymore or being overwritten).
+  */
+  static bool ReadPublishedTimestamp(PublishedItemRing* ring, BufferItemUidType uid, double& filteredTimestamp);
+
+  /*! Items published for lock-free readers, NULL if publishing is disabled */
+  std::atomic<PublishedItemRing*> PublishedItems;
+
+  /*!
+    Rings that were replaced (by resizing or disabling lock-free queries). Readers may still use them,
+    therefore they are only deleted when no lock-free reader is active.
+  */
+  std::vector<PublishedItemRing*> RetiredPublishedItems;
+
+  /*! Number of lock-free queries in progress. A retired ring cannot be referenced by a reader if this is zero. */
+  std::atomic<int> ActiveLockFreeReaders;
+
+  /*! Latest and oldest UID as seen by lock-free readers */
+  std::atomic<BufferItemUidType> PublishedLatestItemUid;
+  std::atomic<BufferItemUidType> PublishedOldestItemUid;
+
+private:
+  PlusTimestampPublisher(const PlusTimestampPublisher&);
+  void operator=(const PlusTimestampPublisher&);
+};
+
+#endif
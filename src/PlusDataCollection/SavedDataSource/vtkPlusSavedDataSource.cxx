@@ -5,17 +5,22 @@ See License.txt for details.
 =========================================================Plus=header=end*/
 
 #include "PlusConfigure.h"
+#include "igsioTrackedFrame.h"
 #include "vtkImageData.h"
 #include "vtkMatrix4x4.h"
-#include "vtkIGSIOSequenceIO.h"
 #include "vtkObjectFactory.h"
 #include "vtkPlusBuffer.h"
 #include "vtkPlusChannel.h"
 #include "vtkPlusDataSource.h"
+#include "vtkPlusReplayClock.h"
 #include "vtkPlusSavedDataSource.h"
+#include "vtkPlusSequenceIO.h"
 #include "vtkIGSIOTrackedFrameList.h"
 #include "vtksys/SystemTools.hxx"
 
+// STL includes
+#include <algorithm>
+
 vtkStandardNewMacro(vtkPlusSavedDataSource);
 
 //----------------------------------------------------------------------------
@@ -28,8 +33,14 @@ vtkPlusSavedDataSource::vtkPlusSavedDataSource()
   , LocalVideoBuffer(NULL)
   , UseAllFrameFields(false)
   , UseOriginalTimestamps(false)
+  , LazyLoading(false)
+  , ReadAheadFrames(16)
+  , LazyReader(NULL)
+  , LazyFirstFrameUid(0)
+  , ReadAheadThreadActive(std::make_pair(false, false))
   , LastAddedFrameUid(0)
   , LastAddedLoopIndex(0)
+  , NumberOfReplayedFrames(0)
   , SimulatedStream(VIDEO_STREAM)
 {
   // No callback function provided by the device, so the data capture thread will be used to poll the hardware and add new items to the buffer
@@ -44,6 +55,7 @@ vtkPlusSavedDataSource::~vtkPlusSavedDataSource()
   {
     this->Disconnect();
   }
+  this->StopLazyLoading();
   DeleteLocalBuffers();
 }
 
@@ -69,13 +81,42 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdate()
   }
 
   PlusStatus status = PLUS_FAIL;
+  vtkPlusReplayClock* replayClock = this->GetReplayClock();
   if (this->UseOriginalTimestamps)
   {
     status = InternalUpdateOriginalTimestamp(frameToBeAddedUid, frameToBeAddedLoopIndex);
   }
+  else if (replayClock == NULL)
+  {
+    status = InternalUpdateCurrentTimestamp(frameToBeAddedUid, frameToBeAddedLoopIndex, UNDEFINED_TIMESTAMP);
+  }
   else
   {
-    status = InternalUpdateCurrentTimestamp(frameToBeAddedUid, frameToBeAddedLoopIndex);
+    // Replaying faster than real time: add all the frames that are due at the acquisition rate
+    // and timestamp them with the replay clock, so that the result does not depend on the update timing
+    status = PLUS_SUCCESS;
+    const double framePeriodSec = 1.0 / this->AcquisitionRate;
+    const double clockTime = replayClock->GetTime();
+    for (double timestamp = replayClock->GetStartTime() + this->NumberOfReplayedFrames * framePeriodSec; timestamp <= clockTime;
+         timestamp = replayClock->GetStartTime() + this->NumberOfReplayedFrames * framePeriodSec)
+    {
+      if (!this->RepeatEnabled && frameToBeAddedLoopIndex > 0)
+      {
+        // played the loop once, no more frames to add
+        break;
+      }
+      if (InternalUpdateCurrentTimestamp(frameToBeAddedUid, frameToBeAddedLoopIndex, timestamp) != PLUS_SUCCESS)
+      {
+        status = PLUS_FAIL;
+      }
+      this->NumberOfReplayedFrames++;
+      frameToBeAddedUid++;
+      if (frameToBeAddedUid > this->LoopLastFrameUid)
+      {
+        frameToBeAddedLoopIndex++;
+        frameToBeAddedUid -= numberOfFramesInTheLoop;
+      }
+    }
   }
 
   return status;
@@ -84,8 +125,8 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdate()
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusSavedDataSource::InternalUpdateOriginalTimestamp(BufferItemUidType frameToBeAddedUid, int frameToBeAddedLoopIndex)
 {
-  // Compute elapsed time since we started the acquisition
-  double elapsedTime = vtkIGSIOAccurateTimer::GetSystemTime() - this->GetOutputDataSource()->GetStartTime();
+  // Compute elapsed time since we started the acquisition (the replay clock may run faster than the system time)
+  double elapsedTime = this->GetClockTime() - this->GetOutputDataSource()->GetStartTime();
   double loopTime = this->LoopStopTime_Local - this->LoopStartTime_Local;
 
   const int numberOfFramesInTheLoop = this->LoopLastFrameUid - this->LoopFirstFrameUid + 1;
@@ -173,12 +214,21 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdateOriginalTimestamp(BufferItemUid
     {
       case VIDEO_STREAM:
         {
+          std::shared_ptr<igsioTrackedFrame> lazyFrame;
+          const igsioVideoFrame* frame = this->GetVideoFrame(frameToBeAddedUid, dataBufferItemToBeAdded, lazyFrame);
+          if (frame == NULL)
+          {
+            status = PLUS_FAIL;
+            break;
+          }
           igsioFieldMapType fieldMap;
           if (this->UseAllFrameFields)
           {
             fieldMap = dataBufferItemToBeAdded.GetFrameFieldMap();
+            // in lazy loading mode the timestamp is stored in the local buffer to make sure that each item has a field
+            fieldMap.erase("Timestamp");
           }
-          if (this->AddVideoItemToVideoSources(this->GetVideoSources(), dataBufferItemToBeAdded.GetFrame(), this->FrameNumber, unfilteredTimestamp, filteredTimestamp, &fieldMap) != PLUS_SUCCESS)
+          if (this->AddVideoItemToVideoSources(this->GetVideoSources(), *frame, this->FrameNumber, unfilteredTimestamp, filteredTimestamp, &fieldMap) != PLUS_SUCCESS)
           {
             status = PLUS_FAIL;
           }
@@ -251,7 +301,7 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdateOriginalTimestamp(BufferItemUid
 }
 
 //----------------------------------------------------------------------------
-PlusStatus vtkPlusSavedDataSource::InternalUpdateCurrentTimestamp(BufferItemUidType frameToBeAddedUid, int frameToBeAddedLoopIndex)
+PlusStatus vtkPlusSavedDataSource::InternalUpdateCurrentTimestamp(BufferItemUidType frameToBeAddedUid, int frameToBeAddedLoopIndex, double timestamp)
 {
   // Don't use the original timestamps, just replay with one frame at each update
 
@@ -274,12 +324,21 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdateCurrentTimestamp(BufferItemUidT
   {
     case VIDEO_STREAM:
       {
+        std::shared_ptr<igsioTrackedFrame> lazyFrame;
+        const igsioVideoFrame* frame = this->GetVideoFrame(frameToBeAddedUid, dataBufferItemToBeAdded, lazyFrame);
+        if (frame == NULL)
+        {
+          status = PLUS_FAIL;
+          break;
+        }
         igsioFieldMapType fieldMap;
         if (this->UseAllFrameFields)
         {
           fieldMap = dataBufferItemToBeAdded.GetFrameFieldMap();
+          // in lazy loading mode the timestamp is stored in the local buffer to make sure that each item has a field
+          fieldMap.erase("Timestamp");
         }
-        if (this->AddVideoItemToVideoSources(this->GetVideoSources(), dataBufferItemToBeAdded.GetFrame(), this->FrameNumber, UNDEFINED_TIMESTAMP, UNDEFINED_TIMESTAMP, &fieldMap) != PLUS_SUCCESS)
+        if (this->AddVideoItemToVideoSources(this->GetVideoSources(), *frame, this->FrameNumber, timestamp, timestamp, &fieldMap) != PLUS_SUCCESS)
         {
           // UNDEFINED_TIMESTAMP => use current timestamp
           status = PLUS_FAIL;
@@ -331,7 +390,7 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdateCurrentTimestamp(BufferItemUidT
           // This device has no frame numbering, just auto increment tool frame number if new frame received
           unsigned long frameNumber = tool->GetFrameNumber() + 1 ;
           // send the transformation matrix and flags to the tool
-          if (this->ToolTimeStampedUpdate(tool->GetId(), toolTransMatrix, toolStatus, frameNumber, UNDEFINED_TIMESTAMP) != PLUS_SUCCESS)
+          if (this->ToolTimeStampedUpdate(tool->GetId(), toolTransMatrix, toolStatus, frameNumber, timestamp) != PLUS_SUCCESS)
           {
             status = PLUS_FAIL;
           }
@@ -381,12 +440,35 @@ PlusStatus vtkPlusSavedDataSource::InternalConnect()
 
   vtkSmartPointer<vtkIGSIOTrackedFrameList> savedDataBuffer = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
 
-  // Read sequence file into tracked frame list
-  vtkIGSIOSequenceIO::Read(foundAbsoluteImagePath, savedDataBuffer);
+  this->StopLazyLoading();
+  if (this->LazyLoading && vtkPlusChunkedSequenceIO::CanReadWriteFile(foundAbsoluteImagePath))
+  {
+    // Only the timestamps and frame fields are loaded now, images are read from the file during replay
+    this->LazyReader = vtkSmartPointer<vtkPlusChunkedSequenceIO>::New();
+    this->LazyReader->SetUseMemoryMapping(true);
+    if (this->LazyReader->OpenForReading(foundAbsoluteImagePath) != PLUS_SUCCESS
+        || this->LazyReader->ReadAllFrames(savedDataBuffer, false) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Unable to connect to saved data video source: Unable to read sequence file: " << this->SequenceFile);
+      this->StopLazyLoading();
+      return PLUS_FAIL;
+    }
+  }
+  else
+  {
+    if (this->LazyLoading)
+    {
+      LOG_WARNING("Lazy loading is only supported for chunked sequence files (.pseq), all the frames of " << this->SequenceFile
+                  << " are loaded into memory. Use EditSequenceFile to convert the file.");
+    }
+    // Read sequence file into tracked frame list
+    vtkPlusSequenceIO::Read(foundAbsoluteImagePath, savedDataBuffer);
+  }
 
   if (savedDataBuffer->GetNumberOfTrackedFrames() < 1)
   {
     LOG_ERROR("Failed to connect to saved dataset - there is no frame in the sequence metafile!");
+    this->StopLazyLoading();
     return PLUS_FAIL;
   }
 
@@ -394,10 +476,19 @@ PlusStatus vtkPlusSavedDataSource::InternalConnect()
   switch (this->SimulatedStream)
   {
     case VIDEO_STREAM:
-      status = InternalConnectVideo(savedDataBuffer);
+      if (this->LazyReader != NULL)
+      {
+        status = InternalConnectVideoLazy(savedDataBuffer);
+      }
+      else
+      {
+        status = InternalConnectVideo(savedDataBuffer);
+      }
       break;
     case TRACKER_STREAM:
       status = InternalConnectTracker(savedDataBuffer);
+      // all the tracking data is in the local buffers, the file is not needed anymore
+      this->StopLazyLoading();
       break;
     default:
       LOG_ERROR("Unknown stream type: " << this->SimulatedStream);
@@ -405,12 +496,14 @@ PlusStatus vtkPlusSavedDataSource::InternalConnect()
 
   if (status != PLUS_SUCCESS)
   {
+    this->StopLazyLoading();
     return PLUS_FAIL;
   }
 
   if (GetLocalBuffer() == NULL)
   {
     LOG_ERROR("Local buffer is invalid");
+    this->StopLazyLoading();
     return PLUS_FAIL;
   }
 
@@ -453,6 +546,12 @@ PlusStatus vtkPlusSavedDataSource::InternalConnect()
   this->LastAddedFrameUid = this->LoopFirstFrameUid - 1;
   this->LastAddedLoopIndex = 0;
 
+  if (this->LazyReader != NULL && this->StartReadAheadThread() != PLUS_SUCCESS)
+  {
+    this->StopLazyLoading();
+    return PLUS_FAIL;
+  }
+
   return PLUS_SUCCESS;
 }
 
@@ -502,26 +601,107 @@ PlusStatus vtkPlusSavedDataSource::InternalConnectVideo(vtkIGSIOTrackedFrameList
   this->LocalVideoBuffer->CopyImagesFromTrackedFrameList(savedDataBuffer, vtkPlusBuffer::READ_FILTERED_IGNORE_UNFILTERED_TIMESTAMPS, this->UseAllFrameFields);
   savedDataBuffer->Clear();
 
+  return this->SetupVideoSources(this->LocalVideoBuffer->GetImageOrientation(), this->LocalVideoBuffer->GetFrameSize(),
+                                 this->LocalVideoBuffer->GetNumberOfScalarComponents(), this->LocalVideoBuffer->GetPixelType());
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSavedDataSource::InternalConnectVideoLazy(vtkIGSIOTrackedFrameList* savedDataBuffer)
+{
+  vtkPlusDataSource* outputDataSource = this->GetOutputDataSource();
+  if (outputDataSource == NULL)
+  {
+    return PLUS_FAIL;
+  }
+
+  // Image properties are taken from the first frame
+  igsioTrackedFrame firstFrame;
+  if (this->LazyReader->ReadFrame(0, firstFrame) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to read the first frame of sequence file " << this->SequenceFile);
+    return PLUS_FAIL;
+  }
+  igsioVideoFrame* firstImage = firstFrame.GetImageData();
+  if (!firstImage->IsImageValid())
+  {
+    LOG_ERROR("Sequence file " << this->SequenceFile << " does not contain image data");
+    return PLUS_FAIL;
+  }
+  if (outputDataSource->SetImageType(firstImage->GetImageType()) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to set video buffer image type");
+    return PLUS_FAIL;
+  }
+  unsigned int numberOfScalarComponents(1);
+  if (firstImage->GetNumberOfScalarComponents(numberOfScalarComponents) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to retrieve number of scalar components.");
+    return PLUS_FAIL;
+  }
+
+  // The local buffer only stores the timestamps and frame fields. The frame size is not set, so no memory is allocated for images.
+  DeleteLocalBuffers();
+  this->LocalVideoBuffer = vtkPlusBuffer::New();
+  this->LocalVideoBuffer->SetImageOrientation(firstImage->GetImageOrientation());
+  this->LocalVideoBuffer->SetImageType(firstImage->GetImageType());
+  this->LocalVideoBuffer->SetBufferSize(savedDataBuffer->GetNumberOfTrackedFrames());
+  this->LocalVideoBuffer->SetLocalTimeOffsetSec(0.0);   // the time offset is copied from the output, so reset it to 0
+
+  this->LazyFrameIndices.clear();
+  this->LazyFrameIndices.reserve(savedDataBuffer->GetNumberOfTrackedFrames());
+  for (unsigned int frameIndex = 0; frameIndex < savedDataBuffer->GetNumberOfTrackedFrames(); ++frameIndex)
+  {
+    igsioTrackedFrame* frame = savedDataBuffer->GetTrackedFrame(frameIndex);
+    igsioFieldMapType fields;
+    if (this->UseAllFrameFields)
+    {
+      fields = frame->GetCustomFields();
+      fields.erase("UnfilteredTimestamp");
+      fields.erase("FrameNumber");
+    }
+    // Items are only added to the buffer if they have fields, so the timestamp is always kept (it is removed from the output)
+    fields["Timestamp"] = std::make_pair(FRAMEFIELD_NONE, igsioCommon::ToString<double>(frame->GetTimestamp()));
+
+    // Items with the same timestamp are not added, the index of the frame in the file is only stored for added items
+    int numberOfItems = this->LocalVideoBuffer->GetNumberOfItems();
+    this->LocalVideoBuffer->AddItem(fields, frameIndex, frame->GetTimestamp(), frame->GetTimestamp());
+    if (this->LocalVideoBuffer->GetNumberOfItems() > numberOfItems)
+    {
+      this->LazyFrameIndices.push_back(frameIndex);
+    }
+  }
+  savedDataBuffer->Clear();
+  this->LazyFirstFrameUid = this->LocalVideoBuffer->GetOldestItemUidInBuffer();
+
+  LOG_INFO("Lazy loading of " << this->LazyFrameIndices.size() << " frames from " << this->SequenceFile
+           << (this->LazyReader->IsMemoryMapped() ? " (memory-mapped)" : ""));
+
+  return this->SetupVideoSources(firstImage->GetImageOrientation(), firstFrame.GetFrameSize(), numberOfScalarComponents, firstImage->GetVTKScalarPixelType());
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSavedDataSource::SetupVideoSources(US_IMAGE_ORIENTATION imageOrientation, const FrameSizeType& frameSize, unsigned int numberOfScalarComponents, igsioCommon::VTKScalarPixelType pixelType)
+{
   PlusStatus result(PLUS_SUCCESS);
   for (DataSourceContainerIterator it = this->VideoSources.begin(); it != this->VideoSources.end(); ++it)
   {
     vtkPlusDataSource* source(it->second);
 
-    if (source->SetInputImageOrientation(this->LocalVideoBuffer->GetImageOrientation()) != PLUS_SUCCESS)
+    if (source->SetInputImageOrientation(imageOrientation) != PLUS_SUCCESS)
     {
       LOG_ERROR(source->GetId() << ": Failed to set video image orientation");
       result = PLUS_FAIL;
       continue;
     }
 
-    if (source->SetInputFrameSize(this->LocalVideoBuffer->GetFrameSize()) != PLUS_SUCCESS)
+    if (source->SetInputFrameSize(frameSize) != PLUS_SUCCESS)
     {
       LOG_ERROR(source->GetId() << ": Failed to set video image orientation");
       result = PLUS_FAIL;
       continue;
     }
 
-    if (source->SetNumberOfScalarComponents(this->LocalVideoBuffer->GetNumberOfScalarComponents()) != PLUS_SUCCESS)
+    if (source->SetNumberOfScalarComponents(numberOfScalarComponents) != PLUS_SUCCESS)
     {
       LOG_ERROR(source->GetId() << ": Failed to set video image orientation");
       result = PLUS_FAIL;
@@ -530,14 +710,14 @@ PlusStatus vtkPlusSavedDataSource::InternalConnectVideo(vtkIGSIOTrackedFrameList
 
     source->Clear();
 
-    if (source->SetInputFrameSize(this->LocalVideoBuffer->GetFrameSize()) != PLUS_SUCCESS)
+    if (source->SetInputFrameSize(frameSize) != PLUS_SUCCESS)
     {
       LOG_ERROR(source->GetId() << ": Failed to set video image orientation");
       result = PLUS_FAIL;
       continue;
     }
 
-    if (source->SetPixelType(this->LocalVideoBuffer->GetPixelType()) != PLUS_SUCCESS)
+    if (source->SetPixelType(pixelType) != PLUS_SUCCESS)
     {
       LOG_ERROR(source->GetId() << ": Failed to set video image orientation");
       result = PLUS_FAIL;
@@ -610,13 +790,188 @@ PlusStatus vtkPlusSavedDataSource::InternalConnectTracker(vtkIGSIOTrackedFrameLi
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSavedDataSource::InternalStartRecording()
+{
+  this->NumberOfReplayedFrames = 0;
+  return PLUS_SUCCESS;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusSavedDataSource::InternalDisconnect()
 {
+  this->StopLazyLoading();
   DeleteLocalBuffers();
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+const igsioVideoFrame* vtkPlusSavedDataSource::GetVideoFrame(BufferItemUidType uid, StreamBufferItem& bufferItem, std::shared_ptr<igsioTrackedFrame>& lazyFrame)
+{
+  if (this->LazyReader == NULL)
+  {
+    // all the images are in the local buffer
+    return &bufferItem.GetFrame();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(this->LazyFrameCacheMutex);
+
+    // Request reading of the frames that will be replayed next (wrapping around at the end of the loop)
+    const int numberOfFramesInTheLoop = this->LoopLastFrameUid - this->LoopFirstFrameUid + 1;
+    this->ReadAheadRequests.clear();
+    BufferItemUidType nextUid = uid;
+    for (int i = 0; i < std::min(this->ReadAheadFrames, numberOfFramesInTheLoop - 1); ++i)
+    {
+      nextUid++;
+      if (nextUid > this->LoopLastFrameUid)
+      {
+        nextUid -= numberOfFramesInTheLoop;
+      }
+      this->ReadAheadRequests.push_back(nextUid);
+    }
+
+    // Frames that are not needed anymore are removed from the cache to keep the memory usage constant
+    for (std::map<BufferItemUidType, std::shared_ptr<igsioTrackedFrame> >::iterator it = this->LazyFrameCache.begin(); it != this->LazyFrameCache.end();)
+    {
+      if (it->first != uid && std::find(this->ReadAheadRequests.begin(), this->ReadAheadRequests.end(), it->first) == this->ReadAheadRequests.end())
+      {
+        it = this->LazyFrameCache.erase(it);
+      }
+      else
+      {
+        ++it;
+      }
+    }
+
+    std::map<BufferItemUidType, std::shared_ptr<igsioTrackedFrame> >::iterator cachedFrame = this->LazyFrameCache.find(uid);
+    if (cachedFrame != this->LazyFrameCache.end())
+    {
+      lazyFrame = cachedFrame->second;
+    }
+    this->ReadAheadRequested.notify_all();
+  }
+
+  if (!lazyFrame)
+  {
+    // The frame has not been read in advance (e.g., replay just started or the disk is too slow), read it now
+    lazyFrame = this->ReadLazyFrame(uid);
+    if (!lazyFrame)
+    {
+      return NULL;
+    }
+  }
+  return lazyFrame->GetImageData();
+}
+
+//----------------------------------------------------------------------------
+std::shared_ptr<igsioTrackedFrame> vtkPlusSavedDataSource::ReadLazyFrame(BufferItemUidType uid)
+{
+  std::lock_guard<std::mutex> readerLock(this->LazyReaderMutex);
+
+  {
+    // The frame may have been read by the read-ahead thread while waiting for the reader
+    std::lock_guard<std::mutex> lock(this->LazyFrameCacheMutex);
+    std::map<BufferItemUidType, std::shared_ptr<igsioTrackedFrame> >::iterator cachedFrame = this->LazyFrameCache.find(uid);
+    if (cachedFrame != this->LazyFrameCache.end())
+    {
+      return cachedFrame->second;
+    }
+  }
+
+  if (uid < this->LazyFirstFrameUid || uid - this->LazyFirstFrameUid >= static_cast<BufferItemUidType>(this->LazyFrameIndices.size()))
+  {
+    LOG_ERROR("vtkPlusSavedDataSource: Failed to retrieve item from the buffer, UID=" << uid);
+    return std::shared_ptr<igsioTrackedFrame>();
+  }
+  unsigned int frameIndex = this->LazyFrameIndices[uid - this->LazyFirstFrameUid];
+  std::shared_ptr<igsioTrackedFrame> frame = std::make_shared<igsioTrackedFrame>();
+  if (this->LazyReader->ReadFrame(frameIndex, *frame) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("vtkPlusSavedDataSource: Failed to read frame " << frameIndex << " from sequence file " << this->SequenceFile);
+    return std::shared_ptr<igsioTrackedFrame>();
+  }
+
+  std::lock_guard<std::mutex> lock(this->LazyFrameCacheMutex);
+  this->LazyFrameCache[uid] = frame;
+  return frame;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSavedDataSource::StartReadAheadThread()
+{
+  std::lock_guard<std::mutex> lock(this->LazyFrameCacheMutex);
+  if (this->ReadAheadThreadActive.first)
+  {
+    // already running
+    return PLUS_SUCCESS;
+  }
+  this->ReadAheadThreadActive.first = true;
+  this->ReadAheadThreadActive.second = true;
+  if (this->Threader->SpawnThread((vtkThreadFunctionType)&ReadAheadThread, this) < 0)
+  {
+    LOG_ERROR(this->GetDeviceId() << ": Failed to start the read-ahead thread");
+    this->ReadAheadThreadActive = std::make_pair(false, false);
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusSavedDataSource::StopLazyLoading()
+{
+  {
+    std::unique_lock<std::mutex> lock(this->LazyFrameCacheMutex);
+    this->ReadAheadThreadActive.first = false;
+    this->ReadAheadRequested.notify_all();
+    this->ReadAheadRequested.wait(lock, [this] { return !this->ReadAheadThreadActive.second; });
+    this->ReadAheadRequests.clear();
+    this->LazyFrameCache.clear();
+  }
+
+  std::lock_guard<std::mutex> readerLock(this->LazyReaderMutex);
+  if (this->LazyReader != NULL)
+  {
+    this->LazyReader->Close();
+    this->LazyReader = NULL;
+  }
+  this->LazyFrameIndices.clear();
+}
+
+//----------------------------------------------------------------------------
+void* vtkPlusSavedDataSource::ReadAheadThread(vtkMultiThreader::ThreadInfo* data)
+{
+  vtkPlusSavedDataSource* self = (vtkPlusSavedDataSource*)(data->UserData);
+
+  std::unique_lock<std::mutex> lock(self->LazyFrameCacheMutex);
+  while (true)
+  {
+    self->ReadAheadRequested.wait(lock, [self] { return !self->ReadAheadRequests.empty() || !self->ReadAheadThreadActive.first; });
+    if (!self->ReadAheadThreadActive.first)
+    {
+      break;
+    }
+
+    // Frames are read in the order they will be replayed
+    BufferItemUidType uid = self->ReadAheadRequests.front();
+    self->ReadAheadRequests.erase(self->ReadAheadRequests.begin());
+    if (self->LazyFrameCache.find(uid) != self->LazyFrameCache.end())
+    {
+      continue;
+    }
+    lock.unlock();
+
+    // Reading the frame loads the pages of the mapped file, so the internal update thread does not have to wait for the disk
+    self->ReadLazyFrame(uid);
+
+    lock.lock();
+  }
+
+  self->ReadAheadThreadActive.second = false;
+  self->ReadAheadRequested.notify_all();
+  return NULL;
+}
+
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusSavedDataSource::ReadConfiguration(vtkXMLDataElement* rootConfigElement)
 {
@@ -670,6 +1025,13 @@ PlusStatus vtkPlusSavedDataSource::ReadConfiguration(vtkXMLDataElement* rootConf
 
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(RepeatEnabled, deviceConfig);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(UseOriginalTimestamps, deviceConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(LazyLoading, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, ReadAheadFrames, deviceConfig);
+  if (this->ReadAheadFrames < 0)
+  {
+    LOG_WARNING("ReadAheadFrames must not be negative, frames will not be read in advance");
+    this->ReadAheadFrames = 0;
+  }
 
   const char* useData = deviceConfig->GetAttribute("UseData");
   if (useData != NULL)
@@ -707,6 +1069,11 @@ PlusStatus vtkPlusSavedDataSource::WriteConfiguration(vtkXMLDataElement* rootCon
   XML_WRITE_CSTRING_ATTRIBUTE_IF_NOT_NULL(SequenceFile, imageAcquisitionConfig);
   XML_WRITE_BOOL_ATTRIBUTE(RepeatEnabled, imageAcquisitionConfig);
   XML_WRITE_BOOL_ATTRIBUTE(UseOriginalTimestamps, imageAcquisitionConfig);
+  if (this->LazyLoading)
+  {
+    XML_WRITE_BOOL_ATTRIBUTE(LazyLoading, imageAcquisitionConfig);
+    imageAcquisitionConfig->SetIntAttribute("ReadAheadFrames", this->ReadAheadFrames);
+  }
 
   if (this->UseAllFrameFields)
   {
@@ -9,8 +9,16 @@ See License.txt for details.
 
 #include "vtkPlusDataCollectionExport.h"
 
+#include "vtkPlusChunkedSequenceIO.h"
 #include "vtkPlusDevice.h"
 
+// STL includes
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+
+class igsioTrackedFrame;
 class vtkPlusBuffer;
 
 class vtkPlusDataCollectionExport vtkPlusSavedDataSource;
@@ -27,6 +35,9 @@ Attributes:
 \li UseOriginalTimestamps: if true then the original timestamps (recorded originally in the source file)
   will be replayed exactly, otherwise only the timestamp difference will be replayed exactly,
   starting from the current time (TRUE|FALSE)
+\li LazyLoading: if true and the source file is a chunked sequence file (.pseq) then only the timestamps and
+  frame fields are loaded at connect, images are read from the (memory-mapped) file during replay (TRUE|FALSE)
+\li ReadAheadFrames: number of frames that are read in advance by a background thread in lazy loading mode
 
 */
 class vtkPlusDataCollectionExport vtkPlusSavedDataSource : public vtkPlusDevice
@@ -73,6 +84,22 @@ public:
   /*! Read the timestamps from the file and use provide them in the output (instead of the current time) */
   vtkBooleanMacro( UseOriginalTimestamps, bool );
 
+  /*!
+    If enabled then images of chunked sequence files (.pseq) are not loaded at connect but read from the file
+    when they are replayed, so that sequences larger than the available memory can be replayed.
+    The local video buffer only contains the timestamps and frame fields in this mode.
+  */
+  vtkGetMacro( LazyLoading, bool );
+  /*! Enable reading images from the file on demand */
+  vtkSetMacro( LazyLoading, bool );
+  /*! Enable reading images from the file on demand */
+  vtkBooleanMacro( LazyLoading, bool );
+
+  /*! Number of frames that are read in advance (on a background thread) in lazy loading mode */
+  vtkGetMacro( ReadAheadFrames, int );
+  /*! Number of frames that are read in advance (on a background thread) in lazy loading mode */
+  vtkSetMacro( ReadAheadFrames, int );
+
   /*! Get local video buffer */
   vtkGetObjectMacro( LocalVideoBuffer, vtkPlusBuffer );
 
@@ -101,14 +128,41 @@ protected:
   /*! Connect to device, in case the output is a tracker stream */
   virtual PlusStatus InternalConnectTracker( vtkIGSIOTrackedFrameList* savedDataBuffer );
 
+  /*! Connect to device, in case the output is a video stream and images are read from the file on demand */
+  virtual PlusStatus InternalConnectVideoLazy( vtkIGSIOTrackedFrameList* savedDataBuffer );
+
+  /*! Set the image properties of the output video sources */
+  PlusStatus SetupVideoSources( US_IMAGE_ORIENTATION imageOrientation, const FrameSizeType& frameSize, unsigned int numberOfScalarComponents, igsioCommon::VTKScalarPixelType pixelType );
+
+  /*!
+    Get the image of a local video buffer item. In lazy loading mode the image is read from the file (or taken from the read-ahead cache)
+    and lazyFrame holds it while it is used. Returns NULL if the image cannot be read.
+  */
+  const igsioVideoFrame* GetVideoFrame( BufferItemUidType uid, StreamBufferItem& bufferItem, std::shared_ptr<igsioTrackedFrame>& lazyFrame );
+
+  /*! Read the frame of a local video buffer item from the file */
+  std::shared_ptr<igsioTrackedFrame> ReadLazyFrame( BufferItemUidType uid );
+
+  /*! Start the thread that reads frames in advance in lazy loading mode */
+  PlusStatus StartReadAheadThread();
+
+  /*! Stop the read-ahead thread and release the sequence file */
+  void StopLazyLoading();
+
+  /*! Thread that reads the requested frames into the cache in lazy loading mode */
+  static void* ReadAheadThread( vtkMultiThreader::ThreadInfo* data );
+
+  /*! Start replaying */
+  virtual PlusStatus InternalStartRecording();
+
   /*! Disconnect from device */
   virtual PlusStatus InternalDisconnect();
 
   /*! The internal function which actually does the grab.  */
   PlusStatus InternalUpdate();
 
-  /*! Internal update, called when NOT the original timestamps are used */
-  PlusStatus InternalUpdateCurrentTimestamp( BufferItemUidType frameToBeAddedUid, int frameToBeAddedLoopIndex );
+  /*! Internal update, called when NOT the original timestamps are used. UNDEFINED_TIMESTAMP means the frame is timestamped with the current time. */
+  PlusStatus InternalUpdateCurrentTimestamp( BufferItemUidType frameToBeAddedUid, int frameToBeAddedLoopIndex, double timestamp );
 
   /*! Internal update, called when the original timestamps are used */
   PlusStatus InternalUpdateOriginalTimestamp( BufferItemUidType frameToBeAddedUid, int frameToBeAddedLoopIndex );
@@ -161,12 +215,46 @@ protected:
   /*! Read the timestamps from the file and use provide them in the output (instead of the current time) */
   bool UseOriginalTimestamps;
 
+  /*! Read images from the file on demand instead of loading the whole file at connect */
+  bool LazyLoading;
+
+  /*! Number of frames that are read in advance in lazy loading mode */
+  int ReadAheadFrames;
+
+  /*! Memory-mapped sequence file that images are read from in lazy loading mode (NULL if all the images are in the local buffer) */
+  vtkSmartPointer<vtkPlusChunkedSequenceIO> LazyReader;
+
+  /*! Serializes reading of the file by the read-ahead thread and the internal update thread */
+  std::mutex LazyReaderMutex;
+
+  /*! Index of the frame in the sequence file for each item of the local video buffer (in lazy loading mode) */
+  std::vector<unsigned int> LazyFrameIndices;
+
+  /*! UID of the first item of the local video buffer */
+  BufferItemUidType LazyFirstFrameUid;
+
+  /*! Frames that are already read from the file, indexed by local video buffer item UID */
+  std::map<BufferItemUidType, std::shared_ptr<igsioTrackedFrame> > LazyFrameCache;
+
+  /*! Local video buffer item UIDs that the read-ahead thread has to read */
+  std::vector<BufferItemUidType> ReadAheadRequests;
+
+  /*! Protects LazyFrameCache, ReadAheadRequests, and ReadAheadThreadActive */
+  std::mutex LazyFrameCacheMutex;
+  std::condition_variable ReadAheadRequested;
+
+  /*! Read-ahead thread state: first is true while the thread should run, second is true while the thread is running */
+  std::pair<bool, bool> ReadAheadThreadActive;
+
   /*! Buffer item UID of the last added frame in the local buffer */
   BufferItemUidType LastAddedFrameUid;
 
   /*! Index of the loop when the last frame was added. Used for making sure we add each frame only once in one loop period. */
   int LastAddedLoopIndex;
 
+  /*! Number of frames added since the recording started, used for timestamping the frames when replaying faster than real time without the original timestamps */
+  unsigned long NumberOfReplayedFrames;
+
   /*! Frames before this item (identified by the buffer item UID) in the local buffer are ignored, not replayed */
   BufferItemUidType LoopFirstFrameUid;
 
@@ -0,0 +1,165 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file LatencyTracerTest.cxx
+  \brief This program tests that the latency tracer collects the acquisition stages of buffer items only when it is enabled,
+  computes the latency statistics of each stage and writes a Chrome trace file.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusLatencyTracer.h"
+#include "vtkPlusTrackerBuffer.h"
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+  const double ITEM_AGE_SEC = 0.020;
+  const int NUMBER_OF_ITEMS = 50;
+
+  //----------------------------------------------------------------------------
+  PlusStatus AddItems(vtkPlusTrackerBuffer* buffer, int firstFrameNumber)
+  {
+    vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    for (int frameNumber = firstFrameNumber; frameNumber < firstFrameNumber + NUMBER_OF_ITEMS; ++frameNumber)
+    {
+      // The item is reported as if it had been acquired ITEM_AGE_SEC earlier
+      double timestamp = vtkIGSIOAccurateTimer::GetSystemTime() - ITEM_AGE_SEC;
+      if (buffer->AddTimeStampedItem(matrix, TOOL_OK, frameNumber, timestamp, timestamp) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to add item " << frameNumber);
+        return PLUS_FAIL;
+      }
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  int CheckStatistics(const PlusLatencyTracer::StageStatistics& statistics, const std::string& expectedName)
+  {
+    if (statistics.Name != expectedName)
+    {
+      LOG_ERROR("Stage name mismatch: " << statistics.Name << " (expected: " << expectedName << ")");
+      return 1;
+    }
+    if (statistics.NumberOfSamples != NUMBER_OF_ITEMS)
+    {
+      LOG_ERROR(expectedName << ": number of samples mismatch: " << statistics.NumberOfSamples << " (expected: " << NUMBER_OF_ITEMS << ")");
+      return 1;
+    }
+    // Latency cannot be less than the age of the item, allow generous margin for slow test machines
+    if (statistics.MedianSec < ITEM_AGE_SEC || statistics.MedianSec > statistics.Percentile99Sec
+        || statistics.Percentile99Sec > statistics.MaxSec || statistics.MaxSec > ITEM_AGE_SEC + 1.0)
+    {
+      LOG_ERROR(expectedName << ": invalid latency statistics: median " << statistics.MedianSec << ", 99th percentile " << statistics.Percentile99Sec << ", max " << statistics.MaxSec);
+      return 1;
+    }
+    return 0;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  int numberOfErrors(0);
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  PlusLatencyTracer* latencyTracer = PlusLatencyTracer::GetInstance();
+  vtkSmartPointer<vtkPlusTrackerBuffer> buffer = vtkSmartPointer<vtkPlusTrackerBuffer>::New();
+  buffer->SetBufferSize(2 * NUMBER_OF_ITEMS);
+  buffer->SetLatencyTracingComponent("TestTool");
+
+  // Tracing is disabled by default, nothing is collected
+  AddItems(buffer, 0);
+  std::vector<PlusLatencyTracer::StageStatistics> statistics;
+  latencyTracer->GetStatistics(statistics);
+  if (!statistics.empty())
+  {
+    LOG_ERROR("Latency data is collected while tracing is disabled");
+    numberOfErrors++;
+  }
+
+  // Collect the acquisition stages
+  latencyTracer->SetEnabled(true);
+  AddItems(buffer, NUMBER_OF_ITEMS);
+  latencyTracer->SetEnabled(false);
+  latencyTracer->GetStatistics(statistics);
+  if (statistics.size() != 2)
+  {
+    LOG_ERROR("Number of traced stages mismatch: " << statistics.size() << " (expected: 2)");
+    numberOfErrors++;
+  }
+  else
+  {
+    numberOfErrors += CheckStatistics(statistics[0], "Acquired (TestTool)");
+    numberOfErrors += CheckStatistics(statistics[1], "TimestampFiltered (TestTool)");
+  }
+
+  // Write trace file
+  std::string traceFilePath = vtkPlusConfig::GetInstance()->GetOutputPath("LatencyTracerTest.json");
+  if (latencyTracer->WriteChromeTrace(traceFilePath) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to write trace file");
+    numberOfErrors++;
+  }
+  else
+  {
+    std::ifstream traceFile(traceFilePath.c_str());
+    std::stringstream traceContent;
+    traceContent << traceFile.rdbuf();
+    if (traceContent.str().find("\"traceEvents\"") == std::string::npos || traceContent.str().find("Acquired (TestTool)") == std::string::npos)
+    {
+      LOG_ERROR("Invalid trace file content: " << traceFilePath);
+      numberOfErrors++;
+    }
+  }
+
+  latencyTracer->Reset();
+  latencyTracer->GetStatistics(statistics);
+  if (!statistics.empty())
+  {
+    LOG_ERROR("Latency data is not cleared by Reset");
+    numberOfErrors++;
+  }
+
+  if (numberOfErrors != 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
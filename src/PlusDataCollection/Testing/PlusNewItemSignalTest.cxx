@@ -0,0 +1,262 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PlusNewItemSignalTest.cxx
+  \brief Verifies that waiting on a new item signal times out if there is no notification, returns immediately
+  if a notification has been received before the wait, and wakes up when another thread sends a notification.
+  Verifies that all threads waiting on the same signal are woken up, and that adding an item to a buffer
+  wakes up all threads that wait on signals registered to the buffer.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusNewItemSignal.h"
+#include "vtkPlusBuffer.h"
+
+// IGSIO includes
+#include <vtkIGSIOAccurateTimer.h>
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <atomic>
+#include <memory>
+#include <thread>
+
+namespace
+{
+  const double SHORT_TIMEOUT_SEC = 0.1;
+  const double LONG_TIMEOUT_SEC = 10.0;
+  // Time for the started threads to begin waiting
+  const double THREAD_START_DELAY_SEC = 0.2;
+  // Maximum time between a notification and the wake-up of the waiting threads, generous for loaded test machines
+  const double MAX_WAKE_UP_DELAY_SEC = 2.0;
+  const int NUMBER_OF_WAITERS = 4;
+
+  struct WaiterResult
+  {
+    WaiterResult()
+      : NewItemAdded(false)
+      , WakeUpTime(0.0)
+    {
+    }
+    bool NewItemAdded;
+    double WakeUpTime;
+  };
+
+  //----------------------------------------------------------------------------
+  void WaiterThread(PlusNewItemSignal* signal, std::atomic<int>* numberOfStartedWaiters, WaiterResult* result)
+  {
+    (*numberOfStartedWaiters)++;
+    result->NewItemAdded = signal->Wait(LONG_TIMEOUT_SEC);
+    result->WakeUpTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  }
+
+  //----------------------------------------------------------------------------
+  void NotifierThread(PlusNewItemSignal* signal, double delaySec)
+  {
+    vtkIGSIOAccurateTimer::Delay(delaySec);
+    signal->Notify();
+  }
+
+  //----------------------------------------------------------------------------
+  // Start a waiter thread for each signal, wait until they are all waiting, then call notify
+  // and check that all waiters are woken up by the notification
+  template<typename NotifyFunction>
+  int TestWaiters(const std::vector<PlusNewItemSignal*>& signals, NotifyFunction notify, const std::string& description)
+  {
+    std::atomic<int> numberOfStartedWaiters(0);
+    std::vector<WaiterResult> results(signals.size());
+    std::vector<std::thread> waiters;
+    for (size_t i = 0; i < signals.size(); ++i)
+    {
+      waiters.push_back(std::thread(WaiterThread, signals[i], &numberOfStartedWaiters, &results[i]));
+    }
+    while (numberOfStartedWaiters < static_cast<int>(signals.size()))
+    {
+      vtkIGSIOAccurateTimer::Delay(0.001);
+    }
+    vtkIGSIOAccurateTimer::Delay(THREAD_START_DELAY_SEC);
+
+    double notificationTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    notify();
+    for (std::vector<std::thread>::iterator it = waiters.begin(); it != waiters.end(); ++it)
+    {
+      it->join();
+    }
+
+    int numberOfErrors = 0;
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+      if (!results[i].NewItemAdded || results[i].WakeUpTime - notificationTime > MAX_WAKE_UP_DELAY_SEC)
+      {
+        LOG_ERROR(description << ": waiter " << i << " is not woken up by the notification (wait result: " << (results[i].NewItemAdded ? "new item" : "timeout")
+                  << ", wake-up delay: " << results[i].WakeUpTime - notificationTime << " sec)");
+        numberOfErrors++;
+      }
+    }
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestSingleThread()
+  {
+    int numberOfErrors = 0;
+    PlusNewItemSignal signal;
+
+    double startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    bool newItemAdded = signal.Wait(SHORT_TIMEOUT_SEC);
+    double elapsedTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - startTime;
+    if (newItemAdded || elapsedTimeSec < 0.9 * SHORT_TIMEOUT_SEC || elapsedTimeSec > SHORT_TIMEOUT_SEC + MAX_WAKE_UP_DELAY_SEC)
+    {
+      LOG_ERROR("Wait without notification returned " << (newItemAdded ? "new item" : "timeout") << " after " << elapsedTimeSec << " sec, expected timeout after " << SHORT_TIMEOUT_SEC << " sec");
+      numberOfErrors++;
+    }
+
+    if (signal.Wait(0.0))
+    {
+      LOG_ERROR("Wait with zero timeout returned new item without notification");
+      numberOfErrors++;
+    }
+
+    // Notifications received before the wait are reported once
+    signal.Notify();
+    signal.Notify();
+    startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    newItemAdded = signal.Wait(LONG_TIMEOUT_SEC);
+    elapsedTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - startTime;
+    if (!newItemAdded || elapsedTimeSec > MAX_WAKE_UP_DELAY_SEC)
+    {
+      LOG_ERROR("Wait after notification returned " << (newItemAdded ? "new item" : "timeout") << " after " << elapsedTimeSec << " sec, expected immediate return");
+      numberOfErrors++;
+    }
+    if (signal.Wait(SHORT_TIMEOUT_SEC))
+    {
+      LOG_ERROR("Notification is reported more than once");
+      numberOfErrors++;
+    }
+
+    // Notification from another thread while waiting
+    startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    std::thread notifier(NotifierThread, &signal, SHORT_TIMEOUT_SEC);
+    newItemAdded = signal.Wait(LONG_TIMEOUT_SEC);
+    elapsedTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - startTime;
+    notifier.join();
+    if (!newItemAdded || elapsedTimeSec > SHORT_TIMEOUT_SEC + MAX_WAKE_UP_DELAY_SEC)
+    {
+      LOG_ERROR("Wait with notification from another thread returned " << (newItemAdded ? "new item" : "timeout") << " after " << elapsedTimeSec << " sec");
+      numberOfErrors++;
+    }
+
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestBufferSignals()
+  {
+    int numberOfErrors = 0;
+    vtkSmartPointer<vtkPlusBuffer> buffer = vtkSmartPointer<vtkPlusBuffer>::New();
+    buffer->SetBufferSize(10);
+    vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+
+    std::vector<std::shared_ptr<PlusNewItemSignal> > bufferSignals;
+    std::vector<PlusNewItemSignal*> signals;
+    for (int i = 0; i < NUMBER_OF_WAITERS; ++i)
+    {
+      bufferSignals.push_back(std::make_shared<PlusNewItemSignal>());
+      signals.push_back(bufferSignals.back().get());
+      buffer->AddNewItemSignal(bufferSignals.back());
+    }
+    // Adding the same signal again must not cause duplicate notifications
+    buffer->AddNewItemSignal(bufferSignals[0]);
+
+    unsigned long frameNumber = 0;
+    numberOfErrors += TestWaiters(signals, [&]()
+    {
+      buffer->AddTimeStampedItem(matrix, TOOL_OK, frameNumber, frameNumber * 0.1);
+      frameNumber++;
+    }, "Signals of a buffer");
+
+    // Removed signals are not notified anymore
+    buffer->RemoveNewItemSignal(bufferSignals[0]);
+    buffer->AddTimeStampedItem(matrix, TOOL_OK, frameNumber, frameNumber * 0.1);
+    frameNumber++;
+    if (bufferSignals[0]->Wait(SHORT_TIMEOUT_SEC))
+    {
+      LOG_ERROR("Signal is notified after it is removed from the buffer");
+      numberOfErrors++;
+    }
+    for (int i = 1; i < NUMBER_OF_WAITERS; ++i)
+    {
+      if (!bufferSignals[i]->Wait(0.0))
+      {
+        LOG_ERROR("Signal " << i << " is not notified when an item is added to the buffer");
+        numberOfErrors++;
+      }
+    }
+
+    for (int i = 1; i < NUMBER_OF_WAITERS; ++i)
+    {
+      buffer->RemoveNewItemSignal(bufferSignals[i]);
+    }
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int numberOfErrors(0);
+
+  numberOfErrors += TestSingleThread();
+
+  // Several threads waiting on the same signal
+  PlusNewItemSignal sharedSignal;
+  std::vector<PlusNewItemSignal*> sharedSignals(NUMBER_OF_WAITERS, &sharedSignal);
+  numberOfErrors += TestWaiters(sharedSignals, [&]() { sharedSignal.Notify(); }, "Shared signal");
+  if (sharedSignal.Wait(SHORT_TIMEOUT_SEC))
+  {
+    LOG_ERROR("Shared signal: notification is reported again after all waiters are woken up");
+    numberOfErrors++;
+  }
+
+  numberOfErrors += TestBufferSignals();
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
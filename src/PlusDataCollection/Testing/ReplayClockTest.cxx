@@ -0,0 +1,366 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file ReplayClockTest.cxx
+  \brief This program tests that the FREE_RUN replay clock only advances when all the registered devices completed their
+  update, that unregistering a device releases the others, and that the SCALED replay clock is frozen while paused. If a sequence file is specified then it also replays the
+  file with two saved data sources in FREE_RUN mode a few times and verifies that the timestamps of the replayed
+  frames are the same in each run.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkIGSIOAccurateTimer.h"
+#include "vtkPlusDataCollector.h"
+#include "vtkPlusDataSource.h"
+#include "vtkPlusDevice.h"
+#include "vtkPlusReplayClock.h"
+
+// VTK includes
+#include <vtkXMLUtilities.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+  const double START_TIME = 100.0;
+  const double STEP_SEC = 0.5;
+
+  //----------------------------------------------------------------------------
+  int TestFreeRunLockStep()
+  {
+    int numberOfErrors = 0;
+
+    vtkSmartPointer<vtkPlusReplayClock> clock = vtkSmartPointer<vtkPlusReplayClock>::New();
+    clock->SetMode(vtkPlusReplayClock::FREE_RUN);
+    clock->SetStepSec(STEP_SEC);
+    clock->Start(START_TIME);
+
+    vtkSmartPointer<vtkPlusDevice> deviceA = vtkSmartPointer<vtkPlusDevice>::New();
+    vtkSmartPointer<vtkPlusDevice> deviceB = vtkSmartPointer<vtkPlusDevice>::New();
+    clock->RegisterDevice(deviceA);
+    clock->RegisterDevice(deviceB);
+
+    // Device A has stepped, but device B has not: the clock must not advance
+    if (clock->WaitForNextStep(deviceA, 0.05))
+    {
+      LOG_ERROR("Clock advanced before all the registered devices have stepped");
+      numberOfErrors++;
+    }
+    if (clock->GetTime() != START_TIME)
+    {
+      LOG_ERROR("Clock time changed before all the registered devices have stepped: " << clock->GetTime() << " (expected: " << START_TIME << ")");
+      numberOfErrors++;
+    }
+
+    // Device B steps as well: the clock advances by one step
+    if (!clock->WaitForNextStep(deviceB, 0.05))
+    {
+      LOG_ERROR("Clock did not advance after all the registered devices have stepped");
+      numberOfErrors++;
+    }
+    if (clock->GetTime() != START_TIME + STEP_SEC)
+    {
+      LOG_ERROR("Clock time mismatch after one step: " << clock->GetTime() << " (expected: " << START_TIME + STEP_SEC << ")");
+      numberOfErrors++;
+    }
+
+    // Device A waits for device B, which is unregistered instead of stepping: device A must be released
+    std::atomic<bool> advanced(false);
+    std::thread waitingThread([&clock, &deviceA, &advanced]()
+    {
+      advanced = clock->WaitForNextStep(deviceA, 5.0);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    if (clock->GetTime() != START_TIME + STEP_SEC)
+    {
+      LOG_ERROR("Clock advanced while device B has not stepped: " << clock->GetTime());
+      numberOfErrors++;
+    }
+    clock->UnregisterDevice(deviceB);
+    waitingThread.join();
+    if (!advanced)
+    {
+      LOG_ERROR("Unregistering a device did not release the device that was waiting for it");
+      numberOfErrors++;
+    }
+    if (clock->GetTime() != START_TIME + 2 * STEP_SEC)
+    {
+      LOG_ERROR("Clock time mismatch after unregistering a device: " << clock->GetTime() << " (expected: " << START_TIME + 2 * STEP_SEC << ")");
+      numberOfErrors++;
+    }
+
+    // The clock does not advance while paused, even if all the devices have stepped
+    clock->Pause();
+    if (clock->WaitForNextStep(deviceA, 0.05))
+    {
+      LOG_ERROR("Clock advanced while paused");
+      numberOfErrors++;
+    }
+    clock->Resume();
+    if (clock->GetTime() != START_TIME + 3 * STEP_SEC)
+    {
+      LOG_ERROR("Clock did not advance when resumed: " << clock->GetTime() << " (expected: " << START_TIME + 3 * STEP_SEC << ")");
+      numberOfErrors++;
+    }
+
+    clock->UnregisterDevice(deviceA);
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestScaledPause()
+  {
+    int numberOfErrors = 0;
+    const double speedFactor = 10.0;
+
+    vtkSmartPointer<vtkPlusReplayClock> clock = vtkSmartPointer<vtkPlusReplayClock>::New();
+    clock->SetMode(vtkPlusReplayClock::SCALED);
+    clock->SetSpeedFactor(speedFactor);
+
+    // Started paused (as in vtkPlusDataCollector::Start): the clock stays at the start time until resumed
+    clock->Pause();
+    clock->Start(vtkIGSIOAccurateTimer::GetSystemTime());
+    vtkIGSIOAccurateTimer::Delay(0.1);
+    if (clock->GetTime() != clock->GetStartTime())
+    {
+      LOG_ERROR("Clock advanced while paused after start: " << clock->GetTime() - clock->GetStartTime() << " sec");
+      numberOfErrors++;
+    }
+
+    clock->Resume();
+    vtkIGSIOAccurateTimer::Delay(0.1);
+    double clockTimeBeforePause = clock->GetTime();
+    clock->Pause();
+    double pausedClockTime = clock->GetTime();
+    if (pausedClockTime - clock->GetStartTime() < 0.1 * speedFactor * 0.9)
+    {
+      LOG_ERROR("Clock did not advance after resume: " << pausedClockTime - clock->GetStartTime() << " sec (expected: " << 0.1 * speedFactor << " sec)");
+      numberOfErrors++;
+    }
+    if (pausedClockTime < clockTimeBeforePause)
+    {
+      LOG_ERROR("Clock went backward when paused: " << pausedClockTime << " (before: " << clockTimeBeforePause << ")");
+      numberOfErrors++;
+    }
+
+    // The system time that passes while paused is not added to the clock time
+    vtkIGSIOAccurateTimer::Delay(0.2);
+    if (clock->GetTime() != pausedClockTime)
+    {
+      LOG_ERROR("Clock advanced while paused: " << clock->GetTime() - pausedClockTime << " sec");
+      numberOfErrors++;
+    }
+    clock->Resume();
+    double resumedClockTime = clock->GetTime();
+    if (resumedClockTime - pausedClockTime > 0.2 * speedFactor / 2)
+    {
+      LOG_ERROR("Clock jumped ahead when resumed: " << resumedClockTime - pausedClockTime << " sec");
+      numberOfErrors++;
+    }
+
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  // Timestamps (relative to the start of the clock) of the frames of a data source that are not later than maxTimeSec
+  PlusStatus GetRelativeTimestamps(vtkPlusDataCollector* dataCollector, const std::string& deviceId, double maxTimeSec, std::vector<double>& timestamps)
+  {
+    vtkPlusDevice* device = NULL;
+    vtkPlusDataSource* source = NULL;
+    if (dataCollector->GetDevice(device, deviceId) != PLUS_SUCCESS || device->GetFirstActiveOutputVideoSource(source) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Unable to get the video source of device " << deviceId);
+      return PLUS_FAIL;
+    }
+
+    double startTime = dataCollector->GetReplayClock()->GetStartTime();
+    timestamps.clear();
+    for (BufferItemUidType uid = source->GetOldestItemUidInBuffer(); uid <= source->GetLatestItemUidInBuffer(); ++uid)
+    {
+      StreamBufferItem item;
+      if (source->GetStreamBufferItem(uid, &item) != ITEM_OK)
+      {
+        LOG_ERROR("Unable to get item " << uid << " from device " << deviceId);
+        return PLUS_FAIL;
+      }
+      double relativeTimestamp = item.GetFilteredTimestamp(source->GetLocalTimeOffsetSec()) - startTime;
+      if (relativeTimestamp > maxTimeSec)
+      {
+        break;
+      }
+      timestamps.push_back(relativeTimestamp);
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  // Replay the sequence file with two saved data sources until the clock reaches replayTimeSec and get the frame timestamps
+  PlusStatus Replay(const std::string& seqFileName, double replayTimeSec, std::vector<double>& timestampsA, std::vector<double>& timestampsB)
+  {
+    // The two devices are updated at different rates, so they have to wait for each other in the lock-step
+    std::ostringstream config;
+    config << "<PlusConfiguration version=\"2.1\">"
+           << "  <DataCollection StartupDelaySec=\"0\" ReplayClock=\"FREE_RUN\" ReplayStepSec=\"0.02\">"
+           << "    <DeviceSet Name=\"ReplayClockTest\" Description=\"Two saved data sources replayed in FREE_RUN mode\" />"
+           << "    <Device Id=\"VideoDeviceA\" Type=\"SavedDataSource\" SequenceFile=\"" << seqFileName << "\" UseData=\"IMAGE\" RepeatEnabled=\"TRUE\" AcquisitionRate=\"10\">"
+           << "      <DataSources><DataSource Type=\"Video\" Id=\"VideoA\" BufferSize=\"1000\" PortUsImageOrientation=\"MF\" /></DataSources>"
+           << "      <OutputChannels><OutputChannel Id=\"VideoStreamA\" VideoDataSourceId=\"VideoA\" /></OutputChannels>"
+           << "    </Device>"
+           << "    <Device Id=\"VideoDeviceB\" Type=\"SavedDataSource\" SequenceFile=\"" << seqFileName << "\" UseData=\"IMAGE\" RepeatEnabled=\"TRUE\" AcquisitionRate=\"7\">"
+           << "      <DataSources><DataSource Type=\"Video\" Id=\"VideoB\" BufferSize=\"1000\" PortUsImageOrientation=\"MF\" /></DataSources>"
+           << "      <OutputChannels><OutputChannel Id=\"VideoStreamB\" VideoDataSourceId=\"VideoB\" /></OutputChannels>"
+           << "    </Device>"
+           << "  </DataCollection>"
+           << "</PlusConfiguration>";
+    vtkSmartPointer<vtkXMLDataElement> configRootElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(config.str().c_str()));
+    if (configRootElement == NULL)
+    {
+      LOG_ERROR("Unable to parse test configuration");
+      return PLUS_FAIL;
+    }
+    vtkPlusConfig::GetInstance()->SetDeviceSetConfigurationData(configRootElement);
+
+    vtkSmartPointer<vtkPlusDataCollector> dataCollector = vtkSmartPointer<vtkPlusDataCollector>::New();
+    if (dataCollector->ReadConfiguration(configRootElement) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Configuration incorrect for ReplayClockTest.");
+      return PLUS_FAIL;
+    }
+    if (dataCollector->Connect() != PLUS_SUCCESS || dataCollector->Start() != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to start data collection!");
+      return PLUS_FAIL;
+    }
+
+    // The clock runs as fast as the devices can be updated, continue a bit longer than the compared time range
+    vtkPlusReplayClock* clock = dataCollector->GetReplayClock();
+    const double maxWaitTimeSec = 60.0;
+    double waitStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    while (clock->GetTime() - clock->GetStartTime() < replayTimeSec + 0.5)
+    {
+      if (vtkIGSIOAccurateTimer::GetSystemTime() - waitStartTime > maxWaitTimeSec)
+      {
+        LOG_ERROR("Replay clock did not reach " << replayTimeSec << " sec in " << maxWaitTimeSec << " sec");
+        return PLUS_FAIL;
+      }
+      vtkIGSIOAccurateTimer::Delay(0.01);
+    }
+    dataCollector->Stop();
+
+    PlusStatus status = PLUS_SUCCESS;
+    if (GetRelativeTimestamps(dataCollector, "VideoDeviceA", replayTimeSec, timestampsA) != PLUS_SUCCESS
+        || GetRelativeTimestamps(dataCollector, "VideoDeviceB", replayTimeSec, timestampsB) != PLUS_SUCCESS)
+    {
+      status = PLUS_FAIL;
+    }
+    dataCollector->Disconnect();
+    return status;
+  }
+
+  //----------------------------------------------------------------------------
+  int CompareTimestamps(const std::string& deviceId, int run, const std::vector<double>& expected, const std::vector<double>& actual)
+  {
+    if (expected.empty())
+    {
+      LOG_ERROR(deviceId << ": no frames were replayed");
+      return 1;
+    }
+    if (actual.size() != expected.size())
+    {
+      LOG_ERROR(deviceId << ": number of frames in run " << run << " is " << actual.size() << " (expected: " << expected.size() << ")");
+      return 1;
+    }
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+      // Timestamps are computed from the clock start time and an integer number of steps
+      if (std::fabs(actual[i] - expected[i]) > 1e-6)
+      {
+        LOG_ERROR(deviceId << ": timestamp of frame " << i << " in run " << run << " is " << actual[i] << " (expected: " << expected[i] << ")");
+        return 1;
+      }
+    }
+    return 0;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  std::string seqFileName;
+  double replayTimeSec(3.0);
+  int numberOfRuns(3);
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--seq-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &seqFileName, "Sequence file to replay in FREE_RUN mode. If not specified then only the clock is tested.");
+  args.AddArgument("--replay-time-sec", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &replayTimeSec, "Clock time range where the replayed timestamps are compared (default: 3 sec).");
+  args.AddArgument("--number-of-runs", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfRuns, "Number of times the sequence file is replayed (default: 3).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int numberOfErrors = TestFreeRunLockStep();
+  numberOfErrors += TestScaledPause();
+
+  if (!seqFileName.empty())
+  {
+    std::vector<double> expectedTimestampsA;
+    std::vector<double> expectedTimestampsB;
+    for (int run = 0; run < numberOfRuns; ++run)
+    {
+      std::vector<double> timestampsA;
+      std::vector<double> timestampsB;
+      if (Replay(seqFileName, replayTimeSec, timestampsA, timestampsB) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Replay " << run << " failed");
+        numberOfErrors++;
+        break;
+      }
+      if (run == 0)
+      {
+        expectedTimestampsA = timestampsA;
+        expectedTimestampsB = timestampsB;
+      }
+      numberOfErrors += CompareTimestamps("VideoDeviceA", run, expectedTimestampsA, timestampsA);
+      numberOfErrors += CompareTimestamps("VideoDeviceB", run, expectedTimestampsB, timestampsB);
+    }
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
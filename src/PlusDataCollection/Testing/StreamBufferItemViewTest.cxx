@@ -0,0 +1,169 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file StreamBufferItemViewTest.cxx
+  \brief This program tests that buffer item views share the pixel data with the buffer
+  and that their content is preserved when the buffer slot is overwritten.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkPlusBuffer.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+namespace
+{
+  const unsigned int FRAME_SIZE_X = 16;
+  const unsigned int FRAME_SIZE_Y = 8;
+
+  //----------------------------------------------------------------------------
+  PlusStatus AddFrame(vtkPlusBuffer* buffer, unsigned char pixelValue, long frameNumber)
+  {
+    std::vector<unsigned char> pixels(FRAME_SIZE_X * FRAME_SIZE_Y, pixelValue);
+    FrameSizeType frameSize = { FRAME_SIZE_X, FRAME_SIZE_Y, 1 };
+    std::array<int, 3> clipRectOrigin = { igsioCommon::NO_CLIP, igsioCommon::NO_CLIP, igsioCommon::NO_CLIP };
+    std::array<int, 3> clipRectSize = { igsioCommon::NO_CLIP, igsioCommon::NO_CLIP, igsioCommon::NO_CLIP };
+    double timestamp = 10.0 + frameNumber * 0.1;
+    return buffer->AddItem(&pixels[0], US_IMG_ORIENT_MF, frameSize, VTK_UNSIGNED_CHAR, 1, US_IMG_BRIGHTNESS, 0, frameNumber,
+                           clipRectOrigin, clipRectSize, timestamp, timestamp);
+  }
+
+  //----------------------------------------------------------------------------
+  bool AllPixelsEqual(StreamBufferItem& item, unsigned char expectedValue)
+  {
+    unsigned char* pixels = static_cast<unsigned char*>(item.GetFrame().GetScalarPointer());
+    if (pixels == NULL)
+    {
+      return false;
+    }
+    for (unsigned int i = 0; i < FRAME_SIZE_X * FRAME_SIZE_Y; ++i)
+    {
+      if (pixels[i] != expectedValue)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  int numberOfErrors(0);
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  vtkSmartPointer<vtkPlusBuffer> buffer = vtkSmartPointer<vtkPlusBuffer>::New();
+  buffer->SetBufferSize(2);
+  buffer->SetPixelType(VTK_UNSIGNED_CHAR);
+  buffer->SetNumberOfScalarComponents(1);
+  buffer->SetImageType(US_IMG_BRIGHTNESS);
+  buffer->SetImageOrientation(US_IMG_ORIENT_MF);
+  buffer->SetFrameSize(FRAME_SIZE_X, FRAME_SIZE_Y, 1);
+
+  if (AddFrame(buffer, 1, 0) != PLUS_SUCCESS || AddFrame(buffer, 2, 1) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to add frames to the buffer");
+    return EXIT_FAILURE;
+  }
+
+  // Take a view of the latest frame: it must reference the buffer slot
+  StreamBufferItem view;
+  if (buffer->GetLatestStreamBufferItemView(&view) != ITEM_OK)
+  {
+    LOG_ERROR("Failed to get latest buffer item view");
+    return EXIT_FAILURE;
+  }
+  if (!view.IsFrameStorageShared())
+  {
+    LOG_ERROR("Buffer item view does not share the pixel storage with the buffer");
+    numberOfErrors++;
+  }
+  if (!AllPixelsEqual(view, 2))
+  {
+    LOG_ERROR("Buffer item view content is invalid");
+    numberOfErrors++;
+  }
+
+  // Wrap around the ring twice, so that the slot of the viewed frame is overwritten
+  for (long frameNumber = 2; frameNumber < 6; ++frameNumber)
+  {
+    if (AddFrame(buffer, static_cast<unsigned char>(frameNumber + 1), frameNumber) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to add frame " << frameNumber << " to the buffer");
+      numberOfErrors++;
+    }
+  }
+
+  if (!AllPixelsEqual(view, 2))
+  {
+    LOG_ERROR("Buffer item view content changed after the buffer slot was reused");
+    numberOfErrors++;
+  }
+  if (view.IsFrameStorageShared())
+  {
+    LOG_ERROR("Buffer item view is still shared after the buffer slot was reused");
+    numberOfErrors++;
+  }
+
+  // The buffer content must be correct, too
+  StreamBufferItem latestItem;
+  if (buffer->GetLatestStreamBufferItem(&latestItem) != ITEM_OK || !AllPixelsEqual(latestItem, 6))
+  {
+    LOG_ERROR("Latest buffer item content is invalid");
+    numberOfErrors++;
+  }
+  StreamBufferItem oldestItem;
+  if (buffer->GetOldestStreamBufferItem(&oldestItem) != ITEM_OK || !AllPixelsEqual(oldestItem, 5))
+  {
+    LOG_ERROR("Oldest buffer item content is invalid");
+    numberOfErrors++;
+  }
+
+  // Deep copy into a view must not modify the buffer
+  StreamBufferItem secondView;
+  buffer->GetLatestStreamBufferItemView(&secondView);
+  secondView.DeepCopy(&oldestItem);
+  if (buffer->GetLatestStreamBufferItem(&latestItem) != ITEM_OK || !AllPixelsEqual(latestItem, 6))
+  {
+    LOG_ERROR("Deep copy into a buffer item view modified the buffer");
+    numberOfErrors++;
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
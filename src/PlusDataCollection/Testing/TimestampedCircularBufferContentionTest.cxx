@@ -0,0 +1,189 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file TimestampedCircularBufferContentionTest.cxx
+  \brief This program measures the throughput of timestamp queries while a producer thread
+  continuously adds items to the buffer. The measurement is repeated with an increasing number of reader
+  threads, both with locked and with lock-free timestamp queries. Results of all queries are validated.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkPlusBuffer.h"
+
+// IGSIO includes
+#include <vtkIGSIOAccurateTimer.h>
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <atomic>
+#include <iomanip>
+#include <thread>
+
+namespace
+{
+  const double ITEM_PERIOD_SEC = 0.001;
+
+  struct ContentionState
+  {
+    vtkPlusBuffer* Buffer;
+    std::atomic<bool> Stop;
+    std::atomic<unsigned long> NumberOfQueries;
+    std::atomic<unsigned long> NumberOfInvalidResults;
+    std::atomic<unsigned long> NumberOfAddedItems;
+  };
+
+  //----------------------------------------------------------------------------
+  void WriterThread(ContentionState* state)
+  {
+    vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    unsigned long frameNumber = 0;
+    while (!state->Stop)
+    {
+      // item with UID n has timestamp (n-1)*ITEM_PERIOD_SEC, which allows validation of the query results
+      double timestamp = frameNumber * ITEM_PERIOD_SEC;
+      matrix->SetElement(0, 3, timestamp);
+      if (state->Buffer->AddTimeStampedItem(matrix, TOOL_OK, frameNumber, timestamp, timestamp) == PLUS_SUCCESS)
+      {
+        state->NumberOfAddedItems++;
+      }
+      frameNumber++;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void ReaderThread(ContentionState* state, unsigned int seed)
+  {
+    unsigned long numberOfQueries = 0;
+    unsigned long numberOfInvalidResults = 0;
+    while (!state->Stop)
+    {
+      BufferItemUidType latestUid = state->Buffer->GetLatestItemUidInBuffer();
+      if (latestUid < 1)
+      {
+        continue;
+      }
+      double latestTimestamp = 0;
+      if (state->Buffer->GetTimeStamp(latestUid, latestTimestamp) == ITEM_OK
+          && fabs(latestTimestamp - (latestUid - 1) * ITEM_PERIOD_SEC) > 1e-9)
+      {
+        numberOfInvalidResults++;
+      }
+
+      // query a time between two items, somewhere in the recent past
+      seed = seed * 1103515245 + 12345;
+      double queryTime = latestTimestamp - ((seed >> 16) % 100 + 0.3) * ITEM_PERIOD_SEC;
+      BufferItemUidType uid = 0;
+      if (state->Buffer->GetItemUidFromTime(queryTime, uid) == ITEM_OK
+          && fabs((uid - 1) * ITEM_PERIOD_SEC - queryTime) > 0.5 * ITEM_PERIOD_SEC + 1e-9)
+      {
+        numberOfInvalidResults++;
+      }
+      numberOfQueries += 3;
+    }
+    state->NumberOfQueries += numberOfQueries;
+    state->NumberOfInvalidResults += numberOfInvalidResults;
+  }
+
+  //----------------------------------------------------------------------------
+  double MeasureQueryRate(bool lockFree, int numberOfReaders, double durationSec, unsigned long& numberOfInvalidResults, double& itemRate)
+  {
+    vtkSmartPointer<vtkPlusBuffer> buffer = vtkSmartPointer<vtkPlusBuffer>::New();
+    buffer->SetBufferSize(500);
+    buffer->SetLockFreeTimestampQueries(lockFree);
+
+    ContentionState state;
+    state.Buffer = buffer;
+    state.Stop = false;
+    state.NumberOfQueries = 0;
+    state.NumberOfInvalidResults = 0;
+    state.NumberOfAddedItems = 0;
+
+    std::thread writer(WriterThread, &state);
+    std::vector<std::thread> readers;
+    for (int i = 0; i < numberOfReaders; ++i)
+    {
+      readers.push_back(std::thread(ReaderThread, &state, static_cast<unsigned int>(i + 1)));
+    }
+
+    double startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    vtkIGSIOAccurateTimer::Delay(durationSec);
+    state.Stop = true;
+    for (std::vector<std::thread>::iterator it = readers.begin(); it != readers.end(); ++it)
+    {
+      it->join();
+    }
+    writer.join();
+    double elapsedTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - startTime;
+
+    numberOfInvalidResults = state.NumberOfInvalidResults;
+    itemRate = state.NumberOfAddedItems / elapsedTimeSec;
+    return state.NumberOfQueries / elapsedTimeSec;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+  int maxNumberOfReaders = 8;
+  double durationSec = 0.5;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--max-readers", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &maxNumberOfReaders, "Maximum number of reader threads (default: 8). Number of readers is doubled in each measurement.");
+  args.AddArgument("--duration-sec", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &durationSec, "Duration of each measurement in seconds (default: 0.5)");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int numberOfErrors(0);
+  std::cout << "Readers, Locked queries/sec, Lock-free queries/sec, Locked items/sec, Lock-free items/sec" << std::endl;
+  for (int numberOfReaders = 1; numberOfReaders <= maxNumberOfReaders; numberOfReaders *= 2)
+  {
+    unsigned long lockedInvalidResults(0);
+    unsigned long lockFreeInvalidResults(0);
+    double lockedItemRate(0);
+    double lockFreeItemRate(0);
+    double lockedQueryRate = MeasureQueryRate(false, numberOfReaders, durationSec, lockedInvalidResults, lockedItemRate);
+    double lockFreeQueryRate = MeasureQueryRate(true, numberOfReaders, durationSec, lockFreeInvalidResults, lockFreeItemRate);
+    std::cout << numberOfReaders << ", " << std::fixed << std::setprecision(0) << lockedQueryRate << ", " << lockFreeQueryRate
+              << ", " << lockedItemRate << ", " << lockFreeItemRate << std::endl;
+    if (lockedInvalidResults > 0 || lockFreeInvalidResults > 0)
+    {
+      LOG_ERROR("Invalid query results with " << numberOfReaders << " readers: " << lockedInvalidResults << " (locked), " << lockFreeInvalidResults << " (lock-free)");
+      numberOfErrors++;
+    }
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,310 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file TrackerBufferTest.cxx
+  \brief This program tests that the compact tracker buffer returns the same items as the generic buffer
+  (after wraparound, resize and deep copy in both directions), with both locked and lock-free timestamp queries,
+  and that the allocation-free interpolated pose query gives the same result as the interpolated buffer item query.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusMath.h"
+#include "vtkPlusBuffer.h"
+#include "vtkPlusTrackerBuffer.h"
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtkTransform.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+namespace
+{
+  const double START_TIME = 100.0;
+  const double SAMPLING_PERIOD_SEC = 0.01;
+
+  //----------------------------------------------------------------------------
+  PlusStatus AddPose(vtkPlusBuffer* buffer, int frameNumber)
+  {
+    vtkSmartPointer<vtkTransform> transform = vtkSmartPointer<vtkTransform>::New();
+    transform->Translate(frameNumber * 0.5, 10.0 - frameNumber, 3.0);
+    transform->RotateZ(frameNumber * 2.0);
+    transform->RotateX(frameNumber * 0.5);
+
+    // Every 4th item is missing, every 3rd item has a custom field
+    ToolStatus status = (frameNumber % 4 == 0 ? TOOL_MISSING : TOOL_OK);
+    igsioFieldMapType fields;
+    if (frameNumber % 3 == 0)
+    {
+      std::ostringstream value;
+      value << "Value" << frameNumber;
+      fields["TestField"].first = FRAMEFIELD_NONE;
+      fields["TestField"].second = value.str();
+    }
+
+    double timestamp = START_TIME + frameNumber * SAMPLING_PERIOD_SEC;
+    return buffer->AddTimeStampedItem(transform->GetMatrix(), status, frameNumber, timestamp, timestamp, &fields);
+  }
+
+  //----------------------------------------------------------------------------
+  int CompareItems(StreamBufferItem& expected, StreamBufferItem& actual, const std::string& description)
+  {
+    int numberOfErrors = 0;
+    if (expected.GetIndex() != actual.GetIndex() || expected.GetStatus() != actual.GetStatus()
+        || fabs(expected.GetFilteredTimestamp(0) - actual.GetFilteredTimestamp(0)) > 1e-9
+        || fabs(expected.GetUnfilteredTimestamp(0) - actual.GetUnfilteredTimestamp(0)) > 1e-9)
+    {
+      LOG_ERROR(description << ": item mismatch (index: " << expected.GetIndex() << " vs " << actual.GetIndex()
+                << ", status: " << expected.GetStatus() << " vs " << actual.GetStatus()
+                << ", timestamp: " << std::fixed << expected.GetFilteredTimestamp(0) << " vs " << actual.GetFilteredTimestamp(0) << ")");
+      numberOfErrors++;
+    }
+    if (expected.GetFrameField("TestField") != actual.GetFrameField("TestField"))
+    {
+      LOG_ERROR(description << ": field mismatch (" << expected.GetFrameField("TestField") << " vs " << actual.GetFrameField("TestField") << ")");
+      numberOfErrors++;
+    }
+    vtkSmartPointer<vtkMatrix4x4> expectedMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    vtkSmartPointer<vtkMatrix4x4> actualMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    expected.GetMatrix(expectedMatrix);
+    actual.GetMatrix(actualMatrix);
+    for (int row = 0; row < 4; ++row)
+    {
+      for (int col = 0; col < 4; ++col)
+      {
+        if (fabs(expectedMatrix->GetElement(row, col) - actualMatrix->GetElement(row, col)) > 1e-9)
+        {
+          LOG_ERROR(description << ": matrix mismatch at (" << row << "," << col << "): "
+                    << expectedMatrix->GetElement(row, col) << " vs " << actualMatrix->GetElement(row, col));
+          return numberOfErrors + 1;
+        }
+      }
+    }
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int ComparePose(StreamBufferItem& expected, vtkPlusBuffer* buffer, double time, const std::string& description)
+  {
+    double pose[vtkPlusBuffer::POSE_SIZE] = { 0 };
+    ToolStatus status(TOOL_UNKNOWN);
+    igsioFieldMapType fields;
+    if (buffer->GetInterpolatedPoseFromTime(time, pose, status, &fields) != ITEM_OK)
+    {
+      LOG_ERROR(description << ": failed to get pose at time " << std::fixed << time);
+      return 1;
+    }
+    if (status != expected.GetStatus())
+    {
+      LOG_ERROR(description << ": status mismatch at time " << std::fixed << time << " (" << expected.GetStatus() << " vs " << status << ")");
+      return 1;
+    }
+    std::string fieldValue = (fields.find("TestField") != fields.end() ? fields["TestField"].second : "");
+    if (fieldValue != expected.GetFrameField("TestField"))
+    {
+      LOG_ERROR(description << ": field mismatch (" << expected.GetFrameField("TestField") << " vs " << fieldValue << ")");
+      return 1;
+    }
+    double expectedPose[vtkPlusBuffer::POSE_SIZE] = { 0 };
+    expected.GetPose(expectedPose);
+    for (int i = 0; i < vtkPlusBuffer::POSE_SIZE; ++i)
+    {
+      if (fabs(expectedPose[i] - pose[i]) > 1e-9)
+      {
+        LOG_ERROR(description << ": pose mismatch at time " << std::fixed << time << " element " << i << ": " << expectedPose[i] << " vs " << pose[i]);
+        return 1;
+      }
+    }
+    return 0;
+  }
+
+  //----------------------------------------------------------------------------
+  int CompareBuffers(vtkPlusBuffer* expected, vtkPlusBuffer* actual, const std::string& description)
+  {
+    int numberOfErrors = 0;
+    if (expected->GetNumberOfItems() != actual->GetNumberOfItems()
+        || expected->GetOldestItemUidInBuffer() != actual->GetOldestItemUidInBuffer()
+        || expected->GetLatestItemUidInBuffer() != actual->GetLatestItemUidInBuffer())
+    {
+      LOG_ERROR(description << ": buffer content mismatch (number of items: " << expected->GetNumberOfItems() << " vs " << actual->GetNumberOfItems()
+                << ", oldest UID: " << expected->GetOldestItemUidInBuffer() << " vs " << actual->GetOldestItemUidInBuffer()
+                << ", latest UID: " << expected->GetLatestItemUidInBuffer() << " vs " << actual->GetLatestItemUidInBuffer() << ")");
+      return 1;
+    }
+
+    // Items by UID
+    for (BufferItemUidType uid = expected->GetOldestItemUidInBuffer(); uid <= expected->GetLatestItemUidInBuffer(); ++uid)
+    {
+      StreamBufferItem expectedItem;
+      StreamBufferItem actualItem;
+      if (expected->GetStreamBufferItem(uid, &expectedItem) != ITEM_OK || actual->GetStreamBufferItem(uid, &actualItem) != ITEM_OK)
+      {
+        LOG_ERROR(description << ": failed to get item " << uid);
+        numberOfErrors++;
+        continue;
+      }
+      numberOfErrors += CompareItems(expectedItem, actualItem, description);
+    }
+
+    // Items by time (queries outside of the buffer range would log warnings)
+    double oldestTime(0);
+    double latestTime(0);
+    if (expected->GetOldestTimeStamp(oldestTime) != ITEM_OK || expected->GetLatestTimeStamp(latestTime) != ITEM_OK)
+    {
+      return numberOfErrors;
+    }
+    for (double time = oldestTime; time <= latestTime; time += SAMPLING_PERIOD_SEC * 0.3)
+    {
+      BufferItemUidType expectedUid(0);
+      BufferItemUidType actualUid(0);
+      ItemStatus expectedStatus = expected->GetItemUidFromTime(time, expectedUid);
+      ItemStatus actualStatus = actual->GetItemUidFromTime(time, actualUid);
+      if (expectedStatus != actualStatus || (expectedStatus == ITEM_OK && expectedUid != actualUid))
+      {
+        LOG_ERROR(description << ": item UID from time " << std::fixed << time << " mismatch (status: " << expectedStatus << " vs " << actualStatus
+                  << ", UID: " << expectedUid << " vs " << actualUid << ")");
+        numberOfErrors++;
+      }
+
+      StreamBufferItem expectedItem;
+      StreamBufferItem actualItem;
+      expectedStatus = expected->GetStreamBufferItemFromTime(time, &expectedItem, vtkPlusBuffer::INTERPOLATED);
+      actualStatus = actual->GetStreamBufferItemFromTime(time, &actualItem, vtkPlusBuffer::INTERPOLATED);
+      if (expectedStatus != actualStatus)
+      {
+        LOG_ERROR(description << ": interpolated item status mismatch at time " << std::fixed << time << " (" << expectedStatus << " vs " << actualStatus << ")");
+        numberOfErrors++;
+      }
+      else if (expectedStatus == ITEM_OK)
+      {
+        numberOfErrors += CompareItems(expectedItem, actualItem, description + " (interpolated)");
+        numberOfErrors += ComparePose(expectedItem, actual, time, description + " (interpolated pose)");
+      }
+    }
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestTrackerBuffer(bool lockFreeTimestampQueries)
+  {
+    int numberOfErrors(0);
+    const std::string mode = (lockFreeTimestampQueries ? " (lock-free queries)" : " (locked queries)");
+
+    vtkSmartPointer<vtkPlusBuffer> genericBuffer = vtkSmartPointer<vtkPlusBuffer>::New();
+    vtkSmartPointer<vtkPlusTrackerBuffer> trackerBuffer = vtkSmartPointer<vtkPlusTrackerBuffer>::New();
+    trackerBuffer->SetLockFreeTimestampQueries(lockFreeTimestampQueries);
+    genericBuffer->SetBufferSize(50);
+    trackerBuffer->SetBufferSize(50);
+
+    // Empty buffers
+    numberOfErrors += CompareBuffers(genericBuffer, trackerBuffer, "Empty buffer" + mode);
+
+    // Fill the buffers more than twice, so that the ring wraps around
+    for (int frameNumber = 0; frameNumber < 120; ++frameNumber)
+    {
+      if (AddPose(genericBuffer, frameNumber) != PLUS_SUCCESS || AddPose(trackerBuffer, frameNumber) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to add item " << frameNumber);
+        numberOfErrors++;
+      }
+    }
+    numberOfErrors += CompareBuffers(genericBuffer, trackerBuffer, "After wraparound" + mode);
+
+    // Poses can be read without creating buffer items
+    double pose[vtkPlusTrackerBuffer::POSE_SIZE] = { 0 };
+    ToolStatus status(TOOL_UNKNOWN);
+    double timestamp(0);
+    if (trackerBuffer->GetPose(trackerBuffer->GetLatestItemUidInBuffer(), pose, status, timestamp) != ITEM_OK
+        || status != TOOL_OK || fabs(timestamp - (START_TIME + 119 * SAMPLING_PERIOD_SEC)) > 1e-9 || fabs(pose[3] - 119 * 0.5) > 1e-9)
+    {
+      LOG_ERROR("Invalid latest pose (status: " << status << ", timestamp: " << std::fixed << timestamp << ", x: " << pose[3] << ")");
+      numberOfErrors++;
+    }
+    if (trackerBuffer->GetPose(0, pose, status, timestamp) != ITEM_NOT_AVAILABLE_ANYMORE)
+    {
+      LOG_ERROR("Overwritten pose is still available");
+      numberOfErrors++;
+    }
+
+    // Resize: the most recent items are kept
+    genericBuffer->SetBufferSize(30);
+    trackerBuffer->SetBufferSize(30);
+    numberOfErrors += CompareBuffers(genericBuffer, trackerBuffer, "After shrinking" + mode);
+    genericBuffer->SetBufferSize(80);
+    trackerBuffer->SetBufferSize(80);
+    numberOfErrors += CompareBuffers(genericBuffer, trackerBuffer, "After growing" + mode);
+    for (int frameNumber = 120; frameNumber < 150; ++frameNumber)
+    {
+      if (AddPose(genericBuffer, frameNumber) != PLUS_SUCCESS || AddPose(trackerBuffer, frameNumber) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to add item " << frameNumber);
+        numberOfErrors++;
+      }
+    }
+    numberOfErrors += CompareBuffers(genericBuffer, trackerBuffer, "After adding items to resized buffer" + mode);
+
+    // Deep copy in both directions
+    vtkSmartPointer<vtkPlusBuffer> genericCopy = vtkSmartPointer<vtkPlusBuffer>::New();
+    genericCopy->DeepCopy(trackerBuffer);
+    numberOfErrors += CompareBuffers(genericBuffer, genericCopy, "Generic copy of tracker buffer" + mode);
+    vtkSmartPointer<vtkPlusTrackerBuffer> trackerCopy = vtkSmartPointer<vtkPlusTrackerBuffer>::New();
+    trackerCopy->SetLockFreeTimestampQueries(lockFreeTimestampQueries);
+    trackerCopy->DeepCopy(genericBuffer);
+    numberOfErrors += CompareBuffers(genericBuffer, trackerCopy, "Tracker copy of generic buffer" + mode);
+    vtkSmartPointer<vtkPlusTrackerBuffer> trackerToTrackerCopy = vtkSmartPointer<vtkPlusTrackerBuffer>::New();
+    trackerToTrackerCopy->SetLockFreeTimestampQueries(lockFreeTimestampQueries);
+    trackerToTrackerCopy->DeepCopy(trackerBuffer);
+    numberOfErrors += CompareBuffers(genericBuffer, trackerToTrackerCopy, "Tracker copy of tracker buffer" + mode);
+
+    // Clear
+    genericBuffer->Clear();
+    trackerBuffer->Clear();
+    numberOfErrors += CompareBuffers(genericBuffer, trackerBuffer, "After clear" + mode);
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  int numberOfErrors(0);
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  // The generic buffer is the reference, it always uses locked queries
+  numberOfErrors += TestTrackerBuffer(false);
+  numberOfErrors += TestTrackerBuffer(true);
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
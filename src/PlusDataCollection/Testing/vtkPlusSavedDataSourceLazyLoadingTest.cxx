@@ -0,0 +1,277 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkPlusSavedDataSourceLazyLoadingTest.cxx
+  \brief Converts a sequence file to a chunked sequence file (.pseq) and replays it with a saved data source
+  in FREE_RUN mode with and without lazy loading. Verifies that the replayed frames (timestamps and pixels) are the
+  same in both modes over more than one loop, and after the lazy loading data source is disconnected and reconnected.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkIGSIOAccurateTimer.h"
+#include "vtkIGSIOTrackedFrameList.h"
+#include "vtkPlusChunkedSequenceIO.h"
+#include "vtkPlusDataCollector.h"
+#include "vtkPlusDataSource.h"
+#include "vtkPlusDevice.h"
+#include "vtkPlusReplayClock.h"
+#include "vtkPlusSequenceIO.h"
+
+// VTK includes
+#include <vtkXMLUtilities.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <cmath>
+#include <sstream>
+
+namespace
+{
+  const double ACQUISITION_RATE = 50.0;
+  const char DEVICE_ID[] = "VideoDevice";
+
+  struct ReplayedFrame
+  {
+    double Timestamp;
+    unsigned long long PixelDigest;
+  };
+
+  //----------------------------------------------------------------------------
+  // FNV-1a hash of the pixels, so that the frames of the runs do not have to be kept in memory
+  unsigned long long GetPixelDigest(igsioVideoFrame& frame)
+  {
+    const unsigned char* pixel = static_cast<const unsigned char*>(frame.GetScalarPointer());
+    unsigned long long digest = 14695981039346656037ULL;
+    for (unsigned long i = 0; i < frame.GetFrameSizeInBytes(); ++i)
+    {
+      digest = (digest ^ pixel[i]) * 1099511628211ULL;
+    }
+    return digest;
+  }
+
+  //----------------------------------------------------------------------------
+  vtkSmartPointer<vtkPlusDataCollector> CreateDataCollector(const std::string& pseqFileName, bool lazyLoading, int bufferSize)
+  {
+    // One frame is replayed in each step of the clock
+    std::ostringstream config;
+    config << "<PlusConfiguration version=\"2.1\">"
+           << "  <DataCollection StartupDelaySec=\"0\" ReplayClock=\"FREE_RUN\" ReplayStepSec=\"" << 1.0 / ACQUISITION_RATE << "\">"
+           << "    <DeviceSet Name=\"vtkPlusSavedDataSourceLazyLoadingTest\" Description=\"Saved data source replayed in FREE_RUN mode\" />"
+           << "    <Device Id=\"" << DEVICE_ID << "\" Type=\"SavedDataSource\" SequenceFile=\"" << pseqFileName << "\" UseData=\"IMAGE\" RepeatEnabled=\"TRUE\""
+           << "      AcquisitionRate=\"" << ACQUISITION_RATE << "\" LazyLoading=\"" << (lazyLoading ? "TRUE" : "FALSE") << "\" ReadAheadFrames=\"4\">"
+           << "      <DataSources><DataSource Type=\"Video\" Id=\"Video\" BufferSize=\"" << bufferSize << "\" PortUsImageOrientation=\"MF\" /></DataSources>"
+           << "      <OutputChannels><OutputChannel Id=\"VideoStream\" VideoDataSourceId=\"Video\" /></OutputChannels>"
+           << "    </Device>"
+           << "  </DataCollection>"
+           << "</PlusConfiguration>";
+    vtkSmartPointer<vtkXMLDataElement> configRootElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(config.str().c_str()));
+    if (configRootElement == NULL)
+    {
+      LOG_ERROR("Unable to parse test configuration");
+      return NULL;
+    }
+    vtkPlusConfig::GetInstance()->SetDeviceSetConfigurationData(configRootElement);
+
+    vtkSmartPointer<vtkPlusDataCollector> dataCollector = vtkSmartPointer<vtkPlusDataCollector>::New();
+    if (dataCollector->ReadConfiguration(configRootElement) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Configuration incorrect for vtkPlusSavedDataSourceLazyLoadingTest.");
+      return NULL;
+    }
+    return dataCollector;
+  }
+
+  //----------------------------------------------------------------------------
+  // Connect and start the data collector, replay until the clock reaches replayTimeSec and get the replayed frames
+  PlusStatus Replay(vtkPlusDataCollector* dataCollector, double replayTimeSec, std::vector<ReplayedFrame>& frames)
+  {
+    if (dataCollector->Connect() != PLUS_SUCCESS || dataCollector->Start() != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to start data collection!");
+      return PLUS_FAIL;
+    }
+
+    // The clock runs as fast as the device can be updated, continue a bit longer than the compared time range
+    vtkPlusReplayClock* clock = dataCollector->GetReplayClock();
+    const double maxWaitTimeSec = 60.0;
+    double waitStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    while (clock->GetTime() - clock->GetStartTime() < replayTimeSec + 0.5)
+    {
+      if (vtkIGSIOAccurateTimer::GetSystemTime() - waitStartTime > maxWaitTimeSec)
+      {
+        LOG_ERROR("Replay clock did not reach " << replayTimeSec << " sec in " << maxWaitTimeSec << " sec");
+        dataCollector->Disconnect();
+        return PLUS_FAIL;
+      }
+      vtkIGSIOAccurateTimer::Delay(0.01);
+    }
+    dataCollector->Stop();
+
+    vtkPlusDevice* device = NULL;
+    vtkPlusDataSource* source = NULL;
+    if (dataCollector->GetDevice(device, DEVICE_ID) != PLUS_SUCCESS || device->GetFirstActiveOutputVideoSource(source) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Unable to get the video source of device " << DEVICE_ID);
+      dataCollector->Disconnect();
+      return PLUS_FAIL;
+    }
+
+    PlusStatus status = PLUS_SUCCESS;
+    double startTime = clock->GetStartTime();
+    frames.clear();
+    for (BufferItemUidType uid = source->GetOldestItemUidInBuffer(); uid <= source->GetLatestItemUidInBuffer(); ++uid)
+    {
+      StreamBufferItem item;
+      if (source->GetStreamBufferItem(uid, &item) != ITEM_OK)
+      {
+        LOG_ERROR("Unable to get item " << uid << " from device " << DEVICE_ID);
+        status = PLUS_FAIL;
+        break;
+      }
+      ReplayedFrame frame;
+      frame.Timestamp = item.GetFilteredTimestamp(source->GetLocalTimeOffsetSec()) - startTime;
+      if (frame.Timestamp > replayTimeSec)
+      {
+        break;
+      }
+      frame.PixelDigest = GetPixelDigest(item.GetFrame());
+      frames.push_back(frame);
+    }
+
+    dataCollector->Disconnect();
+    return status;
+  }
+
+  //----------------------------------------------------------------------------
+  int CompareFrames(const std::string& runName, const std::vector<ReplayedFrame>& expected, const std::vector<ReplayedFrame>& actual)
+  {
+    if (actual.size() != expected.size())
+    {
+      LOG_ERROR(runName << ": number of replayed frames is " << actual.size() << " (expected: " << expected.size() << ")");
+      return 1;
+    }
+    int numberOfErrors = 0;
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+      // Timestamps are computed from the clock start time and an integer number of steps
+      if (std::fabs(actual[i].Timestamp - expected[i].Timestamp) > 1e-6)
+      {
+        LOG_ERROR(runName << ": timestamp of frame " << i << " is " << actual[i].Timestamp << " (expected: " << expected[i].Timestamp << ")");
+        numberOfErrors++;
+      }
+      if (actual[i].PixelDigest != expected[i].PixelDigest)
+      {
+        LOG_ERROR(runName << ": pixels of frame " << i << " differ from the frame replayed without lazy loading");
+        numberOfErrors++;
+      }
+    }
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  std::string seqFileName;
+  double numberOfLoops(2.5);
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--seq-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &seqFileName, "Sequence file that is converted to a chunked sequence file and replayed.");
+  args.AddArgument("--number-of-loops", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfLoops, "Number of times the sequence is replayed in each run (default: 2.5).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "\n\nvtkPlusSavedDataSourceLazyLoadingTest help:" << args.GetHelp() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (printHelp)
+  {
+    std::cout << "\n\nvtkPlusSavedDataSourceLazyLoadingTest help:" << args.GetHelp() << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  if (seqFileName.empty())
+  {
+    LOG_ERROR("--seq-file argument is required!");
+    return EXIT_FAILURE;
+  }
+
+  // Lazy loading is only supported for chunked sequence files
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> frameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  if (vtkPlusSequenceIO::Read(seqFileName, frameList) != PLUS_SUCCESS || frameList->GetNumberOfTrackedFrames() < 2)
+  {
+    LOG_ERROR("Failed to read frames from " << seqFileName);
+    return EXIT_FAILURE;
+  }
+  const std::string pseqFileName = vtkPlusConfig::GetInstance()->GetOutputPath("SavedDataSourceLazyLoadingTest.pseq");
+  if (vtkPlusChunkedSequenceIO::Write(pseqFileName, frameList) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to write " << pseqFileName);
+    return EXIT_FAILURE;
+  }
+
+  // The frames are replayed at ACQUISITION_RATE, so the loop is longer than the original recording if it was faster
+  const int numberOfFramesInTheLoop = static_cast<int>(frameList->GetNumberOfTrackedFrames());
+  const double replayTimeSec = numberOfLoops * numberOfFramesInTheLoop / ACQUISITION_RATE;
+  const int bufferSize = static_cast<int>((replayTimeSec + 1.0) * ACQUISITION_RATE) + 10;
+  frameList->Clear();
+
+  int numberOfErrors = 0;
+
+  std::vector<ReplayedFrame> eagerFrames;
+  vtkSmartPointer<vtkPlusDataCollector> eagerDataCollector = CreateDataCollector(pseqFileName, false, bufferSize);
+  if (eagerDataCollector == NULL || Replay(eagerDataCollector, replayTimeSec, eagerFrames) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Replay without lazy loading failed");
+    return EXIT_FAILURE;
+  }
+  if (eagerFrames.size() <= static_cast<size_t>(numberOfFramesInTheLoop))
+  {
+    LOG_ERROR("Only " << eagerFrames.size() << " frames were replayed, the loop of " << numberOfFramesInTheLoop << " frames was not repeated");
+    numberOfErrors++;
+  }
+
+  vtkSmartPointer<vtkPlusDataCollector> lazyDataCollector = CreateDataCollector(pseqFileName, true, bufferSize);
+  if (lazyDataCollector == NULL)
+  {
+    return EXIT_FAILURE;
+  }
+  // The same data collector is connected twice, so that the reader and the read-ahead thread are restarted
+  const char* runNames[2] = { "Lazy loading", "Lazy loading after reconnect" };
+  for (int run = 0; run < 2; ++run)
+  {
+    std::vector<ReplayedFrame> lazyFrames;
+    if (Replay(lazyDataCollector, replayTimeSec, lazyFrames) != PLUS_SUCCESS)
+    {
+      LOG_ERROR(runNames[run] << ": replay failed");
+      numberOfErrors++;
+      break;
+    }
+    numberOfErrors += CompareFrames(runNames[run], eagerFrames, lazyFrames);
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
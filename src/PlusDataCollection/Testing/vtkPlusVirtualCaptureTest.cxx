@@ -0,0 +1,226 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkPlusVirtualCaptureTest.cxx
+  \brief Records a saved data source with a virtual capture device using the same calls as the start/suspend/stop
+  recording commands: start, suspend, start again (into a new file) and stop. Verifies that each file contains
+  exactly the frames that were recorded into it, while batches are still queued for the writer thread when the
+  second recording is started.
+*/
+
+#include "PlusConfigure.h"
+#include "vtkIGSIOAccurateTimer.h"
+#include "vtkIGSIOSequenceIO.h"
+#include "vtkIGSIOTrackedFrameList.h"
+#include "vtkPlusChannel.h"
+#include "vtkPlusChunkedSequenceIO.h"
+#include "vtkPlusDataCollector.h"
+#include "vtkPlusVirtualCapture.h"
+#include "vtkXMLUtilities.h"
+#include "vtksys/CommandLineArguments.hxx"
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  PlusStatus GetNumberOfFramesInFile(const std::string& filename, unsigned int& numberOfFrames)
+  {
+    std::string fullPath = vtkPlusConfig::GetInstance()->GetOutputPath(filename);
+    if (vtkPlusChunkedSequenceIO::CanReadWriteFile(fullPath))
+    {
+      vtkSmartPointer<vtkPlusChunkedSequenceIO> reader = vtkSmartPointer<vtkPlusChunkedSequenceIO>::New();
+      if (reader->OpenForReading(fullPath) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Unable to read " << fullPath);
+        return PLUS_FAIL;
+      }
+      numberOfFrames = reader->GetNumberOfFrames();
+      reader->Close();
+      return PLUS_SUCCESS;
+    }
+
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> frameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    if (vtkIGSIOSequenceIO::Read(fullPath, frameList) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Unable to read " << fullPath);
+      return PLUS_FAIL;
+    }
+    numberOfFrames = frameList->GetNumberOfTrackedFrames();
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  // Record for the specified time then suspend, returns the number of frames recorded into the current file
+  long RecordAndSuspend(vtkPlusVirtualCapture* captureDevice, double recordingTimeSec)
+  {
+    captureDevice->SetEnableCapturing(true);
+    vtkIGSIOAccurateTimer::Delay(recordingTimeSec);
+    captureDevice->SetEnableCapturing(false);
+    // let the update that may be in progress complete
+    vtkIGSIOAccurateTimer::Delay(0.2);
+    return captureDevice->GetTotalFramesRecorded();
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  std::string inputSeqFileName;
+  std::string outputExtension(".igs.mha");
+  double recordingTimeSec(1.5);
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--seq-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputSeqFileName, "Sequence file that is replayed by a saved data source and recorded.");
+  args.AddArgument("--output-extension", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &outputExtension, "Extension of the recorded files (default: .igs.mha).");
+  args.AddArgument("--recording-time-sec", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &recordingTimeSec, "Duration of each recording (default: 1.5 sec).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "\n\nvtkPlusVirtualCaptureTest help:" << args.GetHelp() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (printHelp)
+  {
+    std::cout << "\n\nvtkPlusVirtualCaptureTest help:" << args.GetHelp() << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  if (inputSeqFileName.empty())
+  {
+    LOG_ERROR("--seq-file is required");
+    return EXIT_FAILURE;
+  }
+
+  // Small frame buffer and writer queue, so that batches are waiting for the writer when recording is restarted
+  std::ostringstream config;
+  config << "<PlusConfiguration version=\"2.1\">"
+         << "  <DataCollection StartupDelaySec=\"0.5\">"
+         << "    <DeviceSet Name=\"VirtualCaptureTest\" Description=\"Start, suspend, start and stop recording\" />"
+         << "    <Device Id=\"VideoDevice\" Type=\"SavedDataSource\" SequenceFile=\"" << inputSeqFileName << "\" UseData=\"IMAGE\" RepeatEnabled=\"TRUE\" AcquisitionRate=\"30\">"
+         << "      <DataSources><DataSource Type=\"Video\" Id=\"Video\" BufferSize=\"100\" PortUsImageOrientation=\"MF\" /></DataSources>"
+         << "      <OutputChannels><OutputChannel Id=\"VideoStream\" VideoDataSourceId=\"Video\" /></OutputChannels>"
+         << "    </Device>"
+         << "    <Device Id=\"CaptureDevice\" Type=\"VirtualCapture\" BaseFilename=\"VirtualCaptureTest" << outputExtension << "\" EnableCapturingOnStart=\"FALSE\""
+         << "      RequestedFrameRate=\"30\" FrameBufferSize=\"3\" WriterQueueSize=\"2\" MaxRecordedFramesInMemory=\"10\">"
+         << "      <InputChannels><InputChannel Id=\"VideoStream\" /></InputChannels>"
+         << "    </Device>"
+         << "  </DataCollection>"
+         << "</PlusConfiguration>";
+  vtkSmartPointer<vtkXMLDataElement> configRootElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(config.str().c_str()));
+  if (configRootElement == NULL)
+  {
+    LOG_ERROR("Unable to parse test configuration");
+    return EXIT_FAILURE;
+  }
+  vtkPlusConfig::GetInstance()->SetDeviceSetConfigurationData(configRootElement);
+
+  vtkSmartPointer<vtkPlusDataCollector> dataCollector = vtkSmartPointer<vtkPlusDataCollector>::New();
+  if (dataCollector->ReadConfiguration(configRootElement) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Configuration incorrect for vtkPlusVirtualCaptureTest.");
+    return EXIT_FAILURE;
+  }
+
+  vtkPlusDevice* device = NULL;
+  if (dataCollector->GetDevice(device, "CaptureDevice") != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to locate the device with Id=\"CaptureDevice\". Check config file.");
+    return EXIT_FAILURE;
+  }
+  vtkPlusVirtualCapture* captureDevice = vtkPlusVirtualCapture::SafeDownCast(device);
+  if (captureDevice == NULL)
+  {
+    LOG_ERROR("Device CaptureDevice is not a virtual capture device");
+    return EXIT_FAILURE;
+  }
+
+  if (dataCollector->Connect() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to connect to devices!");
+    return EXIT_FAILURE;
+  }
+  if (dataCollector->Start() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to start data collection!");
+    return EXIT_FAILURE;
+  }
+
+  int numberOfErrors = 0;
+
+  // Start
+  std::string firstFilename = std::string("VirtualCaptureTest_1") + outputExtension;
+  if (captureDevice->OpenFile(firstFilename.c_str()) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to open " << firstFilename);
+    return EXIT_FAILURE;
+  }
+  // Suspend
+  long firstNumberOfFrames = RecordAndSuspend(captureDevice, recordingTimeSec);
+
+  // Start again (completes the first file)
+  std::string secondFilename = std::string("VirtualCaptureTest_2") + outputExtension;
+  if (captureDevice->OpenFile(secondFilename.c_str()) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to open " << secondFilename);
+    return EXIT_FAILURE;
+  }
+  if (captureDevice->GetTotalFramesRecorded() != 0)
+  {
+    LOG_ERROR("Frame counter is not reset when a new file is opened: " << captureDevice->GetTotalFramesRecorded());
+    numberOfErrors++;
+  }
+
+  // Stop
+  long secondNumberOfFrames = RecordAndSuspend(captureDevice, recordingTimeSec);
+  std::string resultFilename;
+  if (captureDevice->CloseFile(NULL, &resultFilename) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to close " << secondFilename);
+    numberOfErrors++;
+  }
+
+  dataCollector->Stop();
+  dataCollector->Disconnect();
+
+  if (firstNumberOfFrames <= 0 || secondNumberOfFrames <= 0)
+  {
+    LOG_ERROR("No frames were recorded (first file: " << firstNumberOfFrames << ", second file: " << secondNumberOfFrames << ")");
+    return EXIT_FAILURE;
+  }
+
+  unsigned int numberOfFramesInFile = 0;
+  if (GetNumberOfFramesInFile(firstFilename, numberOfFramesInFile) != PLUS_SUCCESS || static_cast<long>(numberOfFramesInFile) != firstNumberOfFrames)
+  {
+    LOG_ERROR(firstFilename << " contains " << numberOfFramesInFile << " frames, expected " << firstNumberOfFrames);
+    numberOfErrors++;
+  }
+  numberOfFramesInFile = 0;
+  if (GetNumberOfFramesInFile(secondFilename, numberOfFramesInFile) != PLUS_SUCCESS || static_cast<long>(numberOfFramesInFile) != secondNumberOfFrames)
+  {
+    LOG_ERROR(secondFilename << " contains " << numberOfFramesInFile << " frames, expected " << secondNumberOfFrames);
+    numberOfErrors++;
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Recorded " << firstNumberOfFrames << " and " << secondNumberOfFrames << " frames. Test completed successfully.");
+  return EXIT_SUCCESS;
+}
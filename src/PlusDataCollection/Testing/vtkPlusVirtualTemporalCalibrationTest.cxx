@@ -0,0 +1,285 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkPlusVirtualTemporalCalibrationTest.cxx
+  \brief Replays the same synthetic probe motion with two saved data sources, the second one with a known local time
+  offset, and connects them to a virtual temporal calibration device. Verifies that the device estimates the known lag,
+  sends it to the field data source of its output channel and compensates it by changing the time offset of the
+  moving device. The configuration is written and read back to verify that the attributes are preserved.
+*/
+
+#include "PlusConfigure.h"
+#include "igsioTrackedFrame.h"
+#include "vtkIGSIOAccurateTimer.h"
+#include "vtkIGSIOTrackedFrameList.h"
+#include "vtkPlusChannel.h"
+#include "vtkPlusDataCollector.h"
+#include "vtkPlusDataSource.h"
+#include "vtkPlusSequenceIO.h"
+#include "vtkPlusVirtualTemporalCalibration.h"
+#include "vtkMatrix4x4.h"
+#include "vtkXMLUtilities.h"
+#include "vtksys/CommandLineArguments.hxx"
+
+#include <cmath>
+#include <sstream>
+
+namespace
+{
+  const double FRAME_RATE = 50.0;
+  const int NUMBER_OF_FRAMES = 500;
+  const double LAG_TOLERANCE_SEC = 0.01;
+
+  //----------------------------------------------------------------------------
+  // Probe motion along a tilted axis. The frequencies are multiples of the loop frequency, so the motion is continuous
+  // when the replay is repeated, but it is not periodic within the lag search range.
+  double GetPosition(double time)
+  {
+    const double pi = 3.14159265358979323846;
+    return 20.0 * sin(2 * pi * 0.3 * time) + 8.0 * sin(2 * pi * 0.7 * time + 0.4) + 3.0 * sin(2 * pi * 1.3 * time + 1.1);
+  }
+
+  //----------------------------------------------------------------------------
+  // Both devices replay the same file: the ProbeToTracker and ProbeToMovingTracker transforms are identical
+  PlusStatus WriteSequenceFile(const std::string& filename)
+  {
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> frameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    vtkSmartPointer<vtkMatrix4x4> probeToTracker = vtkSmartPointer<vtkMatrix4x4>::New();
+    for (int frameIndex = 0; frameIndex < NUMBER_OF_FRAMES; ++frameIndex)
+    {
+      igsioTrackedFrame frame;
+      FrameSizeType frameSize = {1, 1, 1};
+      if (frame.GetImageData()->AllocateFrame(frameSize, VTK_UNSIGNED_CHAR, 1) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to allocate frame " << frameIndex);
+        return PLUS_FAIL;
+      }
+      frame.GetImageData()->SetImageOrientation(US_IMG_ORIENT_MF);
+      double time = frameIndex / FRAME_RATE;
+      double position = GetPosition(time);
+      probeToTracker->SetElement(0, 3, 0.8 * position);
+      probeToTracker->SetElement(1, 3, 0.6 * position);
+      probeToTracker->SetElement(2, 3, 150.0);
+      const char* transformNames[2] = { "ProbeToTracker", "ProbeToMovingTracker" };
+      for (int i = 0; i < 2; ++i)
+      {
+        igsioTransformName transformName(transformNames[i]);
+        frame.SetFrameTransform(transformName, probeToTracker);
+        frame.SetFrameTransformStatus(transformName, TOOL_OK);
+      }
+      frame.SetTimestamp(time);
+      frameList->AddTrackedFrame(&frame);
+    }
+    if (vtkPlusSequenceIO::Write(filename, frameList) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to write " << filename);
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  // Frames are replayed with their original timestamps, so the timestamps of the two devices differ only by the time offset
+  vtkSmartPointer<vtkXMLDataElement> CreateConfiguration(const std::string& seqFileName, double movingTimeOffsetSec)
+  {
+    std::ostringstream config;
+    config << "<PlusConfiguration version=\"2.1\">"
+           << "  <DataCollection StartupDelaySec=\"0\">"
+           << "    <DeviceSet Name=\"VirtualTemporalCalibrationTest\" Description=\"Temporal calibration of two replayed tracker streams\" />"
+           << "    <Device Id=\"FixedDevice\" Type=\"SavedDataSource\" SequenceFile=\"" << seqFileName << "\" UseData=\"TRANSFORM\" ToolReferenceFrame=\"Tracker\""
+           << "      RepeatEnabled=\"TRUE\" UseOriginalTimestamps=\"TRUE\" AcquisitionRate=\"" << FRAME_RATE << "\">"
+           << "      <DataSources><DataSource Type=\"Tool\" Id=\"Probe\" BufferSize=\"1000\" /></DataSources>"
+           << "      <OutputChannels><OutputChannel Id=\"FixedStream\"><DataSource Id=\"Probe\" /></OutputChannel></OutputChannels>"
+           << "    </Device>"
+           << "    <Device Id=\"MovingDevice\" Type=\"SavedDataSource\" SequenceFile=\"" << seqFileName << "\" UseData=\"TRANSFORM\" ToolReferenceFrame=\"MovingTracker\""
+           << "      RepeatEnabled=\"TRUE\" UseOriginalTimestamps=\"TRUE\" AcquisitionRate=\"" << FRAME_RATE << "\" LocalTimeOffsetSec=\"" << movingTimeOffsetSec << "\">"
+           << "      <DataSources><DataSource Type=\"Tool\" Id=\"Probe\" BufferSize=\"1000\" /></DataSources>"
+           << "      <OutputChannels><OutputChannel Id=\"MovingStream\"><DataSource Id=\"Probe\" /></OutputChannel></OutputChannels>"
+           << "    </Device>"
+           << "    <Device Id=\"TemporalCalibrationDevice\" Type=\"VirtualTemporalCalibration\" MissingInputGracePeriodSec=\"1.0\""
+           << "      FixedProbeToReferenceTransformName=\"ProbeToTracker\" MovingProbeToReferenceTransformName=\"ProbeToMovingTracker\""
+           << "      SamplingResolutionSec=\"0.01\" MaximumMovingLagSec=\"0.5\" MemoryTimeSec=\"3.0\" MinimumConfidence=\"0.9\" ApplyTimeOffset=\"TRUE\">"
+           << "      <InputChannels><InputChannel Id=\"FixedStream\" /><InputChannel Id=\"MovingStream\" /></InputChannels>"
+           << "      <DataSources><DataSource Type=\"FieldData\" Id=\"LagField\" /></DataSources>"
+           << "      <OutputChannels><OutputChannel Id=\"LagStream\"><DataSource Id=\"LagField\" /></OutputChannel></OutputChannels>"
+           << "    </Device>"
+           << "  </DataCollection>"
+           << "</PlusConfiguration>";
+    return vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(config.str().c_str()));
+  }
+
+  //----------------------------------------------------------------------------
+  // Wait until the device has a lag estimate, returns false if the timeout expires
+  bool WaitForLagEstimate(vtkPlusVirtualTemporalCalibration* calibrationDevice, double timeoutSec, double& lagSec, double& confidence)
+  {
+    double waitStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    while (vtkIGSIOAccurateTimer::GetSystemTime() - waitStartTime < timeoutSec)
+    {
+      if (calibrationDevice->GetMovingLagSec(lagSec, confidence) == PLUS_SUCCESS)
+      {
+        return true;
+      }
+      vtkIGSIOAccurateTimer::Delay(0.1);
+    }
+    return false;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  double movingTimeOffsetSec(0.12);
+  double timeoutSec(30.0);
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--moving-time-offset-sec", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &movingTimeOffsetSec, "Local time offset of the moving device, this is the lag to be found (default: 0.12 sec).");
+  args.AddArgument("--timeout-sec", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &timeoutSec, "Maximum time to wait for the lag estimate and its compensation (default: 30 sec).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "\n\nvtkPlusVirtualTemporalCalibrationTest help:" << args.GetHelp() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (printHelp)
+  {
+    std::cout << "\n\nvtkPlusVirtualTemporalCalibrationTest help:" << args.GetHelp() << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  const std::string seqFileName = vtkPlusConfig::GetInstance()->GetOutputPath("VirtualTemporalCalibrationTest.igs.mha");
+  if (WriteSequenceFile(seqFileName) != PLUS_SUCCESS)
+  {
+    return EXIT_FAILURE;
+  }
+
+  vtkSmartPointer<vtkXMLDataElement> configRootElement = CreateConfiguration(seqFileName, movingTimeOffsetSec);
+  if (configRootElement == NULL)
+  {
+    LOG_ERROR("Unable to parse test configuration");
+    return EXIT_FAILURE;
+  }
+  vtkPlusConfig::GetInstance()->SetDeviceSetConfigurationData(configRootElement);
+
+  vtkSmartPointer<vtkPlusDataCollector> dataCollector = vtkSmartPointer<vtkPlusDataCollector>::New();
+  if (dataCollector->ReadConfiguration(configRootElement) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Configuration incorrect for vtkPlusVirtualTemporalCalibrationTest.");
+    return EXIT_FAILURE;
+  }
+
+  vtkPlusDevice* device = NULL;
+  vtkPlusDevice* movingDevice = NULL;
+  if (dataCollector->GetDevice(device, "TemporalCalibrationDevice") != PLUS_SUCCESS || dataCollector->GetDevice(movingDevice, "MovingDevice") != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to locate the devices. Check config file.");
+    return EXIT_FAILURE;
+  }
+  vtkPlusVirtualTemporalCalibration* calibrationDevice = vtkPlusVirtualTemporalCalibration::SafeDownCast(device);
+  if (calibrationDevice == NULL)
+  {
+    LOG_ERROR("Device TemporalCalibrationDevice is not a virtual temporal calibration device");
+    return EXIT_FAILURE;
+  }
+
+  int numberOfErrors = 0;
+
+  // Attributes are written back as they were read
+  vtkSmartPointer<vtkXMLDataElement> writtenConfigRootElement = vtkSmartPointer<vtkXMLDataElement>::New();
+  writtenConfigRootElement->DeepCopy(configRootElement);
+  if (calibrationDevice->WriteConfiguration(writtenConfigRootElement) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to write temporal calibration device configuration");
+    numberOfErrors++;
+  }
+  vtkSmartPointer<vtkPlusVirtualTemporalCalibration> readBackDevice = vtkSmartPointer<vtkPlusVirtualTemporalCalibration>::New();
+  readBackDevice->SetDeviceId("TemporalCalibrationDevice");
+  if (readBackDevice->ReadConfiguration(writtenConfigRootElement) != PLUS_SUCCESS
+      || readBackDevice->GetFixedProbeToReferenceTransformName() != "ProbeToTracker"
+      || readBackDevice->GetMovingProbeToReferenceTransformName() != "ProbeToMovingTracker"
+      || readBackDevice->GetSamplingResolutionSec() != 0.01 || readBackDevice->GetMaximumMovingLagSec() != 0.5
+      || readBackDevice->GetMemoryTimeSec() != 3.0 || readBackDevice->GetMinimumConfidence() != 0.9
+      || !readBackDevice->GetApplyTimeOffset())
+  {
+    LOG_ERROR("Temporal calibration device configuration is not preserved when it is written and read back");
+    numberOfErrors++;
+  }
+
+  if (dataCollector->Connect() != PLUS_SUCCESS || dataCollector->Start() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to start data collection!");
+    return EXIT_FAILURE;
+  }
+
+  // The lag is the local time offset of the moving device
+  double lagSec(0);
+  double confidence(0);
+  if (!WaitForLagEstimate(calibrationDevice, timeoutSec, lagSec, confidence))
+  {
+    LOG_ERROR("Lag is not estimated in " << timeoutSec << " sec");
+    numberOfErrors++;
+  }
+  else
+  {
+    LOG_INFO("Estimated lag: " << lagSec << " sec (confidence: " << confidence << ")");
+    if (fabs(lagSec - movingTimeOffsetSec) > LAG_TOLERANCE_SEC)
+    {
+      LOG_ERROR("Estimated lag is " << lagSec << " sec, expected " << movingTimeOffsetSec << " sec");
+      numberOfErrors++;
+    }
+
+    vtkPlusChannel* lagChannel = NULL;
+    vtkPlusDataSource* lagFieldSource = NULL;
+    if (calibrationDevice->GetOutputChannelByName(lagChannel, "LagStream") != PLUS_SUCCESS
+        || lagChannel->GetFieldDataSource(lagFieldSource, "LagField") != PLUS_SUCCESS
+        || lagFieldSource->GetNumberOfItems() == 0)
+    {
+      LOG_ERROR("Estimated lag is not sent to the field data source of the output channel");
+      numberOfErrors++;
+    }
+  }
+
+  // When the estimate is reliable (after the memory time) the lag is compensated: the time offset is changed to about 0,
+  // then the estimation is restarted and the remaining lag is about 0
+  double waitStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  while (movingDevice->GetLocalTimeOffsetSec() == movingTimeOffsetSec && vtkIGSIOAccurateTimer::GetSystemTime() - waitStartTime < timeoutSec)
+  {
+    vtkIGSIOAccurateTimer::Delay(0.1);
+  }
+  if (fabs(movingDevice->GetLocalTimeOffsetSec()) > LAG_TOLERANCE_SEC)
+  {
+    LOG_ERROR("Local time offset of the moving device is " << movingDevice->GetLocalTimeOffsetSec() << " sec, expected to be compensated to 0 sec");
+    numberOfErrors++;
+  }
+  else if (!WaitForLagEstimate(calibrationDevice, timeoutSec, lagSec, confidence) || fabs(lagSec) > LAG_TOLERANCE_SEC)
+  {
+    LOG_ERROR("Lag is not estimated after compensation or it is not 0 sec (" << lagSec << " sec)");
+    numberOfErrors++;
+  }
+
+  dataCollector->Stop();
+  dataCollector->Disconnect();
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully.");
+  return EXIT_SUCCESS;
+}
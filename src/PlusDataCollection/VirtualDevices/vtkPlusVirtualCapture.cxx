@@ -10,15 +10,25 @@ See License.txt for details.
 #include "vtkObjectFactory.h"
 #include "vtkPlusChannel.h"
 #include "vtkPlusDataSource.h"
+#include "vtkPlusReplayClock.h"
 #include "vtkIGSIOSequenceIO.h"
 #include "vtkIGSIOTrackedFrameList.h"
 #include "vtkPlusVirtualCapture.h"
 #include "vtksys/SystemTools.hxx"
 
+// STL includes
+#include <algorithm>
+#include <cstdio>
+
 #ifdef PLUS_USE_VTKVIDEOIO_MKV
 //  #include "vtkPlusMkvSequenceIO.h"
 #endif
 
+#if !defined(_WIN32)
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
 //----------------------------------------------------------------------------
 
 vtkStandardNewMacro(vtkPlusVirtualCapture);
@@ -30,6 +40,8 @@ namespace
   static const double WARNING_RECORDING_LAG_SEC = 1.0; // if the recording lags more than this then a warning message will be displayed
   static const double MAX_ALLOWED_RECORDING_LAG_SEC = 3.0; // if the recording lags more than this then it'll skip frames to catch up
   static const unsigned int DISABLE_FRAME_BUFFER = std::numeric_limits<unsigned int>::max();
+  static const unsigned int DEFAULT_WRITER_QUEUE_SIZE = 50;
+  static const unsigned int DEFAULT_MAX_RECORDED_FRAMES_IN_MEMORY = 1000;
 }
 
 //----------------------------------------------------------------------------
@@ -46,6 +58,8 @@ vtkPlusVirtualCapture::vtkPlusVirtualCapture()
   , CurrentFilename("")
   , BaseFilename("TrackedImageSequence.nrrd")
   , Writer(NULL)
+  , ChunkedWriter(NULL)
+  , WriterFrames(vtkSmartPointer<vtkIGSIOTrackedFrameList>::New())
   , EnableFileCompression(false)
   , IsHeaderPrepared(false)
   , TotalFramesRecorded(0)
@@ -54,6 +68,15 @@ vtkPlusVirtualCapture::vtkPlusVirtualCapture()
   , FrameBufferSize(DISABLE_FRAME_BUFFER)
   , IsData3D(false)
   , WriterAccessMutex(vtkSmartPointer<vtkIGSIORecursiveCriticalSection>::New())
+  , WriterQueueSize(DEFAULT_WRITER_QUEUE_SIZE)
+  , MaxRecordedFramesInMemory(DEFAULT_MAX_RECORDED_FRAMES_IN_MEMORY)
+  , DiskSyncPolicy(DISK_SYNC_NONE)
+  , WriterBusy(false)
+  , WriterReserved(false)
+  , WriterThreadActive(std::make_pair(false, false))
+  , WriteFailed(false)
+  , WriterQueueFull(false)
+  , DroppingRecordedFrames(false)
   , GracePeriodLogLevel(vtkPlusLogger::LOG_LEVEL_DEBUG)
   , EncodingFourCC("VP90")
 {
@@ -68,10 +91,11 @@ vtkPlusVirtualCapture::vtkPlusVirtualCapture()
 //----------------------------------------------------------------------------
 vtkPlusVirtualCapture::~vtkPlusVirtualCapture()
 {
-  if (IsHeaderPrepared)
+  if (this->HasUnsavedData())
   {
     this->CloseFile();
   }
+  this->StopWriterThread();
 
   if (RecordedFrames != NULL)
   {
@@ -90,6 +114,15 @@ vtkPlusVirtualCapture::~vtkPlusVirtualCapture()
 void vtkPlusVirtualCapture::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+
+  WriterQueueStatistics stats = this->GetWriterQueueStatistics();
+  os << indent << "WriterQueueSize: " << this->WriterQueueSize << std::endl;
+  os << indent << "MaxRecordedFramesInMemory: " << this->MaxRecordedFramesInMemory << std::endl;
+  os << indent << "DiskSyncPolicy: " << (this->DiskSyncPolicy == DISK_SYNC_BATCH ? "BATCH" : "NONE") << std::endl;
+  os << indent << "WriterQueueDepth: " << stats.QueueDepth << " (max: " << stats.MaxQueueDepth << ", frames: " << stats.NumberOfQueuedFrames << ")" << std::endl;
+  os << indent << "NumberOfWrittenFrames: " << stats.NumberOfWrittenFrames << " in " << stats.NumberOfWrittenBatches << " batches" << std::endl;
+  os << indent << "NumberOfDroppedFrames: " << stats.NumberOfDroppedFrames << std::endl;
+  os << indent << "BatchWriteTimeSec: " << stats.LastBatchWriteTimeSec << " (max: " << stats.MaxBatchWriteTimeSec << ")" << std::endl;
 }
 
 //----------------------------------------------------------------------------
@@ -109,6 +142,16 @@ PlusStatus vtkPlusVirtualCapture::ReadConfiguration(vtkXMLDataElement* rootConfi
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, RequestedFrameRate, deviceConfig);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, FrameBufferSize, deviceConfig);
   XML_READ_STRING_ATTRIBUTE_OPTIONAL(EncodingFourCC, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, WriterQueueSize, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, MaxRecordedFramesInMemory, deviceConfig);
+  XML_READ_ENUM2_ATTRIBUTE_OPTIONAL(DiskSyncPolicy, deviceConfig, "NONE", DISK_SYNC_NONE, "BATCH", DISK_SYNC_BATCH);
+#ifdef _WIN32
+  if (this->DiskSyncPolicy == DISK_SYNC_BATCH)
+  {
+    LOG_WARNING("DiskSyncPolicy=\"BATCH\" is not supported on this platform. Written data is flushed to the disk by the operating system.");
+    this->DiskSyncPolicy = DISK_SYNC_NONE;
+  }
+#endif
 
   return PLUS_SUCCESS;
 }
@@ -121,6 +164,9 @@ PlusStatus vtkPlusVirtualCapture::WriteConfiguration(vtkXMLDataElement* rootConf
   deviceElement->SetAttribute("EnableFileCompression", this->EnableFileCompression ? "TRUE" : "FALSE");
   deviceElement->SetAttribute("EnableCaptureOnStart", this->EnableCapturingOnStart ? "TRUE" : "FALSE");
   deviceElement->SetDoubleAttribute("RequestedFrameRate", this->GetRequestedFrameRate());
+  deviceElement->SetIntAttribute("WriterQueueSize", this->WriterQueueSize);
+  deviceElement->SetIntAttribute("MaxRecordedFramesInMemory", this->MaxRecordedFramesInMemory);
+  deviceElement->SetAttribute("DiskSyncPolicy", this->DiskSyncPolicy == DISK_SYNC_BATCH ? "BATCH" : "NONE");
 
   return PLUS_SUCCESS;
 }
@@ -134,12 +180,17 @@ PlusStatus vtkPlusVirtualCapture::InternalConnect()
     return PLUS_FAIL;
   }
 
+  if (this->StartWriterThread() != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
   if (this->GetEnableCapturingOnStart())
   {
     this->SetEnableCapturing(true);
   }
 
-  this->LastUpdateTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  this->LastUpdateTime = this->GetClockTime();
 
   return PLUS_SUCCESS;
 }
@@ -149,38 +200,43 @@ PlusStatus vtkPlusVirtualCapture::InternalDisconnect()
 {
   this->EnableCapturing = false;
 
-  // If outstanding frames to be written, deal with them
-  if (this->RecordedFrames->GetNumberOfTrackedFrames() != 0 && this->IsHeaderPrepared)
-  {
-    if (this->Writer->AppendImagesToHeader() != PLUS_SUCCESS)
-    {
-      LOG_ERROR("Unable to append image data to header.");
-      this->Disconnect();
-      return PLUS_FAIL;
-    }
-    if (this->Writer->WriteImages() != PLUS_SUCCESS)
-    {
-      LOG_ERROR("Unable to append images. Stopping recording at timestamp: " << this->LastAlreadyRecordedFrameTimestamp);
-      this->Disconnect();
-      return PLUS_FAIL;
-    }
-
-    this->ClearRecordedFrames();
-  }
+  // Outstanding frames are written by the writer thread before the file is closed
   PlusStatus status = this->CloseFile();
+  this->StopWriterThread();
   return status;
 }
 
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusVirtualCapture::OpenFile(const char* aFilename)
 {
+  // The writer thread must not use the writer and its frame list while they are replaced
+  if (this->FlushWriterQueue() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to write queued frames to " << this->CurrentFilename);
+  }
+
   igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->WriterAccessMutex);
 
+  if (this->IsHeaderPrepared || this->TotalFramesRecorded > 0)
+  {
+    // Recording was suspended and then started again: complete the current file before starting a new one
+    LOG_INFO("Recording to " << this->CurrentFilename << " is completed (" << this->TotalFramesRecorded << " frames) before a new file is opened");
+    if (this->CloseFile() != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+  }
+
   if (aFilename == NULL || strlen(aFilename) == 0)
   {
     std::string filenameRoot = igsioCommon::GetSequenceFilenameWithoutExtension(this->BaseFilename);
     std::string ext = igsioCommon::GetSequenceFilenameExtension(this->BaseFilename);
-    if (ext.empty())
+    if (vtkPlusChunkedSequenceIO::CanReadWriteFile(this->BaseFilename))
+    {
+      ext = vtksys::SystemTools::GetFilenameLastExtension(this->BaseFilename);
+      filenameRoot = this->BaseFilename.substr(0, this->BaseFilename.size() - ext.size());
+    }
+    else if (ext.empty())
     {
       // default to nrrd
       ext = ".nrrd";
@@ -205,6 +261,21 @@ PlusStatus vtkPlusVirtualCapture::OpenFile(const char* aFilename)
     this->CurrentFilename = aFilename;
   }
 
+  if (vtkPlusChunkedSequenceIO::CanReadWriteFile(aFilename))
+  {
+    // Chunked sequence file: frames are appended chunk by chunk, the file is only opened when the first batch is written
+    if (this->Writer != NULL)
+    {
+      this->Writer->Delete();
+      this->Writer = NULL;
+    }
+    this->ChunkedWriter = vtkSmartPointer<vtkPlusChunkedSequenceIO>::New();
+    this->ChunkedWriter->SetUseCompression(this->EnableFileCompression);
+    this->WriterFrames->Clear();
+    return PLUS_SUCCESS;
+  }
+  this->ChunkedWriter = NULL;
+
   this->Writer = vtkIGSIOSequenceIO::CreateSequenceHandlerForFile(aFilename);
   if (!this->Writer)
   {
@@ -212,7 +283,8 @@ PlusStatus vtkPlusVirtualCapture::OpenFile(const char* aFilename)
     return PLUS_FAIL;
   }
   this->Writer->SetUseCompression(this->EnableFileCompression);
-  this->Writer->SetTrackedFrameList(this->RecordedFrames);
+  this->WriterFrames->Clear();
+  this->Writer->SetTrackedFrameList(this->WriterFrames);
   // Need to set the filename before finalizing header, because the pixel data file name depends on the file extension
   this->Writer->SetFileName(vtkPlusConfig::GetInstance()->GetOutputPath(aFilename));
 
@@ -222,39 +294,69 @@ PlusStatus vtkPlusVirtualCapture::OpenFile(const char* aFilename)
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusVirtualCapture::CloseFile(const char* aFilename /* = NULL */, std::string* resultFilename /* = NULL */)
 {
+  // Write all outstanding frames without blocking the recording, errors are reported by WriteFrames below
+  this->FlushWriterQueue();
+
   // Fix the header to write the correct number of frames
   igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->WriterAccessMutex);
 
+  // Write the frames that were recorded while the queue was written (the writer must not be changed while the writer thread is using it)
+  PlusStatus writeStatus = this->WriteFrames(true);
+
   if (!this->IsHeaderPrepared)
   {
     // nothing has been prepared, so nothing to finalize
-    return PLUS_SUCCESS;
+    this->WriteFailed = false;
+    return writeStatus;
   }
 
-  if (aFilename != NULL && strlen(aFilename) != 0)
+  if (this->ChunkedWriter != NULL)
   {
-    // Need to set the filename before finalizing header, because the pixel data file name depends on the file extension
-    this->Writer->SetFileName(vtkPlusConfig::GetInstance()->GetOutputPath(aFilename));
-    this->CurrentFilename = aFilename;
+    // All the frames are already in the file, only the frame index has to be written
+    if (this->ChunkedWriter->Close() != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Unable to write frame index to " << this->ChunkedWriter->GetFileName());
+      writeStatus = PLUS_FAIL;
+    }
+    if (aFilename != NULL && strlen(aFilename) != 0)
+    {
+      std::string newFullPath = vtkPlusConfig::GetInstance()->GetOutputPath(aFilename);
+      if (std::rename(this->ChunkedWriter->GetFileName().c_str(), newFullPath.c_str()) != 0)
+      {
+        LOG_ERROR("Unable to rename " << this->ChunkedWriter->GetFileName() << " to " << newFullPath);
+        writeStatus = PLUS_FAIL;
+      }
+      else
+      {
+        this->CurrentFilename = aFilename;
+      }
+    }
+    if (resultFilename != NULL)
+    {
+      (*resultFilename) = vtkPlusConfig::GetInstance()->GetOutputPath(this->CurrentFilename);
+    }
   }
-
-  // Do we have any outstanding unwritten data?
-  if (this->RecordedFrames->GetNumberOfTrackedFrames() != 0)
+  else
   {
-    this->WriteFrames(true);
-  }
+    if (aFilename != NULL && strlen(aFilename) != 0)
+    {
+      // Need to set the filename before finalizing header, because the pixel data file name depends on the file extension
+      this->Writer->SetFileName(vtkPlusConfig::GetInstance()->GetOutputPath(aFilename));
+      this->CurrentFilename = aFilename;
+    }
 
-  this->Writer->UpdateDimensionsCustomStrings(this->TotalFramesRecorded, this->GetIsData3D());
-  this->Writer->UpdateFieldInImageHeader(this->Writer->GetDimensionSizeString());
-  this->Writer->UpdateFieldInImageHeader(this->Writer->GetDimensionKindsString());
-  this->Writer->FinalizeHeader();
+    this->Writer->UpdateDimensionsCustomStrings(this->TotalFramesRecorded, this->GetIsData3D());
+    this->Writer->UpdateFieldInImageHeader(this->Writer->GetDimensionSizeString());
+    this->Writer->UpdateFieldInImageHeader(this->Writer->GetDimensionKindsString());
+    this->Writer->FinalizeHeader();
 
-  if (resultFilename != NULL)
-  {
-    (*resultFilename) = this->Writer->GetFileName();
-  }
+    if (resultFilename != NULL)
+    {
+      (*resultFilename) = this->Writer->GetFileName();
+    }
 
-  this->Writer->Close();
+    this->Writer->Close();
+  }
 
   std::string fullPath = vtkPlusConfig::GetInstance()->GetOutputPath(this->CurrentFilename);
   std::string path = vtksys::SystemTools::GetFilenamePath(fullPath);
@@ -265,13 +367,14 @@ PlusStatus vtkPlusVirtualCapture::CloseFile(const char* aFilename /* = NULL */,
   this->IsHeaderPrepared = false;
   this->TotalFramesRecorded = 0;
   this->RecordedFrames->Clear();
+  this->WriteFailed = false;
 
   if (this->OpenFile() != PLUS_SUCCESS)
   {
     return PLUS_FAIL;
   }
 
-  return PLUS_SUCCESS;
+  return writeStatus;
 }
 
 //----------------------------------------------------------------------------
@@ -294,17 +397,19 @@ PlusStatus vtkPlusVirtualCapture::InternalUpdate()
     LOG_WARNING("AcquisitionRate value is invalid " << this->AcquisitionRate << ". Use default sampling period of " << samplingPeriodSec << " sec");
   }
 
+  // Sampling is timed by the clock time, which runs faster than the system time if recorded data is replayed faster than real time
+  double updateClockTime = this->GetClockTime();
   if (this->LastUpdateTime == 0.0)
   {
-    this->LastUpdateTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    this->LastUpdateTime = updateClockTime;
   }
   if (this->NextFrameToBeRecordedTimestamp == 0.0)
   {
-    this->NextFrameToBeRecordedTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+    this->NextFrameToBeRecordedTimestamp = updateClockTime;
   }
   double startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
 
-  this->TimeWaited += startTimeSec - LastUpdateTime;
+  this->TimeWaited += updateClockTime - LastUpdateTime;
 
   if (this->TimeWaited < samplingPeriodSec)
   {
@@ -315,6 +420,12 @@ PlusStatus vtkPlusVirtualCapture::InternalUpdate()
   this->TimeWaited = 0.0;
 
   double maxProcessingTimeSec = samplingPeriodSec * 2.0; // put a hard limit on the max processing time to make sure the application remains responsive during recording
+  vtkPlusReplayClock* replayClock = this->GetReplayClock();
+  if (replayClock != NULL && replayClock->GetMode() == vtkPlusReplayClock::FREE_RUN)
+  {
+    // the replay clock waits until all the frames are recorded, so don't skip any frames
+    maxProcessingTimeSec = -1;
+  }
   double requestedFramePeriodSec = 0.1;
   if (this->RequestedFrameRate > 0)
   {
@@ -370,14 +481,15 @@ PlusStatus vtkPlusVirtualCapture::InternalUpdate()
     }
   }
 
+  // Frames that are dropped by WriteFrames are subtracted from the total
+  this->TotalFramesRecorded += nbFramesAfter - nbFramesBefore;
+
   if (this->WriteFrames() != PLUS_SUCCESS)
   {
     LOG_ERROR(this->GetDeviceId() << ": Unable to write " << nbFramesAfter - nbFramesBefore << " frames.");
     return PLUS_FAIL;
   }
 
-  this->TotalFramesRecorded += nbFramesAfter - nbFramesBefore;
-
   if (this->TotalFramesRecorded == 0)
   {
     // We haven't received any data so far
@@ -386,8 +498,8 @@ PlusStatus vtkPlusVirtualCapture::InternalUpdate()
 
   // Check whether the recording needed more time than the sampling interval
   double recordingTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec;
-  double currentSystemTime = vtkIGSIOAccurateTimer::GetSystemTime();
-  double recordingLagSec =  currentSystemTime - this->NextFrameToBeRecordedTimestamp;
+  double currentClockTime = this->GetClockTime();
+  double recordingLagSec =  currentClockTime - this->NextFrameToBeRecordedTimestamp;
 
   if (recordingTimeSec > samplingPeriodSec)
   {
@@ -402,7 +514,7 @@ PlusStatus vtkPlusVirtualCapture::InternalUpdate()
     double latestInputTimestamp = this->NextFrameToBeRecordedTimestamp;
     if (GetLatestInputItemTimestamp(latestInputTimestamp) == PLUS_SUCCESS)
     {
-      acquisitionLagSec = currentSystemTime - latestInputTimestamp;
+      acquisitionLagSec = currentClockTime - latestInputTimestamp;
     }
     if (acquisitionLagSec < MAX_ALLOWED_RECORDING_LAG_SEC)
     {
@@ -410,10 +522,10 @@ PlusStatus vtkPlusVirtualCapture::InternalUpdate()
       // (because acquisitionLagSec < MAX_ALLOWED_RECORDING_LAG_SEC)
       LOG_ERROR("Recording cannot keep up with the acquisition. Skip " << recordingLagSec << " seconds of the data stream to catch up.");
     }
-    this->NextFrameToBeRecordedTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+    this->NextFrameToBeRecordedTimestamp = this->GetClockTime();
   }
 
-  this->LastUpdateTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  this->LastUpdateTime = this->GetClockTime();
 
   return PLUS_SUCCESS;
 }
@@ -450,7 +562,12 @@ PlusStatus vtkPlusVirtualCapture::NotifyConfigured()
 //-----------------------------------------------------------------------------
 bool vtkPlusVirtualCapture::HasUnsavedData() const
 {
-  return this->IsHeaderPrepared;
+  if (this->IsHeaderPrepared)
+  {
+    return true;
+  }
+  std::lock_guard<std::mutex> lock(this->WriterQueueMutex);
+  return !this->WriterQueue.empty() || this->WriterBusy || this->WriterReserved;
 }
 
 //-----------------------------------------------------------------------------
@@ -474,6 +591,10 @@ void vtkPlusVirtualCapture::SetEnableFileCompression(bool aFileCompression)
   {
     this->Writer->SetUseCompression(aFileCompression);
   }
+  if (this->ChunkedWriter != NULL)
+  {
+    this->ChunkedWriter->SetUseCompression(aFileCompression);
+  }
 
   this->EnableFileCompression = aFileCompression;
 }
@@ -502,15 +623,28 @@ PlusStatus vtkPlusVirtualCapture::Reset()
 
     this->SetEnableCapturing(false);
 
+    // The writer thread must not use the writer while it is discarded
+    this->DiscardWriterQueue();
+
     if (this->IsHeaderPrepared)
     {
-      this->Writer->Discard();
+      if (this->ChunkedWriter != NULL)
+      {
+        std::string chunkedFileName = this->ChunkedWriter->GetFileName();
+        this->ChunkedWriter->Close();
+        vtksys::SystemTools::RemoveFile(chunkedFileName);
+      }
+      else
+      {
+        this->Writer->Discard();
+      }
     }
 
     this->ClearRecordedFrames();
-    this->Writer->GetTrackedFrameList()->Clear();
+    this->WriterFrames->Clear();
     this->IsHeaderPrepared = false;
     this->TotalFramesRecorded = 0;
+    this->WriteFailed = false;
   }
 
   if (this->OpenFile() != PLUS_SUCCESS)
@@ -519,7 +653,7 @@ PlusStatus vtkPlusVirtualCapture::Reset()
     return PLUS_FAIL;
   }
 
-  this->LastUpdateTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  this->LastUpdateTime = this->GetClockTime();
 
   return PLUS_SUCCESS;
 }
@@ -576,6 +710,8 @@ PlusStatus vtkPlusVirtualCapture::TakeSnapshot()
     return PLUS_FAIL;
   }
 
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->WriterAccessMutex);
+
   // Add tracked frame to the list
   // Snapshots are triggered manually, so the additional copying in AddTrackedFrame compared to TakeTrackedFrame is not relevant.
   if (this->RecordedFrames->AddTrackedFrame(&trackedFrame, vtkIGSIOTrackedFrameList::SKIP_INVALID_FRAME) != PLUS_SUCCESS)
@@ -584,60 +720,346 @@ PlusStatus vtkPlusVirtualCapture::TakeSnapshot()
     return PLUS_FAIL;
   }
 
+  this->TotalFramesRecorded += 1;
+
   if (this->WriteFrames() != PLUS_SUCCESS)
   {
     LOG_ERROR(this->GetDeviceId() << ": Failed to write snapshot frame");
     return PLUS_FAIL;
   }
 
-  this->TotalFramesRecorded += 1;
-
   return PLUS_SUCCESS;
 }
 
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusVirtualCapture::WriteFrames(bool force)
 {
-  if (!this->IsHeaderPrepared && this->RecordedFrames->GetNumberOfTrackedFrames() != 0)
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->WriterAccessMutex);
+
+  if (this->WriteFailed)
   {
-    if (this->Writer->PrepareHeader() != PLUS_SUCCESS)
+    LOG_ERROR("Unable to write frames to " << this->CurrentFilename << ". Stopping recording at timestamp: " << this->LastAlreadyRecordedFrameTimestamp);
+    this->StopRecording();
+    return PLUS_FAIL;
+  }
+
+  if (this->RecordedFrames->GetNumberOfTrackedFrames() != 0)
+  {
+    this->SetIsData3D(this->RecordedFrames->GetTrackedFrame(0)->GetFrameSize()[2] > 1);
+
+    if (force || !this->IsFrameBuffered() ||
+        (this->IsFrameBuffered() && this->RecordedFrames->GetNumberOfTrackedFrames() > this->GetFrameBufferSize()))
     {
-      LOG_ERROR("Unable to prepare header");
-      this->StopRecording();
-      return PLUS_FAIL;
+      // If the queue is full then the frames remain in the recorded frame list and they are queued in a later update
+      if (!this->QueueRecordedFrames(force))
+      {
+        unsigned int maxRecordedFrames = this->MaxRecordedFramesInMemory;
+        if (this->IsFrameBuffered())
+        {
+          maxRecordedFrames = std::max(maxRecordedFrames, this->FrameBufferSize);
+        }
+        // If the memory limit is reached then the oldest frames are dropped, sampling must not wait for the disk
+        this->TotalFramesRecorded -= this->DropRecordedFrames(maxRecordedFrames);
+      }
     }
-    this->IsHeaderPrepared = true;
   }
 
-  if (this->RecordedFrames->GetNumberOfTrackedFrames() == 0)
+  if (!force)
   {
     return PLUS_SUCCESS;
   }
 
-  this->SetIsData3D(this->RecordedFrames->GetTrackedFrame(0)->GetFrameSize()[2] > 1);
+  if (this->FlushWriterQueue() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to write frames to " << this->CurrentFilename << ". Stopping recording at timestamp: " << this->LastAlreadyRecordedFrameTimestamp);
+    this->StopRecording();
+    return PLUS_FAIL;
+  }
+
+  return PLUS_SUCCESS;
+}
 
-  if (force || !this->IsFrameBuffered() ||
-      (this->IsFrameBuffered() && this->RecordedFrames->GetNumberOfTrackedFrames() > this->GetFrameBufferSize()))
+//-----------------------------------------------------------------------------
+bool vtkPlusVirtualCapture::QueueRecordedFrames(bool ignoreQueueSize)
+{
   {
+    std::lock_guard<std::mutex> lock(this->WriterQueueMutex);
+    if (!ignoreQueueSize && this->WriterQueueSize > 0 && this->WriterQueue.size() >= this->WriterQueueSize)
+    {
+      if (!this->WriterQueueFull)
+      {
+        LOG_WARNING(this->GetDeviceId() << ": Writing to disk cannot keep up with the recording, " << this->WriterQueue.size()
+                    << " batches are waiting to be written. Recorded frames are kept in memory until they can be written.");
+        this->WriterQueueFull = true;
+      }
+      return false;
+    }
+    this->WriterQueueFull = false;
+    this->DroppingRecordedFrames = false;
+
+    unsigned int numberOfFrames = this->RecordedFrames->GetNumberOfTrackedFrames();
+    this->WriterQueue.push_back(vtkSmartPointer<vtkIGSIOTrackedFrameList>::Take(this->RecordedFrames));
+    this->WriterStats.QueueDepth = this->WriterQueue.size();
+    this->WriterStats.MaxQueueDepth = std::max(this->WriterStats.MaxQueueDepth, this->WriterStats.QueueDepth);
+    this->WriterStats.NumberOfQueuedFrames += numberOfFrames;
+  }
+  this->WriterQueueChanged.notify_all();
+
+  // The queued frame list is owned by the writer from now on, continue recording into a new list
+  this->RecordedFrames = vtkIGSIOTrackedFrameList::New();
+  this->RecordedFrames->SetValidationRequirements(REQUIRE_UNIQUE_TIMESTAMP);
+  this->FirstFrameIndexInThisSegment = 0;
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualCapture::FlushWriterQueue()
+{
+  std::deque<vtkSmartPointer<vtkIGSIOTrackedFrameList> > batches;
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->WriterAccessMutex);
+    if (this->RecordedFrames->GetNumberOfTrackedFrames() != 0)
+    {
+      this->SetIsData3D(this->RecordedFrames->GetTrackedFrame(0)->GetFrameSize()[2] > 1);
+      this->QueueRecordedFrames(true);
+    }
+    // Take over the queue, the writer thread does not start writing a new batch until the writer is released
+    std::lock_guard<std::mutex> lock(this->WriterQueueMutex);
+    batches.swap(this->WriterQueue);
+    this->WriterStats.QueueDepth = 0;
+    this->WriterReserved = true;
+  }
+
+  std::unique_lock<std::mutex> lock(this->WriterQueueMutex);
+  // The batch that the writer thread is writing was queued earlier, so it must be completed first
+  this->WriterQueueChanged.wait(lock, [this] { return !this->WriterBusy; });
+  this->WriterBusy = true;
+  while (!batches.empty() && !this->WriteFailed)
+  {
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> batch = batches.front();
+    batches.pop_front();
+    lock.unlock();
+    PlusStatus status = this->WriteBatch(batch);
+    lock.lock();
+    if (status != PLUS_SUCCESS)
+    {
+      this->WriteFailed = true;
+    }
+  }
+  if (!batches.empty())
+  {
+    // Writing failed, the remaining frames are dropped
+    this->WriterStats.NumberOfQueuedFrames = 0;
+  }
+  this->WriterBusy = false;
+  this->WriterReserved = false;
+  lock.unlock();
+  this->WriterQueueChanged.notify_all();
+
+  return this->WriteFailed ? PLUS_FAIL : PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusVirtualCapture::DiscardWriterQueue()
+{
+  std::unique_lock<std::mutex> lock(this->WriterQueueMutex);
+  this->WriterQueue.clear();
+  this->WriterStats.QueueDepth = 0;
+  this->WriterStats.NumberOfQueuedFrames = 0;
+  this->WriterQueueChanged.wait(lock, [this] { return !this->WriterBusy; });
+}
+
+//-----------------------------------------------------------------------------
+unsigned int vtkPlusVirtualCapture::DropRecordedFrames(unsigned int maxRecordedFrames)
+{
+  unsigned int numberOfFrames = this->RecordedFrames->GetNumberOfTrackedFrames();
+  if (numberOfFrames <= maxRecordedFrames)
+  {
+    return 0;
+  }
+  unsigned int numberOfDroppedFrames = numberOfFrames - maxRecordedFrames;
+  this->RecordedFrames->RemoveTrackedFrameRange(0, numberOfDroppedFrames - 1);
+  this->FirstFrameIndexInThisSegment = std::max(0, this->FirstFrameIndexInThisSegment - static_cast<int>(numberOfDroppedFrames));
+
+  std::lock_guard<std::mutex> lock(this->WriterQueueMutex);
+  if (!this->DroppingRecordedFrames)
+  {
+    LOG_WARNING(this->GetDeviceId() << ": More than " << maxRecordedFrames << " recorded frames are waiting to be written to disk. The oldest frames are dropped"
+                << " until writing catches up with the recording.");
+    this->DroppingRecordedFrames = true;
+  }
+  this->WriterStats.NumberOfDroppedFrames += numberOfDroppedFrames;
+  return numberOfDroppedFrames;
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualCapture::WriteBatch(vtkIGSIOTrackedFrameList* batch)
+{
+  double startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+  unsigned int numberOfFrames = batch->GetNumberOfTrackedFrames();
+
+  if (this->ChunkedWriter != NULL)
+  {
+    if (!this->IsHeaderPrepared)
+    {
+      if (this->ChunkedWriter->OpenForWriting(vtkPlusConfig::GetInstance()->GetOutputPath(this->CurrentFilename)) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Unable to open " << this->CurrentFilename << " for writing");
+        return PLUS_FAIL;
+      }
+      this->IsHeaderPrepared = true;
+    }
+    // Each batch is appended as a new chunk, which remains readable even if the recording is interrupted
+    if (this->ChunkedWriter->AppendFrames(batch) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Unable to append images to " << this->CurrentFilename);
+      return PLUS_FAIL;
+    }
+  }
+  else
+  {
+    // The writer writes the frames of its tracked frame list
+    this->WriterFrames = batch;
+    this->Writer->SetTrackedFrameList(batch);
+
+    if (!this->IsHeaderPrepared)
+    {
+      // The first batch determines the image properties in the header
+      if (this->Writer->PrepareHeader() != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Unable to prepare header");
+        return PLUS_FAIL;
+      }
+      this->IsHeaderPrepared = true;
+    }
+
     if (this->Writer->AppendImagesToHeader() != PLUS_SUCCESS)
     {
       LOG_ERROR("Unable to append image data to header.");
-      this->StopRecording();
       return PLUS_FAIL;
     }
     if (this->Writer->WriteImages() != PLUS_SUCCESS)
     {
-      LOG_ERROR("Unable to append images. Stopping recording at timestamp: " << LastAlreadyRecordedFrameTimestamp);
-      this->StopRecording();
+      LOG_ERROR("Unable to append images to " << this->CurrentFilename);
       return PLUS_FAIL;
     }
+  }
+  batch->Clear();
 
-    this->ClearRecordedFrames();
+  if (this->DiskSyncPolicy == DISK_SYNC_BATCH)
+  {
+    this->SyncToDisk(this->ChunkedWriter != NULL ? this->ChunkedWriter->GetFileName() : std::string(this->Writer->GetFileName()));
   }
 
+  double writeTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec;
+  std::lock_guard<std::mutex> lock(this->WriterQueueMutex);
+  this->WriterStats.QueueDepth = this->WriterQueue.size();
+  this->WriterStats.NumberOfQueuedFrames -= std::min(this->WriterStats.NumberOfQueuedFrames, numberOfFrames);
+  this->WriterStats.NumberOfWrittenBatches++;
+  this->WriterStats.NumberOfWrittenFrames += numberOfFrames;
+  this->WriterStats.LastBatchWriteTimeSec = writeTimeSec;
+  this->WriterStats.MaxBatchWriteTimeSec = std::max(this->WriterStats.MaxBatchWriteTimeSec, writeTimeSec);
+
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusVirtualCapture::SyncToDisk(const std::string& filename)
+{
+#if !defined(_WIN32)
+  // Only the output file is flushed, the recording does not wait for the cached data of other files
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    LOG_WARNING("Unable to open " << filename << " to synchronize it to the disk");
+    return;
+  }
+  if (fsync(fd) != 0)
+  {
+    LOG_WARNING("Failed to synchronize " << filename << " to the disk");
+  }
+  close(fd);
+#endif
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualCapture::StartWriterThread()
+{
+  std::lock_guard<std::mutex> lock(this->WriterQueueMutex);
+  if (this->WriterThreadActive.first)
+  {
+    // already running
+    return PLUS_SUCCESS;
+  }
+  this->WriterThreadActive.first = true;
+  this->WriterThreadActive.second = true;
+  if (this->Threader->SpawnThread((vtkThreadFunctionType)&WriterThread, this) < 0)
+  {
+    LOG_ERROR(this->GetDeviceId() << ": Failed to start the writer thread");
+    this->WriterThreadActive = std::make_pair(false, false);
+    return PLUS_FAIL;
+  }
   return PLUS_SUCCESS;
 }
 
+//-----------------------------------------------------------------------------
+void vtkPlusVirtualCapture::StopWriterThread()
+{
+  std::unique_lock<std::mutex> lock(this->WriterQueueMutex);
+  this->WriterThreadActive.first = false;
+  this->WriterQueueChanged.notify_all();
+  this->WriterQueueChanged.wait(lock, [this] { return !this->WriterThreadActive.second; });
+}
+
+//-----------------------------------------------------------------------------
+void* vtkPlusVirtualCapture::WriterThread(vtkMultiThreader::ThreadInfo* data)
+{
+  vtkPlusVirtualCapture* self = (vtkPlusVirtualCapture*)(data->UserData);
+
+  std::unique_lock<std::mutex> lock(self->WriterQueueMutex);
+  while (true)
+  {
+    self->WriterQueueChanged.wait(lock, [self] { return (!self->WriterQueue.empty() || !self->WriterThreadActive.first) && !self->WriterReserved && !self->WriterBusy; });
+    if (self->WriterQueue.empty())
+    {
+      // stop requested and all the queued frames are written
+      break;
+    }
+
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> batch = self->WriterQueue.front();
+    self->WriterQueue.pop_front();
+    self->WriterStats.QueueDepth = self->WriterQueue.size();
+    self->WriterBusy = true;
+    lock.unlock();
+
+    PlusStatus status = self->WriteBatch(batch);
+
+    lock.lock();
+    self->WriterBusy = false;
+    if (status != PLUS_SUCCESS)
+    {
+      // Recording is stopped by the internal update thread, the frames that cannot be written are dropped
+      self->WriteFailed = true;
+      self->WriterQueue.clear();
+      self->WriterStats.QueueDepth = 0;
+      self->WriterStats.NumberOfQueuedFrames = 0;
+    }
+    self->WriterQueueChanged.notify_all();
+  }
+
+  self->WriterThreadActive.second = false;
+  self->WriterQueueChanged.notify_all();
+  return NULL;
+}
+
+//-----------------------------------------------------------------------------
+vtkPlusVirtualCapture::WriterQueueStatistics vtkPlusVirtualCapture::GetWriterQueueStatistics()
+{
+  std::lock_guard<std::mutex> lock(this->WriterQueueMutex);
+  return this->WriterStats;
+}
+
 //-----------------------------------------------------------------------------
 int vtkPlusVirtualCapture::OutputChannelCount() const
 {
@@ -10,13 +10,23 @@ See License.txt for details.
 #include "vtkPlusDataCollectionExport.h"
 #include "vtkPlusDevice.h"
 #include "vtkIGSIOSequenceIOBase.h"
+#include "vtkPlusChunkedSequenceIO.h"
+
+// STL includes
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <string>
 
 //class vtkIGSIOTrackedFrameList;
 
 /*!
 \class vtkPlusVirtualCapture
-\brief
+\brief Records the frames of the input channel into a sequence file
+
+Frames are sampled by the internal update thread and handed over in batches to a dedicated writer thread through
+a bounded queue, so slow disk writes do not make the sampling fall behind.
 
 \ingroup PlusLibDataCollection
 */
@@ -94,6 +104,47 @@ public:
 
   virtual std::string GetOutputFileName() { return vtkPlusConfig::GetInstance()->GetOutputPath(CurrentFilename); };
 
+  enum DiskSyncPolicyType
+  {
+    DISK_SYNC_NONE,   ///< Leave flushing of the written data to the operating system
+    DISK_SYNC_BATCH   ///< Force writing of the cached data to the disk after each written batch
+  };
+
+  /*! Statistics of the writer queue, for monitoring the disk throughput */
+  struct WriterQueueStatistics
+  {
+    WriterQueueStatistics()
+      : QueueDepth(0)
+      , MaxQueueDepth(0)
+      , NumberOfQueuedFrames(0)
+      , NumberOfWrittenBatches(0)
+      , NumberOfWrittenFrames(0)
+      , NumberOfDroppedFrames(0)
+      , LastBatchWriteTimeSec(0.0)
+      , MaxBatchWriteTimeSec(0.0)
+    {
+    }
+    unsigned int QueueDepth;
+    unsigned int MaxQueueDepth;
+    unsigned int NumberOfQueuedFrames;
+    unsigned long NumberOfWrittenBatches;
+    unsigned long NumberOfWrittenFrames;
+    unsigned long NumberOfDroppedFrames;
+    double LastBatchWriteTimeSec;
+    double MaxBatchWriteTimeSec;
+  };
+
+  WriterQueueStatistics GetWriterQueueStatistics();
+
+  vtkSetMacro(WriterQueueSize, unsigned int);
+  vtkGetMacro(WriterQueueSize, unsigned int);
+
+  vtkSetMacro(MaxRecordedFramesInMemory, unsigned int);
+  vtkGetMacro(MaxRecordedFramesInMemory, unsigned int);
+
+  vtkSetMacro(DiskSyncPolicy, DiskSyncPolicyType);
+  vtkGetMacro(DiskSyncPolicy, DiskSyncPolicyType);
+
 protected:
   vtkPlusVirtualCapture();
   virtual ~vtkPlusVirtualCapture();
@@ -114,6 +165,37 @@ protected:
   */
   virtual PlusStatus WriteFrames(bool force = false);
 
+  /*!
+    Move the recorded frames to the writer queue and start a new recorded frame list.
+    Returns false if the queue is full (the frames are kept then and queued later).
+    If ignoreQueueSize is true then the frames are queued even if the queue is full.
+  */
+  bool QueueRecordedFrames(bool ignoreQueueSize);
+
+  /*!
+    Queue the recorded frames and write all the queued frames in this thread. The queue is taken over under WriterAccessMutex,
+    but the frames are written without holding it (unless the caller holds it), so the recording is not blocked by the disk.
+  */
+  PlusStatus FlushWriterQueue();
+
+  /*! Remove all frames from the writer queue without writing them and wait until the batch that is being written is completed */
+  void DiscardWriterQueue();
+
+  /*! Remove the oldest recorded frames so that at most maxRecordedFrames are kept. Returns the number of removed frames. */
+  unsigned int DropRecordedFrames(unsigned int maxRecordedFrames);
+
+  /*! Write a batch of frames to the file (called from the writer thread) */
+  PlusStatus WriteBatch(vtkIGSIOTrackedFrameList* batch);
+
+  /*! Force writing of the cached data of the specified file to the disk */
+  void SyncToDisk(const std::string& filename);
+
+  PlusStatus StartWriterThread();
+  void StopWriterThread();
+
+  /*! Thread that writes the queued frames to the file */
+  static void* WriterThread(vtkMultiThreader::ThreadInfo* data);
+
 protected:
   /*! Recorded tracked frame list */
   vtkIGSIOTrackedFrameList* RecordedFrames;
@@ -153,6 +235,12 @@ protected:
   /*! Sequence writer to write to */
   vtkIGSIOSequenceIOBase* Writer;
 
+  /*! Writer of chunked sequence files (.pseq), used instead of Writer if the file has .pseq extension */
+  vtkSmartPointer<vtkPlusChunkedSequenceIO> ChunkedWriter;
+
+  /*! Frames that are being written by the writer */
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> WriterFrames;
+
   /*! When closing the file, re-read the data from file, and write it compressed */
   bool EnableFileCompression;
 
@@ -160,7 +248,7 @@ protected:
   std::string EncodingFourCC;
 
   /*! Preparing the header requires image data already collected, this flag makes the header preparation wait until valid data is collected */
-  bool IsHeaderPrepared;
+  std::atomic<bool> IsHeaderPrepared;
 
   /*! Record the number of frames captured */
   long int TotalFramesRecorded;  // hard drive will probably fill up before a regular int is hit, but still...
@@ -178,6 +266,40 @@ protected:
   /*! Mutex instance simultaneous access of writer (writer may be accessed from command processing thread and also the internal update thread) */
   vtkSmartPointer<vtkIGSIORecursiveCriticalSection> WriterAccessMutex;
 
+  /*!
+    Maximum number of frame batches waiting for the writer thread. If the queue is full then the recorded frames
+    are kept in memory and queued together as soon as there is space, so sampling never has to wait for the disk.
+  */
+  unsigned int WriterQueueSize;
+
+  /*!
+    Maximum number of recorded frames that are kept in memory while the writer queue is full (at least FrameBufferSize frames
+    are kept if frame buffering is enabled). If more frames are recorded then the oldest ones are dropped, so sampling
+    never waits for the writer thread.
+  */
+  unsigned int MaxRecordedFramesInMemory;
+
+  DiskSyncPolicyType DiskSyncPolicy;
+
+  /*! Protects the writer queue, the writer thread state and the statistics */
+  mutable std::mutex WriterQueueMutex;
+  /*! Signaled when a batch is queued, when a batch is written, and when the writer thread stops */
+  std::condition_variable WriterQueueChanged;
+  std::deque<vtkSmartPointer<vtkIGSIOTrackedFrameList> > WriterQueue;
+  WriterQueueStatistics WriterStats;
+  /*! True while a batch that was removed from the queue is being written (by the writer thread or FlushWriterQueue) */
+  bool WriterBusy;
+  /*! True while FlushWriterQueue writes the batches that it took over from the queue, the writer thread must not write then */
+  bool WriterReserved;
+  /*! Active flag for the writer thread (first: request, second: respond) */
+  std::pair<bool, bool> WriterThreadActive;
+  /*! Set by the writer thread if writing failed, recording is stopped by the internal update thread */
+  std::atomic<bool> WriteFailed;
+  /*! Set when the queue gets full, to log a warning only once per congestion */
+  bool WriterQueueFull;
+  /*! Set when recorded frames are dropped, to log a warning only once per congestion */
+  bool DroppingRecordedFrames;
+
   vtkPlusLogger::LogLevelType GracePeriodLogLevel;
 
   PlusStatus GetInputTrackedFrame(igsioTrackedFrame& aFrame);
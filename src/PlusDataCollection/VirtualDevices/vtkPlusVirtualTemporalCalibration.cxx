@@ -0,0 +1,524 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+
+#include "igsioCommon.h"
+#include "vtkObjectFactory.h"
+#include "vtkPlusChannel.h"
+#include "vtkPlusDataSource.h"
+#include "vtkIGSIOTrackedFrameList.h"
+#include "vtkPlusVirtualTemporalCalibration.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+
+// STL includes
+#include <algorithm>
+
+//----------------------------------------------------------------------------
+
+vtkStandardNewMacro(vtkPlusVirtualTemporalCalibration);
+
+//----------------------------------------------------------------------------
+
+namespace
+{
+  static const char* LAG_FIELD_NAME = "TemporalCalibrationMovingLagSec";
+  static const char* CONFIDENCE_FIELD_NAME = "TemporalCalibrationConfidence";
+  static const int TEMPORAL_CALIBRATION_MISSING_INPUT_DEFAULT = 1;
+
+  /*! Maximum number of frames that are processed from a channel in one update */
+  static const int MAX_NUMBER_OF_FRAMES_PER_UPDATE = 200;
+
+  /*! Number of power iterations for updating the principal motion axis from the previous axis after each tracker sample */
+  static const int PRINCIPAL_AXIS_POWER_ITERATIONS = 2;
+
+  //----------------------------------------------------------------------------
+  template <class T>
+  PlusStatus ComputeIntensityWeightedMeanRow(vtkImageData* image, const int regionOrigin[2], const int regionSize[2], T*, double& meanRow)
+  {
+    int dimensions[3] = {0, 0, 0};
+    image->GetDimensions(dimensions);
+    int numberOfComponents = image->GetNumberOfScalarComponents();
+
+    int firstColumn = 0;
+    int firstRow = 0;
+    int endColumn = dimensions[0];
+    int endRow = dimensions[1];
+    if (regionSize[0] > 0 && regionSize[1] > 0)
+    {
+      firstColumn = std::max(regionOrigin[0], 0);
+      firstRow = std::max(regionOrigin[1], 0);
+      endColumn = std::min(regionOrigin[0] + regionSize[0], dimensions[0]);
+      endRow = std::min(regionOrigin[1] + regionSize[1], dimensions[1]);
+    }
+    if (firstColumn >= endColumn || firstRow >= endRow)
+    {
+      return PLUS_FAIL;
+    }
+
+    const T* pixels = static_cast<const T*>(image->GetScalarPointer());
+    double sumIntensities = 0.0;
+    double sumWeightedRows = 0.0;
+    for (int row = firstRow; row < endRow; ++row)
+    {
+      // Only the first component is used
+      const T* pixel = pixels + (static_cast<size_t>(row) * dimensions[0] + firstColumn) * numberOfComponents;
+      double rowIntensity = 0.0;
+      for (int column = firstColumn; column < endColumn; ++column, pixel += numberOfComponents)
+      {
+        rowIntensity += static_cast<double>(*pixel);
+      }
+      sumIntensities += rowIntensity;
+      sumWeightedRows += rowIntensity * row;
+    }
+    if (sumIntensities <= 0)
+    {
+      return PLUS_FAIL;
+    }
+    meanRow = sumWeightedRows / sumIntensities;
+    return PLUS_SUCCESS;
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkPlusVirtualTemporalCalibration::PositionSignal::PositionSignal()
+  : Channel(NULL)
+  , LastTimestamp(UNDEFINED_TIMESTAMP)
+{
+  this->ResetTrackerStatistics();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusVirtualTemporalCalibration::PositionSignal::ResetTrackerStatistics()
+{
+  this->LastTrackerTimestamp = UNDEFINED_TIMESTAMP;
+  this->SumWeights = 0.0;
+  for (int i = 0; i < 3; ++i)
+  {
+    this->MeanPosition[i] = 0.0;
+    for (int j = 0; j < 3; ++j)
+    {
+      this->PositionCovariance[i][j] = 0.0;
+    }
+    // Start from a direction that is not orthogonal to any of the coordinate axes
+    this->PrincipalAxis[i] = 1.0 / sqrt(3.0);
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkPlusVirtualTemporalCalibration::vtkPlusVirtualTemporalCalibration()
+  : vtkPlusDevice()
+  , SamplingResolutionSec(0.01)
+  , MaximumMovingLagSec(1.0)
+  , MemoryTimeSec(20.0)
+  , MinimumConfidence(0.9)
+  , ApplyTimeOffset(false)
+  , MovingLagAvailable(false)
+  , MovingLagSec(0.0)
+  , MovingLagConfidence(0.0)
+  , TrackedFrames(vtkIGSIOTrackedFrameList::New())
+  , OutputChannel(NULL)
+{
+  this->ImageRegionOrigin[0] = -1;
+  this->ImageRegionOrigin[1] = -1;
+  this->ImageRegionSize[0] = -1;
+  this->ImageRegionSize[1] = -1;
+
+  // The data capture thread will be used to regularly read the new frames of the input channels and update the estimate
+  this->StartThreadForInternalUpdates = true;
+  this->AcquisitionRate = vtkPlusDevice::VIRTUAL_DEVICE_FRAME_RATE;
+}
+
+//----------------------------------------------------------------------------
+vtkPlusVirtualTemporalCalibration::~vtkPlusVirtualTemporalCalibration()
+{
+  this->TrackedFrames->Delete();
+  this->TrackedFrames = NULL;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusVirtualTemporalCalibration::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "FixedProbeToReferenceTransformName: " << this->FixedProbeToReferenceTransformName << std::endl;
+  os << indent << "MovingProbeToReferenceTransformName: " << this->MovingProbeToReferenceTransformName << std::endl;
+  os << indent << "SamplingResolutionSec: " << this->SamplingResolutionSec << std::endl;
+  os << indent << "MaximumMovingLagSec: " << this->MaximumMovingLagSec << std::endl;
+  os << indent << "MemoryTimeSec: " << this->MemoryTimeSec << std::endl;
+  os << indent << "MinimumConfidence: " << this->MinimumConfidence << std::endl;
+  os << indent << "ApplyTimeOffset: " << (this->ApplyTimeOffset ? "TRUE" : "FALSE") << std::endl;
+  if (this->MovingLagAvailable)
+  {
+    os << indent << "MovingLagSec: " << this->MovingLagSec << " (confidence: " << this->MovingLagConfidence << ")" << std::endl;
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualTemporalCalibration::GetMovingLagSec(double& lagSec, double& confidence)
+{
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->UpdateMutex);
+  if (!this->MovingLagAvailable)
+  {
+    return PLUS_FAIL;
+  }
+  lagSec = this->MovingLagSec;
+  confidence = this->MovingLagConfidence;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualTemporalCalibration::InternalConnect()
+{
+  if (this->LagEstimator.SetParameters(this->SamplingResolutionSec, this->MaximumMovingLagSec, this->MemoryTimeSec) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to initialize temporal calibration. Device ID: " << this->GetDeviceId());
+    return PLUS_FAIL;
+  }
+  this->FixedSignal.LastTimestamp = UNDEFINED_TIMESTAMP;
+  this->FixedSignal.ResetTrackerStatistics();
+  this->MovingSignal.LastTimestamp = UNDEFINED_TIMESTAMP;
+  this->MovingSignal.ResetTrackerStatistics();
+  this->MovingLagAvailable = false;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualTemporalCalibration::InternalUpdate()
+{
+  if (!this->HasGracePeriodExpired())
+  {
+    return PLUS_SUCCESS;
+  }
+
+  // The update continues even if no new frames are available from one of the channels (the estimate is kept)
+  this->UpdateSignal(this->FixedSignal, true);
+  this->UpdateSignal(this->MovingSignal, false);
+
+  double lagSec(0);
+  double confidence(0);
+  if (this->LagEstimator.GetLag(lagSec, confidence) != PLUS_SUCCESS)
+  {
+    // Not enough data yet or the probe is not moving
+    return PLUS_SUCCESS;
+  }
+  this->MovingLagAvailable = true;
+  this->MovingLagSec = lagSec;
+  this->MovingLagConfidence = confidence;
+
+  igsioFieldMapType fieldMap;
+  fieldMap[LAG_FIELD_NAME].first = FRAMEFIELD_NONE;
+  fieldMap[LAG_FIELD_NAME].second = igsioCommon::ToString<double>(lagSec);
+  fieldMap[CONFIDENCE_FIELD_NAME].first = FRAMEFIELD_NONE;
+  fieldMap[CONFIDENCE_FIELD_NAME].second = igsioCommon::ToString<double>(confidence);
+  for (DataSourceContainerIterator it = this->OutputChannel->GetFieldDataSourcesStartIterator(); it != this->OutputChannel->GetFieldDataSourcesEndIterator(); ++it)
+  {
+    it->second->AddItem(fieldMap, this->FrameNumber);
+  }
+  this->FrameNumber++;
+
+  if (this->ApplyTimeOffset)
+  {
+    this->ApplyLagToTimeOffset(lagSec, confidence);
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualTemporalCalibration::UpdateSignal(PositionSignal& signal, bool isFixedSignal)
+{
+  this->TrackedFrames->Clear();
+  if (signal.Channel->GetTrackedFrameList(signal.LastTimestamp, this->TrackedFrames, MAX_NUMBER_OF_FRAMES_PER_UPDATE) != PLUS_SUCCESS)
+  {
+    // The requested frames may have been already overwritten in the buffer, continue from the most recent frame
+    LOG_DEBUG("Failed to get new frames from channel " << signal.Channel->GetChannelId() << ". Device ID: " << this->GetDeviceId());
+    signal.LastTimestamp = UNDEFINED_TIMESTAMP;
+    return PLUS_FAIL;
+  }
+
+  for (unsigned int frameIndex = 0; frameIndex < this->TrackedFrames->GetNumberOfTrackedFrames(); ++frameIndex)
+  {
+    igsioTrackedFrame* frame = this->TrackedFrames->GetTrackedFrame(frameIndex);
+    double position(0);
+    if (this->GetPositionFromFrame(*frame, signal, position) != PLUS_SUCCESS)
+    {
+      continue;
+    }
+    if (isFixedSignal)
+    {
+      this->LagEstimator.AddFixedSample(frame->GetTimestamp(), position);
+    }
+    else
+    {
+      this->LagEstimator.AddMovingSample(frame->GetTimestamp(), position);
+    }
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualTemporalCalibration::GetPositionFromFrame(igsioTrackedFrame& frame, PositionSignal& signal, double& position)
+{
+  if (!signal.ProbeToReferenceTransformName.IsValid())
+  {
+    vtkImageData* image = frame.GetImageData()->GetImage();
+    if (image == NULL)
+    {
+      return PLUS_FAIL;
+    }
+    PlusStatus status = PLUS_FAIL;
+    switch (image->GetScalarType())
+    {
+      vtkTemplateMacro(status = ComputeIntensityWeightedMeanRow(image, this->ImageRegionOrigin, this->ImageRegionSize, static_cast<VTK_TT*>(NULL), position));
+      default:
+        LOG_ERROR("Unsupported image scalar type: " << image->GetScalarType() << ". Device ID: " << this->GetDeviceId());
+    }
+    return status;
+  }
+
+  ToolStatus status(TOOL_INVALID);
+  if (frame.GetFrameTransformStatus(signal.ProbeToReferenceTransformName, status) != PLUS_SUCCESS || status != TOOL_OK)
+  {
+    return PLUS_FAIL;
+  }
+  vtkSmartPointer<vtkMatrix4x4> probeToReferenceTransform = vtkSmartPointer<vtkMatrix4x4>::New();
+  if (frame.GetFrameTransform(signal.ProbeToReferenceTransformName, probeToReferenceTransform) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  double probePosition[3] =
+  {
+    probeToReferenceTransform->GetElement(0, 3),
+    probeToReferenceTransform->GetElement(1, 3),
+    probeToReferenceTransform->GetElement(2, 3)
+  };
+
+  // Update the exponentially weighted mean and covariance of the positions (weight of old samples decays with the memory time)
+  double decay = 0.0;
+  if (signal.LastTrackerTimestamp != UNDEFINED_TIMESTAMP && frame.GetTimestamp() > signal.LastTrackerTimestamp)
+  {
+    decay = exp(-(frame.GetTimestamp() - signal.LastTrackerTimestamp) / this->MemoryTimeSec);
+  }
+  else if (signal.LastTrackerTimestamp != UNDEFINED_TIMESTAMP)
+  {
+    decay = 1.0;
+  }
+  signal.LastTrackerTimestamp = frame.GetTimestamp();
+  signal.SumWeights = decay * signal.SumWeights + 1.0;
+  double newSampleWeight = 1.0 / signal.SumWeights;
+  double difference[3] = {0.0, 0.0, 0.0};
+  for (int i = 0; i < 3; ++i)
+  {
+    difference[i] = probePosition[i] - signal.MeanPosition[i];
+    signal.MeanPosition[i] += newSampleWeight * difference[i];
+  }
+  for (int i = 0; i < 3; ++i)
+  {
+    for (int j = 0; j < 3; ++j)
+    {
+      signal.PositionCovariance[i][j] = (1.0 - newSampleWeight) * (signal.PositionCovariance[i][j] + newSampleWeight * difference[i] * difference[j]);
+    }
+  }
+
+  // The principal axis changes slowly, so a few power iterations started from the previous axis keep it up-to-date.
+  // The covariance is positive semidefinite, so the iterations do not flip the direction of the axis.
+  for (int iteration = 0; iteration < PRINCIPAL_AXIS_POWER_ITERATIONS; ++iteration)
+  {
+    double newAxis[3] = {0.0, 0.0, 0.0};
+    for (int i = 0; i < 3; ++i)
+    {
+      for (int j = 0; j < 3; ++j)
+      {
+        newAxis[i] += signal.PositionCovariance[i][j] * signal.PrincipalAxis[j];
+      }
+    }
+    double length = sqrt(newAxis[0] * newAxis[0] + newAxis[1] * newAxis[1] + newAxis[2] * newAxis[2]);
+    if (length < 1e-12)
+    {
+      // No motion yet
+      break;
+    }
+    for (int i = 0; i < 3; ++i)
+    {
+      signal.PrincipalAxis[i] = newAxis[i] / length;
+    }
+  }
+
+  position = probePosition[0] * signal.PrincipalAxis[0] + probePosition[1] * signal.PrincipalAxis[1] + probePosition[2] * signal.PrincipalAxis[2];
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+vtkPlusDevice* vtkPlusVirtualTemporalCalibration::GetMovingDevice()
+{
+  vtkPlusDataSource* source = NULL;
+  if (this->MovingSignal.ProbeToReferenceTransformName.IsValid())
+  {
+    if (this->MovingSignal.Channel->GetTool(source, this->MovingSignal.ProbeToReferenceTransformName.GetTransformName()) != PLUS_SUCCESS)
+    {
+      return NULL;
+    }
+  }
+  else if (this->MovingSignal.Channel->GetVideoSource(source) != PLUS_SUCCESS)
+  {
+    return NULL;
+  }
+  return source->GetDevice();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusVirtualTemporalCalibration::ApplyLagToTimeOffset(double lagSec, double confidence)
+{
+  if (confidence < this->MinimumConfidence
+      || this->LagEstimator.GetPairedSignalDurationSec() < this->MemoryTimeSec
+      || fabs(lagSec) < this->SamplingResolutionSec)
+  {
+    // The estimate is not reliable yet or the lag is already compensated
+    return;
+  }
+  vtkPlusDevice* movingDevice = this->GetMovingDevice();
+  if (movingDevice == NULL)
+  {
+    return;
+  }
+
+  // Frames of the moving device are acquired lagSec earlier than their timestamps indicate
+  double timeOffsetSec = movingDevice->GetLocalTimeOffsetSec() - lagSec;
+  LOG_INFO("Moving signal lag is " << lagSec << " sec (confidence: " << confidence << "). Local time offset of device " << movingDevice->GetDeviceId()
+           << " is changed from " << movingDevice->GetLocalTimeOffsetSec() << " sec to " << timeOffsetSec << " sec.");
+  movingDevice->SetLocalTimeOffsetSec(timeOffsetSec);
+
+  // Timestamps of the moving signal are changed, so the signal history is no longer valid.
+  // Starting the estimation again also prevents compensating the same lag multiple times.
+  this->LagEstimator.Reset();
+  this->FixedSignal.LastTimestamp = UNDEFINED_TIMESTAMP;
+  this->MovingSignal.LastTimestamp = UNDEFINED_TIMESTAMP;
+  this->MovingLagAvailable = false;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualTemporalCalibration::ReadConfiguration(vtkXMLDataElement* rootConfigElement)
+{
+  XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_READING(deviceConfig, rootConfigElement);
+
+  Superclass::ReadConfiguration(rootConfigElement);
+
+  if (this->MissingInputGracePeriodSec < TEMPORAL_CALIBRATION_MISSING_INPUT_DEFAULT)
+  {
+    LOG_WARNING("MissingInputGracePeriodSec must be set to a value > 1s to allow input to arrive and be processed.");
+    this->MissingInputGracePeriodSec = TEMPORAL_CALIBRATION_MISSING_INPUT_DEFAULT;
+  }
+
+  XML_READ_STRING_ATTRIBUTE_OPTIONAL(FixedProbeToReferenceTransformName, deviceConfig);
+  XML_READ_STRING_ATTRIBUTE_OPTIONAL(MovingProbeToReferenceTransformName, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, SamplingResolutionSec, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, MaximumMovingLagSec, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, MemoryTimeSec, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, MinimumConfidence, deviceConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(ApplyTimeOffset, deviceConfig);
+  XML_READ_VECTOR_ATTRIBUTE_OPTIONAL(int, 2, ImageRegionOrigin, deviceConfig);
+  XML_READ_VECTOR_ATTRIBUTE_OPTIONAL(int, 2, ImageRegionSize, deviceConfig);
+
+  PositionSignal* signals[2] = {&this->FixedSignal, &this->MovingSignal};
+  const std::string* transformNames[2] = {&this->FixedProbeToReferenceTransformName, &this->MovingProbeToReferenceTransformName};
+  for (int i = 0; i < 2; ++i)
+  {
+    signals[i]->ProbeToReferenceTransformName = igsioTransformName();
+    if (!transformNames[i]->empty() && signals[i]->ProbeToReferenceTransformName.SetTransformName(transformNames[i]->c_str()) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Invalid probe to reference transform name: " << *transformNames[i]);
+      return PLUS_FAIL;
+    }
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualTemporalCalibration::WriteConfiguration(vtkXMLDataElement* rootConfigElement)
+{
+  XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_WRITING(deviceConfig, rootConfigElement);
+
+  XML_WRITE_STRING_ATTRIBUTE_REMOVE_IF_EMPTY(FixedProbeToReferenceTransformName, deviceConfig);
+  XML_WRITE_STRING_ATTRIBUTE_REMOVE_IF_EMPTY(MovingProbeToReferenceTransformName, deviceConfig);
+  deviceConfig->SetDoubleAttribute("SamplingResolutionSec", this->SamplingResolutionSec);
+  deviceConfig->SetDoubleAttribute("MaximumMovingLagSec", this->MaximumMovingLagSec);
+  deviceConfig->SetDoubleAttribute("MemoryTimeSec", this->MemoryTimeSec);
+  deviceConfig->SetDoubleAttribute("MinimumConfidence", this->MinimumConfidence);
+  deviceConfig->SetAttribute("ApplyTimeOffset", this->ApplyTimeOffset ? "TRUE" : "FALSE");
+  if (this->ImageRegionSize[0] > 0 && this->ImageRegionSize[1] > 0)
+  {
+    deviceConfig->SetVectorAttribute("ImageRegionOrigin", 2, this->ImageRegionOrigin);
+    deviceConfig->SetVectorAttribute("ImageRegionSize", 2, this->ImageRegionSize);
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualTemporalCalibration::NotifyConfigured()
+{
+  if (this->InputChannels.size() < 1 || this->InputChannels.size() > 2)
+  {
+    LOG_ERROR("Temporal calibration needs one or two input channels (fixed and moving signal). Device ID: " << this->GetDeviceId());
+    return PLUS_FAIL;
+  }
+  // If only one channel is specified then both signals are computed from it (e.g., video and tracking data of a tracked video channel)
+  this->FixedSignal.Channel = this->InputChannels[0];
+  this->MovingSignal.Channel = this->InputChannels[this->InputChannels.size() - 1];
+
+  PositionSignal* signals[2] = {&this->FixedSignal, &this->MovingSignal};
+  for (int i = 0; i < 2; ++i)
+  {
+    if (signals[i]->ProbeToReferenceTransformName.IsValid())
+    {
+      vtkPlusDataSource* tool = NULL;
+      if (signals[i]->Channel->GetTool(tool, signals[i]->ProbeToReferenceTransformName.GetTransformName()) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Input channel " << signals[i]->Channel->GetChannelId() << " does not have a tool for transform " << signals[i]->ProbeToReferenceTransformName.GetTransformName()
+                  << ". Device ID: " << this->GetDeviceId());
+        return PLUS_FAIL;
+      }
+    }
+    else if (!signals[i]->Channel->HasVideoSource())
+    {
+      LOG_ERROR("Input channel " << signals[i]->Channel->GetChannelId() << " does not have a video source. Specify the probe to reference transform name to use tracking data."
+                << " Device ID: " << this->GetDeviceId());
+      return PLUS_FAIL;
+    }
+  }
+  if (this->FixedSignal.Channel == this->MovingSignal.Channel
+      && this->FixedSignal.ProbeToReferenceTransformName.GetTransformName() == this->MovingSignal.ProbeToReferenceTransformName.GetTransformName())
+  {
+    LOG_ERROR("Fixed and moving signals of temporal calibration are the same. Specify a second input channel or a different transform name. Device ID: " << this->GetDeviceId());
+    return PLUS_FAIL;
+  }
+
+  if (this->ApplyTimeOffset && this->GetMovingDevice() == NULL)
+  {
+    LOG_ERROR("Device of the moving signal is not found, time offset cannot be applied. Device ID: " << this->GetDeviceId());
+    return PLUS_FAIL;
+  }
+
+  if (this->OutputChannels.size() != 1)
+  {
+    LOG_ERROR("Temporal calibration requires one output channel to send the estimated lag. Device ID: " << this->GetDeviceId());
+    return PLUS_FAIL;
+  }
+  this->OutputChannel = this->OutputChannels[0];
+
+  if (!this->OutputChannel->GetFieldDataEnabled())
+  {
+    LOG_ERROR("Temporal calibration requires an output channel with at least one field data source defined. Device ID: " << this->GetDeviceId());
+    return PLUS_FAIL;
+  }
+
+  return PLUS_SUCCESS;
+}
@@ -0,0 +1,167 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusVirtualTemporalCalibration_h
+#define __vtkPlusVirtualTemporalCalibration_h
+
+#include "PlusConfigure.h"
+#include "vtkPlusDataCollectionExport.h"
+#include "vtkPlusChannel.h"
+#include "vtkPlusDevice.h"
+#include "PlusSignalLagEstimator.h"
+
+class vtkIGSIOTrackedFrameList;
+
+/*!
+\class vtkPlusVirtualTemporalCalibration
+\brief Continuously estimates the time lag between two input channels while data is being acquired
+
+A position signal is extracted from each input channel: from a tracker channel the probe position along its principal
+direction of motion, from a video channel the intensity-weighted mean row of the image. New frames of the channels are
+added to an incremental lag estimator (see PlusSignalLagEstimator), so the estimate follows slow changes of the lag,
+for example when the imaging parameters of the ultrasound system are changed.
+
+The estimated lag and its confidence are sent to the field data sources of the output channel.
+Optionally the lag is compensated by changing the local time offset of the device that provides the moving signal.
+
+\ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport vtkPlusVirtualTemporalCalibration : public vtkPlusDevice
+{
+public:
+  static vtkPlusVirtualTemporalCalibration* New();
+  vtkTypeMacro(vtkPlusVirtualTemporalCalibration, vtkPlusDevice);
+  virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
+
+  /*! Clear the signals and start the estimation from scratch */
+  virtual PlusStatus InternalConnect();
+
+  /*! Read main configuration from xml data */
+  virtual PlusStatus ReadConfiguration(vtkXMLDataElement*);
+
+  /*! Write main configuration from xml data */
+  virtual PlusStatus WriteConfiguration(vtkXMLDataElement*);
+
+  /*! Callback after configuration of all devices is complete */
+  virtual PlusStatus NotifyConfigured();
+
+  virtual bool IsTracker() const {return false;}
+  virtual bool IsVirtual() const {return true;}
+
+  /*! Transform that describes the probe position in the fixed channel. If empty then the position is computed from the video. */
+  vtkSetStdStringMacro(FixedProbeToReferenceTransformName);
+  vtkGetStdStringMacro(FixedProbeToReferenceTransformName);
+
+  /*! Transform that describes the probe position in the moving channel. If empty then the position is computed from the video. */
+  vtkSetStdStringMacro(MovingProbeToReferenceTransformName);
+  vtkGetStdStringMacro(MovingProbeToReferenceTransformName);
+
+  /*! Time resolution of the lag estimation. Default is 0.01 sec. */
+  vtkSetMacro(SamplingResolutionSec, double);
+  vtkGetMacro(SamplingResolutionSec, double);
+
+  /*! Maximum absolute value of the estimated lag. Default is 1 sec. */
+  vtkSetMacro(MaximumMovingLagSec, double);
+  vtkGetMacro(MaximumMovingLagSec, double);
+
+  /*! Time constant of forgetting old samples. Default is 20 sec. */
+  vtkSetMacro(MemoryTimeSec, double);
+  vtkGetMacro(MemoryTimeSec, double);
+
+  /*! Minimum correlation of the signals at the estimated lag for changing the local time offset. Default is 0.9. */
+  vtkSetMacro(MinimumConfidence, double);
+  vtkGetMacro(MinimumConfidence, double);
+
+  /*! If enabled then the estimated lag is compensated by changing the local time offset of the moving device. Disabled by default. */
+  vtkSetMacro(ApplyTimeOffset, bool);
+  vtkGetMacro(ApplyTimeOffset, bool);
+  vtkBooleanMacro(ApplyTimeOffset, bool);
+
+  /*! Origin of the image region that is used for computing the video position signal (in pixels). Default is the whole image. */
+  vtkSetVector2Macro(ImageRegionOrigin, int);
+  vtkGetVector2Macro(ImageRegionOrigin, int);
+
+  /*! Size of the image region that is used for computing the video position signal (in pixels). Default is the whole image. */
+  vtkSetVector2Macro(ImageRegionSize, int);
+  vtkGetVector2Macro(ImageRegionSize, int);
+
+  /*!
+    Get the most recent lag estimate. The lag is the time [s] by which the moving signal lags the fixed signal
+    (after compensation with the current local time offsets). The confidence is between 0 and 1.
+    \return PLUS_FAIL if no estimate is available yet
+  */
+  PlusStatus GetMovingLagSec(double& lagSec, double& confidence);
+
+protected:
+  /*! Position signal of an input channel */
+  class PositionSignal
+  {
+  public:
+    PositionSignal();
+    void ResetTrackerStatistics();
+
+    vtkPlusChannel* Channel;
+    /*! If the name is not valid then the position is computed from the video */
+    igsioTransformName ProbeToReferenceTransformName;
+    /*! Timestamp of the most recent frame that has been added to the estimator */
+    double LastTimestamp;
+
+    /*! Exponentially weighted statistics of the tracked positions for finding the principal direction of the motion */
+    double LastTrackerTimestamp;
+    double SumWeights;
+    double MeanPosition[3];
+    double PositionCovariance[3][3];
+    double PrincipalAxis[3];
+  };
+
+  virtual PlusStatus InternalUpdate();
+
+  /*! Add the new frames of the channel to the estimator */
+  PlusStatus UpdateSignal(PositionSignal& signal, bool isFixedSignal);
+
+  /*! Compute the position value from a frame */
+  PlusStatus GetPositionFromFrame(igsioTrackedFrame& frame, PositionSignal& signal, double& position);
+
+  /*! Change the local time offset of the moving device by the estimated lag if the estimate is reliable */
+  void ApplyLagToTimeOffset(double lagSec, double confidence);
+
+  /*! Device whose local time offset is changed to compensate the lag */
+  vtkPlusDevice* GetMovingDevice();
+
+  std::string FixedProbeToReferenceTransformName;
+  std::string MovingProbeToReferenceTransformName;
+  double SamplingResolutionSec;
+  double MaximumMovingLagSec;
+  double MemoryTimeSec;
+  double MinimumConfidence;
+  bool ApplyTimeOffset;
+  int ImageRegionOrigin[2];
+  int ImageRegionSize[2];
+
+  PositionSignal FixedSignal;
+  PositionSignal MovingSignal;
+  PlusSignalLagEstimator LagEstimator;
+
+  /*! Most recent estimate, protected by the update mutex */
+  bool MovingLagAvailable;
+  double MovingLagSec;
+  double MovingLagConfidence;
+
+  vtkIGSIOTrackedFrameList* TrackedFrames;
+
+  /// Output channel to store the estimated lag for broadcasting
+  vtkPlusChannel* OutputChannel;
+
+protected:
+  vtkPlusVirtualTemporalCalibration();
+  virtual ~vtkPlusVirtualTemporalCalibration();
+
+private:
+  vtkPlusVirtualTemporalCalibration(const vtkPlusVirtualTemporalCalibration&);
+  void operator=(const vtkPlusVirtualTemporalCalibration&);
+};
+
+#endif //__vtkPlusVirtualTemporalCalibration_h
@@ -25,11 +25,64 @@ See License.txt for details.
 // vtkAddon includes
 #include <vtkStreamingVolumeCodec.h>
 
+// STL includes
+#include <algorithm>
+
 static const double NEGLIGIBLE_TIME_DIFFERENCE = 0.00001; // in seconds, used for comparing between exact timestamps
 static const double ANGLE_INTERPOLATION_WARNING_THRESHOLD_DEG = 10; // if the interpolated orientation differs from both the interpolated orientation by more than this threshold then display a warning
 
 vtkStandardNewMacro(vtkPlusBuffer);
 
+namespace
+{
+  //----------------------------------------------------------------------------
+  double GetQuaternionAngleDifferenceDeg(const double quatA[4], const double quatB[4])
+  {
+    double dotProduct = fabs(quatA[0] * quatB[0] + quatA[1] * quatB[1] + quatA[2] * quatB[2] + quatA[3] * quatB[3]);
+    return vtkMath::DegreesFromRadians(2.0 * acos(std::min(dotProduct, 1.0)));
+  }
+
+  //----------------------------------------------------------------------------
+  // Interpolate between two poses (first 3 rows of the transformation matrices, row-major).
+  // The rotation is interpolated with SLERP interpolation, and the position is interpolated with linear interpolation.
+  // angleDiffA and angleDiffB receive the orientation difference between the interpolated and the input poses in degrees.
+  void InterpolatePose(const double poseA[vtkPlusBuffer::POSE_SIZE], const double poseB[vtkPlusBuffer::POSE_SIZE], double itemBweight,
+                       double interpolatedPose[vtkPlusBuffer::POSE_SIZE], double& angleDiffA, double& angleDiffB)
+  {
+    double matrixA[3][3] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
+    double matrixB[3][3] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
+    for (int i = 0; i < 3; i++)
+    {
+      for (int j = 0; j < 3; j++)
+      {
+        matrixA[i][j] = poseA[i * 4 + j];
+        matrixB[i][j] = poseB[i * 4 + j];
+      }
+    }
+
+    double matrixAquat[4] = {0, 0, 0, 0};
+    vtkMath::Matrix3x3ToQuaternion(matrixA, matrixAquat);
+    double matrixBquat[4] = {0, 0, 0, 0};
+    vtkMath::Matrix3x3ToQuaternion(matrixB, matrixBquat);
+    double interpolatedRotationQuat[4] = {0, 0, 0, 0};
+    igsioMath::Slerp(interpolatedRotationQuat, itemBweight, matrixAquat, matrixBquat);
+    double interpolatedRotation[3][3] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
+    vtkMath::QuaternionToMatrix3x3(interpolatedRotationQuat, interpolatedRotation);
+
+    double itemAweight = 1.0 - itemBweight;
+    for (int i = 0; i < 3; i++)
+    {
+      interpolatedPose[i * 4 + 0] = interpolatedRotation[i][0];
+      interpolatedPose[i * 4 + 1] = interpolatedRotation[i][1];
+      interpolatedPose[i * 4 + 2] = interpolatedRotation[i][2];
+      interpolatedPose[i * 4 + 3] = poseA[i * 4 + 3] * itemAweight + poseB[i * 4 + 3] * itemBweight;
+    }
+
+    angleDiffA = GetQuaternionAngleDifferenceDeg(interpolatedRotationQuat, matrixAquat);
+    angleDiffB = GetQuaternionAngleDifferenceDeg(interpolatedRotationQuat, matrixBquat);
+  }
+}
+
 #define LOCAL_LOG_ERROR(msg) \
 { \
   std::ostringstream msgStream; \
@@ -380,6 +433,7 @@ PlusStatus vtkPlusBuffer::AddItem(const igsioFieldMapType& fields,
     std::string name(it->first);
   }
 
+  this->NotifyNewItemSignals();
   return PLUS_SUCCESS;
 }
 
@@ -479,6 +533,13 @@ PlusStatus vtkPlusBuffer::AddItem(void* imageDataPtr,
     return PLUS_FAIL;
   }
 
+  // Readers may still reference the pixel storage of this slot, don't overwrite it
+  if (newObjectInBuffer->DetachFrameStorage() != PLUS_SUCCESS)
+  {
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to allocate pixel storage for the new frame!");
+    return PLUS_FAIL;
+  }
+
   FrameSizeType receivedFrameSize = { 0, 0, 0 };
   newObjectInBuffer->GetFrame().GetFrameSize(receivedFrameSize);
 
@@ -531,6 +592,7 @@ PlusStatus vtkPlusBuffer::AddItem(void* imageDataPtr,
     }
   }
 
+  this->NotifyNewItemSignals();
   return PLUS_SUCCESS;
 }
 
@@ -592,6 +654,13 @@ PlusStatus vtkPlusBuffer::AddItem(void* imageDataPtr, const FrameSizeType& frame
     return PLUS_FAIL;
   }
 
+  // Readers may still reference the pixel storage of this slot, don't overwrite it
+  if (newObjectInBuffer->DetachFrameStorage() != PLUS_SUCCESS)
+  {
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to allocate pixel storage for the new frame!");
+    return PLUS_FAIL;
+  }
+
   unsigned int bufferFrameSizeBytes = newObjectInBuffer->GetFrame().GetFrameSizeInBytes();
   if (bufferFrameSizeBytes < inputFrameSizeInBytes)
   {
@@ -622,6 +691,7 @@ PlusStatus vtkPlusBuffer::AddItem(void* imageDataPtr, const FrameSizeType& frame
 
   newObjectInBuffer->SetFrameField("FrameSizeInBytes", igsioCommon::ToString<unsigned int>(inputFrameSizeInBytes));
 
+  this->NotifyNewItemSignals();
   return PLUS_SUCCESS;
 }
 
@@ -696,6 +766,7 @@ PlusStatus vtkPlusBuffer::AddTimeStampedItem(vtkMatrix4x4* matrix, ToolStatus st
     }
   }
 
+  this->NotifyNewItemSignals();
   return itemStatus;
 }
 
@@ -788,12 +859,47 @@ ItemStatus vtkPlusBuffer::GetStreamBufferItem(BufferItemUidType uid, StreamBuffe
   return ITEM_OK;
 }
 
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusBuffer::GetStreamBufferItemView(BufferItemUidType uid, StreamBufferItem* bufferItem)
+{
+  if (bufferItem == NULL)
+  {
+    LOCAL_LOG_ERROR("Unable to copy data buffer item into a NULL data buffer item!");
+    return ITEM_UNKNOWN_ERROR;
+  }
+
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+
+  StreamBufferItem* dataItem = NULL;
+  ItemStatus itemStatus = this->StreamBuffer->GetBufferItemPointerFromUid(uid, dataItem);
+  if (itemStatus != ITEM_OK)
+  {
+    LOCAL_LOG_WARNING("Failed to retrieve data item");
+    return itemStatus;
+  }
+
+  if (bufferItem->ShallowCopy(dataItem) != PLUS_SUCCESS)
+  {
+    LOCAL_LOG_WARNING("Failed to copy data item");
+    return ITEM_UNKNOWN_ERROR;
+  }
+
+  return ITEM_OK;
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusBuffer::DeepCopy(vtkPlusBuffer* buffer)
 {
   LOG_TRACE("vtkPlusBuffer::DeepCopy");
 
-  this->StreamBuffer->DeepCopy(buffer->StreamBuffer);
+  if (strcmp(buffer->GetClassName(), this->GetClassName()) == 0)
+  {
+    this->StreamBuffer->DeepCopy(buffer->StreamBuffer);
+  }
+  else
+  {
+    this->CopyItemsFrom(buffer);
+  }
   if (buffer->GetFrameSize()[0] != -1 && buffer->GetFrameSize()[1] != -1 && buffer->GetFrameSize()[2] != -1)
   {
     this->SetFrameSize(buffer->GetFrameSize());
@@ -805,6 +911,54 @@ void vtkPlusBuffer::DeepCopy(vtkPlusBuffer* buffer)
   this->SetBufferSize(buffer->GetBufferSize());
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::CopyItemsFrom(vtkPlusBuffer* buffer)
+{
+  this->Clear();
+  this->SetLocalTimeOffsetSec(buffer->GetLocalTimeOffsetSec());
+  if (this->SetBufferSize(buffer->GetBufferSize()) != PLUS_SUCCESS)
+  {
+    LOCAL_LOG_ERROR("Failed to set buffer size for copying buffer items");
+    return PLUS_FAIL;
+  }
+  if (buffer->GetNumberOfItems() < 1)
+  {
+    return PLUS_SUCCESS;
+  }
+
+  PlusStatus status = PLUS_SUCCESS;
+  vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  for (BufferItemUidType uid = buffer->GetOldestItemUidInBuffer(); uid <= buffer->GetLatestItemUidInBuffer(); ++uid)
+  {
+    StreamBufferItem item;
+    if (buffer->GetStreamBufferItem(uid, &item) != ITEM_OK)
+    {
+      // the item has been overwritten since the oldest UID was queried
+      continue;
+    }
+    // timestamps in the buffer are in local time
+    double unfilteredTimestamp = item.GetUnfilteredTimestamp(0.0);
+    double filteredTimestamp = item.GetFilteredTimestamp(0.0);
+    igsioFieldMapType fields = item.GetFrameFieldMap();
+    PlusStatus itemStatus = PLUS_SUCCESS;
+    if (item.HasValidTransformData())
+    {
+      item.GetMatrix(matrix);
+      itemStatus = this->AddTimeStampedItem(matrix, item.GetStatus(), item.GetIndex(), unfilteredTimestamp, filteredTimestamp, &fields);
+    }
+    else
+    {
+      itemStatus = this->AddItem(fields, item.GetIndex(), unfilteredTimestamp, filteredTimestamp);
+    }
+    if (itemStatus != PLUS_SUCCESS)
+    {
+      LOCAL_LOG_ERROR("Failed to copy buffer item with UID: " << uid);
+      status = PLUS_FAIL;
+    }
+  }
+  return status;
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusBuffer::Clear()
 {
@@ -1152,6 +1306,57 @@ bool vtkPlusBuffer::GetTimeStampReporting()
   return this->StreamBuffer->GetTimeStampReporting();
 }
 
+//-----------------------------------------------------------------------------
+void vtkPlusBuffer::SetLatencyTracingComponent(const std::string& component)
+{
+  this->StreamBuffer->SetLatencyTracingComponent(component);
+}
+
+//-----------------------------------------------------------------------------
+std::string vtkPlusBuffer::GetLatencyTracingComponent()
+{
+  return this->StreamBuffer->GetLatencyTracingComponent();
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusBuffer::SetLockFreeTimestampQueries(bool enable)
+{
+  this->StreamBuffer->SetLockFreeTimestampQueries(enable);
+}
+
+//-----------------------------------------------------------------------------
+bool vtkPlusBuffer::GetLockFreeTimestampQueries()
+{
+  return this->StreamBuffer->GetLockFreeTimestampQueries();
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusBuffer::AddNewItemSignal(std::shared_ptr<PlusNewItemSignal> signal)
+{
+  std::lock_guard<std::mutex> lock(this->NewItemSignalsMutex);
+  if (std::find(this->NewItemSignals.begin(), this->NewItemSignals.end(), signal) == this->NewItemSignals.end())
+  {
+    this->NewItemSignals.push_back(signal);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusBuffer::RemoveNewItemSignal(std::shared_ptr<PlusNewItemSignal> signal)
+{
+  std::lock_guard<std::mutex> lock(this->NewItemSignalsMutex);
+  this->NewItemSignals.erase(std::remove(this->NewItemSignals.begin(), this->NewItemSignals.end(), signal), this->NewItemSignals.end());
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusBuffer::NotifyNewItemSignals()
+{
+  std::lock_guard<std::mutex> lock(this->NewItemSignalsMutex);
+  for (std::vector<std::shared_ptr<PlusNewItemSignal> >::iterator it = this->NewItemSignals.begin(); it != this->NewItemSignals.end(); ++it)
+  {
+    (*it)->Notify();
+  }
+}
+
 //----------------------------------------------------------------------------
 // Returns the two buffer items that are closest previous and next buffer items relative to the specified time.
 // itemA is the closest item
@@ -1168,7 +1373,7 @@ PlusStatus vtkPlusBuffer::GetPrevNextBufferItemFromTime(double time, StreamBuffe
 
   // itemA is the item that is the closest to the requested time, get its UID and time
   BufferItemUidType itemAuid(0);
-  ItemStatus status = this->StreamBuffer->GetItemUidFromTime(time, itemAuid);
+  ItemStatus status = this->GetItemUidFromTime(time, itemAuid);
   if (status != ITEM_OK)
   {
     switch (status)
@@ -1200,7 +1405,7 @@ PlusStatus vtkPlusBuffer::GetPrevNextBufferItemFromTime(double time, StreamBuffe
   }
 
   double itemAtime(0);
-  status = this->StreamBuffer->GetTimeStamp(itemAuid, itemAtime);
+  status = this->GetTimeStamp(itemAuid, itemAtime);
   if (status != ITEM_OK)
   {
     LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get data buffer timestamp (time: " << std::fixed << time << ", uid: " << itemAuid << ")");
@@ -1242,7 +1447,7 @@ PlusStatus vtkPlusBuffer::GetPrevNextBufferItemFromTime(double time, StreamBuffe
   }
   // Get item B details
   double itemBtime(0);
-  status = this->StreamBuffer->GetTimeStamp(itemBuid, itemBtime);
+  status = this->GetTimeStamp(itemBuid, itemBtime);
   if (status != ITEM_OK)
   {
     LOCAL_LOG_ERROR("Cannot do interpolation: Failed to get data buffer timestamp with Uid: " << itemBuid);
@@ -1311,7 +1516,7 @@ ItemStatus vtkPlusBuffer::GetStreamBufferItemFromExactTime(double time, StreamBu
   }
 
   // If the time difference is not negligible then return with failure
-  double itemTime = bufferItem->GetFilteredTimestamp(this->StreamBuffer->GetLocalTimeOffsetSec());
+  double itemTime = bufferItem->GetFilteredTimestamp(this->GetLocalTimeOffsetSec());
   if (fabs(itemTime - time) > NEGLIGIBLE_TIME_DIFFERENCE)
   {
     LOCAL_LOG_WARNING("vtkPlusBuffer: Cannot find an item exactly at the requested time (requested time: " << std::fixed << time << ", item time: " << itemTime << ")");
@@ -1327,7 +1532,7 @@ ItemStatus vtkPlusBuffer::GetStreamBufferItemFromClosestTime(double time, Stream
   igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
 
   BufferItemUidType itemUid(0);
-  ItemStatus status = this->StreamBuffer->GetItemUidFromTime(time, itemUid);
+  ItemStatus status = this->GetItemUidFromTime(time, itemUid);
   if (status != ITEM_OK)
   {
     switch (status)
@@ -1392,14 +1597,14 @@ ItemStatus vtkPlusBuffer::GetInterpolatedStreamBufferItemFromTime(double time, S
   //============== Get item weights ==================
 
   double itemAtime(0);
-  if (this->StreamBuffer->GetTimeStamp(itemA.GetUid(), itemAtime) != ITEM_OK)
+  if (this->GetTimeStamp(itemA.GetUid(), itemAtime) != ITEM_OK)
   {
     LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get data buffer timestamp (time: " << std::fixed << time << ", uid: " << itemA.GetUid() << ")");
     return ITEM_UNKNOWN_ERROR;
   }
 
   double itemBtime(0);
-  if (this->StreamBuffer->GetTimeStamp(itemB.GetUid(), itemBtime) != ITEM_OK)
+  if (this->GetTimeStamp(itemB.GetUid(), itemBtime) != ITEM_OK)
   {
     LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get data buffer timestamp (time: " << std::fixed << time << ", uid: " << itemB.GetUid() << ")");
     return ITEM_UNKNOWN_ERROR;
@@ -1417,75 +1622,206 @@ ItemStatus vtkPlusBuffer::GetInterpolatedStreamBufferItemFromTime(double time, S
   double itemAweight = fabs(itemBtime - time) / fabs(itemAtime - itemBtime);
   double itemBweight = 1 - itemAweight;
 
-  //============== Get transform matrices ==================
+  //============== Interpolate pose ==================
+
+  double poseA[POSE_SIZE];
+  itemA.GetPose(poseA);
+  double poseB[POSE_SIZE];
+  itemB.GetPose(poseB);
+  double interpolatedPose[POSE_SIZE];
+  double angleDiffA(0);
+  double angleDiffB(0);
+  InterpolatePose(poseA, poseB, itemBweight, interpolatedPose, angleDiffA, angleDiffB);
 
-  vtkSmartPointer<vtkMatrix4x4> itemAmatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-  if (itemA.GetMatrix(itemAmatrix) != PLUS_SUCCESS)
+  vtkSmartPointer<vtkMatrix4x4> interpolatedMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  for (int i = 0; i < 3; i++)
   {
-    LOCAL_LOG_ERROR("Failed to get item A matrix");
-    return ITEM_UNKNOWN_ERROR;
+    for (int j = 0; j < 4; j++)
+    {
+      interpolatedMatrix->Element[i][j] = interpolatedPose[i * 4 + j];
+    }
   }
-  double matrixA[3][3] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
-  double xyzA[3] = {0, 0, 0};
-  for (int i = 0; i < 3; i++)
+
+  //============== Interpolate time ==================
+
+  double itemAunfilteredTimestamp = itemA.GetUnfilteredTimestamp(0.0);   // 0.0 because timestamps in the buffer are in local time
+  double itemBunfilteredTimestamp = itemB.GetUnfilteredTimestamp(0.0);   // 0.0 because timestamps in the buffer are in local time
+  double interpolatedUnfilteredTimestamp = itemAunfilteredTimestamp * itemAweight + itemBunfilteredTimestamp * itemBweight;
+
+  //============== Write interpolated results into the bufferItem ==================
+
+  bufferItem->DeepCopy(&itemA);
+  bufferItem->SetMatrix(interpolatedMatrix);
+  bufferItem->SetFilteredTimestamp(time - this->GetLocalTimeOffsetSec());   // global = local + offset => local = global - offset
+  bufferItem->SetUnfilteredTimestamp(interpolatedUnfilteredTimestamp);
+
+  if (fabs(angleDiffA) > ANGLE_INTERPOLATION_WARNING_THRESHOLD_DEG && fabs(angleDiffB) > ANGLE_INTERPOLATION_WARNING_THRESHOLD_DEG)
   {
-    matrixA[i][0] = itemAmatrix->GetElement(i, 0);
-    matrixA[i][1] = itemAmatrix->GetElement(i, 1);
-    matrixA[i][2] = itemAmatrix->GetElement(i, 2);
-    xyzA[i] = itemAmatrix->GetElement(i, 3);
+    static vtkIGSIOLogHelper helper(5.f, 5000, vtkPlusLogger::LOG_LEVEL_WARNING);
+    if (helper.ShouldWeLog(true))
+    {
+      LOCAL_LOG_WARNING("Angle difference between interpolated orientations is large (" << fabs(angleDiffA) << " and " << fabs(angleDiffB) << " deg, warning threshold is " << ANGLE_INTERPOLATION_WARNING_THRESHOLD_DEG << "), interpolation may be inaccurate. Consider moving the tools slower.");
+    }
   }
 
-  vtkSmartPointer<vtkMatrix4x4> itemBmatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-  if (itemB.GetMatrix(itemBmatrix) != PLUS_SUCCESS)
+  return ITEM_OK;
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusBuffer::GetPose(BufferItemUidType uid, double pose[POSE_SIZE], ToolStatus& status, double& timestamp)
+{
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+
+  if (this->StreamBuffer->GetNumberOfItems() < 1 || uid > this->StreamBuffer->GetLatestItemUidInBuffer())
   {
-    LOCAL_LOG_ERROR("Failed to get item B matrix");
-    return ITEM_UNKNOWN_ERROR;
+    return ITEM_NOT_AVAILABLE_YET;
   }
-  double matrixB[3][3] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
-  double xyzB[3] = {0, 0, 0};
-  for (int i = 0; i < 3; i++)
+  if (uid < this->StreamBuffer->GetOldestItemUidInBuffer())
   {
-    matrixB[i][0] = itemBmatrix->GetElement(i, 0);
-    matrixB[i][1] = itemBmatrix->GetElement(i, 1);
-    matrixB[i][2] = itemBmatrix->GetElement(i, 2);
-    xyzB[i] = itemBmatrix->GetElement(i, 3);
+    return ITEM_NOT_AVAILABLE_ANYMORE;
   }
 
-  //============== Interpolate rotation ==================
+  StreamBufferItem* dataItem = NULL;
+  ItemStatus itemStatus = this->StreamBuffer->GetBufferItemPointerFromUid(uid, dataItem);
+  if (itemStatus != ITEM_OK)
+  {
+    return itemStatus;
+  }
 
-  double matrixAquat[4] = {0, 0, 0, 0};
-  vtkMath::Matrix3x3ToQuaternion(matrixA, matrixAquat);
-  double matrixBquat[4] = {0, 0, 0, 0};
-  vtkMath::Matrix3x3ToQuaternion(matrixB, matrixBquat);
-  double interpolatedRotationQuat[4] = {0, 0, 0, 0};
-  igsioMath::Slerp(interpolatedRotationQuat, itemBweight, matrixAquat, matrixBquat);
-  double interpolatedRotation[3][3] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
-  vtkMath::QuaternionToMatrix3x3(interpolatedRotationQuat, interpolatedRotation);
+  dataItem->GetPose(pose);
+  status = dataItem->GetStatus();
+  timestamp = dataItem->GetFilteredTimestamp(this->StreamBuffer->GetLocalTimeOffsetSec());
+  return ITEM_OK;
+}
 
-  vtkSmartPointer<vtkMatrix4x4> interpolatedMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-  for (int i = 0; i < 3; i++)
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusBuffer::AddItemFrameFields(BufferItemUidType uid, igsioFieldMapType& fields)
+{
+  // the caller must have locked the buffer
+  StreamBufferItem* dataItem = NULL;
+  ItemStatus itemStatus = this->StreamBuffer->GetBufferItemPointerFromUid(uid, dataItem);
+  if (itemStatus != ITEM_OK)
+  {
+    return itemStatus;
+  }
+  if (dataItem->HasValidFieldData())
   {
-    interpolatedMatrix->Element[i][0] = interpolatedRotation[i][0];
-    interpolatedMatrix->Element[i][1] = interpolatedRotation[i][1];
-    interpolatedMatrix->Element[i][2] = interpolatedRotation[i][2];
-    interpolatedMatrix->Element[i][3] = xyzA[i] * itemAweight + xyzB[i] * itemBweight;
+    igsioFieldMapType itemFields = dataItem->GetFrameFieldMap();
+    for (igsioFieldMapType::const_iterator it = itemFields.begin(); it != itemFields.end(); ++it)
+    {
+      fields[it->first] = it->second;
+    }
   }
+  return ITEM_OK;
+}
 
-  //============== Interpolate time ==================
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusBuffer::GetInterpolatedPoseFromTime(double time, double pose[POSE_SIZE], ToolStatus& status, igsioFieldMapType* fields/*=NULL*/)
+{
+  // Same logic as GetPrevNextBufferItemFromTime and GetInterpolatedStreamBufferItemFromTime,
+  // but only the poses are retrieved and the buffer is locked only once.
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
 
-  double itemAunfilteredTimestamp = itemA.GetUnfilteredTimestamp(0.0);   // 0.0 because timestamps in the buffer are in local time
-  double itemBunfilteredTimestamp = itemB.GetUnfilteredTimestamp(0.0);   // 0.0 because timestamps in the buffer are in local time
-  double interpolatedUnfilteredTimestamp = itemAunfilteredTimestamp * itemAweight + itemBunfilteredTimestamp * itemBweight;
+  // itemA is the item that is the closest to the requested time
+  BufferItemUidType itemAuid(0);
+  ItemStatus itemStatus = this->GetItemUidFromTime(time, itemAuid);
+  if (itemStatus != ITEM_OK)
+  {
+    switch (itemStatus)
+    {
+      case ITEM_NOT_AVAILABLE_YET:
+        LOCAL_LOG_DEBUG("vtkPlusBuffer: Cannot get any item from the buffer for time: " << std::fixed << time << ". Item is not available yet.");
+        break;
+      case ITEM_NOT_AVAILABLE_ANYMORE:
+        LOCAL_LOG_DEBUG("vtkPlusBuffer: Cannot get any item from the buffer for time: " << std::fixed << time << ". Item is not available anymore.");
+        break;
+      default:
+        break;
+    }
+    return itemStatus;
+  }
 
-  //============== Write interpolated results into the bufferItem ==================
+  double itemAtime(0);
+  itemStatus = this->GetPose(itemAuid, pose, status, itemAtime);
+  if (itemStatus != ITEM_OK)
+  {
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get buffer item with Uid: " << itemAuid);
+    return itemStatus;
+  }
+  if (fields != NULL)
+  {
+    this->AddItemFrameFields(itemAuid, *fields);
+  }
 
-  bufferItem->DeepCopy(&itemA);
-  bufferItem->SetMatrix(interpolatedMatrix);
-  bufferItem->SetFilteredTimestamp(time - this->StreamBuffer->GetLocalTimeOffsetSec());   // global = local + offset => local = global - offset
-  bufferItem->SetUnfilteredTimestamp(interpolatedUnfilteredTimestamp);
+  // From here on, if interpolation is not possible then the closest item is returned as missing
+  if (status != TOOL_OK)
+  {
+    // tracker is out of view, ...
+    status = TOOL_MISSING;
+    return ITEM_OK;
+  }
+
+  // If the time difference is negligible then don't interpolate, just return the closest item
+  if (fabs(itemAtime - time) < NEGLIGIBLE_TIME_DIFFERENCE)
+  {
+    return ITEM_OK;
+  }
+
+  // If the closest item is too far, then we don't do interpolation
+  if (fabs(itemAtime - time) > this->GetMaxAllowedTimeDifference())
+  {
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Cannot perform interpolation, time difference compared to itemA is too big " << std::fixed << fabs(itemAtime - time) << " ( closest item time: " << itemAtime << ", requested time: " << time << ").");
+    status = TOOL_MISSING;
+    return ITEM_OK;
+  }
+
+  // Find the closest item on the other side of the timescale (so that time is between itemAtime and itemBtime)
+  BufferItemUidType itemBuid = (time < itemAtime ? itemAuid - 1 : itemAuid + 1);
+  if (itemBuid < this->GetOldestItemUidInBuffer() || itemBuid > this->GetLatestItemUidInBuffer())
+  {
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Cannot perform interpolation, itemB is not available " << std::fixed << " ( itemBuid: " << itemBuid << ", oldest UID: " << this->GetOldestItemUidInBuffer() << ", latest UID: " << this->GetLatestItemUidInBuffer());
+    status = TOOL_MISSING;
+    return ITEM_OK;
+  }
+
+  double poseB[POSE_SIZE];
+  ToolStatus itemBstatus(TOOL_UNKNOWN);
+  double itemBtime(0);
+  if (this->GetPose(itemBuid, poseB, itemBstatus, itemBtime) != ITEM_OK)
+  {
+    LOCAL_LOG_ERROR("Cannot do interpolation: Failed to get data buffer item with Uid: " << itemBuid);
+    status = TOOL_MISSING;
+    return ITEM_OK;
+  }
+
+  // If the next closest item is too far, then we don't do interpolation
+  if (fabs(itemBtime - time) > this->GetMaxAllowedTimeDifference())
+  {
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Cannot perform interpolation, time difference compared to itemB is too big " << std::fixed << fabs(itemBtime - time) << " ( itemBtime: " << itemBtime << ", requested time: " << time << ").");
+    status = TOOL_MISSING;
+    return ITEM_OK;
+  }
+
+  // If there is no valid element on the other side of the requested time, then we cannot do an interpolation
+  if (itemBstatus != TOOL_OK)
+  {
+    status = TOOL_MISSING;
+    return ITEM_OK;
+  }
+
+  if (fabs(itemAtime - itemBtime) < NEGLIGIBLE_TIME_DIFFERENCE)
+  {
+    // exact time match, no need for interpolation
+    return ITEM_OK;
+  }
+
+  double itemAweight = fabs(itemBtime - time) / fabs(itemAtime - itemBtime);
+  double poseA[POSE_SIZE];
+  std::copy(pose, pose + POSE_SIZE, poseA);
+  double angleDiffA(0);
+  double angleDiffB(0);
+  InterpolatePose(poseA, poseB, 1.0 - itemAweight, pose, angleDiffA, angleDiffB);
 
-  double angleDiffA = igsioMath::GetOrientationDifference(interpolatedMatrix, itemAmatrix);
-  double angleDiffB = igsioMath::GetOrientationDifference(interpolatedMatrix, itemBmatrix);
   if (fabs(angleDiffA) > ANGLE_INTERPOLATION_WARNING_THRESHOLD_DEG && fabs(angleDiffB) > ANGLE_INTERPOLATION_WARNING_THRESHOLD_DEG)
   {
     static vtkIGSIOLogHelper helper(5.f, 5000, vtkPlusLogger::LOG_LEVEL_WARNING);
@@ -18,6 +18,7 @@ See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
 #include "igsioCommon.h"
 #include "PlusConfigure.h"
 #include "vtkPlusDataCollectionExport.h"
+#include "PlusNewItemSignal.h"
 #include "PlusStreamBufferItem.h"
 #include "vtkPlusTimestampedCircularBuffer.h"
 
@@ -26,6 +27,11 @@ See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
 // VTK includes
 #include <vtkObject.h>
 
+// STL includes
+#include <memory>
+#include <mutex>
+#include <vector>
+
 class vtkPlusDevice;
 enum ToolStatus;
 
@@ -53,6 +59,9 @@ public:
   vtkTypeMacro(vtkPlusBuffer, vtkObject);
   virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
 
+  /*! Number of values stored for each pose (first 3 rows of the 4x4 transformation matrix, row-major) */
+  static const int POSE_SIZE = 12;
+
   /*!
     Set the size of the buffer, i.e. the maximum number of
     video frames that it will hold.  The default is 30.
@@ -149,7 +158,7 @@ public:
     If the timestamp is less than or equal to the previous timestamp, then nothing  will be done.
     If filteredTimestamp argument is undefined then the filtered timestamp will be computed from the input unfiltered timestamp.
   */
-  PlusStatus AddTimeStampedItem(vtkMatrix4x4* matrix, ToolStatus status, unsigned long frameNumber, double unfilteredTimestamp, double filteredTimestamp = UNDEFINED_TIMESTAMP, const igsioFieldMapType* customFields = NULL);
+  virtual PlusStatus AddTimeStampedItem(vtkMatrix4x4* matrix, ToolStatus status, unsigned long frameNumber, double unfilteredTimestamp, double filteredTimestamp = UNDEFINED_TIMESTAMP, const igsioFieldMapType* customFields = NULL);
 
   /*! Get a frame with the specified frame uid from the buffer */
   virtual ItemStatus GetStreamBufferItem(BufferItemUidType uid, StreamBufferItem* bufferItem);
@@ -163,8 +172,34 @@ public:
   {
     return this->GetStreamBufferItem(this->GetOldestItemUidInBuffer(), bufferItem);
   };
+  /*!
+    Get a frame with the specified frame uid from the buffer without copying the pixel data.
+    The video frame of bufferItem references the pixel storage of the buffer slot. If the slot is
+    reused while bufferItem still references it then the slot gets a new storage, so the content of
+    bufferItem is not changed. The pixel data of bufferItem must not be modified.
+  */
+  virtual ItemStatus GetStreamBufferItemView(BufferItemUidType uid, StreamBufferItem* bufferItem);
+  /*! Get the most recent frame from the buffer without copying the pixel data */
+  virtual ItemStatus GetLatestStreamBufferItemView(StreamBufferItem* bufferItem)
+  {
+    return this->GetStreamBufferItemView(this->GetLatestItemUidInBuffer(), bufferItem);
+  };
   /*! Get a frame that was acquired at the specified time from buffer */
   virtual ItemStatus GetStreamBufferItemFromTime(double time, StreamBufferItem* bufferItem, DataItemTemporalInterpolationType interpolation);
+
+  /*!
+    Get the pose of an item without creating a buffer item.
+    pose receives the first 3 rows of the transformation matrix (row-major), timestamp is in global time.
+  */
+  virtual ItemStatus GetPose(BufferItemUidType uid, double pose[POSE_SIZE], ToolStatus& status, double& timestamp);
+
+  /*!
+    Get the pose at the specified time, computed the same way as GetStreamBufferItemFromTime with INTERPOLATED
+    interpolation, but without copying buffer items or allocating matrices. The buffer is locked once for the whole query.
+    status is TOOL_MISSING if the pose could not be interpolated (then pose is the pose of the closest item).
+    If fields is not NULL then the custom fields of the closest item are added to it.
+  */
+  virtual ItemStatus GetInterpolatedPoseFromTime(double time, double pose[POSE_SIZE], ToolStatus& status, igsioFieldMapType* fields = NULL);
   virtual PlusStatus ModifyBufferItemFrameField(BufferItemUidType uid, const std::string& key, const std::string& value);
 
   /*! Get latest timestamp in the buffer */
@@ -192,7 +227,7 @@ public:
     Given a timestamp, compute the nearest buffer index
     This assumes that the times monotonically increase
   */
-  ItemStatus GetBufferIndexFromTime(const double time, int& bufferIndex);
+  virtual ItemStatus GetBufferIndexFromTime(const double time, int& bufferIndex);
 
   /*! Get buffer item unique ID */
   virtual BufferItemUidType GetOldestItemUidInBuffer()
@@ -271,6 +306,16 @@ public:
   /*! If TimeStampReporting is enabled then all filtered and unfiltered timestamp values will be saved in a table for diagnostic purposes. */
   bool GetTimeStampReporting();
 
+  /*! Name of the component that the acquisition stages of the items are reported with to PlusLatencyTracer */
+  void SetLatencyTracingComponent(const std::string& component);
+  /*! Name of the component that the acquisition stages of the items are reported with to PlusLatencyTracer */
+  std::string GetLatencyTracingComponent();
+
+  /*! If enabled then timestamp and UID queries do not lock the buffer (see vtkPlusTimestampedCircularBuffer::SetLockFreeTimestampQueries) */
+  virtual void SetLockFreeTimestampQueries(bool enable);
+  /*! If enabled then timestamp and UID queries do not lock the buffer (see vtkPlusTimestampedCircularBuffer::SetLockFreeTimestampQueries) */
+  bool GetLockFreeTimestampQueries();
+
   /*! Set the frame size in pixel  */
   PlusStatus SetFrameSize(unsigned int x, unsigned int y, unsigned int z, bool allocateFrames = true);
   /*! Set the frame size in pixel  */
@@ -317,6 +362,14 @@ public:
   vtkGetStringMacro(DescriptiveName);
   vtkSetStringMacro(DescriptiveName);
 
+  /*!
+    Notify the signal each time a new item is added to the buffer, so that consumers can wait for new data
+    instead of polling the buffer. Items that are copied from other buffers or files are not notified.
+  */
+  void AddNewItemSignal(std::shared_ptr<PlusNewItemSignal> signal);
+  /*! Stop notifying a signal that was added by AddNewItemSignal */
+  void RemoveNewItemSignal(std::shared_ptr<PlusNewItemSignal> signal);
+
 protected:
   vtkPlusBuffer();
   ~vtkPlusBuffer();
@@ -330,6 +383,15 @@ protected:
   */
   virtual bool CheckFrameFormat(const FrameSizeType& frameSizeInPx, igsioCommon::VTKScalarPixelType pixelType, US_IMAGE_TYPE imgType, int numberOfScalarComponents);
 
+  /*!
+    Copy the items of a buffer that stores the items in a different layout (e.g., vtkPlusTrackerBuffer) one by one.
+    Only transforms and custom fields are copied.
+  */
+  PlusStatus CopyItemsFrom(vtkPlusBuffer* buffer);
+
+  /*! Add the custom fields of an item to fields. The caller must have locked the buffer. */
+  virtual ItemStatus AddItemFrameFields(BufferItemUidType uid, igsioFieldMapType& fields);
+
   /*! Returns the two buffer items that are closest previous and next buffer items relative to the specified time. itemA is the closest item */
   PlusStatus GetPrevNextBufferItemFromTime(double time, StreamBufferItem& itemA, StreamBufferItem& itemB);
 
@@ -346,6 +408,9 @@ protected:
   /*! Get tracker buffer item from the closest timestamp */
   virtual ItemStatus GetStreamBufferItemFromClosestTime(double time, StreamBufferItem* bufferItem);
 
+  /*! Notify the new item signals, called after an item is added to the buffer */
+  void NotifyNewItemSignals();
+
 protected:
   /*! Image frame size in pixel */
   FrameSizeType FrameSize;
@@ -371,6 +436,10 @@ protected:
 
   char* DescriptiveName;
 
+  /*! Signals that are notified when a new item is added */
+  std::vector<std::shared_ptr<PlusNewItemSignal> > NewItemSignals;
+  std::mutex NewItemSignalsMutex;
+
 private:
   vtkPlusBuffer(const vtkPlusBuffer&);
   void operator=(const vtkPlusBuffer&);
@@ -6,6 +6,7 @@ See License.txt for details.
 
 // Local includes
 #include "PlusConfigure.h"
+#include "PlusLatencyTracer.h"
 #include "PlusPlotter.h"
 #include "vtkPlusBuffer.h"
 #include "vtkPlusChannel.h"
@@ -524,6 +525,83 @@ void vtkPlusChannel::SetVideoSource(vtkPlusDataSource* aSource)
   this->VideoSource = aSource;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChannel::GetToolTransformsFromTime(double timestamp, igsioTrackedFrame& trackedFrame)
+{
+  int numberOfErrors(0);
+
+  // A single matrix and field map is used for all the tools, the poses are copied directly from the buffers
+  vtkSmartPointer<vtkMatrix4x4> toolMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  igsioFieldMapType fieldMap;
+  double pose[vtkPlusBuffer::POSE_SIZE];
+
+  for (DataSourceContainerConstIterator it = this->GetToolsStartIterator(); it != this->GetToolsEndIterator(); ++it)
+  {
+    vtkPlusDataSource* aTool = it->second;
+    igsioTransformName toolTransformName(aTool->GetId());
+    if (!toolTransformName.IsValid())
+    {
+      LOG_ERROR("Tool transform name is invalid!");
+      numberOfErrors++;
+      continue;
+    }
+
+    ToolStatus toolStatus(TOOL_UNKNOWN);
+    fieldMap.clear();
+    ItemStatus result = aTool->GetInterpolatedPoseFromTime(timestamp, pose, toolStatus, &fieldMap);
+    if (result != ITEM_OK)
+    {
+      double latestTimestamp(0);
+      if (aTool->GetLatestTimeStamp(latestTimestamp) != ITEM_OK)
+      {
+        LOG_ERROR("Failed to get latest timestamp!");
+        numberOfErrors++;
+      }
+
+      double oldestTimestamp(0);
+      if (aTool->GetOldestTimeStamp(oldestTimestamp) != ITEM_OK)
+      {
+        LOG_ERROR("Failed to get oldest timestamp!");
+        numberOfErrors++;
+      }
+
+      LOG_ERROR(aTool->GetId() << ": Failed to get tracker item from buffer by time: " << std::fixed << timestamp << " (Latest timestamp: " << latestTimestamp << "   Oldest timestamp: " << oldestTimestamp << ").");
+      numberOfErrors++;
+      continue;
+    }
+
+    for (int row = 0; row < 3; ++row)
+    {
+      for (int column = 0; column < 4; ++column)
+      {
+        toolMatrix->Element[row][column] = pose[row * 4 + column];
+      }
+    }
+
+    if (trackedFrame.SetFrameTransform(toolTransformName, toolMatrix) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to set transform for tool " << aTool->GetId());
+      numberOfErrors++;
+      continue;
+    }
+
+    if (trackedFrame.SetFrameTransformStatus(toolTransformName, toolStatus) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to set transform status for tool " << aTool->GetId());
+      numberOfErrors++;
+      continue;
+    }
+
+    // Copy all custom fields
+    for (igsioFieldMapType::const_iterator fieldIterator = fieldMap.begin(); fieldIterator != fieldMap.end(); fieldIterator++)
+    {
+      trackedFrame.SetFrameField(fieldIterator->first, fieldIterator->second.second, fieldIterator->second.first);
+    }
+  }
+
+  return (numberOfErrors == 0 ? PLUS_SUCCESS : PLUS_FAIL);
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusChannel::GetTrackedFrame(double timestamp, igsioTrackedFrame& aTrackedFrame, bool enableImageData/*=true*/)
 {
@@ -560,16 +638,16 @@ PlusStatus vtkPlusChannel::GetTrackedFrame(double timestamp, igsioTrackedFrame&
       return PLUS_FAIL;
     }
 
+    // The pixel data is shared with the buffer, it is only copied once, into the tracked frame
     StreamBufferItem CurrentStreamBufferItem;
-    if (this->VideoSource->GetStreamBufferItem(frameUID, &CurrentStreamBufferItem) != ITEM_OK)
+    if (this->VideoSource->GetStreamBufferItemView(frameUID, &CurrentStreamBufferItem) != ITEM_OK)
     {
       LOG_ERROR("Couldn't get video buffer item by frame UID: " << frameUID);
       return PLUS_FAIL;
     }
 
     // Copy frame
-    igsioVideoFrame frame = CurrentStreamBufferItem.GetFrame();
-    aTrackedFrame.SetImageData(frame);
+    aTrackedFrame.SetImageData(CurrentStreamBufferItem.GetFrame());
 
     // Copy all custom fields
     igsioFieldMapType fieldMap = CurrentStreamBufferItem.GetFrameFieldMap();
@@ -589,71 +667,9 @@ PlusStatus vtkPlusChannel::GetTrackedFrame(double timestamp, igsioTrackedFrame&
   // Add main tool timestamp
   aTrackedFrame.SetTimestamp(synchronizedTimestamp);
 
-  for (DataSourceContainerConstIterator it = this->GetToolsStartIterator(); it != this->GetToolsEndIterator(); ++it)
+  if (this->GetToolTransformsFromTime(synchronizedTimestamp, aTrackedFrame) != PLUS_SUCCESS)
   {
-    vtkPlusDataSource* aTool = it->second;
-    igsioTransformName toolTransformName(aTool->GetId());
-    if (!toolTransformName.IsValid())
-    {
-      LOG_ERROR("Tool transform name is invalid!");
-      numberOfErrors++;
-      continue;
-    }
-
-    StreamBufferItem bufferItem;
-    ItemStatus result = aTool->GetStreamBufferItemFromTime(synchronizedTimestamp, &bufferItem, vtkPlusBuffer::INTERPOLATED);
-    if (result != ITEM_OK)
-    {
-      double latestTimestamp(0);
-      if (aTool->GetLatestTimeStamp(latestTimestamp) != ITEM_OK)
-      {
-        LOG_ERROR("Failed to get latest timestamp!");
-        numberOfErrors++;
-      }
-
-      double oldestTimestamp(0);
-      if (aTool->GetOldestTimeStamp(oldestTimestamp) != ITEM_OK)
-      {
-        LOG_ERROR("Failed to get oldest timestamp!");
-        numberOfErrors++;
-      }
-
-      LOG_ERROR(aTool->GetId() << ": Failed to get tracker item from buffer by time: " << std::fixed << synchronizedTimestamp << " (Latest timestamp: " << latestTimestamp << "   Oldest timestamp: " << oldestTimestamp << ").");
-      numberOfErrors++;
-      continue;
-    }
-
-    vtkSmartPointer<vtkMatrix4x4> dMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-    if (bufferItem.GetMatrix(dMatrix) != PLUS_SUCCESS)
-    {
-      LOG_ERROR("Failed to get matrix from buffer item for tool " << aTool->GetId());
-      numberOfErrors++;
-      continue;
-    }
-
-    if (aTrackedFrame.SetFrameTransform(toolTransformName, dMatrix) != PLUS_SUCCESS)
-    {
-      LOG_ERROR("Failed to set transform for tool " << aTool->GetId());
-      numberOfErrors++;
-      continue;
-    }
-
-    if (aTrackedFrame.SetFrameTransformStatus(toolTransformName, bufferItem.GetStatus()) != PLUS_SUCCESS)
-    {
-      LOG_ERROR("Failed to set transform status for tool " << aTool->GetId());
-      numberOfErrors++;
-      continue;
-    }
-
-    // Copy all custom fields
-    igsioFieldMapType fieldMap = bufferItem.GetFrameFieldMap();
-    igsioFieldMapType::iterator fieldIterator;
-    for (igsioFieldMapType::const_iterator fieldIterator = fieldMap.begin(); fieldIterator != fieldMap.end(); fieldIterator++)
-    {
-      aTrackedFrame.SetFrameField(fieldIterator->first, fieldIterator->second.second, fieldIterator->second.first);
-    }
-
-    synchronizedTimestamp = bufferItem.GetTimestamp(aTool->GetLocalTimeOffsetSec());
+    numberOfErrors++;
   }
 
   for (DataSourceContainerConstIterator it = this->GetFieldDataSourcesStartIterator(); it != this->GetFieldDataSourcesEndIterator(); ++it)
@@ -696,6 +712,11 @@ PlusStatus vtkPlusChannel::GetTrackedFrame(double timestamp, igsioTrackedFrame&
   // Copy frame timestamp
   aTrackedFrame.SetTimestamp(synchronizedTimestamp);
 
+  if (numberOfErrors == 0 && PlusLatencyTracer::GetInstance()->GetEnabled())
+  {
+    PlusLatencyTracer::GetInstance()->AddEvent(PlusLatencyTracer::STAGE_CHANNEL_READ, synchronizedTimestamp, this->ChannelId != NULL ? this->ChannelId : "");
+  }
+
   return (numberOfErrors == 0 ? PLUS_SUCCESS : PLUS_FAIL);
 }
 
@@ -1728,6 +1749,9 @@ vtkImageData* vtkPlusChannel::GetBrightnessOutput()
     return resultImage;
   }
 
+  // The frame is copied, because the returned image is kept by the caller. A view would keep the pixel storage of the
+  // buffer slot referenced, so the buffer would have to allocate new storage when the slot is overwritten. The copy
+  // reuses the pixel storage of the previous output if the frame size and type are unchanged.
   if (this->VideoSource->GetLatestStreamBufferItem(&this->BrightnessOutputTrackedFrame) != ITEM_OK)
   {
     LOG_DEBUG("No video data available yet, return blank frame");
@@ -1913,4 +1937,40 @@ bool vtkPlusChannel::IsVideoSource3D() const
   {
     return false;
   }
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusChannel::AddNewItemSignal(std::shared_ptr<PlusNewItemSignal> signal)
+{
+  if (this->HasVideoSource())
+  {
+    this->VideoSource->AddNewItemSignal(signal);
+    return;
+  }
+  for (DataSourceContainerIterator it = this->Tools.begin(); it != this->Tools.end(); ++it)
+  {
+    it->second->AddNewItemSignal(signal);
+  }
+  for (DataSourceContainerIterator it = this->FieldDataSources.begin(); it != this->FieldDataSources.end(); ++it)
+  {
+    it->second->AddNewItemSignal(signal);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusChannel::RemoveNewItemSignal(std::shared_ptr<PlusNewItemSignal> signal)
+{
+  // Remove from all buffers, the video source may have been changed since the signal was added
+  if (this->VideoSource != NULL)
+  {
+    this->VideoSource->RemoveNewItemSignal(signal);
+  }
+  for (DataSourceContainerIterator it = this->Tools.begin(); it != this->Tools.end(); ++it)
+  {
+    it->second->RemoveNewItemSignal(signal);
+  }
+  for (DataSourceContainerIterator it = this->FieldDataSources.begin(); it != this->FieldDataSources.end(); ++it)
+  {
+    it->second->RemoveNewItemSignal(signal);
+  }
 }
\ No newline at end of file
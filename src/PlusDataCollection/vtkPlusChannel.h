@@ -14,6 +14,10 @@
 #include "vtkDataObject.h"
 #include "vtkPlusRfProcessor.h"
 
+#include <memory>
+
+class PlusNewItemSignal;
+
 //class igsioTrackedFrame; 
 class vtkPlusHTMLGenerator;
 class vtkPlusDataSource;
@@ -112,6 +116,15 @@ public:
   virtual PlusStatus GetTrackedFrame(double timestamp, igsioTrackedFrame& trackedFrame, bool enableImageData = true);
   virtual PlusStatus GetTrackedFrame(igsioTrackedFrame& trackedFrame);
 
+  /*!
+    Set the transforms, transform statuses and custom fields of all the tools at a specific timestamp in a tracked frame.
+    The transforms are interpolated the same way as by vtkPlusBuffer::GetStreamBufferItemFromTime with INTERPOLATED
+    interpolation, but the poses are read directly from the buffers, without copying buffer items.
+    \param timestamp Timestamp of the requested transforms
+    \param trackedFrame Target tracked frame
+  */
+  virtual PlusStatus GetToolTransformsFromTime(double timestamp, igsioTrackedFrame& trackedFrame);
+
   /*!
     Get the tracked frame list from devices since time specified
     \param aTimestampOfLastFrameAlreadyGot Used for preventing returning the same frame multiple times. In: the timestamp of the timestamp that has been already returned in previous GetTrackedFrameListSampled calls. If no frames have got yet then set it to UNDEFINED_TIMESTAMP. Out: the timestamp of the most recent frame that is returned.
@@ -170,6 +183,16 @@ public:
   */
   virtual PlusStatus GenerateDataAcquisitionReport(vtkPlusHTMLGenerator* htmlReport);
 
+  /*!
+    Register a signal that is notified when a new item is added to the channel.
+    If the channel has a video source then only new video frames are signaled (tool poses are interpolated
+    at the frame timestamps anyway), otherwise new items in any of the tool or field data buffers.
+  */
+  void AddNewItemSignal(std::shared_ptr<PlusNewItemSignal> signal);
+
+  /*! Unregister a signal that was added by AddNewItemSignal */
+  void RemoveNewItemSignal(std::shared_ptr<PlusNewItemSignal> signal);
+
 protected:
   /*! Get number of tracked frames between two given timestamps (inclusive) */
   virtual int GetNumberOfFramesBetweenTimestamps(double aTimestampFrom, double aTimestampTo);
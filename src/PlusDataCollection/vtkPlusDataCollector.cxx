@@ -12,6 +12,7 @@ See License.txt for details.
 #include "vtkPlusDataSource.h"
 #include "vtkPlusDevice.h"
 #include "vtkPlusDeviceFactory.h"
+#include "vtkPlusReplayClock.h"
 #include "vtkPlusSavedDataSource.h"
 
 // vtkAddon includes
@@ -41,6 +42,7 @@ vtkPlusDataCollector::vtkPlusDataCollector()
   : vtkObject()
   , StartupDelaySec(0.0)
   , DeviceFactory(vtkSmartPointer<vtkPlusDeviceFactory>::New())
+  , ReplayClock(vtkSmartPointer<vtkPlusReplayClock>::New())
   , Connected(false)
   , Started(false)
 {
@@ -105,6 +107,12 @@ PlusStatus vtkPlusDataCollector::ReadConfiguration(vtkXMLDataElement* aConfig)
     LOG_DEBUG("StartupDelaySec: " << std::fixed << startupDelaySec);
   }
 
+  if (this->ReplayClock->ReadConfiguration(dataCollectionElement) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to read replay clock configuration");
+    return PLUS_FAIL;
+  }
+
   std::set<std::string> existingDeviceIds;
 
   for (int i = 0; i < dataCollectionElement->GetNumberOfNestedElements(); ++i)
@@ -282,7 +290,7 @@ PlusStatus vtkPlusDataCollector::WriteConfiguration(vtkXMLDataElement* aConfig)
 
   dataCollectionConfig->SetDoubleAttribute("StartupDelaySec", GetStartupDelaySec());
 
-  PlusStatus status = PLUS_SUCCESS;
+  PlusStatus status = this->ReplayClock->WriteConfiguration(dataCollectionConfig);
 
   for (DeviceCollectionConstIterator it = Devices.begin(); it != Devices.end(); ++it)
   {
@@ -322,6 +330,11 @@ PlusStatus vtkPlusDataCollector::Start()
 
   const double startTime = vtkIGSIOAccurateTimer::GetSystemTime();
 
+  // The clock must not advance until all the devices are started, otherwise in FREE_RUN mode
+  // it would not wait for the devices that are started later
+  this->ReplayClock->Pause();
+  this->ReplayClock->Start(startTime);
+
   for (DeviceCollectionIterator it = Devices.begin(); it != Devices.end(); ++ it)
   {
     vtkPlusDevice* device = *it;
@@ -334,6 +347,8 @@ PlusStatus vtkPlusDataCollector::Start()
     device->SetStartTime(startTime);
   }
 
+  this->ReplayClock->Resume();
+
   LOG_DEBUG("vtkPlusDataCollector::Start -- wait " << std::fixed << this->StartupDelaySec << " sec for buffer init...");
 
   vtkIGSIOAccurateTimer::DelayWithEventProcessing(this->StartupDelaySec);
@@ -423,6 +438,9 @@ void vtkPlusDataCollector::PrintSelf(ostream& os, vtkIndent indent)
     os << indent << "Device: " << std::endl;
     (*it)->PrintSelf(os, indent);
   }
+
+  os << indent << "ReplayClock: " << std::endl;
+  this->ReplayClock->PrintSelf(os, indent.GetNextIndent());
 }
 
 //----------------------------------------------------------------------------
@@ -619,7 +637,7 @@ PlusStatus vtkPlusDataCollector::GetVideoData(vtkPlusChannel* aRequestedChannel,
     // Get tracked frame from buffer
     igsioTrackedFrame* trackedFrame = new igsioTrackedFrame;
     StreamBufferItem currentStreamBufferItem;
-    if (aSource->GetStreamBufferItem(itemUid, &currentStreamBufferItem) != ITEM_OK)
+    if (aSource->GetStreamBufferItemView(itemUid, &currentStreamBufferItem) != ITEM_OK)
     {
       LOG_ERROR("Couldn't get video buffer item by frame UID: " << itemUid);
       delete trackedFrame;
@@ -711,6 +729,12 @@ PlusStatus vtkPlusDataCollector::SetLoopTimes()
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+vtkPlusReplayClock* vtkPlusDataCollector::GetReplayClock() const
+{
+  return this->ReplayClock;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusDataCollector::AddDevice(vtkPlusDevice* aDevice)
 {
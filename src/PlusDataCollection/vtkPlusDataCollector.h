@@ -18,6 +18,7 @@ See License.txt for details.
 //class igsioTrackedFrame; 
 class vtkPlusChannel;
 class vtkPlusDeviceFactory;
+class vtkPlusReplayClock;
 //class vtkIGSIOTrackedFrameList;
 class vtkXMLDataElement;
 
@@ -154,6 +155,9 @@ public:
   /*! Get startup delay in sec to give some time to the buffers for proper initialization */
   vtkGetMacro(StartupDelaySec, double);
 
+  /*! Get the clock that is shared by all the devices (allows replaying recorded data faster than real time) */
+  vtkPlusReplayClock* GetReplayClock() const;
+
 protected:
   vtkPlusDataCollector();
   virtual ~vtkPlusDataCollector();
@@ -163,6 +167,9 @@ protected:
 
   vtkSmartPointer<vtkPlusDeviceFactory> DeviceFactory;
 
+  /*! Clock shared by all the devices. Its time is the system time unless recorded data is replayed faster than real time. */
+  vtkSmartPointer<vtkPlusReplayClock> ReplayClock;
+
   DeviceCollection Devices;
 
   bool Connected;
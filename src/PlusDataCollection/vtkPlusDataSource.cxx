@@ -6,8 +6,10 @@ See License.txt for details.
 
 // Local includes
 #include "PlusConfigure.h"
+#include "PlusLatencyTracer.h"
 #include "vtkPlusBuffer.h"
 #include "vtkPlusDataSource.h"
+#include "vtkPlusTrackerBuffer.h"
 
 // VTK includes
 #include <vtkMatrix4x4.h>
@@ -207,6 +209,36 @@ PlusStatus vtkPlusDataSource::SetPortName(const std::string& portName)
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusDataSource::SetType(DataSourceType type)
+{
+  if (this->Type == type)
+  {
+    return;
+  }
+  this->Type = type;
+
+  // Tool sources only store poses, for them a buffer with compact pose storage is used
+  bool useTrackerBuffer = (type == DATA_SOURCE_TYPE_TOOL);
+  if (useTrackerBuffer != (vtkPlusTrackerBuffer::SafeDownCast(this->Buffer) != NULL))
+  {
+    vtkPlusBuffer* newBuffer = useTrackerBuffer ? vtkPlusTrackerBuffer::New() : vtkPlusBuffer::New();
+    newBuffer->SetDescriptiveName(this->Buffer->GetDescriptiveName());
+    newBuffer->SetAveragedItemsForFiltering(this->Buffer->GetAveragedItemsForFiltering());
+    newBuffer->SetStartTime(this->Buffer->GetStartTime());
+    newBuffer->SetTimeStampReporting(this->Buffer->GetTimeStampReporting());
+    newBuffer->SetLatencyTracingComponent(this->Buffer->GetLatencyTracingComponent());
+    newBuffer->SetLockFreeTimestampQueries(this->Buffer->GetLockFreeTimestampQueries());
+    newBuffer->SetMaxAllowedTimeDifference(this->Buffer->GetMaxAllowedTimeDifference());
+    // copies buffer size, local time offset and the items
+    newBuffer->DeepCopy(this->Buffer);
+    this->Buffer->Delete();
+    this->Buffer = newBuffer;
+  }
+
+  this->Modified();
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusDataSource::DeepCopy(const vtkPlusDataSource& aSource)
 {
@@ -401,6 +433,8 @@ PlusStatus vtkPlusDataSource::ReadConfiguration(vtkXMLDataElement* sourceElement
     LOG_DEBUG("AveragedItemsForFiltering is not defined in source element \"" << this->GetId() << "\". Using default value: " << this->GetBuffer()->GetAveragedItemsForFiltering());
   }
 
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(LockFreeTimestampQueries, sourceElement);
+
   std::string descName;
   if (!aDescriptiveNameForBuffer.empty())
   {
@@ -413,6 +447,7 @@ PlusStatus vtkPlusDataSource::ReadConfiguration(vtkXMLDataElement* sourceElement
     descName += this->GetId();
   }
   this->GetBuffer()->SetDescriptiveName(descName.c_str());
+  this->GetBuffer()->SetLatencyTracingComponent(descName);
 
   // Read custom properties
   for (int i = 0; i < sourceElement->GetNumberOfNestedElements(); ++i)
@@ -462,6 +497,11 @@ PlusStatus vtkPlusDataSource::WriteConfiguration(vtkXMLDataElement* aSourceEleme
     aSourceElement->SetIntAttribute("AveragedItemsForFiltering", this->GetBuffer()->GetAveragedItemsForFiltering());
   }
 
+  if (this->GetLockFreeTimestampQueries())
+  {
+    XML_WRITE_BOOL_ATTRIBUTE(LockFreeTimestampQueries, aSourceElement);
+  }
+
   // Write custom properties
   if (this->CustomProperties.size() > 0)
   {
@@ -548,20 +588,26 @@ void vtkPlusDataSource::SetCustomProperty(const std::string& propertyName, const
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusDataSource::AddItem(vtkImageData* frame, US_IMAGE_ORIENTATION usImageOrientation, US_IMAGE_TYPE imageType, long frameNumber, double unfilteredTimestamp/*=UNDEFINED_TIMESTAMP*/, double filteredTimestamp/*=UNDEFINED_TIMESTAMP*/, const igsioFieldMapType* customFields /*= NULL*/)
 {
-  return this->GetBuffer()->AddItem(frame, usImageOrientation, imageType, frameNumber, this->ClipRectangleOrigin, this->ClipRectangleSize, unfilteredTimestamp, filteredTimestamp, customFields);
+  PlusStatus status = this->GetBuffer()->AddItem(frame, usImageOrientation, imageType, frameNumber, this->ClipRectangleOrigin, this->ClipRectangleSize, unfilteredTimestamp, filteredTimestamp, customFields);
+  this->TraceProcessedItem(status, unfilteredTimestamp, filteredTimestamp);
+  return status;
 }
 
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusDataSource::AddItem(const igsioVideoFrame* frame, long frameNumber, double unfilteredTimestamp/*=UNDEFINED_TIMESTAMP*/, double filteredTimestamp/*=UNDEFINED_TIMESTAMP*/, const igsioFieldMapType* customFields /*= NULL*/)
 {
-  return this->GetBuffer()->AddItem(frame, frameNumber, this->ClipRectangleOrigin, this->ClipRectangleSize, unfilteredTimestamp, filteredTimestamp, customFields);
+  PlusStatus status = this->GetBuffer()->AddItem(frame, frameNumber, this->ClipRectangleOrigin, this->ClipRectangleSize, unfilteredTimestamp, filteredTimestamp, customFields);
+  this->TraceProcessedItem(status, unfilteredTimestamp, filteredTimestamp);
+  return status;
 }
 
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusDataSource::AddItem(const igsioFieldMapType& customFields, long frameNumber, double unfilteredTimestamp/*=UNDEFINED_TIMESTAMP*/,
                                       double filteredTimestamp/*=UNDEFINED_TIMESTAMP*/)
 {
-  return this->GetBuffer()->AddItem(customFields, frameNumber, unfilteredTimestamp, filteredTimestamp);
+  PlusStatus status = this->GetBuffer()->AddItem(customFields, frameNumber, unfilteredTimestamp, filteredTimestamp);
+  this->TraceProcessedItem(status, unfilteredTimestamp, filteredTimestamp);
+  return status;
 }
 
 //----------------------------------------------------------------------------
@@ -569,14 +615,18 @@ PlusStatus vtkPlusDataSource::AddItem(void* imageDataPtr, US_IMAGE_ORIENTATION u
                                       unsigned int numberOfScalarComponents, US_IMAGE_TYPE imageType, int numberOfBytesToSkip, long frameNumber, double unfilteredTimestamp /*= UNDEFINED_TIMESTAMP*/,
                                       double filteredTimestamp /*= UNDEFINED_TIMESTAMP*/, const igsioFieldMapType* customFields /*= NULL*/)
 {
-  return this->GetBuffer()->AddItem(imageDataPtr, usImageOrientation, frameSizeInPx, pixelType, numberOfScalarComponents, imageType, numberOfBytesToSkip, frameNumber,
-                                    this->ClipRectangleOrigin, this->ClipRectangleSize, unfilteredTimestamp, filteredTimestamp, customFields);
+  PlusStatus status = this->GetBuffer()->AddItem(imageDataPtr, usImageOrientation, frameSizeInPx, pixelType, numberOfScalarComponents, imageType, numberOfBytesToSkip, frameNumber,
+                      this->ClipRectangleOrigin, this->ClipRectangleSize, unfilteredTimestamp, filteredTimestamp, customFields);
+  this->TraceProcessedItem(status, unfilteredTimestamp, filteredTimestamp);
+  return status;
 }
 
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusDataSource::AddItem(void* imageDataPtr, const FrameSizeType& frameSize, unsigned int frameSizeInBytes, US_IMAGE_TYPE imageType, long frameNumber, double unfilteredTimestamp /*= UNDEFINED_TIMESTAMP*/, double filteredTimestamp /*= UNDEFINED_TIMESTAMP*/, const igsioFieldMapType* customFields /*= NULL*/)
 {
-  return this->GetBuffer()->AddItem(imageDataPtr, frameSize, frameSizeInBytes, imageType, frameNumber, unfilteredTimestamp, filteredTimestamp, customFields);
+  PlusStatus status = this->GetBuffer()->AddItem(imageDataPtr, frameSize, frameSizeInBytes, imageType, frameNumber, unfilteredTimestamp, filteredTimestamp, customFields);
+  this->TraceProcessedItem(status, unfilteredTimestamp, filteredTimestamp);
+  return status;
 }
 
 //-----------------------------------------------------------------------------
@@ -825,12 +875,30 @@ ItemStatus vtkPlusDataSource::GetOldestStreamBufferItem(StreamBufferItem* buffer
   return this->GetBuffer()->GetOldestStreamBufferItem(bufferItem);
 }
 
+//-----------------------------------------------------------------------------
+ItemStatus vtkPlusDataSource::GetStreamBufferItemView(BufferItemUidType uid, StreamBufferItem* bufferItem)
+{
+  return this->GetBuffer()->GetStreamBufferItemView(uid, bufferItem);
+}
+
+//-----------------------------------------------------------------------------
+ItemStatus vtkPlusDataSource::GetLatestStreamBufferItemView(StreamBufferItem* bufferItem)
+{
+  return this->GetBuffer()->GetLatestStreamBufferItemView(bufferItem);
+}
+
 //-----------------------------------------------------------------------------
 ItemStatus vtkPlusDataSource::GetStreamBufferItemFromTime(double time, StreamBufferItem* bufferItem, vtkPlusBuffer::DataItemTemporalInterpolationType interpolation)
 {
   return this->GetBuffer()->GetStreamBufferItemFromTime(time, bufferItem, interpolation);
 }
 
+//-----------------------------------------------------------------------------
+ItemStatus vtkPlusDataSource::GetInterpolatedPoseFromTime(double time, double pose[vtkPlusBuffer::POSE_SIZE], ToolStatus& status, igsioFieldMapType* fields/*=NULL*/)
+{
+  return this->GetBuffer()->GetInterpolatedPoseFromTime(time, pose, status, fields);
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusDataSource::ModifyBufferItemFrameField(BufferItemUidType uid, const std::string& key, const std::string& value)
 {
@@ -903,6 +971,30 @@ bool vtkPlusDataSource::GetTimeStampReporting()
   return this->GetBuffer()->GetTimeStampReporting();
 }
 
+//-----------------------------------------------------------------------------
+void vtkPlusDataSource::SetLockFreeTimestampQueries(bool enable)
+{
+  this->GetBuffer()->SetLockFreeTimestampQueries(enable);
+}
+
+//-----------------------------------------------------------------------------
+bool vtkPlusDataSource::GetLockFreeTimestampQueries()
+{
+  return this->GetBuffer()->GetLockFreeTimestampQueries();
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusDataSource::AddNewItemSignal(std::shared_ptr<PlusNewItemSignal> signal)
+{
+  this->GetBuffer()->AddNewItemSignal(signal);
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusDataSource::RemoveNewItemSignal(std::shared_ptr<PlusNewItemSignal> signal)
+{
+  this->GetBuffer()->RemoveNewItemSignal(signal);
+}
+
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusDataSource::WriteToSequenceFile(const char* filename, bool useCompression /*= false */)
 {
@@ -920,7 +1012,27 @@ PlusStatus vtkPlusDataSource::DeepCopyBufferTo(vtkPlusBuffer& bufferToFill)
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusDataSource::AddTimeStampedItem(vtkMatrix4x4* matrix, ToolStatus status, unsigned long frameNumber, double unfilteredTimestamp, double filteredTimestamp/*=UNDEFINED_TIMESTAMP*/, const igsioFieldMapType* customFields /*= NULL*/)
 {
-  return this->GetBuffer()->AddTimeStampedItem(matrix, status, frameNumber, unfilteredTimestamp, filteredTimestamp, customFields);
+  PlusStatus itemStatus = this->GetBuffer()->AddTimeStampedItem(matrix, status, frameNumber, unfilteredTimestamp, filteredTimestamp, customFields);
+  this->TraceProcessedItem(itemStatus, unfilteredTimestamp, filteredTimestamp);
+  return itemStatus;
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusDataSource::TraceProcessedItem(PlusStatus status, double unfilteredTimestamp, double filteredTimestamp)
+{
+  PlusLatencyTracer* latencyTracer = PlusLatencyTracer::GetInstance();
+  if (!latencyTracer->GetEnabled() || status != PLUS_SUCCESS || this->Device == NULL || !this->Device->IsVirtual())
+  {
+    return;
+  }
+  // Virtual devices add their output with the timestamp of the input data, so the latency includes the processing time
+  double itemTimestamp = (filteredTimestamp != UNDEFINED_TIMESTAMP ? filteredTimestamp : unfilteredTimestamp);
+  if (itemTimestamp == UNDEFINED_TIMESTAMP)
+  {
+    // the item is not associated with input data
+    return;
+  }
+  latencyTracer->AddEvent(PlusLatencyTracer::STAGE_PROCESSED, itemTimestamp, this->Device->GetDeviceId());
 }
 
 //-----------------------------------------------------------------------------
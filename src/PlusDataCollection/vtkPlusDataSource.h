@@ -138,8 +138,14 @@ public:
   virtual ItemStatus GetLatestStreamBufferItem(StreamBufferItem* bufferItem);
   /*! Get the oldest frame from buffer */
   virtual ItemStatus GetOldestStreamBufferItem(StreamBufferItem* bufferItem);
+  /*! Get a frame with the specified frame uid from the buffer without copying the pixel data (see vtkPlusBuffer::GetStreamBufferItemView) */
+  virtual ItemStatus GetStreamBufferItemView(BufferItemUidType uid, StreamBufferItem* bufferItem);
+  /*! Get the most recent frame from the buffer without copying the pixel data */
+  virtual ItemStatus GetLatestStreamBufferItemView(StreamBufferItem* bufferItem);
   /*! Get a frame that was acquired at the specified time from buffer */
   virtual ItemStatus GetStreamBufferItemFromTime(double time, StreamBufferItem* bufferItem, vtkPlusBuffer::DataItemTemporalInterpolationType interpolation);
+  /*! Get the interpolated pose at the specified time without creating buffer items (see vtkPlusBuffer::GetInterpolatedPoseFromTime) */
+  virtual ItemStatus GetInterpolatedPoseFromTime(double time, double pose[vtkPlusBuffer::POSE_SIZE], ToolStatus& status, igsioFieldMapType* fields = NULL);
   /*! Update a field in the specified stream buffer item */
   virtual PlusStatus ModifyBufferItemFrameField(BufferItemUidType uid, const std::string& key, const std::string& value);
 
@@ -160,6 +166,16 @@ public:
   /*! If TimeStampReporting is enabled then all filtered and unfiltered timestamp values will be saved in a table for diagnostic purposes. */
   bool GetTimeStampReporting();
 
+  /*! If enabled then timestamp and UID queries do not lock the buffer, so that readers never block the acquisition */
+  void SetLockFreeTimestampQueries(bool enable);
+  /*! If enabled then timestamp and UID queries do not lock the buffer, so that readers never block the acquisition */
+  bool GetLockFreeTimestampQueries();
+
+  /*! Register a signal that is notified when a new item is added to the buffer (see vtkPlusBuffer::AddNewItemSignal) */
+  void AddNewItemSignal(std::shared_ptr<PlusNewItemSignal> signal);
+  /*! Unregister a signal that was added by AddNewItemSignal */
+  void RemoveNewItemSignal(std::shared_ptr<PlusNewItemSignal> signal);
+
   /*!
     Set the size of the buffer, i.e. the maximum number of
     video frames that it will hold.  The default is 30.
@@ -310,7 +326,8 @@ public:
 
   /*! Get type: video or tool. */
   vtkGetMacroConst(Type, DataSourceType);
-  vtkSetMacro(Type, DataSourceType);
+  /*! Set type: video or tool. Tool sources store their items in a vtkPlusTrackerBuffer, other sources in a vtkPlusBuffer. */
+  virtual void SetType(DataSourceType type);
 
   /*! Get the frame number (some devices have frame numbering, otherwise just increment if new frame received) */
   vtkGetMacroConst(FrameNumber, unsigned long);
@@ -360,6 +377,9 @@ protected:
   /*! Access the data buffer */
   virtual vtkPlusBuffer* GetBuffer() const;
 
+  /*! Report the processed stage of an added item to PlusLatencyTracer if the item was added by a virtual device */
+  void TraceProcessedItem(PlusStatus status, double unfilteredTimestamp, double filteredTimestamp);
+
 protected:
   vtkPlusDataSource();
   ~vtkPlusDataSource();
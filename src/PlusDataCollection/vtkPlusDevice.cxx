@@ -8,11 +8,14 @@ See License.txt for details.
 #include "PlusConfigure.h"
 #include "vtkPlusBuffer.h"
 #include "vtkPlusChannel.h"
+#include "vtkPlusDataCollector.h"
 #include "vtkPlusDataSource.h"
 #include "vtkPlusDevice.h"
+#include "vtkPlusReplayClock.h"
 #include "vtkIGSIORecursiveCriticalSection.h"
 #include "vtkPlusSequenceIO.h"
 #include "vtkIGSIOTrackedFrameList.h"
+#include "PlusNewItemSignal.h"
 
 // VTK includes
 #include <vtkImageData.h>
@@ -114,6 +117,8 @@ vtkStandardNewMacro(vtkPlusDevice);
 
 const int vtkPlusDevice::VIRTUAL_DEVICE_FRAME_RATE = 50;
 static const int FRAME_RATE_AVERAGING = 10;
+/*! In FREE_RUN replay mode the update thread checks this often if the recording is stopped while waiting for the other devices */
+static const double REPLAY_STEP_WAIT_TIMEOUT_SEC = 0.1;
 const std::string vtkPlusDevice::BMODE_PORT_NAME = "B";
 const std::string vtkPlusDevice::RFMODE_PORT_NAME = "Rf";
 const std::string vtkPlusDevice::PARAMETERS_XML_ELEMENT_TAG = "Parameters";
@@ -139,6 +144,7 @@ vtkPlusDevice::vtkPlusDevice()
   , OutputNeedsInitialization(1)
   , CorrectlyConfigured(true)
   , StartThreadForInternalUpdates(false)
+  , UpdateOnNewInputData(false)
   , LocalTimeOffsetSec(0.0)
   , MissingInputGracePeriodSec(0.0)
   , RequireImageOrientationInConfiguration(false)
@@ -964,6 +970,8 @@ PlusStatus vtkPlusDevice::ReadConfiguration(vtkXMLDataElement* rootXMLElement)
     deviceXMLElement->GetScalarAttribute("MissingInputGracePeriodSec", this->MissingInputGracePeriodSec);
   }
 
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(UpdateOnNewInputData, deviceXMLElement);
+
   vtkXMLDataElement* dataSourcesElement = deviceXMLElement->FindNestedElementWithName("DataSources");
   if (dataSourcesElement != NULL)
   {
@@ -1300,9 +1308,28 @@ PlusStatus vtkPlusDevice::StartRecording()
 
   if (this->StartThreadForInternalUpdates)
   {
+    vtkPlusReplayClock* replayClock = this->GetReplayClock();
+    bool replayFreeRun = (replayClock != NULL && replayClock->GetMode() == vtkPlusReplayClock::FREE_RUN);
+    if (replayFreeRun)
+    {
+      // register before the thread is started, so that the clock does not advance without waiting for this device
+      replayClock->RegisterDevice(this);
+    }
     this->ThreadId =
       this->Threader->SpawnThread((vtkThreadFunctionType)\
                                   &vtkDataCaptureThread, this);
+    if (this->ThreadId < 0)
+    {
+      LOCAL_LOG_ERROR("Cannot start recording, failed to start the internal update thread");
+      if (replayFreeRun)
+      {
+        // the other devices must not wait for this device
+        replayClock->UnregisterDevice(this);
+      }
+      this->Recording = 0;
+      this->InternalStopRecording();
+      return PLUS_FAIL;
+    }
   }
 
   this->Modified();
@@ -1356,10 +1383,31 @@ void* vtkPlusDevice::vtkDataCaptureThread(vtkMultiThreader::ThreadInfo* data)
   vtkPlusDevice* self = (vtkPlusDevice*)(data->UserData);
 
   double rate = self->GetAcquisitionRate();
+  double updatePeriodSec = 1.0 / rate;
   double currtime[FRAME_RATE_AVERAGING] = {0};
   unsigned long updatecount = 0;
   self->ThreadAlive = true;
 
+  // Devices that process data of other devices are woken up when new input data arrives
+  std::shared_ptr<PlusNewItemSignal> newInputSignal;
+  if (self->UpdateOnNewInputData && !self->InputChannels.empty())
+  {
+    newInputSignal = std::make_shared<PlusNewItemSignal>();
+    for (ChannelContainerIterator it = self->InputChannels.begin(); it != self->InputChannels.end(); ++it)
+    {
+      (*it)->AddNewItemSignal(newInputSignal);
+    }
+  }
+
+  // When recorded data is replayed faster than real time then the devices are updated more frequently (SCALED)
+  // or in lock-step, each device waiting until all the others completed their update (FREE_RUN)
+  vtkPlusReplayClock* replayClock = self->GetReplayClock();
+  bool replayFreeRun = (replayClock != NULL && replayClock->GetMode() == vtkPlusReplayClock::FREE_RUN);
+  if (replayClock != NULL && replayClock->GetMode() == vtkPlusReplayClock::SCALED)
+  {
+    updatePeriodSec /= replayClock->GetSpeedFactor();
+  }
+
   while (self->IsRecording() && self->GetCorrectlyConfigured())
   {
     double newtime = vtkIGSIOAccurateTimer::GetSystemTime();
@@ -1383,15 +1431,43 @@ void* vtkPlusDevice::vtkDataCaptureThread(vtkMultiThreader::ThreadInfo* data)
       self->UpdateTime.Modified();
     }
 
-    double delay = (newtime + 1.0 / rate - vtkIGSIOAccurateTimer::GetSystemTime());
+    if (replayFreeRun)
+    {
+      replayClock->WaitForNextStep(self, REPLAY_STEP_WAIT_TIMEOUT_SEC);
+      updatecount++;
+      continue;
+    }
+
+    double delay = (newtime + updatePeriodSec - vtkIGSIOAccurateTimer::GetSystemTime());
     if (delay > 0)
     {
-      vtkIGSIOAccurateTimer::Delay(delay);
+      if (newInputSignal)
+      {
+        newInputSignal->Wait(delay);
+      }
+      else
+      {
+        vtkIGSIOAccurateTimer::Delay(delay);
+      }
     }
 
     updatecount++;
   }
 
+  if (newInputSignal)
+  {
+    for (ChannelContainerIterator it = self->InputChannels.begin(); it != self->InputChannels.end(); ++it)
+    {
+      (*it)->RemoveNewItemSignal(newInputSignal);
+    }
+  }
+
+  if (replayFreeRun)
+  {
+    // the other devices must not wait for this device anymore
+    replayClock->UnregisterDevice(self);
+  }
+
   self->ThreadAlive = false;
   return NULL;
 }
@@ -2116,6 +2192,32 @@ vtkPlusDataCollector* vtkPlusDevice::GetDataCollector()
   return this->DataCollector;
 }
 
+//----------------------------------------------------------------------------
+vtkPlusReplayClock* vtkPlusDevice::GetReplayClock() const
+{
+  if (this->DataCollector == NULL)
+  {
+    return NULL;
+  }
+  vtkPlusReplayClock* replayClock = this->DataCollector->GetReplayClock();
+  if (replayClock == NULL || replayClock->GetMode() == vtkPlusReplayClock::REAL_TIME)
+  {
+    return NULL;
+  }
+  return replayClock;
+}
+
+//----------------------------------------------------------------------------
+double vtkPlusDevice::GetClockTime() const
+{
+  vtkPlusReplayClock* replayClock = this->GetReplayClock();
+  if (replayClock == NULL)
+  {
+    return vtkIGSIOAccurateTimer::GetSystemTime();
+  }
+  return replayClock->GetTime();
+}
+
 //----------------------------------------------------------------------------
 DataSourceContainerConstIterator vtkPlusDevice::GetVideoSourceIteratorBegin() const
 {
@@ -29,6 +29,7 @@ class vtkPlusDataCollector;
 class vtkPlusDataSource;
 class vtkPlusDevice;
 class vtkPlusHTMLGenerator;
+class vtkPlusReplayClock;
 class vtkXMLDataElement;
 
 typedef std::vector<vtkPlusChannel*> ChannelContainer;
@@ -243,6 +244,12 @@ public:
   /*! Set the parent data collector */
   virtual void SetDataCollector(vtkPlusDataCollector* _arg);
 
+  /*! Get the replay clock of the parent data collector if recorded data is replayed faster than real time, NULL if the devices run in real time */
+  vtkPlusReplayClock* GetReplayClock() const;
+
+  /*! Current time: the system time, or the replay clock time if recorded data is replayed faster than real time */
+  double GetClockTime() const;
+
   /*! Set buffer size of all available tools */
   void SetToolsBufferSize(int aBufferSize);
 
@@ -415,6 +422,17 @@ public:
   vtkSetMacro(MissingInputGracePeriodSec, double);
   double GetMissingInputGracePeriodSec() const;
 
+  /*!
+    If enabled, the internal update thread of a device with input channels is woken up as soon as new data arrives
+    in any of its input channels, instead of only polling them at the acquisition rate.
+    The acquisition rate is then only used as the deadline for the next update if no new data arrives, so the device
+    is updated as often as its inputs receive data (which may be much more frequent than the acquisition rate, e.g., for
+    a device with a tracker input). Disabled by default.
+  */
+  vtkSetMacro(UpdateOnNewInputData, bool);
+  vtkGetMacro(UpdateOnNewInputData, bool);
+  vtkBooleanMacro(UpdateOnNewInputData, bool);
+
   /*!
     Creates a default output channel for the device with the name channelId or "OutputChannel".
     \param addSource If true then for imaging devices a default 'Video' source is added to the output.
@@ -585,6 +603,9 @@ protected:
   */
   bool StartThreadForInternalUpdates;
 
+  /*! Wake up the internal update thread when new data arrives in any of the input channels */
+  bool UpdateOnNewInputData;
+
   /*! Value to use when mixing data with another temporally calibrated device*/
   double LocalTimeOffsetSec;
 
@@ -18,6 +18,7 @@ See License.txt for details.
 #include "vtkPlusVirtualSwitcher.h"
 #include "vtkPlusVirtualCapture.h"
 #include "vtkPlusVirtualVolumeReconstructor.h"
+#include "vtkPlusVirtualTemporalCalibration.h"
 #include "vtkPlusImageProcessorVideoSource.h"
 #include "vtkPlusGenericSerialDevice.h"
 #ifdef PLUS_USE_TextRecognizer
@@ -384,6 +385,7 @@ vtkPlusDeviceFactory::vtkPlusDeviceFactory()
   RegisterDevice("VirtualDiscCapture", "vtkPlusVirtualCapture", (PointerToDevice)&vtkPlusVirtualCapture::New); // for backward compatibility
   RegisterDevice("VirtualBufferedCapture", "vtkPlusVirtualCapture", (PointerToDevice)&vtkPlusVirtualCapture::New); // for backward compatibility
   RegisterDevice("VirtualVolumeReconstructor", "vtkPlusVirtualVolumeReconstructor", (PointerToDevice)&vtkPlusVirtualVolumeReconstructor::New);
+  RegisterDevice("VirtualTemporalCalibration", "vtkPlusVirtualTemporalCalibration", (PointerToDevice)&vtkPlusVirtualTemporalCalibration::New);
 }
 
 //----------------------------------------------------------------------------
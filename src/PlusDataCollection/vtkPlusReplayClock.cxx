@@ -0,0 +1,285 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkPlusReplayClock.h"
+
+// IGSIO includes
+#include <vtkIGSIOAccurateTimer.h>
+
+// VTK includes
+#include <vtkObjectFactory.h>
+#include <vtkXMLDataElement.h>
+
+// STL includes
+#include <chrono>
+
+//----------------------------------------------------------------------------
+
+vtkStandardNewMacro(vtkPlusReplayClock);
+
+//----------------------------------------------------------------------------
+vtkPlusReplayClock::vtkPlusReplayClock()
+  : Mode(REAL_TIME)
+  , SpeedFactor(1.0)
+  , StepSec(0.01)
+  , StartTime(vtkIGSIOAccurateTimer::GetSystemTime())
+  , FreeRunTime(StartTime)
+  , StepIndex(0)
+  , Paused(false)
+  , PauseSystemTime(StartTime)
+  , ScaledPauseOffsetSec(0.0)
+{
+}
+
+//----------------------------------------------------------------------------
+vtkPlusReplayClock::~vtkPlusReplayClock()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusReplayClock::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Mode: " << GetClockModeAsString(this->Mode) << std::endl;
+  os << indent << "SpeedFactor: " << this->SpeedFactor << std::endl;
+  os << indent << "StepSec: " << this->StepSec << std::endl;
+  os << indent << "StartTime: " << std::fixed << this->GetStartTime() << std::endl;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusReplayClock::ReadConfiguration(vtkXMLDataElement* dataCollectionElement)
+{
+  if (dataCollectionElement == NULL)
+  {
+    LOG_ERROR("Unable to read replay clock configuration");
+    return PLUS_FAIL;
+  }
+
+  const char* modeStr = dataCollectionElement->GetAttribute("ReplayClock");
+  if (modeStr != NULL)
+  {
+    if (STRCASECMP(modeStr, GetClockModeAsString(REAL_TIME).c_str()) == 0)
+    {
+      this->SetMode(REAL_TIME);
+    }
+    else if (STRCASECMP(modeStr, GetClockModeAsString(SCALED).c_str()) == 0)
+    {
+      this->SetMode(SCALED);
+    }
+    else if (STRCASECMP(modeStr, GetClockModeAsString(FREE_RUN).c_str()) == 0)
+    {
+      this->SetMode(FREE_RUN);
+    }
+    else
+    {
+      LOG_ERROR("Invalid ReplayClock attribute value: " << modeStr << ". Valid values: REAL_TIME, SCALED, FREE_RUN");
+      return PLUS_FAIL;
+    }
+  }
+
+  double speedFactor = 1.0;
+  if (dataCollectionElement->GetScalarAttribute("ReplaySpeedFactor", speedFactor))
+  {
+    if (speedFactor <= 0)
+    {
+      LOG_ERROR("ReplaySpeedFactor must be positive (" << speedFactor << ")");
+      return PLUS_FAIL;
+    }
+    this->SetSpeedFactor(speedFactor);
+  }
+
+  double stepSec = 0.01;
+  if (dataCollectionElement->GetScalarAttribute("ReplayStepSec", stepSec))
+  {
+    if (stepSec <= 0)
+    {
+      LOG_ERROR("ReplayStepSec must be positive (" << stepSec << ")");
+      return PLUS_FAIL;
+    }
+    this->SetStepSec(stepSec);
+  }
+
+  if (this->Mode != REAL_TIME)
+  {
+    LOG_INFO("Replay clock: " << GetClockModeAsString(this->Mode)
+             << (this->Mode == SCALED ? ", speed factor: " : ", step: ") << (this->Mode == SCALED ? this->SpeedFactor : this->StepSec));
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusReplayClock::WriteConfiguration(vtkXMLDataElement* dataCollectionElement)
+{
+  if (dataCollectionElement == NULL)
+  {
+    LOG_ERROR("Unable to write replay clock configuration");
+    return PLUS_FAIL;
+  }
+
+  if (this->Mode == REAL_TIME)
+  {
+    // default, don't clutter the configuration
+    dataCollectionElement->RemoveAttribute("ReplayClock");
+    return PLUS_SUCCESS;
+  }
+
+  dataCollectionElement->SetAttribute("ReplayClock", GetClockModeAsString(this->Mode).c_str());
+  if (this->Mode == SCALED)
+  {
+    dataCollectionElement->SetDoubleAttribute("ReplaySpeedFactor", this->SpeedFactor);
+  }
+  else
+  {
+    dataCollectionElement->SetDoubleAttribute("ReplayStepSec", this->StepSec);
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkPlusReplayClock::GetClockModeAsString(ClockMode mode)
+{
+  switch (mode)
+  {
+    case REAL_TIME:
+      return "REAL_TIME";
+    case SCALED:
+      return "SCALED";
+    case FREE_RUN:
+      return "FREE_RUN";
+    default:
+      return "UNKNOWN";
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusReplayClock::Start(double startTime)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->StartTime = startTime;
+  this->FreeRunTime = startTime;
+  this->ScaledPauseOffsetSec = 0.0;
+  if (this->Paused)
+  {
+    // the clock is started paused, it will be at startTime when resumed
+    this->PauseSystemTime = startTime;
+  }
+  this->UpdatedDevices.clear();
+}
+
+//----------------------------------------------------------------------------
+double vtkPlusReplayClock::GetTime()
+{
+  switch (this->Mode)
+  {
+    case SCALED:
+      {
+        std::lock_guard<std::mutex> lock(this->Mutex);
+        return this->GetScaledTime();
+      }
+    case FREE_RUN:
+      {
+        std::lock_guard<std::mutex> lock(this->Mutex);
+        return this->FreeRunTime;
+      }
+    default:
+      return vtkIGSIOAccurateTimer::GetSystemTime();
+  }
+}
+
+//----------------------------------------------------------------------------
+double vtkPlusReplayClock::GetStartTime() const
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  return this->StartTime;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusReplayClock::Pause()
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  if (this->Paused)
+  {
+    return;
+  }
+  this->Paused = true;
+  this->PauseSystemTime = vtkIGSIOAccurateTimer::GetSystemTime();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusReplayClock::Resume()
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  if (!this->Paused)
+  {
+    return;
+  }
+  this->Paused = false;
+  this->ScaledPauseOffsetSec += vtkIGSIOAccurateTimer::GetSystemTime() - this->PauseSystemTime;
+  // the devices may have completed their update while the clock was paused
+  this->AdvanceIfAllDevicesUpdated();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusReplayClock::RegisterDevice(vtkPlusDevice* device)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->RegisteredDevices.insert(device);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusReplayClock::UnregisterDevice(vtkPlusDevice* device)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->RegisteredDevices.erase(device);
+  this->UpdatedDevices.erase(device);
+  // the clock may have been waiting only for this device
+  this->AdvanceIfAllDevicesUpdated();
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusReplayClock::WaitForNextStep(vtkPlusDevice* device, double timeoutSec)
+{
+  std::unique_lock<std::mutex> lock(this->Mutex);
+  if (this->RegisteredDevices.count(device) == 0)
+  {
+    LOG_ERROR("Device is not registered in the replay clock, it cannot be updated in lock-step");
+    return false;
+  }
+
+  this->UpdatedDevices.insert(device);
+  if (this->AdvanceIfAllDevicesUpdated())
+  {
+    return true;
+  }
+
+  unsigned long stepIndex = this->StepIndex;
+  return this->StepAdvanced.wait_for(lock, std::chrono::duration<double>(timeoutSec), [this, stepIndex] { return this->StepIndex != stepIndex; });
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusReplayClock::AdvanceIfAllDevicesUpdated()
+{
+  if (this->Paused || this->RegisteredDevices.empty() || this->UpdatedDevices.size() < this->RegisteredDevices.size())
+  {
+    return false;
+  }
+  this->FreeRunTime += this->StepSec;
+  this->StepIndex++;
+  this->UpdatedDevices.clear();
+  this->StepAdvanced.notify_all();
+  return true;
+}
+
+//----------------------------------------------------------------------------
+double vtkPlusReplayClock::GetScaledTime() const
+{
+  double systemTime = this->Paused ? this->PauseSystemTime : vtkIGSIOAccurateTimer::GetSystemTime();
+  return this->StartTime + (systemTime - this->StartTime - this->ScaledPauseOffsetSec) * this->SpeedFactor;
+}
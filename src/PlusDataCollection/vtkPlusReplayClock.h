@@ -0,0 +1,155 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusReplayClock_h
+#define __vtkPlusReplayClock_h
+
+// Local includes
+#include "igsioCommon.h"
+#include "vtkPlusDataCollectionExport.h"
+
+// VTK includes
+#include <vtkObject.h>
+
+// STL includes
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <string>
+
+class vtkPlusDevice;
+class vtkXMLDataElement;
+
+/*!
+  \class vtkPlusReplayClock
+  \brief Clock that is shared by all the devices of a data collector, allows replaying recorded data faster than real time
+
+  By default the clock time is the system time. When recorded data is replayed (see vtkPlusSavedDataSource) the clock
+  can run faster than the system time:
+  - SCALED: the clock time passes SpeedFactor times faster than the system time, and the devices are updated
+    SpeedFactor times more frequently.
+  - FREE_RUN: the devices are updated in lock-step: the clock time is increased by StepSec when all the devices
+    have completed an update at the current clock time. Therefore the data is replayed as fast as the slowest device
+    (e.g., a processing device or a virtual capture device) can process it, and the result does not depend on the speed
+    of the computer.
+
+  Saved data sources timestamp the replayed frames with the clock time, so timestamp-based synchronization of the devices
+  works the same way as in real-time replay. The clock is only meaningful when all the data sources are saved data sources.
+
+  \ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport vtkPlusReplayClock : public vtkObject
+{
+public:
+  static vtkPlusReplayClock* New();
+  vtkTypeMacro(vtkPlusReplayClock, vtkObject);
+  virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
+
+  enum ClockMode
+  {
+    REAL_TIME, /*!< The clock time is the system time */
+    SCALED,    /*!< The clock time passes SpeedFactor times faster than the system time */
+    FREE_RUN   /*!< The clock time is increased by StepSec when all the devices completed their update */
+  };
+
+  /*! Read the clock attributes (ReplayClock, ReplaySpeedFactor, ReplayStepSec) from the DataCollection element */
+  PlusStatus ReadConfiguration(vtkXMLDataElement* dataCollectionElement);
+
+  /*! Write the clock attributes to the DataCollection element */
+  PlusStatus WriteConfiguration(vtkXMLDataElement* dataCollectionElement);
+
+  /*! Set the clock time to startTime (system time) and forget the devices that completed an update in the current step */
+  void Start(double startTime);
+
+  /*! Current clock time, in the same time reference as the system time */
+  double GetTime();
+
+  /*! Clock time when the clock was started */
+  double GetStartTime() const;
+
+  /*!
+    Don't advance the clock until Resume() is called (used while the devices are being started).
+    In SCALED mode the clock time is frozen, the system time that passes while paused is not added to the clock time.
+  */
+  void Pause();
+
+  /*! Allow the clock to advance again */
+  void Resume();
+
+  /*! Add a device to the devices that are updated in lock-step in FREE_RUN mode */
+  void RegisterDevice(vtkPlusDevice* device);
+
+  /*! Remove a device from the devices that are updated in lock-step. The clock advances if all the remaining devices have been updated already. */
+  void UnregisterDevice(vtkPlusDevice* device);
+
+  /*!
+    Called by the update thread of the device after it completed an update in FREE_RUN mode.
+    Advances the clock if this was the last registered device that has not been updated at the current clock time yet,
+    otherwise waits until the clock advances or the timeout expires.
+    \return true if the clock advanced, false if the timeout expired
+  */
+  bool WaitForNextStep(vtkPlusDevice* device, double timeoutSec);
+
+  static std::string GetClockModeAsString(ClockMode mode);
+
+  vtkGetMacro(Mode, ClockMode);
+  vtkSetMacro(Mode, ClockMode);
+
+  /*! Ratio of the clock time and the system time in SCALED mode */
+  vtkGetMacro(SpeedFactor, double);
+  vtkSetMacro(SpeedFactor, double);
+
+  /*! Increment of the clock time in FREE_RUN mode */
+  vtkGetMacro(StepSec, double);
+  vtkSetMacro(StepSec, double);
+
+protected:
+  vtkPlusReplayClock();
+  virtual ~vtkPlusReplayClock();
+
+  /*! Advance the clock if all the registered devices completed their update. Mutex must be locked by the caller. */
+  bool AdvanceIfAllDevicesUpdated();
+
+  /*! Clock time in SCALED mode. Mutex must be locked by the caller. */
+  double GetScaledTime() const;
+
+  ClockMode Mode;
+  double SpeedFactor;
+  double StepSec;
+
+  double StartTime;
+
+  /*! Clock time in FREE_RUN mode */
+  double FreeRunTime;
+
+  /*! Number of times the clock advanced in FREE_RUN mode */
+  unsigned long StepIndex;
+
+  /*! The clock does not advance while paused */
+  bool Paused;
+
+  /*! System time when the clock was paused, the SCALED clock time is frozen at this time while paused */
+  double PauseSystemTime;
+
+  /*! System time spent paused since the clock was started, it is not added to the SCALED clock time */
+  double ScaledPauseOffsetSec;
+
+  /*! Devices that are updated in lock-step in FREE_RUN mode */
+  std::set<vtkPlusDevice*> RegisteredDevices;
+
+  /*! Registered devices that completed an update at the current clock time */
+  std::set<vtkPlusDevice*> UpdatedDevices;
+
+  /*! Protects StartTime, FreeRunTime, StepIndex, the pause state, and the device sets */
+  mutable std::mutex Mutex;
+  std::condition_variable StepAdvanced;
+
+private:
+  vtkPlusReplayClock(const vtkPlusReplayClock&);
+  void operator=(const vtkPlusReplayClock&);
+};
+
+#endif
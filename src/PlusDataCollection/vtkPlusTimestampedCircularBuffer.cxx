@@ -5,6 +5,8 @@ See License.txt for details.
 =========================================================Plus=header=end*/
 
 #include "PlusConfigure.h"
+#include "PlusLatencyTracer.h"
+#include "PlusTimestampPublisher.h"
 #include "vtkPlusTimestampedCircularBuffer.h"
 
 #include "vtkDoubleArray.h"
@@ -17,6 +19,7 @@ vtkStandardNewMacro(vtkPlusTimestampedCircularBuffer);
 //----------------------------------------------------------------------------
 vtkPlusTimestampedCircularBuffer::vtkPlusTimestampedCircularBuffer()
   : Mutex(vtkIGSIORecursiveCriticalSection::New())
+  , FilterMutex(vtkIGSIORecursiveCriticalSection::New())
   , NumberOfItems(0)
   , WritePointer(0)
   , CurrentTimeStamp(0.0)
@@ -29,6 +32,8 @@ vtkPlusTimestampedCircularBuffer::vtkPlusTimestampedCircularBuffer()
   , TimeStampLogging(false)
   , StartTime(0)
   , NegligibleTimeDifferenceSec(1e-5)
+  , LockFreeTimestampQueries(false)
+  , TimestampPublisher(new PlusTimestampPublisher)
 {
   this->BufferItemContainer.resize(0);
   this->FilterContainerIndexVector.set_size(0);
@@ -49,6 +54,15 @@ vtkPlusTimestampedCircularBuffer::~vtkPlusTimestampedCircularBuffer()
     this->Mutex = NULL;
   }
 
+  if (this->FilterMutex != NULL)
+  {
+    this->FilterMutex->Delete();
+    this->FilterMutex = NULL;
+  }
+
+  delete this->TimestampPublisher;
+  this->TimestampPublisher = NULL;
+
   if (this->TimeStampReportTable != NULL)
   {
     this->TimeStampReportTable->Delete();
@@ -65,8 +79,39 @@ void vtkPlusTimestampedCircularBuffer::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "BufferSize: " << this->GetBufferSize() << "\n";
   os << indent << "NumberOfItems: " << this->NumberOfItems << "\n";
   os << indent << "CurrentTimeStamp: " << this->CurrentTimeStamp << "\n";
-  os << indent << "Local time offset: " << this->LocalTimeOffsetSec << "\n";
+  os << indent << "Local time offset: " << this->GetLocalTimeOffsetSec() << "\n";
   os << indent << "Latest Item Uid: " << this->LatestItemUid << "\n";
+  os << indent << "Lock-free timestamp queries: " << (this->LockFreeTimestampQueries ? "enabled" : "disabled") << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::SetLockFreeTimestampQueries(bool enable)
+{
+  igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
+  if (this->LockFreeTimestampQueries == enable)
+  {
+    return;
+  }
+  this->LockFreeTimestampQueries = enable;
+  this->RebuildPublishedItems();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::RebuildPublishedItems()
+{
+  // the caller must have locked the buffer
+  this->TimestampPublisher->Rebuild(this->LockFreeTimestampQueries, this->GetBufferSize(), this->LatestItemUid, this->NumberOfItems,
+                                    [this](BufferItemUidType uid, double & filteredTimestamp)
+  {
+    StreamBufferItem* itemPtr = NULL;
+    if (this->GetBufferItemPointerFromUid(uid, itemPtr) != ITEM_OK)
+    {
+      return false;
+    }
+    filteredTimestamp = itemPtr->GetFilteredTimestamp(0.0);
+    return true;
+  });
 }
 
 //----------------------------------------------------------------------------
@@ -96,6 +141,8 @@ PlusStatus vtkPlusTimestampedCircularBuffer::PrepareForNewItem(const double time
     this->WritePointer = 0;
   }
 
+  this->TimestampPublisher->Publish(newFrameUid, timestamp, this->LatestItemUid - (this->NumberOfItems - 1));
+
   return PLUS_SUCCESS;
 }
 
@@ -161,6 +208,8 @@ PlusStatus vtkPlusTimestampedCircularBuffer::SetBufferSize(int newBufferSize)
     this->NumberOfItems = this->GetBufferSize();
   }
 
+  this->RebuildPublishedItems();
+
   this->Modified();
 
   return PLUS_SUCCESS;
@@ -206,9 +255,64 @@ StreamBufferItem* vtkPlusTimestampedCircularBuffer::GetBufferItemPointerFromBuff
   return &this->BufferItemContainer[bufferIndex];
 }
 
+//----------------------------------------------------------------------------
+BufferItemUidType vtkPlusTimestampedCircularBuffer::GetLatestItemUidInBuffer()
+{
+  if (this->TimestampPublisher->IsEnabled())
+  {
+    return this->TimestampPublisher->GetLatestItemUid();
+  }
+  this->Lock();
+  BufferItemUidType latestUid = this->LatestItemUid;
+  this->Unlock();
+  return latestUid;
+}
+
+//----------------------------------------------------------------------------
+BufferItemUidType vtkPlusTimestampedCircularBuffer::GetOldestItemUidInBuffer()
+{
+  if (this->TimestampPublisher->IsEnabled())
+  {
+    return this->TimestampPublisher->GetOldestItemUid();
+  }
+  this->Lock();
+  // LatestItemUid - ( NumberOfItems - 1 ) is the oldest element in the buffer
+  BufferItemUidType oldestUid = this->LatestItemUid - (this->NumberOfItems - 1);
+  this->Unlock();
+  return oldestUid;
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusTimestampedCircularBuffer::GetOldestTimeStamp(double& timestamp)
+{
+  if (this->TimestampPublisher->GetOldestFilteredTimestamp(timestamp))
+  {
+    timestamp += this->GetLocalTimeOffsetSec();
+    return ITEM_OK;
+  }
+  // The oldest item may be removed from the buffer at any moment
+  // therefore we need to retrieve its UID and timestamp within a single lock
+  this->Lock();
+  // LatestItemUid - ( NumberOfItems - 1 ) is the oldest element in the buffer
+  BufferItemUidType oldestUid = (this->LatestItemUid - (this->NumberOfItems - 1));
+  ItemStatus status = this->GetTimeStamp(oldestUid, timestamp);
+  this->Unlock();
+  return status;
+}
+
 //----------------------------------------------------------------------------
 ItemStatus vtkPlusTimestampedCircularBuffer::GetFilteredTimeStamp(const BufferItemUidType uid, double& filteredTimestamp)
 {
+  ItemStatus publishedStatus = ITEM_UNKNOWN_ERROR;
+  if (this->TimestampPublisher->GetFilteredTimestamp(uid, filteredTimestamp, publishedStatus))
+  {
+    if (publishedStatus == ITEM_OK)
+    {
+      filteredTimestamp += this->GetLocalTimeOffsetSec();
+    }
+    return publishedStatus;
+  }
+
   igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
   StreamBufferItem* itemPtr = NULL;
   ItemStatus status = GetBufferItemPointerFromUid(uid, itemPtr);
@@ -309,10 +413,21 @@ ItemStatus vtkPlusTimestampedCircularBuffer::GetBufferIndexFromTime(const double
   return ITEM_OK;
 }
 
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusTimestampedCircularBuffer::GetItemUidFromTime(const double time, BufferItemUidType& uid)
+{
+  ItemStatus status = ITEM_UNKNOWN_ERROR;
+  if (this->TimestampPublisher->GetItemUidFromTime(time, this->GetLocalTimeOffsetSec(), this->NegligibleTimeDifferenceSec, uid, status))
+  {
+    return status;
+  }
+  return this->GetItemUidFromTimeLocked(time, uid);
+}
+
 //----------------------------------------------------------------------------
 // do a simple divide-and-conquer search for the transform
 // that best matches the given timestamp
-ItemStatus vtkPlusTimestampedCircularBuffer::GetItemUidFromTime(const double time, BufferItemUidType& uid)
+ItemStatus vtkPlusTimestampedCircularBuffer::GetItemUidFromTimeLocked(const double time, BufferItemUidType& uid)
 {
   igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
 
@@ -399,10 +514,12 @@ void vtkPlusTimestampedCircularBuffer::DeepCopy(vtkPlusTimestampedCircularBuffer
 {
   buffer->Lock();
   this->Lock();
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> sourceFilterGuardedLock(buffer->FilterMutex);
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> filterGuardedLock(this->FilterMutex);
   this->WritePointer = buffer->WritePointer;
   this->NumberOfItems = buffer->NumberOfItems;
   this->CurrentTimeStamp = buffer->CurrentTimeStamp;
-  this->LocalTimeOffsetSec = buffer->LocalTimeOffsetSec;
+  this->LocalTimeOffsetSec.store(buffer->GetLocalTimeOffsetSec());
   this->LatestItemUid = buffer->LatestItemUid;
   this->StartTime = buffer->StartTime;
   this->AveragedItemsForFiltering = buffer->AveragedItemsForFiltering;
@@ -412,6 +529,7 @@ void vtkPlusTimestampedCircularBuffer::DeepCopy(vtkPlusTimestampedCircularBuffer
   this->FilterContainerIndexVector = buffer->FilterContainerIndexVector;
 
   this->BufferItemContainer = buffer->BufferItemContainer;
+  this->RebuildPublishedItems();
   this->Unlock();
   buffer->Unlock();
 }
@@ -424,6 +542,7 @@ void vtkPlusTimestampedCircularBuffer::Clear()
   this->NumberOfItems = 0;
   this->CurrentTimeStamp = 0;
   this->LatestItemUid = 0;
+  this->RebuildPublishedItems();
   this->Unlock();
 }
 
@@ -528,7 +647,7 @@ double vtkPlusTimestampedCircularBuffer::GetFrameRate(bool ideal /*=false*/, dou
 // is computed to smooth out the jitter in the times that are returned by the system clock:
 PlusStatus vtkPlusTimestampedCircularBuffer::CreateFilteredTimeStampForItem(unsigned long itemIndex, double inUnfilteredTimestamp, double& outFilteredTimestamp, bool& filteredTimestampProbablyValid)
 {
-  this->Lock();
+  this->FilterMutex->Lock();
   filteredTimestampProbablyValid = true;
 
   if (this->FilterContainerIndexVector.size() != this->AveragedItemsForFiltering
@@ -565,7 +684,7 @@ PlusStatus vtkPlusTimestampedCircularBuffer::CreateFilteredTimeStampForItem(unsi
   {
     outFilteredTimestamp = inUnfilteredTimestamp;
     AddToTimeStampReport(itemIndex, inUnfilteredTimestamp, outFilteredTimestamp);
-    this->Unlock();
+    this->FilterMutex->Unlock();
     return PLUS_SUCCESS;
   }
 
@@ -624,7 +743,7 @@ PlusStatus vtkPlusTimestampedCircularBuffer::CreateFilteredTimeStampForItem(unsi
               << " frameindexes = [" << std::fixed << this->FilterContainerIndexVector << "];");
   }
 
-  this->Unlock();
+  this->FilterMutex->Unlock();
   return PLUS_SUCCESS;
 }
 
@@ -643,9 +762,9 @@ PlusStatus vtkPlusTimestampedCircularBuffer::GetTimeStampReportTable(vtkTable* t
     return PLUS_FAIL;
   }
 
-  this->Lock();
+  this->FilterMutex->Lock();
   timeStampReportTable->DeepCopy(this->TimeStampReportTable);
-  this->Unlock();
+  this->FilterMutex->Unlock();
 
   return PLUS_SUCCESS;
 }
@@ -653,12 +772,21 @@ PlusStatus vtkPlusTimestampedCircularBuffer::GetTimeStampReportTable(vtkTable* t
 //----------------------------------------------------------------------------
 void vtkPlusTimestampedCircularBuffer::AddToTimeStampReport(unsigned long itemIndex, double unfilteredTimestamp, double filteredTimestamp)
 {
+  PlusLatencyTracer* latencyTracer = PlusLatencyTracer::GetInstance();
+  if (latencyTracer->GetEnabled())
+  {
+    latencyTracer->AddEvent(PlusLatencyTracer::STAGE_ACQUIRED, unfilteredTimestamp, this->LatencyTracingComponent);
+    latencyTracer->AddEvent(PlusLatencyTracer::STAGE_TIMESTAMP_FILTERED, filteredTimestamp, this->LatencyTracingComponent);
+  }
+
   if (!this->TimeStampReporting)
   {
     // no reporting is needed
     return;
   }
 
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> filterGuardedLock(this->FilterMutex);
+
   if (this->TimeStampReportTable == NULL)
   {
     this->TimeStampReportTable = vtkTable::New();
@@ -10,6 +10,7 @@
 #include "PlusConfigure.h"
 #include "PlusStreamBufferItem.h"
 #include "vtkObject.h"
+#include <atomic>
 #include <deque>
 
 #include "vnl/vnl_matrix.h"
@@ -17,6 +18,7 @@
 
 #include <float.h> // for DBL_MAX
 
+class PlusTimestampPublisher;
 class vtkIGSIORecursiveCriticalSection;
 class vtkTable;
 
@@ -62,23 +64,10 @@ public:
   virtual ItemStatus GetItemUidFromTime( const double time, BufferItemUidType& uid );
 
   /*! Get the most recent frame UID that is already in the buffer */
-  virtual BufferItemUidType GetLatestItemUidInBuffer()
-  {
-    this->Lock();
-    BufferItemUidType latestUid = this->LatestItemUid;
-    this->Unlock();
-    return latestUid;
-  }
+  virtual BufferItemUidType GetLatestItemUidInBuffer();
 
   /*! Get the oldest frame UID in the buffer  */
-  virtual BufferItemUidType GetOldestItemUidInBuffer()
-  {
-    this->Lock();
-    // LatestItemUid - ( NumberOfItems - 1 ) is the oldest element in the buffer
-    BufferItemUidType oldestUid = this->LatestItemUid - ( this->NumberOfItems - 1 );
-    this->Unlock();
-    return oldestUid;
-  }
+  virtual BufferItemUidType GetOldestItemUidInBuffer();
 
   /*! Get timestamp by frame UID associated with the buffer item  */
   virtual ItemStatus GetLatestTimeStamp( double& timestamp )
@@ -86,17 +75,7 @@ public:
     return this->GetTimeStamp( this->GetLatestItemUidInBuffer(), timestamp );
   }
 
-  virtual ItemStatus GetOldestTimeStamp( double& timestamp )
-  {
-    // The oldest item may be removed from the buffer at any moment
-    // therefore we need to retrieve its UID and timestamp within a single lock
-    this->Lock();
-    // LatestItemUid - ( NumberOfItems - 1 ) is the oldest element in the buffer
-    BufferItemUidType oldestUid = ( this->LatestItemUid - ( this->NumberOfItems - 1 ) );
-    ItemStatus status = this->GetTimeStamp( oldestUid, timestamp );
-    this->Unlock();
-    return status;
-  }
+  virtual ItemStatus GetOldestTimeStamp( double& timestamp );
 
   virtual ItemStatus GetTimeStamp( const BufferItemUidType uid, double& timestamp ) { return this->GetFilteredTimeStamp( uid, timestamp ); }
   virtual ItemStatus GetFilteredTimeStamp( const BufferItemUidType uid, double& filteredTimestamp );
@@ -123,9 +102,18 @@ public:
   virtual void DeepCopy( vtkPlusTimestampedCircularBuffer* buffer );
 
   /*!  Set the local time offset in seconds (global = local + offset) */
-  vtkSetMacro( LocalTimeOffsetSec, double );
+  virtual void SetLocalTimeOffsetSec( double offsetSec )
+  {
+    if ( this->LocalTimeOffsetSec.exchange( offsetSec, std::memory_order_acq_rel ) != offsetSec )
+    {
+      this->Modified();
+    }
+  }
   /*!  Get the local time offset in seconds (global = local + offset) */
-  vtkGetMacro( LocalTimeOffsetSec, double );
+  virtual double GetLocalTimeOffsetSec()
+  {
+    return this->LocalTimeOffsetSec.load( std::memory_order_acquire );
+  }
 
   /*!
     Get the frame rate from the buffer based on the number of frames in the buffer
@@ -180,7 +168,10 @@ public:
   */
   virtual PlusStatus CreateFilteredTimeStampForItem( unsigned long itemIndex, double inUnfilteredTimestamp, double& outFilteredTimestamp, bool& filteredTimestampProbablyValid );
 
-  /*! Add values to the timestamp report. If reporting is not enabled then no values will be added. This should only be called if an item is added without calling CreateFilteredTimeStampForItem. */
+  /*!
+    Add values to the timestamp report. If reporting is not enabled then no values will be added. This should only be called if an item is added without calling CreateFilteredTimeStampForItem.
+    If latency tracing is enabled (see PlusLatencyTracer) then the acquired and timestamp filtered stages of the item are reported, too.
+  */
   void AddToTimeStampReport( unsigned long itemIndex, double unfilteredTimestamp, double filteredTimestamp );
 
   /*! Get the table report of the timestamped buffer. To fill this table TimeStampReporting has to be enabled.  */
@@ -196,6 +187,10 @@ public:
   vtkGetMacro( TimeStampLogging, bool );
   vtkBooleanMacro( TimeStampLogging, bool );
 
+  /*! Name of the component that the acquisition stages of the items are reported with to PlusLatencyTracer */
+  void SetLatencyTracingComponent( const std::string& component ) { this->LatencyTracingComponent = component; }
+  std::string GetLatencyTracingComponent() const { return this->LatencyTracingComponent; }
+
   /*! Set number of items used for timestamp filtering (with LSQR mimimizer) */
   vtkSetMacro( AveragedItemsForFiltering, unsigned int );
   /*! Get number of items used for timestamp filtering (with LSQR mimimizer) */
@@ -206,13 +201,38 @@ public:
   /*! Get recording start time */
   vtkGetMacro( StartTime, double );
 
+  /*!
+    If LockFreeTimestampQueries is enabled then the UID and filtered timestamp of each new item are also published
+    in a sequence-locked ring (see PlusTimestampPublisher). Latest/oldest UID, timestamp and time-to-UID queries are then served from this ring
+    without locking the buffer, so readers never block the acquisition thread (and are not blocked by other readers
+    that copy items while holding the lock). Retrieval of the item content still requires locking the buffer.
+  */
+  virtual void SetLockFreeTimestampQueries( bool enable );
+  vtkGetMacro( LockFreeTimestampQueries, bool );
+  vtkBooleanMacro( LockFreeTimestampQueries, bool );
+
 protected:
   vtkPlusTimestampedCircularBuffer();
   ~vtkPlusTimestampedCircularBuffer();
 
+  /*!
+    Refill the published items from the buffer content (or stop publishing if lock-free queries are disabled).
+    The caller must have locked the buffer.
+  */
+  void RebuildPublishedItems();
+
+  /*! Locked implementation of GetItemUidFromTime */
+  ItemStatus GetItemUidFromTimeLocked( const double time, BufferItemUidType& uid );
+
 protected:
   vtkIGSIORecursiveCriticalSection* Mutex;
 
+  /*!
+    Protects the timestamp filtering containers and the timestamp report table. They are only used by the
+    acquisition thread, so a separate lock avoids waiting for readers that hold the buffer lock.
+  */
+  vtkIGSIORecursiveCriticalSection* FilterMutex;
+
   int NumberOfItems;
 
   /*! Next image will be written here */
@@ -220,8 +240,8 @@ protected:
 
   double CurrentTimeStamp;
 
-  /*! Time offset of the buffer in seconds */
-  double LocalTimeOffsetSec;
+  /*! Time offset of the buffer in seconds. Atomic, because lock-free readers use it without locking the buffer. */
+  std::atomic<double> LocalTimeOffsetSec;
 
   /*!
     This will be the UID of the next item that will be added.
@@ -270,12 +290,21 @@ protected:
   */
   bool TimeStampLogging;
 
+  /*! Name of the component that the acquisition stages of the items are reported with to PlusLatencyTracer */
+  std::string LatencyTracingComponent;
+
   /*!
     Due to numerical inaccuracies (e.g, saving a timestamp to a string and reading from it results in a slightly different value)
     it's better to use a tolerance value when making comparisons.
   */
   double NegligibleTimeDifferenceSec;
 
+  /*! If enabled then timestamp queries are served from the TimestampPublisher without locking */
+  bool LockFreeTimestampQueries;
+
+  /*! Publishes the item timestamps for lock-free readers */
+  PlusTimestampPublisher* TimestampPublisher;
+
 private:
   vtkPlusTimestampedCircularBuffer( const vtkPlusTimestampedCircularBuffer& );
   void operator=( const vtkPlusTimestampedCircularBuffer& );
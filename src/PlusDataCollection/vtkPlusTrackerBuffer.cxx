@@ -0,0 +1,802 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkPlusTrackerBuffer.h"
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+
+// STL includes
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+  // in seconds, used for comparing between timestamps (same as in vtkPlusTimestampedCircularBuffer)
+  const double NEGLIGIBLE_TIME_DIFFERENCE = 1e-5;
+}
+
+vtkStandardNewMacro(vtkPlusTrackerBuffer);
+
+//----------------------------------------------------------------------------
+vtkPlusTrackerBuffer::vtkPlusTrackerBuffer()
+  : BufferSize(0)
+  , NumberOfItems(0)
+  , LatestItemUid(0)
+{
+  // Items are stored in this class, the stream buffer is only used for locking and timestamp filtering
+  this->StreamBuffer->SetBufferSize(0);
+
+  // Use the same default size as vtkPlusBuffer
+  this->SetBufferSize(150);
+}
+
+//----------------------------------------------------------------------------
+vtkPlusTrackerBuffer::~vtkPlusTrackerBuffer()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTrackerBuffer::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "BufferSize: " << this->BufferSize << std::endl;
+  os << indent << "NumberOfItems: " << this->NumberOfItems << std::endl;
+  os << indent << "LatestItemUid: " << this->LatestItemUid << std::endl;
+  os << indent << "Number of items with frame fields: " << this->FrameFields.size() << std::endl;
+}
+
+//----------------------------------------------------------------------------
+int vtkPlusTrackerBuffer::GetBufferSize()
+{
+  return this->BufferSize;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTrackerBuffer::SetBufferSize(int newBufferSize)
+{
+  if (newBufferSize < 0)
+  {
+    LOG_ERROR("Invalid buffer size requested: " << newBufferSize);
+    return PLUS_FAIL;
+  }
+
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+
+  if (newBufferSize == this->BufferSize)
+  {
+    return PLUS_SUCCESS;
+  }
+
+  // Keep the most recent items. Array index of an item depends on the buffer size, so items are copied one by one.
+  int numberOfKeptItems = std::min(this->NumberOfItems, newBufferSize);
+  std::vector<double> filteredTimestamps(newBufferSize, 0.0);
+  std::vector<double> unfilteredTimestamps(newBufferSize, 0.0);
+  std::vector<double> poses(newBufferSize * POSE_SIZE, 0.0);
+  std::vector<unsigned long> indices(newBufferSize, 0);
+  std::vector<ToolStatus> statuses(newBufferSize, TOOL_OK);
+  std::vector<unsigned char> itemFlags(newBufferSize, 0);
+  for (BufferItemUidType uid = this->LatestItemUid - numberOfKeptItems + 1; uid <= this->LatestItemUid && numberOfKeptItems > 0; ++uid)
+  {
+    int oldIndex = uid % this->BufferSize;
+    int newIndex = uid % newBufferSize;
+    filteredTimestamps[newIndex] = this->FilteredTimestamps[oldIndex];
+    unfilteredTimestamps[newIndex] = this->UnfilteredTimestamps[oldIndex];
+    std::copy(this->Poses.begin() + oldIndex * POSE_SIZE, this->Poses.begin() + (oldIndex + 1) * POSE_SIZE, poses.begin() + newIndex * POSE_SIZE);
+    indices[newIndex] = this->Indices[oldIndex];
+    statuses[newIndex] = this->Statuses[oldIndex];
+    itemFlags[newIndex] = this->ItemFlags[oldIndex];
+  }
+  this->FilteredTimestamps.swap(filteredTimestamps);
+  this->UnfilteredTimestamps.swap(unfilteredTimestamps);
+  this->Poses.swap(poses);
+  this->Indices.swap(indices);
+  this->Statuses.swap(statuses);
+  this->ItemFlags.swap(itemFlags);
+
+  // Remove the frame fields of the dropped items
+  BufferItemUidType oldestKeptUid = this->LatestItemUid - numberOfKeptItems + 1;
+  this->FrameFields.erase(this->FrameFields.begin(), this->FrameFields.lower_bound(oldestKeptUid));
+
+  this->BufferSize = newBufferSize;
+  this->NumberOfItems = numberOfKeptItems;
+  this->RebuildPublishedItems();
+  this->Modified();
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTrackerBuffer::AddItem(void* imageDataPtr,
+    US_IMAGE_ORIENTATION usImageOrientation,
+    const FrameSizeType& inputFrameSizeInPx,
+    igsioCommon::VTKScalarPixelType pixelType,
+    unsigned int numberOfScalarComponents,
+    US_IMAGE_TYPE imageType,
+    int numberOfBytesToSkip,
+    long frameNumber,
+    const std::array<int, 3>& clipRectangleOrigin,
+    const std::array<int, 3>& clipRectangleSize,
+    double unfilteredTimestamp/*=UNDEFINED_TIMESTAMP*/,
+    double filteredTimestamp/*=UNDEFINED_TIMESTAMP*/,
+    const igsioFieldMapType* customFields/*=NULL*/,
+    vtkStreamingVolumeFrame* encodedFrame/*=NULL*/)
+{
+  LOG_ERROR("Unable to add video frame to tracker buffer " << (this->DescriptiveName ? this->DescriptiveName : "") << ": video data is not supported");
+  return PLUS_FAIL;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTrackerBuffer::AddItem(void* imageDataPtr,
+    const FrameSizeType& frameSize,
+    unsigned int frameSizeInBytes,
+    US_IMAGE_TYPE imageType,
+    long frameNumber,
+    double unfilteredTimestamp/*=UNDEFINED_TIMESTAMP*/,
+    double filteredTimestamp/*=UNDEFINED_TIMESTAMP*/,
+    const igsioFieldMapType* customFields/*=NULL*/)
+{
+  LOG_ERROR("Unable to add video frame to tracker buffer " << (this->DescriptiveName ? this->DescriptiveName : "") << ": video data is not supported");
+  return PLUS_FAIL;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTrackerBuffer::GetFilteredTimestampForNewItem(unsigned long frameNumber, double& unfilteredTimestamp, double& filteredTimestamp, bool& addItem)
+{
+  addItem = true;
+  if (unfilteredTimestamp == UNDEFINED_TIMESTAMP)
+  {
+    unfilteredTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+  }
+  if (filteredTimestamp == UNDEFINED_TIMESTAMP)
+  {
+    bool filteredTimestampProbablyValid = true;
+    if (this->StreamBuffer->CreateFilteredTimeStampForItem(frameNumber, unfilteredTimestamp, filteredTimestamp, filteredTimestampProbablyValid) != PLUS_SUCCESS)
+    {
+      LOG_DEBUG("Failed to create filtered timestamp for tracker buffer item with item index: " << frameNumber);
+      return PLUS_FAIL;
+    }
+    if (!filteredTimestampProbablyValid)
+    {
+      LOG_INFO("Filtered timestamp is probably invalid for tracker buffer item with item index=" << frameNumber << ", time=" << unfilteredTimestamp << ". The item may have been tagged with an inaccurate timestamp, therefore it will not be recorded.");
+      addItem = false;
+    }
+  }
+  else
+  {
+    this->StreamBuffer->AddToTimeStampReport(frameNumber, unfilteredTimestamp, filteredTimestamp);
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTrackerBuffer::PrepareForNewItem(double filteredTimestamp, BufferItemUidType& itemUid, int& itemIndex)
+{
+  // the caller must have locked the buffer
+  if (this->BufferSize < 1)
+  {
+    LOG_ERROR("Unable to add item to tracker buffer " << (this->DescriptiveName ? this->DescriptiveName : "") << ": buffer size is 0");
+    return PLUS_FAIL;
+  }
+
+  if (this->NumberOfItems > 0 && filteredTimestamp <= this->FilteredTimestamps[this->LatestItemUid % this->BufferSize])
+  {
+    // Just a debug message, because we want to avoid unnecessary warning messages if the timestamp is the same as last one
+    LOG_DEBUG("Need to skip newly added item - new timestamp (" << std::fixed << filteredTimestamp << ") is not newer than the last one");
+    return PLUS_FAIL;
+  }
+
+  itemUid = ++this->LatestItemUid;
+  itemIndex = itemUid % this->BufferSize;
+  if (this->NumberOfItems < this->BufferSize)
+  {
+    this->NumberOfItems++;
+  }
+  else if (!this->FrameFields.empty())
+  {
+    // the oldest item is overwritten
+    this->FrameFields.erase(itemUid - this->BufferSize);
+  }
+  this->TimestampPublisher.Publish(itemUid, filteredTimestamp, this->LatestItemUid - (this->NumberOfItems - 1));
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTrackerBuffer::SetLockFreeTimestampQueries(bool enable)
+{
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  if (this->StreamBuffer->GetLockFreeTimestampQueries() == enable)
+  {
+    return;
+  }
+  this->StreamBuffer->SetLockFreeTimestampQueries(enable);
+  this->RebuildPublishedItems();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTrackerBuffer::RebuildPublishedItems()
+{
+  // the caller must have locked the buffer
+  this->TimestampPublisher.Rebuild(this->StreamBuffer->GetLockFreeTimestampQueries(), this->BufferSize, this->LatestItemUid, this->NumberOfItems,
+                                   [this](BufferItemUidType uid, double & filteredTimestamp)
+  {
+    int itemIndex(0);
+    if (this->GetItemIndexFromUid(uid, itemIndex) != ITEM_OK)
+    {
+      return false;
+    }
+    filteredTimestamp = this->FilteredTimestamps[itemIndex];
+    return true;
+  });
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTrackerBuffer::SetItemFields(BufferItemUidType uid, int itemIndex, const igsioFieldMapType& fields)
+{
+  // the caller must have locked the buffer
+  if (fields.empty())
+  {
+    return;
+  }
+  igsioFieldMapType& itemFields = this->FrameFields[uid];
+  for (igsioFieldMapType::const_iterator it = fields.begin(); it != fields.end(); ++it)
+  {
+    itemFields[it->first] = it->second;
+    if (it->first.find("Transform") != std::string::npos)
+    {
+      this->ItemFlags[itemIndex] |= ITEM_FLAG_VALID_TRANSFORM;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTrackerBuffer::AddItem(const igsioFieldMapType& fields,
+    long frameNumber,
+    double unfilteredTimestamp/*=UNDEFINED_TIMESTAMP*/,
+    double filteredTimestamp/*=UNDEFINED_TIMESTAMP*/)
+{
+  if (fields.empty())
+  {
+    return PLUS_SUCCESS;
+  }
+
+  bool addItem = true;
+  if (this->GetFilteredTimestampForNewItem(frameNumber, unfilteredTimestamp, filteredTimestamp, addItem) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  if (!addItem)
+  {
+    return PLUS_SUCCESS;
+  }
+
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  BufferItemUidType itemUid(0);
+  int itemIndex(0);
+  if (this->PrepareForNewItem(filteredTimestamp, itemUid, itemIndex) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  this->FilteredTimestamps[itemIndex] = filteredTimestamp;
+  this->UnfilteredTimestamps[itemIndex] = unfilteredTimestamp;
+  std::fill(this->Poses.begin() + itemIndex * POSE_SIZE, this->Poses.begin() + (itemIndex + 1) * POSE_SIZE, 0.0);
+  this->Indices[itemIndex] = frameNumber;
+  this->Statuses[itemIndex] = TOOL_OK;
+  this->ItemFlags[itemIndex] = 0;
+  this->SetItemFields(itemUid, itemIndex, fields);
+
+  this->NotifyNewItemSignals();
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTrackerBuffer::AddTimeStampedItem(vtkMatrix4x4* matrix, ToolStatus status, unsigned long frameNumber, double unfilteredTimestamp, double filteredTimestamp/*=UNDEFINED_TIMESTAMP*/, const igsioFieldMapType* customFields /*= NULL*/)
+{
+  if (matrix == NULL)
+  {
+    LOG_ERROR("Unable to add NULL matrix to tracker buffer!");
+    return PLUS_FAIL;
+  }
+
+  bool addItem = true;
+  if (this->GetFilteredTimestampForNewItem(frameNumber, unfilteredTimestamp, filteredTimestamp, addItem) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  if (!addItem)
+  {
+    return PLUS_SUCCESS;
+  }
+
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  BufferItemUidType itemUid(0);
+  int itemIndex(0);
+  if (this->PrepareForNewItem(filteredTimestamp, itemUid, itemIndex) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  this->FilteredTimestamps[itemIndex] = filteredTimestamp;
+  this->UnfilteredTimestamps[itemIndex] = unfilteredTimestamp;
+  double* pose = &this->Poses[itemIndex * POSE_SIZE];
+  for (int row = 0; row < 3; ++row)
+  {
+    for (int column = 0; column < 4; ++column)
+    {
+      pose[row * 4 + column] = matrix->Element[row][column];
+    }
+  }
+  this->Indices[itemIndex] = frameNumber;
+  this->Statuses[itemIndex] = status;
+  this->ItemFlags[itemIndex] = ITEM_FLAG_VALID_TRANSFORM;
+  if (customFields != NULL)
+  {
+    this->SetItemFields(itemUid, itemIndex, *customFields);
+  }
+
+  this->NotifyNewItemSignals();
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusTrackerBuffer::GetItemIndexFromUid(BufferItemUidType uid, int& itemIndex)
+{
+  // the caller must have locked the buffer
+  if (uid > this->LatestItemUid)
+  {
+    return ITEM_NOT_AVAILABLE_YET;
+  }
+  if (uid + this->NumberOfItems <= this->LatestItemUid)
+  {
+    return ITEM_NOT_AVAILABLE_ANYMORE;
+  }
+  itemIndex = uid % this->BufferSize;
+  return ITEM_OK;
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusTrackerBuffer::GetStreamBufferItem(BufferItemUidType uid, StreamBufferItem* bufferItem)
+{
+  if (bufferItem == NULL)
+  {
+    LOG_ERROR("Unable to copy data buffer item into a NULL data buffer item!");
+    return ITEM_UNKNOWN_ERROR;
+  }
+
+  vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+
+  int itemIndex(0);
+  ItemStatus itemStatus = this->GetItemIndexFromUid(uid, itemIndex);
+  if (itemStatus != ITEM_OK)
+  {
+    LOG_WARNING("Buffer item is not in the buffer (Uid: " << uid << ")!");
+    return itemStatus;
+  }
+
+  const double* pose = &this->Poses[itemIndex * POSE_SIZE];
+  for (int row = 0; row < 3; ++row)
+  {
+    for (int column = 0; column < 4; ++column)
+    {
+      matrix->Element[row][column] = pose[row * 4 + column];
+    }
+  }
+
+  // Remove the fields that the item may contain from a previous query
+  igsioFieldMapType previousFields = bufferItem->GetFrameFieldMap();
+  for (igsioFieldMapType::const_iterator it = previousFields.begin(); it != previousFields.end(); ++it)
+  {
+    bufferItem->DeleteFrameField(it->first);
+  }
+
+  bufferItem->SetMatrix(matrix);
+  bufferItem->SetValidTransformData((this->ItemFlags[itemIndex] & ITEM_FLAG_VALID_TRANSFORM) != 0);
+  bufferItem->SetStatus(this->Statuses[itemIndex]);
+  bufferItem->SetFilteredTimestamp(this->FilteredTimestamps[itemIndex]);
+  bufferItem->SetUnfilteredTimestamp(this->UnfilteredTimestamps[itemIndex]);
+  bufferItem->SetIndex(this->Indices[itemIndex]);
+  bufferItem->SetUid(uid);
+
+  std::map<BufferItemUidType, igsioFieldMapType>::const_iterator fieldsIt = this->FrameFields.find(uid);
+  if (fieldsIt != this->FrameFields.end())
+  {
+    for (igsioFieldMapType::const_iterator it = fieldsIt->second.begin(); it != fieldsIt->second.end(); ++it)
+    {
+      bufferItem->SetFrameField(it->first, it->second.second, it->second.first);
+    }
+  }
+
+  return ITEM_OK;
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusTrackerBuffer::GetStreamBufferItemView(BufferItemUidType uid, StreamBufferItem* bufferItem)
+{
+  return this->GetStreamBufferItem(uid, bufferItem);
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusTrackerBuffer::GetPose(BufferItemUidType uid, double pose[POSE_SIZE], ToolStatus& status, double& timestamp)
+{
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+
+  int itemIndex(0);
+  ItemStatus itemStatus = this->GetItemIndexFromUid(uid, itemIndex);
+  if (itemStatus != ITEM_OK)
+  {
+    return itemStatus;
+  }
+
+  std::copy(this->Poses.begin() + itemIndex * POSE_SIZE, this->Poses.begin() + (itemIndex + 1) * POSE_SIZE, pose);
+  status = this->Statuses[itemIndex];
+  timestamp = this->FilteredTimestamps[itemIndex] + this->StreamBuffer->GetLocalTimeOffsetSec();
+  return ITEM_OK;
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusTrackerBuffer::AddItemFrameFields(BufferItemUidType uid, igsioFieldMapType& fields)
+{
+  // the caller must have locked the buffer
+  int itemIndex(0);
+  ItemStatus itemStatus = this->GetItemIndexFromUid(uid, itemIndex);
+  if (itemStatus != ITEM_OK)
+  {
+    return itemStatus;
+  }
+
+  std::map<BufferItemUidType, igsioFieldMapType>::const_iterator fieldsIt = this->FrameFields.find(uid);
+  if (fieldsIt != this->FrameFields.end())
+  {
+    for (igsioFieldMapType::const_iterator it = fieldsIt->second.begin(); it != fieldsIt->second.end(); ++it)
+    {
+      fields[it->first] = it->second;
+    }
+  }
+  return ITEM_OK;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTrackerBuffer::ModifyBufferItemFrameField(BufferItemUidType uid, const std::string& key, const std::string& value)
+{
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+
+  int itemIndex(0);
+  if (this->GetItemIndexFromUid(uid, itemIndex) != ITEM_OK)
+  {
+    return PLUS_FAIL;
+  }
+
+  igsioFieldMapType::mapped_type& field = this->FrameFields[uid][key];
+  field.first = FRAMEFIELD_NONE;
+  field.second = value;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusTrackerBuffer::GetLatestTimeStamp(double& latestTimestamp)
+{
+  if (this->TimestampPublisher.IsEnabled())
+  {
+    return this->GetTimeStamp(this->TimestampPublisher.GetLatestItemUid(), latestTimestamp);
+  }
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  return this->GetTimeStamp(this->LatestItemUid, latestTimestamp);
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusTrackerBuffer::GetOldestTimeStamp(double& oldestTimestamp)
+{
+  if (this->TimestampPublisher.GetOldestFilteredTimestamp(oldestTimestamp))
+  {
+    oldestTimestamp += this->StreamBuffer->GetLocalTimeOffsetSec();
+    return ITEM_OK;
+  }
+  // The oldest item may be removed from the buffer at any moment
+  // therefore we need to retrieve its UID and timestamp within a single lock
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  return this->GetTimeStamp(this->LatestItemUid - (this->NumberOfItems - 1), oldestTimestamp);
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusTrackerBuffer::GetTimeStamp(BufferItemUidType uid, double& timestamp)
+{
+  ItemStatus publishedStatus = ITEM_UNKNOWN_ERROR;
+  if (this->TimestampPublisher.GetFilteredTimestamp(uid, timestamp, publishedStatus))
+  {
+    if (publishedStatus == ITEM_OK)
+    {
+      timestamp += this->StreamBuffer->GetLocalTimeOffsetSec();
+    }
+    return publishedStatus;
+  }
+
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+
+  int itemIndex(0);
+  ItemStatus itemStatus = this->GetItemIndexFromUid(uid, itemIndex);
+  if (itemStatus != ITEM_OK)
+  {
+    timestamp = 0;
+    return itemStatus;
+  }
+  timestamp = this->FilteredTimestamps[itemIndex] + this->StreamBuffer->GetLocalTimeOffsetSec();
+  return ITEM_OK;
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusTrackerBuffer::GetIndex(const BufferItemUidType uid, unsigned long& index)
+{
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+
+  int itemIndex(0);
+  ItemStatus itemStatus = this->GetItemIndexFromUid(uid, itemIndex);
+  if (itemStatus != ITEM_OK)
+  {
+    index = 0;
+    return itemStatus;
+  }
+  index = this->Indices[itemIndex];
+  return ITEM_OK;
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusTrackerBuffer::GetBufferIndexFromTime(const double time, int& bufferIndex)
+{
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+
+  BufferItemUidType uid(0);
+  ItemStatus itemStatus = this->GetItemUidFromTime(time, uid);
+  if (itemStatus != ITEM_OK)
+  {
+    return itemStatus;
+  }
+  return this->GetItemIndexFromUid(uid, bufferIndex);
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusTrackerBuffer::GetLatestItemHasValidVideoData()
+{
+  return false;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusTrackerBuffer::GetLatestItemHasValidTransformData()
+{
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  if (this->NumberOfItems < 1)
+  {
+    return false;
+  }
+  return (this->ItemFlags[this->LatestItemUid % this->BufferSize] & ITEM_FLAG_VALID_TRANSFORM) != 0;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusTrackerBuffer::GetLatestItemHasValidFieldData()
+{
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  if (this->NumberOfItems < 1)
+  {
+    return false;
+  }
+  return this->FrameFields.find(this->LatestItemUid) != this->FrameFields.end();
+}
+
+//----------------------------------------------------------------------------
+BufferItemUidType vtkPlusTrackerBuffer::GetOldestItemUidInBuffer()
+{
+  if (this->TimestampPublisher.IsEnabled())
+  {
+    return this->TimestampPublisher.GetOldestItemUid();
+  }
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  // LatestItemUid - ( NumberOfItems - 1 ) is the oldest element in the buffer
+  return this->LatestItemUid - (this->NumberOfItems - 1);
+}
+
+//----------------------------------------------------------------------------
+BufferItemUidType vtkPlusTrackerBuffer::GetLatestItemUidInBuffer()
+{
+  if (this->TimestampPublisher.IsEnabled())
+  {
+    return this->TimestampPublisher.GetLatestItemUid();
+  }
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  return this->LatestItemUid;
+}
+
+//----------------------------------------------------------------------------
+int vtkPlusTrackerBuffer::GetNumberOfItems()
+{
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  return this->NumberOfItems;
+}
+
+//----------------------------------------------------------------------------
+// do a simple divide-and-conquer search for the item
+// that best matches the given timestamp
+ItemStatus vtkPlusTrackerBuffer::GetItemUidFromTime(double time, BufferItemUidType& uid)
+{
+  ItemStatus publishedStatus = ITEM_UNKNOWN_ERROR;
+  if (this->TimestampPublisher.GetItemUidFromTime(time, this->StreamBuffer->GetLocalTimeOffsetSec(), NEGLIGIBLE_TIME_DIFFERENCE, uid, publishedStatus))
+  {
+    return publishedStatus;
+  }
+
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+
+  if (this->NumberOfItems < 1)
+  {
+    return ITEM_NOT_AVAILABLE_YET;
+  }
+  if (this->NumberOfItems == 1)
+  {
+    // There is only one item, it's the closest one to any timestamp
+    uid = this->LatestItemUid;
+    return ITEM_OK;
+  }
+
+  // Timestamps are stored in local time
+  const double localTime = time - this->StreamBuffer->GetLocalTimeOffsetSec();
+  const double* timestamps = &this->FilteredTimestamps[0];
+  const BufferItemUidType bufferSize = this->BufferSize;
+
+  BufferItemUidType lo = this->LatestItemUid - (this->NumberOfItems - 1); // oldest item UID
+  BufferItemUidType hi = this->LatestItemUid; // latest item UID
+  double tlo = timestamps[lo % bufferSize];
+  double thi = timestamps[hi % bufferSize];
+
+  // If the timestamp is slightly out of range then still accept it
+  // (due to errors in conversions there could be slight differences)
+  if (localTime < tlo - NEGLIGIBLE_TIME_DIFFERENCE)
+  {
+    return ITEM_NOT_AVAILABLE_ANYMORE;
+  }
+  else if (localTime > thi + NEGLIGIBLE_TIME_DIFFERENCE)
+  {
+    return ITEM_NOT_AVAILABLE_YET;
+  }
+
+  while (hi - lo > 1)
+  {
+    BufferItemUidType mid = (lo + hi) / 2;
+    double tmid = timestamps[mid % bufferSize];
+    if (localTime < tmid)
+    {
+      hi = mid;
+      thi = tmid;
+    }
+    else
+    {
+      lo = mid;
+      tlo = tmid;
+    }
+  }
+
+  uid = (localTime - tlo > thi - localTime) ? hi : lo;
+  return ITEM_OK;
+}
+
+//----------------------------------------------------------------------------
+double vtkPlusTrackerBuffer::GetFrameRate(bool ideal /*=false*/, double* framePeriodStdevSecPtr /*=NULL*/)
+{
+  std::vector<double> framePeriods;
+  bool cannotComputeIdealFrameRateDueToInvalidFrameNumbers = false;
+  {
+    igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+    framePeriods.reserve(this->NumberOfItems);
+    BufferItemUidType oldestUid = this->LatestItemUid - (this->NumberOfItems - 1);
+    for (BufferItemUidType uid = this->LatestItemUid; uid > oldestUid && this->NumberOfItems > 1; --uid)
+    {
+      int itemIndex = uid % this->BufferSize;
+      int prevItemIndex = (uid - 1) % this->BufferSize;
+      double framePeriod = this->FilteredTimestamps[itemIndex] - this->FilteredTimestamps[prevItemIndex];
+      if (ideal)
+      {
+        long frameDiff = static_cast<long>(this->Indices[itemIndex]) - static_cast<long>(this->Indices[prevItemIndex]);
+        if (frameDiff > 0)
+        {
+          framePeriod /= (1.0 * frameDiff);
+        }
+        else
+        {
+          // the same frame number was set for different frame indexes; this should not happen (probably no frame number is available)
+          cannotComputeIdealFrameRateDueToInvalidFrameNumbers = true;
+        }
+      }
+      if (framePeriod > 0)
+      {
+        framePeriods.push_back(framePeriod);
+      }
+    }
+  }
+
+  if (cannotComputeIdealFrameRateDueToInvalidFrameNumbers)
+  {
+    LOG_WARNING("Cannot compute ideal frame rate acurately, as frame numbers are invalid or missing");
+  }
+
+  const int numberOfFramePeriods = framePeriods.size();
+  if (numberOfFramePeriods < 1)
+  {
+    LOG_WARNING("Failed to compute frame rate. Not enough samples.");
+    return 0;
+  }
+
+  double samplingPeriod(0);
+  for (int i = 0; i < numberOfFramePeriods; i++)
+  {
+    samplingPeriod += framePeriods[i];
+  }
+  samplingPeriod /= 1.0 * numberOfFramePeriods;
+
+  double frameRate(0);
+  if (samplingPeriod != 0)
+  {
+    frameRate = 1.0 / samplingPeriod;
+  }
+
+  if (framePeriodStdevSecPtr != NULL)
+  {
+    // stdev = sqrt ( 1/N * sum[ (xi-mean)^2 ] )
+    double sumOfXiMeanDiffSquare = 0;
+    for (int i = 0; i < numberOfFramePeriods; i++)
+    {
+      sumOfXiMeanDiffSquare += (framePeriods[i] - samplingPeriod) * (framePeriods[i] - samplingPeriod);
+    }
+    (*framePeriodStdevSecPtr) = sqrt(sumOfXiMeanDiffSquare / numberOfFramePeriods);
+  }
+
+  return frameRate;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTrackerBuffer::DeepCopy(vtkPlusBuffer* buffer)
+{
+  LOG_TRACE("vtkPlusTrackerBuffer::DeepCopy");
+
+  vtkPlusTrackerBuffer* trackerBuffer = vtkPlusTrackerBuffer::SafeDownCast(buffer);
+  if (trackerBuffer == NULL)
+  {
+    // the source stores generic stream buffer items
+    this->CopyItemsFrom(buffer);
+    return;
+  }
+
+  igsioLockGuard<StreamItemCircularBuffer> sourceGuardedLock(trackerBuffer->StreamBuffer);
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+
+  // timestamp filtering state, local time offset, etc.
+  this->StreamBuffer->DeepCopy(trackerBuffer->StreamBuffer);
+
+  this->BufferSize = trackerBuffer->BufferSize;
+  this->NumberOfItems = trackerBuffer->NumberOfItems;
+  this->LatestItemUid = trackerBuffer->LatestItemUid;
+  this->FilteredTimestamps = trackerBuffer->FilteredTimestamps;
+  this->UnfilteredTimestamps = trackerBuffer->UnfilteredTimestamps;
+  this->Poses = trackerBuffer->Poses;
+  this->Indices = trackerBuffer->Indices;
+  this->Statuses = trackerBuffer->Statuses;
+  this->ItemFlags = trackerBuffer->ItemFlags;
+  this->FrameFields = trackerBuffer->FrameFields;
+  this->RebuildPublishedItems();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTrackerBuffer::Clear()
+{
+  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  this->StreamBuffer->Clear();
+  this->NumberOfItems = 0;
+  this->LatestItemUid = 0;
+  this->FrameFields.clear();
+  this->RebuildPublishedItems();
+}
@@ -0,0 +1,179 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusTrackerBuffer_h
+#define __vtkPlusTrackerBuffer_h
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkPlusDataCollectionExport.h"
+#include "PlusTimestampPublisher.h"
+#include "vtkPlusBuffer.h"
+
+// STL includes
+#include <map>
+#include <vector>
+
+/*!
+  \class vtkPlusTrackerBuffer
+  \brief Buffer that stores tool poses in a compact structure-of-arrays layout
+
+  A generic vtkPlusBuffer item holds a heap-allocated matrix, a frame field map and an empty video frame,
+  which is a lot of small allocations for trackers that are sampled at high rate, and the timestamps
+  that are searched by GetItemUidFromTime are scattered in memory. This buffer stores timestamps, poses
+  (the first 3 rows of the transformation matrix), statuses and indices in separate contiguous arrays,
+  the frame fields are only stored for items that have any.
+
+  The buffer provides the same interface as vtkPlusBuffer, items are converted to StreamBufferItem when
+  they are retrieved. Video frames cannot be added. vtkPlusDataSource uses this buffer for tool sources.
+  The inherited stream buffer is kept empty, it is only used for locking and timestamp filtering.
+  If LockFreeTimestampQueries is enabled then the timestamps are published in a PlusTimestampPublisher, the same
+  way as in vtkPlusTimestampedCircularBuffer, so timestamp and UID queries do not lock the buffer.
+
+  \ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport vtkPlusTrackerBuffer : public vtkPlusBuffer
+{
+public:
+  static vtkPlusTrackerBuffer* New();
+  vtkTypeMacro(vtkPlusTrackerBuffer, vtkPlusBuffer);
+  virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
+
+  /*! Set the maximum number of items that the buffer will hold. The most recent items are kept. */
+  virtual PlusStatus SetBufferSize(int n) VTK_OVERRIDE;
+  /*! Get the maximum number of items that the buffer will hold */
+  virtual int GetBufferSize() VTK_OVERRIDE;
+
+  using vtkPlusBuffer::AddItem;
+  /*! Video frames cannot be stored in a tracker buffer, always fails */
+  virtual PlusStatus AddItem(void* imageDataPtr,
+                             US_IMAGE_ORIENTATION usImageOrientation,
+                             const FrameSizeType& inputFrameSizeInPx,
+                             igsioCommon::VTKScalarPixelType pixelType,
+                             unsigned int numberOfScalarComponents,
+                             US_IMAGE_TYPE imageType,
+                             int numberOfBytesToSkip,
+                             long frameNumber,
+                             const std::array<int, 3>& clipRectangleOrigin,
+                             const std::array<int, 3>& clipRectangleSize,
+                             double unfilteredTimestamp = UNDEFINED_TIMESTAMP,
+                             double filteredTimestamp = UNDEFINED_TIMESTAMP,
+                             const igsioFieldMapType* customFields = NULL,
+                             vtkStreamingVolumeFrame* encodedFrame = NULL) VTK_OVERRIDE;
+  /*! Video frames cannot be stored in a tracker buffer, always fails */
+  virtual PlusStatus AddItem(void* imageDataPtr,
+                             const FrameSizeType& frameSize,
+                             unsigned int frameSizeInBytes,
+                             US_IMAGE_TYPE imageType,
+                             long frameNumber,
+                             double unfilteredTimestamp = UNDEFINED_TIMESTAMP,
+                             double filteredTimestamp = UNDEFINED_TIMESTAMP,
+                             const igsioFieldMapType* customFields = NULL) VTK_OVERRIDE;
+  /*! Add an item that only contains custom fields */
+  virtual PlusStatus AddItem(const igsioFieldMapType& fields,
+                             long frameNumber,
+                             double unfilteredTimestamp = UNDEFINED_TIMESTAMP,
+                             double filteredTimestamp = UNDEFINED_TIMESTAMP) VTK_OVERRIDE;
+
+  /*! Add a matrix plus status to the buffer (see vtkPlusBuffer::AddTimeStampedItem) */
+  virtual PlusStatus AddTimeStampedItem(vtkMatrix4x4* matrix, ToolStatus status, unsigned long frameNumber, double unfilteredTimestamp, double filteredTimestamp = UNDEFINED_TIMESTAMP, const igsioFieldMapType* customFields = NULL) VTK_OVERRIDE;
+
+  virtual ItemStatus GetStreamBufferItem(BufferItemUidType uid, StreamBufferItem* bufferItem) VTK_OVERRIDE;
+  /*! There is no pixel data in a tracker buffer, so the view is a copy of the item */
+  virtual ItemStatus GetStreamBufferItemView(BufferItemUidType uid, StreamBufferItem* bufferItem) VTK_OVERRIDE;
+  virtual PlusStatus ModifyBufferItemFrameField(BufferItemUidType uid, const std::string& key, const std::string& value) VTK_OVERRIDE;
+
+  virtual ItemStatus GetPose(BufferItemUidType uid, double pose[POSE_SIZE], ToolStatus& status, double& timestamp) VTK_OVERRIDE;
+
+  virtual ItemStatus GetLatestTimeStamp(double& latestTimestamp) VTK_OVERRIDE;
+  virtual ItemStatus GetOldestTimeStamp(double& oldestTimestamp) VTK_OVERRIDE;
+  virtual ItemStatus GetTimeStamp(BufferItemUidType uid, double& timestamp) VTK_OVERRIDE;
+  virtual ItemStatus GetIndex(const BufferItemUidType uid, unsigned long& index) VTK_OVERRIDE;
+  virtual ItemStatus GetBufferIndexFromTime(const double time, int& bufferIndex) VTK_OVERRIDE;
+
+  virtual bool GetLatestItemHasValidVideoData() VTK_OVERRIDE;
+  virtual bool GetLatestItemHasValidTransformData() VTK_OVERRIDE;
+  virtual bool GetLatestItemHasValidFieldData() VTK_OVERRIDE;
+
+  virtual BufferItemUidType GetOldestItemUidInBuffer() VTK_OVERRIDE;
+  virtual BufferItemUidType GetLatestItemUidInBuffer() VTK_OVERRIDE;
+  virtual ItemStatus GetItemUidFromTime(double time, BufferItemUidType& uid) VTK_OVERRIDE;
+  virtual int GetNumberOfItems() VTK_OVERRIDE;
+  virtual double GetFrameRate(bool ideal = false, double* framePeriodStdevSecPtr = NULL) VTK_OVERRIDE;
+
+  /*! Make this buffer into a copy of another buffer */
+  virtual void DeepCopy(vtkPlusBuffer* buffer) VTK_OVERRIDE;
+
+  /*! Clear buffer (set the buffer pointer to the first element) */
+  virtual void Clear() VTK_OVERRIDE;
+
+  /*! If enabled then timestamp and UID queries do not lock the buffer */
+  virtual void SetLockFreeTimestampQueries(bool enable) VTK_OVERRIDE;
+
+protected:
+  vtkPlusTrackerBuffer();
+  ~vtkPlusTrackerBuffer();
+
+  /*! Item flags stored in ItemFlags */
+  enum ItemFlag
+  {
+    ITEM_FLAG_VALID_TRANSFORM = 0x01
+  };
+
+  /*! Get the index of the item in the arrays. The caller must have locked the buffer. */
+  ItemStatus GetItemIndexFromUid(BufferItemUidType uid, int& itemIndex);
+
+  /*!
+    Reserve the place of a new item and return its UID and array index. The frame fields stored at that
+    place are removed. The caller must have locked the buffer.
+  */
+  PlusStatus PrepareForNewItem(double filteredTimestamp, BufferItemUidType& itemUid, int& itemIndex);
+
+  /*! Compute filtered timestamp (if it is undefined) and add the timestamps to the timestamp report. Returns false if the item should not be added. */
+  PlusStatus GetFilteredTimestampForNewItem(unsigned long frameNumber, double& unfilteredTimestamp, double& filteredTimestamp, bool& addItem);
+
+  virtual ItemStatus AddItemFrameFields(BufferItemUidType uid, igsioFieldMapType& fields) VTK_OVERRIDE;
+
+  /*! Store custom fields of an item. The caller must have locked the buffer. */
+  void SetItemFields(BufferItemUidType uid, int itemIndex, const igsioFieldMapType& fields);
+
+  /*!
+    Refill the published timestamps from the buffer content (or stop publishing if lock-free queries are disabled).
+    The caller must have locked the buffer.
+  */
+  void RebuildPublishedItems();
+
+protected:
+  int BufferSize;
+  int NumberOfItems;
+
+  /*! UID of the most recently added item, the item with UID n is stored at array index n % BufferSize */
+  BufferItemUidType LatestItemUid;
+
+  /*! Filtered timestamps in local time */
+  std::vector<double> FilteredTimestamps;
+  /*! Unfiltered timestamps in local time */
+  std::vector<double> UnfilteredTimestamps;
+  /*! Poses, POSE_SIZE values for each item */
+  std::vector<double> Poses;
+  /*! Index assigned by the data acquisition system (usually a counter) */
+  std::vector<unsigned long> Indices;
+  std::vector<ToolStatus> Statuses;
+  /*! Combination of ItemFlag values */
+  std::vector<unsigned char> ItemFlags;
+
+  /*! Custom frame fields of the items that have any, by UID */
+  std::map<BufferItemUidType, igsioFieldMapType> FrameFields;
+
+  /*! Publishes the item timestamps for lock-free readers. Enabled by the LockFreeTimestampQueries flag of the stream buffer. */
+  PlusTimestampPublisher TimestampPublisher;
+
+private:
+  vtkPlusTrackerBuffer(const vtkPlusTrackerBuffer&);
+  void operator=(const vtkPlusTrackerBuffer&);
+};
+
+#endif
@@ -0,0 +1,288 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+\file vtkPlusForoughiBoneSurfaceProbabilityTest.cxx
+Computes the bone surface probability of synthetic multi-slice images and compares it to a reference that is computed
+in the test by the direct definition of the algorithm: 2D Gaussian convolution, 3x3 Laplacian convolution and the shadow
+value of each pixel summed over all the pixels below it. The frame size and the parameters are changed between the runs
+to verify that the internal buffers and kernels are updated. It is also verified that the highest probability is found
+at the simulated bone surface.
+*/
+
+#include "PlusConfigure.h"
+#include "vtkPlusForoughiBoneSurfaceProbability.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkSmartPointer.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <cmath>
+#include <vector>
+
+namespace
+{
+  const double TOLERANCE = 1e-9;
+
+  struct Parameters
+  {
+    int BlurredVSBLoG;
+    double BoneThreshold;
+    double ShadowSigma;
+    int ShadowVSIntensity;
+    double SmoothingSigma;
+    int TransducerMargin;
+  };
+
+  //----------------------------------------------------------------------------
+  // Row of the simulated bone surface in a column
+  int GetSurfaceRow(int x, int slice, int ny)
+  {
+    return static_cast<int>(0.55 * ny + 0.1 * ny * sin(x / 15.0 + slice));
+  }
+
+  //----------------------------------------------------------------------------
+  // Speckle background, bright bone surface and dark acoustic shadow below it
+  void FillImage(vtkImageData* image)
+  {
+    int dimensions[3] = {0};
+    image->GetDimensions(dimensions);
+    unsigned int seed = 4321;
+    for (int slice = 0; slice < dimensions[2]; ++slice)
+    {
+      double* pixel = static_cast<double*>(image->GetScalarPointer(0, 0, slice));
+      for (int y = 0; y < dimensions[1]; ++y)
+      {
+        for (int x = 0; x < dimensions[0]; ++x, ++pixel)
+        {
+          seed = seed * 1103515245 + 12345;
+          double speckle = static_cast<double>((seed >> 16) & 0xFF);
+          int surfaceRow = GetSurfaceRow(x, slice, dimensions[1]);
+          if (y >= surfaceRow - 1 && y <= surfaceRow + 1)
+          {
+            *pixel = 200.0 + 0.2 * speckle;
+          }
+          else if (y > surfaceRow)
+          {
+            *pixel = 0.05 * speckle;
+          }
+          else
+          {
+            *pixel = 0.3 * speckle;
+          }
+        }
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void Normalize(std::vector<double>& buffer, bool doInverse, double maxValue)
+  {
+    double maxPixelValue = 0;
+    for (size_t i = 0; i < buffer.size(); ++i)
+    {
+      maxPixelValue = std::max(maxPixelValue, buffer[i]);
+    }
+    for (size_t i = 0; i < buffer.size(); ++i)
+    {
+      buffer[i] = doInverse ? (maxValue - buffer[i] / (maxPixelValue / maxValue)) : buffer[i] / (maxPixelValue / maxValue);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Direct computation of the bone surface probability of one slice, pixels outside the image are considered zero
+  void ComputeReferenceSlice(const double* input, int nx, int ny, const Parameters& parameters, std::vector<double>& bsp)
+  {
+    const int sliceSize = nx * ny;
+    auto pixelValue = [nx, ny](const std::vector<double>& buffer, int x, int y)
+    {
+      return (x < 0 || x >= nx || y < 0 || y >= ny) ? 0.0 : buffer[x + y * nx];
+    };
+    std::vector<double> inputBuffer(input, input + sliceSize);
+
+    // 2D Gaussian convolution
+    const int kernelRadius = static_cast<int>(floor(parameters.SmoothingSigma * 3));
+    const double smoothingSigma2 = parameters.SmoothingSigma * parameters.SmoothingSigma;
+    std::vector<double> gaussian(sliceSize, 0.0);
+    for (int y = 0; y < ny; ++y)
+    {
+      for (int x = 0; x < nx; ++x)
+      {
+        double sum = 0;
+        for (int j = -kernelRadius; j <= kernelRadius; ++j)
+        {
+          for (int i = -kernelRadius; i <= kernelRadius; ++i)
+          {
+            sum += exp(-(i * i + j * j) / (2 * smoothingSigma2)) * pixelValue(inputBuffer, x + i, y + j);
+          }
+        }
+        gaussian[x + y * nx] = sum;
+      }
+    }
+    Normalize(gaussian, false, 1.0);
+
+    // Shadow model
+    std::vector<double> shadowModel(ny, 0.0);
+    for (int i = 0; i < ny - 5; ++i)
+    {
+      shadowModel[i] = 1 - exp(-(i * i - 1) / (2 * parameters.ShadowSigma * parameters.ShadowSigma));
+    }
+
+    std::vector<double> reflectionNumber(sliceSize, 0.0);
+    std::vector<double> shadowValue(sliceSize, 0.0);
+    for (int y = 0; y < ny; ++y)
+    {
+      for (int x = 0; x < nx; ++x)
+      {
+        int pixelIdx = x + y * nx;
+        if (gaussian[pixelIdx] < parameters.BoneThreshold || pixelIdx <= parameters.TransducerMargin * nx)
+        {
+          continue;
+        }
+        double laplacian = 4 * gaussian[pixelIdx] - pixelValue(gaussian, x - 1, y) - pixelValue(gaussian, x + 1, y) - pixelValue(gaussian, x, y - 1) - pixelValue(gaussian, x, y + 1);
+        if (x == nx - 1 || x == 0 || y == ny - 1 || y == 0 || laplacian <= 0)
+        {
+          laplacian = 0.0;
+        }
+        else
+        {
+          laplacian /= 0.005;
+        }
+        reflectionNumber[pixelIdx] = pow(gaussian[pixelIdx], parameters.BlurredVSBLoG) + laplacian;
+
+        double sumG = 0;
+        double sumGI = 0;
+        for (int i = y; i < ny; ++i)
+        {
+          sumG += shadowModel[i - y];
+          sumGI += shadowModel[i - y] * gaussian[x + i * nx];
+        }
+        shadowValue[pixelIdx] = sumGI / sumG;
+      }
+    }
+    Normalize(reflectionNumber, false, 1.0);
+    Normalize(shadowValue, true, 1.0);
+
+    bsp.resize(sliceSize);
+    for (int i = 0; i < sliceSize; ++i)
+    {
+      bsp[i] = pow(shadowValue[i], parameters.ShadowVSIntensity) * reflectionNumber[i];
+    }
+    Normalize(bsp, false, 255.0);
+  }
+
+  //----------------------------------------------------------------------------
+  int CompareToReference(vtkPlusForoughiBoneSurfaceProbability* filter, int nx, int ny, int numberOfSlices, const Parameters& parameters)
+  {
+    filter->SetBlurredVSBLoG(parameters.BlurredVSBLoG);
+    filter->SetBoneThreshold(parameters.BoneThreshold);
+    filter->SetShadowSigma(parameters.ShadowSigma);
+    filter->SetShadowVSIntensity(parameters.ShadowVSIntensity);
+    filter->SetSmoothingSigma(parameters.SmoothingSigma);
+    filter->SetTransducerMargin(parameters.TransducerMargin);
+
+    vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+    image->SetExtent(0, nx - 1, 0, ny - 1, 0, numberOfSlices - 1);
+    image->AllocateScalars(VTK_DOUBLE, 1);
+    FillImage(image);
+    filter->SetInputData(image);
+    filter->Update();
+    vtkImageData* output = filter->GetOutput();
+
+    int numberOfErrors = 0;
+    for (int slice = 0; slice < numberOfSlices; ++slice)
+    {
+      std::vector<double> reference;
+      ComputeReferenceSlice(static_cast<double*>(image->GetScalarPointer(0, 0, slice)), nx, ny, parameters, reference);
+      const double* bsp = static_cast<double*>(output->GetScalarPointer(0, 0, slice));
+
+      double maxDifference = 0;
+      for (int i = 0; i < nx * ny; ++i)
+      {
+        maxDifference = std::max(maxDifference, fabs(bsp[i] - reference[i]));
+      }
+      if (!(maxDifference <= TOLERANCE))
+      {
+        LOG_ERROR("Image size " << nx << "x" << ny << ", slice " << slice << ": bone surface probability differs from the reference by " << maxDifference);
+        numberOfErrors++;
+      }
+
+      // The most probable bone pixel of a column is expected at the simulated surface (the image borders are excluded)
+      int numberOfMissedColumns = 0;
+      for (int x = 1; x < nx - 1; ++x)
+      {
+        int maxRow = 0;
+        for (int y = 0; y < ny; ++y)
+        {
+          if (bsp[x + y * nx] > bsp[x + maxRow * nx])
+          {
+            maxRow = y;
+          }
+        }
+        if (abs(maxRow - GetSurfaceRow(x, slice, ny)) > parameters.SmoothingSigma)
+        {
+          numberOfMissedColumns++;
+        }
+      }
+      if (numberOfMissedColumns > (nx - 2) / 10)
+      {
+        LOG_ERROR("Image size " << nx << "x" << ny << ", slice " << slice << ": highest probability is not at the bone surface in " << numberOfMissedColumns << " columns");
+        numberOfErrors++;
+      }
+    }
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp = false;
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "\n\nvtkPlusForoughiBoneSurfaceProbabilityTest help:" << args.GetHelp() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (printHelp)
+  {
+    std::cout << "\n\nvtkPlusForoughiBoneSurfaceProbabilityTest help:" << args.GetHelp() << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  vtkSmartPointer<vtkPlusForoughiBoneSurfaceProbability> filter = vtkSmartPointer<vtkPlusForoughiBoneSurfaceProbability>::New();
+
+  int numberOfErrors = 0;
+  Parameters defaultParameters = { 3, 0.4, 6.0, 5, 5.0, 10 };
+  numberOfErrors += CompareToReference(filter, 97, 143, 2, defaultParameters);
+  // The image is shorter than the range where the shadow model differs from 1
+  numberOfErrors += CompareToReference(filter, 64, 40, 1, defaultParameters);
+  Parameters otherParameters = { 2, 0.3, 3.0, 3, 2.0, 5 };
+  numberOfErrors += CompareToReference(filter, 80, 120, 1, otherParameters);
+  // Same frame size, only the parameters are changed
+  numberOfErrors += CompareToReference(filter, 80, 120, 1, defaultParameters);
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully.");
+  return EXIT_SUCCESS;
+}
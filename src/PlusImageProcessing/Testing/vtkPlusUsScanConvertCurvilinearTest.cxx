@@ -0,0 +1,165 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+\file vtkPlusUsScanConvertCurvilinearTest.cxx
+Scan converts synthetic envelope images with and without vectorization and verifies that the results are identical.
+8-bit unsigned and 16-bit signed images are tested, with an intensity scaling that saturates the output.
+*/
+
+#include "PlusConfigure.h"
+#include "vtkPlusUsScanConvertCurvilinear.h"
+
+// VTK includes
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkSmartPointer.h>
+#include <vtkXMLDataElement.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+namespace
+{
+  const int NUMBER_OF_SAMPLES = 257;
+  const int NUMBER_OF_LINES = 127;
+
+  //----------------------------------------------------------------------------
+  // Pseudo-random envelope data, the same on all platforms
+  void FillEnvelope(vtkImageData* envelope)
+  {
+    unsigned int seed = 12345;
+    int numberOfScalars = NUMBER_OF_SAMPLES * NUMBER_OF_LINES;
+    for (int i = 0; i < numberOfScalars; ++i)
+    {
+      seed = seed * 1103515245 + 12345;
+      int value = static_cast<int>((seed >> 16) & 0xFFFF);
+      if (envelope->GetScalarType() == VTK_UNSIGNED_CHAR)
+      {
+        static_cast<unsigned char*>(envelope->GetScalarPointer())[i] = static_cast<unsigned char>(value & 0xFF);
+      }
+      else
+      {
+        static_cast<short*>(envelope->GetScalarPointer())[i] = static_cast<short>(value - 32768);
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  int CountSaturatedPixels(vtkImageData* image)
+  {
+    int count = 0;
+    int numberOfScalars = static_cast<int>(image->GetNumberOfPoints());
+    for (int i = 0; i < numberOfScalars; ++i)
+    {
+      double value = image->GetPointData()->GetScalars()->GetComponent(i, 0);
+      bool saturated = (value == image->GetScalarTypeMax()) || (image->GetScalarType() != VTK_UNSIGNED_CHAR && value == image->GetScalarTypeMin());
+      if (saturated)
+      {
+        count++;
+      }
+    }
+    return count;
+  }
+
+  //----------------------------------------------------------------------------
+  int CompareScalarAndVectorized(int scalarType, double intensityScaling)
+  {
+    vtkSmartPointer<vtkXMLDataElement> scanConversionElement = vtkSmartPointer<vtkXMLDataElement>::New();
+    scanConversionElement->SetName("ScanConversion");
+    scanConversionElement->SetAttribute("TransducerGeometry", "CURVILINEAR");
+    scanConversionElement->SetDoubleAttribute("RadiusStartMm", 10.0);
+    scanConversionElement->SetDoubleAttribute("RadiusStopMm", 70.0);
+    scanConversionElement->SetDoubleAttribute("ThetaStartDeg", -35.0);
+    scanConversionElement->SetDoubleAttribute("ThetaStopDeg", 35.0);
+    scanConversionElement->SetAttribute("OutputImageSizePixel", "411 327");
+    scanConversionElement->SetAttribute("OutputImageSpacingMmPerPixel", "0.2 0.2");
+
+    vtkSmartPointer<vtkPlusUsScanConvertCurvilinear> scanConverter = vtkSmartPointer<vtkPlusUsScanConvertCurvilinear>::New();
+    if (scanConverter->ReadConfiguration(scanConversionElement) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to read scan conversion configuration");
+      return 1;
+    }
+    scanConverter->SetOutputIntensityScaling(intensityScaling);
+
+    vtkSmartPointer<vtkImageData> envelope = vtkSmartPointer<vtkImageData>::New();
+    envelope->SetExtent(0, NUMBER_OF_SAMPLES - 1, 0, NUMBER_OF_LINES - 1, 0, 0);
+    envelope->AllocateScalars(scalarType, 1);
+    FillEnvelope(envelope);
+    scanConverter->SetInputData(envelope);
+
+    scanConverter->SetVectorizationEnabled(false);
+    scanConverter->Update();
+    vtkSmartPointer<vtkImageData> scalarResult = vtkSmartPointer<vtkImageData>::New();
+    scalarResult->DeepCopy(scanConverter->GetOutput());
+
+    scanConverter->SetVectorizationEnabled(true);
+    scanConverter->Update();
+    vtkImageData* vectorizedResult = scanConverter->GetOutput();
+
+    std::string typeName = vtkImageScalarTypeNameMacro(scalarType);
+    int numberOfErrors = 0;
+    size_t imageSizeInBytes = static_cast<size_t>(scalarResult->GetNumberOfPoints()) * scalarResult->GetScalarSize();
+    if (vectorizedResult->GetNumberOfPoints() != scalarResult->GetNumberOfPoints())
+    {
+      LOG_ERROR("Output image size mismatch (" << typeName << ")");
+      return 1;
+    }
+    if (memcmp(scalarResult->GetScalarPointer(), vectorizedResult->GetScalarPointer(), imageSizeInBytes) != 0)
+    {
+      LOG_ERROR("Vectorized scan conversion result differs from the scalar result (" << typeName << ", intensity scaling " << intensityScaling << ")");
+      numberOfErrors++;
+    }
+    if (intensityScaling > 1.0 && CountSaturatedPixels(scalarResult) == 0)
+    {
+      LOG_ERROR("No saturated pixels (" << typeName << ", intensity scaling " << intensityScaling << "), saturation is not tested");
+      numberOfErrors++;
+    }
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp = false;
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "\n\nvtkPlusUsScanConvertCurvilinearTest help:" << args.GetHelp() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (printHelp)
+  {
+    std::cout << "\n\nvtkPlusUsScanConvertCurvilinearTest help:" << args.GetHelp() << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  int numberOfErrors = 0;
+  numberOfErrors += CompareScalarAndVectorized(VTK_UNSIGNED_CHAR, 1.0);
+  numberOfErrors += CompareScalarAndVectorized(VTK_UNSIGNED_CHAR, 2.5);
+  numberOfErrors += CompareScalarAndVectorized(VTK_SHORT, 1.0);
+  numberOfErrors += CompareScalarAndVectorized(VTK_SHORT, 2.5);
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully.");
+  return EXIT_SUCCESS;
+}
@@ -6,6 +6,7 @@
 #include "vtkPlusTransverseProcessEnhancer.h"
 #include <vtkPlusSequenceIO.h>
 
+#include <vtkIGSIOAccurateTimer.h>
 #include <vtkIGSIOTrackedFrameList.h>
 #include <vtkIGSIOMetaImageSequenceIO.h>
 
@@ -13,6 +14,80 @@
 
 #include "string"
 
+//----------------------------------------------------------------------------
+// Process all frames with the enhancer and return the average processing time of a frame
+PlusStatus ProcessFrames(vtkPlusTransverseProcessEnhancer* boneFilter, vtkIGSIOTrackedFrameList* trackedFrameList, double& averageFrameProcessingTimeSec)
+{
+  double startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  PlusStatus status = boneFilter->Update();
+  double processingTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - startTime;
+  int numberOfFrames = trackedFrameList->GetNumberOfTrackedFrames();
+  averageFrameProcessingTimeSec = (numberOfFrames > 0 ? processingTimeSec / numberOfFrames : 0.0);
+  return status;
+}
+
+//----------------------------------------------------------------------------
+// Process the sequence with the image filter chain and with the fused pipeline,
+// report the processing times, and check that the outputs are the same
+PlusStatus ComparePipelines(vtkIGSIOTrackedFrameList* trackedFrameList, vtkXMLDataElement* processorElement)
+{
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> outputFrames[2];
+  double averageFrameProcessingTimeSec[2] = { 0.0, 0.0 };
+  for (int pipelineIndex = 0; pipelineIndex < 2; ++pipelineIndex)
+  {
+    vtkSmartPointer<vtkPlusTransverseProcessEnhancer> boneFilter = vtkSmartPointer<vtkPlusTransverseProcessEnhancer>::New();
+    boneFilter->SetInputFrames(trackedFrameList);
+    boneFilter->ReadConfiguration(processorElement);
+    boneFilter->SetSaveIntermediateResults(false);
+    boneFilter->SetUseFusedPipeline(pipelineIndex == 1);
+    if (ProcessFrames(boneFilter, trackedFrameList, averageFrameProcessingTimeSec[pipelineIndex]) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed processing frames");
+      return PLUS_FAIL;
+    }
+    outputFrames[pipelineIndex] = boneFilter->GetOutputFrames();
+  }
+
+  LOG_INFO("Average frame processing time with the image filter chain: " << averageFrameProcessingTimeSec[0] * 1000.0 << " ms");
+  LOG_INFO("Average frame processing time with the fused pipeline: " << averageFrameProcessingTimeSec[1] * 1000.0 << " ms");
+  if (averageFrameProcessingTimeSec[1] > 0)
+  {
+    LOG_INFO("Speedup: " << averageFrameProcessingTimeSec[0] / averageFrameProcessingTimeSec[1]);
+  }
+
+  // Compare the output images
+  long numberOfDifferentPixels = 0;
+  for (unsigned int frameIndex = 0; frameIndex < outputFrames[0]->GetNumberOfTrackedFrames(); ++frameIndex)
+  {
+    vtkImageData* filterChainImage = outputFrames[0]->GetTrackedFrame(frameIndex)->GetImageData()->GetImage();
+    vtkImageData* fusedImage = outputFrames[1]->GetTrackedFrame(frameIndex)->GetImageData()->GetImage();
+    vtkIdType numberOfValues = filterChainImage->GetNumberOfPoints() * filterChainImage->GetNumberOfScalarComponents();
+    if (fusedImage->GetNumberOfPoints() * fusedImage->GetNumberOfScalarComponents() != numberOfValues
+      || fusedImage->GetScalarType() != VTK_UNSIGNED_CHAR || filterChainImage->GetScalarType() != VTK_UNSIGNED_CHAR)
+    {
+      LOG_ERROR("Output image size or type of the pipelines differ in frame " << frameIndex);
+      return PLUS_FAIL;
+    }
+    const unsigned char* filterChainPixels = static_cast<unsigned char*>(filterChainImage->GetScalarPointer());
+    const unsigned char* fusedPixels = static_cast<unsigned char*>(fusedImage->GetScalarPointer());
+    for (vtkIdType valueIndex = 0; valueIndex < numberOfValues; ++valueIndex)
+    {
+      if (filterChainPixels[valueIndex] != fusedPixels[valueIndex])
+      {
+        ++numberOfDifferentPixels;
+      }
+    }
+  }
+  if (numberOfDifferentPixels > 0)
+  {
+    LOG_ERROR("Outputs of the image filter chain and the fused pipeline differ in " << numberOfDifferentPixels << " pixels");
+    return PLUS_FAIL;
+  }
+  LOG_INFO("Outputs of the image filter chain and the fused pipeline are identical");
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
 int main(int argc, char **argv)
 {
   bool printHelp = false;
@@ -22,6 +97,8 @@ int main(int argc, char **argv)
   std::string outputFileName;
   std::string configFileName;
   bool saveIntermediateResults = false;
+  bool useFusedPipeline = false;
+  bool comparePipelines = false;
   int verboseLevel=vtkPlusLogger::LOG_LEVEL_UNDEFINED;
 
   args.Initialize(argc, argv);
@@ -30,6 +107,8 @@ int main(int argc, char **argv)
   args.AddArgument("--config-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &configFileName, "The filename for input config file.");
   args.AddArgument("--output-seq-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &outputFileName, "The filename to write the processed sequence to.");
   args.AddArgument("--save-intermediate-images", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &saveIntermediateResults, "If intermediate images should be saved to output files");
+  args.AddArgument("--use-fused-pipeline", vtksys::CommandLineArguments::NO_ARGUMENT, &useFusedPipeline, "Use the fused image processing pipeline, regardless of the UseFusedPipeline setting in the config file");
+  args.AddArgument("--compare-pipelines", vtksys::CommandLineArguments::NO_ARGUMENT, &comparePipelines, "Process the sequence with both the image filter chain and the fused pipeline, report the average frame processing times, and fail if the outputs differ");
   args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
 
   if (!args.Parse())
@@ -114,19 +193,30 @@ int main(int argc, char **argv)
   int numberOfFrames = trackedFrameList->GetNumberOfTrackedFrames();
   LOG_INFO("Number of frames in input: " << numberOfFrames);
 
+  if (comparePipelines && ComparePipelines(trackedFrameList, processorElement) != PLUS_SUCCESS)
+  {
+    return EXIT_FAILURE;
+  }
+
   // Bone filter.
   
   vtkSmartPointer<vtkPlusTransverseProcessEnhancer> boneFilter = vtkSmartPointer<vtkPlusTransverseProcessEnhancer>::New();
   
   boneFilter->SetInputFrames(trackedFrameList);
   boneFilter->ReadConfiguration(processorElement);
+  if (useFusedPipeline)
+  {
+    boneFilter->SetUseFusedPipeline(true);
+  }
 
-  PlusStatus filterStatus = boneFilter->Update();
+  double averageFrameProcessingTimeSec = 0.0;
+  PlusStatus filterStatus = ProcessFrames(boneFilter, trackedFrameList, averageFrameProcessingTimeSec);
   if (filterStatus != PlusStatus::PLUS_SUCCESS)
   {
     LOG_ERROR("Failed processing frames");
     return EXIT_FAILURE;
   }
+  LOG_INFO("Average frame processing time: " << averageFrameProcessingTimeSec * 1000.0 << " ms");
 
   LOG_INFO("Writing output to file");
 
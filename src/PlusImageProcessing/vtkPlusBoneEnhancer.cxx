@@ -25,12 +25,97 @@ See License.txt for details.
 #include <igsioVideoFrame.h>
 #include <vtkIGSIOTrackedFrameList.h>
 
-
+#include <algorithm>
 #include <cmath>
 
 //----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkPlusBoneEnhancer);
 
+namespace
+{
+  // Target size of the smoothed image tiles of the fused pipeline, small enough to stay in the cache
+  const int FUSED_PIPELINE_TILE_SIZE_BYTES = 16 * 1024;
+  const int FUSED_PIPELINE_MIN_TILE_ROWS = 8;
+
+  // Weight of the central difference in the gradient (vtkImageSobel2D)
+  const double SOBEL_GRADIENT_SCALE = 0.125;
+
+  //----------------------------------------------------------------------------
+  // Approximation of the gradient magnitude: average of the gradient components converted to unsigned char.
+  // Negative components are converted by keeping the lowest byte of their integer part, which is how
+  // the conversion of the edge detector output to unsigned char has always behaved on the supported compilers.
+  inline unsigned char GetEdgeMagnitude(double gradientX, double gradientY)
+  {
+    int componentX = static_cast<unsigned char>(static_cast<int>(static_cast<float>(gradientX)));
+    int componentY = static_cast<unsigned char>(static_cast<int>(static_cast<float>(gradientY)));
+    return static_cast<unsigned char>((componentX + componentY) / 2);
+  }
+
+  //----------------------------------------------------------------------------
+  // Threshold values are clamped and converted to the image scalar type (vtkImageThreshold)
+  unsigned char GetUcharThreshold(double threshold)
+  {
+    return static_cast<unsigned char>(std::max(0.0, std::min(255.0, threshold)));
+  }
+
+  //----------------------------------------------------------------------------
+  // Rows of the ellipsoid kernel of vtkImageDilateErode3D, as (row offset, first column offset, last column offset) triples
+  void GetEllipsoidKernelSpans(const int kernelSize[2], std::vector<int>& spans)
+  {
+    spans.clear();
+    for (int j = 0; j < kernelSize[1]; ++j)
+    {
+      double normalizedY = (j - (kernelSize[1] - 1) * 0.5) / (kernelSize[1] * 0.5);
+      int firstOffset = kernelSize[0];
+      int lastOffset = -kernelSize[0];
+      for (int i = 0; i < kernelSize[0]; ++i)
+      {
+        double normalizedX = (i - (kernelSize[0] - 1) * 0.5) / (kernelSize[0] * 0.5);
+        if (normalizedX * normalizedX + normalizedY * normalizedY > 1.0)
+        {
+          continue;
+        }
+        firstOffset = std::min(firstOffset, i - kernelSize[0] / 2);
+        lastOffset = std::max(lastOffset, i - kernelSize[0] / 2);
+      }
+      if (firstOffset <= lastOffset)
+      {
+        spans.push_back(j - kernelSize[1] / 2);
+        spans.push_back(firstOffset);
+        spans.push_back(lastOffset);
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  int FindIslandRoot(std::vector<int>& parent, int label)
+  {
+    while (parent[label] != label)
+    {
+      parent[label] = parent[parent[label]];
+      label = parent[label];
+    }
+    return label;
+  }
+
+  //----------------------------------------------------------------------------
+  void MergeIslands(std::vector<int>& parent, std::vector<int>& area, int label1, int label2)
+  {
+    int root1 = FindIslandRoot(parent, label1);
+    int root2 = FindIslandRoot(parent, label2);
+    if (root1 == root2)
+    {
+      return;
+    }
+    if (root1 > root2)
+    {
+      std::swap(root1, root2);
+    }
+    parent[root2] = root1;
+    area[root1] += area[root2];
+  }
+}
+
 //----------------------------------------------------------------------------
 vtkPlusBoneEnhancer::vtkPlusBoneEnhancer()
 : ScanConverter(NULL),
@@ -54,6 +139,7 @@ vtkPlusBoneEnhancer::vtkPlusBoneEnhancer()
   IslandAreaThreshold(-1),
   BoneOutlineDepthPx(3), // Note: this only changes the appearance/thickness of the 3D model. Different numbers do not change what is or is not marked as bone.
   BonePushBackPx(9),     // Horizontal distance between where a shadow is located, and where the bone begins
+  UseFusedPipeline(false),
 
   LinesImage(NULL),
   ProcessedLinesImage(NULL),
@@ -119,6 +205,7 @@ vtkPlusBoneEnhancer::~vtkPlusBoneEnhancer()
 void vtkPlusBoneEnhancer::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+  os << indent << "UseFusedPipeline: " << (this->UseFusedPipeline ? "true" : "false") << std::endl;
 }
 
 //----------------------------------------------------------------------------
@@ -183,6 +270,8 @@ PlusStatus vtkPlusBoneEnhancer::ReadConfiguration(vtkSmartPointer<vtkXMLDataElem
     {
       XML_READ_BOOL_ATTRIBUTE_OPTIONAL(SaveIntermediateResults, saveIntermediateResultsBool);
     }
+
+    XML_READ_BOOL_ATTRIBUTE_OPTIONAL(UseFusedPipeline, imageProcessingOperations);
     
     // Read tags related to the Gaussian filter
     vtkSmartPointer<vtkXMLDataElement> gaussianParameters = imageProcessingOperations->FindNestedElementWithName("GaussianSmoothing");
@@ -266,6 +355,7 @@ PlusStatus vtkPlusBoneEnhancer::WriteConfiguration(vtkSmartPointer<vtkXMLDataEle
 
   //Write the parameters for filters to the output config file
   XML_FIND_NESTED_ELEMENT_CREATE_IF_MISSING(imageProcessingOperations, processingElement, "ImageProcessingOperations");
+  XML_WRITE_BOOL_ATTRIBUTE(UseFusedPipeline, imageProcessingOperations);
 
   XML_FIND_NESTED_ELEMENT_CREATE_IF_MISSING(saveIntermediateResultsBool, imageProcessingOperations, "SaveIntermediateResults");
   XML_WRITE_BOOL_ATTRIBUTE(SaveIntermediateResults, saveIntermediateResultsBool)
@@ -312,34 +402,36 @@ PlusStatus vtkPlusBoneEnhancer::ProcessImageExtents()
 
 //----------------------------------------------------------------------------
 // Fills the lines image by subsampling the input image along scanlines.
-// Also computes pixel statistics.
 void vtkPlusBoneEnhancer::FillLinesImage(vtkSmartPointer<vtkImageData> inputImageData)
 {
   int* linesImageExtent = this->ScanConverter->GetInputImageExtent();
   int lineLengthPx = linesImageExtent[1] - linesImageExtent[0] + 1;
   int numScanLines = linesImageExtent[3] - linesImageExtent[2] + 1;
 
-  // For calculating pixel intensity mean and variance. Algorithm taken from:
-  // https://en.wikipedia.org/wiki/Algorithms_for_calculating_variance#Online_algorithm
-
-  double mean = 0.0;
-  double sumSquareDiff = 0.0; //named M2 in online notes
-  long pixelCount = 0;
-  double currentValue = 0.0; //temporary value for each loop. //Named value in online notes
-  double valueMeanDiff = 0.0; //Named delta in online notes
-
   double directionVectorX;
   double directionVectorY;
   int pixelCoordX;
   int pixelCoordY;
 
   int* inputExtent = inputImageData->GetExtent();
+
+  // Unsigned char images (the usual case) are read directly from memory, other types through the generic accessor
+  const unsigned char* inputPixels = NULL;
+  vtkIdType inputIncrements[3] = { 0, 0, 0 };
+  if (inputImageData->GetScalarType() == VTK_UNSIGNED_CHAR)
+  {
+    inputPixels = static_cast<unsigned char*>(inputImageData->GetScalarPointer(inputExtent[0], inputExtent[2], inputExtent[4]));
+    inputImageData->GetIncrements(inputIncrements);
+  }
+
   for (int scanLine = 0; scanLine < numScanLines; ++scanLine)
   {
     double start[4] = { 0, 0, 0, 0 };
     double end[4] = { 0, 0, 0, 0 };
     ScanConverter->GetScanLineEndPoints(scanLine, start, end);
 
+    unsigned char* linePixels = static_cast<unsigned char*>(this->LinesImage->GetScalarPointer(0, scanLine, 0));
+
     directionVectorX = static_cast<double>(end[0] - start[0]) / (lineLengthPx - 1);
     directionVectorY = static_cast<double>(end[1] - start[1]) / (lineLengthPx - 1);
     for (int pointIndex = 0; pointIndex < lineLengthPx; ++pointIndex)
@@ -349,16 +441,17 @@ void vtkPlusBoneEnhancer::FillLinesImage(vtkSmartPointer<vtkImageData> inputImag
       if (pixelCoordX < inputExtent[0] || pixelCoordX > inputExtent[1]
         || pixelCoordY < inputExtent[2] || pixelCoordY > inputExtent[3])
       {
-        this->LinesImage->SetScalarComponentFromFloat(pointIndex, scanLine, 0, 0, 0);
+        linePixels[pointIndex] = 0;
         continue; // outside of the specified extent
       }
-      currentValue = inputImageData->GetScalarComponentAsDouble(pixelCoordX, pixelCoordY, 0, 0);
-      this->LinesImage->SetScalarComponentFromFloat(pointIndex, scanLine, 0, 0, currentValue);
-
-      ++pixelCount;
-      valueMeanDiff = currentValue - mean;
-      mean = mean + valueMeanDiff / pixelCount;
-      sumSquareDiff = sumSquareDiff + valueMeanDiff * (currentValue - mean);
+      if (inputPixels != NULL)
+      {
+        linePixels[pointIndex] = inputPixels[(pixelCoordX - inputExtent[0]) * inputIncrements[0] + (pixelCoordY - inputExtent[2]) * inputIncrements[1]];
+      }
+      else
+      {
+        linePixels[pointIndex] = static_cast<unsigned char>(inputImageData->GetScalarComponentAsDouble(pixelCoordX, pixelCoordY, 0, 0));
+      }
     }
   }
 }
@@ -366,29 +459,26 @@ void vtkPlusBoneEnhancer::FillLinesImage(vtkSmartPointer<vtkImageData> inputImag
 //----------------------------------------------------------------------------
 void vtkPlusBoneEnhancer::VectorImageToUchar(vtkSmartPointer<vtkImageData> inputImage)
 {
-  unsigned char* vOutput = 0;
-  unsigned char edgeDetectorOutput0;
-  unsigned char edgeDetectorOutput1;
-  float output = 0.0;     // Keep this in [0..255] instead [0..1] for possible future optimization.
-  float output2 = 0.0;
-
   int dims[3] = { 0, 0, 0 };
   this->LinesImage->GetDimensions(dims);
   this->ConversionImage->SetExtent(this->LinesImage->GetExtent());
   this->ConversionImage->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
-  for (int y = dims[1] - 1; y >= 0; --y)
-  {
-    // Initialize variables for a new scan line.
 
-    for (int x = dims[0] - 1; x >= 0; --x)   // Go towards transducer
-    {
-      edgeDetectorOutput0 = static_cast<unsigned char>(inputImage->GetScalarComponentAsFloat(x, y, 0, 0));
-      edgeDetectorOutput1 = static_cast<unsigned char>(inputImage->GetScalarComponentAsFloat(x, y, 0, 1));
-      vOutput = static_cast<unsigned char*>(this->ConversionImage->GetScalarPointer(x, y, 0));
-      output = (float)(edgeDetectorOutput0 + edgeDetectorOutput1) / (float)2;                                         // Not mathematically correct, but a quick approximation of sqrt(x^2 + y^2)
-
-      *vOutput = (unsigned char)std::max(0, std::min(255, (int)output));
-    }
+  // vtkImageSobel2D output is always double
+  if (inputImage->GetScalarType() != VTK_DOUBLE || inputImage->GetNumberOfScalarComponents() < 2)
+  {
+    LOG_ERROR("Edge detector output is expected to be a double image with 2 components");
+    return;
+  }
+  const int numberOfComponents = inputImage->GetNumberOfScalarComponents();
+  const double* gradient = static_cast<double*>(inputImage->GetScalarPointer());
+  unsigned char* output = static_cast<unsigned char*>(this->ConversionImage->GetScalarPointer());
+  const int numberOfPixels = dims[0] * dims[1];
+  for (int pixelIndex = 0; pixelIndex < numberOfPixels; ++pixelIndex)
+  {
+    // Not mathematically correct, but a quick approximation of sqrt(x^2 + y^2)
+    output[pixelIndex] = GetEdgeMagnitude(gradient[0], gradient[1]);
+    gradient += numberOfComponents;
   }
 }
 
@@ -550,6 +640,7 @@ void vtkPlusBoneEnhancer::ThresholdViaStdDeviation(vtkSmartPointer<vtkImageData>
 
   for (int y = dims[1] - 1; y >= 0; --y)
   {
+    unsigned char* rowPixels = static_cast<unsigned char*>(inputImage->GetScalarPointer(0, y, 0));
     max = 0;
 
     pixelSum = 0;
@@ -559,7 +650,7 @@ void vtkPlusBoneEnhancer::ThresholdViaStdDeviation(vtkSmartPointer<vtkImageData>
     //determine the average, sum, and max of the row
     for (int x = dims[0] - 1; x >= fatLayerToCut; --x)
     {
-      vInput = inputImage->GetScalarComponentAsFloat(x, y, 0, 0);
+      vInput = rowPixels[x];
       pixelSum += vInput;
       squearSum += vInput * vInput;
 
@@ -581,7 +672,7 @@ void vtkPlusBoneEnhancer::ThresholdViaStdDeviation(vtkSmartPointer<vtkImageData>
     {
       for (int x = dims[0] - 1; x >= 0; --x)
       {
-        vOutput = static_cast<unsigned char*>(inputImage->GetScalarPointer(x, y, 0));
+        vOutput = rowPixels + x;
         if (*vOutput < thresholdValue && *vOutput != 0)
         {
           *vOutput = 0;
@@ -693,6 +784,37 @@ void vtkPlusBoneEnhancer::RemoveNoise(vtkSmartPointer<vtkImageData> inputImage)
     this->AddIntermediateImage("_02Threshold_1FilterEnd", inputImage);
   }
 
+  // Smoothing, edge detection, binarization and morphological operations.
+  // The fused pipeline does not produce intermediate images, therefore the filter chain is used if they are saved.
+  bool binaryImageComputed = false;
+  if (this->UseFusedPipeline && !this->SaveIntermediateResults)
+  {
+    binaryImageComputed = (this->ApplyFusedPipeline(inputImage) == PLUS_SUCCESS);
+  }
+  if (!binaryImageComputed)
+  {
+    this->ApplyFilterChain(inputImage);
+  }
+
+  //Detect each possible bone area, then subject it to various tests to confirm if it is valid
+  this->MarkShadowOutline(this->BinaryImageForMorphology);
+  if (this->SaveIntermediateResults)
+  {
+    this->AddIntermediateImage("_09PostFilters_1ShadowOutline", this->BinaryImageForMorphology);
+  }
+
+  // Save all stored intermediate images to mha files in output
+  if (this->SaveIntermediateResults)
+  {
+    this->SaveAllIntermediateResultsToFile();
+  }
+  
+  inputImage->DeepCopy(this->BinaryImageForMorphology);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBoneEnhancer::ApplyFilterChain(vtkSmartPointer<vtkImageData> inputImage)
+{
   //Use gaussian smoothing
   this->GaussianSmooth->SetInputData(inputImage);
   if (this->SaveIntermediateResults)
@@ -741,21 +863,368 @@ void vtkPlusBoneEnhancer::RemoveNoise(vtkSmartPointer<vtkImageData> inputImage)
   {
     this->AddIntermediateImage("_08Dilation_1FilterEnd", this->BinaryImageForMorphology);
   }
+}
 
-  //Detect each possible bone area, then subject it to various tests to confirm if it is valid
-  this->MarkShadowOutline(this->BinaryImageForMorphology);
-  if (this->SaveIntermediateResults)
+//----------------------------------------------------------------------------
+// Computes the same result as ApplyFilterChain. Smoothing, edge detection and binarization are computed
+// tile by tile, so that the intermediate images never have to be stored in full, then islands are removed
+// and the morphological operations are applied on the binary image. Scratch buffers are reused between frames.
+PlusStatus vtkPlusBoneEnhancer::ApplyFusedPipeline(vtkSmartPointer<vtkImageData> inputImage)
+{
+  if (inputImage->GetScalarType() != VTK_UNSIGNED_CHAR || inputImage->GetNumberOfScalarComponents() != 1)
   {
-    this->AddIntermediateImage("_09PostFilters_1ShadowOutline", this->BinaryImageForMorphology);
+    LOG_ERROR("The fused pipeline requires a single component unsigned char lines image, the image filter chain is used instead");
+    return PLUS_FAIL;
   }
 
-  // Save all stored intermediate images to mha files in output
-  if (this->SaveIntermediateResults)
+  int dims[3] = { 0, 0, 0 };
+  inputImage->GetDimensions(dims);
+  const int width = dims[0];
+  const int height = dims[1];
+  const int numberOfPixels = width * height;
+  if (numberOfPixels <= 0)
   {
-    this->SaveAllIntermediateResultsToFile();
+    LOG_ERROR("The lines image is empty");
+    return PLUS_FAIL;
+  }
+
+  // Output image
+  int* outputExtent = this->BinaryImageForMorphology->GetExtent();
+  int* inputExtent = inputImage->GetExtent();
+  if (!std::equal(inputExtent, inputExtent + 6, outputExtent) || this->BinaryImageForMorphology->GetScalarType() != VTK_UNSIGNED_CHAR)
+  {
+    this->BinaryImageForMorphology->SetExtent(inputExtent);
+    this->BinaryImageForMorphology->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+  }
+  this->BinaryImageForMorphology->SetSpacing(inputImage->GetSpacing());
+  this->BinaryImageForMorphology->SetOrigin(inputImage->GetOrigin());
+
+  // Gaussian smoothing parameters (vtkImageGaussianSmooth uses the same radius along both axes)
+  const int gaussianRadius = static_cast<int>(this->GaussianStdDev * this->GaussianKernelSize);
+  this->ColumnGaussianKernels.Update(height, gaussianRadius, this->GaussianStdDev);
+  this->RowGaussianKernels.Update(width, gaussianRadius, this->GaussianStdDev);
+  this->GaussianSumBuffer.resize(width);
+  this->ColumnSmoothedBuffer.resize(width);
+
+  // Edge detection and binarization parameters
+  double* spacing = inputImage->GetSpacing();
+  const double gradientScaleX = SOBEL_GRADIENT_SCALE / spacing[0];
+  const double gradientScaleY = SOBEL_GRADIENT_SCALE / spacing[1];
+  const unsigned char lowerThreshold = GetUcharThreshold(this->ImageBinarizer->GetLowerThreshold());
+  const unsigned char upperThreshold = GetUcharThreshold(this->ImageBinarizer->GetUpperThreshold());
+  const unsigned char binaryInValue = static_cast<unsigned char>(this->ImageBinarizer->GetInValue());
+  const unsigned char binaryOutValue = static_cast<unsigned char>(this->ImageBinarizer->GetOutValue());
+
+  const int tileRows = std::max(FUSED_PIPELINE_MIN_TILE_ROWS, FUSED_PIPELINE_TILE_SIZE_BYTES / width);
+  // The edge detector needs one more smoothed row on each side of the tile
+  this->SmoothedTile.resize((tileRows + 2) * width);
+  this->BinaryBuffer.resize(numberOfPixels);
+
+  const unsigned char* image = static_cast<unsigned char*>(inputImage->GetScalarPointer());
+  for (int tileFirstRow = 0; tileFirstRow < height; tileFirstRow += tileRows)
+  {
+    const int tileLastRow = std::min(tileFirstRow + tileRows, height) - 1;
+    const int firstSmoothedRow = std::max(tileFirstRow - 1, 0);
+    const int lastSmoothedRow = std::min(tileLastRow + 1, height - 1);
+    this->SmoothTile(image, width, height, firstSmoothedRow, lastSmoothedRow);
+
+    for (int y = tileFirstRow; y <= tileLastRow; ++y)
+    {
+      // Pixels at the image boundary are replicated (vtkImageSobel2D)
+      const unsigned char* previousRow = &this->SmoothedTile[(std::max(y - 1, 0) - firstSmoothedRow) * width];
+      const unsigned char* currentRow = &this->SmoothedTile[(y - firstSmoothedRow) * width];
+      const unsigned char* nextRow = &this->SmoothedTile[(std::min(y + 1, height - 1) - firstSmoothedRow) * width];
+      unsigned char* binaryRow = &this->BinaryBuffer[y * width];
+      for (int x = 0; x < width; ++x)
+      {
+        const int left = (x > 0 ? x - 1 : 0);
+        const int right = (x < width - 1 ? x + 1 : width - 1);
+        const int sumX = 2 * (currentRow[right] - currentRow[left]) + (previousRow[right] + nextRow[right]) - (previousRow[left] + nextRow[left]);
+        const int sumY = 2 * (nextRow[x] - previousRow[x]) + (nextRow[left] + nextRow[right]) - (previousRow[left] + previousRow[right]);
+        const unsigned char magnitude = GetEdgeMagnitude(sumX * gradientScaleX, sumY * gradientScaleY);
+        binaryRow[x] = (magnitude >= lowerThreshold && magnitude <= upperThreshold) ? binaryInValue : binaryOutValue;
+      }
+    }
+  }
+
+  this->RemoveIslands(&this->BinaryBuffer[0], width, height);
+
+  unsigned char* output = static_cast<unsigned char*>(this->BinaryImageForMorphology->GetScalarPointer());
+  this->ErodedBuffer.resize(numberOfPixels);
+  this->ApplyBinaryMorphology(&this->BinaryBuffer[0], &this->ErodedBuffer[0], width, height, this->ErosionKernelSize,
+                              static_cast<unsigned char>(this->ImageEroder->GetErodeValue()), static_cast<unsigned char>(this->ImageEroder->GetDilateValue()));
+  this->ApplyBinaryMorphology(&this->ErodedBuffer[0], output, width, height, this->DilationKernelSize,
+                              static_cast<unsigned char>(this->ImageDialator->GetErodeValue()), static_cast<unsigned char>(this->ImageDialator->GetDilateValue()));
+  this->BinaryImageForMorphology->Modified();
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBoneEnhancer::GaussianAxisKernels::Update(int length, int radius, double stdDev)
+{
+  if (length == this->Length && radius == this->Radius && stdDev == this->StdDev)
+  {
+    // kernels are already computed for these parameters
+    return;
+  }
+  this->Length = length;
+  this->Radius = radius;
+  this->StdDev = stdDev;
+
+  this->WeightsStart.resize(length);
+  this->FirstOffset.resize(length);
+  this->LastOffset.resize(length);
+  this->Weights.clear();
+  int unclippedKernelStart = -1;
+  for (int i = 0; i < length; ++i)
+  {
+    const int firstOffset = std::max(-radius, -i);
+    const int lastOffset = std::min(radius, length - 1 - i);
+    this->FirstOffset[i] = firstOffset;
+    this->LastOffset[i] = lastOffset;
+    const bool clipped = (firstOffset != -radius || lastOffset != radius);
+    if (!clipped && unclippedKernelStart >= 0)
+    {
+      // all unclipped kernels are the same
+      this->WeightsStart[i] = unclippedKernelStart;
+      continue;
+    }
+    const int kernelStart = static_cast<int>(this->Weights.size());
+    this->WeightsStart[i] = kernelStart;
+    if (!clipped)
+    {
+      unclippedKernelStart = kernelStart;
+    }
+    if (stdDev == 0.0)
+    {
+      this->Weights.push_back(1.0);
+      continue;
+    }
+    double sum = 0.0;
+    for (int offset = firstOffset; offset <= lastOffset; ++offset)
+    {
+      double weight = exp(-static_cast<double>(offset * offset) / (2.0 * stdDev * stdDev));
+      this->Weights.push_back(weight);
+      sum += weight;
+    }
+    for (int weightIndex = kernelStart; weightIndex < static_cast<int>(this->Weights.size()); ++weightIndex)
+    {
+      this->Weights[weightIndex] /= sum;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+// Same operations as vtkImageGaussianSmooth with dimensionality 2: smoothing along the columns is followed by
+// smoothing along the rows, with an unsigned char image in between, and the kernels are applied in the same order,
+// so that rounding is the same. Sums of each kernel position are accumulated for a whole row, which vectorizes well.
+void vtkPlusBoneEnhancer::SmoothTile(const unsigned char* image, int width, int height, int firstRow, int lastRow)
+{
+  double* sums = &this->GaussianSumBuffer[0];
+  unsigned char* columnSmoothed = &this->ColumnSmoothedBuffer[0];
+  const GaussianAxisKernels& columnKernels = this->ColumnGaussianKernels;
+  const GaussianAxisKernels& rowKernels = this->RowGaussianKernels;
+
+  // Pixels that are not closer to the ends of the row than the kernel radius use the unclipped kernel
+  const int unclippedBegin = std::min(rowKernels.Radius, width);
+  const int unclippedEnd = std::max(width - rowKernels.Radius, unclippedBegin);
+
+  for (int y = firstRow; y <= lastRow; ++y)
+  {
+    // Smoothing along the column
+    {
+      const double* weights = &columnKernels.Weights[columnKernels.WeightsStart[y]];
+      const int firstOffset = columnKernels.FirstOffset[y];
+      std::fill(sums, sums + width, 0.0);
+      for (int offset = firstOffset; offset <= columnKernels.LastOffset[y]; ++offset)
+      {
+        const double weight = weights[offset - firstOffset];
+        const unsigned char* inputRow = image + (y + offset) * width;
+        for (int x = 0; x < width; ++x)
+        {
+          sums[x] += weight * inputRow[x];
+        }
+      }
+      for (int x = 0; x < width; ++x)
+      {
+        columnSmoothed[x] = static_cast<unsigned char>(sums[x]);
+      }
+    }
+
+    // Smoothing along the row
+    unsigned char* outputRow = &this->SmoothedTile[(y - firstRow) * width];
+    if (unclippedBegin < unclippedEnd)
+    {
+      const double* weights = &rowKernels.Weights[rowKernels.WeightsStart[unclippedBegin]];
+      std::fill(sums + unclippedBegin, sums + unclippedEnd, 0.0);
+      for (int offset = -rowKernels.Radius; offset <= rowKernels.Radius; ++offset)
+      {
+        const double weight = weights[offset + rowKernels.Radius];
+        const unsigned char* inputPixels = columnSmoothed + offset;
+        for (int x = unclippedBegin; x < unclippedEnd; ++x)
+        {
+          sums[x] += weight * inputPixels[x];
+        }
+      }
+      for (int x = unclippedBegin; x < unclippedEnd; ++x)
+      {
+        outputRow[x] = static_cast<unsigned char>(sums[x]);
+      }
+    }
+    for (int x = 0; x < width; ++x)
+    {
+      if (x >= unclippedBegin && x < unclippedEnd)
+      {
+        continue;
+      }
+      const double* weights = &rowKernels.Weights[rowKernels.WeightsStart[x]];
+      const int firstOffset = rowKernels.FirstOffset[x];
+      double sum = 0.0;
+      for (int offset = firstOffset; offset <= rowKernels.LastOffset[x]; ++offset)
+      {
+        sum += weights[offset - firstOffset] * columnSmoothed[x + offset];
+      }
+      outputRow[x] = static_cast<unsigned char>(sum);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+// Same result as vtkImageIslandRemoval2D with square neighborhood. Islands are labeled in one pass
+// as runs of pixels, merging labels of runs that touch a run in the previous row (union-find).
+void vtkPlusBoneEnhancer::RemoveIslands(unsigned char* image, int width, int height)
+{
+  const int areaThreshold = this->IslandRemover->GetAreaThreshold();
+  if (areaThreshold <= 1)
+  {
+    // all islands have at least one pixel, nothing to remove
+    return;
+  }
+  const unsigned char islandValue = static_cast<unsigned char>(this->IslandRemover->GetIslandValue());
+  const unsigned char replaceValue = static_cast<unsigned char>(this->IslandRemover->GetReplaceValue());
+
+  // Runs are stored as (first x, last x, label) triples
+  std::vector<int>& runs = this->IslandRuns;
+  std::vector<int>& rowRunStart = this->IslandRowRunStart;
+  runs.clear();
+  rowRunStart.resize(height + 1);
+  this->IslandParent.clear();
+  this->IslandArea.clear();
+
+  for (int y = 0; y < height; ++y)
+  {
+    const unsigned char* row = image + y * width;
+    rowRunStart[y] = static_cast<int>(runs.size()) / 3;
+    int previousRowRun = (y > 0 ? rowRunStart[y - 1] : 0);
+    const int previousRowEnd = rowRunStart[y];
+    int x = 0;
+    while (x < width)
+    {
+      if (row[x] != islandValue)
+      {
+        ++x;
+        continue;
+      }
+      const int firstX = x;
+      while (x < width && row[x] == islandValue)
+      {
+        ++x;
+      }
+      const int lastX = x - 1;
+
+      const int label = static_cast<int>(this->IslandParent.size());
+      this->IslandParent.push_back(label);
+      this->IslandArea.push_back(lastX - firstX + 1);
+
+      // Runs of the previous row that touch this run, including diagonally
+      while (previousRowRun < previousRowEnd && runs[3 * previousRowRun + 1] < firstX - 1)
+      {
+        ++previousRowRun;
+      }
+      for (int run = previousRowRun; run < previousRowEnd && runs[3 * run] <= lastX + 1; ++run)
+      {
+        MergeIslands(this->IslandParent, this->IslandArea, label, runs[3 * run + 2]);
+      }
+
+      runs.push_back(firstX);
+      runs.push_back(lastX);
+      runs.push_back(label);
+    }
+  }
+  rowRunStart[height] = static_cast<int>(runs.size()) / 3;
+
+  for (int y = 0; y < height; ++y)
+  {
+    unsigned char* row = image + y * width;
+    for (int run = rowRunStart[y]; run < rowRunStart[y + 1]; ++run)
+    {
+      if (this->IslandArea[FindIslandRoot(this->IslandParent, runs[3 * run + 2])] < areaThreshold)
+      {
+        std::fill(row + runs[3 * run], row + runs[3 * run + 1] + 1, replaceValue);
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+// The number of toValue pixels in each kernel row is computed from prefix counts of the image rows,
+// so that the cost does not depend on the kernel width.
+void vtkPlusBoneEnhancer::ApplyBinaryMorphology(const unsigned char* input, unsigned char* output, int width, int height, const int kernelSize[2], unsigned char fromValue, unsigned char toValue)
+{
+  std::vector<int>& spans = this->MorphologyKernelSpans;
+  GetEllipsoidKernelSpans(kernelSize, spans);
+  const int numberOfSpans = static_cast<int>(spans.size()) / 3;
+  if (numberOfSpans == 0 || (numberOfSpans == 1 && spans[0] == 0 && spans[1] == 0 && spans[2] == 0))
+  {
+    // the kernel contains at most the center pixel, the image is not changed
+    std::copy(input, input + width * height, output);
+    return;
+  }
+
+  const int countRowLength = width + 1;
+  this->MorphologyCountBuffer.resize(countRowLength * height);
+  for (int y = 0; y < height; ++y)
+  {
+    const unsigned char* inputRow = input + y * width;
+    int* counts = &this->MorphologyCountBuffer[y * countRowLength];
+    counts[0] = 0;
+    for (int x = 0; x < width; ++x)
+    {
+      counts[x + 1] = counts[x] + (inputRow[x] == toValue ? 1 : 0);
+    }
+  }
+
+  for (int y = 0; y < height; ++y)
+  {
+    const unsigned char* inputRow = input + y * width;
+    unsigned char* outputRow = output + y * width;
+    for (int x = 0; x < width; ++x)
+    {
+      unsigned char value = inputRow[x];
+      if (value == fromValue)
+      {
+        for (int span = 0; span < numberOfSpans; ++span)
+        {
+          // Kernel pixels outside of the image are ignored
+          const int kernelY = y + spans[3 * span];
+          if (kernelY < 0 || kernelY >= height)
+          {
+            continue;
+          }
+          const int firstX = std::max(x + spans[3 * span + 1], 0);
+          const int lastX = std::min(x + spans[3 * span + 2], width - 1);
+          const int* counts = &this->MorphologyCountBuffer[kernelY * countRowLength];
+          if (firstX <= lastX && counts[lastX + 1] > counts[firstX])
+          {
+            value = toValue;
+            break;
+          }
+        }
+      }
+      outputRow[x] = value;
+    }
   }
-  
-  inputImage->DeepCopy(this->BinaryImageForMorphology);
 }
 
 
@@ -87,6 +87,16 @@ public:
   vtkSetVector2Macro(DilationKernelSize, int);
   vtkGetVector2Macro(DilationKernelSize, int);
 
+  /*!
+    If enabled then smoothing, edge detection, binarization, island removal, erosion and dilation are computed
+    by a fused pipeline that processes the lines image in cache-sized tiles using reusable scratch buffers,
+    instead of the chain of VTK image filters. The results are the same.
+    The VTK filter chain is always used when intermediate results are saved.
+  */
+  vtkSetMacro(UseFusedPipeline, bool);
+  vtkGetMacro(UseFusedPipeline, bool);
+  vtkBooleanMacro(UseFusedPipeline, bool);
+
   void ThresholdViaStdDeviation(vtkSmartPointer<vtkImageData> inputImage);
 
   vtkImageData* GetProcessedLinesImage() { return (this->ProcessedLinesImage); }
@@ -112,6 +122,43 @@ protected:
 
   void ImageConjunction(vtkSmartPointer<vtkImageData> inputImage, vtkSmartPointer<vtkImageData> maskImage);
 
+  /*! Compute BinaryImageForMorphology from the thresholded lines image using the VTK image filters */
+  void ApplyFilterChain(vtkSmartPointer<vtkImageData> inputImage);
+
+  /*! Compute BinaryImageForMorphology from the thresholded lines image using the fused pipeline */
+  PlusStatus ApplyFusedPipeline(vtkSmartPointer<vtkImageData> inputImage);
+
+  /*! Gaussian smoothing of rows [firstRow, lastRow] of the lines image into the SmoothedTile buffer */
+  void SmoothTile(const unsigned char* image, int width, int height, int firstRow, int lastRow);
+
+  /*! Remove 8-connected islands of non-zero pixels that are smaller than IslandAreaThreshold */
+  void RemoveIslands(unsigned char* image, int width, int height);
+
+  /*!
+    Binary morphology with an ellipsoid kernel, same as vtkImageDilateErode3D:
+    a pixel of fromValue is changed to toValue if any pixel of the kernel around it is toValue.
+  */
+  void ApplyBinaryMorphology(const unsigned char* input, unsigned char* output, int width, int height, const int kernelSize[2], unsigned char fromValue, unsigned char toValue);
+
+  /*!
+    Gaussian kernels along an image axis. Kernels of pixels that are closer to the boundary than the radius are
+    clipped and normalized (as in vtkImageGaussianSmooth). All kernels are stored in Weights, the kernel of
+    pixel i starts at WeightsStart[i], and covers the offsets FirstOffset[i]..LastOffset[i].
+  */
+  struct GaussianAxisKernels
+  {
+    GaussianAxisKernels() : Length(-1), Radius(-1), StdDev(-1.0) {}
+    void Update(int length, int radius, double stdDev);
+
+    int Length;
+    int Radius;
+    double StdDev;
+    std::vector<int> WeightsStart;
+    std::vector<int> FirstOffset;
+    std::vector<int> LastOffset;
+    std::vector<double> Weights;
+  };
+
   void AddIntermediateImage(char* fileNamePostfix, vtkSmartPointer<vtkImageData> image);
   void AddIntermediateFromFilter(char* fileNamePostfix, vtkImageAlgorithm* imageAlgorithm);
 
@@ -150,6 +197,23 @@ protected:
   int BoneOutlineDepthPx;
   int BonePushBackPx;
 
+  bool UseFusedPipeline;
+
+  // Scratch buffers of the fused pipeline, kept between frames to avoid reallocation
+  GaussianAxisKernels RowGaussianKernels;
+  GaussianAxisKernels ColumnGaussianKernels;
+  std::vector<double> GaussianSumBuffer;
+  std::vector<unsigned char> ColumnSmoothedBuffer;
+  std::vector<unsigned char> SmoothedTile;
+  std::vector<unsigned char> BinaryBuffer;
+  std::vector<unsigned char> ErodedBuffer;
+  std::vector<int> MorphologyCountBuffer;
+  std::vector<int> MorphologyKernelSpans;
+  std::vector<int> IslandRuns;
+  std::vector<int> IslandRowRunStart;
+  std::vector<int> IslandParent;
+  std::vector<int> IslandArea;
+
   bool SaveIntermediateResults;
   std::string IntermediateImageFileName;
   std::vector<char*> IntermediatePostfixes;
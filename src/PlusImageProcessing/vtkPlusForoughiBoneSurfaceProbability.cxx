@@ -18,22 +18,75 @@ See License.txt for details.
 #include <vtkTimerLog.h>
 
 // STD includes
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 
-// Other includes
-#include "mkl.h"
-#ifdef NDEBUG
-  #include <omp.h>
-#endif
+vtkStandardNewMacro(vtkPlusForoughiBoneSurfaceProbability);
+
+namespace
+{
+  // Shadow model weights are considered to be 1 where they differ from 1 by less than this value
+  const double SHADOW_MODEL_TOLERANCE = 1e-12;
 
-#define MKL_FREE_IF_NULL(var) \
-  if (var != NULL) \
-  { \
-    mkl_free(var); \
-    var = NULL; \
+  // Number of pixels processed at once by MultiplyByPower, small enough to stay in the L1 cache
+  const int POWER_BLOCK_SIZE = 512;
+
+  //-----------------------------------------------------------------------------
+  double IntegerPower(double base, int exponent)
+  {
+    if (exponent < 0)
+    {
+      return 1.0 / IntegerPower(base, -exponent);
+    }
+    double result = 1.0;
+    for (int i = 0; i < exponent; ++i)
+    {
+      result *= base;
+    }
+    return result;
   }
 
-vtkStandardNewMacro(vtkPlusForoughiBoneSurfaceProbability);
+  //-----------------------------------------------------------------------------
+  // output[i] = pow(base[i], exponent) * factor[i]
+  // The power is computed by repeated multiplication of small blocks, which the compiler can vectorize.
+  void MultiplyByPower(const double* base, int exponent, const double* factor, double* output, int size)
+  {
+    if (exponent < 0)
+    {
+      for (int i = 0; i < size; ++i)
+      {
+        output[i] = IntegerPower(base[i], exponent) * factor[i];
+      }
+      return;
+    }
+    for (int blockStart = 0; blockStart < size; blockStart += POWER_BLOCK_SIZE)
+    {
+      const int blockEnd = std::min(blockStart + POWER_BLOCK_SIZE, size);
+      for (int i = blockStart; i < blockEnd; ++i)
+      {
+        output[i] = factor[i];
+      }
+      for (int power = 0; power < exponent; ++power)
+      {
+        for (int i = blockStart; i < blockEnd; ++i)
+        {
+          output[i] *= base[i];
+        }
+      }
+    }
+  }
+
+  //-----------------------------------------------------------------------------
+  // output[i] += weight * input[i]
+  inline void AddWeightedRow(const double* input, double weight, double* output, int size)
+  {
+    for (int i = 0; i < size; ++i)
+    {
+      output[i] += weight * input[i];
+    }
+  }
+}
 
 //----------------------------------------------------------------------------
 vtkPlusForoughiBoneSurfaceProbability::vtkPlusForoughiBoneSurfaceProbability()
@@ -52,22 +105,38 @@ vtkPlusForoughiBoneSurfaceProbability::vtkPlusForoughiBoneSurfaceProbability()
   this->FrameSize[1] = 0;
   this->FrameSize[2] = 1;
 
-  this->MklGaussianBuffer = NULL;
-  this->MklLaplacianOfGaussianBuffer = NULL;
-  this->MklGaussianBufferTemp = NULL;
-  this->MklLaplacianOfGaussianBufferTemp = NULL;
-  this->MklReflectionNumberBuffer = NULL;
-  this->MklShadowValueBuffer = NULL;
-  this->MklShadowModel = NULL;
-  this->MklGaussianKernel = NULL;
-  this->MklLaplacianKernel = NULL;
+  this->ShadowModelNearRange = 0;
 }
 
 //----------------------------------------------------------------------------
 vtkPlusForoughiBoneSurfaceProbability::~vtkPlusForoughiBoneSurfaceProbability()
 {
-  DeleteKernels();
-  // mkl_free_buffers();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusForoughiBoneSurfaceProbability::SetShadowSigma(double shadowSigma)
+{
+  if (this->ShadowSigma == shadowSigma)
+  {
+    return;
+  }
+  this->ShadowSigma = shadowSigma;
+  // The shadow model is precomputed in UpdateKernels
+  this->KernelUpdateRequested = true;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusForoughiBoneSurfaceProbability::SetSmoothingSigma(double smoothingSigma)
+{
+  if (this->SmoothingSigma == smoothingSigma)
+  {
+    return;
+  }
+  this->SmoothingSigma = smoothingSigma;
+  // The Gaussian kernel is precomputed in UpdateKernels
+  this->KernelUpdateRequested = true;
+  this->Modified();
 }
 
 //----------------------------------------------------------------------------
@@ -97,226 +166,270 @@ void vtkPlusForoughiBoneSurfaceProbability::SimpleExecute(vtkImageData* input, v
     this->KernelUpdateRequested = false;
   }
 
-  int* dims = input->GetDimensions();
-  unsigned int nx = this->FrameSize[0];
-  unsigned int ny = this->FrameSize[1];
-  unsigned int sliceSize = this->FrameSize[0] * this->FrameSize[1];
+  int nx = static_cast<int>(this->FrameSize[0]);
+  int ny = static_cast<int>(this->FrameSize[1]);
+  int sliceSize = nx * ny;
 
   vtkSmartPointer<vtkTimerLog> timer = vtkSmartPointer<vtkTimerLog>::New();
 
   // Loop through each slice
-  for (unsigned int sliceIdx = inputExtent[4]; sliceIdx <= inputExtent[5]; ++sliceIdx)
+  for (int sliceIdx = inputExtent[4]; sliceIdx <= inputExtent[5]; ++sliceIdx)
   {
     LOG_INFO("---------------");
     // Index of slice in buffer
     double* inputSlicePtr = static_cast<double*>(input->GetScalarPointer(0, 0, sliceIdx));
     double* outputSlicePtr = static_cast<double*>(output->GetScalarPointer(0, 0, sliceIdx));
 
-    // If slice has not all zero pixels...
-    //if (GetMaxPixelValue(inputSlicePtr, sliceSize) > 0) // this is expensive and always true (except error cases)
+    // Convolve with Gaussian kernel and normalize result between zero and one
+    timer->StartTimer();
+    GaussianSmooth(inputSlicePtr, &this->GaussianBuffer[0], nx, ny);
+    timer->StopTimer();
+    LOG_INFO("Gaussian smoothing: " << timer->GetElapsedTime());
+
+    timer->StartTimer();
+    Normalize(&this->GaussianBuffer[0], sliceSize, false);
+    timer->StopTimer();
+    LOG_INFO("Normalize 1: " << timer->GetElapsedTime());
+
+    // Convolve blurred image with Laplacian kernel
+    timer->StartTimer();
+    Laplacian(&this->GaussianBuffer[0], &this->LaplacianOfGaussianBuffer[0], nx, ny);
+    timer->StopTimer();
+    LOG_INFO("Laplacian: " << timer->GetElapsedTime());
+
+    // Shadow value of all pixels
+    timer->StartTimer();
+    ComputeShadowValues(&this->GaussianBuffer[0], &this->ShadowValueBuffer[0], nx, ny);
+    timer->StopTimer();
+    LOG_INFO("Shadow values: " << timer->GetElapsedTime());
+
+    // Main loop calculating reflection number and keeping shadow value of bone candidate pixels
+    timer->StartTimer();
+    const double* gaussianBuffer = &this->GaussianBuffer[0];
+    double* laplacianOfGaussianBuffer = &this->LaplacianOfGaussianBuffer[0];
+    double* reflectionNumberBuffer = &this->ReflectionNumberBuffer[0];
+    double* shadowValueBuffer = &this->ShadowValueBuffer[0];
+    for (int y = 0; y < ny; ++y)
     {
-      // Convolve with Gaussian kernel and normalize result between zero and one
-      timer->StartTimer();
-      Conv2(inputSlicePtr, this->MklGaussianKernel, this->MklGaussianBufferTemp, this->MklGaussianBuffer, static_cast<int>(this->FrameSize[0]), static_cast<int>(this->FrameSize[1]), this->GaussianKernelSize, this->GaussianKernelSize);
-      timer->StopTimer();
-      LOG_INFO("Conv2 1: " << timer->GetElapsedTime());
-
-      timer->StartTimer();
-      Normalize(this->MklGaussianBuffer, sliceSize, false);
-      timer->StopTimer();
-      LOG_INFO("Normalize 1: " << timer->GetElapsedTime());
-
-      // Convolve blurred image with Laplacian kernel
-      timer->StartTimer();
-      Conv2(this->MklGaussianBuffer, this->MklLaplacianKernel, this->MklLaplacianOfGaussianBufferTemp, this->MklLaplacianOfGaussianBuffer, static_cast<int>(this->FrameSize[0]), static_cast<int>(this->FrameSize[1]), 3, 3);
-      timer->StopTimer();
-      LOG_INFO("Conv2 2: " << timer->GetElapsedTime());
-
-      // Main loop calculating reflection number and shadow value
-      timer->StartTimer();
-      double sumG = 0;
-      double sumGI = 0;
-      double sumHist = 0;
-      int i, pixelIdx, x, y;
-#ifdef NDEBUG
-      #pragma omp parallel for reduction(+:sumG,sumGI, sumHist), private(i, x, pixelIdx)
-#endif
-      for (y = 0; y < ny; ++y)
+      for (int x = 0; x < nx; ++x)
       {
-        for (x = 0; x < nx; ++x)
-        {
-          pixelIdx = x + y * nx;
+        int pixelIdx = x + y * nx;
 
-          // Only include pixels with intensity value larger than a specified threshold
-          if (this->MklGaussianBuffer[pixelIdx] >= this->BoneThreshold && pixelIdx > this->TransducerMargin * nx)
+        // Only include pixels with intensity value larger than a specified threshold
+        if (gaussianBuffer[pixelIdx] >= this->BoneThreshold && pixelIdx > this->TransducerMargin * nx)
+        {
+          // Set outermost border pixels to zero and exclude negative pixels
+          if ((x == nx - 1 || x == 0 || y == ny - 1 || y == 0) || laplacianOfGaussianBuffer[pixelIdx] <= 0)
           {
-            // Set outermost border pixels to zero and exclude negative pixels
-            if ((x == nx - 1 || x == 0 || y == ny - 1 || y == 0) || this->MklLaplacianOfGaussianBuffer[pixelIdx] <= 0)
-            {
-              this->MklLaplacianOfGaussianBuffer[pixelIdx] = 0.0;
-            }
-            else
-            {
-              // Divide by small number to increase image intensity (What! :)
-              this->MklLaplacianOfGaussianBuffer[pixelIdx] = this->MklLaplacianOfGaussianBuffer[pixelIdx] / 0.005;
-            }
-
-            // Calculate reflection number
-            this->MklReflectionNumberBuffer[pixelIdx] = pow(this->MklGaussianBuffer[pixelIdx], this->BlurredVSBLoG) + this->MklLaplacianOfGaussianBuffer[pixelIdx];
-
-            // Calculate shadow value
-            sumG = 0;
-            sumGI = 0;
-            for (i = y; i < ny; ++i)
-            {
-              sumG += this->MklShadowModel[i - y];
-              sumGI += this->MklShadowModel[i - y] * this->MklGaussianBuffer[x + i * nx];
-            }
-            this->MklShadowValueBuffer[pixelIdx] = sumGI / sumG;
+            laplacianOfGaussianBuffer[pixelIdx] = 0.0;
           }
           else
           {
-            this->MklReflectionNumberBuffer[pixelIdx] = 0.0;
-            this->MklShadowValueBuffer[pixelIdx] = 0.0;
+            // Divide by small number to increase image intensity (What! :)
+            laplacianOfGaussianBuffer[pixelIdx] = laplacianOfGaussianBuffer[pixelIdx] / 0.005;
           }
+
+          // Calculate reflection number
+          reflectionNumberBuffer[pixelIdx] = IntegerPower(gaussianBuffer[pixelIdx], this->BlurredVSBLoG) + laplacianOfGaussianBuffer[pixelIdx];
+        }
+        else
+        {
+          reflectionNumberBuffer[pixelIdx] = 0.0;
+          shadowValueBuffer[pixelIdx] = 0.0;
         }
       }
-
-      timer->StopTimer();
-      LOG_INFO("Main processing: " << timer->GetElapsedTime());
-
-      // Normalize both reflection numbers and shadow values
-      timer->StartTimer();
-      Normalize(this->MklReflectionNumberBuffer, sliceSize, false);
-      Normalize(this->MklShadowValueBuffer, sliceSize, true);
-      timer->StopTimer();
-      LOG_INFO("Normalize 2x: " << timer->GetElapsedTime());
-
-      // Calculate BSP
-      timer->StartTimer();
-      vdPowx(sliceSize, this->MklShadowValueBuffer, this->ShadowVSIntensity, this->MklShadowValueBuffer);
-      vdMul(sliceSize, this->MklShadowValueBuffer, this->MklReflectionNumberBuffer, outputSlicePtr);
-      timer->StopTimer();
-      LOG_INFO("Non-linear transform: " << timer->GetElapsedTime());
-
-      // Normalize BSP
-      timer->StartTimer();
-      Normalize(outputSlicePtr, sliceSize, false, 255);
-      timer->StopTimer();
-      LOG_INFO("Normalize 3: " << timer->GetElapsedTime());
     }
+    timer->StopTimer();
+    LOG_INFO("Main processing: " << timer->GetElapsedTime());
+
+    // Normalize both reflection numbers and shadow values
+    timer->StartTimer();
+    Normalize(reflectionNumberBuffer, sliceSize, false);
+    Normalize(shadowValueBuffer, sliceSize, true);
+    timer->StopTimer();
+    LOG_INFO("Normalize 2x: " << timer->GetElapsedTime());
+
+    // Calculate BSP
+    timer->StartTimer();
+    MultiplyByPower(shadowValueBuffer, this->ShadowVSIntensity, reflectionNumberBuffer, outputSlicePtr, sliceSize);
+    timer->StopTimer();
+    LOG_INFO("Non-linear transform: " << timer->GetElapsedTime());
+
+    // Normalize BSP
+    timer->StartTimer();
+    Normalize(outputSlicePtr, sliceSize, false, 255);
+    timer->StopTimer();
+    LOG_INFO("Normalize 3: " << timer->GetElapsedTime());
   }
 }
 
 //-----------------------------------------------------------------------------
 void vtkPlusForoughiBoneSurfaceProbability::UpdateKernels()
 {
-  DeleteKernels();
-
   this->GaussianKernelSize = floor(this->SmoothingSigma * 3) * 2 + 1;
 
-  // Allocating memory for matrices aligned on 64-byte boundary for better performance
-  this->MklGaussianBuffer = (double*)mkl_malloc(this->FrameSize[0] * this->FrameSize[1] * sizeof(double), 64);
-  this->MklLaplacianOfGaussianBuffer = (double*)mkl_malloc(this->FrameSize[0] * this->FrameSize[1] * sizeof(double), 64);
-  this->MklGaussianBufferTemp = (double*)mkl_malloc((this->FrameSize[0] + GaussianKernelSize - 1) * (this->FrameSize[1]  + GaussianKernelSize - 1) * sizeof(double), 64);
-  this->MklLaplacianOfGaussianBufferTemp = (double*)mkl_malloc((this->FrameSize[0] + 2) * (this->FrameSize[1]  + 2) * sizeof(double), 64);
-  this->MklReflectionNumberBuffer = (double*)mkl_malloc(this->FrameSize[0] * this->FrameSize[1] * sizeof(double), 64);
-  this->MklShadowValueBuffer = (double*)mkl_malloc(this->FrameSize[0] * this->FrameSize[1] * sizeof(double), 64);
-  this->MklShadowModel = (double*)mkl_malloc(this->FrameSize[1] * sizeof(double), 64);
-  this->MklGaussianKernel = (double*)mkl_malloc(GaussianKernelSize * GaussianKernelSize * sizeof(double), 64);
-  this->MklLaplacianKernel = (double*)mkl_malloc(3 * 3 * sizeof(double), 64);
+  const int nx = static_cast<int>(this->FrameSize[0]);
+  const int ny = static_cast<int>(this->FrameSize[1]);
+  const int sliceSize = nx * ny;
+
+  this->GaussianBuffer.resize(sliceSize);
+  this->LaplacianOfGaussianBuffer.resize(sliceSize);
+  this->ReflectionNumberBuffer.resize(sliceSize);
+  this->ShadowValueBuffer.resize(sliceSize);
+  this->GaussianBufferTemp.resize(sliceSize);
+  this->PaddedRowBuffer.resize(nx + this->GaussianKernelSize - 1);
+  this->ColumnSuffixSumBuffer.resize((ny + 1) * nx);
 
   // Calculate shadow model
-  for (int i = 0; i < this->FrameSize[1]; ++i)
+  this->ShadowModel.resize(ny);
+  this->ShadowModelSum.resize(ny + 1);
+  this->ShadowModelNearRange = 0;
+  this->ShadowModelSum[0] = 0.0;
+  for (int i = 0; i < ny; ++i)
   {
-    if (i < this->FrameSize[1] - 5)
+    if (i < ny - 5)
     {
-      this->MklShadowModel[i] = 1 - exp(- (i * i - 1) / (2 * this->ShadowSigma * this->ShadowSigma));
+      double shadowModelComplement = exp(- (i * i - 1) / (2 * this->ShadowSigma * this->ShadowSigma));
+      this->ShadowModel[i] = 1 - shadowModelComplement;
+      if (shadowModelComplement >= SHADOW_MODEL_TOLERANCE)
+      {
+        this->ShadowModelNearRange = i + 1;
+      }
     }
     else
     {
-      this->MklShadowModel[i] = 0.0;
+      this->ShadowModel[i] = 0.0;
     }
+    this->ShadowModelSum[i + 1] = this->ShadowModelSum[i] + this->ShadowModel[i];
   }
 
   // Calculate Gaussian kernel
-  int idx = 0;
-  int intervall = (GaussianKernelSize - 1) / 2;
-  for (double x = -intervall; x <= intervall; ++x)
+  // The 2D kernel exp(-(x^2+y^2)/(2*sigma^2)) is separable, it is the product of two 1D kernels
+  this->GaussianKernel.resize(this->GaussianKernelSize);
+  int intervall = (this->GaussianKernelSize - 1) / 2;
+  for (int x = -intervall; x <= intervall; ++x)
   {
-    for (double y = -intervall; y <= intervall; ++y)
-    {
-      this->MklGaussianKernel [idx] = exp(-((x * x) / (2 * this->SmoothingSigma * this->SmoothingSigma) + (y * y) / (2 * this->SmoothingSigma * this->SmoothingSigma)));
-      ++idx;
-    }
+    this->GaussianKernel[x + intervall] = exp(-(x * x) / (2 * this->SmoothingSigma * this->SmoothingSigma));
   }
-
-  // Calculate Laplacian kernel
-  this->MklLaplacianKernel[0] = 0;
-  this->MklLaplacianKernel[1] = -1;
-  this->MklLaplacianKernel[2] = 0;
-  this->MklLaplacianKernel[3] = -1;
-  this->MklLaplacianKernel[4] = 4;
-  this->MklLaplacianKernel[5] = -1;
-  this->MklLaplacianKernel[6] = 0;
-  this->MklLaplacianKernel[7] = -1;
-  this->MklLaplacianKernel[8] = 0;
 }
 
 //-----------------------------------------------------------------------------
-void vtkPlusForoughiBoneSurfaceProbability::DeleteKernels()
+void vtkPlusForoughiBoneSurfaceProbability::GaussianSmooth(const double* inputBuffer, double* outputBuffer, int nx, int ny)
 {
-  // Free memory
-  MKL_FREE_IF_NULL(this->MklGaussianBuffer);
-  MKL_FREE_IF_NULL(this->MklLaplacianOfGaussianBuffer);
-  MKL_FREE_IF_NULL(this->MklGaussianBufferTemp);
-  MKL_FREE_IF_NULL(this->MklLaplacianOfGaussianBufferTemp);
-  MKL_FREE_IF_NULL(this->MklReflectionNumberBuffer);
-  MKL_FREE_IF_NULL(this->MklShadowValueBuffer);
-  MKL_FREE_IF_NULL(this->MklShadowModel);
-  MKL_FREE_IF_NULL(this->MklGaussianKernel);
-  MKL_FREE_IF_NULL(this->MklLaplacianKernel);
+  const int kernelSize = this->GaussianKernelSize;
+  const int kernelRadius = (kernelSize - 1) / 2;
+  const double* kernel = &this->GaussianKernel[0];
+  double* paddedRow = &this->PaddedRowBuffer[0];
+  double* rowSmoothed = &this->GaussianBufferTemp[0];
+
+  // Convolve along rows
+  std::fill(this->PaddedRowBuffer.begin(), this->PaddedRowBuffer.end(), 0.0);
+  for (int y = 0; y < ny; ++y)
+  {
+    std::copy(inputBuffer + y * nx, inputBuffer + (y + 1) * nx, paddedRow + kernelRadius);
+    double* outputRow = rowSmoothed + y * nx;
+    std::fill(outputRow, outputRow + nx, 0.0);
+    for (int k = 0; k < kernelSize; ++k)
+    {
+      AddWeightedRow(paddedRow + k, kernel[k], outputRow, nx);
+    }
+  }
+
+  // Convolve along columns
+  for (int y = 0; y < ny; ++y)
+  {
+    double* outputRow = outputBuffer + y * nx;
+    std::fill(outputRow, outputRow + nx, 0.0);
+    const int firstRow = std::max(y - kernelRadius, 0);
+    const int lastRow = std::min(y + kernelRadius, ny - 1);
+    for (int inputRow = firstRow; inputRow <= lastRow; ++inputRow)
+    {
+      AddWeightedRow(rowSmoothed + inputRow * nx, kernel[inputRow - y + kernelRadius], outputRow, nx);
+    }
+  }
 }
 
 //-----------------------------------------------------------------------------
-// Performs a 2D convolution using Intel MKL defined by the kernel buffer.
-void vtkPlusForoughiBoneSurfaceProbability::Conv2(const double* inputBuffer, const double* kernelBuffer, double* tempBuffer, double* outputBuffer, int nx, int ny, int kx, int ky)
+void vtkPlusForoughiBoneSurfaceProbability::Laplacian(const double* inputBuffer, double* outputBuffer, int nx, int ny)
 {
-  int inputShape[] = {nx, ny};
-  int kernelShape[] = {kx, ky};
-  int resultShape[] = {nx + kx - 1, ny + ky - 1};
-
-  VSLConvTaskPtr task;
-  int status = vsldConvNewTask(&task, VSL_CONV_MODE_AUTO, 2, inputShape, kernelShape, resultShape);
-
-  status = vsldConvExec(task, inputBuffer, NULL, kernelBuffer, NULL, tempBuffer, NULL);
-  vslConvDeleteTask(&task);
-
-  vtkSmartPointer<vtkTimerLog> timer = vtkSmartPointer<vtkTimerLog>::New();
-  timer->StartTimer();
-  ResizeMatrix(tempBuffer, outputBuffer, kx, ky, nx + kx - 1, ny + ky - 1);
-  timer->StopTimer();
-  LOG_INFO("Resizematrix: " << timer->GetElapsedTime());
+  // Kernel: [0 -1 0; -1 4 -1; 0 -1 0]
+  for (int y = 0; y < ny; ++y)
+  {
+    const double* inputRow = inputBuffer + y * nx;
+    double* outputRow = outputBuffer + y * nx;
+    for (int x = 0; x < nx; ++x)
+    {
+      outputRow[x] = 4 * inputRow[x];
+    }
+    for (int x = 1; x < nx; ++x)
+    {
+      outputRow[x] -= inputRow[x - 1];
+    }
+    for (int x = 0; x < nx - 1; ++x)
+    {
+      outputRow[x] -= inputRow[x + 1];
+    }
+    if (y > 0)
+    {
+      AddWeightedRow(inputRow - nx, -1.0, outputRow, nx);
+    }
+    if (y < ny - 1)
+    {
+      AddWeightedRow(inputRow + nx, -1.0, outputRow, nx);
+    }
+  }
 }
 
 //-----------------------------------------------------------------------------
-void vtkPlusForoughiBoneSurfaceProbability::ResizeMatrix(const double* inputBuffer, double* outputBuffer, int xClipping, int yClipping, int xInputSize, int yInputSize)
+void vtkPlusForoughiBoneSurfaceProbability::ComputeShadowValues(const double* inputBuffer, double* outputBuffer, int nx, int ny)
 {
-  int xStart = (xClipping + 2 - 1) / 2 - 1;
-  int yStart = (yClipping + 2 - 1) / 2 - 1;
-  int xStop = xInputSize - xStart;
-  int yStop = yInputSize - yStart;
+  // The shadow value of pixel (x,y) is sum(G[d]*I[x,y+d])/sum(G[d]) for d=0..dMax, where G is the shadow model.
+  // G[d] = 1-g[d], where g[d] is negligible beyond ShadowModelNearRange, therefore
+  // sum(G[d]*I[x,y+d]) = sum(I[x,y+d]) - sum(g[d]*I[x,y+d]), where the first sum is obtained from
+  // the reverse cumulative sum of the column and the second sum is only computed for d<ShadowModelNearRange.
+
+  // Reverse cumulative sum of the columns
+  double* suffixSum = &this->ColumnSuffixSumBuffer[0];
+  std::fill(suffixSum + ny * nx, suffixSum + (ny + 1) * nx, 0.0);
+  for (int y = ny - 1; y >= 0; --y)
+  {
+    const double* inputRow = inputBuffer + y * nx;
+    const double* nextSumRow = suffixSum + (y + 1) * nx;
+    double* sumRow = suffixSum + y * nx;
+    for (int x = 0; x < nx; ++x)
+    {
+      sumRow[x] = nextSumRow[x] + inputRow[x];
+    }
+  }
 
-  int idx = 0;
-  for (int y = 0; y < yInputSize; ++y)
+  for (int y = 0; y < ny; ++y)
   {
-    for (int x = 0; x < xInputSize; ++x)
+    double* outputRow = outputBuffer + y * nx;
+
+    // Shadow model weights are zero for the last 5 rows (d >= ny-5)
+    const int numberOfRowsBelow = std::min(ny - y, ny - 5);
+    const double sumG = (numberOfRowsBelow > 0 ? this->ShadowModelSum[numberOfRowsBelow] : 0.0);
+    if (numberOfRowsBelow <= 0 || sumG == 0.0)
     {
-      if (x >= xStart && x < xStop && y >= yStart && y < yStop)
-      {
-        outputBuffer[idx] = inputBuffer[x + y * xInputSize];
-        ++idx;
-      }
+      std::fill(outputRow, outputRow + nx, 0.0);
+      continue;
+    }
+
+    const double* firstSumRow = suffixSum + y * nx;
+    const double* lastSumRow = suffixSum + (y + numberOfRowsBelow) * nx;
+    for (int x = 0; x < nx; ++x)
+    {
+      outputRow[x] = firstSumRow[x] - lastSumRow[x];
+    }
+    const int nearRange = std::min(numberOfRowsBelow, this->ShadowModelNearRange);
+    for (int d = 0; d < nearRange; ++d)
+    {
+      AddWeightedRow(inputBuffer + (y + d) * nx, this->ShadowModel[d] - 1.0, outputRow, nx);
+    }
+    const double inverseSumG = 1.0 / sumG;
+    for (int x = 0; x < nx; ++x)
+    {
+      outputRow[x] *= inverseSumG;
     }
   }
 }
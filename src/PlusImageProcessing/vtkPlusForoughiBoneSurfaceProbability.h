@@ -18,11 +18,13 @@ Foroughi, P., et al. (2007) Ultrasound bone segmentation using dynamic programmi
 
 Implemented (with some modifications) by Mikael Brudfors, March 2014.
 
-The *Intel MKL* code uses double data at this moment, therefore input and output must be double scalar type image.
+Input and output must be double scalar type image.
 
-The module uses *OpenMP* and *Intel MKL*. A free trial of *Intel MKL* can be downloaded from here:
-
-[https://software.intel.com/en-us/intel-mkl/try-buy](https://software.intel.com/en-us/intel-mkl/try-buy)
+The shadow value of a pixel is the weighted average of the blurred intensities below it. It is computed
+for all pixels of a column in one pass from the reverse cumulative sum of the column: the shadow model weight
+differs from 1 only in a short range (a few ShadowSigma) below the pixel, so only that range needs to be
+summed individually. The Gaussian blurring uses a separable kernel. All kernels process the image row by row
+so that the inner loops run over contiguous memory and can be vectorized by the compiler.
 
 \ingroup PlusLibImageProcessingAlgo
 */
@@ -32,6 +34,8 @@ The module uses *OpenMP* and *Intel MKL*. A free trial of *Intel MKL* can be dow
 #include "vtkSimpleImageToImageFilter.h"
 #include "vtkSmartPointer.h"
 
+#include <vector>
+
 class vtkPlusImageProcessingExport vtkPlusForoughiBoneSurfaceProbability : public vtkSimpleImageToImageFilter
 {
 public:
@@ -47,7 +51,7 @@ public:
   vtkGetMacro(BoneThreshold, double);
 
   /*! Standard deviation of the Gaussian weighting function which models the transition of high intensity pixels close to bone surface to the dark pixels deeper under the bone. */
-  vtkSetMacro(ShadowSigma, double);
+  virtual void SetShadowSigma(double shadowSigma);
   vtkGetMacro(ShadowSigma, double);
 
   /* Controls the ratio between the shadow map and the reflection number. */
@@ -55,7 +59,7 @@ public:
   vtkGetMacro(ShadowVSIntensity, int);
 
   /*! Defines the size of the Gaussian kernel used for blurring. */
-  vtkSetMacro(SmoothingSigma, double);
+  virtual void SetSmoothingSigma(double smoothingSigma);
   vtkGetMacro(SmoothingSigma, double);
 
   /*! Defines the number of rows to exclude from the top part of the image (close to the transducer head). */
@@ -67,11 +71,16 @@ protected:
   virtual ~vtkPlusForoughiBoneSurfaceProbability();
 
   void UpdateKernels();
-  void DeleteKernels();
 
-  void Foroughi2007(double* inputBuffer, double* outputBuffer, double smoothingSigma, int transducerMargin, double shadowSigma, double boneThreshold, int blurredVSBLoG, int shadowVSIntensity, int nx, int ny, int nz);
-  void Conv2(const double* inputBuffer, const double* kernelBuffer, double* tempBuffer, double* outputBuffer, int nx, int ny, int kx, int ky);
-  void ResizeMatrix(const double* inputBuffer, double* outputBuffer, int xClipping, int yClipping, int xInputSize, int yInputSize);
+  /*! Convolve the image with the Gaussian kernel. The output has the same size as the input, pixels outside the image are considered zero. */
+  void GaussianSmooth(const double* inputBuffer, double* outputBuffer, int nx, int ny);
+
+  /*! Convolve the image with the 3x3 Laplacian kernel. The output has the same size as the input, pixels outside the image are considered zero. */
+  void Laplacian(const double* inputBuffer, double* outputBuffer, int nx, int ny);
+
+  /*! Compute the shadow value (weighted average of the intensities below the pixel, weighted by the shadow model) for all pixels */
+  void ComputeShadowValues(const double* inputBuffer, double* outputBuffer, int nx, int ny);
+
   double GetMaxPixelValue(const double* buffer, int size);
   void Normalize(double* buffer, int size, bool doInverse, double maxValue = 1.0);
 
@@ -89,15 +98,27 @@ protected:
   int GaussianKernelSize;
   FrameSizeType FrameSize;
 
-  double* MklGaussianBuffer;
-  double* MklLaplacianOfGaussianBuffer;
-  double* MklGaussianBufferTemp;
-  double* MklLaplacianOfGaussianBufferTemp;
-  double* MklReflectionNumberBuffer;
-  double* MklShadowValueBuffer;
-  double* MklShadowModel;
-  double* MklGaussianKernel;
-  double* MklLaplacianKernel;
+  std::vector<double> GaussianBuffer;
+  std::vector<double> LaplacianOfGaussianBuffer;
+  std::vector<double> ReflectionNumberBuffer;
+  std::vector<double> ShadowValueBuffer;
+
+  /*! Intermediate result of the separable convolution (image blurred along rows only) */
+  std::vector<double> GaussianBufferTemp;
+  /*! One image row padded with zeros by the half Gaussian kernel size on both sides */
+  std::vector<double> PaddedRowBuffer;
+  /*! Reverse cumulative sum of the columns of the blurred image: row y contains the sum of the rows y..ny-1, row ny is zero */
+  std::vector<double> ColumnSuffixSumBuffer;
+
+  /*! Weight of the intensity d rows below the pixel in the shadow value */
+  std::vector<double> ShadowModel;
+  /*! ShadowModelSum[n] is the sum of the first n shadow model weights */
+  std::vector<double> ShadowModelSum;
+  /*! Number of shadow model weights that differ from 1 by a non-negligible amount */
+  int ShadowModelNearRange;
+
+  /*! 1D Gaussian kernel, the 2D kernel is the outer product of this kernel with itself */
+  std::vector<double> GaussianKernel;
 
 private:
   vtkPlusForoughiBoneSurfaceProbability(const vtkPlusForoughiBoneSurfaceProbability&);  // Not implemented.
@@ -15,6 +15,7 @@ See License.txt for details.
 #include "vtkStreamingDemandDrivenPipeline.h"
 #include "vtkMath.h"
 
+#include <algorithm>
 #include <math.h>
 
 vtkStandardNewMacro(vtkPlusRfToBrightnessConvert);
@@ -28,6 +29,8 @@ vtkPlusRfToBrightnessConvert::vtkPlusRfToBrightnessConvert()
   this->ImageType=US_IMG_TYPE_XX;
   this->BrightnessScale=10.0;
   this->NumberOfHilbertFilterCoeffs=64;
+  this->HilbertTransformMethod=HILBERT_TRANSFORM_CONVOLUTION;
+  this->DecimationFactor=1;
 }
 
 //----------------------------------------------------------------------------
@@ -50,7 +53,11 @@ int vtkPlusRfToBrightnessConvert::RequestInformation(vtkInformation*,
   // Set the output extent to be the same as the input extent by default
   int outExt[6]={0};
   inInfo->Get(vtkStreamingDemandDrivenPipeline::WHOLE_EXTENT(), outExt);
-  
+
+  // Number of samples along the scanline in the input (RF) and output (B-mode) image
+  int numberOfRfSamplesInScanline=inExt[1]-inExt[0]+1;
+  int numberOfBmodeSamplesInScanline=(numberOfRfSamplesInScanline+this->DecimationFactor-1)/this->DecimationFactor;
+
   // Update the output image extent depending on the RF encoding type
   switch (this->ImageType)
   {
@@ -67,23 +74,38 @@ int vtkPlusRfToBrightnessConvert::RequestInformation(vtkInformation*,
       int numberOfBmodeRows=(inExt[3]-inExt[2]+1)/2;
       outExt[2] = inExt[2]/2;
       outExt[3] = outExt[2] + numberOfBmodeRows - 1;
+      // => number of columns in the output image is reduced by the decimation factor
+      outExt[0] = inExt[0]/this->DecimationFactor;
+      outExt[1] = outExt[0] + numberOfBmodeSamplesInScanline - 1;
     }
     break;
   case US_IMG_RF_REAL:
     {
       // RF data: III..., III...
       // B-mode data: BBB..., BBB...
-      // => the output image size is the same as the input image size
-      // keep the default extent
+      // => the output image size is the same as the input image size, except the number of columns
+      // is reduced by the decimation factor
+      outExt[0] = inExt[0]/this->DecimationFactor;
+      outExt[1] = outExt[0] + numberOfBmodeSamplesInScanline - 1;
+      if (this->HilbertTransformMethod==HILBERT_TRANSFORM_FFT)
+      {
+        // Update the FFT plan (it is only recomputed if the scanline length changed)
+        if (this->HilbertTransformFft.SetSize(PlusFft::GetNextPowerOfTwo(numberOfRfSamplesInScanline)) != PLUS_SUCCESS)
+        {
+          vtkErrorMacro("Failed to prepare FFT for " << numberOfRfSamplesInScanline << " samples");
+          return 0;
+        }
+      }
     }
     break;
   case US_IMG_RF_IQ_LINE:
     {
       // RF data: IQIQIQ....., IQIQIQ.....
       // B-mode data: BBB..., BBB...
-      // => number of columns in the output image is half of the columns in the input image
-      int numberOfBmodeColumns=(inExt[1]-inExt[0]+1)/2;
-      outExt[0] = inExt[0]/2;
+      // => number of columns in the output image is half of the columns in the input image (divided by the decimation factor)
+      int numberOfIqPairs=numberOfRfSamplesInScanline/2;
+      int numberOfBmodeColumns=(numberOfIqPairs+this->DecimationFactor-1)/this->DecimationFactor;
+      outExt[0] = inExt[0]/(2*this->DecimationFactor);
       outExt[1] = outExt[0] + numberOfBmodeColumns - 1;
     }
     break;
@@ -129,6 +151,7 @@ void vtkPlusRfToBrightnessConvert::ThreadedRequestData(
   }
 
   int inExt[6]={outExt[0], outExt[1], outExt[2], outExt[3], outExt[4], outExt[5]};
+  int* inWholeExt=inData[0][0]->GetExtent();
   // Get the input extent for the output extent
   switch (this->ImageType)
   {
@@ -145,14 +168,19 @@ void vtkPlusRfToBrightnessConvert::ThreadedRequestData(
       int numberOfRfRows=numberOfBmodeRows*2;
       inExt[2] = outExt[2]*2;
       inExt[3] = inExt[2] + numberOfRfRows - 1;
+      // => number of columns in the output image is reduced by the decimation factor
+      inExt[0] = outExt[0]*this->DecimationFactor;
+      inExt[1] = std::min(inExt[0] + (outExt[1]-outExt[0]+1)*this->DecimationFactor - 1, inWholeExt[1]);
     }
     break;
   case US_IMG_RF_REAL:
     {
       // RF data: III..., III...
       // B-mode data: BBB..., BBB...
-      // => the output image size is the same as the input image size
-      // keep the default extent
+      // => the output image size is the same as the input image size, except the number of columns
+      // is reduced by the decimation factor
+      inExt[0] = outExt[0]*this->DecimationFactor;
+      inExt[1] = std::min(inExt[0] + (outExt[1]-outExt[0]+1)*this->DecimationFactor - 1, inWholeExt[1]);
     }
     break;
   case US_IMG_RF_IQ_LINE:
@@ -161,9 +189,9 @@ void vtkPlusRfToBrightnessConvert::ThreadedRequestData(
       // B-mode data: BBB..., BBB...
       // => number of columns in the output image is half of the columns in the input image
       int numberOfBmodeColumns=outExt[1]-outExt[0]+1;
-      int numberOfRfColumns=numberOfBmodeColumns*2;
-      inExt[0] = outExt[0]*2;
-      inExt[1] = inExt[0] + numberOfRfColumns - 1;
+      int numberOfRfColumns=numberOfBmodeColumns*2*this->DecimationFactor;
+      inExt[0] = outExt[0]*2*this->DecimationFactor;
+      inExt[1] = std::min(inExt[0] + numberOfRfColumns - 1, inWholeExt[1]);
     }
     break;
   default:
@@ -240,6 +268,55 @@ void vtkPlusRfToBrightnessConvert::ThreadedLineByLineHilbertTransform(int inExt[
     return;
   }
 
+  if (this->ImageType==US_IMG_RF_REAL && this->HilbertTransformMethod==HILBERT_TRANSFORM_FFT)
+  {
+    if (this->HilbertTransformFft.GetSize()<static_cast<unsigned int>(numberOfRfSamplesInScanline))
+    {
+      LOG_ERROR("FFT size ("<<this->HilbertTransformFft.GetSize()<<") is smaller than the scanline length ("<<numberOfRfSamplesInScanline<<")");
+      return;
+    }
+    // One complex FFT computes the Hilbert transform of two real scanlines, so scanlines are processed in pairs
+    std::vector<PlusFft::ComplexType> fftBuffer(this->HilbertTransformFft.GetSize());
+    ScalarType* pendingInPtr=NULL;
+    unsigned char* pendingOutPtr=NULL;
+    for (int idx2 = outExt[4]; idx2 <= outExt[5]; ++idx2)
+    {
+      for (int idx1 = outExt[2]; !this->AbortExecute && idx1 <= outExt[3]; ++idx1)
+      {
+        if (threadId==0)
+        {
+          // it is the first thread, report progress
+          if (!(count%target))
+          {
+            this->UpdateProgress(count/(50.0*target));
+          }
+          count++;
+        }
+        if (pendingInPtr==NULL)
+        {
+          pendingInPtr=inPtr;
+          pendingOutPtr=outPtr;
+        }
+        else
+        {
+          ComputeAmplitudeFft(pendingOutPtr, pendingInPtr, outPtr, inPtr, numberOfRfSamplesInScanline, &fftBuffer[0]);
+          pendingInPtr=NULL;
+          pendingOutPtr=NULL;
+        }
+        inPtr += numberOfRfSamplesInScanline+inInc1;
+        outPtr += numberOfBmodeSamplesInScanline+outInc1;
+      }
+      inPtr += inInc2;
+      outPtr += outInc2;
+    }
+    if (pendingInPtr!=NULL)
+    {
+      // odd number of scanlines
+      ComputeAmplitudeFft(pendingOutPtr, pendingInPtr, static_cast<unsigned char*>(NULL), static_cast<ScalarType*>(NULL), numberOfRfSamplesInScanline, &fftBuffer[0]);
+    }
+    return;
+  }
+
   ScalarType* hilbertTransformBuffer = new ScalarType[numberOfRfSamplesInScanline + 1];
   for (int idx2 = outExt[4]; idx2 <= outExt[5]; ++idx2)
   {
@@ -306,6 +383,10 @@ void vtkPlusRfToBrightnessConvert::ThreadedLineByLineHilbertTransform(int inExt[
 void vtkPlusRfToBrightnessConvert::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os,indent);
+  os << indent << "BrightnessScale: " << this->BrightnessScale << std::endl;
+  os << indent << "NumberOfHilbertFilterCoeffs: " << this->NumberOfHilbertFilterCoeffs << std::endl;
+  os << indent << "HilbertTransformMethod: " << (this->HilbertTransformMethod==HILBERT_TRANSFORM_FFT ? "FFT" : "CONVOLUTION") << std::endl;
+  os << indent << "DecimationFactor: " << this->DecimationFactor << std::endl;
 }
 
 //-----------------------------------------------------------------------------
@@ -315,6 +396,8 @@ PlusStatus vtkPlusRfToBrightnessConvert::ReadConfiguration(vtkXMLDataElement* rf
   XML_VERIFY_ELEMENT(rfToBrightnessElement, "RfToBrightnessConversion");
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfHilbertFilterCoeffs, rfToBrightnessElement);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, BrightnessScale, rfToBrightnessElement);
+  XML_READ_ENUM2_ATTRIBUTE_OPTIONAL(HilbertTransformMethod, rfToBrightnessElement, "CONVOLUTION", HILBERT_TRANSFORM_CONVOLUTION, "FFT", HILBERT_TRANSFORM_FFT);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, DecimationFactor, rfToBrightnessElement);
   return PLUS_SUCCESS;
 }
 
@@ -327,6 +410,8 @@ PlusStatus vtkPlusRfToBrightnessConvert::WriteConfiguration(vtkXMLDataElement* r
 
   rfToBrightnessElement->SetDoubleAttribute("NumberOfHilbertFilterCoeffs", this->NumberOfHilbertFilterCoeffs);
   rfToBrightnessElement->SetDoubleAttribute("BrightnessScale", this->BrightnessScale);
+  rfToBrightnessElement->SetAttribute("HilbertTransformMethod", this->HilbertTransformMethod==HILBERT_TRANSFORM_FFT ? "FFT" : "CONVOLUTION");
+  rfToBrightnessElement->SetIntAttribute("DecimationFactor", this->DecimationFactor);
 
   return PLUS_SUCCESS;
 }
@@ -409,50 +494,91 @@ PlusStatus vtkPlusRfToBrightnessConvert::ComputeHilbertTransform(ScalarType *hil
   return PLUS_SUCCESS;
 }
 
-template<typename ScalarType>
-void vtkPlusRfToBrightnessConvert::ComputeAmplitudeILineQLine(unsigned char *ampl, ScalarType *inputSignal, ScalarType *inputSignalHilbertTransformed, int npt)
+//-----------------------------------------------------------------------------
+unsigned char vtkPlusRfToBrightnessConvert::ComputeBrightness(double xt, double xht) const
 {
-  for (int i=0; i<this->NumberOfHilbertFilterCoeffs/2+1; i++)
+  double brightnessValue = sqrt(sqrt(sqrt(xt*xt+xht*xht)))*this->BrightnessScale;
+  if (brightnessValue>MAX_BRIGHTNESS_VALUE) brightnessValue=MAX_BRIGHTNESS_VALUE;
+  if (brightnessValue<MIN_BRIGHTNESS_VALUE) brightnessValue=MIN_BRIGHTNESS_VALUE;
+  return static_cast<unsigned char>(brightnessValue);
+  /*
+  If needed, the phase could be computed as follows:
+  phase[i] = atan2(xht ,xt);
+  omega[i] = phase[i]-phase[i-1];
+  if (omega[i]<0)
   {
-    ampl[i]=0;
+    omega[i]+=2*pi;
   }
-  for (int i=this->NumberOfHilbertFilterCoeffs/2+1; i<=npt-this->NumberOfHilbertFilterCoeffs/2; i++) 
+  */
+}
+
+template<typename ScalarType>
+void vtkPlusRfToBrightnessConvert::ComputeAmplitudeILineQLine(unsigned char *ampl, ScalarType *inputSignal, ScalarType *inputSignalHilbertTransformed, int npt)
+{
+  // samples at the edges are not valid, because the convolution filter does not fit there
+  int firstValidSample=this->NumberOfHilbertFilterCoeffs/2+1;
+  int lastValidSample=npt-this->NumberOfHilbertFilterCoeffs/2;
+  int outputIndex=0;
+  for (int i=0; i<npt; i+=this->DecimationFactor)
   {
-    double xt = inputSignal[i];
-    double xht = inputSignalHilbertTransformed[i];
-    double brightnessValue = sqrt(sqrt(sqrt(xt*xt+xht*xht)))*this->BrightnessScale;
-    if (brightnessValue>MAX_BRIGHTNESS_VALUE) brightnessValue=MAX_BRIGHTNESS_VALUE;
-    if (brightnessValue<MIN_BRIGHTNESS_VALUE) brightnessValue=MIN_BRIGHTNESS_VALUE;
-    ampl[i]=brightnessValue;
-    /*
-    If needed, the phase could be computed as follows:
-    phase[i] = atan2(xht ,xt);
-    omega[i] = phase[i]-phase[i-1];
-    if (omega[i]<0)
+    if (i<firstValidSample || i>lastValidSample)
     {
-      omega[i]+=2*pi;
+      ampl[outputIndex++]=0;
+      continue;
     }
-    */
+    ampl[outputIndex++]=ComputeBrightness(inputSignal[i], inputSignalHilbertTransformed[i]);
+  }
+}
+
+template<typename ScalarType>
+void vtkPlusRfToBrightnessConvert::ComputeAmplitudeFft(unsigned char *firstAmpl, ScalarType *firstSignal, unsigned char *secondAmpl, ScalarType *secondSignal, int npt, PlusFft::ComplexType* fftBuffer)
+{
+  const int fftSize=this->HilbertTransformFft.GetSize();
+  for (int i=0; i<npt; i++)
+  {
+    fftBuffer[i]=PlusFft::ComplexType(firstSignal[i], secondSignal ? secondSignal[i] : 0.0);
   }
-  for (int i=npt-this->NumberOfHilbertFilterCoeffs/2+1; i<npt; i++)
+  for (int i=npt; i<fftSize; i++)
+  {
+    fftBuffer[i]=0.0;
+  }
+
+  this->HilbertTransformFft.Forward(fftBuffer);
+
+  // Hilbert transform: multiply positive frequencies by -i and negative frequencies by +i, remove DC and Nyquist components.
+  // The transform maps real signals to real signals, therefore the Hilbert transform of the first signal
+  // is in the real part and the Hilbert transform of the second signal is in the imaginary part of the result.
+  fftBuffer[0]=0.0;
+  fftBuffer[fftSize/2]=0.0;
+  for (int k=1; k<fftSize/2; k++)
   {
-    ampl[i]=0;
+    fftBuffer[k]=PlusFft::ComplexType(fftBuffer[k].imag(), -fftBuffer[k].real());
+    fftBuffer[fftSize-k]=PlusFft::ComplexType(-fftBuffer[fftSize-k].imag(), fftBuffer[fftSize-k].real());
+  }
+
+  this->HilbertTransformFft.Inverse(fftBuffer);
+
+  int outputIndex=0;
+  for (int i=0; i<npt; i+=this->DecimationFactor)
+  {
+    firstAmpl[outputIndex]=ComputeBrightness(firstSignal[i], fftBuffer[i].real());
+    if (secondSignal)
+    {
+      secondAmpl[outputIndex]=ComputeBrightness(secondSignal[i], fftBuffer[i].imag());
+    }
+    outputIndex++;
   }
 }
 
 template<typename ScalarType>
 void vtkPlusRfToBrightnessConvert::ComputeAmplitudeIqLine(unsigned char *ampl, ScalarType *inputSignal, const int npt)
 {
-  int inputIndex=0;
   int outputIndex=0;
   int numberOfIqPairs=floor(double(npt)/2);
-  for (int i=0; i<numberOfIqPairs; i++) 
+  for (int i=0; i<numberOfIqPairs; i+=this->DecimationFactor) 
   {
-    double xt = inputSignal[inputIndex++];
-    double xht = inputSignal[inputIndex++];
-    double outputValue=sqrt(sqrt(sqrt(xt*xt+xht*xht)))*this->BrightnessScale;
-    if (outputValue>MAX_BRIGHTNESS_VALUE) outputValue=MAX_BRIGHTNESS_VALUE;
-    if (outputValue<MIN_BRIGHTNESS_VALUE) outputValue=MIN_BRIGHTNESS_VALUE;
-    ampl[outputIndex++] = outputValue;
+    double xt = inputSignal[2*i];
+    double xht = inputSignal[2*i+1];
+    ampl[outputIndex++] = ComputeBrightness(xt, xht);
   }
 }
@@ -10,6 +10,8 @@
 #include "vtkPlusImageProcessingExport.h"
 #include "vtkThreadedImageAlgorithm.h"
 
+#include "PlusFft.h"
+
 /*!
 \class vtkPlusRfToBrightnessConvert
 \brief This class converts ultrasound RF data to brightness values
@@ -20,7 +22,13 @@ compression of the RF data.
 Envelope detection (estimation of the amplitude of the RF signal) is performed by computing
 the Euclidean norm of the RF signal (in-phase, I) and a 90deg phase shifted version of the
 RF signal (quadrature, Q). The Q signal may be provided by the acquisition system or can be
-computed from the I signal by a Hilbert transform.
+computed from the I signal by a Hilbert transform. The Hilbert transform can be computed
+by convolution with a finite-length filter (default) or by FFT (exact transform of the whole scanline,
+faster for long scanlines). In FFT mode two scanlines are transformed at once and the FFT plan is
+computed only when the scanline length changes.
+
+Optionally, the brightness is only computed for every DecimationFactor-th sample of the scanlines,
+so that envelope detection and compression run at the (lower) resolution of the output image.
 
 Dynamic range compression converts the 16-bit input signal to 8-bit by a non-linear function.
 In this filter the compressedSignal=sqrt(sqrt(envelopeDetected))*BrightnessScale function is used.
@@ -56,6 +64,22 @@ public:
   vtkSetMacro(BrightnessScale, double);
   vtkGetMacro(BrightnessScale, double);
 
+  enum HilbertTransformMethodType
+  {
+    HILBERT_TRANSFORM_CONVOLUTION,
+    HILBERT_TRANSFORM_FFT
+  };
+
+  /*! Specify how the Hilbert transform of real RF data (US_IMG_RF_REAL) is computed */
+  vtkSetMacro(HilbertTransformMethod, HilbertTransformMethodType);
+  vtkGetMacro(HilbertTransformMethod, HilbertTransformMethodType);
+  void SetHilbertTransformMethodToConvolution() { this->SetHilbertTransformMethod(HILBERT_TRANSFORM_CONVOLUTION); }
+  void SetHilbertTransformMethodToFft() { this->SetHilbertTransformMethod(HILBERT_TRANSFORM_FFT); }
+
+  /*! Number of RF samples along the scanline for each output sample. 1 means no decimation. Not used for US_IMG_BRIGHTNESS. */
+  vtkSetClampMacro(DecimationFactor, int, 1, VTK_INT_MAX);
+  vtkGetMacro(DecimationFactor, int);
+
 protected:
   vtkPlusRfToBrightnessConvert();
   ~vtkPlusRfToBrightnessConvert();
@@ -89,6 +113,18 @@ protected:
   template<typename ScalarType>
   void ComputeAmplitudeIqLine(unsigned char *ampl, ScalarType *inputSignal, const int npt);
 
+  /*!
+    Compute amplitude of two real RF signals using FFT-based Hilbert transform. The two signals are transformed
+    together, the first in the real and the second in the imaginary part of fftBuffer.
+    secondAmpl and secondSignal may be NULL if there is only one signal to process.
+    npt is the number of samples in each input signal, fftBuffer must contain HilbertTransformFft.GetSize() elements.
+  */
+  template<typename ScalarType>
+  void ComputeAmplitudeFft(unsigned char *firstAmpl, ScalarType *firstSignal, unsigned char *secondAmpl, ScalarType *secondSignal, int npt, PlusFft::ComplexType* fftBuffer);
+
+  /*! Compute the brightness value from the in-phase and quadrature components of the signal (envelope detection and dynamic range compression) */
+  unsigned char ComputeBrightness(double xt, double xht) const;
+
   /*! Scaling of the brightness output. Higher value means brighter image. */
   double BrightnessScale;
 
@@ -98,6 +134,15 @@ protected:
   /*! Coefficients of the Hilbert transform, computed from the NumberOfHilbertFilterCoeffs */
   std::vector<double> HilbertTransformCoeffs;
 
+  /*! Method of computing the Hilbert transform of real RF data */
+  HilbertTransformMethodType HilbertTransformMethod;
+
+  /*! FFT plan for the Hilbert transform, updated in RequestInformation when the scanline length changes */
+  PlusFft HilbertTransformFft;
+
+  /*! Number of RF samples along the scanline for each output sample */
+  int DecimationFactor;
+
   /*! Image type (RF_IQ_LINE, RF_I_LINE_Q_LINE, ...) */
   US_IMAGE_TYPE ImageType;
 
@@ -31,6 +31,21 @@ non-commercial terms in your toolbox and distribute it."
 #include <math.h>
 #include <string.h>
 #include <ctype.h>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+  #define PLUS_SCAN_CONVERT_X86
+  #include <immintrin.h>
+  #if defined(_MSC_VER)
+    #include <intrin.h>
+    #define PLUS_SCAN_CONVERT_TARGET_SSE41
+    #define PLUS_SCAN_CONVERT_TARGET_AVX2
+  #else
+    // Vectorized kernels are compiled for the specific instruction set, they are only called if the processor supports it
+    #define PLUS_SCAN_CONVERT_TARGET_SSE41 __attribute__((target("sse4.1")))
+    #define PLUS_SCAN_CONVERT_TARGET_AVX2 __attribute__((target("avx2")))
+  #endif
+#endif
 
 vtkStandardNewMacro( vtkPlusUsScanConvertCurvilinear );
 
@@ -43,8 +58,9 @@ vtkPlusUsScanConvertCurvilinear::vtkPlusUsScanConvertCurvilinear()
   this->ThetaStartDeg = -30.0;
   this->ThetaStopDeg = 30.0;
   this->OutputIntensityScaling = 1.0;
+  this->VectorizationEnabled = true;
 
-  // Values that are used for computing the InterpolatedPointArray
+  // Values that are used for computing the InterpolatedPoints table
   this->InterpInputImageExtent[0] = 0;
   this->InterpInputImageExtent[1] = -1;
   this->InterpInputImageExtent[2] = 0;
@@ -74,6 +90,28 @@ vtkPlusUsScanConvertCurvilinear::~vtkPlusUsScanConvertCurvilinear()
 {
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusUsScanConvertCurvilinear::InterpolatedPointTable::Clear()
+{
+  this->InputPixelIndices.clear();
+  this->OutputPixelIndices.clear();
+  for ( int i = 0; i < 4; i++ )
+  {
+    this->WeightCoefficients[i].clear();
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusUsScanConvertCurvilinear::InterpolatedPointTable::AddPoint( int inputPixelIndex, int outputPixelIndex, const double weightCoefficients[4] )
+{
+  this->InputPixelIndices.push_back( inputPixelIndex );
+  this->OutputPixelIndices.push_back( outputPixelIndex );
+  for ( int i = 0; i < 4; i++ )
+  {
+    this->WeightCoefficients[i].push_back( weightCoefficients[i] );
+  }
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusUsScanConvertCurvilinear::ComputeInterpolatedPointArray(
   int* inputImageExtent, double radiusStartMm, double radiusStopMm, double thetaStartDeg, double thetaStopDeg,
@@ -114,7 +152,7 @@ void vtkPlusUsScanConvertCurvilinear::ComputeInterpolatedPointArray(
 
   if ( !modifiedScanConversionParams )
   {
-    // scan conversion parameters haven't been modified since the InterpolatedPointArray was last computed
+    // scan conversion parameters haven't been modified since the InterpolatedPoints table was last computed
     // there is no need to recompute, just return
     return;
   }
@@ -139,7 +177,7 @@ void vtkPlusUsScanConvertCurvilinear::ComputeInterpolatedPointArray(
 
   // Compute the interpolated point array now
 
-  this->InterpolatedPointArray.clear();
+  this->InterpolatedPoints.Clear();
 
   int numberOfSamples = inputImageExtent[1] - inputImageExtent[0] + 1;
   int numberOfLines = inputImageExtent[3] - inputImageExtent[2] + 1;
@@ -157,6 +195,8 @@ void vtkPlusUsScanConvertCurvilinear::ComputeInterpolatedPointArray(
   double dx = outputImageSpacing[0];
   double dz = outputImageSpacing[1];
 
+  // Points are added row by row, so they are sorted by output pixel index
+
   // Starting depth in image coordinates in mm
   double z = radiusStartMm - this->InterpTransducerCenterPixel[1] * dz;
   for ( int i = 0; i < outputImageSizePixelsY; i++ )
@@ -178,20 +218,19 @@ void vtkPlusUsScanConvertCurvilinear::ComputeInterpolatedPointArray(
            ( index_line >= 0 ) && ( index_line + 1 < numberOfLines ) )
       {
         // The sample is inside the input image, so it can be computed
-        InterpolatedPoint ip;
         double samp_val = samp - index_samp; // Sub-sample fraction for interpolation
         double line_val = line - index_line; // Sub-line fraction for interpolation
 
         //  Calculate the coefficients
-        ip.weightCoefficients[0] = ( 1 - samp_val ) * ( 1 - line_val ) * intensityScaling;
-        ip.weightCoefficients[1] =    samp_val * ( 1 - line_val ) * intensityScaling;
-        ip.weightCoefficients[2] = ( 1 - samp_val ) * line_val   * intensityScaling;
-        ip.weightCoefficients[3] =    samp_val * line_val   * intensityScaling;
-
-        ip.inputPixelIndex = index_samp + index_line * numberOfSamples;
-        ip.outputPixelIndex = j + outputImageSizePixelsX * i;
-
-        this->InterpolatedPointArray.push_back( ip );
+        double weightCoefficients[4] =
+        {
+          ( 1 - samp_val ) * ( 1 - line_val ) * intensityScaling,
+          samp_val * ( 1 - line_val ) * intensityScaling,
+          ( 1 - samp_val ) * line_val   * intensityScaling,
+          samp_val * line_val   * intensityScaling
+        };
+
+        this->InterpolatedPoints.AddPoint( index_samp + index_line * numberOfSamples, j + outputImageSizePixelsX * i, weightCoefficients );
       }
 
       x = x + dx;
@@ -279,6 +318,309 @@ void vtkPlusUsScanConvertCurvilinear::AllocateOutputData( vtkImageData* output,
   }
 }
 
+//----------------------------------------------------------------------------
+// Scan conversion kernels
+//
+// Each output pixel is the weighted sum of 4 neighboring input pixels. All kernels compute the sum in
+// the same order in double precision and saturate it to the range of the pixel type the same way,
+// therefore the vectorized kernels give exactly the same result as the scalar one.
+
+namespace
+{
+  enum InstructionSet
+  {
+    INSTRUCTION_SET_SCALAR,
+    INSTRUCTION_SET_SSE41,
+    INSTRUCTION_SET_AVX2
+  };
+
+  //----------------------------------------------------------------------------
+  InstructionSet DetectInstructionSet()
+  {
+#if defined(PLUS_SCAN_CONVERT_X86)
+#  if defined(_MSC_VER)
+    int cpuInfo[4] = {0};
+    __cpuid(cpuInfo, 0);
+    int maxFunctionId = cpuInfo[0];
+    __cpuid(cpuInfo, 1);
+    bool sse41 = (cpuInfo[2] & (1 << 19)) != 0;
+    bool osxsave = (cpuInfo[2] & (1 << 27)) != 0;
+    bool avx = (cpuInfo[2] & (1 << 28)) != 0;
+    bool avx2 = false;
+    if (maxFunctionId >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6)
+    {
+      __cpuidex(cpuInfo, 7, 0);
+      avx2 = (cpuInfo[1] & (1 << 5)) != 0;
+    }
+#  else
+    __builtin_cpu_init();
+    bool sse41 = __builtin_cpu_supports("sse4.1") != 0;
+    bool avx2 = __builtin_cpu_supports("avx2") != 0;
+#  endif
+    if (avx2)
+    {
+      return INSTRUCTION_SET_AVX2;
+    }
+    if (sse41)
+    {
+      return INSTRUCTION_SET_SSE41;
+    }
+#endif
+    return INSTRUCTION_SET_SCALAR;
+  }
+
+  //----------------------------------------------------------------------------
+  InstructionSet GetInstructionSet()
+  {
+    static const InstructionSet instructionSet = DetectInstructionSet();
+    return instructionSet;
+  }
+
+  //----------------------------------------------------------------------------
+  std::string GetInstructionSetName(InstructionSet instructionSet)
+  {
+    switch (instructionSet)
+    {
+      case INSTRUCTION_SET_AVX2:
+        return "AVX2";
+      case INSTRUCTION_SET_SSE41:
+        return "SSE4.1";
+      default:
+        return "scalar";
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Convert the weighted sum to pixel value. Values outside the range of the pixel type are saturated
+  // (they can only occur if the intensity scaling is larger than 1).
+  template <class T>
+  inline T GetPixelValue(double value)
+  {
+    const double minValue = static_cast<double>(std::numeric_limits<T>::lowest());
+    const double maxValue = static_cast<double>(std::numeric_limits<T>::max());
+    if (value <= minValue)
+    {
+      return std::numeric_limits<T>::lowest();
+    }
+    if (value >= maxValue)
+    {
+      return std::numeric_limits<T>::max();
+    }
+    return static_cast<T>(value);
+  }
+
+  //----------------------------------------------------------------------------
+  // Scalar kernel, handles all the data types. Computes points [firstPoint, afterLastPoint).
+  template <class T>
+  void ScanConvertScalar(const vtkPlusUsScanConvertCurvilinear::InterpolatedPointTable& table, const T* inPtr, int numberOfSamples,
+                         T* outPtr, int firstPoint, int afterLastPoint)
+  {
+    const int* inputPixelIndices = table.InputPixelIndices.data();
+    const int* outputPixelIndices = table.OutputPixelIndices.data();
+    const double* weights0 = table.WeightCoefficients[0].data();
+    const double* weights1 = table.WeightCoefficients[1].data();
+    const double* weights2 = table.WeightCoefficients[2].data();
+    const double* weights3 = table.WeightCoefficients[3].data();
+    for (int i = firstPoint; i < afterLastPoint; ++i)
+    {
+      const T* envPointer = inPtr + inputPixelIndices[i]; // Pointer to the envelope data
+      outPtr[outputPixelIndices[i]] = GetPixelValue<T>(
+                                        weights0[i] * envPointer[0] // (+0, +0)
+                                        + weights1[i] * envPointer[1] // (+1, +0)
+                                        + weights2[i] * envPointer[numberOfSamples] // (+0, +1)
+                                        + weights3[i] * envPointer[numberOfSamples + 1] // (+1, +1)
+                                        + 0.5); // for rounding
+    }
+  }
+
+#if defined(PLUS_SCAN_CONVERT_X86)
+  //----------------------------------------------------------------------------
+  // Input pixels are fetched as 32-bit words: for 8-bit images the (+0,+0), (+1,+0) pixels are the two lowest bytes
+  // of the word that starts at the first pixel and the (+0,+1), (+1,+1) pixels are the two highest bytes of the word
+  // that ends at the last pixel, so that no byte is read outside the input image. For 16-bit images each word
+  // contains exactly two neighboring pixels.
+
+  //----------------------------------------------------------------------------
+  inline int LoadWord(const void* address)
+  {
+    int word;
+    memcpy(&word, address, sizeof(word));
+    return word;
+  }
+
+  //----------------------------------------------------------------------------
+  // Split the words into the 4 neighboring pixels (as 32-bit integers)
+  template <class T>
+  PLUS_SCAN_CONVERT_TARGET_SSE41
+  inline void UnpackPixelsSse41(__m128i firstRow, __m128i secondRow, __m128i pixels[4])
+  {
+    if (sizeof(T) == 1)
+    {
+      const __m128i lowMask = _mm_set1_epi32(0xFF);
+      pixels[0] = _mm_and_si128(firstRow, lowMask);
+      pixels[1] = _mm_and_si128(_mm_srli_epi32(firstRow, 8), lowMask);
+      pixels[2] = _mm_and_si128(_mm_srli_epi32(secondRow, 16), lowMask);
+      pixels[3] = _mm_srli_epi32(secondRow, 24);
+    }
+    else
+    {
+      // sign extension of the 16-bit values
+      pixels[0] = _mm_srai_epi32(_mm_slli_epi32(firstRow, 16), 16);
+      pixels[1] = _mm_srai_epi32(firstRow, 16);
+      pixels[2] = _mm_srai_epi32(_mm_slli_epi32(secondRow, 16), 16);
+      pixels[3] = _mm_srai_epi32(secondRow, 16);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Computes 2 points per iteration
+  template <class T>
+  PLUS_SCAN_CONVERT_TARGET_SSE41
+  void ScanConvertSse41(const vtkPlusUsScanConvertCurvilinear::InterpolatedPointTable& table, const T* inPtr, int numberOfSamples,
+                        T* outPtr, int firstPoint, int afterLastPoint)
+  {
+    const int* inputPixelIndices = table.InputPixelIndices.data();
+    const int* outputPixelIndices = table.OutputPixelIndices.data();
+    const double* const weights[4] = { table.WeightCoefficients[0].data(), table.WeightCoefficients[1].data(), table.WeightCoefficients[2].data(), table.WeightCoefficients[3].data() };
+    // Offset of the word that contains the (+0,+1), (+1,+1) pixels
+    const int secondRowOffset = (sizeof(T) == 1) ? numberOfSamples - 2 : numberOfSamples;
+    const __m128d minValue = _mm_set1_pd(static_cast<double>(std::numeric_limits<T>::lowest()));
+    const __m128d maxValue = _mm_set1_pd(static_cast<double>(std::numeric_limits<T>::max()));
+
+    int i = firstPoint;
+    for (; i + 2 <= afterLastPoint; i += 2)
+    {
+      __m128i firstRow = _mm_cvtsi32_si128(LoadWord(inPtr + inputPixelIndices[i]));
+      firstRow = _mm_insert_epi32(firstRow, LoadWord(inPtr + inputPixelIndices[i + 1]), 1);
+      __m128i secondRow = _mm_cvtsi32_si128(LoadWord(inPtr + inputPixelIndices[i] + secondRowOffset));
+      secondRow = _mm_insert_epi32(secondRow, LoadWord(inPtr + inputPixelIndices[i + 1] + secondRowOffset), 1);
+      __m128i pixels[4];
+      UnpackPixelsSse41<T>(firstRow, secondRow, pixels);
+
+      __m128d sum = _mm_mul_pd(_mm_loadu_pd(weights[0] + i), _mm_cvtepi32_pd(pixels[0]));
+      sum = _mm_add_pd(sum, _mm_mul_pd(_mm_loadu_pd(weights[1] + i), _mm_cvtepi32_pd(pixels[1])));
+      sum = _mm_add_pd(sum, _mm_mul_pd(_mm_loadu_pd(weights[2] + i), _mm_cvtepi32_pd(pixels[2])));
+      sum = _mm_add_pd(sum, _mm_mul_pd(_mm_loadu_pd(weights[3] + i), _mm_cvtepi32_pd(pixels[3])));
+      sum = _mm_add_pd(sum, _mm_set1_pd(0.5));
+      sum = _mm_min_pd(_mm_max_pd(sum, minValue), maxValue);
+
+      __m128i values = _mm_cvttpd_epi32(sum);
+      outPtr[outputPixelIndices[i]] = static_cast<T>(_mm_cvtsi128_si32(values));
+      outPtr[outputPixelIndices[i + 1]] = static_cast<T>(_mm_extract_epi32(values, 1));
+    }
+    ScanConvertScalar(table, inPtr, numberOfSamples, outPtr, i, afterLastPoint);
+  }
+
+  //----------------------------------------------------------------------------
+  // Computes 4 points per iteration, the input words are fetched by hardware gathers
+  template <class T>
+  PLUS_SCAN_CONVERT_TARGET_AVX2
+  void ScanConvertAvx2(const vtkPlusUsScanConvertCurvilinear::InterpolatedPointTable& table, const T* inPtr, int numberOfSamples,
+                       T* outPtr, int firstPoint, int afterLastPoint)
+  {
+    const int* inputPixelIndices = table.InputPixelIndices.data();
+    const int* outputPixelIndices = table.OutputPixelIndices.data();
+    const double* weights0 = table.WeightCoefficients[0].data();
+    const double* weights1 = table.WeightCoefficients[1].data();
+    const double* weights2 = table.WeightCoefficients[2].data();
+    const double* weights3 = table.WeightCoefficients[3].data();
+    const bool is8Bit = (sizeof(T) == 1);
+    // Offset of the word that contains the (+0,+1), (+1,+1) pixels
+    const __m128i secondRowOffset = _mm_set1_epi32(is8Bit ? numberOfSamples - 2 : numberOfSamples);
+    const __m256d minValue = _mm256_set1_pd(static_cast<double>(std::numeric_limits<T>::lowest()));
+    const __m256d maxValue = _mm256_set1_pd(static_cast<double>(std::numeric_limits<T>::max()));
+    const int* base = reinterpret_cast<const int*>(inPtr);
+
+    int i = firstPoint;
+    for (; i + 4 <= afterLastPoint; i += 4)
+    {
+      __m128i inputIndices = _mm_loadu_si128(reinterpret_cast<const __m128i*>(inputPixelIndices + i));
+      __m128i secondRowIndices = _mm_add_epi32(inputIndices, secondRowOffset);
+      __m128i firstRow, secondRow;
+      // the scale of the gather must be a compile-time constant
+      if (is8Bit)
+      {
+        firstRow = _mm_i32gather_epi32(base, inputIndices, 1);
+        secondRow = _mm_i32gather_epi32(base, secondRowIndices, 1);
+      }
+      else
+      {
+        firstRow = _mm_i32gather_epi32(base, inputIndices, 2);
+        secondRow = _mm_i32gather_epi32(base, secondRowIndices, 2);
+      }
+      __m128i pixels[4];
+      UnpackPixelsSse41<T>(firstRow, secondRow, pixels);
+
+      __m256d sum = _mm256_mul_pd(_mm256_loadu_pd(weights0 + i), _mm256_cvtepi32_pd(pixels[0]));
+      sum = _mm256_add_pd(sum, _mm256_mul_pd(_mm256_loadu_pd(weights1 + i), _mm256_cvtepi32_pd(pixels[1])));
+      sum = _mm256_add_pd(sum, _mm256_mul_pd(_mm256_loadu_pd(weights2 + i), _mm256_cvtepi32_pd(pixels[2])));
+      sum = _mm256_add_pd(sum, _mm256_mul_pd(_mm256_loadu_pd(weights3 + i), _mm256_cvtepi32_pd(pixels[3])));
+      sum = _mm256_add_pd(sum, _mm256_set1_pd(0.5));
+      sum = _mm256_min_pd(_mm256_max_pd(sum, minValue), maxValue);
+
+      // Output pixels are not contiguous (only the pixels inside the fan are computed), so they are stored one by one
+      int values[4];
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(values), _mm256_cvttpd_epi32(sum));
+      for (int k = 0; k < 4; ++k)
+      {
+        outPtr[outputPixelIndices[i + k]] = static_cast<T>(values[k]);
+      }
+    }
+    ScanConvertScalar(table, inPtr, numberOfSamples, outPtr, i, afterLastPoint);
+  }
+#endif
+
+  //----------------------------------------------------------------------------
+  template <class T>
+  void ScanConvert(const vtkPlusUsScanConvertCurvilinear::InterpolatedPointTable& table, const T* inPtr, int numberOfSamples,
+                   T* outPtr, int firstPoint, int afterLastPoint, bool vtkNotUsed(vectorizationEnabled))
+  {
+    ScanConvertScalar(table, inPtr, numberOfSamples, outPtr, firstPoint, afterLastPoint);
+  }
+
+  //----------------------------------------------------------------------------
+  // 8-bit unsigned and 16-bit signed images are processed by the vectorized kernels, if available.
+  // The kernels require at least 2 samples in each line, which is guaranteed if the table is not empty.
+  template <class T>
+  void ScanConvertVectorized(const vtkPlusUsScanConvertCurvilinear::InterpolatedPointTable& table, const T* inPtr, int numberOfSamples,
+                             T* outPtr, int firstPoint, int afterLastPoint, bool vectorizationEnabled)
+  {
+#if defined(PLUS_SCAN_CONVERT_X86)
+    if (vectorizationEnabled)
+    {
+      switch (GetInstructionSet())
+      {
+        case INSTRUCTION_SET_AVX2:
+          ScanConvertAvx2(table, inPtr, numberOfSamples, outPtr, firstPoint, afterLastPoint);
+          return;
+        case INSTRUCTION_SET_SSE41:
+          ScanConvertSse41(table, inPtr, numberOfSamples, outPtr, firstPoint, afterLastPoint);
+          return;
+        default:
+          break;
+      }
+    }
+#endif
+    ScanConvertScalar(table, inPtr, numberOfSamples, outPtr, firstPoint, afterLastPoint);
+  }
+
+  //----------------------------------------------------------------------------
+  template <>
+  void ScanConvert<unsigned char>(const vtkPlusUsScanConvertCurvilinear::InterpolatedPointTable& table, const unsigned char* inPtr, int numberOfSamples,
+                                  unsigned char* outPtr, int firstPoint, int afterLastPoint, bool vectorizationEnabled)
+  {
+    ScanConvertVectorized(table, inPtr, numberOfSamples, outPtr, firstPoint, afterLastPoint, vectorizationEnabled);
+  }
+
+  //----------------------------------------------------------------------------
+  template <>
+  void ScanConvert<short>(const vtkPlusUsScanConvertCurvilinear::InterpolatedPointTable& table, const short* inPtr, int numberOfSamples,
+                          short* outPtr, int firstPoint, int afterLastPoint, bool vectorizationEnabled)
+  {
+    ScanConvertVectorized(table, inPtr, numberOfSamples, outPtr, firstPoint, afterLastPoint, vectorizationEnabled);
+  }
+}
+
 //----------------------------------------------------------------------------
 // The templated execute function handles all the data types.
 // T: originally developed for unsigned int
@@ -288,23 +630,14 @@ void vtkPlusUsScanConvertExecute( vtkPlusUsScanConvertCurvilinear* self,
                                   vtkImageData* outData, T* outPtr,
                                   int interpolationTableExt[6], int id )
 {
-  T* envelope_data = inPtr; // The envelope detected and log-compressed data
   int numberOfSamples = inData->GetExtent()[1] - inData->GetExtent()[0] + 1; // Number of samples in one envelope line
-
-  T* image = outPtr; // The resulting image
-
-  std::vector<vtkPlusUsScanConvertCurvilinear::InterpolatedPoint>::const_iterator firstPoint = self->GetInterpolatedPointArray().begin() + interpolationTableExt[0];
-  std::vector<vtkPlusUsScanConvertCurvilinear::InterpolatedPoint>::const_iterator afterLastPoint = self->GetInterpolatedPointArray().begin() + interpolationTableExt[1] + 1;
-  for ( std::vector<vtkPlusUsScanConvertCurvilinear::InterpolatedPoint>::const_iterator it = firstPoint; it != afterLastPoint; ++it )
+  const vtkPlusUsScanConvertCurvilinear::InterpolatedPointTable& table = self->GetInterpolatedPoints();
+  if ( interpolationTableExt[1] < interpolationTableExt[0] || interpolationTableExt[1] >= table.GetNumberOfPoints() )
   {
-    T* env_pointer = ( T* ) & ( envelope_data[it->inputPixelIndex] ); // Pointer to the envelope data
-    image[it->outputPixelIndex] =
-      it->weightCoefficients[0] * env_pointer[0] // (+0, +0)
-      + it->weightCoefficients[1] * env_pointer[1] // (+1, +0)
-      + it->weightCoefficients[2] * env_pointer[numberOfSamples] // (+0, +1)
-      + it->weightCoefficients[3] * env_pointer[numberOfSamples + 1] // (+1, +1)
-      + 0.5; // for rounding
+    // empty table
+    return;
   }
+  ScanConvert<T>( table, inPtr, numberOfSamples, outPtr, interpolationTableExt[0], interpolationTableExt[1] + 1, self->GetVectorizationEnabled() );
 }
 
 //----------------------------------------------------------------------------
@@ -354,7 +687,8 @@ void vtkPlusUsScanConvertCurvilinear::PrintSelf( ostream& os, vtkIndent indent )
   os << indent << "ThetaStartDeg: " << this->ThetaStartDeg << "\n";
   os << indent << "ThetaStopDeg: " << this->ThetaStopDeg << "\n";
   os << indent << "OutputIntensityScaling: " << this->OutputIntensityScaling << "\n";
-  os << indent << "InterpolatedPointArraySize: " << this->InterpolatedPointArray.size() << "\n";
+  os << indent << "InterpolatedPointArraySize: " << this->InterpolatedPoints.GetNumberOfPoints() << "\n";
+  os << indent << "VectorizationEnabled: " << ( this->VectorizationEnabled ? "true" : "false" ) << " (supported instruction set: " << GetInstructionSetName( GetInstructionSet() ) << ")\n";
 
 }
 
@@ -371,7 +705,7 @@ int vtkPlusUsScanConvertCurvilinear::SplitExtent( int splitExt[6], int startExt[
 
   // Starting extent
   int min = 0;
-  int max = this->InterpolatedPointArray.size() - 1;
+  int max = this->InterpolatedPoints.GetNumberOfPoints() - 1;
 
   splitExt[0] = min;
   splitExt[1] = max;
@@ -36,22 +36,41 @@ public:
   /*! Get the scan converted image */
   virtual vtkImageData* GetOutput();
 
-  struct InterpolatedPoint
+  /*!
+    Interpolation table. Each point defines the computation of a pixel in the output (scan converted) image from 4 input pixels.
+    Points are stored as a structure of arrays, sorted by output pixel index, so that they can be processed by vector instructions.
+  */
+  struct InterpolatedPointTable
   {
-    /*! Weighting coefficients that used to construct the output pixel from 4 input pixels */
-    double weightCoefficients[4];
     /*! Position of the first input pixel that is used to construct the output point (in the sample line matrix). The 3 others are one row/column away. */
-    int inputPixelIndex;
-    // Position of the output pixel (in the image matrix) */
-    int outputPixelIndex;
+    std::vector<int> InputPixelIndices;
+    /*! Position of the output pixel (in the image matrix) */
+    std::vector<int> OutputPixelIndices;
+    /*! Weighting coefficients of the (+0,+0), (+1,+0), (+0,+1), (+1,+1) input pixels, including the intensity scaling */
+    std::vector<double> WeightCoefficients[4];
+
+    int GetNumberOfPoints() const
+    {
+      return static_cast<int>(this->OutputPixelIndices.size());
+    }
+    void Clear();
+    void AddPoint(int inputPixelIndex, int outputPixelIndex, const double weightCoefficients[4]);
   };
 
-  /*! Retrieve the InterpolatedPointArray (used internally by the thread function) */
-  const std::vector<InterpolatedPoint>& GetInterpolatedPointArray()
+  /*! Retrieve the interpolation table (used internally by the thread function) */
+  const InterpolatedPointTable& GetInterpolatedPoints()
   {
-    return this->InterpolatedPointArray;
+    return this->InterpolatedPoints;
   };
 
+  /*!
+    If enabled (default) then SSE4.1 or AVX2 instructions are used for 8-bit unsigned and 16-bit signed images,
+    if the processor supports them. The result is the same as without vectorization.
+  */
+  vtkSetMacro(VectorizationEnabled, bool);
+  vtkGetMacro(VectorizationEnabled, bool);
+  vtkBooleanMacro(VectorizationEnabled, bool);
+
   /*! Initialize the parameters used in reconstruction. These are for the cases when video source can obtain them from the hardware */
   vtkSetMacro(RadiusStartMm, double);
   vtkGetMacro(RadiusStartMm, double);
@@ -61,6 +80,10 @@ public:
   vtkSetMacro(ThetaStopDeg, double);
   vtkSetMacro(OutputImageStartDepthMm, double);
 
+  /*! Intensity scaling factor from envelope to image. Values that exceed the range of the pixel type are saturated. */
+  vtkSetMacro(OutputIntensityScaling, double);
+  vtkGetMacro(OutputIntensityScaling, double);
+
   /*!
     Get the start and end point of the selected scanline
     transducer surface, the end point is far from the transducer surface.
@@ -109,8 +132,10 @@ protected:
   /*! Intensity scaling factor from envelope to image */
   double OutputIntensityScaling;
 
-  /*! Each element of this array defines the computation of a pixel in the output (scan converted) image.  */
-  std::vector<InterpolatedPoint> InterpolatedPointArray;
+  /*! Each point of this table defines the computation of a pixel in the output (scan converted) image.  */
+  InterpolatedPointTable InterpolatedPoints;
+
+  bool VectorizationEnabled;
 
   int InterpInputImageExtent[6];
   double InterpRadiusStartMm;
@@ -123,7 +148,7 @@ protected:
   double InterpIntensityScaling;
 
   /*!
-    Computes the InterpolatedPointArray from the method arguments. The array is not recomputed if
+    Computes the InterpolatedPoints table from the method arguments. The array is not recomputed if
     the input arguments are the same as last time.
   */
   void ComputeInterpolatedPointArray(
@@ -145,6 +145,17 @@ PlusStatus PlusIgtlClientInfo::SetClientInfoFromXmlData(vtkXMLDataElement* xmlda
       stream.EmbeddedTransformToFrame = embeddedTransformToFrame;
       stream.Name = name;
 
+      std::string compression;
+      XML_READ_STRING_ATTRIBUTE_NONMEMBER_OPTIONAL(Compression, compression, imageElem);
+      if (!compression.empty())
+      {
+        stream.Compression = igtl::PlusCompressedImageMessage::GetCompressionMethodFromString(compression);
+        if (stream.Compression == igtl::PlusCompressedImageMessage::COMPRESSION_NONE && !igsioCommon::IsEqualInsensitive(compression, "None"))
+        {
+          LOG_WARNING("Unknown Compression attribute value of ImageNames/Image element #" << i << ": " << compression << ". Images will be sent without compression.");
+        }
+      }
+
       clientInfo.ImageStreams.push_back(stream);
     }
   }
@@ -291,6 +302,10 @@ void PlusIgtlClientInfo::GetClientInfoInXmlData(std::string& strXmlData)
     image->SetName("Image");
     image->SetAttribute("Name", ImageStreams[i].Name.c_str());
     image->SetAttribute("EmbeddedTransformToFrame", ImageStreams[i].EmbeddedTransformToFrame.c_str());
+    if (ImageStreams[i].Compression != igtl::PlusCompressedImageMessage::COMPRESSION_NONE)
+    {
+      image->SetAttribute("Compression", igtl::PlusCompressedImageMessage::GetCompressionMethodAsString(ImageStreams[i].Compression).c_str());
+    }
     imageNames->AddNestedElement(image);
   }
   xmldata->AddNestedElement(imageNames);
@@ -373,7 +388,12 @@ void PlusIgtlClientInfo::PrintSelf(ostream& os, vtkIndent indent)
       {
         os << ", ";
       }
-      os << this->ImageStreams[i].Name << " (EmbeddedTransformToFrame: " << this->ImageStreams[i].EmbeddedTransformToFrame << ")";
+      os << this->ImageStreams[i].Name << " (EmbeddedTransformToFrame: " << this->ImageStreams[i].EmbeddedTransformToFrame;
+      if (this->ImageStreams[i].Compression != igtl::PlusCompressedImageMessage::COMPRESSION_NONE)
+      {
+        os << ", Compression: " << igtl::PlusCompressedImageMessage::GetCompressionMethodAsString(this->ImageStreams[i].Compression);
+      }
+      os << ")";
     }
   }
   else
@@ -9,6 +9,7 @@
 
 // Local includes
 #include "PlusConfigure.h"
+#include "igtlPlusCompressedImageMessage.h"
 #include "vtkPlusOpenIGTLinkExport.h"
 
 // IGSIO includes
@@ -18,6 +19,7 @@
 #include <igtlClientSocket.h>
 
 // STL includes
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -69,8 +71,17 @@ public:
     std::string EmbeddedTransformToFrame;
     /*! Class for decoding and encoding frames */
     vtkSmartPointer<vtkIGSIOFrameConverter> FrameConverter;
+    /*!
+      Lossless compression of the image. If it is not COMPRESSION_NONE then the images are sent in
+      COMPIMAGE messages (see igtl::PlusCompressedImageMessage) instead of IMAGE messages.
+    */
+    igtl::PlusCompressedImageMessage::CompressionMethod Compression;
+    /*! Previous frame of the stream for the compression, shared by the copies of the stream */
+    std::shared_ptr<igtl::PlusCompressedImageMessage::CompressionState> CompressionState;
     ImageStream()
       : FrameConverter(vtkSmartPointer<vtkIGSIOFrameConverter>::New())
+      , Compression(igtl::PlusCompressedImageMessage::COMPRESSION_NONE)
+      , CompressionState(std::make_shared<igtl::PlusCompressedImageMessage::CompressionState>())
     {
     };
   };
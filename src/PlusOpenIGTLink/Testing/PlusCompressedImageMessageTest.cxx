@@ -0,0 +1,200 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PlusCompressedImageMessageTest.cxx
+  \brief Packs a stream of frames into compressed image messages and unpacks them as a client would receive them.
+  Verifies that key frames and delta frames are restored exactly, that a delta frame is rejected after a dropped
+  message, that decoding recovers at the next key frame and that a truncated message is rejected.
+*/
+
+#include "PlusConfigure.h"
+#include "igtlPlusCompressedImageMessage.h"
+#include "igsioVideoFrame.h"
+#include "vtkImageData.h"
+#include "vtksys/CommandLineArguments.hxx"
+
+#include <igtlMessageHeader.h>
+#include <igtl_header.h>
+#include <igtl_util.h>
+
+namespace
+{
+  const int FRAME_SIZE[3] = { 64, 48, 1 };
+
+  //----------------------------------------------------------------------------
+  // Smoothly moving pattern, so that consecutive frames differ only slightly
+  void FillFrame(vtkImageData* image, int frameNumber)
+  {
+    unsigned char* pixel = static_cast<unsigned char*>(image->GetScalarPointer());
+    for (int y = 0; y < FRAME_SIZE[1]; ++y)
+    {
+      for (int x = 0; x < FRAME_SIZE[0]; ++x)
+      {
+        *(pixel++) = static_cast<unsigned char>((x + y + 3 * frameNumber) % 256);
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Copy the packed message into a new message, the same way as the client receives it from the socket.
+  // If bodySize is non-negative then only the first bodySize bytes of the body are transferred.
+  igtl::PlusCompressedImageMessage::Pointer Transmit(igtl::PlusCompressedImageMessage* sentMsg, int bodySize = -1)
+  {
+    igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+    headerMsg->InitBuffer();
+    memcpy(headerMsg->GetBufferPointer(), sentMsg->GetPackPointer(), IGTL_HEADER_SIZE);
+    if (bodySize >= 0)
+    {
+      igtl_header* header = reinterpret_cast<igtl_header*>(headerMsg->GetBufferPointer());
+      igtl_header_convert_byte_order(header);
+      header->body_size = static_cast<igtl_uint64>(bodySize);
+      igtl_header_convert_byte_order(header);
+    }
+    headerMsg->Unpack();
+
+    igtl::PlusCompressedImageMessage::Pointer receivedMsg = igtl::PlusCompressedImageMessage::New();
+    receivedMsg->SetMessageHeader(headerMsg);
+    receivedMsg->AllocateBuffer();
+    memcpy(receivedMsg->GetBufferBodyPointer(), sentMsg->GetPackBodyPointer(), receivedMsg->GetBufferBodySize());
+    return receivedMsg;
+  }
+
+  //----------------------------------------------------------------------------
+  // Returns true if the frame is received (unpacked and decoded), in that case the pixels are also verified
+  bool Receive(igtl::PlusCompressedImageMessage* receivedMsg, vtkImageData* expectedImage, igtl::PlusCompressedImageMessage::CompressionState& receiverState, int& numberOfErrors)
+  {
+    if (!(receivedMsg->Unpack(1) & igtl::MessageHeader::UNPACK_BODY))
+    {
+      LOG_ERROR("Failed to unpack compressed image message");
+      numberOfErrors++;
+      return false;
+    }
+    igsioVideoFrame frame;
+    if (receivedMsg->GetImage(frame, receiverState) != PLUS_SUCCESS)
+    {
+      return false;
+    }
+    int dimensions[3] = {0};
+    frame.GetImage()->GetDimensions(dimensions);
+    if (dimensions[0] != FRAME_SIZE[0] || dimensions[1] != FRAME_SIZE[1] || dimensions[2] != FRAME_SIZE[2])
+    {
+      LOG_ERROR("Frame size mismatch: " << dimensions[0] << "x" << dimensions[1] << "x" << dimensions[2]);
+      numberOfErrors++;
+      return true;
+    }
+    if (memcmp(frame.GetScalarPointer(), expectedImage->GetScalarPointer(), frame.GetFrameSizeInBytes()) != 0)
+    {
+      LOG_ERROR("Received pixels differ from the sent pixels");
+      numberOfErrors++;
+    }
+    return true;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "\n\nPlusCompressedImageMessageTest help:" << args.GetHelp() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (printHelp)
+  {
+    std::cout << "\n\nPlusCompressedImageMessageTest help:" << args.GetHelp() << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+  image->SetDimensions(FRAME_SIZE[0], FRAME_SIZE[1], FRAME_SIZE[2]);
+  image->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+
+  // Frame 1 is a key frame, frames 2-4 are delta frames, frame 5 is the next key frame
+  igtl::PlusCompressedImageMessage::CompressionState senderState;
+  senderState.KeyFrameInterval = 4;
+  igtl::PlusCompressedImageMessage::CompressionState receiverState;
+
+  int numberOfErrors = 0;
+  const int numberOfFrames = 6;
+  const int droppedFrameNumber = 3;
+  for (int frameNumber = 1; frameNumber <= numberOfFrames; ++frameNumber)
+  {
+    FillFrame(image, frameNumber);
+    igtl::PlusCompressedImageMessage::Pointer sentMsg = igtl::PlusCompressedImageMessage::New();
+    if (sentMsg->SetImage(image, US_IMG_BRIGHTNESS, senderState) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to compress frame " << frameNumber);
+      return EXIT_FAILURE;
+    }
+    sentMsg->Pack();
+
+    bool expectedKeyFrame = (frameNumber == 1 || frameNumber == 5);
+    if (sentMsg->IsKeyFrame() != expectedKeyFrame)
+    {
+      LOG_ERROR("Frame " << frameNumber << " is " << (sentMsg->IsKeyFrame() ? "a key frame" : "a delta frame") << ", expected " << (expectedKeyFrame ? "a key frame" : "a delta frame"));
+      numberOfErrors++;
+    }
+
+    if (frameNumber == droppedFrameNumber)
+    {
+      continue;
+    }
+
+    igtl::PlusCompressedImageMessage::Pointer receivedMsg = Transmit(sentMsg);
+    bool received = Receive(receivedMsg, image, receiverState, numberOfErrors);
+    if (receivedMsg->IsKeyFrame() != expectedKeyFrame)
+    {
+      LOG_ERROR("Received frame " << frameNumber << " key frame flag mismatch");
+      numberOfErrors++;
+    }
+
+    // Only the delta frame right after the dropped frame cannot be decoded
+    bool expectedReceived = (frameNumber != droppedFrameNumber + 1);
+    if (received != expectedReceived)
+    {
+      LOG_ERROR("Frame " << frameNumber << " is " << (received ? "decoded" : "not decoded") << ", expected " << (expectedReceived ? "decoded" : "not decoded"));
+      numberOfErrors++;
+    }
+  }
+
+  // Truncated message: the body is shorter than the compressed image header
+  {
+    FillFrame(image, numberOfFrames + 1);
+    igtl::PlusCompressedImageMessage::Pointer sentMsg = igtl::PlusCompressedImageMessage::New();
+    sentMsg->SetImage(image, US_IMG_BRIGHTNESS, senderState);
+    sentMsg->Pack();
+    igtl::PlusCompressedImageMessage::Pointer receivedMsg = Transmit(sentMsg, 10);
+    if (receivedMsg->Unpack(0) & igtl::MessageHeader::UNPACK_BODY)
+    {
+      LOG_ERROR("Truncated compressed image message is unpacked");
+      numberOfErrors++;
+    }
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully.");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,422 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "igtlPlusCompressedImageMessage.h"
+#include "vtkImageData.h"
+#include "vtkMatrix4x4.h"
+#include "vtkPlusIgtlMessageFactory.h"
+
+#ifdef PLUS_USE_SYSTEM_ZLIB
+  #include <zlib.h>
+#else
+  #include <vtk_zlib.h>
+#endif
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  /*!
+    Compute the difference of each scalar to the previous frame (or take the scalar itself if there is no previous frame)
+    and write byte k of each difference to the k-th plane of the residual buffer.
+  */
+  template<typename ScalarType>
+  void EncodeResidual(const unsigned char* frame, const unsigned char* previousFrame, size_t numberOfScalars, unsigned char* residual)
+  {
+    const ScalarType* frameScalars = reinterpret_cast<const ScalarType*>(frame);
+    const ScalarType* previousFrameScalars = reinterpret_cast<const ScalarType*>(previousFrame);
+    for (size_t i = 0; i < numberOfScalars; ++i)
+    {
+      ScalarType difference = (previousFrameScalars == NULL) ? frameScalars[i] : static_cast<ScalarType>(frameScalars[i] - previousFrameScalars[i]);
+      for (size_t k = 0; k < sizeof(ScalarType); ++k)
+      {
+        residual[k * numberOfScalars + i] = static_cast<unsigned char>(difference >> (8 * k));
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Inverse of EncodeResidual */
+  template<typename ScalarType>
+  void DecodeResidual(const unsigned char* residual, const unsigned char* previousFrame, size_t numberOfScalars, unsigned char* frame)
+  {
+    ScalarType* frameScalars = reinterpret_cast<ScalarType*>(frame);
+    const ScalarType* previousFrameScalars = reinterpret_cast<const ScalarType*>(previousFrame);
+    for (size_t i = 0; i < numberOfScalars; ++i)
+    {
+      ScalarType difference = 0;
+      for (size_t k = 0; k < sizeof(ScalarType); ++k)
+      {
+        difference |= static_cast<ScalarType>(residual[k * numberOfScalars + i]) << (8 * k);
+      }
+      frameScalars[i] = (previousFrameScalars == NULL) ? difference : static_cast<ScalarType>(previousFrameScalars[i] + difference);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus EncodeResidual(int scalarSize, const unsigned char* frame, const unsigned char* previousFrame, size_t numberOfScalars, unsigned char* residual)
+  {
+    switch (scalarSize)
+    {
+      case 1: EncodeResidual<igtl_uint8>(frame, previousFrame, numberOfScalars, residual); return PLUS_SUCCESS;
+      case 2: EncodeResidual<igtl_uint16>(frame, previousFrame, numberOfScalars, residual); return PLUS_SUCCESS;
+      case 4: EncodeResidual<igtl_uint32>(frame, previousFrame, numberOfScalars, residual); return PLUS_SUCCESS;
+      case 8: EncodeResidual<igtl_uint64>(frame, previousFrame, numberOfScalars, residual); return PLUS_SUCCESS;
+      default:
+        LOG_ERROR("Unsupported scalar size for image compression: " << scalarSize);
+        return PLUS_FAIL;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus DecodeResidual(int scalarSize, const unsigned char* residual, const unsigned char* previousFrame, size_t numberOfScalars, unsigned char* frame)
+  {
+    switch (scalarSize)
+    {
+      case 1: DecodeResidual<igtl_uint8>(residual, previousFrame, numberOfScalars, frame); return PLUS_SUCCESS;
+      case 2: DecodeResidual<igtl_uint16>(residual, previousFrame, numberOfScalars, frame); return PLUS_SUCCESS;
+      case 4: DecodeResidual<igtl_uint32>(residual, previousFrame, numberOfScalars, frame); return PLUS_SUCCESS;
+      case 8: DecodeResidual<igtl_uint64>(residual, previousFrame, numberOfScalars, frame); return PLUS_SUCCESS;
+      default:
+        LOG_ERROR("Unsupported scalar size for image decompression: " << scalarSize);
+        return PLUS_FAIL;
+    }
+  }
+}
+
+namespace igtl
+{
+  //----------------------------------------------------------------------------
+  PlusCompressedImageMessage::CompressionState::CompressionState()
+    : KeyFrameInterval(DEFAULT_KEY_FRAME_INTERVAL)
+    , PreviousScalarType(0)
+    , PreviousNumberOfComponents(0)
+    , PreviousFrameIndex(0)
+    , NumberOfFramesSinceKeyFrame(0)
+  {
+    PreviousFrameSize[0] = PreviousFrameSize[1] = PreviousFrameSize[2] = 0;
+  }
+
+  //----------------------------------------------------------------------------
+  void PlusCompressedImageMessage::CompressionState::Reset()
+  {
+    this->PreviousFrame.clear();
+    this->NumberOfFramesSinceKeyFrame = 0;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusCompressedImageMessage::PlusCompressedImageMessage()
+    : MessageBase()
+  {
+    this->m_SendMessageType = "COMPIMAGE";
+  }
+
+  //----------------------------------------------------------------------------
+  PlusCompressedImageMessage::~PlusCompressedImageMessage()
+  {
+  }
+
+  //----------------------------------------------------------------------------
+  igtl::MessageBase::Pointer PlusCompressedImageMessage::Clone()
+  {
+    igtl::MessageBase::Pointer clone;
+    {
+      vtkSmartPointer<vtkPlusIgtlMessageFactory> factory = vtkSmartPointer<vtkPlusIgtlMessageFactory>::New();
+      clone = dynamic_cast<igtl::MessageBase*>(factory->CreateSendMessage(this->GetMessageType(), this->GetHeaderVersion()).GetPointer());
+    }
+
+    igtl::PlusCompressedImageMessage::Pointer msg = dynamic_cast<igtl::PlusCompressedImageMessage*>(clone.GetPointer());
+
+    int bodySize = this->m_MessageSize - IGTL_HEADER_SIZE;
+    msg->InitBuffer();
+    msg->CopyHeader(this);
+    msg->AllocateBuffer(bodySize);
+    if (bodySize > 0)
+    {
+      msg->CopyBody(this);
+    }
+
+#if OpenIGTLink_HEADER_VERSION >= 2
+    msg->m_MetaDataHeader = this->m_MetaDataHeader;
+    msg->m_MetaDataMap = this->m_MetaDataMap;
+    msg->m_IsExtendedHeaderUnpacked = this->m_IsExtendedHeaderUnpacked;
+#endif
+
+    return clone;
+  }
+
+  //----------------------------------------------------------------------------
+  std::string PlusCompressedImageMessage::GetCompressionMethodAsString(CompressionMethod method)
+  {
+    switch (method)
+    {
+      case COMPRESSION_DELTA_ZLIB:
+        return "DeltaZlib";
+      default:
+        return "None";
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  PlusCompressedImageMessage::CompressionMethod PlusCompressedImageMessage::GetCompressionMethodFromString(const std::string& methodName)
+  {
+    if (igsioCommon::IsEqualInsensitive(methodName, "DeltaZlib"))
+    {
+      return COMPRESSION_DELTA_ZLIB;
+    }
+    return COMPRESSION_NONE;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus PlusCompressedImageMessage::SetImage(vtkImageData* image, US_IMAGE_TYPE imageType, CompressionState& state)
+  {
+    if (image == NULL)
+    {
+      LOG_ERROR("Failed to compress image - input image is NULL");
+      return PLUS_FAIL;
+    }
+
+    int dimensions[3] = {0};
+    image->GetDimensions(dimensions);
+    for (int i = 0; i < 3; ++i)
+    {
+      if (dimensions[i] < 0 || dimensions[i] > static_cast<int>(std::numeric_limits<igtl_uint16>::max()))
+      {
+        LOG_ERROR("Frame size element is too large to be sent over OpenIGTLink. Cannot set compressed image.");
+        return PLUS_FAIL;
+      }
+      this->m_MessageHeader.m_FrameSize[i] = static_cast<igtl_uint16>(dimensions[i]);
+    }
+    this->m_MessageHeader.m_ScalarType = PlusCommon::GetIGTLScalarPixelTypeFromVTK(image->GetScalarType());
+    this->m_MessageHeader.m_NumberOfComponents = image->GetNumberOfScalarComponents();
+    this->m_MessageHeader.m_ImageType = imageType;
+    this->m_MessageHeader.m_CompressionMethod = COMPRESSION_DELTA_ZLIB;
+
+    int scalarSize = image->GetScalarSize();
+    size_t numberOfScalars = static_cast<size_t>(dimensions[0]) * dimensions[1] * dimensions[2] * image->GetNumberOfScalarComponents();
+    size_t imageDataSizeInBytes = numberOfScalars * scalarSize;
+    if (imageDataSizeInBytes > std::numeric_limits<igtl_uint32>::max())
+    {
+      LOG_ERROR("Image is too large to be sent over OpenIGTLink. Cannot set compressed image.");
+      return PLUS_FAIL;
+    }
+    this->m_MessageHeader.m_ImageDataSizeInBytes = static_cast<igtl_uint32>(imageDataSizeInBytes);
+
+    // The frame can be encoded relative to the previous frame if the previous frame has the same geometry
+    bool keyFrame = state.PreviousFrame.size() != imageDataSizeInBytes
+                    || state.PreviousScalarType != this->m_MessageHeader.m_ScalarType
+                    || state.PreviousNumberOfComponents != this->m_MessageHeader.m_NumberOfComponents
+                    || state.PreviousFrameSize[0] != this->m_MessageHeader.m_FrameSize[0]
+                    || state.PreviousFrameSize[1] != this->m_MessageHeader.m_FrameSize[1]
+                    || state.PreviousFrameSize[2] != this->m_MessageHeader.m_FrameSize[2]
+                    || state.NumberOfFramesSinceKeyFrame + 1 >= state.KeyFrameInterval;
+
+    const unsigned char* frame = static_cast<const unsigned char*>(image->GetScalarPointer());
+    state.ResidualBuffer.resize(imageDataSizeInBytes);
+    if (imageDataSizeInBytes > 0
+        && EncodeResidual(scalarSize, frame, keyFrame ? NULL : &state.PreviousFrame[0], numberOfScalars, &state.ResidualBuffer[0]) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+
+    uLongf compressedDataSizeInBytes = compressBound(static_cast<uLong>(imageDataSizeInBytes));
+    this->m_CompressedData.resize(compressedDataSizeInBytes);
+    // Fastest compression level: the frames have to be compressed at the acquisition rate
+    int result = compress2(&this->m_CompressedData[0], &compressedDataSizeInBytes,
+                           imageDataSizeInBytes > 0 ? &state.ResidualBuffer[0] : NULL, static_cast<uLong>(imageDataSizeInBytes), Z_BEST_SPEED);
+    if (result != Z_OK)
+    {
+      LOG_ERROR("Failed to compress image (zlib error " << result << ")");
+      state.Reset();
+      return PLUS_FAIL;
+    }
+    this->m_CompressedData.resize(compressedDataSizeInBytes);
+    this->m_MessageHeader.m_CompressedDataSizeInBytes = static_cast<igtl_uint32>(compressedDataSizeInBytes);
+
+    state.PreviousFrameIndex++;
+    this->m_MessageHeader.m_FrameIndex = state.PreviousFrameIndex;
+    this->m_MessageHeader.m_Flags = keyFrame ? FLAG_KEY_FRAME : 0;
+    state.NumberOfFramesSinceKeyFrame = keyFrame ? 0 : state.NumberOfFramesSinceKeyFrame + 1;
+    state.PreviousFrame.assign(frame, frame + imageDataSizeInBytes);
+    state.PreviousScalarType = this->m_MessageHeader.m_ScalarType;
+    state.PreviousNumberOfComponents = this->m_MessageHeader.m_NumberOfComponents;
+    for (int i = 0; i < 3; ++i)
+    {
+      state.PreviousFrameSize[i] = this->m_MessageHeader.m_FrameSize[i];
+    }
+
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus PlusCompressedImageMessage::GetImage(igsioVideoFrame& frame, CompressionState& state)
+  {
+    if (this->m_MessageHeader.m_CompressionMethod != COMPRESSION_DELTA_ZLIB)
+    {
+      LOG_ERROR("Unsupported image compression method: " << this->m_MessageHeader.m_CompressionMethod);
+      return PLUS_FAIL;
+    }
+
+    igsioCommon::VTKScalarPixelType pixelType = PlusCommon::GetVTKScalarPixelTypeFromIGTL(this->m_MessageHeader.m_ScalarType);
+    FrameSizeType frameSize = { this->m_MessageHeader.m_FrameSize[0], this->m_MessageHeader.m_FrameSize[1], this->m_MessageHeader.m_FrameSize[2] };
+    if (frame.AllocateFrame(frameSize, pixelType, this->m_MessageHeader.m_NumberOfComponents) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to allocate memory for frame received in compressed image message");
+      return PLUS_FAIL;
+    }
+    frame.SetImageType((US_IMAGE_TYPE)this->m_MessageHeader.m_ImageType);
+
+    size_t imageDataSizeInBytes = frame.GetFrameSizeInBytes();
+    if (imageDataSizeInBytes != this->m_MessageHeader.m_ImageDataSizeInBytes)
+    {
+      LOG_ERROR("Image data size mismatch in compressed image message: expected " << imageDataSizeInBytes << " bytes, received " << this->m_MessageHeader.m_ImageDataSizeInBytes);
+      state.Reset();
+      return PLUS_FAIL;
+    }
+
+    bool keyFrame = this->IsKeyFrame();
+    if (!keyFrame)
+    {
+      bool previousFrameAvailable = state.PreviousFrame.size() == imageDataSizeInBytes
+                                    && state.PreviousScalarType == this->m_MessageHeader.m_ScalarType
+                                    && state.PreviousNumberOfComponents == this->m_MessageHeader.m_NumberOfComponents
+                                    && state.PreviousFrameIndex + 1 == this->m_MessageHeader.m_FrameIndex;
+      if (!previousFrameAvailable)
+      {
+        // A message has been dropped, frames cannot be decoded until the next key frame
+        LOG_DEBUG("Compressed image frame " << this->m_MessageHeader.m_FrameIndex << " is skipped, the previous frame is not available");
+        state.Reset();
+        return PLUS_FAIL;
+      }
+    }
+
+    state.ResidualBuffer.resize(imageDataSizeInBytes);
+    uLongf residualSizeInBytes = static_cast<uLongf>(imageDataSizeInBytes);
+    int result = uncompress(imageDataSizeInBytes > 0 ? &state.ResidualBuffer[0] : NULL, &residualSizeInBytes,
+                            this->m_CompressedData.empty() ? NULL : &this->m_CompressedData[0], static_cast<uLong>(this->m_CompressedData.size()));
+    if (result != Z_OK || residualSizeInBytes != imageDataSizeInBytes)
+    {
+      LOG_ERROR("Failed to decompress image (zlib error " << result << ")");
+      state.Reset();
+      return PLUS_FAIL;
+    }
+
+    unsigned char* frameData = static_cast<unsigned char*>(frame.GetScalarPointer());
+    int scalarSize = frame.GetImage()->GetScalarSize();
+    size_t numberOfScalars = (scalarSize > 0) ? imageDataSizeInBytes / scalarSize : 0;
+    if (imageDataSizeInBytes > 0
+        && DecodeResidual(scalarSize, &state.ResidualBuffer[0], keyFrame ? NULL : &state.PreviousFrame[0], numberOfScalars, frameData) != PLUS_SUCCESS)
+    {
+      state.Reset();
+      return PLUS_FAIL;
+    }
+    frame.GetImage()->Modified();
+
+    state.PreviousFrame.assign(frameData, frameData + imageDataSizeInBytes);
+    state.PreviousFrameIndex = this->m_MessageHeader.m_FrameIndex;
+    state.PreviousScalarType = this->m_MessageHeader.m_ScalarType;
+    state.PreviousNumberOfComponents = this->m_MessageHeader.m_NumberOfComponents;
+    for (int i = 0; i < 3; ++i)
+    {
+      state.PreviousFrameSize[i] = this->m_MessageHeader.m_FrameSize[i];
+    }
+
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus PlusCompressedImageMessage::SetEmbeddedImageTransform(const vtkMatrix4x4& matrix)
+  {
+    for (int i = 0; i < 4; ++i)
+    {
+      for (int j = 0; j < 4; ++j)
+      {
+        m_MessageHeader.m_EmbeddedImageTransform[i][j] = matrix.GetElement(i, j);
+      }
+    }
+
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  vtkSmartPointer<vtkMatrix4x4> PlusCompressedImageMessage::GetEmbeddedImageTransform()
+  {
+    vtkSmartPointer<vtkMatrix4x4> mat(vtkSmartPointer<vtkMatrix4x4>::New());
+    for (int i = 0; i < 4; ++i)
+    {
+      for (int j = 0; j < 4; ++j)
+      {
+        mat->SetElement(i, j, m_MessageHeader.m_EmbeddedImageTransform[i][j]);
+      }
+    }
+    return mat;
+  }
+
+  //----------------------------------------------------------------------------
+  bool PlusCompressedImageMessage::IsKeyFrame() const
+  {
+    return (this->m_MessageHeader.m_Flags & FLAG_KEY_FRAME) != 0;
+  }
+
+  //----------------------------------------------------------------------------
+  int PlusCompressedImageMessage::CalculateContentBufferSize()
+  {
+    return this->m_MessageHeader.GetMessageHeaderSize()
+           + this->m_MessageHeader.m_CompressedDataSizeInBytes;
+  }
+
+  //----------------------------------------------------------------------------
+  int PlusCompressedImageMessage::PackContent()
+  {
+    AllocateBuffer();
+
+    // Copy header
+    CompressedImageHeader* header = (CompressedImageHeader*)(this->m_Content);
+    *header = this->m_MessageHeader;
+
+    // Copy compressed image data
+    if (!this->m_CompressedData.empty())
+    {
+      memcpy(this->m_Content + header->GetMessageHeaderSize(), &this->m_CompressedData[0], this->m_CompressedData.size());
+    }
+
+    // Convert header endian
+    header->ConvertEndianness();
+
+    return 1;
+  }
+
+  //----------------------------------------------------------------------------
+  int PlusCompressedImageMessage::UnpackContent()
+  {
+    // The header is converted in place, so the message must be large enough to contain it
+    if (this->m_Content == NULL || static_cast<size_t>(this->GetBufferBodySize()) < this->m_MessageHeader.GetMessageHeaderSize())
+    {
+      LOG_ERROR("Invalid compressed image message: message size (" << this->GetBufferBodySize() << ") is smaller than the header size");
+      return 0;
+    }
+
+    CompressedImageHeader* header = (CompressedImageHeader*)(this->m_Content);
+
+    // Convert header endian
+    header->ConvertEndianness();
+
+    // Copy header
+    this->m_MessageHeader = *header;
+
+    if (this->m_MessageHeader.GetMessageHeaderSize() + this->m_MessageHeader.m_CompressedDataSizeInBytes > static_cast<size_t>(this->GetBufferBodySize()))
+    {
+      LOG_ERROR("Invalid compressed image message: compressed data size exceeds the message size");
+      return 0;
+    }
+
+    // Copy compressed image data
+    unsigned char* compressedData = this->m_Content + header->GetMessageHeaderSize();
+    this->m_CompressedData.assign(compressedData, compressedData + this->m_MessageHeader.m_CompressedDataSizeInBytes);
+
+    return 1;
+  }
+}
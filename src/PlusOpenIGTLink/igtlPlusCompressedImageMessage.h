@@ -0,0 +1,209 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __igtlPlusCompressedImageMessage_h
+#define __igtlPlusCompressedImageMessage_h
+
+#include "vtkPlusOpenIGTLinkExport.h"
+
+#include "igsioVideoFrame.h"
+#include "igtl_types.h"
+#include "igtl_win32header.h"
+#include "igtlMessageBase.h"
+#include "igtlObject.h"
+#include "igtl_header.h"
+#include "igtl_util.h"
+#include "vtkMatrix4x4.h"
+#include "vtkSmartPointer.h"
+#include <string>
+#include <vector>
+
+class vtkImageData;
+
+namespace igtl
+{
+  // This command prevents 4-byte alignment in the struct (which enables m_FrameSize[3])
+#pragma pack(1)     /* For 1-byte boundary in memory */
+
+  /*!
+    \class PlusCompressedImageMessage
+    \brief IGTL message helper class for sending images with lossless compression
+
+    The message contains the same image as an IMAGE message, but the pixel data is compressed losslessly:
+    the difference to the previous frame of the stream is computed for each scalar (wrap-around arithmetic),
+    the bytes of the differences are grouped by significance, and the result is compressed by zlib (deflate).
+    Consecutive ultrasound frames are similar and the high bytes of the differences are mostly zero,
+    so this greatly reduces the size of 16-bit RF data.
+
+    Each frame depends on the previous frame of the stream, therefore both the sender and the receiver
+    keep a CompressionState for each stream. Key frames (frames that do not depend on the previous frame)
+    are sent periodically, so the receiver can resume decoding after a dropped message.
+
+    \ingroup PlusLibOpenIGTLink
+  */
+  class vtkPlusOpenIGTLinkExport PlusCompressedImageMessage: public MessageBase
+  {
+  public:
+    igtlTypeMacro(igtl::PlusCompressedImageMessage, igtl::MessageBase);
+    igtlNewMacro(igtl::PlusCompressedImageMessage);
+
+    enum CompressionMethod
+    {
+      COMPRESSION_NONE = 0,
+      COMPRESSION_DELTA_ZLIB = 1
+    };
+
+    /*! Frame that the next frame of a stream is encoded relative to (or decoded with) */
+    class vtkPlusOpenIGTLinkExport CompressionState
+    {
+    public:
+      CompressionState();
+
+      /*! Forget the previous frame, the next frame will be a key frame */
+      void Reset();
+
+      /*! Default value of KeyFrameInterval */
+      static const unsigned int DEFAULT_KEY_FRAME_INTERVAL = 50;
+
+      /*! Maximum number of frames between key frames */
+      unsigned int KeyFrameInterval;
+
+    protected:
+      friend class PlusCompressedImageMessage;
+
+      /*! Pixel data of the previous frame */
+      std::vector<unsigned char> PreviousFrame;
+      igtl_uint16 PreviousScalarType;
+      igtl_uint16 PreviousNumberOfComponents;
+      igtl_uint16 PreviousFrameSize[3];
+      /*! Index of the previous frame in the stream */
+      igtl_uint32 PreviousFrameIndex;
+      unsigned int NumberOfFramesSinceKeyFrame;
+      /*! Temporary buffer for the grouped bytes of the differences */
+      std::vector<unsigned char> ResidualBuffer;
+    };
+
+  public:
+    /*! Override clone so that we use the plus igtl factory */
+    virtual igtl::MessageBase::Pointer Clone();
+
+    /*! Convert between compression method and its name in the client info ("None", "DeltaZlib") */
+    static std::string GetCompressionMethodAsString(CompressionMethod method);
+    static CompressionMethod GetCompressionMethodFromString(const std::string& methodName);
+
+    /*! Compress the image. The previous frame of the stream is taken from (and the image is stored in) the compression state. */
+    PlusStatus SetImage(vtkImageData* image, US_IMAGE_TYPE imageType, CompressionState& state);
+
+    /*! Decompress the unpacked image. Fails if the message is not a key frame and the previous frame of the stream is not available. */
+    PlusStatus GetImage(igsioVideoFrame& frame, CompressionState& state);
+
+    /*! Set the embedded transform of the image */
+    PlusStatus SetEmbeddedImageTransform(const vtkMatrix4x4& matrix);
+
+    /*! Get the embedded transform of the image */
+    vtkSmartPointer<vtkMatrix4x4> GetEmbeddedImageTransform();
+
+    /*! Returns true if the image does not depend on the previous frame of the stream */
+    bool IsKeyFrame() const;
+
+  protected:
+    enum FrameFlags
+    {
+      FLAG_KEY_FRAME = 0x0001
+    };
+
+    class CompressedImageHeader
+    {
+    public:
+      CompressedImageHeader()
+        : m_ScalarType(0)
+        , m_NumberOfComponents(0)
+        , m_ImageType(0)
+        , m_CompressionMethod(COMPRESSION_NONE)
+        , m_Flags(0)
+        , m_FrameIndex(0)
+        , m_ImageDataSizeInBytes(0)
+        , m_CompressedDataSizeInBytes(0)
+      {
+        m_FrameSize[0] = m_FrameSize[1] = m_FrameSize[2] = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+          for (int j = 0; j < 4; ++j)
+          {
+            m_EmbeddedImageTransform[i][j] = (i == j) ? 1.f : 0.f;
+          }
+        }
+      }
+
+      size_t GetMessageHeaderSize()
+      {
+        size_t headersize = 0;
+        headersize += sizeof(igtl_uint16);        // m_ScalarType
+        headersize += sizeof(igtl_uint16);        // m_NumberOfComponents
+        headersize += sizeof(igtl_uint16);        // m_ImageType
+        headersize += sizeof(igtl_uint16) * 3;    // m_FrameSize[3]
+        headersize += sizeof(igtl_uint16);        // m_CompressionMethod
+        headersize += sizeof(igtl_uint16);        // m_Flags
+        headersize += sizeof(igtl_uint32);        // m_FrameIndex
+        headersize += sizeof(igtl_uint32);        // m_ImageDataSizeInBytes
+        headersize += sizeof(igtl_uint32);        // m_CompressedDataSizeInBytes
+        headersize += sizeof(igtl::Matrix4x4);    // m_EmbeddedImageTransform[4][4]
+
+        return headersize;
+      }
+
+      void ConvertEndianness()
+      {
+        if (igtl_is_little_endian())
+        {
+          m_ScalarType = BYTE_SWAP_INT16(m_ScalarType);
+          m_NumberOfComponents = BYTE_SWAP_INT16(m_NumberOfComponents);
+          m_ImageType = BYTE_SWAP_INT16(m_ImageType);
+          m_FrameSize[0] = BYTE_SWAP_INT16(m_FrameSize[0]);
+          m_FrameSize[1] = BYTE_SWAP_INT16(m_FrameSize[1]);
+          m_FrameSize[2] = BYTE_SWAP_INT16(m_FrameSize[2]);
+          m_CompressionMethod = BYTE_SWAP_INT16(m_CompressionMethod);
+          m_Flags = BYTE_SWAP_INT16(m_Flags);
+          m_FrameIndex = BYTE_SWAP_INT32(m_FrameIndex);
+          m_ImageDataSizeInBytes = BYTE_SWAP_INT32(m_ImageDataSizeInBytes);
+          m_CompressedDataSizeInBytes = BYTE_SWAP_INT32(m_CompressedDataSizeInBytes);
+          igtl_uint32* transformElements = reinterpret_cast<igtl_uint32*>(&m_EmbeddedImageTransform[0][0]);
+          for (int i = 0; i < 16; ++i)
+          {
+            transformElements[i] = BYTE_SWAP_INT32(transformElements[i]);
+          }
+        }
+      }
+
+      igtl_uint16     m_ScalarType;                 /* scalar type */
+      igtl_uint16     m_NumberOfComponents;         /* number of scalar components */
+      igtl_uint16     m_ImageType;                  /* image type */
+      igtl_uint16     m_FrameSize[3];               /* entire image volume size */
+      igtl_uint16     m_CompressionMethod;          /* compression method of the image data */
+      igtl_uint16     m_Flags;                      /* combination of FrameFlags */
+      igtl_uint32     m_FrameIndex;                 /* index of the frame in the stream */
+      igtl_uint32     m_ImageDataSizeInBytes;       /* size of the uncompressed image, in bytes */
+      igtl_uint32     m_CompressedDataSizeInBytes;  /* size of the compressed image, in bytes */
+      igtl::Matrix4x4 m_EmbeddedImageTransform;     /* matrix representing the IJK to world transformation */
+    };
+
+    virtual int  CalculateContentBufferSize();
+    virtual int  PackContent();
+    virtual int  UnpackContent();
+
+    PlusCompressedImageMessage();
+    ~PlusCompressedImageMessage();
+
+    std::vector<unsigned char> m_CompressedData;
+
+    CompressedImageHeader m_MessageHeader;
+  };
+
+#pragma pack()
+
+} // namespace igtl
+
+#endif
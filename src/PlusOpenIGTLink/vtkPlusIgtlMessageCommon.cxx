@@ -439,6 +439,104 @@ PlusStatus vtkPlusIgtlMessageCommon::UnpackImageMessage(igtl::MessageHeader::Poi
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusIgtlMessageCommon::PackCompressedImageMessage(igtl::PlusCompressedImageMessage::Pointer imageMessage,
+    igsioTrackedFrame& trackedFrame,
+    const vtkMatrix4x4& matrix,
+    igtl::PlusCompressedImageMessage::CompressionState& compressionState,
+    vtkIGSIOFrameConverter* frameConverter/*=NULL*/)
+{
+  if (imageMessage.IsNull())
+  {
+    LOG_ERROR("Failed to pack compressed image message - input image message is NULL");
+    return PLUS_FAIL;
+  }
+
+  if (!trackedFrame.GetImageData()->IsImageValid())
+  {
+    LOG_WARNING("Unable to send compressed image message - image data is NOT valid!");
+    return PLUS_FAIL;
+  }
+
+  vtkSmartPointer<vtkIGSIOFrameConverter> converter = frameConverter;
+  if (!converter)
+  {
+    converter = vtkSmartPointer<vtkIGSIOFrameConverter>::New();
+  }
+
+  vtkSmartPointer<vtkImageData> frameImage = converter->GetUncompressedImage(trackedFrame.GetImageData());
+  if (imageMessage->SetImage(frameImage, trackedFrame.GetImageData()->GetImageType(), compressionState) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to pack compressed image message - unable to compress image");
+    return PLUS_FAIL;
+  }
+  imageMessage->SetEmbeddedImageTransform(matrix);
+
+  igtl::TimeStamp::Pointer igtlFrameTime = igtl::TimeStamp::New();
+  igtlFrameTime->SetTime(trackedFrame.GetTimestamp());
+  imageMessage->SetTimeStamp(igtlFrameTime);
+  imageMessage->Pack();
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusIgtlMessageCommon::UnpackCompressedImageMessage(igtl::MessageHeader::Pointer headerMsg,
+    igtl::Socket* socket,
+    igsioTrackedFrame& trackedFrame,
+    const igsioTransformName& embeddedTransformName,
+    igtl::PlusCompressedImageMessage::CompressionState& compressionState,
+    int crccheck)
+{
+  if (headerMsg.IsNull())
+  {
+    LOG_ERROR("Unable to unpack compressed image message - header message is NULL!");
+    return PLUS_FAIL;
+  }
+
+  if (socket == NULL)
+  {
+    LOG_ERROR("Unable to unpack compressed image message - socket is NULL!");
+    return PLUS_FAIL;
+  }
+
+  igtl::PlusCompressedImageMessage::Pointer imgMsg = dynamic_cast<igtl::PlusCompressedImageMessage*>(headerMsg.GetPointer());
+  if (imgMsg.IsNull())
+  {
+    imgMsg = igtl::PlusCompressedImageMessage::New();
+  }
+  imgMsg->SetMessageHeader(headerMsg);
+  imgMsg->AllocateBuffer();
+
+  socket->Receive(imgMsg->GetBufferBodyPointer(), imgMsg->GetBufferBodySize());
+
+  int c = imgMsg->Unpack(crccheck);
+  if (!(c & igtl::MessageHeader::UNPACK_BODY))
+  {
+    LOG_ERROR("Couldn't receive compressed image message from server!");
+    return PLUS_FAIL;
+  }
+
+  igsioVideoFrame frame;
+  if (imgMsg->GetImage(frame, compressionState) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  igtl::TimeStamp::Pointer igtlTimestamp = igtl::TimeStamp::New();
+  imgMsg->GetTimeStamp(igtlTimestamp);
+
+  trackedFrame.SetImageData(frame);
+  trackedFrame.SetTimestamp(igtlTimestamp->GetTimeStamp());
+
+  if (embeddedTransformName.IsValid())
+  {
+    trackedFrame.SetFrameTransform(embeddedTransformName, imgMsg->GetEmbeddedImageTransform());
+  }
+
+  return PLUS_SUCCESS;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusIgtlMessageCommon::PackImageMetaMessage(igtl::ImageMetaMessage::Pointer imageMetaMessage,
     igsioCommon::ImageMetaDataList& imageMetaDataList)
@@ -18,6 +18,7 @@ See License.txt for details.
 #include <igtlImageMessage.h>
 #include <igtlImageMetaMessage.h>
 #include <igtlMessageBase.h>
+#include <igtlPlusCompressedImageMessage.h>
 #include <igtlPlusTrackedFrameMessage.h>
 #include <igtlPlusUsMessage.h>
 #include <igtlPolyDataMessage.h>
@@ -73,6 +74,17 @@ public:
   /*! Unpack image message to tracked frame */
   static PlusStatus UnpackImageMessage(igtl::MessageHeader::Pointer headerMsg, igtl::Socket* socket, igsioTrackedFrame& trackedFrame, const igsioTransformName& embeddedTransformName, int crccheck);
 
+  /*! Pack compressed image message from tracked frame. The compression state holds the previous frame of the image stream. */
+  static PlusStatus PackCompressedImageMessage(igtl::PlusCompressedImageMessage::Pointer imageMessage, igsioTrackedFrame& trackedFrame, const vtkMatrix4x4& imageToReferenceTransform,
+      igtl::PlusCompressedImageMessage::CompressionState& compressionState, vtkIGSIOFrameConverter* frameConverter = NULL);
+
+  /*!
+    Unpack compressed image message to tracked frame. The compression state holds the previous frame of the image stream.
+    Returns PLUS_FAIL if the frame cannot be decoded (e.g., because the previous frame has been dropped).
+  */
+  static PlusStatus UnpackCompressedImageMessage(igtl::MessageHeader::Pointer headerMsg, igtl::Socket* socket, igsioTrackedFrame& trackedFrame, const igsioTransformName& embeddedTransformName,
+      igtl::PlusCompressedImageMessage::CompressionState& compressionState, int crccheck);
+
   /*! Pack image meta deta message from vtkPlusServer::ImageMetaDataList  */
   static PlusStatus PackImageMetaMessage(igtl::ImageMetaMessage::Pointer imageMetaMessage, igsioCommon::ImageMetaDataList& imageMetaDataList);
 
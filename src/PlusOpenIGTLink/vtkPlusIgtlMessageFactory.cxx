@@ -24,6 +24,7 @@ See License.txt for details.
 #include "igtlCommandMessage.h"
 #include "igtlImageMessage.h"
 #include "igtlPlusClientInfoMessage.h"
+#include "igtlPlusCompressedImageMessage.h"
 #include "igtlPlusTrackedFrameMessage.h"
 #include "igtlPlusUsMessage.h"
 #include "igtlPositionMessage.h"
@@ -54,6 +55,7 @@ vtkPlusIgtlMessageFactory::vtkPlusIgtlMessageFactory()
   this->IgtlFactory->AddMessageType("CLIENTINFO", (PointerToMessageBaseNew)&igtl::PlusClientInfoMessage::New);
   this->IgtlFactory->AddMessageType("TRACKEDFRAME", (PointerToMessageBaseNew)&igtl::PlusTrackedFrameMessage::New);
   this->IgtlFactory->AddMessageType("USMESSAGE", (PointerToMessageBaseNew)&igtl::PlusUsMessage::New);
+  this->IgtlFactory->AddMessageType("COMPIMAGE", (PointerToMessageBaseNew)&igtl::PlusCompressedImageMessage::New);
 }
 
 //----------------------------------------------------------------------------
@@ -138,9 +140,66 @@ igtl::MessageBase::Pointer vtkPlusIgtlMessageFactory::CreateSendMessage(const st
   return aMessageBase;
 }
 
+//----------------------------------------------------------------------------
+bool vtkPlusIgtlMessageFactory::GetPackedMessageCacheKey(const std::string& messageType, const PlusIgtlClientInfo& clientInfo, igsioTrackedFrame& trackedFrame, std::string& cacheKey)
+{
+  std::ostringstream key;
+  key << messageType << "|" << clientInfo.GetClientHeaderVersion();
+  if (messageType == "IMAGE")
+  {
+    if (trackedFrame.GetImageData()->IsFrameEncoded())
+    {
+      // encoded frames are decoded by the frame converter of the client, which keeps decoding state
+      return false;
+    }
+    for (std::vector<PlusIgtlClientInfo::ImageStream>::const_iterator imageStreamIterator = clientInfo.ImageStreams.begin(); imageStreamIterator != clientInfo.ImageStreams.end(); ++imageStreamIterator)
+    {
+      if (imageStreamIterator->Compression != igtl::PlusCompressedImageMessage::COMPRESSION_NONE)
+      {
+        // compressed images are encoded relative to the previous frame that has been sent to the client
+        return false;
+      }
+      key << "|" << imageStreamIterator->Name << ">" << imageStreamIterator->EmbeddedTransformToFrame;
+    }
+  }
+  else if (messageType == "TRANSFORM" || messageType == "POSITION")
+  {
+    for (std::vector<igsioTransformName>::const_iterator transformNameIterator = clientInfo.TransformNames.begin(); transformNameIterator != clientInfo.TransformNames.end(); ++transformNameIterator)
+    {
+      key << "|" << transformNameIterator->GetTransformName();
+    }
+  }
+  else if (messageType == "TRACKEDFRAME")
+  {
+    for (std::vector<igsioTransformName>::const_iterator transformNameIterator = clientInfo.TransformNames.begin(); transformNameIterator != clientInfo.TransformNames.end(); ++transformNameIterator)
+    {
+      key << "|" << transformNameIterator->GetTransformName();
+    }
+    if (!clientInfo.ImageStreams.empty())
+    {
+      key << "|" << clientInfo.ImageStreams[0].Name << ">" << clientInfo.ImageStreams[0].EmbeddedTransformToFrame;
+    }
+  }
+  else if (messageType == "STRING")
+  {
+    for (std::vector<std::string>::const_iterator stringNameIterator = clientInfo.StringNames.begin(); stringNameIterator != clientInfo.StringNames.end(); ++stringNameIterator)
+    {
+      key << "|" << *stringNameIterator;
+    }
+  }
+  else if (messageType != "USMESSAGE")
+  {
+    // VIDEO messages are encoded by the stateful encoder of the client, TDATA messages depend on the TDATA state of the client
+    return false;
+  }
+
+  cacheKey = key.str();
+  return true;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusIgtlMessageFactory::PackMessages(int clientId, const PlusIgtlClientInfo& clientInfo, std::vector<igtl::MessageBase::Pointer>& igtlMessages, igsioTrackedFrame& trackedFrame,
-    bool packValidTransformsOnly, vtkIGSIOTransformRepository* transformRepository/*=NULL*/)
+    bool packValidTransformsOnly, vtkIGSIOTransformRepository* transformRepository/*=NULL*/, PackedMessageCache* messageCache/*=NULL*/)
 {
   int numberOfErrors(0);
   igtlMessages.clear();
@@ -153,6 +212,21 @@ PlusStatus vtkPlusIgtlMessageFactory::PackMessages(int clientId, const PlusIgtlC
   for (std::vector<std::string>::const_iterator messageTypeIterator = clientInfo.IgtlMessageTypes.begin(); messageTypeIterator != clientInfo.IgtlMessageTypes.end(); ++ messageTypeIterator)
   {
     std::string messageType = (*messageTypeIterator);
+
+    // Reuse the messages that have been packed for another client with the same subscription
+    std::string cacheKey;
+    if (messageCache != NULL && this->GetPackedMessageCacheKey(messageType, clientInfo, trackedFrame, cacheKey))
+    {
+      PackedMessageCache::const_iterator cachedMessagesIterator = messageCache->find(cacheKey);
+      if (cachedMessagesIterator != messageCache->end())
+      {
+        igtlMessages.insert(igtlMessages.end(), cachedMessagesIterator->second.begin(), cachedMessagesIterator->second.end());
+        continue;
+      }
+    }
+    int numberOfErrorsBeforePacking = numberOfErrors;
+    std::vector<igtl::MessageBase::Pointer>::size_type numberOfMessagesBeforePacking = igtlMessages.size();
+
     igtl::MessageBase::Pointer igtlMessage;
     try
     {
@@ -212,6 +286,13 @@ PlusStatus vtkPlusIgtlMessageFactory::PackMessages(int clientId, const PlusIgtlC
     else
     {
       LOG_WARNING("This message type (" << messageType << ") is not supported!");
+      continue;
+    }
+
+    // Only completely packed messages are shared, so that packing errors are reported for each client
+    if (!cacheKey.empty() && numberOfErrors == numberOfErrorsBeforePacking)
+    {
+      (*messageCache)[cacheKey].assign(igtlMessages.begin() + numberOfMessagesBeforePacking, igtlMessages.end());
     }
   }
 
@@ -425,7 +506,22 @@ int vtkPlusIgtlMessageFactory::PackImageMessage(const PlusIgtlClientInfo& client
 
     std::string deviceName = imageTransformName.From() + std::string("_") + imageTransformName.To();
 
-    igtl::ImageMessage::Pointer imageMessage = dynamic_cast<igtl::ImageMessage*>(igtlMessage->Clone().GetPointer());
+    // The client requested lossless compression, send the image in a COMPIMAGE message instead of IMAGE
+    igtl::MessageBase::Pointer imageMessage;
+    if (imageStream.Compression != igtl::PlusCompressedImageMessage::COMPRESSION_NONE)
+    {
+      imageMessage = this->CreateSendMessage("COMPIMAGE", clientInfo.GetClientHeaderVersion());
+    }
+    else
+    {
+      imageMessage = igtlMessage->Clone();
+    }
+    if (imageMessage.IsNull())
+    {
+      LOG_ERROR("Failed to create " << messageType << " message - unable to create image message");
+      numberOfErrors++;
+      continue;
+    }
     if (trackedFrame.IsFrameFieldDefined(igsioTrackedFrame::FIELD_FRIENDLY_DEVICE_NAME))
     {
       // Allow overriding of device name with something human readable
@@ -448,13 +544,23 @@ int vtkPlusIgtlMessageFactory::PackImageMessage(const PlusIgtlClientInfo& client
       imageMessage->SetMetaDataElement(*stringNameIterator, IANA_TYPE_US_ASCII, trackedFrame.GetFrameField(*stringNameIterator));
     }
 
-    if (vtkPlusIgtlMessageCommon::PackImageMessage(imageMessage, trackedFrame, *matrix, imageStream.FrameConverter) != PLUS_SUCCESS)
+    igtl::PlusCompressedImageMessage::Pointer compressedImageMessage = dynamic_cast<igtl::PlusCompressedImageMessage*>(imageMessage.GetPointer());
+    if (compressedImageMessage.IsNotNull())
+    {
+      if (vtkPlusIgtlMessageCommon::PackCompressedImageMessage(compressedImageMessage, trackedFrame, *matrix, *imageStream.CompressionState, imageStream.FrameConverter) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to create " << messageType << " message - unable to pack compressed image message");
+        numberOfErrors++;
+        continue;
+      }
+    }
+    else if (vtkPlusIgtlMessageCommon::PackImageMessage(dynamic_cast<igtl::ImageMessage*>(imageMessage.GetPointer()), trackedFrame, *matrix, imageStream.FrameConverter) != PLUS_SUCCESS)
     {
       LOG_ERROR("Failed to create " << messageType << " message - unable to pack image message");
       numberOfErrors++;
       continue;
     }
-    igtlMessages.push_back(imageMessage.GetPointer());
+    igtlMessages.push_back(imageMessage);
   }
   return numberOfErrors;
 }
@@ -20,6 +20,9 @@
 // PlusLib includes
 #include "PlusIgtlClientInfo.h"
 
+// STL includes
+#include <map>
+
 class vtkXMLDataElement;
 //class igsioTrackedFrame; 
 //class vtkIGSIOTransformRepository;
@@ -42,6 +45,13 @@ public:
   /*! Function pointer for storing New() static methods of igtl::MessageBase classes */
   typedef igtl::MessageBase::Pointer (*PointerToMessageBaseNew)();
 
+  /*!
+    Messages packed from a single tracked frame, by cache key (see PackMessages).
+    Clients that request the same content get the same packed message objects, so each message is
+    packed only once per frame. A cache must not be reused for another tracked frame.
+  */
+  typedef std::map<std::string, std::vector<igtl::MessageBase::Pointer> > PackedMessageCache;
+
   /*!
   Get pointer to message type new function, or NULL if the message type not registered
   Usage: igtl::MessageBase::Pointer message = GetMessageTypeNewPointer("IMAGE")();
@@ -76,9 +86,12 @@ public:
   \param igtMessages Output list for the generated IGTL messages
   \param trackedFrame Input tracked frame data used for IGTL message generation
   \param transformRepository Transform repository used for computing the selected transforms
+  \param messageCache Optional cache of the messages that have been already packed from the same tracked frame for other clients.
+    Messages that only depend on the tracked frame and the client subscription (message type, header version, image streams,
+    transform and string names) are taken from the cache if available, otherwise they are packed and added to the cache.
   */
   PlusStatus PackMessages(int clientId, const PlusIgtlClientInfo& clientInfo, std::vector<igtl::MessageBase::Pointer>& igtMessages, igsioTrackedFrame& trackedFrame,
-                          bool packValidTransformsOnly, vtkIGSIOTransformRepository* transformRepository = NULL);
+                          bool packValidTransformsOnly, vtkIGSIOTransformRepository* transformRepository = NULL, PackedMessageCache* messageCache = NULL);
 
 protected:
   vtkPlusIgtlMessageFactory();
@@ -87,6 +100,12 @@ protected:
   igtl::MessageFactory::Pointer IgtlFactory;
 
 protected:
+  /*!
+    Get the key that identifies the content of the messages of a message type for a client in a PackedMessageCache.
+    Returns false if the messages cannot be shared between clients (e.g., they depend on the state of the client).
+  */
+  bool GetPackedMessageCacheKey(const std::string& messageType, const PlusIgtlClientInfo& clientInfo, igsioTrackedFrame& trackedFrame, std::string& cacheKey);
+
   int PackImageMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, const std::string& messageType,
                        igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages, int clientId);
 #if defined(OpenIGTLink_ENABLE_VIDEOSTREAMING)
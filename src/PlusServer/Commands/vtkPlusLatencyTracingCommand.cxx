@@ -0,0 +1,200 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusLatencyTracer.h"
+#include "vtkPlusCommandProcessor.h"
+#include "vtkPlusLatencyTracingCommand.h"
+
+// STL includes
+#include <iomanip>
+
+//----------------------------------------------------------------------------
+
+vtkStandardNewMacro(vtkPlusLatencyTracingCommand);
+
+//----------------------------------------------------------------------------
+
+namespace
+{
+  static const std::string START_CMD = "StartLatencyTracing";
+  static const std::string STOP_CMD = "StopLatencyTracing";
+  static const std::string GET_STATISTICS_CMD = "GetLatencyStatistics";
+  static const std::string SAVE_TRACE_CMD = "SaveLatencyTrace";
+
+  static const std::string DEFAULT_TRACE_FILENAME = "LatencyTrace.json";
+}
+
+//----------------------------------------------------------------------------
+vtkPlusLatencyTracingCommand::vtkPlusLatencyTracingCommand()
+  : MaxNumberOfTraceEvents(-1)
+{
+}
+
+//----------------------------------------------------------------------------
+vtkPlusLatencyTracingCommand::~vtkPlusLatencyTracingCommand()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusLatencyTracingCommand::SetNameToStart() { SetName(START_CMD); }
+void vtkPlusLatencyTracingCommand::SetNameToStop() { SetName(STOP_CMD); }
+void vtkPlusLatencyTracingCommand::SetNameToGetStatistics() { SetName(GET_STATISTICS_CMD); }
+void vtkPlusLatencyTracingCommand::SetNameToSaveTrace() { SetName(SAVE_TRACE_CMD); }
+
+//----------------------------------------------------------------------------
+void vtkPlusLatencyTracingCommand::GetCommandNames(std::list<std::string>& cmdNames)
+{
+  cmdNames.clear();
+  cmdNames.push_back(START_CMD);
+  cmdNames.push_back(STOP_CMD);
+  cmdNames.push_back(GET_STATISTICS_CMD);
+  cmdNames.push_back(SAVE_TRACE_CMD);
+}
+
+//----------------------------------------------------------------------------
+std::string vtkPlusLatencyTracingCommand::GetDescription(const std::string& commandName)
+{
+  std::string desc;
+  if (commandName.empty() || igsioCommon::IsEqualInsensitive(commandName, START_CMD))
+  {
+    desc += START_CMD;
+    desc += ": Clear the collected latency data and start latency tracing of the acquisition-to-OpenIGTLink pipeline. Attributes: MaxNumberOfTraceEvents: number of most recent events kept for the trace file (optional)";
+  }
+  if (commandName.empty() || igsioCommon::IsEqualInsensitive(commandName, STOP_CMD))
+  {
+    desc += STOP_CMD;
+    desc += ": Stop latency tracing. The collected data is kept.";
+  }
+  if (commandName.empty() || igsioCommon::IsEqualInsensitive(commandName, GET_STATISTICS_CMD))
+  {
+    desc += GET_STATISTICS_CMD;
+    desc += ": Get the number of samples, median, 99th percentile and maximum latency of each stage (in ms). The values are also returned in the metadata of the response, one entry per stage.";
+  }
+  if (commandName.empty() || igsioCommon::IsEqualInsensitive(commandName, SAVE_TRACE_CMD))
+  {
+    desc += SAVE_TRACE_CMD;
+    desc += ": Save the most recent events to a Chrome trace (JSON) file. Attributes: OutputFilename: name of the output file in the output directory (optional, default: " + DEFAULT_TRACE_FILENAME + ")";
+  }
+  return desc;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusLatencyTracingCommand::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+}
+
+//----------------------------------------------------------------------------
+vtkPlusCommand* vtkPlusLatencyTracingCommand::Clone()
+{
+  return New();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusLatencyTracingCommand::ReadConfiguration(vtkXMLDataElement* aConfig)
+{
+  if (vtkPlusCommand::ReadConfiguration(aConfig) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  if (igsioCommon::IsEqualInsensitive(this->Name, START_CMD))
+  {
+    XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, MaxNumberOfTraceEvents, aConfig);
+  }
+  if (igsioCommon::IsEqualInsensitive(this->Name, SAVE_TRACE_CMD))
+  {
+    XML_READ_STRING_ATTRIBUTE_OPTIONAL(OutputFilename, aConfig);
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusLatencyTracingCommand::WriteConfiguration(vtkXMLDataElement* aConfig)
+{
+  if (vtkPlusCommand::WriteConfiguration(aConfig) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  if (igsioCommon::IsEqualInsensitive(this->Name, START_CMD) && this->MaxNumberOfTraceEvents >= 0)
+  {
+    aConfig->SetIntAttribute("MaxNumberOfTraceEvents", this->MaxNumberOfTraceEvents);
+  }
+  if (igsioCommon::IsEqualInsensitive(this->Name, SAVE_TRACE_CMD))
+  {
+    XML_WRITE_STRING_ATTRIBUTE_REMOVE_IF_EMPTY(OutputFilename, aConfig);
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusLatencyTracingCommand::Execute()
+{
+  LOG_DEBUG("vtkPlusLatencyTracingCommand::Execute: " << this->Name);
+
+  PlusLatencyTracer* latencyTracer = PlusLatencyTracer::GetInstance();
+
+  if (igsioCommon::IsEqualInsensitive(this->Name, START_CMD))
+  {
+    latencyTracer->SetEnabled(false);
+    if (this->MaxNumberOfTraceEvents >= 0)
+    {
+      latencyTracer->SetMaxNumberOfTraceEvents(this->MaxNumberOfTraceEvents);
+    }
+    latencyTracer->Reset();
+    latencyTracer->SetEnabled(true);
+    this->QueueCommandResponse(PLUS_SUCCESS, "Latency tracing started.");
+    return PLUS_SUCCESS;
+  }
+  else if (igsioCommon::IsEqualInsensitive(this->Name, STOP_CMD))
+  {
+    latencyTracer->SetEnabled(false);
+    this->QueueCommandResponse(PLUS_SUCCESS, "Latency tracing stopped.");
+    return PLUS_SUCCESS;
+  }
+  else if (igsioCommon::IsEqualInsensitive(this->Name, GET_STATISTICS_CMD))
+  {
+    std::vector<PlusLatencyTracer::StageStatistics> statistics;
+    latencyTracer->GetStatistics(statistics);
+    if (statistics.empty())
+    {
+      this->QueueCommandResponse(PLUS_FAIL, "Command failed. See error message.", "No latency data has been collected. Start latency tracing with the " + START_CMD + " command.");
+      return PLUS_FAIL;
+    }
+
+    std::ostringstream message;
+    message << std::fixed << std::setprecision(2) << "Latency statistics (stage: samples, median, 99th percentile, max in ms):";
+    igtl::MessageBase::MetaDataMap metadata;
+    for (std::vector<PlusLatencyTracer::StageStatistics>::iterator it = statistics.begin(); it != statistics.end(); ++it)
+    {
+      std::ostringstream values;
+      values << std::fixed << std::setprecision(2) << it->NumberOfSamples << " " << it->MedianSec * 1000.0 << " " << it->Percentile99Sec * 1000.0 << " " << it->MaxSec * 1000.0;
+      message << "\n" << it->Name << ": " << values.str();
+      metadata[it->Name] = std::pair<IANA_ENCODING_TYPE, std::string>(IANA_TYPE_US_ASCII, values.str());
+    }
+    this->QueueCommandResponse(PLUS_SUCCESS, message.str(), "", &metadata);
+    return PLUS_SUCCESS;
+  }
+  else if (igsioCommon::IsEqualInsensitive(this->Name, SAVE_TRACE_CMD))
+  {
+    std::string outputFilePath = vtkPlusConfig::GetInstance()->GetOutputPath(this->OutputFilename.empty() ? DEFAULT_TRACE_FILENAME : this->OutputFilename);
+    if (latencyTracer->WriteChromeTrace(outputFilePath) != PLUS_SUCCESS)
+    {
+      this->QueueCommandResponse(PLUS_FAIL, "Command failed. See error message.", "Failed to save latency trace to " + outputFilePath);
+      return PLUS_FAIL;
+    }
+    this->QueueCommandResponse(PLUS_SUCCESS, "Latency trace saved to " + outputFilePath);
+    return PLUS_SUCCESS;
+  }
+
+  this->QueueCommandResponse(PLUS_FAIL, "Command failed. See error message.", "Unknown command: " + this->Name);
+  return PLUS_FAIL;
+}
@@ -0,0 +1,67 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusLatencyTracingCommand_h
+#define __vtkPlusLatencyTracingCommand_h
+
+#include "vtkPlusServerExport.h"
+
+#include "vtkPlusCommand.h"
+
+/*!
+  \class vtkPlusLatencyTracingCommand
+  \brief This command starts and stops latency tracing (see PlusLatencyTracer) and returns or saves the results.
+  \ingroup PlusLibPlusServer
+ */
+class vtkPlusServerExport vtkPlusLatencyTracingCommand : public vtkPlusCommand
+{
+public:
+
+  static vtkPlusLatencyTracingCommand* New();
+  vtkTypeMacro(vtkPlusLatencyTracingCommand, vtkPlusCommand);
+  virtual void PrintSelf(ostream& os, vtkIndent indent);
+  virtual vtkPlusCommand* Clone();
+
+  /*! Executes the command  */
+  virtual PlusStatus Execute();
+
+  /*! Read command parameters from XML */
+  virtual PlusStatus ReadConfiguration(vtkXMLDataElement* aConfig);
+
+  /*! Write command parameters to XML */
+  virtual PlusStatus WriteConfiguration(vtkXMLDataElement* aConfig);
+
+  /*! Get all the command names that this class can execute */
+  virtual void GetCommandNames(std::list<std::string>& cmdNames);
+
+  /*! Gets the description for the specified command name. */
+  virtual std::string GetDescription(const std::string& commandName);
+
+  vtkGetStdStringMacro(OutputFilename);
+  vtkSetStdStringMacro(OutputFilename);
+
+  vtkGetMacro(MaxNumberOfTraceEvents, int);
+  vtkSetMacro(MaxNumberOfTraceEvents, int);
+
+  void SetNameToStart();
+  void SetNameToStop();
+  void SetNameToGetStatistics();
+  void SetNameToSaveTrace();
+
+protected:
+  vtkPlusLatencyTracingCommand();
+  virtual ~vtkPlusLatencyTracingCommand();
+
+private:
+  std::string OutputFilename;
+  /*! Number of most recent events kept for the trace file, negative value means that the current setting is kept */
+  int MaxNumberOfTraceEvents;
+
+  vtkPlusLatencyTracingCommand(const vtkPlusLatencyTracingCommand&);
+  void operator=(const vtkPlusLatencyTracingCommand&);
+};
+
+#endif
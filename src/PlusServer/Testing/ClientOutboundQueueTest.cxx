@@ -0,0 +1,536 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file ClientOutboundQueueTest.cxx
+  \brief Verifies the bounds and the overflow policies (DROP_OLDEST, DROP_NEWEST, NEVER_DROP) of the outbound
+  message queue of the OpenIGTLink server clients, and that the server disconnects a client that stops reading.
+  The client is a plain OpenIGTLink socket that is connected to the server through the loopback interface.
+  Also verifies that the next compressed frame is a key frame if a compressed image message of a client is dropped.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "igtlPlusCompressedImageMessage.h"
+#include "vtkPlusOpenIGTLinkServer.h"
+
+// IGSIO includes
+#include <vtkIGSIOAccurateTimer.h>
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkObjectFactory.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// OpenIGTLink includes
+#include <igtlClientSocket.h>
+#include <igtlImageMessage.h>
+#include <igtlMessageHeader.h>
+#include <igtlServerSocket.h>
+#include <igtlStatusMessage.h>
+
+// STL includes
+#include <thread>
+
+//----------------------------------------------------------------------------
+/*! Gives the test access to the client handling of the server without starting the server threads */
+class vtkPlusOpenIGTLinkServerTester : public vtkPlusOpenIGTLinkServer
+{
+public:
+  static vtkPlusOpenIGTLinkServerTester* New();
+  vtkTypeMacro(vtkPlusOpenIGTLinkServerTester, vtkPlusOpenIGTLinkServer);
+
+  using vtkPlusOpenIGTLinkServer::AddClient;
+  using vtkPlusOpenIGTLinkServer::DisconnectFailedClients;
+  using vtkPlusOpenIGTLinkServer::QueueMessageForClient;
+  using vtkPlusOpenIGTLinkServer::QueueMessageResponseForClient;
+  using vtkPlusOpenIGTLinkServer::SendMessageResponses;
+  using vtkPlusOpenIGTLinkServer::SetNumberOfRetryAttempts;
+  using vtkPlusOpenIGTLinkServer::SetDelayBetweenRetryAttemptsSec;
+};
+vtkStandardNewMacro(vtkPlusOpenIGTLinkServerTester);
+
+namespace
+{
+  const int FIRST_TEST_PORT = 18950;
+  const int NUMBER_OF_TEST_PORTS = 50;
+  const float CLIENT_SEND_TIMEOUT_SEC = 0.1f;
+  // Maximum time for the server to answer a request or to detect a stalled client, generous for loaded test machines
+  const double MAX_RESPONSE_TIME_SEC = 20.0;
+  // Total size of the messages that are queued for a client that does not read, larger than the socket buffers
+  const int STALL_IMAGE_SIZE = 1024;
+  const int NUMBER_OF_STALL_MESSAGES = 32;
+
+  //----------------------------------------------------------------------------
+  igtl::MessageBase::Pointer CreateMessage(const std::string& name)
+  {
+    igtl::StatusMessage::Pointer message = igtl::StatusMessage::New();
+    message->SetDeviceName(name.c_str());
+    message->SetCode(igtl::StatusMessage::STATUS_OK);
+    message->Pack();
+    return message.GetPointer();
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Pop all messages from the queue and check that their names match the expected names */
+  int CheckQueueContents(ClientOutboundQueue& queue, const std::vector<std::string>& expectedNames, const std::string& description)
+  {
+    std::vector<std::string> names;
+    igtl::MessageBase::Pointer message;
+    while (queue.Pop(message, 0.0))
+    {
+      names.push_back(message->GetDeviceName());
+    }
+    if (names != expectedNames)
+    {
+      std::ostringstream actual;
+      std::ostringstream expected;
+      for (std::vector<std::string>::iterator it = names.begin(); it != names.end(); ++it)
+      {
+        actual << " " << *it;
+      }
+      for (std::vector<std::string>::const_iterator it = expectedNames.begin(); it != expectedNames.end(); ++it)
+      {
+        expected << " " << *it;
+      }
+      LOG_ERROR(description << ": queue contains" << actual.str() << ", expected" << expected.str());
+      return 1;
+    }
+    return 0;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestOverflowPolicies()
+  {
+    int numberOfErrors = 0;
+
+    // DROP_OLDEST removes the oldest message when the queue is full
+    {
+      ClientOutboundQueue queue(3);
+      queue.Push(CreateMessage("A"), ClientOutboundQueue::DROP_OLDEST);
+      queue.Push(CreateMessage("B"), ClientOutboundQueue::DROP_OLDEST);
+      if (!queue.Push(CreateMessage("C"), ClientOutboundQueue::DROP_OLDEST))
+      {
+        LOG_ERROR("DROP_OLDEST: message is dropped before the queue is full");
+        numberOfErrors++;
+      }
+      if (queue.Push(CreateMessage("D"), ClientOutboundQueue::DROP_OLDEST))
+      {
+        LOG_ERROR("DROP_OLDEST: no message is reported as dropped when the queue is full");
+        numberOfErrors++;
+      }
+      ClientOutboundQueue::Statistics stats = queue.GetStatistics();
+      if (stats.QueueDepth != 3 || stats.MaxQueueDepth != 3 || stats.NumberOfDroppedMessages != 1)
+      {
+        LOG_ERROR("DROP_OLDEST: statistics are depth=" << stats.QueueDepth << ", max depth=" << stats.MaxQueueDepth << ", dropped=" << stats.NumberOfDroppedMessages
+                  << ", expected depth=3, max depth=3, dropped=1");
+        numberOfErrors++;
+      }
+      numberOfErrors += CheckQueueContents(queue, { "B", "C", "D" }, "DROP_OLDEST");
+    }
+
+    // DROP_OLDEST does not remove messages that were queued with NEVER_DROP
+    {
+      ClientOutboundQueue queue(2);
+      queue.Push(CreateMessage("Response"), ClientOutboundQueue::NEVER_DROP);
+      queue.Push(CreateMessage("A"), ClientOutboundQueue::DROP_OLDEST);
+      queue.Push(CreateMessage("B"), ClientOutboundQueue::DROP_OLDEST);
+      numberOfErrors += CheckQueueContents(queue, { "Response", "B" }, "DROP_OLDEST with a NEVER_DROP message");
+    }
+
+    // If no message can be removed then the new message is discarded
+    {
+      ClientOutboundQueue queue(1);
+      queue.Push(CreateMessage("Response"), ClientOutboundQueue::NEVER_DROP);
+      if (queue.Push(CreateMessage("A"), ClientOutboundQueue::DROP_OLDEST))
+      {
+        LOG_ERROR("DROP_OLDEST: message is reported as queued, although the queue is full of NEVER_DROP messages");
+        numberOfErrors++;
+      }
+      numberOfErrors += CheckQueueContents(queue, { "Response" }, "DROP_OLDEST with only NEVER_DROP messages");
+    }
+
+    // DROP_NEWEST discards the new message when the queue is full
+    {
+      ClientOutboundQueue queue(2);
+      queue.Push(CreateMessage("A"), ClientOutboundQueue::DROP_NEWEST);
+      queue.Push(CreateMessage("B"), ClientOutboundQueue::DROP_NEWEST);
+      if (queue.Push(CreateMessage("C"), ClientOutboundQueue::DROP_NEWEST))
+      {
+        LOG_ERROR("DROP_NEWEST: no message is reported as dropped when the queue is full");
+        numberOfErrors++;
+      }
+      if (queue.GetStatistics().NumberOfDroppedMessages != 1)
+      {
+        LOG_ERROR("DROP_NEWEST: number of dropped messages is " << queue.GetStatistics().NumberOfDroppedMessages << ", expected 1");
+        numberOfErrors++;
+      }
+      numberOfErrors += CheckQueueContents(queue, { "A", "B" }, "DROP_NEWEST");
+    }
+
+    // NEVER_DROP messages are queued above the bound
+    {
+      ClientOutboundQueue queue(1);
+      queue.Push(CreateMessage("A"), ClientOutboundQueue::DROP_OLDEST);
+      if (!queue.Push(CreateMessage("Response"), ClientOutboundQueue::NEVER_DROP))
+      {
+        LOG_ERROR("NEVER_DROP: message is reported as dropped");
+        numberOfErrors++;
+      }
+      if (queue.GetStatistics().MaxQueueDepth != 2)
+      {
+        LOG_ERROR("NEVER_DROP: maximum queue depth is " << queue.GetStatistics().MaxQueueDepth << ", expected 2");
+        numberOfErrors++;
+      }
+      numberOfErrors += CheckQueueContents(queue, { "A", "Response" }, "NEVER_DROP");
+    }
+
+    // Zero maximum size means that the queue is not limited
+    {
+      const unsigned int numberOfMessages = 1000;
+      ClientOutboundQueue queue(0);
+      igtl::MessageBase::Pointer message = CreateMessage("A");
+      for (unsigned int i = 0; i < numberOfMessages; ++i)
+      {
+        if (!queue.Push(message, ClientOutboundQueue::DROP_NEWEST))
+        {
+          LOG_ERROR("Unlimited queue: message " << i << " is dropped");
+          numberOfErrors++;
+          break;
+        }
+      }
+      if (queue.GetStatistics().QueueDepth != numberOfMessages)
+      {
+        LOG_ERROR("Unlimited queue: queue depth is " << queue.GetStatistics().QueueDepth << ", expected " << numberOfMessages);
+        numberOfErrors++;
+      }
+    }
+
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestPopAndStop()
+  {
+    int numberOfErrors = 0;
+    const double shortTimeoutSec = 0.1;
+    ClientOutboundQueue queue(10);
+    igtl::MessageBase::Pointer message;
+
+    double startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    if (queue.Pop(message, shortTimeoutSec))
+    {
+      LOG_ERROR("Pop returned a message from an empty queue");
+      numberOfErrors++;
+    }
+    double elapsedTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - startTime;
+    if (elapsedTimeSec < 0.9 * shortTimeoutSec)
+    {
+      LOG_ERROR("Pop from an empty queue returned after " << elapsedTimeSec << " sec, expected timeout after " << shortTimeoutSec << " sec");
+      numberOfErrors++;
+    }
+
+    queue.Push(CreateMessage("A"), ClientOutboundQueue::DROP_OLDEST);
+    if (!queue.Pop(message, 0.0))
+    {
+      LOG_ERROR("Pop did not return the queued message");
+      numberOfErrors++;
+    }
+    queue.MessageSent();
+    if (queue.GetStatistics().NumberOfSentMessages != 1 || !queue.IsEmpty())
+    {
+      LOG_ERROR("Number of sent messages is " << queue.GetStatistics().NumberOfSentMessages << ", expected 1 and an empty queue");
+      numberOfErrors++;
+    }
+
+    // Stop wakes up a waiting writer and discards the queued messages
+    queue.Push(CreateMessage("B"), ClientOutboundQueue::DROP_OLDEST);
+    queue.Pop(message, 0.0);
+    startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    std::thread stopper([&queue, shortTimeoutSec]()
+    {
+      vtkIGSIOAccurateTimer::Delay(shortTimeoutSec);
+      queue.Stop();
+    });
+    bool messagePopped = queue.Pop(message, MAX_RESPONSE_TIME_SEC);
+    elapsedTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - startTime;
+    stopper.join();
+    if (messagePopped || elapsedTimeSec > MAX_RESPONSE_TIME_SEC / 2)
+    {
+      LOG_ERROR("Stop did not wake up the waiting Pop (returned " << (messagePopped ? "a message" : "no message") << " after " << elapsedTimeSec << " sec)");
+      numberOfErrors++;
+    }
+    if (queue.Push(CreateMessage("C"), ClientOutboundQueue::NEVER_DROP) || !queue.IsEmpty())
+    {
+      LOG_ERROR("Message is queued after the queue is stopped");
+      numberOfErrors++;
+    }
+
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Modify the image slightly, compress it as the next frame of the stream and return true if it is a key frame */
+  bool CompressNextFrame(vtkImageData* image, igtl::PlusCompressedImageMessage::CompressionState& state, igtl::MessageBase::Pointer& message)
+  {
+    static_cast<unsigned char*>(image->GetScalarPointer())[0]++;
+    igtl::PlusCompressedImageMessage::Pointer compressedMessage = igtl::PlusCompressedImageMessage::New();
+    compressedMessage->SetDeviceName("Image_Reference");
+    if (compressedMessage->SetImage(image, US_IMG_BRIGHTNESS, state) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to compress the image");
+    }
+    compressedMessage->Pack();
+    message = compressedMessage.GetPointer();
+    return compressedMessage->IsKeyFrame();
+  }
+
+  //----------------------------------------------------------------------------
+  int TestCompressedImageDrop()
+  {
+    int numberOfErrors = 0;
+
+    // The dropped message is reported to the caller
+    {
+      ClientOutboundQueue queue(1);
+      igtl::MessageBase::Pointer droppedMessage;
+      queue.Push(CreateMessage("A"), ClientOutboundQueue::DROP_OLDEST, UNDEFINED_TIMESTAMP, &droppedMessage);
+      queue.Push(CreateMessage("B"), ClientOutboundQueue::DROP_OLDEST, UNDEFINED_TIMESTAMP, &droppedMessage);
+      if (droppedMessage.IsNull() || std::string(droppedMessage->GetDeviceName()) != "A")
+      {
+        LOG_ERROR("DROP_OLDEST: dropped message is " << (droppedMessage.IsNull() ? "not reported" : droppedMessage->GetDeviceName()) << ", expected A");
+        numberOfErrors++;
+      }
+      droppedMessage = NULL;
+      queue.Push(CreateMessage("C"), ClientOutboundQueue::DROP_NEWEST, UNDEFINED_TIMESTAMP, &droppedMessage);
+      if (droppedMessage.IsNull() || std::string(droppedMessage->GetDeviceName()) != "C")
+      {
+        LOG_ERROR("DROP_NEWEST: dropped message is " << (droppedMessage.IsNull() ? "not reported" : droppedMessage->GetDeviceName()) << ", expected C");
+        numberOfErrors++;
+      }
+    }
+
+    vtkSmartPointer<vtkPlusOpenIGTLinkServerTester> server = vtkSmartPointer<vtkPlusOpenIGTLinkServerTester>::New();
+    ClientData client;
+    client.ClientId = 1;
+    client.OutboundQueue = std::make_shared<ClientOutboundQueue>(1);
+    PlusIgtlClientInfo::ImageStream imageStream;
+    imageStream.Name = "Image";
+    imageStream.EmbeddedTransformToFrame = "Reference";
+    imageStream.Compression = igtl::PlusCompressedImageMessage::COMPRESSION_DELTA_ZLIB;
+    client.ClientInfo.ImageStreams.push_back(imageStream);
+    igtl::PlusCompressedImageMessage::CompressionState& state = *client.ClientInfo.ImageStreams[0].CompressionState;
+
+    vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+    image->SetDimensions(64, 48, 1);
+    image->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+    memset(image->GetScalarPointer(), 0, 64 * 48);
+
+    // The first frame is a key frame and fills the queue, the next frame is a delta frame
+    igtl::MessageBase::Pointer message;
+    CompressNextFrame(image, state, message);
+    server->QueueMessageForClient(client, message, ClientOutboundQueue::DROP_NEWEST);
+    if (CompressNextFrame(image, state, message))
+    {
+      LOG_ERROR("Second frame of the stream is a key frame, expected a delta frame");
+      numberOfErrors++;
+    }
+
+    // The delta frame is dropped, the client would not be able to decode the following delta frames
+    if (server->QueueMessageForClient(client, message, ClientOutboundQueue::DROP_NEWEST))
+    {
+      LOG_ERROR("Compressed image message is queued, although the queue of the client is full");
+      numberOfErrors++;
+    }
+    if (!CompressNextFrame(image, state, message))
+    {
+      LOG_ERROR("Frame after a dropped compressed image message is a delta frame, expected a key frame");
+      numberOfErrors++;
+    }
+
+    // Dropping other messages does not force a key frame
+    server->QueueMessageForClient(client, CreateMessage("Status"), ClientOutboundQueue::DROP_NEWEST);
+    if (CompressNextFrame(image, state, message))
+    {
+      LOG_ERROR("Frame after a dropped status message is a key frame, expected a delta frame");
+      numberOfErrors++;
+    }
+
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Connect a client socket to a server socket on the loopback interface and return both ends of the connection */
+  PlusStatus ConnectFakeClient(igtl::ServerSocket::Pointer& listeningSocket, igtl::ClientSocket::Pointer& fakeClientSocket, igtl::ClientSocket::Pointer& acceptedSocket)
+  {
+    listeningSocket = igtl::ServerSocket::New();
+    int port = FIRST_TEST_PORT;
+    for (; port < FIRST_TEST_PORT + NUMBER_OF_TEST_PORTS; ++port)
+    {
+      if (listeningSocket->CreateServer(port) >= 0)
+      {
+        break;
+      }
+    }
+    if (port == FIRST_TEST_PORT + NUMBER_OF_TEST_PORTS)
+    {
+      LOG_ERROR("Cannot create a server socket on ports " << FIRST_TEST_PORT << "-" << FIRST_TEST_PORT + NUMBER_OF_TEST_PORTS - 1);
+      return PLUS_FAIL;
+    }
+
+    fakeClientSocket = igtl::ClientSocket::New();
+    if (fakeClientSocket->ConnectToServer("127.0.0.1", port) != 0)
+    {
+      LOG_ERROR("Cannot connect to port " << port);
+      return PLUS_FAIL;
+    }
+    fakeClientSocket->SetReceiveTimeout(static_cast<int>(MAX_RESPONSE_TIME_SEC * 1000));
+    acceptedSocket = listeningSocket->WaitForConnection(static_cast<unsigned long>(MAX_RESPONSE_TIME_SEC * 1000));
+    if (acceptedSocket.IsNull())
+    {
+      LOG_ERROR("Connection is not accepted on port " << port);
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  /*!
+    Connect a fake client to a server that uses a receiver and a writer thread for the client, check that a
+    request is answered, then stop reading and check that the server disconnects the client.
+  */
+  int TestStalledClientDisconnect()
+  {
+    vtkSmartPointer<vtkPlusOpenIGTLinkServerTester> server = vtkSmartPointer<vtkPlusOpenIGTLinkServerTester>::New();
+    server->SetEventLoopEnabled(false);
+    server->SetDefaultClientSendTimeoutSec(CLIENT_SEND_TIMEOUT_SEC);
+    server->SetNumberOfRetryAttempts(1);
+    server->SetDelayBetweenRetryAttemptsSec(0.01);
+
+    igtl::ServerSocket::Pointer listeningSocket;
+    igtl::ClientSocket::Pointer fakeClientSocket;
+    igtl::ClientSocket::Pointer acceptedSocket;
+    if (ConnectFakeClient(listeningSocket, fakeClientSocket, acceptedSocket) != PLUS_SUCCESS)
+    {
+      return 1;
+    }
+    server->AddClient(acceptedSocket);
+    // Client IDs start from 1 and this is the only server of the test
+    const int clientId = 1;
+
+    int numberOfErrors = 0;
+
+    // A client that reads receives the response to its request
+    igtl::GetStatusMessage::Pointer request = igtl::GetStatusMessage::New();
+    request->SetDeviceName("FakeClient");
+    request->Pack();
+    fakeClientSocket->Send(request->GetBufferPointer(), request->GetBufferSize());
+    igtl::MessageHeader::Pointer replyHeader = igtl::MessageHeader::New();
+    replyHeader->InitBuffer();
+    int bytesReceived = fakeClientSocket->Receive(replyHeader->GetBufferPointer(), replyHeader->GetBufferSize());
+    if (bytesReceived != replyHeader->GetBufferSize())
+    {
+      LOG_ERROR("No reply is received for the GET_STATUS request");
+      numberOfErrors++;
+    }
+    else
+    {
+      replyHeader->Unpack();
+      if (std::string(replyHeader->GetMessageType()) != "STATUS")
+      {
+        LOG_ERROR("Reply to the GET_STATUS request is a " << replyHeader->GetMessageType() << " message, expected STATUS");
+        numberOfErrors++;
+      }
+      fakeClientSocket->Skip(replyHeader->GetBodySizeToRead(), 0);
+    }
+    // The writer thread counts the message after the send call returned
+    ClientOutboundQueue::Statistics stats;
+    double startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    while (server->GetClientOutboundQueueStatistics(clientId, stats) == PLUS_SUCCESS && stats.NumberOfSentMessages == 0
+           && vtkIGSIOAccurateTimer::GetSystemTime() - startTime < MAX_RESPONSE_TIME_SEC)
+    {
+      vtkIGSIOAccurateTimer::Delay(0.01);
+    }
+    if (stats.NumberOfSentMessages != 1)
+    {
+      LOG_ERROR("Number of messages sent to the client is " << stats.NumberOfSentMessages << ", expected 1");
+      numberOfErrors++;
+    }
+
+    // The client stops reading: queue more data than the socket buffers can hold
+    igtl::ImageMessage::Pointer image = igtl::ImageMessage::New();
+    image->SetDeviceName("Image");
+    image->SetDimensions(STALL_IMAGE_SIZE, STALL_IMAGE_SIZE, 1);
+    image->SetScalarTypeToUint8();
+    image->AllocateScalars();
+    image->Pack();
+    for (int i = 0; i < NUMBER_OF_STALL_MESSAGES; ++i)
+    {
+      server->QueueMessageResponseForClient(clientId, image.GetPointer());
+    }
+    vtkPlusOpenIGTLinkServerTester::SendMessageResponses(*server);
+
+    startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    while (server->GetNumberOfConnectedClients() > 0 && vtkIGSIOAccurateTimer::GetSystemTime() - startTime < MAX_RESPONSE_TIME_SEC)
+    {
+      vtkIGSIOAccurateTimer::Delay(0.1);
+      server->DisconnectFailedClients();
+    }
+    if (server->GetNumberOfConnectedClients() > 0)
+    {
+      LOG_ERROR("Client that does not read is not disconnected in " << MAX_RESPONSE_TIME_SEC << " sec");
+      numberOfErrors++;
+    }
+
+    server->StopOpenIGTLinkService();
+    fakeClientSocket->CloseSocket();
+    listeningSocket->CloseSocket();
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int numberOfErrors(0);
+
+  numberOfErrors += TestOverflowPolicies();
+  numberOfErrors += TestPopAndStop();
+  numberOfErrors += TestCompressedImageDrop();
+  numberOfErrors += TestStalledClientDisconnect();
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
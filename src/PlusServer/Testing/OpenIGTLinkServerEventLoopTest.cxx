@@ -0,0 +1,364 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file OpenIGTLinkServerEventLoopTest.cxx
+  \brief Verifies the event loop of the OpenIGTLink server (Linux only): requests that arrive one byte at a time or
+  several in one packet are answered, a message that is larger than the socket buffers is received intact by a
+  client that reads slowly, a client that announces a too large message body is disconnected, and a client that
+  stops reading is disconnected. The clients are plain OpenIGTLink sockets connected through the loopback interface.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkPlusOpenIGTLinkServer.h"
+
+// IGSIO includes
+#include <vtkIGSIOAccurateTimer.h>
+
+// VTK includes
+#include <vtkObjectFactory.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// OpenIGTLink includes
+#include <igtlClientSocket.h>
+#include <igtlImageMessage.h>
+#include <igtlMessageHeader.h>
+#include <igtlStatusMessage.h>
+
+// STL includes
+#include <algorithm>
+#include <vector>
+
+//----------------------------------------------------------------------------
+/*! Gives the test access to the event loop of the server without starting the data sender thread */
+class vtkPlusOpenIGTLinkServerTester : public vtkPlusOpenIGTLinkServer
+{
+public:
+  static vtkPlusOpenIGTLinkServerTester* New();
+  vtkTypeMacro(vtkPlusOpenIGTLinkServerTester, vtkPlusOpenIGTLinkServer);
+
+  using vtkPlusOpenIGTLinkServer::StartConnectionReceiverThread;
+  using vtkPlusOpenIGTLinkServer::DisconnectFailedClients;
+  using vtkPlusOpenIGTLinkServer::QueueMessageResponseForClient;
+  using vtkPlusOpenIGTLinkServer::SendMessageResponses;
+  using vtkPlusOpenIGTLinkServer::SetNumberOfRetryAttempts;
+  using vtkPlusOpenIGTLinkServer::SetDelayBetweenRetryAttemptsSec;
+  using vtkPlusOpenIGTLinkServer::SetMaxClientMessageBodySizeBytes;
+};
+vtkStandardNewMacro(vtkPlusOpenIGTLinkServerTester);
+
+namespace
+{
+  // Each server of the test listens on its own port, so that the connections closed by the previous server do not prevent binding
+  const int FIRST_TEST_PORT = 18940;
+  // Maximum time for the server to answer a request or to disconnect a client, generous for loaded test machines
+  const double MAX_RESPONSE_TIME_SEC = 20.0;
+  const int MAX_CLIENT_MESSAGE_BODY_SIZE_BYTES = 1024 * 1024;
+  // Image that is larger than the socket buffers, so it is sent in several parts
+  const int LARGE_IMAGE_SIZE = 4096;
+  const int SLOW_READ_CHUNK_SIZE_BYTES = 64 * 1024;
+  const int NUMBER_OF_STALL_MESSAGES = 8;
+  // Offset of the body size in the OpenIGTLink header
+  const int HEADER_BODY_SIZE_OFFSET = 42;
+
+  //----------------------------------------------------------------------------
+  /*! Start an event loop server without a data collector */
+  vtkSmartPointer<vtkPlusOpenIGTLinkServerTester> StartServer(int port, float sendTimeoutSec, int numberOfRetryAttempts)
+  {
+    vtkSmartPointer<vtkPlusOpenIGTLinkServerTester> server = vtkSmartPointer<vtkPlusOpenIGTLinkServerTester>::New();
+    server->SetEventLoopEnabled(true);
+    server->SetListeningPort(port);
+    server->SetDefaultClientSendTimeoutSec(sendTimeoutSec);
+    server->SetNumberOfRetryAttempts(numberOfRetryAttempts);
+    server->SetDelayBetweenRetryAttemptsSec(0.01);
+    server->SetMaxClientMessageBodySizeBytes(MAX_CLIENT_MESSAGE_BODY_SIZE_BYTES);
+    if (server->StartConnectionReceiverThread() != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to start the event loop of the server on port " << port);
+      return NULL;
+    }
+    return server;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Connect a client to the server and wait until the event loop has accepted it */
+  igtl::ClientSocket::Pointer ConnectClient(vtkPlusOpenIGTLinkServerTester* server)
+  {
+    unsigned int numberOfConnectedClients = server->GetNumberOfConnectedClients();
+    igtl::ClientSocket::Pointer clientSocket = igtl::ClientSocket::New();
+    if (clientSocket->ConnectToServer("127.0.0.1", server->GetListeningPort()) != 0)
+    {
+      LOG_ERROR("Cannot connect to the server on port " << server->GetListeningPort());
+      return NULL;
+    }
+    clientSocket->SetReceiveTimeout(static_cast<int>(MAX_RESPONSE_TIME_SEC * 1000));
+    double startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    while (server->GetNumberOfConnectedClients() == numberOfConnectedClients && vtkIGSIOAccurateTimer::GetSystemTime() - startTime < MAX_RESPONSE_TIME_SEC)
+    {
+      vtkIGSIOAccurateTimer::Delay(0.01);
+    }
+    if (server->GetNumberOfConnectedClients() == numberOfConnectedClients)
+    {
+      LOG_ERROR("Client connection is not accepted by the server");
+      return NULL;
+    }
+    return clientSocket;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Wait until the server disconnects all clients that it failed to communicate with */
+  bool WaitForDisconnect(vtkPlusOpenIGTLinkServerTester* server)
+  {
+    double startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    while (server->GetNumberOfConnectedClients() > 0 && vtkIGSIOAccurateTimer::GetSystemTime() - startTime < MAX_RESPONSE_TIME_SEC)
+    {
+      vtkIGSIOAccurateTimer::Delay(0.05);
+      server->DisconnectFailedClients();
+    }
+    return server->GetNumberOfConnectedClients() == 0;
+  }
+
+  //----------------------------------------------------------------------------
+  igtl::MessageBase::Pointer CreateStatusRequest()
+  {
+    igtl::GetStatusMessage::Pointer request = igtl::GetStatusMessage::New();
+    request->SetDeviceName("FakeClient");
+    request->Pack();
+    return request.GetPointer();
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Receive a message header, check its type and return the size of the body that follows it */
+  int ReceiveHeader(igtl::ClientSocket* clientSocket, const std::string& expectedMessageType, igtlUint64& bodySize, const std::string& description)
+  {
+    igtl::MessageHeader::Pointer header = igtl::MessageHeader::New();
+    header->InitBuffer();
+    if (clientSocket->Receive(header->GetBufferPointer(), header->GetBufferSize()) != header->GetBufferSize())
+    {
+      LOG_ERROR(description << ": no " << expectedMessageType << " message is received");
+      return 1;
+    }
+    header->Unpack();
+    bodySize = header->GetBodySizeToRead();
+    if (std::string(header->GetMessageType()) != expectedMessageType)
+    {
+      LOG_ERROR(description << ": received a " << header->GetMessageType() << " message, expected " << expectedMessageType);
+      return 1;
+    }
+    return 0;
+  }
+
+  //----------------------------------------------------------------------------
+  int ReceiveStatusReply(igtl::ClientSocket* clientSocket, const std::string& description)
+  {
+    igtlUint64 bodySize = 0;
+    if (ReceiveHeader(clientSocket, "STATUS", bodySize, description) != 0)
+    {
+      return 1;
+    }
+    clientSocket->Skip(bodySize, 0);
+    return 0;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Send a request in single bytes and two requests in one packet, the server has to reassemble the messages */
+  int TestPartialReceive(igtl::ClientSocket* clientSocket)
+  {
+    int numberOfErrors = 0;
+
+    igtl::MessageBase::Pointer request = CreateStatusRequest();
+    const unsigned char* requestBuffer = static_cast<const unsigned char*>(request->GetBufferPointer());
+    for (int i = 0; i < request->GetBufferSize(); ++i)
+    {
+      clientSocket->Send(requestBuffer + i, 1);
+      vtkIGSIOAccurateTimer::Delay(0.001);
+    }
+    numberOfErrors += ReceiveStatusReply(clientSocket, "Request sent in single bytes");
+
+    std::vector<unsigned char> twoRequests(requestBuffer, requestBuffer + request->GetBufferSize());
+    twoRequests.insert(twoRequests.end(), requestBuffer, requestBuffer + request->GetBufferSize());
+    clientSocket->Send(&twoRequests[0], twoRequests.size());
+    numberOfErrors += ReceiveStatusReply(clientSocket, "First of two requests sent in one packet");
+    numberOfErrors += ReceiveStatusReply(clientSocket, "Second of two requests sent in one packet");
+
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Read a message that does not fit in the socket buffers slowly, the server has to send it in several parts */
+  int TestPartialSend(vtkPlusOpenIGTLinkServerTester* server, int clientId, igtl::ClientSocket* clientSocket)
+  {
+    igtl::ImageMessage::Pointer image = igtl::ImageMessage::New();
+    image->SetDeviceName("Image");
+    image->SetDimensions(LARGE_IMAGE_SIZE, LARGE_IMAGE_SIZE, 1);
+    image->SetScalarTypeToUint8();
+    image->AllocateScalars();
+    unsigned char* pixels = static_cast<unsigned char*>(image->GetScalarPointer());
+    for (int i = 0; i < static_cast<int>(image->GetImageSize()); ++i)
+    {
+      pixels[i] = static_cast<unsigned char>(i % 251);
+    }
+    image->Pack();
+
+    server->QueueMessageResponseForClient(clientId, image.GetPointer());
+    vtkPlusOpenIGTLinkServerTester::SendMessageResponses(*server);
+
+    igtlUint64 bodySize = 0;
+    if (ReceiveHeader(clientSocket, "IMAGE", bodySize, "Slowly read image") != 0)
+    {
+      return 1;
+    }
+    if (bodySize != image->GetBufferBodySize())
+    {
+      LOG_ERROR("Slowly read image: body size is " << bodySize << ", expected " << image->GetBufferBodySize());
+      return 1;
+    }
+    std::vector<unsigned char> body(bodySize);
+    for (igtlUint64 receivedBytes = 0; receivedBytes < bodySize; receivedBytes += SLOW_READ_CHUNK_SIZE_BYTES)
+    {
+      igtlUint64 chunkSize = std::min<igtlUint64>(SLOW_READ_CHUNK_SIZE_BYTES, bodySize - receivedBytes);
+      if (clientSocket->Receive(&body[receivedBytes], chunkSize) != chunkSize)
+      {
+        LOG_ERROR("Slowly read image: connection is lost after " << receivedBytes << " bytes of the body");
+        return 1;
+      }
+      vtkIGSIOAccurateTimer::Delay(0.001);
+    }
+    if (!std::equal(body.begin(), body.end(), static_cast<const unsigned char*>(image->GetBufferBodyPointer())))
+    {
+      LOG_ERROR("Slowly read image: received body differs from the sent body");
+      return 1;
+    }
+    return 0;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Announce a body that is larger than the limit, the server must disconnect the client instead of allocating it */
+  int TestOversizedMessage(vtkPlusOpenIGTLinkServerTester* server, igtl::ClientSocket* clientSocket)
+  {
+    igtl::MessageBase::Pointer request = CreateStatusRequest();
+    std::vector<unsigned char> header(static_cast<const unsigned char*>(request->GetBufferPointer()), static_cast<const unsigned char*>(request->GetBufferPointer()) + IGTL_HEADER_SIZE);
+    // Body size is a big-endian 64-bit integer
+    const igtlUint64 announcedBodySize = static_cast<igtlUint64>(1) << 40;
+    for (int i = 0; i < 8; ++i)
+    {
+      header[HEADER_BODY_SIZE_OFFSET + i] = static_cast<unsigned char>((announcedBodySize >> (8 * (7 - i))) & 0xFF);
+    }
+
+    // The server reports the disconnection with a warning, which is expected here
+    int logLevel = vtkPlusLogger::Instance()->GetLogLevel();
+    vtkPlusLogger::Instance()->SetLogLevel(vtkPlusLogger::LOG_LEVEL_ERROR);
+    clientSocket->Send(&header[0], header.size());
+    bool disconnected = WaitForDisconnect(server);
+    vtkPlusLogger::Instance()->SetLogLevel(logLevel);
+
+    if (!disconnected)
+    {
+      LOG_ERROR("Client that announced a " << announcedBodySize << " bytes long message body is not disconnected");
+      return 1;
+    }
+    return 0;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Queue more data than the socket buffers can hold for a client that does not read, the server must disconnect it */
+  int TestStalledClientDisconnect(vtkPlusOpenIGTLinkServerTester* server, int clientId)
+  {
+    igtl::ImageMessage::Pointer image = igtl::ImageMessage::New();
+    image->SetDeviceName("Image");
+    image->SetDimensions(LARGE_IMAGE_SIZE, LARGE_IMAGE_SIZE, 1);
+    image->SetScalarTypeToUint8();
+    image->AllocateScalars();
+    image->Pack();
+    for (int i = 0; i < NUMBER_OF_STALL_MESSAGES; ++i)
+    {
+      server->QueueMessageResponseForClient(clientId, image.GetPointer());
+    }
+    vtkPlusOpenIGTLinkServerTester::SendMessageResponses(*server);
+
+    if (!WaitForDisconnect(server))
+    {
+      LOG_ERROR("Client that does not read is not disconnected in " << MAX_RESPONSE_TIME_SEC << " sec");
+      return 1;
+    }
+    return 0;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int numberOfErrors(0);
+
+  // Client IDs start from 1 and are not reused, even by another server instance
+  int clientId = 1;
+
+  // Default send timeout and retries, so that the slow reader is not disconnected
+  vtkSmartPointer<vtkPlusOpenIGTLinkServerTester> server = StartServer(FIRST_TEST_PORT, 0.5f, 10);
+  if (server.GetPointer() == NULL)
+  {
+    return EXIT_FAILURE;
+  }
+  igtl::ClientSocket::Pointer clientSocket = ConnectClient(server);
+  if (clientSocket.IsNull())
+  {
+    return EXIT_FAILURE;
+  }
+  numberOfErrors += TestPartialReceive(clientSocket);
+  numberOfErrors += TestPartialSend(server, clientId, clientSocket);
+  numberOfErrors += TestOversizedMessage(server, clientSocket);
+  clientSocket->CloseSocket();
+  server->StopOpenIGTLinkService();
+  clientId++;
+
+  // Short send timeout, so that the stalled client is disconnected quickly
+  server = StartServer(FIRST_TEST_PORT + 1, 0.1f, 1);
+  if (server.GetPointer() == NULL)
+  {
+    return EXIT_FAILURE;
+  }
+  clientSocket = ConnectClient(server);
+  if (clientSocket.IsNull())
+  {
+    return EXIT_FAILURE;
+  }
+  numberOfErrors += TestStalledClientDisconnect(server, clientId);
+  clientSocket->CloseSocket();
+  server->StopOpenIGTLinkService();
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
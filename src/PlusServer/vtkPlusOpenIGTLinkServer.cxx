@@ -8,6 +8,8 @@ See License.txt for details.
 #include "PlusConfigure.h"
 #include "PlusCommon.h"
 #include "PlusConfigure.h"
+#include "PlusLatencyTracer.h"
+#include "PlusNewItemSignal.h"
 #include "igsioTrackedFrame.h"
 #include "vtkPlusChannel.h"
 #include "vtkPlusCommand.h"
@@ -42,15 +44,9 @@ See License.txt for details.
 // OpenIGTLinkIO includes
 #include <igtlioPolyDataConverter.h>
 
-#if defined(WIN32)
-  #include "vtkPlusOpenIGTLinkServerWin32.cxx"
-#elif defined(__APPLE__)
-  #include "vtkPlusOpenIGTLinkServerMacOSX.cxx"
-#elif defined(__linux__)
-  #include "vtkPlusOpenIGTLinkServerLinux.cxx"
-#endif
-
 // STL includes
+#include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <streambuf>
 
@@ -62,6 +58,8 @@ namespace
   const int IGTL_EMPTY_DATA_SIZE = -1;
   const double SERVER_START_CHECK_DELAY_SEC = 2.0;
   const double SERVER_START_CHECK_DELAY_INTERVAL_SEC = 0.05;
+  const double DATA_WRITER_WAIT_TIMEOUT_SEC = 0.2;
+  const int DEFAULT_MAX_CLIENT_MESSAGE_BODY_SIZE_BYTES = 16 * 1024 * 1024;
 
   //----------------------------------------------------------------------------
   // If a frame cannot be retrieved from the device buffers (because it was overwritten by new frames)
@@ -70,6 +68,187 @@ namespace
   const double SAMPLING_SKIPPING_MARGIN_SEC = 0.1;
 }
 
+//----------------------------------------------------------------------------
+/*! Source of the body of a received message, the header is already consumed */
+class ClientMessageBodyReader
+{
+public:
+  virtual ~ClientMessageBodyReader() {}
+  virtual void Receive(void* data, size_t length) = 0;
+  virtual void Skip(size_t length) = 0;
+};
+
+//----------------------------------------------------------------------------
+/*! Reads the message body directly from the client socket */
+class SocketMessageBodyReader : public ClientMessageBodyReader
+{
+public:
+  explicit SocketMessageBodyReader(igtl::ClientSocket* socket)
+    : Socket(socket)
+  {
+  }
+  virtual void Receive(void* data, size_t length)
+  {
+    this->Socket->Receive(data, length);
+  }
+  virtual void Skip(size_t length)
+  {
+    this->Socket->Skip(length, 0);
+  }
+
+protected:
+  igtl::ClientSocket::Pointer Socket;
+};
+
+//----------------------------------------------------------------------------
+/*! Reads the message body from a buffer that already contains all the body bytes */
+class BufferMessageBodyReader : public ClientMessageBodyReader
+{
+public:
+  explicit BufferMessageBodyReader(const std::vector<unsigned char>& buffer)
+    : Buffer(buffer)
+    , Position(0)
+  {
+  }
+  virtual void Receive(void* data, size_t length)
+  {
+    size_t bytesToCopy = std::min(length, this->Buffer.size() - this->Position);
+    if (bytesToCopy > 0)
+    {
+      std::copy(this->Buffer.begin() + this->Position, this->Buffer.begin() + this->Position + bytesToCopy, static_cast<unsigned char*>(data));
+    }
+    this->Position += bytesToCopy;
+  }
+  virtual void Skip(size_t length)
+  {
+    this->Position += std::min(length, this->Buffer.size() - this->Position);
+  }
+
+protected:
+  const std::vector<unsigned char>& Buffer;
+  size_t Position;
+};
+
+// Platform specific functions (server info, event loop)
+#if defined(WIN32)
+  #include "vtkPlusOpenIGTLinkServerWin32.cxx"
+#elif defined(__APPLE__)
+  #include "vtkPlusOpenIGTLinkServerMacOSX.cxx"
+#elif defined(__linux__)
+  #include "vtkPlusOpenIGTLinkServerLinux.cxx"
+#endif
+
+//----------------------------------------------------------------------------
+ClientOutboundQueue::ClientOutboundQueue(unsigned int maxNumberOfMessages)
+  : MaxNumberOfMessages(maxNumberOfMessages)
+  , Stopped(false)
+  , PoppedMessageTraceTimestamp(UNDEFINED_TIMESTAMP)
+{
+}
+
+//----------------------------------------------------------------------------
+bool ClientOutboundQueue::Push(igtl::MessageBase::Pointer message, OverflowPolicy policy, double traceTimestamp/*=UNDEFINED_TIMESTAMP*/, igtl::MessageBase::Pointer* droppedMessage/*=NULL*/)
+{
+  bool messageDropped = false;
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    if (this->Stopped)
+    {
+      return false;
+    }
+    // Zero maximum size means that the queue is not limited
+    if (policy != NEVER_DROP && this->MaxNumberOfMessages > 0 && this->Messages.size() >= this->MaxNumberOfMessages)
+    {
+      std::deque<QueuedMessage>::iterator oldestDroppableIt = this->Messages.end();
+      if (policy == DROP_OLDEST)
+      {
+        oldestDroppableIt = std::find_if(this->Messages.begin(), this->Messages.end(), [](const QueuedMessage & queued) { return queued.Droppable; });
+      }
+      this->Stats.NumberOfDroppedMessages++;
+      if (oldestDroppableIt == this->Messages.end())
+      {
+        // Nothing can be removed to make room for the new message
+        if (droppedMessage != NULL)
+        {
+          *droppedMessage = message;
+        }
+        return false;
+      }
+      if (droppedMessage != NULL)
+      {
+        *droppedMessage = oldestDroppableIt->Message;
+      }
+      this->Messages.erase(oldestDroppableIt);
+      messageDropped = true;
+    }
+    QueuedMessage queued;
+    queued.Message = message;
+    queued.Droppable = (policy != NEVER_DROP);
+    queued.TraceTimestamp = traceTimestamp;
+    this->Messages.push_back(queued);
+    this->Stats.MaxQueueDepth = std::max<unsigned int>(this->Stats.MaxQueueDepth, this->Messages.size());
+  }
+  this->MessageAvailable.notify_one();
+  return !messageDropped;
+}
+
+//----------------------------------------------------------------------------
+bool ClientOutboundQueue::Pop(igtl::MessageBase::Pointer& message, double timeoutSec)
+{
+  std::unique_lock<std::mutex> lock(this->Mutex);
+  this->MessageAvailable.wait_for(lock, std::chrono::duration<double>(timeoutSec), [this] { return this->Stopped || !this->Messages.empty(); });
+  if (this->Stopped || this->Messages.empty())
+  {
+    return false;
+  }
+  message = this->Messages.front().Message;
+  this->PoppedMessageTraceTimestamp = this->Messages.front().TraceTimestamp;
+  this->Messages.pop_front();
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void ClientOutboundQueue::MessageSent()
+{
+  double traceTimestamp = UNDEFINED_TIMESTAMP;
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    this->Stats.NumberOfSentMessages++;
+    traceTimestamp = this->PoppedMessageTraceTimestamp;
+  }
+  if (traceTimestamp != UNDEFINED_TIMESTAMP)
+  {
+    PlusLatencyTracer::GetInstance()->AddEvent(PlusLatencyTracer::STAGE_SENT, traceTimestamp);
+  }
+}
+
+//----------------------------------------------------------------------------
+void ClientOutboundQueue::Stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    this->Stopped = true;
+    this->Messages.clear();
+  }
+  this->MessageAvailable.notify_all();
+}
+
+//----------------------------------------------------------------------------
+bool ClientOutboundQueue::IsEmpty()
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  return this->Messages.empty();
+}
+
+//----------------------------------------------------------------------------
+ClientOutboundQueue::Statistics ClientOutboundQueue::GetStatistics()
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  Statistics stats = this->Stats;
+  stats.QueueDepth = static_cast<unsigned int>(this->Messages.size());
+  return stats;
+}
+
 //----------------------------------------------------------------------------
 
 vtkStandardNewMacro(vtkPlusOpenIGTLinkServer);
@@ -88,6 +267,14 @@ vtkPlusOpenIGTLinkServer::vtkPlusOpenIGTLinkServer()
   , NumberOfRetryAttempts(10)
   , DelayBetweenRetryAttemptsSec(0.05)
   , MaxNumberOfIgtlMessagesToSend(100)
+  , MaxNumberOfQueuedMessagesPerClient(100)
+  , DataOverflowPolicy(ClientOutboundQueue::DROP_OLDEST)
+  , ResponseOverflowPolicy(ClientOutboundQueue::NEVER_DROP)
+  , CompressionKeyFrameInterval(igtl::PlusCompressedImageMessage::CompressionState::DEFAULT_KEY_FRAME_INTERVAL)
+  , EventLoopEnabled(EVENT_LOOP_AVAILABLE)
+  , EventLoopFd(-1)
+  , EventLoopWakeUpFd(-1)
+  , MaxClientMessageBodySizeBytes(DEFAULT_MAX_CLIENT_MESSAGE_BODY_SIZE_BYTES)
   , ConnectionReceiverThreadId(-1)
   , DataSenderThreadId(-1)
   , IgtlMessageFactory(vtkSmartPointer<vtkPlusIgtlMessageFactory>::New())
@@ -163,10 +350,10 @@ PlusStatus vtkPlusOpenIGTLinkServer::StartOpenIGTLinkService()
     return PLUS_FAIL;
   }
 
-  if (this->ConnectionReceiverThreadId < 0)
+  if (this->StartConnectionReceiverThread() != PLUS_SUCCESS)
   {
-    this->ConnectionActive.Request = true;
-    this->ConnectionReceiverThreadId = this->Threader->SpawnThread((vtkThreadFunctionType)&ConnectionReceiverThread, this);
+    LOG_ERROR("Unable to initialize receiver and sender processes.");
+    return PLUS_FAIL;
   }
 
   if (this->DataSenderThreadId < 0)
@@ -175,16 +362,6 @@ PlusStatus vtkPlusOpenIGTLinkServer::StartOpenIGTLinkService()
     this->DataSenderThreadId = this->Threader->SpawnThread((vtkThreadFunctionType)&DataSenderThread, this);
   }
 
-  // Wait a short duration to see if both threads initialized properly, check at 50ms interval
-  RETRY_UNTIL_TRUE(this->ConnectionActive.Respond,
-                   vtkMath::Round(SERVER_START_CHECK_DELAY_SEC / SERVER_START_CHECK_DELAY_INTERVAL_SEC),
-                   SERVER_START_CHECK_DELAY_INTERVAL_SEC);
-  if (!this->ConnectionActive.Respond)
-  {
-    LOG_ERROR("Unable to initialize receiver and sender processes.");
-    return PLUS_FAIL;
-  }
-
   std::ostringstream ss;
   ss << "Data sent by default: ";
   this->DefaultClientInfo.PrintSelf(ss, vtkIndent(0));
@@ -197,6 +374,29 @@ PlusStatus vtkPlusOpenIGTLinkServer::StartOpenIGTLinkService()
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkServer::StartConnectionReceiverThread()
+{
+  if (this->ConnectionReceiverThreadId < 0)
+  {
+    this->ConnectionActive.Request = true;
+    if (this->EventLoopEnabled)
+    {
+      this->ConnectionReceiverThreadId = this->Threader->SpawnThread((vtkThreadFunctionType)&EventLoopThread, this);
+    }
+    else
+    {
+      this->ConnectionReceiverThreadId = this->Threader->SpawnThread((vtkThreadFunctionType)&ConnectionReceiverThread, this);
+    }
+  }
+
+  // Wait a short duration to see if the thread initialized properly, check at 50ms interval
+  RETRY_UNTIL_TRUE(this->ConnectionActive.Respond,
+                   vtkMath::Round(SERVER_START_CHECK_DELAY_SEC / SERVER_START_CHECK_DELAY_INTERVAL_SEC),
+                   SERVER_START_CHECK_DELAY_INTERVAL_SEC);
+  return this->ConnectionActive.Respond ? PLUS_SUCCESS : PLUS_FAIL;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusOpenIGTLinkServer::StopOpenIGTLinkService()
 {
@@ -255,29 +455,7 @@ void* vtkPlusOpenIGTLinkServer::ConnectionReceiverThread(vtkMultiThreader::Threa
     igtl::ClientSocket::Pointer newClientSocket = self->ServerSocket->WaitForConnection(CLIENT_SOCKET_TIMEOUT_SEC * 1000);
     if (newClientSocket.IsNotNull())
     {
-      // Lock before we change the clients list
-      igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(self->IgtlClientsMutex);
-      ClientData newClient;
-      self->IgtlClients.push_back(newClient);
-
-      ClientData* client = &(self->IgtlClients.back());   // get a reference to the client data that is stored in the list
-      client->ClientId = self->ClientIdCounter;
-      self->ClientIdCounter++;
-      client->ClientSocket = newClientSocket;
-      client->ClientSocket->SetReceiveTimeout(self->DefaultClientReceiveTimeoutSec * 1000);
-      client->ClientSocket->SetSendTimeout(self->DefaultClientSendTimeoutSec * 1000);
-      client->ClientInfo = self->DefaultClientInfo;
-      client->Server = self;
-
-      int port = 0;
-      std::string address = "unknown";
-#if (OPENIGTLINK_VERSION_MAJOR > 1) || ( OPENIGTLINK_VERSION_MAJOR == 1 && OPENIGTLINK_VERSION_MINOR > 9 ) || ( OPENIGTLINK_VERSION_MAJOR == 1 && OPENIGTLINK_VERSION_MINOR == 9 && OPENIGTLINK_VERSION_PATCH > 4 )
-      newClientSocket->GetSocketAddressAndPort(address, port);
-#endif
-      LOG_INFO("Received new client connection (client " << client->ClientId << " at " << address << ":" << port << "). Number of connected clients: " << self->GetNumberOfConnectedClients());
-
-      client->DataReceiverActive.first = true;
-      client->DataReceiverThreadId = self->Threader->SpawnThread((vtkThreadFunctionType)&DataReceiverThread, client);
+      self->AddClient(newClientSocket);
     }
   }
 
@@ -293,6 +471,59 @@ void* vtkPlusOpenIGTLinkServer::ConnectionReceiverThread(vtkMultiThreader::Threa
   return NULL;
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkServer::InitializeCompressionStates(PlusIgtlClientInfo& clientInfo) const
+{
+  // Each client decodes its own stream, so the clients must not share the previous frames
+  for (std::vector<PlusIgtlClientInfo::ImageStream>::iterator it = clientInfo.ImageStreams.begin(); it != clientInfo.ImageStreams.end(); ++it)
+  {
+    it->CompressionState = std::make_shared<igtl::PlusCompressedImageMessage::CompressionState>();
+    it->CompressionState->KeyFrameInterval = static_cast<unsigned int>(this->CompressionKeyFrameInterval);
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkServer::AddClient(igtl::ClientSocket::Pointer clientSocket)
+{
+  // Lock before we change the clients list
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
+  ClientData newClient;
+  this->IgtlClients.push_back(newClient);
+
+  ClientData* client = &(this->IgtlClients.back());   // get a reference to the client data that is stored in the list
+  client->ClientId = this->ClientIdCounter;
+  this->ClientIdCounter++;
+  client->ClientSocket = clientSocket;
+  client->ClientSocket->SetReceiveTimeout(this->DefaultClientReceiveTimeoutSec * 1000);
+  client->ClientSocket->SetSendTimeout(this->DefaultClientSendTimeoutSec * 1000);
+  client->ClientInfo = this->DefaultClientInfo;
+  this->InitializeCompressionStates(client->ClientInfo);
+  client->OutboundQueue = std::make_shared<ClientOutboundQueue>(static_cast<unsigned int>(std::max(this->MaxNumberOfQueuedMessagesPerClient, 0)));
+  client->Server = this;
+
+  int port = 0;
+  std::string address = "unknown";
+#if (OPENIGTLINK_VERSION_MAJOR > 1) || ( OPENIGTLINK_VERSION_MAJOR == 1 && OPENIGTLINK_VERSION_MINOR > 9 ) || ( OPENIGTLINK_VERSION_MAJOR == 1 && OPENIGTLINK_VERSION_MINOR == 9 && OPENIGTLINK_VERSION_PATCH > 4 )
+  clientSocket->GetSocketAddressAndPort(address, port);
+#endif
+  LOG_INFO("Received new client connection (client " << client->ClientId << " at " << address << ":" << port << "). Number of connected clients: " << this->GetNumberOfConnectedClients());
+
+  if (this->EventLoopEnabled)
+  {
+    // The event loop receives from and sends to the client, no threads are needed
+    if (this->AddClientToEventLoop(*client) != PLUS_SUCCESS)
+    {
+      client->SendFailed = true;
+    }
+    return;
+  }
+
+  client->DataReceiverActive.first = true;
+  client->DataReceiverThreadId = this->Threader->SpawnThread((vtkThreadFunctionType)&DataReceiverThread, client);
+  client->DataWriterActive.first = true;
+  client->DataWriterThreadId = this->Threader->SpawnThread((vtkThreadFunctionType)&DataWriterThread, client);
+}
+
 //----------------------------------------------------------------------------
 void* vtkPlusOpenIGTLinkServer::DataSenderThread(vtkMultiThreader::ThreadInfo* data)
 {
@@ -351,6 +582,8 @@ void* vtkPlusOpenIGTLinkServer::DataSenderThread(vtkMultiThreader::ThreadInfo* d
   if (self->BroadcastChannel)
   {
     self->BroadcastChannel->GetMostRecentTimestamp(self->LastSentTrackedFrameTimestamp);
+    self->NewBroadcastDataSignal = std::make_shared<PlusNewItemSignal>();
+    self->BroadcastChannel->AddNewItemSignal(self->NewBroadcastDataSignal);
   }
 
   double elapsedTimeSinceLastPacketSentSec = 0;
@@ -377,6 +610,8 @@ void* vtkPlusOpenIGTLinkServer::DataSenderThread(vtkMultiThreader::ThreadInfo* d
       self->GracePeriodLogLevel = vtkPlusLogger::LOG_LEVEL_WARNING;
     }
 
+    self->DisconnectFailedClients();
+
     SendMessageResponses(*self);
 
     // Send remote command execution replies to clients before sending any images/transforms/etc...
@@ -385,6 +620,11 @@ void* vtkPlusOpenIGTLinkServer::DataSenderThread(vtkMultiThreader::ThreadInfo* d
     // Send image/tracking/string data
     SendLatestFramesToClients(*self, elapsedTimeSinceLastPacketSentSec);
   }
+  if (self->BroadcastChannel && self->NewBroadcastDataSignal)
+  {
+    self->BroadcastChannel->RemoveNewItemSignal(self->NewBroadcastDataSignal);
+  }
+  self->NewBroadcastDataSignal.reset();
   // Close thread
   self->DataSenderThreadId = -1;
   self->DataSenderActive.Respond = false;
@@ -438,7 +678,15 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendLatestFramesToClients(vtkPlusOpenIGTLin
   // There is no new frame in the buffer
   if (trackedFrameList->GetNumberOfTrackedFrames() == 0)
   {
-    vtkIGSIOAccurateTimer::Delay(DELAY_ON_NO_NEW_FRAMES_SEC);
+    if (self.NewBroadcastDataSignal)
+    {
+      // Return as soon as new data arrives, the delay is only an upper bound for processing command responses
+      self.NewBroadcastDataSignal->Wait(DELAY_ON_NO_NEW_FRAMES_SEC);
+    }
+    else
+    {
+      vtkIGSIOAccurateTimer::Delay(DELAY_ON_NO_NEW_FRAMES_SEC);
+    }
     elapsedTimeSinceLastPacketSentSec += vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec;
 
     // Send keep alive packet to clients
@@ -479,17 +727,17 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendMessageResponses(vtkPlusOpenIGTLinkServ
     for (ClientIdToMessageListMap::iterator it = self.MessageResponseQueue.begin(); it != self.MessageResponseQueue.end(); ++it)
     {
       igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(self.IgtlClientsMutex);
-      igtl::ClientSocket::Pointer clientSocket = NULL;
+      ClientData* client = NULL;
 
       for (std::list<ClientData>::iterator clientIterator = self.IgtlClients.begin(); clientIterator != self.IgtlClients.end(); ++clientIterator)
       {
         if (clientIterator->ClientId == it->first)
         {
-          clientSocket = clientIterator->ClientSocket;
+          client = &(*clientIterator);
           break;
         }
       }
-      if (clientSocket.IsNull())
+      if (client == NULL)
       {
         LOG_WARNING("Message reply cannot be sent to client " << it->first << ", probably client has been disconnected.");
         continue;
@@ -497,7 +745,7 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendMessageResponses(vtkPlusOpenIGTLinkServ
 
       for (std::vector<igtl::MessageBase::Pointer>::iterator messageIt = it->second.begin(); messageIt != it->second.end(); ++messageIt)
       {
-        clientSocket->Send((*messageIt)->GetBufferPointer(), (*messageIt)->GetBufferSize());
+        self.QueueMessageForClient(*client, *messageIt, self.ResponseOverflowPolicy);
       }
     }
     self.MessageResponseQueue.clear();
@@ -526,22 +774,22 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendCommandResponses(vtkPlusOpenIGTLinkServ
       // Only send the response to the client that requested the command
       LOG_DEBUG("Send command reply to client " << (*responseIt)->GetClientId() << ": " << igtlResponseMessage->GetDeviceName());
       igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(self.IgtlClientsMutex);
-      igtl::ClientSocket::Pointer clientSocket = NULL;
+      ClientData* client = NULL;
       for (std::list<ClientData>::iterator clientIterator = self.IgtlClients.begin(); clientIterator != self.IgtlClients.end(); ++clientIterator)
       {
         if (clientIterator->ClientId == (*responseIt)->GetClientId())
         {
-          clientSocket = clientIterator->ClientSocket;
+          client = &(*clientIterator);
           break;
         }
       }
 
-      if (clientSocket.IsNull())
+      if (client == NULL)
       {
         LOG_WARNING("Message reply cannot be sent to client " << (*responseIt)->GetClientId() << ", probably client has been disconnected");
         continue;
       }
-      clientSocket->Send(igtlResponseMessage->GetBufferPointer(), igtlResponseMessage->GetBufferSize());
+      self.QueueMessageForClient(*client, igtlResponseMessage, self.ResponseOverflowPolicy);
     }
   }
 
@@ -549,431 +797,454 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendCommandResponses(vtkPlusOpenIGTLinkServ
 }
 
 //----------------------------------------------------------------------------
-void* vtkPlusOpenIGTLinkServer::DataReceiverThread(vtkMultiThreader::ThreadInfo* data)
+PlusStatus vtkPlusOpenIGTLinkServer::ProcessClientMessage(ClientData& client, igtl::MessageHeader::Pointer headerMsg, ClientMessageBodyReader& bodyReader)
 {
-  ClientData* client = (ClientData*)(data->UserData);
-  client->DataReceiverActive.second = true;
-  vtkPlusOpenIGTLinkServer* self = client->Server;
-
-  /*! Store the IDs of recent commands to be able to detect duplicate command IDs */
-  std::deque<uint32_t> previousCommandIds;
-
-  // Make copy of frequently used data to avoid locking of client data
-  igtl::ClientSocket::Pointer clientSocket = client->ClientSocket;
-  int clientId = client->ClientId;
+  int clientId = client.ClientId;
 
-  igtl::MessageHeader::Pointer headerMsg = self->IgtlMessageFactory->CreateHeaderMessage(IGTL_HEADER_VERSION_1);
-
-  while (client->DataReceiverActive.first)
   {
-    headerMsg->InitBuffer();
-
-    // Receive generic header from the socket
-    int bytesReceived = clientSocket->Receive(headerMsg->GetBufferPointer(), headerMsg->GetBufferSize());
-    if (bytesReceived == IGTL_EMPTY_DATA_SIZE || bytesReceived != headerMsg->GetBufferSize())
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
+    // Keep track of the highest known version of message ever sent by this client, this is the version that we reply with
+    // (upper bounded by the servers version)
+    if (headerMsg->GetHeaderVersion() > client.ClientInfo.GetClientHeaderVersion())
     {
-      vtkIGSIOAccurateTimer::Delay(0.1);
-      continue;
+      client.ClientInfo.SetClientHeaderVersion(std::min<int>(this->GetIGTLHeaderVersion(), headerMsg->GetHeaderVersion()));
     }
+  }
 
-    headerMsg->Unpack(self->IgtlMessageCrcCheckEnabled);
+  igtl::MessageBase::Pointer bodyMessage = this->IgtlMessageFactory->CreateReceiveMessage(headerMsg);
+  if (bodyMessage.IsNull())
+  {
+    LOG_ERROR("Unable to receive message from client: " << client.ClientId);
+    return PLUS_SUCCESS;
+  }
 
-    {
-      igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(self->IgtlClientsMutex);
-      // Keep track of the highest known version of message ever sent by this client, this is the version that we reply with
-      // (upper bounded by the servers version)
-      if (headerMsg->GetHeaderVersion() > client->ClientInfo.GetClientHeaderVersion())
-      {
-        client->ClientInfo.SetClientHeaderVersion(std::min<int>(self->GetIGTLHeaderVersion(), headerMsg->GetHeaderVersion()));
-      }
-    }
+  if (typeid(*bodyMessage) == typeid(igtl::PlusClientInfoMessage))
+  {
+    igtl::PlusClientInfoMessage::Pointer clientInfoMsg = dynamic_cast<igtl::PlusClientInfoMessage*>(bodyMessage.GetPointer());
+    clientInfoMsg->SetMessageHeader(headerMsg);
+    clientInfoMsg->AllocateBuffer();
+
+    bodyReader.Receive(clientInfoMsg->GetBufferBodyPointer(), clientInfoMsg->GetBufferBodySize());
 
-    igtl::MessageBase::Pointer bodyMessage = self->IgtlMessageFactory->CreateReceiveMessage(headerMsg);
-    if (bodyMessage.IsNull())
+    int c = clientInfoMsg->Unpack(this->IgtlMessageCrcCheckEnabled);
+    if (c & igtl::MessageHeader::UNPACK_BODY || clientInfoMsg->GetBufferBodySize() == 0)
     {
-      LOG_ERROR("Unable to receive message from client: " << client->ClientId);
-      continue;
+      // Message received from client, need to lock to modify client info
+      igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
+      client.ClientInfo = clientInfoMsg->GetClientInfo();
+      this->InitializeCompressionStates(client.ClientInfo);
+      LOG_DEBUG("Client info message received from client " << clientId);
     }
+  }
+  else if (typeid(*bodyMessage) == typeid(igtl::GetStatusMessage))
+  {
+    // Just ping server, we can skip message and respond
+    bodyReader.Skip(headerMsg->GetBodySizeToRead());
 
-    if (typeid(*bodyMessage) == typeid(igtl::PlusClientInfoMessage))
+    igtl::StatusMessage::Pointer replyMsg = dynamic_cast<igtl::StatusMessage*>(this->IgtlMessageFactory->CreateSendMessage("STATUS", client.ClientInfo.GetClientHeaderVersion()).GetPointer());
+    replyMsg->SetCode(igtl::StatusMessage::STATUS_OK);
+    replyMsg->Pack();
+    // Replies are queued, the socket is only written by the writer thread (or the event loop)
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
+    this->QueueMessageForClient(client, replyMsg.GetPointer(), this->ResponseOverflowPolicy);
+  }
+  else if (typeid(*bodyMessage) == typeid(igtl::StringMessage)
+           && vtkPlusCommand::IsCommandDeviceName(headerMsg->GetDeviceName()))
+  {
+    igtl::StringMessage::Pointer stringMsg = dynamic_cast<igtl::StringMessage*>(bodyMessage.GetPointer());
+    stringMsg->SetMessageHeader(headerMsg);
+    stringMsg->AllocateBuffer();
+    bodyReader.Receive(stringMsg->GetBufferBodyPointer(), stringMsg->GetBufferBodySize());
+
+    // We are receiving old style commands, handle it
+    int c = stringMsg->Unpack(this->IgtlMessageCrcCheckEnabled);
+    if (c & igtl::MessageHeader::UNPACK_BODY || stringMsg->GetBufferBodySize() == 0)
     {
-      igtl::PlusClientInfoMessage::Pointer clientInfoMsg = dynamic_cast<igtl::PlusClientInfoMessage*>(bodyMessage.GetPointer());
-      clientInfoMsg->SetMessageHeader(headerMsg);
-      clientInfoMsg->AllocateBuffer();
-
-      clientSocket->Receive(clientInfoMsg->GetBufferBodyPointer(), clientInfoMsg->GetBufferBodySize());
-
-      int c = clientInfoMsg->Unpack(self->IgtlMessageCrcCheckEnabled);
-      if (c & igtl::MessageHeader::UNPACK_BODY || clientInfoMsg->GetBufferBodySize() == 0)
+      std::string deviceName(headerMsg->GetDeviceName());
+      if (deviceName.empty())
       {
-        // Message received from client, need to lock to modify client info
-        igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(self->IgtlClientsMutex);
-        client->ClientInfo = clientInfoMsg->GetClientInfo();
-        LOG_DEBUG("Client info message received from client " << clientId);
+        this->PlusCommandProcessor->QueueStringResponse(PLUS_FAIL, std::string(vtkPlusCommand::DEVICE_NAME_REPLY), clientId, "Unable to read DeviceName.");
+        return PLUS_SUCCESS;
       }
-    }
-    else if (typeid(*bodyMessage) == typeid(igtl::GetStatusMessage))
-    {
-      // Just ping server, we can skip message and respond
-      clientSocket->Skip(headerMsg->GetBodySizeToRead(), 0);
-
-      igtl::StatusMessage::Pointer replyMsg = dynamic_cast<igtl::StatusMessage*>(self->IgtlMessageFactory->CreateSendMessage("STATUS", client->ClientInfo.GetClientHeaderVersion()).GetPointer());
-      replyMsg->SetCode(igtl::StatusMessage::STATUS_OK);
-      replyMsg->Pack();
-      clientSocket->Send(replyMsg->GetBufferPointer(), replyMsg->GetBufferSize());
-    }
-    else if (typeid(*bodyMessage) == typeid(igtl::StringMessage)
-             && vtkPlusCommand::IsCommandDeviceName(headerMsg->GetDeviceName()))
-    {
-      igtl::StringMessage::Pointer stringMsg = dynamic_cast<igtl::StringMessage*>(bodyMessage.GetPointer());
-      stringMsg->SetMessageHeader(headerMsg);
-      stringMsg->AllocateBuffer();
-      clientSocket->Receive(stringMsg->GetBufferBodyPointer(), stringMsg->GetBufferBodySize());
 
-      // We are receiving old style commands, handle it
-      int c = stringMsg->Unpack(self->IgtlMessageCrcCheckEnabled);
-      if (c & igtl::MessageHeader::UNPACK_BODY || stringMsg->GetBufferBodySize() == 0)
+      uint32_t uid(0);
+      try
       {
-        std::string deviceName(headerMsg->GetDeviceName());
-        if (deviceName.empty())
-        {
-          self->PlusCommandProcessor->QueueStringResponse(PLUS_FAIL, std::string(vtkPlusCommand::DEVICE_NAME_REPLY), clientId, "Unable to read DeviceName.");
-          continue;
-        }
-
-        uint32_t uid(0);
-        try
-        {
 #if (_MSC_VER == 1500)
-          std::istringstream ss(vtkPlusCommand::GetUidFromCommandDeviceName(deviceName));
-          ss >> uid;
+        std::istringstream ss(vtkPlusCommand::GetUidFromCommandDeviceName(deviceName));
+        ss >> uid;
 #else
-          uid = std::stoi(vtkPlusCommand::GetUidFromCommandDeviceName(deviceName));
+        uid = std::stoi(vtkPlusCommand::GetUidFromCommandDeviceName(deviceName));
 #endif
-        }
-        catch (std::invalid_argument e)
-        {
-          LOG_ERROR("Unable to extract command UID from device name string.");
-          // Removing support for malformed command strings, reply with error
-          self->PlusCommandProcessor->QueueStringResponse(PLUS_FAIL, std::string(vtkPlusCommand::DEVICE_NAME_REPLY), clientId, "Malformed DeviceName. Expected CMD_cmdId (ex: CMD_001)");
-          continue;
-        }
-
-        deviceName = vtkPlusCommand::GetPrefixFromCommandDeviceName(deviceName);
-
-        if (std::find(previousCommandIds.begin(), previousCommandIds.end(), uid) != previousCommandIds.end())
-        {
-          // Command already exists
-          LOG_WARNING("Already received a command with id = " << uid << " from client " << clientId << ". This repeated command will be ignored.");
-          continue;
-        }
-        // New command, remember its ID
-        previousCommandIds.push_back(uid);
-        if (previousCommandIds.size() > NUMBER_OF_RECENT_COMMAND_IDS_STORED)
-        {
-          previousCommandIds.pop_front();
-        }
-
-        LOG_DEBUG("Received command from client " << clientId << ", device " << deviceName << " with UID " << uid << ": " << stringMsg->GetString());
-
-        vtkSmartPointer<vtkXMLDataElement> cmdElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(stringMsg->GetString()));
-        std::string commandName = std::string(cmdElement->GetAttribute("Name") == NULL ? "" : cmdElement->GetAttribute("Name"));
-
-        self->PlusCommandProcessor->QueueCommand(false, clientId, commandName, stringMsg->GetString(), deviceName, uid, stringMsg->GetMetaData());
       }
-
-    }
-    else if (typeid(*bodyMessage) == typeid(igtl::CommandMessage))
-    {
-      igtl::CommandMessage::Pointer commandMsg = dynamic_cast<igtl::CommandMessage*>(bodyMessage.GetPointer());
-      commandMsg->SetMessageHeader(headerMsg);
-      commandMsg->AllocateBuffer();
-      clientSocket->Receive(commandMsg->GetBufferBodyPointer(), commandMsg->GetBufferBodySize());
-
-      int c = commandMsg->Unpack(self->IgtlMessageCrcCheckEnabled);
-      if (c & igtl::MessageHeader::UNPACK_BODY || commandMsg->GetBufferBodySize() == 0)
+      catch (std::invalid_argument e)
       {
-        std::string deviceName(headerMsg->GetDeviceName());
-
-        uint32_t uid;
-        uid = commandMsg->GetCommandId();
-
-        if (std::find(previousCommandIds.begin(), previousCommandIds.end(), uid) != previousCommandIds.end())
-        {
-          // Command already exists
-          LOG_WARNING("Already received a command with id = " << uid << " from client " << clientId << ". This repeated command will be ignored.");
-          continue;
-        }
-        // New command, remember its ID
-        previousCommandIds.push_back(uid);
-        if (previousCommandIds.size() > NUMBER_OF_RECENT_COMMAND_IDS_STORED)
-        {
-          previousCommandIds.pop_front();
-        }
+        LOG_ERROR("Unable to extract command UID from device name string.");
+        // Removing support for malformed command strings, reply with error
+        this->PlusCommandProcessor->QueueStringResponse(PLUS_FAIL, std::string(vtkPlusCommand::DEVICE_NAME_REPLY), clientId, "Malformed DeviceName. Expected CMD_cmdId (ex: CMD_001)");
+        return PLUS_SUCCESS;
+      }
 
-        LOG_DEBUG("Received header version " << commandMsg->GetHeaderVersion() << " command " << commandMsg->GetCommandName()
-                  << " from client " << clientId << ", device " << deviceName << " with UID " << uid << ": " << commandMsg->GetCommandContent());
+      deviceName = vtkPlusCommand::GetPrefixFromCommandDeviceName(deviceName);
 
-        self->PlusCommandProcessor->QueueCommand(true, clientId, commandMsg->GetCommandName(), commandMsg->GetCommandContent(), deviceName, uid, commandMsg->GetMetaData());
+      if (std::find(client.PreviousCommandIds.begin(), client.PreviousCommandIds.end(), uid) != client.PreviousCommandIds.end())
+      {
+        // Command already exists
+        LOG_WARNING("Already received a command with id = " << uid << " from client " << clientId << ". This repeated command will be ignored.");
+        return PLUS_SUCCESS;
       }
-      else
+      // New command, remember its ID
+      client.PreviousCommandIds.push_back(uid);
+      if (client.PreviousCommandIds.size() > NUMBER_OF_RECENT_COMMAND_IDS_STORED)
       {
-        LOG_ERROR("STRING message unpacking failed for client " << clientId);
+        client.PreviousCommandIds.pop_front();
       }
+
+      LOG_DEBUG("Received command from client " << clientId << ", device " << deviceName << " with UID " << uid << ": " << stringMsg->GetString());
+
+      vtkSmartPointer<vtkXMLDataElement> cmdElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(stringMsg->GetString()));
+      std::string commandName = std::string(cmdElement->GetAttribute("Name") == NULL ? "" : cmdElement->GetAttribute("Name"));
+
+      this->PlusCommandProcessor->QueueCommand(false, clientId, commandName, stringMsg->GetString(), deviceName, uid, stringMsg->GetMetaData());
     }
-    else if (typeid(*bodyMessage) == typeid(igtl::StartTrackingDataMessage))
-    {
-      std::string deviceName("");
 
-      igtl::StartTrackingDataMessage::Pointer startTracking = dynamic_cast<igtl::StartTrackingDataMessage*>(bodyMessage.GetPointer());
-      startTracking->SetMessageHeader(headerMsg);
-      startTracking->AllocateBuffer();
+  }
+  else if (typeid(*bodyMessage) == typeid(igtl::CommandMessage))
+  {
+    igtl::CommandMessage::Pointer commandMsg = dynamic_cast<igtl::CommandMessage*>(bodyMessage.GetPointer());
+    commandMsg->SetMessageHeader(headerMsg);
+    commandMsg->AllocateBuffer();
+    bodyReader.Receive(commandMsg->GetBufferBodyPointer(), commandMsg->GetBufferBodySize());
 
-      clientSocket->Receive(startTracking->GetBufferBodyPointer(), startTracking->GetBufferBodySize());
+    int c = commandMsg->Unpack(this->IgtlMessageCrcCheckEnabled);
+    if (c & igtl::MessageHeader::UNPACK_BODY || commandMsg->GetBufferBodySize() == 0)
+    {
+      std::string deviceName(headerMsg->GetDeviceName());
+
+      uint32_t uid;
+      uid = commandMsg->GetCommandId();
 
-      int c = startTracking->Unpack(self->IgtlMessageCrcCheckEnabled);
-      if (c & igtl::MessageHeader::UNPACK_BODY || startTracking->GetBufferBodySize() == 0)
+      if (std::find(client.PreviousCommandIds.begin(), client.PreviousCommandIds.end(), uid) != client.PreviousCommandIds.end())
       {
-        client->ClientInfo.SetTDATAResolution(startTracking->GetResolution());
-        client->ClientInfo.SetTDATARequested(true);
+        // Command already exists
+        LOG_WARNING("Already received a command with id = " << uid << " from client " << clientId << ". This repeated command will be ignored.");
+        return PLUS_SUCCESS;
       }
-      else
+      // New command, remember its ID
+      client.PreviousCommandIds.push_back(uid);
+      if (client.PreviousCommandIds.size() > NUMBER_OF_RECENT_COMMAND_IDS_STORED)
       {
-        LOG_ERROR("Client " << clientId << " STT_TDATA failed: could not retrieve startTracking message");
-        return NULL;
+        client.PreviousCommandIds.pop_front();
       }
 
-      igtl::MessageBase::Pointer msg = self->IgtlMessageFactory->CreateSendMessage("RTS_TDATA", client->ClientInfo.GetClientHeaderVersion());
-      igtl::RTSTrackingDataMessage* rtsMsg = dynamic_cast<igtl::RTSTrackingDataMessage*>(msg.GetPointer());
-      rtsMsg->SetStatus(0);
-      rtsMsg->Pack();
-      self->QueueMessageResponseForClient(client->ClientId, msg);
+      LOG_DEBUG("Received header version " << commandMsg->GetHeaderVersion() << " command " << commandMsg->GetCommandName()
+                << " from client " << clientId << ", device " << deviceName << " with UID " << uid << ": " << commandMsg->GetCommandContent());
+
+      this->PlusCommandProcessor->QueueCommand(true, clientId, commandMsg->GetCommandName(), commandMsg->GetCommandContent(), deviceName, uid, commandMsg->GetMetaData());
     }
-    else if (typeid(*bodyMessage) == typeid(igtl::StopTrackingDataMessage))
+    else
     {
-      igtl::StopTrackingDataMessage::Pointer stopTracking = dynamic_cast<igtl::StopTrackingDataMessage*>(bodyMessage.GetPointer());
-      stopTracking->SetMessageHeader(headerMsg);
-      stopTracking->AllocateBuffer();
+      LOG_ERROR("STRING message unpacking failed for client " << clientId);
+    }
+  }
+  else if (typeid(*bodyMessage) == typeid(igtl::StartTrackingDataMessage))
+  {
+    std::string deviceName("");
+
+    igtl::StartTrackingDataMessage::Pointer startTracking = dynamic_cast<igtl::StartTrackingDataMessage*>(bodyMessage.GetPointer());
+    startTracking->SetMessageHeader(headerMsg);
+    startTracking->AllocateBuffer();
 
-      clientSocket->Receive(stopTracking->GetBufferBodyPointer(), stopTracking->GetBufferBodySize());
+    bodyReader.Receive(startTracking->GetBufferBodyPointer(), startTracking->GetBufferBodySize());
 
-      client->ClientInfo.SetTDATARequested(false);
-      igtl::MessageBase::Pointer msg = self->IgtlMessageFactory->CreateSendMessage("RTS_TDATA", client->ClientInfo.GetClientHeaderVersion());
-      igtl::RTSTrackingDataMessage* rtsMsg = dynamic_cast<igtl::RTSTrackingDataMessage*>(msg.GetPointer());
-      rtsMsg->SetStatus(0);
-      rtsMsg->Pack();
-      self->QueueMessageResponseForClient(client->ClientId, msg);
+    int c = startTracking->Unpack(this->IgtlMessageCrcCheckEnabled);
+    if (c & igtl::MessageHeader::UNPACK_BODY || startTracking->GetBufferBodySize() == 0)
+    {
+      client.ClientInfo.SetTDATAResolution(startTracking->GetResolution());
+      client.ClientInfo.SetTDATARequested(true);
     }
-    else if (typeid(*bodyMessage) == typeid(igtl::GetPolyDataMessage))
+    else
     {
-      igtl::GetPolyDataMessage::Pointer polyDataMessage = dynamic_cast<igtl::GetPolyDataMessage*>(bodyMessage.GetPointer());
-      polyDataMessage->SetMessageHeader(headerMsg);
-      polyDataMessage->AllocateBuffer();
+      LOG_ERROR("Client " << clientId << " STT_TDATA failed: could not retrieve startTracking message");
+      return PLUS_FAIL;
+    }
+
+    igtl::MessageBase::Pointer msg = this->IgtlMessageFactory->CreateSendMessage("RTS_TDATA", client.ClientInfo.GetClientHeaderVersion());
+    igtl::RTSTrackingDataMessage* rtsMsg = dynamic_cast<igtl::RTSTrackingDataMessage*>(msg.GetPointer());
+    rtsMsg->SetStatus(0);
+    rtsMsg->Pack();
+    this->QueueMessageResponseForClient(client.ClientId, msg);
+  }
+  else if (typeid(*bodyMessage) == typeid(igtl::StopTrackingDataMessage))
+  {
+    igtl::StopTrackingDataMessage::Pointer stopTracking = dynamic_cast<igtl::StopTrackingDataMessage*>(bodyMessage.GetPointer());
+    stopTracking->SetMessageHeader(headerMsg);
+    stopTracking->AllocateBuffer();
+
+    bodyReader.Receive(stopTracking->GetBufferBodyPointer(), stopTracking->GetBufferBodySize());
+
+    client.ClientInfo.SetTDATARequested(false);
+    igtl::MessageBase::Pointer msg = this->IgtlMessageFactory->CreateSendMessage("RTS_TDATA", client.ClientInfo.GetClientHeaderVersion());
+    igtl::RTSTrackingDataMessage* rtsMsg = dynamic_cast<igtl::RTSTrackingDataMessage*>(msg.GetPointer());
+    rtsMsg->SetStatus(0);
+    rtsMsg->Pack();
+    this->QueueMessageResponseForClient(client.ClientId, msg);
+  }
+  else if (typeid(*bodyMessage) == typeid(igtl::GetPolyDataMessage))
+  {
+    igtl::GetPolyDataMessage::Pointer polyDataMessage = dynamic_cast<igtl::GetPolyDataMessage*>(bodyMessage.GetPointer());
+    polyDataMessage->SetMessageHeader(headerMsg);
+    polyDataMessage->AllocateBuffer();
 
-      clientSocket->Receive(polyDataMessage->GetBufferBodyPointer(), polyDataMessage->GetBufferBodySize());
+    bodyReader.Receive(polyDataMessage->GetBufferBodyPointer(), polyDataMessage->GetBufferBodySize());
 
-      int c = polyDataMessage->Unpack(self->IgtlMessageCrcCheckEnabled);
-      if (c & igtl::MessageHeader::UNPACK_BODY || polyDataMessage->GetBufferBodySize() == 0)
+    int c = polyDataMessage->Unpack(this->IgtlMessageCrcCheckEnabled);
+    if (c & igtl::MessageHeader::UNPACK_BODY || polyDataMessage->GetBufferBodySize() == 0)
+    {
+      std::string fileName;
+      // Check metadata for requisite parameters, if absent, check deviceName
+      if (polyDataMessage->GetHeaderVersion() > IGTL_HEADER_VERSION_1)
       {
-        std::string fileName;
-        // Check metadata for requisite parameters, if absent, check deviceName
-        if (polyDataMessage->GetHeaderVersion() > IGTL_HEADER_VERSION_1)
-        {
-          if (!polyDataMessage->GetMetaDataElement("filename", fileName))
-          {
-            fileName = polyDataMessage->GetDeviceName();
-            if (fileName.empty())
-            {
-              LOG_ERROR("GetPolyData message sent with no filename in either metadata or deviceName field.");
-              continue;
-            }
-          }
-        }
-        else
+        if (!polyDataMessage->GetMetaDataElement("filename", fileName))
         {
           fileName = polyDataMessage->GetDeviceName();
           if (fileName.empty())
           {
             LOG_ERROR("GetPolyData message sent with no filename in either metadata or deviceName field.");
-            continue;
+            return PLUS_SUCCESS;
           }
         }
+      }
+      else
+      {
+        fileName = polyDataMessage->GetDeviceName();
+        if (fileName.empty())
+        {
+          LOG_ERROR("GetPolyData message sent with no filename in either metadata or deviceName field.");
+          return PLUS_SUCCESS;
+        }
+      }
 
-        vtkSmartPointer<vtkPolyDataReader> reader = vtkSmartPointer<vtkPolyDataReader>::New();
-        reader->SetFileName(fileName.c_str());
-        reader->Update();
+      vtkSmartPointer<vtkPolyDataReader> reader = vtkSmartPointer<vtkPolyDataReader>::New();
+      reader->SetFileName(fileName.c_str());
+      reader->Update();
 
-        auto polyData = reader->GetOutput();
-        if (polyData != nullptr)
-        {
-          igtl::MessageBase::Pointer msg = self->IgtlMessageFactory->CreateSendMessage("POLYDATA", client->ClientInfo.GetClientHeaderVersion());
-          igtl::PolyDataMessage* polyMsg = dynamic_cast<igtl::PolyDataMessage*>(msg.GetPointer());
+      auto polyData = reader->GetOutput();
+      if (polyData != nullptr)
+      {
+        igtl::MessageBase::Pointer msg = this->IgtlMessageFactory->CreateSendMessage("POLYDATA", client.ClientInfo.GetClientHeaderVersion());
+        igtl::PolyDataMessage* polyMsg = dynamic_cast<igtl::PolyDataMessage*>(msg.GetPointer());
 
-          igtlioPolyDataConverter::ContentData data;
-          data.deviceName = "PlusServer";
-          data.polydata = polyData;
+        igtlioPolyDataConverter::ContentData data;
+        data.deviceName = "PlusServer";
+        data.polydata = polyData;
 
-          igtlioBaseConverter::HeaderData header;
-          header.deviceName = "PlusServer";
+        igtlioBaseConverter::HeaderData header;
+        header.deviceName = "PlusServer";
 
-          igtlioPolyDataConverter::toIGTL(header, data, (igtl::PolyDataMessage::Pointer*)&msg);
-          if (!msg->SetMetaDataElement("fileName", IANA_TYPE_US_ASCII, fileName))
-          {
-            LOG_ERROR("Filename too long to be sent back to client. Aborting.");
-            continue;
-          }
-          self->QueueMessageResponseForClient(client->ClientId, msg);
-          continue;
+        igtlioPolyDataConverter::toIGTL(header, data, (igtl::PolyDataMessage::Pointer*)&msg);
+        if (!msg->SetMetaDataElement("fileName", IANA_TYPE_US_ASCII, fileName))
+        {
+          LOG_ERROR("Filename too long to be sent back to client. Aborting.");
+          return PLUS_SUCCESS;
         }
-
-        igtl::MessageBase::Pointer msg = self->IgtlMessageFactory->CreateSendMessage("RTS_POLYDATA", polyDataMessage->GetHeaderVersion());
-        igtl::RTSPolyDataMessage* rtsPolyMsg = dynamic_cast<igtl::RTSPolyDataMessage*>(msg.GetPointer());
-        rtsPolyMsg->SetStatus(false);
-        self->QueueMessageResponseForClient(client->ClientId, rtsPolyMsg);
-      }
-      else
-      {
-        LOG_ERROR("Client " << clientId << " GET_POLYDATA failed: could not retrieve message");
-        return NULL;
+        this->QueueMessageResponseForClient(client.ClientId, msg);
+        return PLUS_SUCCESS;
       }
+
+      igtl::MessageBase::Pointer msg = this->IgtlMessageFactory->CreateSendMessage("RTS_POLYDATA", polyDataMessage->GetHeaderVersion());
+      igtl::RTSPolyDataMessage* rtsPolyMsg = dynamic_cast<igtl::RTSPolyDataMessage*>(msg.GetPointer());
+      rtsPolyMsg->SetStatus(false);
+      this->QueueMessageResponseForClient(client.ClientId, rtsPolyMsg);
     }
-    else if (typeid(*bodyMessage) == typeid(igtl::StatusMessage))
+    else
     {
-      // status message is used as a keep-alive, don't do anything
-      clientSocket->Skip(headerMsg->GetBodySizeToRead(), 0);
+      LOG_ERROR("Client " << clientId << " GET_POLYDATA failed: could not retrieve message");
+      return PLUS_FAIL;
     }
-    else if (typeid(*bodyMessage) == typeid(igtl::GetImageMetaMessage))
-    {
-      igtl::GetImageMetaMessage::Pointer getImageMetaMsg = dynamic_cast<igtl::GetImageMetaMessage*>(bodyMessage.GetPointer());
-      getImageMetaMsg->SetMessageHeader(headerMsg);
-      getImageMetaMsg->AllocateBuffer();
+  }
+  else if (typeid(*bodyMessage) == typeid(igtl::StatusMessage))
+  {
+    // status message is used as a keep-alive, don't do anything
+    bodyReader.Skip(headerMsg->GetBodySizeToRead());
+  }
+  else if (typeid(*bodyMessage) == typeid(igtl::GetImageMetaMessage))
+  {
+    igtl::GetImageMetaMessage::Pointer getImageMetaMsg = dynamic_cast<igtl::GetImageMetaMessage*>(bodyMessage.GetPointer());
+    getImageMetaMsg->SetMessageHeader(headerMsg);
+    getImageMetaMsg->AllocateBuffer();
 
-      clientSocket->Receive(getImageMetaMsg->GetBufferBodyPointer(), getImageMetaMsg->GetBufferBodySize());
+    bodyReader.Receive(getImageMetaMsg->GetBufferBodyPointer(), getImageMetaMsg->GetBufferBodySize());
 
-      int c = getImageMetaMsg->Unpack(self->IgtlMessageCrcCheckEnabled);
-      if (c & igtl::MessageHeader::UNPACK_BODY || getImageMetaMsg->GetBufferBodySize() == 0)
-      {
-        // Image meta message
-        std::string deviceName("");
-        if (headerMsg->GetDeviceName() != NULL)
-        {
-          deviceName = headerMsg->GetDeviceName();
-        }
-        self->PlusCommandProcessor->QueueGetImageMetaData(clientId, deviceName);
-      }
-      else
+    int c = getImageMetaMsg->Unpack(this->IgtlMessageCrcCheckEnabled);
+    if (c & igtl::MessageHeader::UNPACK_BODY || getImageMetaMsg->GetBufferBodySize() == 0)
+    {
+      // Image meta message
+      std::string deviceName("");
+      if (headerMsg->GetDeviceName() != NULL)
       {
-        LOG_ERROR("Client " << clientId << " GET_IMGMETA failed: could not retrieve message");
-        return NULL;
+        deviceName = headerMsg->GetDeviceName();
       }
+      this->PlusCommandProcessor->QueueGetImageMetaData(clientId, deviceName);
     }
-    else if (typeid(*bodyMessage) == typeid(igtl::GetImageMessage))
+    else
     {
-      igtl::GetImageMessage::Pointer getImageMsg = dynamic_cast<igtl::GetImageMessage*>(bodyMessage.GetPointer());
-      getImageMsg->SetMessageHeader(headerMsg);
-      getImageMsg->AllocateBuffer();
+      LOG_ERROR("Client " << clientId << " GET_IMGMETA failed: could not retrieve message");
+      return PLUS_FAIL;
+    }
+  }
+  else if (typeid(*bodyMessage) == typeid(igtl::GetImageMessage))
+  {
+    igtl::GetImageMessage::Pointer getImageMsg = dynamic_cast<igtl::GetImageMessage*>(bodyMessage.GetPointer());
+    getImageMsg->SetMessageHeader(headerMsg);
+    getImageMsg->AllocateBuffer();
 
-      clientSocket->Receive(getImageMsg->GetBufferBodyPointer(), getImageMsg->GetBufferBodySize());
+    bodyReader.Receive(getImageMsg->GetBufferBodyPointer(), getImageMsg->GetBufferBodySize());
 
-      int c = getImageMsg->Unpack(self->IgtlMessageCrcCheckEnabled);
-      if (c & igtl::MessageHeader::UNPACK_BODY || getImageMsg->GetBufferBodySize() == 0)
+    int c = getImageMsg->Unpack(this->IgtlMessageCrcCheckEnabled);
+    if (c & igtl::MessageHeader::UNPACK_BODY || getImageMsg->GetBufferBodySize() == 0)
+    {
+      std::string deviceName("");
+      if (headerMsg->GetDeviceName() != NULL)
       {
-        std::string deviceName("");
-        if (headerMsg->GetDeviceName() != NULL)
-        {
-          deviceName = headerMsg->GetDeviceName();
-        }
-        else
-        {
-          LOG_ERROR("Please select the image you want to acquire");
-          return NULL;
-        }
-        self->PlusCommandProcessor->QueueGetImage(clientId, deviceName);
+        deviceName = headerMsg->GetDeviceName();
       }
       else
       {
-        LOG_ERROR("Client " << clientId << " GET_IMAGE failed: could not retrieve message");
-        return NULL;
+        LOG_ERROR("Please select the image you want to acquire");
+        return PLUS_FAIL;
       }
-
+      this->PlusCommandProcessor->QueueGetImage(clientId, deviceName);
     }
-    else if (typeid(*bodyMessage) == typeid(igtl::GetPointMessage))
+    else
     {
-      igtl::GetPointMessage* getPointMsg = dynamic_cast<igtl::GetPointMessage*>(bodyMessage.GetPointer());
-      getPointMsg->SetMessageHeader(headerMsg);
-      getPointMsg->AllocateBuffer();
+      LOG_ERROR("Client " << clientId << " GET_IMAGE failed: could not retrieve message");
+      return PLUS_FAIL;
+    }
+
+  }
+  else if (typeid(*bodyMessage) == typeid(igtl::GetPointMessage))
+  {
+    igtl::GetPointMessage* getPointMsg = dynamic_cast<igtl::GetPointMessage*>(bodyMessage.GetPointer());
+    getPointMsg->SetMessageHeader(headerMsg);
+    getPointMsg->AllocateBuffer();
 
-      clientSocket->Receive(getPointMsg->GetBufferBodyPointer(), getPointMsg->GetBufferBodySize());
+    bodyReader.Receive(getPointMsg->GetBufferBodyPointer(), getPointMsg->GetBufferBodySize());
 
-      int c = getPointMsg->Unpack(self->IgtlMessageCrcCheckEnabled);
-      if (c & igtl::MessageHeader::UNPACK_BODY || getPointMsg->GetBufferBodySize() == 0)
+    int c = getPointMsg->Unpack(this->IgtlMessageCrcCheckEnabled);
+    if (c & igtl::MessageHeader::UNPACK_BODY || getPointMsg->GetBufferBodySize() == 0)
+    {
+      std::string fileName;
+      if (!getPointMsg->GetMetaDataElement("Filename", fileName))
       {
-        std::string fileName;
-        if (!getPointMsg->GetMetaDataElement("Filename", fileName))
-        {
-          fileName = getPointMsg->GetDeviceName();
-        }
+        fileName = getPointMsg->GetDeviceName();
+      }
 
-        if (igsioCommon::Tail(fileName, 4) != "fcsv")
-        {
-          LOG_WARNING("Filename does not end in fcsv. GetPoint behaviour may not function correctly.");
-        }
+      if (igsioCommon::Tail(fileName, 4) != "fcsv")
+      {
+        LOG_WARNING("Filename does not end in fcsv. GetPoint behaviour may not function correctly.");
+      }
 
-        if (!vtksys::SystemTools::FileExists(fileName) &&
-            !vtksys::SystemTools::FileExists(vtkPlusConfig::GetInstance()->GetImagePath(fileName)))
-        {
-          LOG_ERROR("File: " << fileName << " requested but does not exist. Cannot get POINT data from it.");
-          return NULL;
-        }
+      if (!vtksys::SystemTools::FileExists(fileName) &&
+          !vtksys::SystemTools::FileExists(vtkPlusConfig::GetInstance()->GetImagePath(fileName)))
+      {
+        LOG_ERROR("File: " << fileName << " requested but does not exist. Cannot get POINT data from it.");
+        return PLUS_FAIL;
+      }
 
-        igtl::MessageBase::Pointer msg = self->IgtlMessageFactory->CreateSendMessage("POINT", client->ClientInfo.GetClientHeaderVersion());
-        igtl::PointMessage* pointMsg = dynamic_cast<igtl::PointMessage*>(msg.GetPointer());
+      igtl::MessageBase::Pointer msg = this->IgtlMessageFactory->CreateSendMessage("POINT", client.ClientInfo.GetClientHeaderVersion());
+      igtl::PointMessage* pointMsg = dynamic_cast<igtl::PointMessage*>(msg.GetPointer());
 
-        std::ifstream t(fileName);
+      std::ifstream t(fileName);
+      if (!t.is_open())
+      {
+        t.open(vtkPlusConfig::GetInstance()->GetImagePath(fileName));
         if (!t.is_open())
         {
-          t.open(vtkPlusConfig::GetInstance()->GetImagePath(fileName));
-          if (!t.is_open())
-          {
-            LOG_ERROR("Cannot read file: " << fileName);
-            return NULL;
-          }
+          LOG_ERROR("Cannot read file: " << fileName);
+          return PLUS_FAIL;
         }
-        std::stringstream buffer;
-        buffer << t.rdbuf();
-        std::vector<std::string> lines = igsioCommon::SplitStringIntoTokens(buffer.str(), '\n', false);
-        for (std::vector<std::string>::iterator it = lines.begin(); it != lines.end(); ++it)
+      }
+      std::stringstream buffer;
+      buffer << t.rdbuf();
+      std::vector<std::string> lines = igsioCommon::SplitStringIntoTokens(buffer.str(), '\n', false);
+      for (std::vector<std::string>::iterator it = lines.begin(); it != lines.end(); ++it)
+      {
+        std::string line = igsioCommon::Trim(*it);
+        if (line[0] == '#')
         {
-          std::string line = igsioCommon::Trim(*it);
-          if (line[0] == '#')
-          {
-            continue;
-          }
-
-          std::vector<std::string> tokens = igsioCommon::SplitStringIntoTokens(line, ',', true);
-          igtl::PointElement::Pointer elem = igtl::PointElement::New();
-          elem->SetPosition(std::stof(tokens[1]), std::stof(tokens[2]), std::stof(tokens[3]));
-          elem->SetName(tokens[0].c_str());
-          elem->SetGroupName("Point");
-          pointMsg->AddPointElement(elem);
+          return PLUS_SUCCESS;
         }
 
-        self->QueueMessageResponseForClient(client->ClientId, pointMsg);
-      }
-      else
-      {
-        LOG_ERROR("Client " << clientId << " GET_POINT failed: could not retrieve message");
-        return NULL;
+        std::vector<std::string> tokens = igsioCommon::SplitStringIntoTokens(line, ',', true);
+        igtl::PointElement::Pointer elem = igtl::PointElement::New();
+        elem->SetPosition(std::stof(tokens[1]), std::stof(tokens[2]), std::stof(tokens[3]));
+        elem->SetName(tokens[0].c_str());
+        elem->SetGroupName("Point");
+        pointMsg->AddPointElement(elem);
       }
+
+      this->QueueMessageResponseForClient(client.ClientId, pointMsg);
     }
     else
     {
-      // if the device type is unknown, skip reading.
-      LOG_WARNING("Unknown OpenIGTLink message is received from client " << clientId << ". Device type: " << headerMsg->GetMessageType()
-                  << ". Device name: " << headerMsg->GetDeviceName() << ".");
-      clientSocket->Skip(headerMsg->GetBodySizeToRead(), 0);
+      LOG_ERROR("Client " << clientId << " GET_POINT failed: could not retrieve message");
+      return PLUS_FAIL;
+    }
+  }
+  else
+  {
+    // if the device type is unknown, skip reading.
+    LOG_WARNING("Unknown OpenIGTLink message is received from client " << clientId << ". Device type: " << headerMsg->GetMessageType()
+                << ". Device name: " << headerMsg->GetDeviceName() << ".");
+    bodyReader.Skip(headerMsg->GetBodySizeToRead());
+    return PLUS_SUCCESS;
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void* vtkPlusOpenIGTLinkServer::DataReceiverThread(vtkMultiThreader::ThreadInfo* data)
+{
+  ClientData* client = (ClientData*)(data->UserData);
+  client->DataReceiverActive.second = true;
+  vtkPlusOpenIGTLinkServer* self = client->Server;
+
+  // Make copy of frequently used data to avoid locking of client data
+  igtl::ClientSocket::Pointer clientSocket = client->ClientSocket;
+  SocketMessageBodyReader bodyReader(clientSocket);
+
+  igtl::MessageHeader::Pointer headerMsg = self->IgtlMessageFactory->CreateHeaderMessage(IGTL_HEADER_VERSION_1);
+
+  while (client->DataReceiverActive.first)
+  {
+    headerMsg->InitBuffer();
+
+    // Receive generic header from the socket
+    int bytesReceived = clientSocket->Receive(headerMsg->GetBufferPointer(), headerMsg->GetBufferSize());
+    if (bytesReceived == IGTL_EMPTY_DATA_SIZE || bytesReceived != headerMsg->GetBufferSize())
+    {
+      vtkIGSIOAccurateTimer::Delay(0.1);
       continue;
     }
+
+    headerMsg->Unpack(self->IgtlMessageCrcCheckEnabled);
+
+    if (headerMsg->GetBodySizeToRead() > static_cast<igtlUint64>(self->MaxClientMessageBodySizeBytes))
+    {
+      LOG_WARNING("Client " << client->ClientId << " sent a " << headerMsg->GetMessageType() << " message with a " << headerMsg->GetBodySizeToRead()
+                  << " bytes long body, larger than MaxClientMessageBodySizeBytes (" << self->MaxClientMessageBodySizeBytes << "). The client is disconnected.");
+      // The data sender thread disconnects the client
+      igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(self->IgtlClientsMutex);
+      client->SendFailed = true;
+      break;
+    }
+
+    if (self->ProcessClientMessage(*client, headerMsg, bodyReader) != PLUS_SUCCESS)
+    {
+      break;
+    }
   } // ConnectionActive
 
   // Close thread
@@ -982,6 +1253,100 @@ void* vtkPlusOpenIGTLinkServer::DataReceiverThread(vtkMultiThreader::ThreadInfo*
   return NULL;
 }
 
+//----------------------------------------------------------------------------
+void* vtkPlusOpenIGTLinkServer::DataWriterThread(vtkMultiThreader::ThreadInfo* data)
+{
+  ClientData* client = (ClientData*)(data->UserData);
+  client->DataWriterActive.second = true;
+  vtkPlusOpenIGTLinkServer* self = client->Server;
+
+  // Make copy of frequently used data to avoid locking of client data
+  igtl::ClientSocket::Pointer clientSocket = client->ClientSocket;
+  std::shared_ptr<ClientOutboundQueue> outboundQueue = client->OutboundQueue;
+
+  igtl::MessageBase::Pointer igtlMessage;
+  while (client->DataWriterActive.first)
+  {
+    if (!outboundQueue->Pop(igtlMessage, DATA_WRITER_WAIT_TIMEOUT_SEC))
+    {
+      continue;
+    }
+
+    int retValue = 0;
+    RETRY_UNTIL_TRUE((retValue = clientSocket->Send(igtlMessage->GetBufferPointer(), igtlMessage->GetBufferSize())) != 0, self->NumberOfRetryAttempts, self->DelayBetweenRetryAttemptsSec);
+    if (retValue == 0)
+    {
+      igtl::TimeStamp::Pointer ts = igtl::TimeStamp::New();
+      igtlMessage->GetTimeStamp(ts);
+      LOG_INFO("Client disconnected - could not send " << igtlMessage->GetMessageType() << " message to client (device name: " << igtlMessage->GetDeviceName()
+               << "  Timestamp: " << std::fixed << ts->GetTimeStamp() << ").");
+      // The data sender thread disconnects the client
+      igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(self->IgtlClientsMutex);
+      client->SendFailed = true;
+      break;
+    }
+    outboundQueue->MessageSent();
+  }
+
+  // Close thread
+  client->DataWriterThreadId = -1;
+  client->DataWriterActive.second = false;
+  return NULL;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusOpenIGTLinkServer::QueueMessageForClient(ClientData& client, igtl::MessageBase::Pointer message, ClientOutboundQueue::OverflowPolicy policy, double traceTimestamp/*=UNDEFINED_TIMESTAMP*/)
+{
+  if (client.OutboundQueue == nullptr || client.SendFailed)
+  {
+    return false;
+  }
+  igtl::MessageBase::Pointer droppedMessage;
+  bool messageQueued = client.OutboundQueue->Push(message, policy, traceTimestamp, &droppedMessage);
+  if (!messageQueued)
+  {
+    LOG_DEBUG("Outbound queue of client " << client.ClientId << " is full, a message has been dropped.");
+  }
+  if (droppedMessage.IsNotNull() && dynamic_cast<igtl::PlusCompressedImageMessage*>(droppedMessage.GetPointer()) != NULL)
+  {
+    // The client cannot decode the delta frames that follow the dropped frame, so the next frame of each
+    // compressed stream must be a key frame. The device name of the message does not always identify the stream.
+    for (std::vector<PlusIgtlClientInfo::ImageStream>::iterator it = client.ClientInfo.ImageStreams.begin(); it != client.ClientInfo.ImageStreams.end(); ++it)
+    {
+      if (it->CompressionState != nullptr)
+      {
+        it->CompressionState->Reset();
+      }
+    }
+  }
+  if (this->EventLoopEnabled)
+  {
+    this->WakeUpEventLoop();
+  }
+  return messageQueued;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkServer::DisconnectFailedClients()
+{
+  std::vector<int> disconnectedClientIds;
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
+    for (std::list<ClientData>::iterator clientIterator = this->IgtlClients.begin(); clientIterator != this->IgtlClients.end(); ++clientIterator)
+    {
+      if (clientIterator->SendFailed)
+      {
+        disconnectedClientIds.push_back(clientIterator->ClientId);
+      }
+    }
+  }
+
+  for (std::vector< int >::iterator it = disconnectedClientIds.begin(); it != disconnectedClientIds.end(); ++it)
+  {
+    DisconnectClient(*it);
+  }
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusOpenIGTLinkServer::SendTrackedFrame(igsioTrackedFrame& trackedFrame)
 {
@@ -1002,24 +1367,31 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendTrackedFrame(igsioTrackedFrame& tracked
   double timestampUniversal = vtkIGSIOAccurateTimer::GetUniversalTimeFromSystemTime(timestampSystem);
   trackedFrame.SetTimestamp(timestampUniversal);
 
-  std::vector<int> disconnectedClientIds;
   {
-    // Lock before we send message to the clients
+    // Messages are packed once per frame, clients with the same subscription share them
+    vtkPlusIgtlMessageFactory::PackedMessageCache messageCache;
+
+    // Lock before we queue messages for the clients. Messages are sent by the writer thread of each client,
+    // so a slow client does not delay the others.
     igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
     for (std::list<ClientData>::iterator clientIterator = this->IgtlClients.begin(); clientIterator != this->IgtlClients.end(); ++clientIterator)
     {
-      igtl::ClientSocket::Pointer clientSocket = (*clientIterator).ClientSocket;
+      if (clientIterator->SendFailed)
+      {
+        // Client is about to be disconnected
+        continue;
+      }
 
       // Create IGT messages
       std::vector<igtl::MessageBase::Pointer> igtlMessages;
       std::vector<igtl::MessageBase::Pointer>::iterator igtlMessageIterator;
 
-      if (this->IgtlMessageFactory->PackMessages(clientIterator->ClientId, clientIterator->ClientInfo, igtlMessages, trackedFrame, this->SendValidTransformsOnly, this->TransformRepository) != PLUS_SUCCESS)
+      if (this->IgtlMessageFactory->PackMessages(clientIterator->ClientId, clientIterator->ClientInfo, igtlMessages, trackedFrame, this->SendValidTransformsOnly, this->TransformRepository, &messageCache) != PLUS_SUCCESS)
       {
         LOG_WARNING("Failed to pack all IGT messages");
       }
 
-      // Send all messages to a client
+      // Queue all messages for a client
       for (igtlMessageIterator = igtlMessages.begin(); igtlMessageIterator != igtlMessages.end(); ++igtlMessageIterator)
       {
         igtl::MessageBase::Pointer igtlMessage = (*igtlMessageIterator);
@@ -1028,29 +1400,14 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendTrackedFrame(igsioTrackedFrame& tracked
           continue;
         }
 
-        int retValue = 0;
-        RETRY_UNTIL_TRUE((retValue = clientSocket->Send(igtlMessage->GetBufferPointer(), igtlMessage->GetBufferSize())) != 0, this->NumberOfRetryAttempts, this->DelayBetweenRetryAttemptsSec);
-        if (retValue == 0)
-        {
-          disconnectedClientIds.push_back(clientIterator->ClientId);
-          igtl::TimeStamp::Pointer ts = igtl::TimeStamp::New();
-          igtlMessage->GetTimeStamp(ts);
-          LOG_INFO("Client disconnected - could not send " << igtlMessage->GetMessageType() << " message to client (device name: " << igtlMessage->GetDeviceName()
-                   << "  Timestamp: " << std::fixed << ts->GetTimeStamp() << ").");
-          break;
-        }
+        this->QueueMessageForClient(*clientIterator, igtlMessage, this->DataOverflowPolicy, timestampSystem);
 
         // Update the TDATA timestamp, even if TDATA isn't sent (cheaper than checking for existing TDATA message type)
         clientIterator->ClientInfo.SetLastTDATASentTimeStamp(trackedFrame.GetTimestamp());
       }
     }
   }
-
-  // Clean up disconnected clients
-  for (std::vector< int >::iterator it = disconnectedClientIds.begin(); it != disconnectedClientIds.end(); ++it)
-  {
-    DisconnectClient(*it);
-  }
+  PlusLatencyTracer::GetInstance()->AddEvent(PlusLatencyTracer::STAGE_PACKED, timestampSystem);
 
   // restore original timestamp
   trackedFrame.SetTimestamp(timestampSystem);
@@ -1061,7 +1418,7 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendTrackedFrame(igsioTrackedFrame& tracked
 //----------------------------------------------------------------------------
 void vtkPlusOpenIGTLinkServer::DisconnectClient(int clientId)
 {
-  // Stop the client's data receiver thread
+  // Stop the client's data receiver and writer threads
   {
     // Request thread stop
     igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
@@ -1072,17 +1429,23 @@ void vtkPlusOpenIGTLinkServer::DisconnectClient(int clientId)
         continue;
       }
       clientIterator->DataReceiverActive.first = false;
+      clientIterator->DataWriterActive.first = false;
+      if (clientIterator->OutboundQueue != nullptr)
+      {
+        // Wake up the writer thread
+        clientIterator->OutboundQueue->Stop();
+      }
       break;
     }
   }
 
-  // Wait for the thread to stop
-  bool clientDataReceiverThreadStillActive = false;
+  // Wait for the threads to stop
+  bool clientThreadsStillActive = false;
   do
   {
-    clientDataReceiverThreadStillActive = false;
+    clientThreadsStillActive = false;
     {
-      // check if any of the receiver threads are still active
+      // check if the receiver or writer thread is still active
       igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
       for (std::list<ClientData>::iterator clientIterator = this->IgtlClients.begin(); clientIterator != this->IgtlClients.end(); ++clientIterator)
       {
@@ -1095,24 +1458,35 @@ void vtkPlusOpenIGTLinkServer::DisconnectClient(int clientId)
           if (clientIterator->DataReceiverActive.second)
           {
             // thread still running
-            clientDataReceiverThreadStillActive = true;
+            clientThreadsStillActive = true;
           }
           else
           {
             // thread stopped
             clientIterator->DataReceiverThreadId = -1;
           }
-          break;
         }
+        if (clientIterator->DataWriterThreadId > 0)
+        {
+          if (clientIterator->DataWriterActive.second)
+          {
+            clientThreadsStillActive = true;
+          }
+          else
+          {
+            clientIterator->DataWriterThreadId = -1;
+          }
+        }
+        break;
       }
     }
-    if (clientDataReceiverThreadStillActive)
+    if (clientThreadsStillActive)
     {
       // give some time for the threads to finish
       vtkIGSIOAccurateTimer::DelayWithEventProcessing(0.2);
     }
   }
-  while (clientDataReceiverThreadStillActive);
+  while (clientThreadsStillActive);
 
   // Close socket and remove client from the list
   int port = 0;
@@ -1145,38 +1519,23 @@ void vtkPlusOpenIGTLinkServer::KeepAlive()
 {
   LOG_TRACE("Keep alive packet sent to clients...");
 
-  std::vector< int > disconnectedClientIds;
+  // Lock before we queue messages for the clients
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
 
+  for (std::list<ClientData>::iterator clientIterator = this->IgtlClients.begin(); clientIterator != this->IgtlClients.end(); ++clientIterator)
   {
-    // Lock before we send message to the clients
-    igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
-
-    for (std::list<ClientData>::iterator clientIterator = this->IgtlClients.begin(); clientIterator != this->IgtlClients.end(); ++clientIterator)
+    if (clientIterator->OutboundQueue == nullptr || !clientIterator->OutboundQueue->IsEmpty())
     {
-      igtl::StatusMessage::Pointer replyMsg = igtl::StatusMessage::New();
-      replyMsg->SetCode(igtl::StatusMessage::STATUS_OK);
-      replyMsg->Pack();
+      // Messages are still waiting to be sent, they keep the connection alive
+      continue;
+    }
 
-      int retValue = 0;
-      RETRY_UNTIL_TRUE(
-        (retValue = clientIterator->ClientSocket->Send(replyMsg->GetPackPointer(), replyMsg->GetPackSize())) != 0,
-        this->NumberOfRetryAttempts, this->DelayBetweenRetryAttemptsSec);
-      if (retValue == 0)
-      {
-        disconnectedClientIds.push_back(clientIterator->ClientId);
-        igtl::TimeStamp::Pointer ts = igtl::TimeStamp::New();
-        replyMsg->GetTimeStamp(ts);
+    igtl::StatusMessage::Pointer replyMsg = igtl::StatusMessage::New();
+    replyMsg->SetCode(igtl::StatusMessage::STATUS_OK);
+    replyMsg->Pack();
 
-        LOG_DEBUG("Client disconnected - could not send " << replyMsg->GetMessageType() << " message to client (device name: " << replyMsg->GetDeviceName()
-                  << "  Timestamp: " << std::fixed <<  ts->GetTimeStamp() << ").");
-      }
-    } // clientIterator
-  } // unlock client list
-
-  // Clean up disconnected clients
-  for (std::vector< int >::iterator it = disconnectedClientIds.begin(); it != disconnectedClientIds.end(); ++it)
-  {
-    DisconnectClient(*it);
+    // If the message cannot be sent then the writer thread marks the client for disconnection
+    this->QueueMessageForClient(*clientIterator, replyMsg.GetPointer(), this->DataOverflowPolicy);
   }
 }
 
@@ -1204,6 +1563,22 @@ PlusStatus vtkPlusOpenIGTLinkServer::GetClientInfo(unsigned int clientId, PlusIg
   return PLUS_FAIL;
 }
 
+//------------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkServer::GetClientOutboundQueueStatistics(unsigned int clientId, ClientOutboundQueue::Statistics& outStatistics) const
+{
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
+  for (std::list<ClientData>::const_iterator it = this->IgtlClients.begin(); it != this->IgtlClients.end(); ++it)
+  {
+    if (it->ClientId == clientId && it->OutboundQueue != nullptr)
+    {
+      outStatistics = it->OutboundQueue->GetStatistics();
+      return PLUS_SUCCESS;
+    }
+  }
+
+  return PLUS_FAIL;
+}
+
 //------------------------------------------------------------------------------
 PlusStatus vtkPlusOpenIGTLinkServer::ReadConfiguration(vtkXMLDataElement* serverElement, const std::string& aFilename)
 {
@@ -1224,9 +1599,31 @@ PlusStatus vtkPlusOpenIGTLinkServer::ReadConfiguration(vtkXMLDataElement* server
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfRetryAttempts, serverElement);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, DelayBetweenRetryAttemptsSec, serverElement);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, KeepAliveIntervalSec, serverElement);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, MaxClientMessageBodySizeBytes, serverElement);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, MaxNumberOfQueuedMessagesPerClient, serverElement);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, CompressionKeyFrameInterval, serverElement);
+  if (this->CompressionKeyFrameInterval < 1)
+  {
+    LOG_ERROR("CompressionKeyFrameInterval must be positive (" << this->CompressionKeyFrameInterval << ")");
+    return PLUS_FAIL;
+  }
+  XML_READ_ENUM3_ATTRIBUTE_OPTIONAL(DataOverflowPolicy, serverElement,
+                                    "DROP_OLDEST", ClientOutboundQueue::DROP_OLDEST,
+                                    "DROP_NEWEST", ClientOutboundQueue::DROP_NEWEST,
+                                    "NEVER_DROP", ClientOutboundQueue::NEVER_DROP);
+  XML_READ_ENUM3_ATTRIBUTE_OPTIONAL(ResponseOverflowPolicy, serverElement,
+                                    "DROP_OLDEST", ClientOutboundQueue::DROP_OLDEST,
+                                    "DROP_NEWEST", ClientOutboundQueue::DROP_NEWEST,
+                                    "NEVER_DROP", ClientOutboundQueue::NEVER_DROP);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(SendValidTransformsOnly, serverElement);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(IgtlMessageCrcCheckEnabled, serverElement);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(LogWarningOnNoDataAvailable, serverElement);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(EventLoopEnabled, serverElement);
+  if (this->EventLoopEnabled && !EVENT_LOOP_AVAILABLE)
+  {
+    LOG_WARNING("EventLoopEnabled is not supported on this platform, a receiver and a writer thread is started for each client.");
+    this->EventLoopEnabled = false;
+  }
 
   this->DefaultClientInfo.IgtlMessageTypes.clear();
   this->DefaultClientInfo.TransformNames.clear();
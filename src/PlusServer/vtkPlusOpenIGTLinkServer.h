@@ -20,7 +20,11 @@
 #include <vtkSmartPointer.h>
 
 // STL includes
+#include <condition_variable>
 #include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
 
 // OS includes
 #if (_MSC_VER == 1500)
@@ -29,6 +33,7 @@
 
 // IGTL includes
 #include <igtlMessageBase.h>
+#include <igtlMessageHeader.h>
 #include <igtlServerSocket.h>
 
 //class igsioTrackedFrame; 
@@ -39,6 +44,84 @@ class vtkPlusCommandProcessor;
 class vtkPlusCommandResponse;
 class vtkIGSIORecursiveCriticalSection;
 //class vtkIGSIOTransformRepository;
+class ClientMessageBodyReader;
+class PlusNewItemSignal;
+
+/*!
+  \struct ClientOutboundQueue
+  \brief Bounded queue of packed messages waiting to be sent to one client
+
+  The queue is filled by the server threads and drained by the writer thread of the client, so
+  a slow client does not delay sending to the other clients. When the queue is full then the
+  overflow policy of the message that is being queued decides what happens.
+*/
+struct ClientOutboundQueue
+{
+  enum OverflowPolicy
+  {
+    DROP_OLDEST,  ///< Remove the oldest droppable message from the queue to make room for the new message
+    DROP_NEWEST,  ///< Discard the new message
+    NEVER_DROP    ///< Queue the message even if the queue is full, the message cannot be dropped later either
+  };
+
+  /*! Statistics of the queue, for monitoring slow clients */
+  struct Statistics
+  {
+    Statistics()
+      : QueueDepth(0)
+      , MaxQueueDepth(0)
+      , NumberOfSentMessages(0)
+      , NumberOfDroppedMessages(0)
+    {
+    }
+    unsigned int QueueDepth;
+    unsigned int MaxQueueDepth;
+    unsigned long NumberOfSentMessages;
+    unsigned long NumberOfDroppedMessages;
+  };
+
+  explicit ClientOutboundQueue(unsigned int maxNumberOfMessages);
+
+  /*!
+    Add a message to the queue. Returns false if a message had to be dropped because the queue is full.
+    \param traceTimestamp Timestamp (system time) of the data in the message, used for reporting the sent stage to PlusLatencyTracer
+    \param droppedMessage If not NULL then it is set to the message that was dropped (it may be the new message)
+  */
+  bool Push(igtl::MessageBase::Pointer message, OverflowPolicy policy, double traceTimestamp = UNDEFINED_TIMESTAMP, igtl::MessageBase::Pointer* droppedMessage = NULL);
+
+  /*!
+    Wait until a message is available (at most timeoutSec) and remove it from the queue.
+    Returns false if there is no message or the queue has been stopped.
+  */
+  bool Pop(igtl::MessageBase::Pointer& message, double timeoutSec);
+
+  /*! Called by the writer thread after the message that was last popped has been sent */
+  void MessageSent();
+
+  /*! Wake up and stop the writer thread, messages that are still in the queue are discarded */
+  void Stop();
+
+  bool IsEmpty();
+
+  Statistics GetStatistics();
+
+protected:
+  struct QueuedMessage
+  {
+    igtl::MessageBase::Pointer Message;
+    bool Droppable;
+    double TraceTimestamp;
+  };
+
+  std::mutex Mutex;
+  std::condition_variable MessageAvailable;
+  std::deque<QueuedMessage> Messages;
+  unsigned int MaxNumberOfMessages;
+  bool Stopped;
+  Statistics Stats;
+  /*! Trace timestamp of the message that was last popped */
+  double PoppedMessageTraceTimestamp;
+};
 
 struct ClientData
 {
@@ -47,6 +130,13 @@ struct ClientData
     , ClientSocket(NULL)
     , DataReceiverActive(std::make_pair(false, false))
     , DataReceiverThreadId(-1)
+    , DataWriterActive(std::make_pair(false, false))
+    , DataWriterThreadId(-1)
+    , SendFailed(false)
+    , PendingMessageBytesSent(0)
+    , LastSendProgressTime(0.0)
+    , WritableEventRequested(false)
+    , ReceivedBytes(0)
     , Server(NULL)
   {
   }
@@ -65,6 +155,31 @@ struct ClientData
   std::pair<bool, bool> DataReceiverActive;
   int DataReceiverThreadId;
 
+  /// Messages waiting to be sent to the client
+  std::shared_ptr<ClientOutboundQueue> OutboundQueue;
+
+  /// Active flag for the thread that sends the queued messages (first: request, second: respond )
+  std::pair<bool, bool> DataWriterActive;
+  int DataWriterThreadId;
+
+  /// Set by the writer thread if a message could not be sent, the client is then disconnected by the data sender thread
+  bool SendFailed;
+
+  /// Store the IDs of recent commands to be able to detect duplicate command IDs
+  std::deque<uint32_t> PreviousCommandIds;
+
+  /// Event loop only: message that is being sent, number of its bytes that are already sent and time of the last successful send
+  igtl::MessageBase::Pointer PendingMessage;
+  size_t PendingMessageBytesSent;
+  double LastSendProgressTime;
+  /// Event loop only: true if the event loop waits for the socket to become writable
+  bool WritableEventRequested;
+
+  /// Event loop only: header of the message that is being received (NULL while the header is received) and the received bytes
+  igtl::MessageHeader::Pointer ReceivedHeader;
+  std::vector<unsigned char> ReceiveBuffer;
+  size_t ReceivedBytes;
+
   PlusIgtlClientInfo ClientInfo;
 
   vtkPlusOpenIGTLinkServer* Server;
@@ -83,6 +198,18 @@ struct ClientData
   requested image and tracking information in the same format as in the DefaultClientInfo element in the device set
   configuration file.
 
+  Messages are not sent directly to the clients but are queued in the bounded outbound queue of each client and
+  sent by a writer thread of the client, so that a slow client does not delay the others. The size of the queues
+  (MaxNumberOfQueuedMessagesPerClient) and what happens to the data messages (DataOverflowPolicy) and command
+  responses (ResponseOverflowPolicy) when a queue is full can be set in the configuration file.
+
+  On Linux a single epoll based event loop thread (EventLoopEnabled) accepts connections and receives from and
+  sends to all clients, so the number of threads does not grow with the number of clients.
+
+  Images of streams with lossless compression are sent as differences to the previous frame of the stream, except
+  for key frames that are sent at most every CompressionKeyFrameInterval frames. A client that missed a message
+  can decode the stream again from the next key frame.
+
   \ingroup PlusLibPlusServer
 */
 class vtkPlusServerExport vtkPlusOpenIGTLinkServer: public vtkObject
@@ -126,6 +253,16 @@ public:
   vtkSetMacro(DefaultClientReceiveTimeoutSec, float);
   vtkGetMacroConst(DefaultClientReceiveTimeoutSec, float);
 
+  /*!
+    If enabled then a single event loop thread accepts connections, receives messages from all clients and sends
+    the queued messages to all clients, instead of starting a receiver and a writer thread for each client.
+    Only available on Linux (where it is enabled by default).
+    New tracked frames do not wake up the event loop directly: the data sender thread is woken up when new data is
+    added to the broadcast channel, gets the frames and queues the messages for the clients, which wakes up the event loop.
+  */
+  vtkSetMacro(EventLoopEnabled, bool);
+  vtkGetMacroConst(EventLoopEnabled, bool);
+
   /*! Set data collector instance */
   vtkSetMacro(DataCollector, vtkPlusDataCollector*);
   vtkGetMacroConst(DataCollector, vtkPlusDataCollector*);
@@ -142,6 +279,9 @@ public:
     */
   virtual PlusStatus GetClientInfo(unsigned int clientId, PlusIgtlClientInfo& outClientInfo) const;
 
+  /*! Get the outbound queue depth and sent/dropped message counters of a client */
+  virtual PlusStatus GetClientOutboundQueueStatistics(unsigned int clientId, ClientOutboundQueue::Statistics& outStatistics) const;
+
   /*! Start server */
   PlusStatus StartOpenIGTLinkService();
 
@@ -166,6 +306,9 @@ protected:
   /*! Add a response to the queue for sending to the client */
   PlusStatus QueueMessageResponseForClient(int clientId, igtl::MessageBase::Pointer message);
 
+  /*! Start the thread that accepts the client connections (the event loop thread if EventLoopEnabled is set) and wait until it is listening */
+  PlusStatus StartConnectionReceiverThread();
+
   /*! Thread for client connection handling */
   static void* ConnectionReceiverThread(vtkMultiThreader::ThreadInfo* data);
 
@@ -184,6 +327,43 @@ protected:
   /*! Thread for receiving control data from clients */
   static void* DataReceiverThread(vtkMultiThreader::ThreadInfo* data);
 
+  /*! Thread for sending the queued messages to a client */
+  static void* DataWriterThread(vtkMultiThreader::ThreadInfo* data);
+
+  /*! Thread that handles connections, receiving and sending for all clients if EventLoopEnabled is set (platform specific) */
+  static void* EventLoopThread(vtkMultiThreader::ThreadInfo* data);
+
+  /*! Wake up the event loop to send newly queued messages. The caller must have locked IgtlClientsMutex. (platform specific) */
+  void WakeUpEventLoop();
+
+  /*! Start monitoring the socket of a new client in the event loop. The caller must have locked IgtlClientsMutex. (platform specific) */
+  PlusStatus AddClientToEventLoop(ClientData& client);
+
+  /*! Receive and process all messages that are available on the socket of a client. Used by the event loop on Linux only. */
+  void ReceiveClientMessages(ClientData& client);
+
+  /*! Add a newly connected client to the client list and start receiving from and sending to it */
+  void AddClient(igtl::ClientSocket::Pointer clientSocket);
+
+  /*! Create a new compression state for each image stream of the client, with the key frame interval of the server */
+  void InitializeCompressionStates(PlusIgtlClientInfo& clientInfo) const;
+
+  /*!
+    Process a message received from a client. The header is already received and unpacked, the body is read from bodyReader.
+    Returns PLUS_FAIL if no more messages should be received from the client.
+  */
+  PlusStatus ProcessClientMessage(ClientData& client, igtl::MessageHeader::Pointer headerMsg, ClientMessageBodyReader& bodyReader);
+
+  /*!
+    Add a message to the outbound queue of a client. The caller must have locked IgtlClientsMutex.
+    Returns false if a message was dropped because the queue of the client is full. If a compressed image
+    was dropped then the compression of the client restarts with a key frame.
+  */
+  bool QueueMessageForClient(ClientData& client, igtl::MessageBase::Pointer message, ClientOutboundQueue::OverflowPolicy policy, double traceTimestamp = UNDEFINED_TIMESTAMP);
+
+  /*! Disconnect clients that a message could not be sent to */
+  void DisconnectFailedClients();
+
   /*! Tracked frame interface, sends the selected message type and data to all clients */
   virtual PlusStatus SendTrackedFrame(igsioTrackedFrame& trackedFrame);
 
@@ -216,6 +396,21 @@ protected:
   vtkSetMacro(KeepAliveIntervalSec, double);
   vtkGetMacroConst(KeepAliveIntervalSec, double);
 
+  vtkSetMacro(MaxClientMessageBodySizeBytes, int);
+  vtkGetMacroConst(MaxClientMessageBodySizeBytes, int);
+
+  vtkSetMacro(MaxNumberOfQueuedMessagesPerClient, int);
+  vtkGetMacroConst(MaxNumberOfQueuedMessagesPerClient, int);
+
+  vtkSetMacro(DataOverflowPolicy, ClientOutboundQueue::OverflowPolicy);
+  vtkGetMacroConst(DataOverflowPolicy, ClientOutboundQueue::OverflowPolicy);
+
+  vtkSetMacro(ResponseOverflowPolicy, ClientOutboundQueue::OverflowPolicy);
+  vtkGetMacroConst(ResponseOverflowPolicy, ClientOutboundQueue::OverflowPolicy);
+
+  vtkSetMacro(CompressionKeyFrameInterval, int);
+  vtkGetMacroConst(CompressionKeyFrameInterval, int);
+
   vtkSetStdStringMacro(OutputChannelId);
   vtkSetStdStringMacro(ConfigFilename);
 
@@ -253,6 +448,31 @@ private:
   /*! Maximum number of IGTL messages to send in one period */
   int MaxNumberOfIgtlMessagesToSend;
 
+  /*! Maximum number of messages waiting to be sent to a client (0 = no limit), the overflow policy decides what happens to the messages above this limit */
+  int MaxNumberOfQueuedMessagesPerClient;
+
+  /*! Overflow policy of the messages that are created from tracked frames (images, transforms, etc.) and keep-alive messages */
+  ClientOutboundQueue::OverflowPolicy DataOverflowPolicy;
+
+  /*! Overflow policy of command and message responses */
+  ClientOutboundQueue::OverflowPolicy ResponseOverflowPolicy;
+
+  /*! Maximum number of frames between key frames of the compressed image streams */
+  int CompressionKeyFrameInterval;
+
+  /*! Use a single event loop thread for all client sockets instead of threads per client */
+  bool EventLoopEnabled;
+
+  /*! Event loop file descriptors (epoll instance and the eventfd that wakes up the loop), -1 if the event loop is not running */
+  int EventLoopFd;
+  int EventLoopWakeUpFd;
+
+  /*!
+    Maximum size of the body of a message received from a client. The body buffer is allocated before the body is
+    received, so a larger size is not accepted: the client is disconnected instead.
+  */
+  int MaxClientMessageBodySizeBytes;
+
   // Active flag for threads (request, respond )
   struct ThreadFlags
   {
@@ -318,6 +538,9 @@ private:
   /*! Channel to use for broadcasting */
   vtkPlusChannel* BroadcastChannel;
 
+  /*! Signaled when new data is added to the broadcast channel, wakes up the data sender thread */
+  std::shared_ptr<PlusNewItemSignal> NewBroadcastDataSignal;
+
   bool LogWarningOnNoDataAvailable;
 
   double KeepAliveIntervalSec;
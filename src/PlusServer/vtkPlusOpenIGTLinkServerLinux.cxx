@@ -1,7 +1,48 @@
 #include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
+#include <errno.h>
 #include <ifaddrs.h>
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <limits>
+
+namespace
+{
+  const bool EVENT_LOOP_AVAILABLE = true;
+  const int EVENT_LOOP_MAX_NUMBER_OF_EVENTS = 64;
+  const int EVENT_LOOP_TIMEOUT_MSEC = 200;
+
+  // Epoll event IDs of the sockets that do not belong to a client (client IDs start from 1)
+  const uint64_t LISTENING_SOCKET_EVENT_ID = 0;
+  const uint64_t WAKE_UP_EVENT_ID = std::numeric_limits<uint64_t>::max();
+
+  //----------------------------------------------------------------------------
+  /*! Get the file descriptor of an OpenIGTLink socket (it is only accessible to derived classes) */
+  struct SocketDescriptorAccessor : public igtl::Socket
+  {
+    static int GetDescriptor(igtl::Socket* socket)
+    {
+      return socket->*(&SocketDescriptorAccessor::m_SocketDescriptor);
+    }
+  };
+
+  //----------------------------------------------------------------------------
+  ClientData* FindClient(std::list<ClientData>& clients, uint64_t clientId)
+  {
+    for (std::list<ClientData>::iterator clientIterator = clients.begin(); clientIterator != clients.end(); ++clientIterator)
+    {
+      if (static_cast<uint64_t>(clientIterator->ClientId) == clientId)
+      {
+        return &(*clientIterator);
+      }
+    }
+    return NULL;
+  }
+}
 
 void PrintServerInfo(vtkPlusOpenIGTLinkServer* self)
 {
@@ -35,4 +76,332 @@ void PrintServerInfo(vtkPlusOpenIGTLinkServer* self)
   }
   ss << " -- port " << self->GetListeningPort();
   LOG_INFO(ss.str());
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkServer::AddClientToEventLoop(ClientData& client)
+{
+  client.ReceivedHeader = NULL;
+  client.ReceiveBuffer.resize(IGTL_HEADER_SIZE);
+  client.ReceivedBytes = 0;
+
+  epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN;
+  event.data.u64 = client.ClientId;
+  if (epoll_ctl(this->EventLoopFd, EPOLL_CTL_ADD, SocketDescriptorAccessor::GetDescriptor(client.ClientSocket), &event) != 0)
+  {
+    LOG_ERROR("Failed to add the socket of client " << client.ClientId << " to the event loop: " << strerror(errno));
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkServer::WakeUpEventLoop()
+{
+  if (this->EventLoopWakeUpFd < 0)
+  {
+    return;
+  }
+  uint64_t increment = 1;
+  if (write(this->EventLoopWakeUpFd, &increment, sizeof(increment)) < 0 && errno != EAGAIN)
+  {
+    LOG_ERROR("Failed to wake up the OpenIGTLink server event loop: " << strerror(errno));
+  }
+}
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  /*! Enable or disable waiting for the client socket to become writable */
+  void SetWritableEventRequested(int eventLoopFd, ClientData& client, bool requested)
+  {
+    if (client.WritableEventRequested == requested)
+    {
+      return;
+    }
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN | (requested ? EPOLLOUT : 0);
+    event.data.u64 = client.ClientId;
+    if (epoll_ctl(eventLoopFd, EPOLL_CTL_MOD, SocketDescriptorAccessor::GetDescriptor(client.ClientSocket), &event) != 0)
+    {
+      LOG_ERROR("Failed to modify the events of client " << client.ClientId << " in the event loop: " << strerror(errno));
+      client.SendFailed = true;
+      return;
+    }
+    client.WritableEventRequested = requested;
+  }
+
+  //----------------------------------------------------------------------------
+  /*!
+    Send queued messages to the client until the queue is empty or the socket would block.
+    A message is not dropped once sending of it has started. The caller must have locked the client list.
+  */
+  void SendQueuedMessages(int eventLoopFd, ClientData& client, double sendStallTimeoutSec)
+  {
+    if (client.SendFailed)
+    {
+      return;
+    }
+    int socketDescriptor = SocketDescriptorAccessor::GetDescriptor(client.ClientSocket);
+    while (true)
+    {
+      if (client.PendingMessage.IsNull())
+      {
+        if (!client.OutboundQueue->Pop(client.PendingMessage, 0.0))
+        {
+          // All messages are sent
+          break;
+        }
+        client.PendingMessageBytesSent = 0;
+        client.LastSendProgressTime = vtkIGSIOAccurateTimer::GetSystemTime();
+      }
+
+      const unsigned char* messageBuffer = static_cast<const unsigned char*>(client.PendingMessage->GetBufferPointer());
+      size_t messageSize = client.PendingMessage->GetBufferSize();
+      ssize_t bytesSent = send(socketDescriptor, messageBuffer + client.PendingMessageBytesSent, messageSize - client.PendingMessageBytesSent, MSG_DONTWAIT | MSG_NOSIGNAL);
+      if (bytesSent < 0)
+      {
+        if (errno == EINTR)
+        {
+          continue;
+        }
+        if ((errno == EAGAIN || errno == EWOULDBLOCK)
+            && vtkIGSIOAccurateTimer::GetSystemTime() - client.LastSendProgressTime < sendStallTimeoutSec)
+        {
+          // Socket buffer is full, continue when the socket becomes writable
+          SetWritableEventRequested(eventLoopFd, client, true);
+          return;
+        }
+        igtl::TimeStamp::Pointer ts = igtl::TimeStamp::New();
+        client.PendingMessage->GetTimeStamp(ts);
+        LOG_INFO("Client disconnected - could not send " << client.PendingMessage->GetMessageType() << " message to client (device name: " << client.PendingMessage->GetDeviceName()
+                 << "  Timestamp: " << std::fixed << ts->GetTimeStamp() << ").");
+        // The data sender thread disconnects the client
+        client.SendFailed = true;
+        return;
+      }
+
+      client.PendingMessageBytesSent += bytesSent;
+      client.LastSendProgressTime = vtkIGSIOAccurateTimer::GetSystemTime();
+      if (client.PendingMessageBytesSent == messageSize)
+      {
+        client.PendingMessage = NULL;
+        client.OutboundQueue->MessageSent();
+      }
+    }
+    SetWritableEventRequested(eventLoopFd, client, false);
+  }
+}
+
+//----------------------------------------------------------------------------
+void* vtkPlusOpenIGTLinkServer::EventLoopThread(vtkMultiThreader::ThreadInfo* data)
+{
+  vtkPlusOpenIGTLinkServer* self = (vtkPlusOpenIGTLinkServer*)(data->UserData);
+
+  int r = self->ServerSocket->CreateServer(self->ListeningPort);
+  if (r < 0)
+  {
+    LOG_ERROR("Cannot create a server socket.");
+    return NULL;
+  }
+
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(self->IgtlClientsMutex);
+    self->EventLoopFd = epoll_create1(EPOLL_CLOEXEC);
+    self->EventLoopWakeUpFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  }
+  epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN;
+  bool eventLoopCreated = (self->EventLoopFd >= 0 && self->EventLoopWakeUpFd >= 0);
+  if (eventLoopCreated)
+  {
+    event.data.u64 = LISTENING_SOCKET_EVENT_ID;
+    eventLoopCreated = (epoll_ctl(self->EventLoopFd, EPOLL_CTL_ADD, SocketDescriptorAccessor::GetDescriptor(self->ServerSocket), &event) == 0);
+  }
+  if (eventLoopCreated)
+  {
+    event.data.u64 = WAKE_UP_EVENT_ID;
+    eventLoopCreated = (epoll_ctl(self->EventLoopFd, EPOLL_CTL_ADD, self->EventLoopWakeUpFd, &event) == 0);
+  }
+  if (!eventLoopCreated)
+  {
+    LOG_ERROR("Cannot create the OpenIGTLink server event loop: " << strerror(errno));
+  }
+  else
+  {
+    PrintServerInfo(self);
+    self->ConnectionActive.Respond = true;
+  }
+
+  // A client is disconnected if no bytes could be sent to it for as long as the threaded sending would retry
+  const double sendStallTimeoutSec = self->NumberOfRetryAttempts * (self->DefaultClientSendTimeoutSec + self->DelayBetweenRetryAttemptsSec);
+
+  epoll_event events[EVENT_LOOP_MAX_NUMBER_OF_EVENTS];
+  while (eventLoopCreated && self->ConnectionActive.Request)
+  {
+    int numberOfEvents = epoll_wait(self->EventLoopFd, events, EVENT_LOOP_MAX_NUMBER_OF_EVENTS, EVENT_LOOP_TIMEOUT_MSEC);
+    if (numberOfEvents < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      LOG_ERROR("OpenIGTLink server event loop failed: " << strerror(errno));
+      break;
+    }
+
+    for (int i = 0; i < numberOfEvents; ++i)
+    {
+      if (events[i].data.u64 == LISTENING_SOCKET_EVENT_ID)
+      {
+        // A connection is waiting, so accepting it does not block
+        igtl::ClientSocket::Pointer newClientSocket = self->ServerSocket->WaitForConnection(1);
+        if (newClientSocket.IsNotNull())
+        {
+          self->AddClient(newClientSocket);
+        }
+        continue;
+      }
+      if (events[i].data.u64 == WAKE_UP_EVENT_ID)
+      {
+        // Messages have been queued, they are sent below
+        uint64_t counter = 0;
+        if (read(self->EventLoopWakeUpFd, &counter, sizeof(counter)) < 0 && errno != EAGAIN)
+        {
+          LOG_ERROR("Failed to read the OpenIGTLink server event loop wake up counter: " << strerror(errno));
+        }
+        continue;
+      }
+
+      // Client socket event
+      igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(self->IgtlClientsMutex);
+      ClientData* client = FindClient(self->IgtlClients, events[i].data.u64);
+      if (client == NULL || client->SendFailed)
+      {
+        // Client is disconnected or about to be disconnected
+        continue;
+      }
+      if (events[i].events & EPOLLIN)
+      {
+        self->ReceiveClientMessages(*client);
+      }
+      else if (events[i].events & (EPOLLERR | EPOLLHUP))
+      {
+        LOG_DEBUG("Connection of client " << client->ClientId << " is closed.");
+        client->SendFailed = true;
+      }
+    }
+
+    // Send queued messages. Clients that are waiting for their socket to become writable are also checked here, to detect stalled connections.
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(self->IgtlClientsMutex);
+    for (std::list<ClientData>::iterator clientIterator = self->IgtlClients.begin(); clientIterator != self->IgtlClients.end(); ++clientIterator)
+    {
+      SendQueuedMessages(self->EventLoopFd, *clientIterator, sendStallTimeoutSec);
+    }
+  }
+
+  // Close the event loop, client sockets are closed when the clients are disconnected
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(self->IgtlClientsMutex);
+    if (self->EventLoopWakeUpFd >= 0)
+    {
+      close(self->EventLoopWakeUpFd);
+      self->EventLoopWakeUpFd = -1;
+    }
+    if (self->EventLoopFd >= 0)
+    {
+      close(self->EventLoopFd);
+      self->EventLoopFd = -1;
+    }
+  }
+
+  // Close server socket
+  if (self->ServerSocket.IsNotNull())
+  {
+    self->ServerSocket->CloseSocket();
+  }
+
+  // Close thread
+  self->ConnectionReceiverThreadId = -1;
+  self->ConnectionActive.Respond = false;
+  return NULL;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkServer::ReceiveClientMessages(ClientData& client)
+{
+  int socketDescriptor = SocketDescriptorAccessor::GetDescriptor(client.ClientSocket);
+  while (!client.SendFailed)
+  {
+    // Receive the header first, then the body that the header announces
+    if (client.ReceivedBytes < client.ReceiveBuffer.size())
+    {
+      ssize_t bytesReceived = recv(socketDescriptor, &client.ReceiveBuffer[client.ReceivedBytes], client.ReceiveBuffer.size() - client.ReceivedBytes, MSG_DONTWAIT);
+      if (bytesReceived == 0)
+      {
+        LOG_DEBUG("Connection of client " << client.ClientId << " is closed.");
+        client.SendFailed = true;
+        return;
+      }
+      if (bytesReceived < 0)
+      {
+        if (errno == EINTR)
+        {
+          continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+          LOG_DEBUG("Failed to receive from client " << client.ClientId << ": " << strerror(errno));
+          client.SendFailed = true;
+        }
+        return;
+      }
+      client.ReceivedBytes += bytesReceived;
+      if (client.ReceivedBytes < client.ReceiveBuffer.size())
+      {
+        continue;
+      }
+    }
+
+    if (client.ReceivedHeader.IsNull())
+    {
+      igtl::MessageHeader::Pointer headerMsg = this->IgtlMessageFactory->CreateHeaderMessage(IGTL_HEADER_VERSION_1);
+      headerMsg->InitBuffer();
+      std::copy(client.ReceiveBuffer.begin(), client.ReceiveBuffer.end(), static_cast<unsigned char*>(headerMsg->GetBufferPointer()));
+      headerMsg->Unpack(this->IgtlMessageCrcCheckEnabled);
+      if (headerMsg->GetBodySizeToRead() > static_cast<igtlUint64>(this->MaxClientMessageBodySizeBytes))
+      {
+        LOG_WARNING("Client " << client.ClientId << " sent a " << headerMsg->GetMessageType() << " message with a " << headerMsg->GetBodySizeToRead()
+                    << " bytes long body, larger than MaxClientMessageBodySizeBytes (" << this->MaxClientMessageBodySizeBytes << "). The client is disconnected.");
+        client.SendFailed = true;
+        return;
+      }
+      client.ReceivedHeader = headerMsg;
+      client.ReceiveBuffer.resize(headerMsg->GetBodySizeToRead());
+      client.ReceivedBytes = 0;
+      if (!client.ReceiveBuffer.empty())
+      {
+        continue;
+      }
+    }
+
+    // Message is complete, prepare for receiving the next header before processing it
+    std::vector<unsigned char> body;
+    body.swap(client.ReceiveBuffer);
+    igtl::MessageHeader::Pointer headerMsg = client.ReceivedHeader;
+    client.ReceivedHeader = NULL;
+    client.ReceiveBuffer.resize(IGTL_HEADER_SIZE);
+    client.ReceivedBytes = 0;
+
+    BufferMessageBodyReader bodyReader(body);
+    if (this->ProcessClientMessage(client, headerMsg, bodyReader) != PLUS_SUCCESS)
+    {
+      client.SendFailed = true;
+      return;
+    }
+  }
 }
\ No newline at end of file
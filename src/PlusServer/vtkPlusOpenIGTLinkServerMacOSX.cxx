@@ -35,4 +35,28 @@ void PrintServerInfo(vtkPlusOpenIGTLinkServer* self)
   }
   ss << " -- port " << self->GetListeningPort();
   LOG_INFO(ss.str());
+}
+
+namespace
+{
+  const bool EVENT_LOOP_AVAILABLE = false;
+}
+
+//----------------------------------------------------------------------------
+void* vtkPlusOpenIGTLinkServer::EventLoopThread(vtkMultiThreader::ThreadInfo* data)
+{
+  // Event loop is not available on this platform, use threads per client
+  return ConnectionReceiverThread(data);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkServer::WakeUpEventLoop()
+{
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkServer::AddClientToEventLoop(ClientData& client)
+{
+  LOG_ERROR("Event loop is not available on this platform.");
+  return PLUS_FAIL;
 }
\ No newline at end of file
@@ -8,6 +8,8 @@ See License.txt for details.
 
 #include "PlusSpatialModel.h"
 
+#include "vtkCellType.h"
+#include "vtkGenericCell.h"
 #include "vtkMath.h"
 #include "vtkMatrix4x4.h"
 #include "vtkModifiedBSPTree.h"
@@ -18,7 +20,9 @@ See License.txt for details.
 #include "vtkProbeFilter.h"
 #include "vtkPointData.h"
 #include "vtkIdList.h"
-#include "vtkTriangle.h"
+#include "vtkPoints.h"
+
+#include <algorithm>
 
 // If fraction of the transmitted beam intensity is smaller then this value then we consider the beam to be completely absorbed
 const double MINIMUM_BEAM_INTENSITY = 1e-9;
@@ -26,6 +30,28 @@ const double MINIMUM_BEAM_INTENSITY = 1e-9;
 // Characterizes the specular reflection BRDF. If the value is smaller then reflection is limited to a smaller angle range (closer to 90deg incidence angle).
 double SPECULAR_REFLECTION_BRDF_STDEV = 30.0;
 
+#if VTK_MAJOR_VERSION < 9 || (VTK_MAJOR_VERSION == 9 && VTK_MINOR_VERSION < 2)
+// Before VTK 9.2 the locator uses an internal cell object for computing line intersections,
+// therefore concurrent line intersection queries have to be serialized.
+#define PLUS_SERIALIZE_LOCATOR_QUERIES
+namespace
+{
+  vtkIGSIORecursiveCriticalSection* GetLocatorQueryMutex()
+  {
+    static vtkSmartPointer<vtkIGSIORecursiveCriticalSection> locatorQueryMutex = vtkSmartPointer<vtkIGSIORecursiveCriticalSection>::New();
+    return locatorQueryMutex;
+  }
+}
+#endif
+
+//-----------------------------------------------------------------------------
+PlusSpatialModel::LineIntersectionScratch::LineIntersectionScratch()
+  : IntersectionPoints_Model(vtkSmartPointer<vtkPoints>::New())
+  , IntersectionCellIds(vtkSmartPointer<vtkIdList>::New())
+  , Cell(vtkSmartPointer<vtkGenericCell>::New())
+{
+}
+
 //-----------------------------------------------------------------------------
 PlusSpatialModel::PlusSpatialModel()
   : Name("")
@@ -44,6 +70,7 @@ PlusSpatialModel::PlusSpatialModel()
   , SurfaceSpecularReflectionCoefficient(0.0)
   , SurfaceDiffuseReflectionCoefficient(0.1)
   , ModelLocalizer(vtkModifiedBSPTree::New())
+  , ModelBvh(new PlusTriangleBvh)
   , PolyData(NULL)
 {
 }
@@ -78,6 +105,7 @@ PlusSpatialModel::PlusSpatialModel(const PlusSpatialModel& model)
   SetModelToObjectTransform(model.ModelToObjectTransform);
   SetReferenceToObjectTransform(model.ReferenceToObjectTransform);
   SetModelLocalizer(model.ModelLocalizer);
+  this->ModelBvh = model.ModelBvh;
   SetPolyData(model.PolyData);
   this->ModelFileNeedsUpdate = model.ModelFileNeedsUpdate;
   this->PrecomputedAttenuations = model.PrecomputedAttenuations;
@@ -101,6 +129,7 @@ void PlusSpatialModel::operator=(const PlusSpatialModel& model)
   SetModelToObjectTransform(model.ModelToObjectTransform);
   SetReferenceToObjectTransform(model.ReferenceToObjectTransform);
   SetModelLocalizer(model.ModelLocalizer);
+  this->ModelBvh = model.ModelBvh;
   SetPolyData(model.PolyData);
   this->ModelFileNeedsUpdate = model.ModelFileNeedsUpdate;
   this->PrecomputedAttenuations = model.PrecomputedAttenuations;
@@ -253,9 +282,8 @@ void PlusSpatialModel::CalculateIntensity(std::vector<double>& reflectedIntensit
   }
 
   // Compute attenuation within this model
-  double intensityAttenuationCoefficientdBPerPixel = this->AttenuationCoefficientDbPerCmMhz * (distanceBetweenScanlineSamplePointsMm / 10.0) * this->ImagingFrequencyMhz;
   // intensityAttenuationCoefficientPerPixel: should be close to 1, as it's the ratio of (transmitted beam intensity / incident beam intensity) after traversing through a single pixel
-  double intensityAttenuationCoefficientPerPixel = pow(10.0, -intensityAttenuationCoefficientdBPerPixel / 10.0);
+  double intensityAttenuationCoefficientPerPixel = GetIntensityAttenuationCoefficientPerPixel(distanceBetweenScanlineSamplePointsMm);
   // intensityAttenuatedFractionPerPixel: how big fraction of the intensity is attenuated during traversing through one voxel
   double intensityAttenuatedFractionPerPixel = (1 - intensityAttenuationCoefficientPerPixel);
   // intensityTransmittedFractionPerPixelTwoWay: how big fraction of the intensity is transmitted during traversing through one voxel; takes into account both propagation directions
@@ -313,8 +341,52 @@ void PlusSpatialModel::CalculateIntensity(std::vector<double>& reflectedIntensit
   // TODO: to simulate beamwidth, take into account the incidence angle and disperse the reflection on a larger area if the angle is large
 }
 
+//-----------------------------------------------------------------------------
+double PlusSpatialModel::GetIntensityAttenuationCoefficientPerPixel(double distanceBetweenScanlineSamplePointsMm)
+{
+  double intensityAttenuationCoefficientdBPerPixel = this->AttenuationCoefficientDbPerCmMhz * (distanceBetweenScanlineSamplePointsMm / 10.0) * this->ImagingFrequencyMhz;
+  return pow(10.0, -intensityAttenuationCoefficientdBPerPixel / 10.0);
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus PlusSpatialModel::PrepareForConcurrentAccess(double distanceBetweenScanlineSamplePointsMm, unsigned int maxNumberOfFilledPixels)
+{
+  UpdateModelFile();
+  if (!this->ModelFile.empty() && this->PolyData == NULL)
+  {
+    LOG_ERROR("Surface model of SpatialModel " << (this->Name.empty() ? "(undefined)" : this->Name) << " is not available");
+    return PLUS_FAIL;
+  }
+
+  // Compute the attenuation table exactly the same way as in CalculateIntensity so that it is not recomputed there
+  double intensityAttenuationCoefficientPerPixel = GetIntensityAttenuationCoefficientPerPixel(distanceBetweenScanlineSamplePointsMm);
+  double intensityTransmittedFractionPerPixelTwoWay = intensityAttenuationCoefficientPerPixel * intensityAttenuationCoefficientPerPixel;
+  if (maxNumberOfFilledPixels > 0
+      && (this->PrecomputedAttenuations.size() < maxNumberOfFilledPixels || intensityTransmittedFractionPerPixelTwoWay != this->PrecomputedAttenuations[0]))
+  {
+    UpdatePrecomputedAttenuations(intensityTransmittedFractionPerPixelTwoWay, maxNumberOfFilledPixels);
+  }
+
+  return PLUS_SUCCESS;
+}
+
 //-----------------------------------------------------------------------------
 void PlusSpatialModel::GetLineIntersections(std::deque<LineIntersectionInfo>& lineIntersections, double* scanLineStartPoint_Reference, double* scanLineEndPoint_Reference)
+{
+  LineIntersectionScratch scratch;
+  GetLineIntersections(lineIntersections, scanLineStartPoint_Reference, scanLineEndPoint_Reference, scratch);
+}
+
+//-----------------------------------------------------------------------------
+void PlusSpatialModel::GetLineIntersections(std::deque<LineIntersectionInfo>& lineIntersections, double* scanLineStartPoint_Reference, double* scanLineEndPoint_Reference,
+    LineIntersectionScratch& scratch)
+{
+  GetLinePacketIntersections(1, &scanLineStartPoint_Reference, &scanLineEndPoint_Reference, &lineIntersections, scratch);
+}
+
+//-----------------------------------------------------------------------------
+void PlusSpatialModel::GetLinePacketIntersections(int numberOfLines, double* const* scanLineStartPoints_Reference, double* const* scanLineEndPoints_Reference,
+    std::deque<LineIntersectionInfo>* lineIntersections, LineIntersectionScratch& scratch)
 {
   UpdateModelFile();
 
@@ -326,59 +398,171 @@ void PlusSpatialModel::GetLineIntersections(std::deque<LineIntersectionInfo>& li
     intersectionInfo.Model = this;
     intersectionInfo.IntersectionIncidenceAngleRad = 0;
     intersectionInfo.IntersectionDistanceFromStartPointMm = 0;
-    lineIntersections.push_back(intersectionInfo);
+    for (int lineIndex = 0; lineIndex < numberOfLines; lineIndex++)
+    {
+      lineIntersections[lineIndex].push_back(intersectionInfo);
+    }
     return;
   }
 
-  // non-normalized direction vector of the scanline
-  double scanLineDirectionVector_Reference[4] =
-  {
-    scanLineEndPoint_Reference[0] - scanLineStartPoint_Reference[0],
-    scanLineEndPoint_Reference[1] - scanLineStartPoint_Reference[1],
-    scanLineEndPoint_Reference[2] - scanLineStartPoint_Reference[2],
-    0
-  };
-  double scanLineDirectionVectorNorm_Reference = vtkMath::Norm(scanLineDirectionVector_Reference);
-  double searchLineStartPoint_Reference[4] = {0, 0, 0, 1};
-  for (int i = 0; i < 3; i++)
+  // Matrices are computed on the stack (instead of creating vtkMatrix4x4 objects) because this method is called
+  // for each scanline packet and model, potentially from multiple threads
+  double objectToModelMatrix[16];
+  vtkMatrix4x4::Invert(this->ModelToObjectTransform->GetData(), objectToModelMatrix);
+  double referenceToModelMatrix[16];
+  vtkMatrix4x4::Multiply4x4(objectToModelMatrix, this->ReferenceToObjectTransform->GetData(), referenceToModelMatrix);
+  double modelToReferenceMatrix[16];
+  vtkMatrix4x4::Invert(referenceToModelMatrix, modelToReferenceMatrix);
+
+  const int packetSize = PlusTriangleBvh::PACKET_SIZE;
+  for (int firstLineIndex = 0; firstLineIndex < numberOfLines; firstLineIndex += packetSize)
   {
-    searchLineStartPoint_Reference[i] = scanLineStartPoint_Reference[i] - this->TransducerSpatialModelMaxOverlapMm * scanLineDirectionVector_Reference[i] / scanLineDirectionVectorNorm_Reference;
-  }
+    const int numberOfLinesInPacket = std::min(packetSize, numberOfLines - firstLineIndex);
+
+    // The intersections are searched from a point before the scanline start point to detect model/transducer overlap
+    double scanLineDirectionVectors_Reference[PlusTriangleBvh::PACKET_SIZE][4];
+    double searchLineStartPoints_Reference[PlusTriangleBvh::PACKET_SIZE][4];
+    double searchLineStartPoints_Model[PlusTriangleBvh::PACKET_SIZE][4];
+    double scanLineEndPoints_Model[PlusTriangleBvh::PACKET_SIZE][4];
+    for (int lineIndexInPacket = 0; lineIndexInPacket < numberOfLinesInPacket; lineIndexInPacket++)
+    {
+      const double* scanLineStartPoint_Reference = scanLineStartPoints_Reference[firstLineIndex + lineIndexInPacket];
+      double* scanLineEndPoint_Reference = scanLineEndPoints_Reference[firstLineIndex + lineIndexInPacket];
+      // non-normalized direction vector of the scanline
+      double* scanLineDirectionVector_Reference = scanLineDirectionVectors_Reference[lineIndexInPacket];
+      for (int i = 0; i < 3; i++)
+      {
+        scanLineDirectionVector_Reference[i] = scanLineEndPoint_Reference[i] - scanLineStartPoint_Reference[i];
+      }
+      scanLineDirectionVector_Reference[3] = 0;
+      double scanLineDirectionVectorNorm_Reference = vtkMath::Norm(scanLineDirectionVector_Reference);
+      double* searchLineStartPoint_Reference = searchLineStartPoints_Reference[lineIndexInPacket];
+      for (int i = 0; i < 3; i++)
+      {
+        searchLineStartPoint_Reference[i] = scanLineStartPoint_Reference[i] - this->TransducerSpatialModelMaxOverlapMm * scanLineDirectionVector_Reference[i] / scanLineDirectionVectorNorm_Reference;
+      }
+      searchLineStartPoint_Reference[3] = 1;
+      vtkMatrix4x4::MultiplyPoint(referenceToModelMatrix, searchLineStartPoint_Reference, searchLineStartPoints_Model[lineIndexInPacket]);
+      vtkMatrix4x4::MultiplyPoint(referenceToModelMatrix, scanLineEndPoint_Reference, scanLineEndPoints_Model[lineIndexInPacket]);
+    }
 
-  vtkSmartPointer<vtkMatrix4x4> objectToModelMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-  vtkMatrix4x4::Invert(this->ModelToObjectTransform, objectToModelMatrix);
-  vtkSmartPointer<vtkMatrix4x4> referenceToModelMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-  vtkMatrix4x4::Multiply4x4(objectToModelMatrix, this->ReferenceToObjectTransform, referenceToModelMatrix);
+    if (!this->ModelBvh->IsEmpty())
+    {
+      PlusTriangleBvh::RayPacket rays;
+      rays.NumberOfRays = numberOfLinesInPacket;
+      for (int lineIndexInPacket = 0; lineIndexInPacket < numberOfLinesInPacket; lineIndexInPacket++)
+      {
+        for (int i = 0; i < 3; i++)
+        {
+          rays.Origin[i][lineIndexInPacket] = searchLineStartPoints_Model[lineIndexInPacket][i];
+          rays.Direction[i][lineIndexInPacket] = scanLineEndPoints_Model[lineIndexInPacket][i] - searchLineStartPoints_Model[lineIndexInPacket][i];
+        }
+      }
+      this->ModelBvh->IntersectPacket(rays, scratch.BvhHits);
 
-  double searchLineStartPoint_Model[4] = {0, 0, 0, 1};
-  double scanLineEndPoint_Model[4] = {0, 0, 0, 1};
-  referenceToModelMatrix->MultiplyPoint(searchLineStartPoint_Reference, searchLineStartPoint_Model);
-  referenceToModelMatrix->MultiplyPoint(scanLineEndPoint_Reference, scanLineEndPoint_Model);
+      for (int lineIndexInPacket = 0; lineIndexInPacket < numberOfLinesInPacket; lineIndexInPacket++)
+      {
+        const std::vector<PlusTriangleBvh::RayHit>& hits = scratch.BvhHits.Hits[lineIndexInPacket];
+        std::vector<SurfaceIntersection>& surfaceIntersections = scratch.SurfaceIntersections;
+        surfaceIntersections.resize(hits.size());
+        for (size_t hitIndex = 0; hitIndex < hits.size(); hitIndex++)
+        {
+          const PlusTriangleBvh::RayHit& hit = hits[hitIndex];
+          SurfaceIntersection& surfaceIntersection = surfaceIntersections[hitIndex];
+          for (int i = 0; i < 3; i++)
+          {
+            // Intersection points are rounded to single precision, as the points returned by the locator are (vtkPoints stores float values),
+            // so that the simulated images do not depend on which method is used for computing the intersections
+            surfaceIntersection.Point_Model[i] = static_cast<float>(rays.Origin[i][lineIndexInPacket] + hit.T * rays.Direction[i][lineIndexInPacket]);
+          }
+          surfaceIntersection.Point_Model[3] = 1;
+          surfaceIntersection.IsTriangle = true;
+          // Weights are computed from the rounded point the same way as for the intersections found by the locator
+          vtkGenericCell* cell = scratch.Cell;
+          this->PolyData->GetCell(this->ModelBvh->GetTriangleCellId(hit.TriangleIndex), cell);
+          double pcoords[3] = {0, 0, 0};
+          double dist2 = 0;
+          double closestPoint[3] = {0, 0, 0};
+          int subId = 0;
+          cell->EvaluatePosition(surfaceIntersection.Point_Model, closestPoint, subId, pcoords, dist2, surfaceIntersection.Weights);
+          for (int pointIndex = 0; pointIndex < 3; pointIndex++)
+          {
+            surfaceIntersection.PointIds[pointIndex] = cell->GetPointId(pointIndex);
+          }
+        }
+        AddSurfaceIntersections(lineIntersections[firstLineIndex + lineIndexInPacket], surfaceIntersections, scanLineStartPoints_Reference[firstLineIndex + lineIndexInPacket],
+                                searchLineStartPoints_Reference[lineIndexInPacket], scanLineDirectionVectors_Reference[lineIndexInPacket], referenceToModelMatrix, modelToReferenceMatrix);
+      }
+    }
+    else
+    {
+      // The surface is not made of triangles, the locator is used for computing the intersections of each line
+      for (int lineIndexInPacket = 0; lineIndexInPacket < numberOfLinesInPacket; lineIndexInPacket++)
+      {
+        vtkPoints* intersectionPoints_Model = scratch.IntersectionPoints_Model;
+        vtkIdList* intersectionCellIds = scratch.IntersectionCellIds;
+        intersectionPoints_Model->Reset();
+        intersectionCellIds->Reset();
+        {
+#ifdef PLUS_SERIALIZE_LOCATOR_QUERIES
+          igsioLockGuard<vtkIGSIORecursiveCriticalSection> locatorQueryGuard(GetLocatorQueryMutex());
+          this->ModelLocalizer->IntersectWithLine(searchLineStartPoints_Model[lineIndexInPacket], scanLineEndPoints_Model[lineIndexInPacket], 0.0, intersectionPoints_Model, intersectionCellIds);
+#else
+          this->ModelLocalizer->IntersectWithLine(searchLineStartPoints_Model[lineIndexInPacket], scanLineEndPoints_Model[lineIndexInPacket], 0.0, intersectionPoints_Model, intersectionCellIds, scratch.Cell);
+#endif
+        }
 
-  vtkSmartPointer<vtkPoints> intersectionPoints_Model = vtkSmartPointer<vtkPoints>::New();
-  vtkSmartPointer<vtkIdList> intersectionCellIds = vtkSmartPointer<vtkIdList>::New();
-  this->ModelLocalizer->IntersectWithLine(searchLineStartPoint_Model, scanLineEndPoint_Model, 0.0, intersectionPoints_Model, intersectionCellIds);
+        std::vector<SurfaceIntersection>& surfaceIntersections = scratch.SurfaceIntersections;
+        surfaceIntersections.resize(intersectionPoints_Model->GetNumberOfPoints());
+        for (vtkIdType intersectionPointIndex = 0; intersectionPointIndex < intersectionPoints_Model->GetNumberOfPoints(); intersectionPointIndex++)
+        {
+          SurfaceIntersection& surfaceIntersection = surfaceIntersections[intersectionPointIndex];
+          intersectionPoints_Model->GetPoint(intersectionPointIndex, surfaceIntersection.Point_Model);
+          surfaceIntersection.Point_Model[3] = 1;
+          // The cell is retrieved into the per-thread generic cell, as vtkPolyData::GetCell(cellId) would return an object that is shared between threads
+          vtkGenericCell* cell = scratch.Cell;
+          this->PolyData->GetCell(intersectionCellIds->GetId(intersectionPointIndex), cell);
+          surfaceIntersection.IsTriangle = (cell->GetCellType() == VTK_TRIANGLE);
+          if (surfaceIntersection.IsTriangle)
+          {
+            double pcoords[3] = {0, 0, 0};
+            double dist2 = 0;
+            double closestPoint[3] = {0, 0, 0};
+            int subId = 0;
+            cell->EvaluatePosition(surfaceIntersection.Point_Model, closestPoint, subId, pcoords, dist2, surfaceIntersection.Weights);
+            for (int pointIndex = 0; pointIndex < 3; pointIndex++)
+            {
+              surfaceIntersection.PointIds[pointIndex] = cell->GetPointId(pointIndex);
+            }
+          }
+        }
+        AddSurfaceIntersections(lineIntersections[firstLineIndex + lineIndexInPacket], surfaceIntersections, scanLineStartPoints_Reference[firstLineIndex + lineIndexInPacket],
+                                searchLineStartPoints_Reference[lineIndexInPacket], scanLineDirectionVectors_Reference[lineIndexInPacket], referenceToModelMatrix, modelToReferenceMatrix);
+      }
+    }
+  }
+}
 
-  if (intersectionPoints_Model->GetNumberOfPoints() < 1)
+//-----------------------------------------------------------------------------
+void PlusSpatialModel::AddSurfaceIntersections(std::deque<LineIntersectionInfo>& lineIntersections, const std::vector<SurfaceIntersection>& surfaceIntersections,
+    double* scanLineStartPoint_Reference, double* searchLineStartPoint_Reference, double* scanLineDirectionVector_Reference,
+    double* referenceToModelMatrix, double* modelToReferenceMatrix)
+{
+  if (surfaceIntersections.empty())
   {
     // no intersections with this model
     return;
   }
 
-  vtkSmartPointer<vtkMatrix4x4> modelToReferenceMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-  vtkMatrix4x4::Invert(referenceToModelMatrix, modelToReferenceMatrix);
-
   // Measure the distance from the starting point in the reference coordinate system
-  double intersectionPoint_Model[4] = {0, 0, 0, 1};
   double intersectionPoint_Reference[4] = {0, 0, 0, 1};
-  int intersectionPointIndex = 0;
+  size_t intersectionPointIndex = 0;
   bool scanLineStartPointInsideModel = false;
   // Search for intersection points in the search line that are not part of the scanline to detect
   // potential model/transducer overlap
-  for (; intersectionPointIndex < intersectionPoints_Model->GetNumberOfPoints(); intersectionPointIndex++)
+  for (; intersectionPointIndex < surfaceIntersections.size(); intersectionPointIndex++)
   {
-    intersectionPoints_Model->GetPoint(intersectionPointIndex, intersectionPoint_Model);
-    modelToReferenceMatrix->MultiplyPoint(intersectionPoint_Model, intersectionPoint_Reference);
+    vtkMatrix4x4::MultiplyPoint(modelToReferenceMatrix, surfaceIntersections[intersectionPointIndex].Point_Model, intersectionPoint_Reference);
     double intersectionDistanceFromSearchLineStartPointMm = sqrt(vtkMath::Distance2BetweenPoints(searchLineStartPoint_Reference, intersectionPoint_Reference));
     if (intersectionDistanceFromSearchLineStartPointMm <= this->TransducerSpatialModelMaxOverlapMm)
     {
@@ -408,36 +592,24 @@ void PlusSpatialModel::GetLineIntersections(std::deque<LineIntersectionInfo>& li
   }
 
   double scanLineDirectionVector_Model[4] = {0, 0, 0, 0};
-  referenceToModelMatrix->MultiplyPoint(scanLineDirectionVector_Reference, scanLineDirectionVector_Model);
+  vtkMatrix4x4::MultiplyPoint(referenceToModelMatrix, scanLineDirectionVector_Reference, scanLineDirectionVector_Model);
   vtkMath::Normalize(scanLineDirectionVector_Model);
 
-  for (; intersectionPointIndex < intersectionPoints_Model->GetNumberOfPoints(); intersectionPointIndex++)
+  for (; intersectionPointIndex < surfaceIntersections.size(); intersectionPointIndex++)
   {
-    intersectionPoints_Model->GetPoint(intersectionPointIndex, intersectionPoint_Model);
-    modelToReferenceMatrix->MultiplyPoint(intersectionPoint_Model, intersectionPoint_Reference);
+    const SurfaceIntersection& surfaceIntersection = surfaceIntersections[intersectionPointIndex];
+    vtkMatrix4x4::MultiplyPoint(modelToReferenceMatrix, surfaceIntersection.Point_Model, intersectionPoint_Reference);
     intersectionInfo.IntersectionDistanceFromStartPointMm = sqrt(vtkMath::Distance2BetweenPoints(scanLineStartPoint_Reference, intersectionPoint_Reference));
-    vtkTriangle* cell = vtkTriangle::SafeDownCast(this->PolyData->GetCell(intersectionCellIds->GetId(intersectionPointIndex)));
-    if (cell != NULL && normals_Model != NULL)
+    if (surfaceIntersection.IsTriangle && normals_Model != NULL)
     {
-      const int NUMBER_OF_POINTS_PER_CELL = 3; // triangle cell
-      double pcoords[NUMBER_OF_POINTS_PER_CELL] = {0, 0, 0};
-      double dist2 = 0;
-      double weights[NUMBER_OF_POINTS_PER_CELL] = {0, 0, 0};
-      double closestPoint[3] = {0, 0, 0};
-      int subId = 0;
-      cell->EvaluatePosition(intersectionPoint_Model, closestPoint, subId, pcoords, dist2, weights);
       double interpolatedNormal_Model[3] = {0, 0, 0};
-      for (int pointIndex = 0; pointIndex < NUMBER_OF_POINTS_PER_CELL; pointIndex++)
+      for (int pointIndex = 0; pointIndex < 3; pointIndex++)
       {
-        double* normalAtCellCorner = normals_Model->GetTuple3(cell->GetPointId(pointIndex));
-        if (normalAtCellCorner == NULL)
-        {
-          LOG_ERROR("SpatialModel::GetLineIntersections error: invalid normal");
-          continue;
-        }
-        interpolatedNormal_Model[0] += normalAtCellCorner[0] * weights[pointIndex];
-        interpolatedNormal_Model[1] += normalAtCellCorner[1] * weights[pointIndex];
-        interpolatedNormal_Model[2] += normalAtCellCorner[2] * weights[pointIndex];
+        double normalAtCellCorner[3] = {0, 0, 0};
+        normals_Model->GetTuple(surfaceIntersection.PointIds[pointIndex], normalAtCellCorner);
+        interpolatedNormal_Model[0] += normalAtCellCorner[0] * surfaceIntersection.Weights[pointIndex];
+        interpolatedNormal_Model[1] += normalAtCellCorner[1] * surfaceIntersection.Weights[pointIndex];
+        interpolatedNormal_Model[2] += normalAtCellCorner[2] * surfaceIntersection.Weights[pointIndex];
       }
       vtkMath::Normalize(interpolatedNormal_Model);
       intersectionInfo.IntersectionIncidenceAngleRad = acos(vtkMath::Dot(interpolatedNormal_Model, scanLineDirectionVector_Model));
@@ -512,10 +684,16 @@ PlusStatus PlusSpatialModel::UpdateModelFile()
   this->PolyData = polyDataNormalsComputer->GetOutput();
   this->PolyData->Register(NULL);
 
-  this->ModelLocalizer->SetDataSet(this->PolyData);
-  this->ModelLocalizer->SetMaxLevel(24);
-  this->ModelLocalizer->SetNumberOfCellsPerNode(32);
-  this->ModelLocalizer->BuildLocator();
+  // The triangle hierarchy is used for computing line intersections. If the surface contains other cells than triangles
+  // then the hierarchy cannot be built and the (slower) locator is used instead.
+  if (this->ModelBvh->Build(this->PolyData) != PLUS_SUCCESS || this->ModelBvh->IsEmpty())
+  {
+    this->ModelBvh->Clear();
+    this->ModelLocalizer->SetDataSet(this->PolyData);
+    this->ModelLocalizer->SetMaxLevel(24);
+    this->ModelLocalizer->SetNumberOfCellsPerNode(32);
+    this->ModelLocalizer->BuildLocator();
+  }
 
   return PLUS_SUCCESS;
 }
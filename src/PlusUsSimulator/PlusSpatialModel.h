@@ -11,8 +11,16 @@
 
 #include "vtkPlusUsSimulatorExport.h"
 
+#include "PlusTriangleBvh.h"
+#include "vtkSmartPointer.h"
+
+#include <memory>
+
+class vtkGenericCell;
+class vtkIdList;
 class vtkMatrix4x4;
 class vtkModifiedBSPTree;
+class vtkPoints;
 class vtkPolyData;
 
 /*!
@@ -38,6 +46,33 @@ public:
     double IntersectionIncidenceAngleRad;
   };
 
+  /*! Intersection of a line and the model surface */
+  struct SurfaceIntersection
+  {
+    /*! Intersection point in the Model coordinate system (homogeneous coordinates) */
+    double Point_Model[4];
+    /*! True if the intersected cell is a triangle. PointIds and Weights are only valid for triangles. */
+    bool IsTriangle;
+    /*! Point IDs of the triangle corners */
+    vtkIdType PointIds[3];
+    /*! Interpolation weights of the triangle corners at the intersection point */
+    double Weights[3];
+  };
+
+  /*!
+    Temporary objects used for computing line intersections. They are kept between calls to avoid reallocations.
+    Threads that compute line intersections concurrently must use separate instances.
+  */
+  struct LineIntersectionScratch
+  {
+    LineIntersectionScratch();
+    vtkSmartPointer<vtkPoints> IntersectionPoints_Model;
+    vtkSmartPointer<vtkIdList> IntersectionCellIds;
+    vtkSmartPointer<vtkGenericCell> Cell;
+    PlusTriangleBvh::PacketHits BvhHits;
+    std::vector<SurfaceIntersection> SurfaceIntersections;
+  };
+
   PlusSpatialModel();
   virtual ~PlusSpatialModel();
 
@@ -72,6 +107,30 @@ public:
   */
   void GetLineIntersections(std::deque<LineIntersectionInfo>& lineIntersections, double* scanLineStartPoint_Reference, double* scanLineEndPoint_Reference);
 
+  /*!
+    Get all the intersection points of the model and a line, using the provided temporary objects.
+    It can be called concurrently from multiple threads (each using a separate scratch object) after PrepareForConcurrentAccess is called.
+  */
+  void GetLineIntersections(std::deque<LineIntersectionInfo>& lineIntersections, double* scanLineStartPoint_Reference, double* scanLineEndPoint_Reference,
+                            LineIntersectionScratch& scratch);
+
+  /*!
+    Get all the intersection points of the model and multiple lines. The lines are intersected with the model
+    in packets of PlusTriangleBvh::PACKET_SIZE, which is much faster than computing the intersections of each line separately
+    if the lines are close to each other (such as neighbor scanlines).
+    The results of line i are appended to lineIntersections[i].
+    It can be called concurrently from multiple threads (each using a separate scratch object) after PrepareForConcurrentAccess is called.
+  */
+  void GetLinePacketIntersections(int numberOfLines, double* const* scanLineStartPoints_Reference, double* const* scanLineEndPoints_Reference,
+                                  std::deque<LineIntersectionInfo>* lineIntersections, LineIntersectionScratch& scratch);
+
+  /*!
+    Load the model file, build the surface locator and the attenuation lookup table if they are not up-to-date.
+    After this GetLineIntersections and CalculateIntensity (for at most maxNumberOfFilledPixels pixels with the same sample distance)
+    do not modify the model, so they can be called concurrently from multiple threads.
+  */
+  PlusStatus PrepareForConcurrentAccess(double distanceBetweenScanlineSamplePointsMm, unsigned int maxNumberOfFilledPixels);
+
   double GetAcousticImpedanceMegarayls();
 
   /*!
@@ -99,6 +158,14 @@ protected:
   void SetModelToObjectTransform(double* matrixElements);
 
   PlusStatus UpdateModelFile();
+
+  /*! Compute the line intersections (in Reference coordinate system) from the surface intersection points (in Model coordinate system) */
+  void AddSurfaceIntersections(std::deque<LineIntersectionInfo>& lineIntersections, const std::vector<SurfaceIntersection>& surfaceIntersections,
+                               double* scanLineStartPoint_Reference, double* searchLineStartPoint_Reference, double* scanLineDirectionVector_Reference,
+                               double* referenceToModelMatrix, double* modelToReferenceMatrix);
+
+  /*! Ratio of transmitted and incident beam intensity after traversing through a single pixel */
+  double GetIntensityAttenuationCoefficientPerPixel(double distanceBetweenScanlineSamplePointsMm);
   void UpdatePrecomputedAttenuations(double intensityTransmittedFractionPerPixelTwoWay, int numberOfElements);
 
 protected:
@@ -184,8 +251,12 @@ protected:
   */
   double SurfaceDiffuseReflectionCoefficient;
 
+  /*! Locator for computing line intersections. Only used if the surface contains non-triangle cells (otherwise ModelBvh is used). */
   vtkModifiedBSPTree* ModelLocalizer;
 
+  /*! Hierarchy of the surface triangles for fast computation of line intersections. Shared between copies of the model, similarly to ModelLocalizer. */
+  std::shared_ptr<PlusTriangleBvh> ModelBvh;
+
   /*! Surface mesh. Points are stored in the Model coordinate system (as in the input file) */
   vtkPolyData* PolyData;
 
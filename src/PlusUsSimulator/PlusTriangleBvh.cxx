@@ -0,0 +1,493 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "PlusTriangleBvh.h"
+
+#include "vtkCellType.h"
+#include "vtkIdList.h"
+#include "vtkPoints.h"
+#include "vtkPolyData.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+  /*! Nodes with at most this many triangles are not split */
+  const int MAX_TRIANGLES_PER_LEAF = 4;
+
+  /*! Number of bins used for evaluating the surface area heuristic along the split axis */
+  const int NUMBER_OF_SAH_BINS = 16;
+
+  /*! Relative cost of visiting a node compared to intersecting a triangle */
+  const double NODE_TRAVERSAL_COST = 1.0;
+
+  /*! Nodes are not split below this depth, which limits the size of the traversal stack */
+  const int MAX_TREE_DEPTH = 60;
+
+  /*!
+    Node bounding boxes are enlarged by this fraction of the mesh size, so that rounding errors in the
+    box test cannot reject a segment that intersects a triangle (box tests are only used for culling).
+  */
+  const double BOUNDS_TOLERANCE_RELATIVE = 1e-7;
+
+  /*! Used instead of 1/0 in the box test, so that no NaN is produced if the segment starts on a box face */
+  const double LARGE_INVERSE_DIRECTION = 1e30;
+
+  //----------------------------------------------------------------------------
+  double GetHalfSurfaceArea(const double boundsMin[3], const double boundsMax[3])
+  {
+    double size[3] = { boundsMax[0] - boundsMin[0], boundsMax[1] - boundsMin[1], boundsMax[2] - boundsMin[2] };
+    return size[0] * size[1] + size[1] * size[2] + size[2] * size[0];
+  }
+
+  //----------------------------------------------------------------------------
+  void InitializeBounds(double boundsMin[3], double boundsMax[3])
+  {
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      boundsMin[axis] = VTK_DOUBLE_MAX;
+      boundsMax[axis] = -VTK_DOUBLE_MAX;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void ExtendBounds(double boundsMin[3], double boundsMax[3], const double otherMin[3], const double otherMax[3])
+  {
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      boundsMin[axis] = std::min(boundsMin[axis], otherMin[axis]);
+      boundsMax[axis] = std::max(boundsMax[axis], otherMax[axis]);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  bool RayHitLessThan(const PlusTriangleBvh::RayHit& a, const PlusTriangleBvh::RayHit& b)
+  {
+    return a.T < b.T;
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusTriangleBvh::RayPacket::RayPacket()
+  : NumberOfRays(0)
+{
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    std::fill(this->Origin[axis], this->Origin[axis] + PACKET_SIZE, 0.0);
+    std::fill(this->Direction[axis], this->Direction[axis] + PACKET_SIZE, 0.0);
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusTriangleBvh::PlusTriangleBvh()
+{
+}
+
+//----------------------------------------------------------------------------
+void PlusTriangleBvh::Clear()
+{
+  this->Nodes.clear();
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    this->Vertex0[axis].clear();
+    this->Edge1[axis].clear();
+    this->Edge2[axis].clear();
+  }
+  this->CellIds.clear();
+  this->PointIds.clear();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusTriangleBvh::Build(vtkPolyData* polyData)
+{
+  Clear();
+  if (polyData == NULL)
+  {
+    LOG_ERROR("PlusTriangleBvh::Build failed: input polydata is invalid");
+    return PLUS_FAIL;
+  }
+
+  std::vector<double> vertices;
+  std::vector<vtkIdType> cellIds;
+  std::vector<vtkIdType> pointIds;
+  vertices.reserve(9 * polyData->GetNumberOfCells());
+  cellIds.reserve(polyData->GetNumberOfCells());
+  pointIds.reserve(3 * polyData->GetNumberOfCells());
+
+  vtkSmartPointer<vtkIdList> cellPointIds = vtkSmartPointer<vtkIdList>::New();
+  double point[3] = { 0, 0, 0 };
+  for (vtkIdType cellId = 0; cellId < polyData->GetNumberOfCells(); ++cellId)
+  {
+    int cellType = polyData->GetCellType(cellId);
+    if (cellType == VTK_EMPTY_CELL || cellType == VTK_VERTEX || cellType == VTK_POLY_VERTEX || cellType == VTK_LINE || cellType == VTK_POLY_LINE)
+    {
+      // a line segment does not intersect these cells (except in degenerate cases)
+      continue;
+    }
+    if (cellType != VTK_TRIANGLE)
+    {
+      LOG_DEBUG("PlusTriangleBvh::Build: mesh contains non-triangle cells (cell type: " << cellType << ")");
+      return PLUS_FAIL;
+    }
+    polyData->GetCellPoints(cellId, cellPointIds);
+    for (int cornerIndex = 0; cornerIndex < 3; ++cornerIndex)
+    {
+      polyData->GetPoint(cellPointIds->GetId(cornerIndex), point);
+      vertices.insert(vertices.end(), point, point + 3);
+      pointIds.push_back(cellPointIds->GetId(cornerIndex));
+    }
+    cellIds.push_back(cellId);
+  }
+
+  Build(static_cast<int>(cellIds.size()), vertices.empty() ? NULL : &vertices[0], cellIds.empty() ? NULL : &cellIds[0], pointIds.empty() ? NULL : &pointIds[0]);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void PlusTriangleBvh::Build(int numberOfTriangles, const double* vertices, const vtkIdType* cellIds, const vtkIdType* pointIds)
+{
+  Clear();
+  if (numberOfTriangles <= 0)
+  {
+    return;
+  }
+
+  std::vector<BuildTriangle> triangles(numberOfTriangles);
+  double meshMin[3];
+  double meshMax[3];
+  InitializeBounds(meshMin, meshMax);
+  for (int triangleIndex = 0; triangleIndex < numberOfTriangles; ++triangleIndex)
+  {
+    BuildTriangle& triangle = triangles[triangleIndex];
+    const double* corners = vertices + 9 * triangleIndex;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      triangle.BoundsMin[axis] = std::min(corners[axis], std::min(corners[3 + axis], corners[6 + axis]));
+      triangle.BoundsMax[axis] = std::max(corners[axis], std::max(corners[3 + axis], corners[6 + axis]));
+      triangle.Centroid[axis] = (corners[axis] + corners[3 + axis] + corners[6 + axis]) / 3.0;
+    }
+    triangle.InputIndex = triangleIndex;
+    ExtendBounds(meshMin, meshMax, triangle.BoundsMin, triangle.BoundsMax);
+  }
+
+  // Nodes are appended during the build, reserve the maximum number of nodes to avoid reallocations
+  this->Nodes.reserve(2 * numberOfTriangles);
+  this->Nodes.resize(1);
+  BuildNode(0, triangles, 0, numberOfTriangles, 0);
+
+  // Enlarge all boxes by the same small amount to make the culling conservative
+  double tolerance = BOUNDS_TOLERANCE_RELATIVE * std::max(meshMax[0] - meshMin[0], std::max(meshMax[1] - meshMin[1], meshMax[2] - meshMin[2]));
+  for (std::vector<Node>::iterator nodeIt = this->Nodes.begin(); nodeIt != this->Nodes.end(); ++nodeIt)
+  {
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      nodeIt->BoundsMin[axis] -= tolerance;
+      nodeIt->BoundsMax[axis] += tolerance;
+    }
+  }
+
+  // Store triangles in leaf order
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    this->Vertex0[axis].resize(numberOfTriangles);
+    this->Edge1[axis].resize(numberOfTriangles);
+    this->Edge2[axis].resize(numberOfTriangles);
+  }
+  this->CellIds.resize(numberOfTriangles);
+  this->PointIds.resize(3 * numberOfTriangles);
+  for (int triangleIndex = 0; triangleIndex < numberOfTriangles; ++triangleIndex)
+  {
+    int inputIndex = triangles[triangleIndex].InputIndex;
+    const double* corners = vertices + 9 * inputIndex;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      this->Vertex0[axis][triangleIndex] = corners[axis];
+      this->Edge1[axis][triangleIndex] = corners[3 + axis] - corners[axis];
+      this->Edge2[axis][triangleIndex] = corners[6 + axis] - corners[axis];
+    }
+    this->CellIds[triangleIndex] = cellIds[inputIndex];
+    for (int cornerIndex = 0; cornerIndex < 3; ++cornerIndex)
+    {
+      this->PointIds[3 * triangleIndex + cornerIndex] = pointIds[3 * inputIndex + cornerIndex];
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void PlusTriangleBvh::BuildNode(int nodeIndex, std::vector<BuildTriangle>& triangles, int firstTriangle, int numberOfTriangles, int depth)
+{
+  double boundsMin[3];
+  double boundsMax[3];
+  double centroidMin[3];
+  double centroidMax[3];
+  InitializeBounds(boundsMin, boundsMax);
+  InitializeBounds(centroidMin, centroidMax);
+  for (int triangleIndex = firstTriangle; triangleIndex < firstTriangle + numberOfTriangles; ++triangleIndex)
+  {
+    ExtendBounds(boundsMin, boundsMax, triangles[triangleIndex].BoundsMin, triangles[triangleIndex].BoundsMax);
+    ExtendBounds(centroidMin, centroidMax, triangles[triangleIndex].Centroid, triangles[triangleIndex].Centroid);
+  }
+  {
+    Node& node = this->Nodes[nodeIndex];
+    std::copy(boundsMin, boundsMin + 3, node.BoundsMin);
+    std::copy(boundsMax, boundsMax + 3, node.BoundsMax);
+    node.FirstChildOrTriangle = firstTriangle;
+    node.NumberOfTriangles = numberOfTriangles;
+  }
+
+  if (numberOfTriangles <= MAX_TRIANGLES_PER_LEAF || depth >= MAX_TREE_DEPTH)
+  {
+    return;
+  }
+
+  // Split along the axis where the centroids are spread the most
+  int splitAxis = 0;
+  for (int axis = 1; axis < 3; ++axis)
+  {
+    if (centroidMax[axis] - centroidMin[axis] > centroidMax[splitAxis] - centroidMin[splitAxis])
+    {
+      splitAxis = axis;
+    }
+  }
+  double centroidExtent = centroidMax[splitAxis] - centroidMin[splitAxis];
+  if (centroidExtent <= 0)
+  {
+    // all centroids are at the same position, triangles cannot be separated
+    return;
+  }
+
+  // Evaluate the surface area heuristic at the bin boundaries
+  int binTriangleCount[NUMBER_OF_SAH_BINS] = { 0 };
+  double binMin[NUMBER_OF_SAH_BINS][3];
+  double binMax[NUMBER_OF_SAH_BINS][3];
+  for (int binIndex = 0; binIndex < NUMBER_OF_SAH_BINS; ++binIndex)
+  {
+    InitializeBounds(binMin[binIndex], binMax[binIndex]);
+  }
+  const double binScale = NUMBER_OF_SAH_BINS / centroidExtent;
+  for (int triangleIndex = firstTriangle; triangleIndex < firstTriangle + numberOfTriangles; ++triangleIndex)
+  {
+    int binIndex = std::min(NUMBER_OF_SAH_BINS - 1, static_cast<int>((triangles[triangleIndex].Centroid[splitAxis] - centroidMin[splitAxis]) * binScale));
+    binTriangleCount[binIndex]++;
+    ExtendBounds(binMin[binIndex], binMax[binIndex], triangles[triangleIndex].BoundsMin, triangles[triangleIndex].BoundsMax);
+  }
+
+  // Cost of the splits sweeping from the right: area and count of bins >= split index
+  double rightArea[NUMBER_OF_SAH_BINS] = { 0 };
+  int rightCount[NUMBER_OF_SAH_BINS] = { 0 };
+  double sweepMin[3];
+  double sweepMax[3];
+  InitializeBounds(sweepMin, sweepMax);
+  int sweepCount = 0;
+  for (int binIndex = NUMBER_OF_SAH_BINS - 1; binIndex > 0; --binIndex)
+  {
+    if (binTriangleCount[binIndex] > 0)
+    {
+      ExtendBounds(sweepMin, sweepMax, binMin[binIndex], binMax[binIndex]);
+      sweepCount += binTriangleCount[binIndex];
+    }
+    rightCount[binIndex] = sweepCount;
+    rightArea[binIndex] = (sweepCount > 0 ? GetHalfSurfaceArea(sweepMin, sweepMax) : 0.0);
+  }
+
+  int bestSplitBin = -1;
+  double bestCost = VTK_DOUBLE_MAX;
+  InitializeBounds(sweepMin, sweepMax);
+  sweepCount = 0;
+  for (int splitBin = 1; splitBin < NUMBER_OF_SAH_BINS; ++splitBin)
+  {
+    if (binTriangleCount[splitBin - 1] > 0)
+    {
+      ExtendBounds(sweepMin, sweepMax, binMin[splitBin - 1], binMax[splitBin - 1]);
+      sweepCount += binTriangleCount[splitBin - 1];
+    }
+    if (sweepCount == 0 || rightCount[splitBin] == 0)
+    {
+      continue;
+    }
+    double cost = sweepCount * GetHalfSurfaceArea(sweepMin, sweepMax) + rightCount[splitBin] * rightArea[splitBin];
+    if (cost < bestCost)
+    {
+      bestCost = cost;
+      bestSplitBin = splitBin;
+    }
+  }
+
+  int numberOfLeftTriangles = 0;
+  double nodeArea = GetHalfSurfaceArea(boundsMin, boundsMax);
+  if (bestSplitBin > 0 && (nodeArea <= 0 || NODE_TRAVERSAL_COST + bestCost / nodeArea < numberOfTriangles))
+  {
+    BuildTriangle* middle = std::partition(&triangles[firstTriangle], &triangles[firstTriangle] + numberOfTriangles,
+                                           [&](const BuildTriangle & triangle)
+    {
+      return std::min(NUMBER_OF_SAH_BINS - 1, static_cast<int>((triangle.Centroid[splitAxis] - centroidMin[splitAxis]) * binScale)) < bestSplitBin;
+    });
+    numberOfLeftTriangles = static_cast<int>(middle - &triangles[firstTriangle]);
+  }
+  else if (numberOfTriangles > 4 * MAX_TRIANGLES_PER_LEAF)
+  {
+    // Splitting is not worth it according to the heuristic, but very large leaves are still avoided by a median split
+    numberOfLeftTriangles = numberOfTriangles / 2;
+    std::nth_element(&triangles[firstTriangle], &triangles[firstTriangle] + numberOfLeftTriangles, &triangles[firstTriangle] + numberOfTriangles,
+                     [&](const BuildTriangle & a, const BuildTriangle & b) { return a.Centroid[splitAxis] < b.Centroid[splitAxis]; });
+  }
+  if (numberOfLeftTriangles <= 0 || numberOfLeftTriangles >= numberOfTriangles)
+  {
+    return;
+  }
+
+  int firstChildIndex = static_cast<int>(this->Nodes.size());
+  this->Nodes.resize(firstChildIndex + 2);
+  this->Nodes[nodeIndex].FirstChildOrTriangle = firstChildIndex;
+  this->Nodes[nodeIndex].NumberOfTriangles = 0;
+  BuildNode(firstChildIndex, triangles, firstTriangle, numberOfLeftTriangles, depth + 1);
+  BuildNode(firstChildIndex + 1, triangles, firstTriangle + numberOfLeftTriangles, numberOfTriangles - numberOfLeftTriangles, depth + 1);
+}
+
+//----------------------------------------------------------------------------
+void PlusTriangleBvh::IntersectPacket(const RayPacket& rays, PacketHits& hits) const
+{
+  const int numberOfRays = (rays.NumberOfRays < 0 ? 0 : (rays.NumberOfRays > PACKET_SIZE ? static_cast<int>(PACKET_SIZE) : rays.NumberOfRays));
+  for (int rayIndex = 0; rayIndex < numberOfRays; ++rayIndex)
+  {
+    hits.Hits[rayIndex].clear();
+  }
+  if (this->Nodes.empty() || numberOfRays == 0)
+  {
+    return;
+  }
+
+  // Unused lanes repeat the first segment, so that all lanes contain valid numbers. Their hits are not stored.
+  double origin[3][PACKET_SIZE];
+  double direction[3][PACKET_SIZE];
+  double inverseDirection[3][PACKET_SIZE];
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    for (int lane = 0; lane < PACKET_SIZE; ++lane)
+    {
+      int rayIndex = (lane < numberOfRays ? lane : 0);
+      origin[axis][lane] = rays.Origin[axis][rayIndex];
+      direction[axis][lane] = rays.Direction[axis][rayIndex];
+      inverseDirection[axis][lane] = (direction[axis][lane] != 0 ? 1.0 / direction[axis][lane] : LARGE_INVERSE_DIRECTION);
+    }
+  }
+
+  int nodeStack[MAX_TREE_DEPTH + 2];
+  int nodeStackSize = 0;
+  nodeStack[nodeStackSize++] = 0;
+  while (nodeStackSize > 0)
+  {
+    const Node& node = this->Nodes[nodeStack[--nodeStackSize]];
+
+    // Slab test of all segments, the node is visited if any segment intersects the box
+    double entryT[PACKET_SIZE];
+    double exitT[PACKET_SIZE];
+    for (int lane = 0; lane < PACKET_SIZE; ++lane)
+    {
+      entryT[lane] = 0.0;
+      exitT[lane] = 1.0;
+    }
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      for (int lane = 0; lane < PACKET_SIZE; ++lane)
+      {
+        double t1 = (node.BoundsMin[axis] - origin[axis][lane]) * inverseDirection[axis][lane];
+        double t2 = (node.BoundsMax[axis] - origin[axis][lane]) * inverseDirection[axis][lane];
+        entryT[lane] = std::max(entryT[lane], std::min(t1, t2));
+        exitT[lane] = std::min(exitT[lane], std::max(t1, t2));
+      }
+    }
+    int anyLaneHit = 0;
+    for (int lane = 0; lane < PACKET_SIZE; ++lane)
+    {
+      anyLaneHit |= (entryT[lane] <= exitT[lane]);
+    }
+    if (!anyLaneHit)
+    {
+      continue;
+    }
+
+    if (node.NumberOfTriangles > 0)
+    {
+      IntersectLeaf(node, origin, direction, numberOfRays, hits);
+    }
+    else
+    {
+      nodeStack[nodeStackSize++] = node.FirstChildOrTriangle + 1;
+      nodeStack[nodeStackSize++] = node.FirstChildOrTriangle;
+    }
+  }
+
+  for (int rayIndex = 0; rayIndex < numberOfRays; ++rayIndex)
+  {
+    if (hits.Hits[rayIndex].size() > 1)
+    {
+      std::sort(hits.Hits[rayIndex].begin(), hits.Hits[rayIndex].end(), RayHitLessThan);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void PlusTriangleBvh::IntersectLeaf(const Node& node, const double origin[3][PACKET_SIZE], const double direction[3][PACKET_SIZE], int numberOfRays, PacketHits& hits) const
+{
+  for (int triangleIndex = node.FirstChildOrTriangle; triangleIndex < node.FirstChildOrTriangle + node.NumberOfTriangles; ++triangleIndex)
+  {
+    const double v0[3] = { this->Vertex0[0][triangleIndex], this->Vertex0[1][triangleIndex], this->Vertex0[2][triangleIndex] };
+    const double e1[3] = { this->Edge1[0][triangleIndex], this->Edge1[1][triangleIndex], this->Edge1[2][triangleIndex] };
+    const double e2[3] = { this->Edge2[0][triangleIndex], this->Edge2[1][triangleIndex], this->Edge2[2][triangleIndex] };
+
+    // Moller-Trumbore test of all segments against the triangle. Both sides of the triangle are intersected.
+    // If the segment is parallel to the triangle then the determinant is 0 and the division results in inf or NaN,
+    // which fails the range checks.
+    double hitT[PACKET_SIZE];
+    double hitU[PACKET_SIZE];
+    double hitV[PACKET_SIZE];
+    int isHit[PACKET_SIZE];
+    int anyLaneHit = 0;
+    for (int lane = 0; lane < PACKET_SIZE; ++lane)
+    {
+      const double dx = direction[0][lane];
+      const double dy = direction[1][lane];
+      const double dz = direction[2][lane];
+      const double px = dy * e2[2] - dz * e2[1];
+      const double py = dz * e2[0] - dx * e2[2];
+      const double pz = dx * e2[1] - dy * e2[0];
+      const double inverseDeterminant = 1.0 / (e1[0] * px + e1[1] * py + e1[2] * pz);
+      const double tx = origin[0][lane] - v0[0];
+      const double ty = origin[1][lane] - v0[1];
+      const double tz = origin[2][lane] - v0[2];
+      const double u = (tx * px + ty * py + tz * pz) * inverseDeterminant;
+      const double qx = ty * e1[2] - tz * e1[1];
+      const double qy = tz * e1[0] - tx * e1[2];
+      const double qz = tx * e1[1] - ty * e1[0];
+      const double v = (dx * qx + dy * qy + dz * qz) * inverseDeterminant;
+      const double t = (e2[0] * qx + e2[1] * qy + e2[2] * qz) * inverseDeterminant;
+      hitT[lane] = t;
+      hitU[lane] = u;
+      hitV[lane] = v;
+      isHit[lane] = (u >= 0.0) & (v >= 0.0) & (u + v <= 1.0) & (t >= 0.0) & (t <= 1.0);
+      anyLaneHit |= isHit[lane];
+    }
+    if (!anyLaneHit)
+    {
+      continue;
+    }
+    for (int rayIndex = 0; rayIndex < numberOfRays; ++rayIndex)
+    {
+      if (isHit[rayIndex])
+      {
+        RayHit hit;
+        hit.T = hitT[rayIndex];
+        hit.U = hitU[rayIndex];
+        hit.V = hitV[rayIndex];
+        hit.TriangleIndex = triangleIndex;
+        hits.Hits[rayIndex].push_back(hit);
+      }
+    }
+  }
+}
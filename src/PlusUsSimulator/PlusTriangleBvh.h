@@ -0,0 +1,143 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusTriangleBvh_h
+#define __PlusTriangleBvh_h
+
+#include "PlusConfigure.h"
+#include "vtkPlusUsSimulatorExport.h"
+
+#include <vector>
+
+class vtkPolyData;
+
+/*!
+  \class PlusTriangleBvh
+  \brief Bounding volume hierarchy of a triangle mesh for computing all intersections of line segments and the mesh
+
+  The hierarchy is built with the surface area heuristic and stored in a flat array (children of a node are stored
+  next to each other, the triangles of each leaf are stored contiguously), so the traversal does not need any pointer chasing.
+
+  Line segments are intersected with the mesh in packets of PACKET_SIZE segments. Neighbor scanlines of an ultrasound
+  image are almost parallel, so they visit almost the same nodes: a node is visited if any segment of the packet intersects
+  its bounding box and then all segments of the packet are tested against the node's triangles together.
+  Segment data is stored as structure of arrays, so that the box and triangle tests of the segments of a packet
+  can be computed with SIMD instructions.
+
+  Results are written into preallocated per-segment arrays that keep their capacity between calls, so intersecting
+  a packet does not allocate memory in the steady state. The hierarchy is not modified by the intersection computation,
+  so it can be used from multiple threads concurrently.
+
+  \ingroup PlusLibUsSimulatorAlgo
+*/
+class vtkPlusUsSimulatorExport PlusTriangleBvh
+{
+public:
+  /*! Maximum number of line segments that are intersected with the mesh together */
+  static const int PACKET_SIZE = 8;
+
+  /*!
+    Line segments of a packet. Points of segment i are Origin[.][i] + t * Direction[.][i] (0 <= t <= 1).
+    Coordinates are stored as structure of arrays: Origin[0] contains the x coordinates of all the segments, etc.
+  */
+  struct RayPacket
+  {
+    RayPacket();
+    int NumberOfRays;
+    double Origin[3][PACKET_SIZE];
+    double Direction[3][PACKET_SIZE];
+  };
+
+  /*! Intersection of a line segment with a triangle */
+  struct RayHit
+  {
+    /*! Position along the segment (0 = segment start, 1 = segment end) */
+    double T;
+    /*! Barycentric coordinates of the intersection point: (1-U-V) * point0 + U * point1 + V * point2 */
+    double U;
+    double V;
+    /*! Index of the triangle in the hierarchy, see GetTrianglePointIds */
+    int TriangleIndex;
+  };
+
+  /*! Intersections of each segment of a packet, sorted by increasing T */
+  struct PacketHits
+  {
+    std::vector<RayHit> Hits[PACKET_SIZE];
+  };
+
+  PlusTriangleBvh();
+
+  /*!
+    Build the hierarchy from the triangles of the polydata. Vertices, lines and empty cells are ignored.
+    \return PLUS_FAIL if the polydata contains other cells than triangles (e.g., polygons or triangle strips)
+  */
+  PlusStatus Build(vtkPolyData* polyData);
+
+  /*!
+    Build the hierarchy from a list of triangles
+    \param numberOfTriangles Number of triangles
+    \param vertices Coordinates of the triangle corners, 9 values (x0 y0 z0 x1 y1 z1 x2 y2 z2) per triangle
+    \param cellIds Cell ID of each triangle in the original mesh
+    \param pointIds Point IDs of the triangle corners in the original mesh, 3 values per triangle
+  */
+  void Build(int numberOfTriangles, const double* vertices, const vtkIdType* cellIds, const vtkIdType* pointIds);
+
+  /*! Remove all triangles */
+  void Clear();
+
+  bool IsEmpty() const { return this->Nodes.empty(); }
+  int GetNumberOfTriangles() const { return static_cast<int>(this->CellIds.size()); }
+
+  /*! Cell ID of the triangle in the original mesh */
+  vtkIdType GetTriangleCellId(int triangleIndex) const { return this->CellIds[triangleIndex]; }
+
+  /*! Point IDs of the triangle corners in the original mesh (3 values) */
+  const vtkIdType* GetTrianglePointIds(int triangleIndex) const { return &this->PointIds[3 * triangleIndex]; }
+
+  /*!
+    Compute all intersections of the segments of the packet with the triangles. Intersections of segment i are stored
+    in hits.Hits[i] (for i < rays.NumberOfRays), previous content is removed.
+  */
+  void IntersectPacket(const RayPacket& rays, PacketHits& hits) const;
+
+protected:
+  /*!
+    Node of the hierarchy. If NumberOfTriangles is 0 then the node is an inner node and its children are
+    Nodes[FirstChildOrTriangle] and Nodes[FirstChildOrTriangle + 1]. Otherwise the node is a leaf that contains
+    triangles FirstChildOrTriangle ... FirstChildOrTriangle + NumberOfTriangles - 1.
+  */
+  struct Node
+  {
+    double BoundsMin[3];
+    double BoundsMax[3];
+    int FirstChildOrTriangle;
+    int NumberOfTriangles;
+  };
+
+  /*! Temporary data used while the hierarchy is built */
+  struct BuildTriangle
+  {
+    double BoundsMin[3];
+    double BoundsMax[3];
+    double Centroid[3];
+    int InputIndex;
+  };
+
+  void BuildNode(int nodeIndex, std::vector<BuildTriangle>& triangles, int firstTriangle, int numberOfTriangles, int depth);
+  void IntersectLeaf(const Node& node, const double origin[3][PACKET_SIZE], const double direction[3][PACKET_SIZE], int numberOfRays, PacketHits& hits) const;
+
+  std::vector<Node> Nodes;
+
+  /*! Triangle data in leaf order. First corner and the two edges from the first corner, as structure of arrays. */
+  std::vector<double> Vertex0[3];
+  std::vector<double> Edge1[3];
+  std::vector<double> Edge2[3];
+  std::vector<vtkIdType> CellIds;
+  std::vector<vtkIdType> PointIds;
+};
+
+#endif
@@ -0,0 +1,213 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PlusTriangleBvhTest.cxx
+  \brief Intersects line segments with a triangle mesh using PlusTriangleBvh and vtkModifiedBSPTree and verifies
+  that both find the same triangles at the same positions. Segments that cross the mesh, start inside it or miss it
+  are tested, in full and partial packets.
+*/
+
+#include "PlusConfigure.h"
+#include "PlusTriangleBvh.h"
+
+#include "vtkIdList.h"
+#include "vtkMath.h"
+#include "vtkModifiedBSPTree.h"
+#include "vtkPoints.h"
+#include "vtkPolyData.h"
+#include "vtkSphereSource.h"
+#include "vtksys/CommandLineArguments.hxx"
+
+#include <algorithm>
+
+namespace
+{
+  const double SPHERE_RADIUS_MM = 20.0;
+  const double POSITION_TOLERANCE_MM = 1e-3;
+
+  struct Hit
+  {
+    vtkIdType CellId;
+    double Point[3];
+    bool operator<(const Hit& other) const
+    {
+      return this->CellId < other.CellId;
+    }
+  };
+
+  //----------------------------------------------------------------------------
+  // Pseudo-random number in [-1, 1], the same on all platforms
+  double GetRandom(unsigned int& seed)
+  {
+    seed = seed * 1103515245 + 12345;
+    return static_cast<double>((seed >> 8) & 0xFFFF) / 32767.5 - 1.0;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int numberOfSegments = 1003;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--number-of-segments", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfSegments, "Number of tested line segments (default: 1003).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "\n\nPlusTriangleBvhTest help:" << args.GetHelp() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (printHelp)
+  {
+    std::cout << "\n\nPlusTriangleBvhTest help:" << args.GetHelp() << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  vtkSmartPointer<vtkSphereSource> sphereSource = vtkSmartPointer<vtkSphereSource>::New();
+  sphereSource->SetCenter(5, -3, 40);
+  sphereSource->SetRadius(SPHERE_RADIUS_MM);
+  sphereSource->SetThetaResolution(37);
+  sphereSource->SetPhiResolution(23);
+  sphereSource->Update();
+  vtkPolyData* polyData = sphereSource->GetOutput();
+  double center[3] = {0};
+  sphereSource->GetCenter(center);
+
+  PlusTriangleBvh bvh;
+  if (bvh.Build(polyData) != PLUS_SUCCESS || bvh.GetNumberOfTriangles() != polyData->GetNumberOfCells())
+  {
+    LOG_ERROR("Failed to build the hierarchy of " << polyData->GetNumberOfCells() << " triangles");
+    return EXIT_FAILURE;
+  }
+
+  vtkSmartPointer<vtkModifiedBSPTree> locator = vtkSmartPointer<vtkModifiedBSPTree>::New();
+  locator->SetDataSet(polyData);
+  locator->BuildLocator();
+
+  // Segments start and end at random points of a box that is larger than the sphere,
+  // so most of them cross the sphere surface twice, some of them once (start inside), some of them never
+  unsigned int seed = 1;
+  std::vector<double> segmentPoints(6 * numberOfSegments);
+  for (int segmentIndex = 0; segmentIndex < numberOfSegments; segmentIndex++)
+  {
+    double boxHalfSize = (segmentIndex % 5 == 0) ? 0.5 * SPHERE_RADIUS_MM : 1.5 * SPHERE_RADIUS_MM;
+    for (int i = 0; i < 3; i++)
+    {
+      segmentPoints[6 * segmentIndex + i] = center[i] + boxHalfSize * GetRandom(seed);
+      segmentPoints[6 * segmentIndex + 3 + i] = center[i] + 1.5 * SPHERE_RADIUS_MM * GetRandom(seed);
+    }
+  }
+
+  int numberOfErrors = 0;
+  int numberOfHits = 0;
+  PlusTriangleBvh::PacketHits packetHits;
+  vtkSmartPointer<vtkPoints> intersectionPoints = vtkSmartPointer<vtkPoints>::New();
+  vtkSmartPointer<vtkIdList> intersectionCellIds = vtkSmartPointer<vtkIdList>::New();
+  for (int firstSegmentIndex = 0; firstSegmentIndex < numberOfSegments; firstSegmentIndex += PlusTriangleBvh::PACKET_SIZE)
+  {
+    PlusTriangleBvh::RayPacket rays;
+    rays.NumberOfRays = std::min(static_cast<int>(PlusTriangleBvh::PACKET_SIZE), numberOfSegments - firstSegmentIndex);
+    for (int rayIndex = 0; rayIndex < rays.NumberOfRays; rayIndex++)
+    {
+      const double* segment = &segmentPoints[6 * (firstSegmentIndex + rayIndex)];
+      for (int i = 0; i < 3; i++)
+      {
+        rays.Origin[i][rayIndex] = segment[i];
+        rays.Direction[i][rayIndex] = segment[3 + i] - segment[i];
+      }
+    }
+    bvh.IntersectPacket(rays, packetHits);
+
+    for (int rayIndex = 0; rayIndex < rays.NumberOfRays; rayIndex++)
+    {
+      int segmentIndex = firstSegmentIndex + rayIndex;
+      double* segment = &segmentPoints[6 * segmentIndex];
+
+      std::vector<Hit> bvhHits;
+      double previousT = -1.0;
+      for (std::vector<PlusTriangleBvh::RayHit>::const_iterator it = packetHits.Hits[rayIndex].begin(); it != packetHits.Hits[rayIndex].end(); ++it)
+      {
+        if (it->T < previousT)
+        {
+          LOG_ERROR("Intersections of segment " << segmentIndex << " are not sorted");
+          numberOfErrors++;
+        }
+        previousT = it->T;
+        Hit hit;
+        hit.CellId = bvh.GetTriangleCellId(it->TriangleIndex);
+        for (int i = 0; i < 3; i++)
+        {
+          hit.Point[i] = rays.Origin[i][rayIndex] + it->T * rays.Direction[i][rayIndex];
+        }
+        bvhHits.push_back(hit);
+      }
+
+      intersectionPoints->Reset();
+      intersectionCellIds->Reset();
+      locator->IntersectWithLine(segment, segment + 3, 0.0, intersectionPoints, intersectionCellIds);
+      std::vector<Hit> locatorHits;
+      for (vtkIdType intersectionIndex = 0; intersectionIndex < intersectionPoints->GetNumberOfPoints(); intersectionIndex++)
+      {
+        Hit hit;
+        hit.CellId = intersectionCellIds->GetId(intersectionIndex);
+        intersectionPoints->GetPoint(intersectionIndex, hit.Point);
+        locatorHits.push_back(hit);
+      }
+
+      if (bvhHits.size() != locatorHits.size())
+      {
+        LOG_ERROR("Segment " << segmentIndex << ": number of intersections mismatch (hierarchy: " << bvhHits.size() << ", locator: " << locatorHits.size() << ")");
+        numberOfErrors++;
+        continue;
+      }
+      std::sort(bvhHits.begin(), bvhHits.end());
+      std::sort(locatorHits.begin(), locatorHits.end());
+      for (size_t hitIndex = 0; hitIndex < bvhHits.size(); hitIndex++)
+      {
+        if (bvhHits[hitIndex].CellId != locatorHits[hitIndex].CellId)
+        {
+          LOG_ERROR("Segment " << segmentIndex << ": intersected cell mismatch (hierarchy: " << bvhHits[hitIndex].CellId << ", locator: " << locatorHits[hitIndex].CellId << ")");
+          numberOfErrors++;
+          continue;
+        }
+        double distance = sqrt(vtkMath::Distance2BetweenPoints(bvhHits[hitIndex].Point, locatorHits[hitIndex].Point));
+        if (distance > POSITION_TOLERANCE_MM)
+        {
+          LOG_ERROR("Segment " << segmentIndex << ": intersection point mismatch in cell " << bvhHits[hitIndex].CellId << " (distance: " << distance << " mm)");
+          numberOfErrors++;
+        }
+      }
+      numberOfHits += static_cast<int>(bvhHits.size());
+    }
+  }
+
+  if (numberOfHits == 0)
+  {
+    LOG_ERROR("No intersections were found");
+    numberOfErrors++;
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Found the same " << numberOfHits << " intersections for " << numberOfSegments << " segments. Test completed successfully.");
+  return EXIT_SUCCESS;
+}
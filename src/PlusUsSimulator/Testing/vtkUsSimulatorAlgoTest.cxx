@@ -174,6 +174,7 @@ int main(int argc, char** argv)
   std::string intersectionFile;
   bool showResults = false;
   bool useCompression(true);
+  int numberOfThreads = 0;
 
   int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
 
@@ -188,6 +189,7 @@ int main(int argc, char** argv)
   args.AddArgument("--output-us-img-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &outputUsImageFile, "File name of the generated output ultrasound image");
   args.AddArgument("--output-slice-model-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &intersectionFile, "Name of STL output file containing the model of all the frames (optional)");
   args.AddArgument("--show-results", vtksys::CommandLineArguments::NO_ARGUMENT, &showResults, "Show the simulated image on the screen");
+  args.AddArgument("--number-of-threads", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfThreads, "Number of threads used for simulating the scanlines (optional, overrides the value in the configuration file)");
 
   // Input arguments error checking
   if (!args.Parse())
@@ -259,6 +261,10 @@ int main(int argc, char** argv)
     LOG_ERROR("Failed to read US simulator configuration!");
     exit(EXIT_FAILURE);
   }
+  if (numberOfThreads > 0)
+  {
+    usSimulator->SetNumberOfThreads(numberOfThreads);
+  }
   usSimulator->SetTransformRepository(transformRepository);
   igsioTransformName imageToReferenceTransformName(usSimulator->GetImageCoordinateFrame(), usSimulator->GetReferenceCoordinateFrame());
 
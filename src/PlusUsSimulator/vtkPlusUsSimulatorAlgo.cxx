@@ -7,6 +7,7 @@ See License.txt for details.
 #include "PlusConfigure.h"
 
 #include <algorithm>
+#include <atomic>
 #include <list>
 #include <map>
 
@@ -32,7 +33,6 @@ See License.txt for details.
 #include "vtkPlusUsScanConvert.h"
 
 // For noise generation
-#include "vtkLineSource.h"
 #include "vtkPerlinNoise.h"
 #include "vtkProbeFilter.h"
 #include "vtkSampleFunction.h"
@@ -69,6 +69,9 @@ vtkPlusUsSimulatorAlgo::vtkPlusUsSimulatorAlgo()
   this->NoisePhase[1] = 0;
   this->NoisePhase[2] = 0;
 
+  this->NumberOfThreads = 0;
+  this->Threader = vtkSmartPointer<vtkMultiThreader>::New();
+
   // this->TransducerSpatialModel doesn't have to be initialized, as the default parameters of SpatialModel
   // are for soft tissue that should match the transducer material in acoustic impedance
 }
@@ -90,6 +93,7 @@ vtkPlusUsSimulatorAlgo::~vtkPlusUsSimulatorAlgo()
 void vtkPlusUsSimulatorAlgo::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << std::endl;
 }
 
 //-----------------------------------------------------------------------------
@@ -112,6 +116,163 @@ inline double fastPow(double a, double b)
   return u.d;
 }
 
+//-----------------------------------------------------------------------------
+struct vtkPlusUsSimulatorAlgo::ScanLineSimulationJob
+{
+  vtkPlusUsSimulatorAlgo* Self;
+  /*! Start and end point (homogeneous coordinates) of each scanline in the Reference coordinate system: 8 values per scanline */
+  double* ScanLineEndPoints_Reference;
+  double DistanceBetweenScanlineSamplePointsMm;
+  vtkPerlinNoise* NoiseFunction;
+  unsigned char* ScanLinesPixels;
+  vtkIdType ScanLineIncrement;
+  std::atomic<int> NextScanLineIndex;
+  std::atomic<int> NextScratchIndex;
+  std::atomic<bool> ScanLineFailed;
+};
+
+//-----------------------------------------------------------------------------
+void* vtkPlusUsSimulatorAlgo::SimulateScanLinesThread(vtkMultiThreader::ThreadInfo* data)
+{
+  ScanLineSimulationJob* job = static_cast<ScanLineSimulationJob*>(data->UserData);
+  vtkPlusUsSimulatorAlgo* self = job->Self;
+  ScanLineScratch& scratch = self->ThreadScratch[job->NextScratchIndex++];
+
+  // Packets of neighbor scanlines are distributed dynamically, as the computation time depends on the number of intersected models
+  const int packetSize = PlusTriangleBvh::PACKET_SIZE;
+  for (int firstScanLineIndex = job->NextScanLineIndex.fetch_add(packetSize); firstScanLineIndex < self->NumberOfScanlines; firstScanLineIndex = job->NextScanLineIndex.fetch_add(packetSize))
+  {
+    const int numberOfScanLinesInPacket = std::min(packetSize, self->NumberOfScanlines - firstScanLineIndex);
+    double* scanLineStartPoints_Reference[PlusTriangleBvh::PACKET_SIZE];
+    double* scanLineEndPoints_Reference[PlusTriangleBvh::PACKET_SIZE];
+    for (int lineIndexInPacket = 0; lineIndexInPacket < numberOfScanLinesInPacket; lineIndexInPacket++)
+    {
+      scanLineStartPoints_Reference[lineIndexInPacket] = job->ScanLineEndPoints_Reference + 8 * (firstScanLineIndex + lineIndexInPacket);
+      scanLineEndPoints_Reference[lineIndexInPacket] = scanLineStartPoints_Reference[lineIndexInPacket] + 4;
+      scratch.LineIntersectionsWithModels[lineIndexInPacket].clear();
+    }
+
+    // Get model intersection positions along the scanlines for all the models
+    for (std::vector<PlusSpatialModel>::iterator spatialModelIt = self->SpatialModels.begin(); spatialModelIt != self->SpatialModels.end(); ++spatialModelIt)
+    {
+      // Append line intersections found with this model to the intersection list of each scanline
+      spatialModelIt->GetLinePacketIntersections(numberOfScanLinesInPacket, scanLineStartPoints_Reference, scanLineEndPoints_Reference,
+          scratch.LineIntersectionsWithModels, scratch.LineIntersectionScratch);
+    }
+
+    for (int lineIndexInPacket = 0; lineIndexInPacket < numberOfScanLinesInPacket; lineIndexInPacket++)
+    {
+      unsigned char* dstPixelAddress = job->ScanLinesPixels + (firstScanLineIndex + lineIndexInPacket) * job->ScanLineIncrement;
+      if (self->SimulateScanLine(scanLineStartPoints_Reference[lineIndexInPacket], scanLineEndPoints_Reference[lineIndexInPacket], job->DistanceBetweenScanlineSamplePointsMm,
+                                 job->NoiseFunction, dstPixelAddress, scratch.LineIntersectionsWithModels[lineIndexInPacket], scratch.Intensities) != PLUS_SUCCESS)
+      {
+        job->ScanLineFailed = true;
+      }
+    }
+  }
+
+  return NULL;
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusUsSimulatorAlgo::SimulateScanLine(double* scanLineStartPoint_Reference, double* scanLineEndPoint_Reference, double distanceBetweenScanlineSamplePointsMm,
+    vtkPerlinNoise* noiseFunction, unsigned char* dstPixelAddress,
+    std::deque<PlusSpatialModel::LineIntersectionInfo>& lineIntersectionsWithModels, std::vector<double>& intensities)
+{
+  ConvertLineModelIntersectionsToSegmentDescriptor(lineIntersectionsWithModels);
+
+  int numIntersectionPoints = lineIntersectionsWithModels.size();
+  if (numIntersectionPoints < 1)
+  {
+    return PLUS_FAIL;
+  }
+
+  // Noise is sampled at the same positions as the points of a vtkLineSource with NumberOfSamplesPerScanline points
+  // along the scanline would be (stored with single precision)
+  double scanLineDirection_Reference[3] =
+  {
+    scanLineEndPoint_Reference[0] - scanLineStartPoint_Reference[0],
+    scanLineEndPoint_Reference[1] - scanLineStartPoint_Reference[1],
+    scanLineEndPoint_Reference[2] - scanLineStartPoint_Reference[2]
+  };
+  const int noiseSamplerResolution = std::max(1, this->NumberOfSamplesPerScanline - 1);
+  double samplePointPosition_Reference[3] = {0, 0, 0};
+
+  int currentPixelIndex = 0;
+  double incomingBeamIntensity = this->IncomingIntensityMwPerCm2 * 1000;
+  PlusSpatialModel* previousModel = &this->TransducerSpatialModel;
+  for (vtkIdType intersectionIndex = 0; (intersectionIndex <= numIntersectionPoints) && (currentPixelIndex < this->NumberOfSamplesPerScanline); intersectionIndex++)
+  {
+    // determine end of segment position and pixel color
+    int endOfSegmentPixelIndex = currentPixelIndex;
+    double distanceOfIntersectionPointFromScanLineStartPointMm = 0; // defined here to allow for access later on in code
+    if (intersectionIndex + 1 < numIntersectionPoints)
+    {
+      distanceOfIntersectionPointFromScanLineStartPointMm = lineIntersectionsWithModels[intersectionIndex + 1].IntersectionDistanceFromStartPointMm;
+      endOfSegmentPixelIndex = distanceOfIntersectionPointFromScanLineStartPointMm / distanceBetweenScanlineSamplePointsMm;
+      if (endOfSegmentPixelIndex > this->NumberOfSamplesPerScanline)
+      {
+        // the next intersection point is out of the image
+        endOfSegmentPixelIndex = this->NumberOfSamplesPerScanline;
+      }
+    }
+    else
+    {
+      // last segment, after all the intersection points
+      endOfSegmentPixelIndex = this->NumberOfSamplesPerScanline;
+    }
+
+    int numberOfFilledPixels = endOfSegmentPixelIndex - currentPixelIndex;
+    if (numberOfFilledPixels < 1)
+    {
+      continue;
+    }
+
+    PlusSpatialModel* currentModel = NULL;
+    if (intersectionIndex < numIntersectionPoints)
+    {
+      currentModel = lineIntersectionsWithModels[intersectionIndex].Model;
+    }
+    else
+    {
+      // the segment after the last intersection point is assumed to belong to the model of the last intersection
+      currentModel = lineIntersectionsWithModels[numIntersectionPoints - 1].Model;
+    }
+
+    double outgoingBeamIntensity = 0;
+    currentModel->CalculateIntensity(intensities, numberOfFilledPixels, distanceBetweenScanlineSamplePointsMm, previousModel->GetAcousticImpedanceMegarayls(), incomingBeamIntensity, outgoingBeamIntensity, lineIntersectionsWithModels[intersectionIndex].IntersectionIncidenceAngleRad);
+    previousModel = currentModel;
+
+    if (this->NoiseAmplitude > 0)
+    {
+      for (int pixelIndex = 0; pixelIndex < numberOfFilledPixels; pixelIndex++)
+      {
+        double samplePointParameter = static_cast<double>(currentPixelIndex + pixelIndex) / noiseSamplerResolution;
+        for (int i = 0; i < 3; i++)
+        {
+          samplePointPosition_Reference[i] = static_cast<float>(scanLineStartPoint_Reference[i] + samplePointParameter * scanLineDirection_Reference[i]);
+        }
+        double noise = noiseFunction->EvaluateFunction(samplePointPosition_Reference);
+        // Noise is multiplicative: NoisySignal = signal + noise * (signal-SignalMean) = signal*(1+noise) - noise*SignalMean;
+        (*dstPixelAddress++) = std::max(std::min(this->BrightnessConversionOffset + this->BrightnessConversionScale * fastPow(intensities[pixelIndex], this->BrightnessConversionGamma) + noise, 255.0), 0.0);
+      }
+    }
+    else
+    {
+      for (int pixelIndex = 0; pixelIndex < numberOfFilledPixels; pixelIndex++)
+      {
+        (*dstPixelAddress++) = std::max(std::min(this->BrightnessConversionOffset + this->BrightnessConversionScale * fastPow(intensities[pixelIndex], this->BrightnessConversionGamma), 255.0), 0.0);
+      }
+    }
+
+    incomingBeamIntensity = outgoingBeamIntensity;
+
+    currentPixelIndex += numberOfFilledPixels;
+  }
+
+  return PLUS_SUCCESS;
+}
+
 //-----------------------------------------------------------------------------
 int vtkPlusUsSimulatorAlgo::RequestData(vtkInformation* request, vtkInformationVector** inputVector, vtkInformationVector* outputVector)
 {
@@ -134,9 +295,6 @@ int vtkPlusUsSimulatorAlgo::RequestData(vtkInformation* request, vtkInformationV
   scanLines->SetExtent(0, this->NumberOfSamplesPerScanline - 1, 0, this->NumberOfScanlines - 1, 0, 0);
   scanLines->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
 
-  // Create BSPTree for fast scanline-model intersection computation
-  vtkSmartPointer<vtkPoints> scanLineIntersectionWithModel = vtkSmartPointer<vtkPoints>::New();
-
   vtkPlusUsScanConvert* scanConverter = this->RfProcessor->GetScanConverter();
   if (scanConverter == NULL)
   {
@@ -153,12 +311,9 @@ int vtkPlusUsSimulatorAlgo::RequestData(vtkInformation* request, vtkInformationV
   double distanceBetweenScanlineSamplePointsMm = scanConverter->GetDistanceBetweenScanlineSamplePointsMm();
 
   // Initialize noise generator
-  vtkSmartPointer<vtkLineSource> noiseSamplerLine_Reference = vtkSmartPointer<vtkLineSource>::New();
   vtkSmartPointer<vtkPerlinNoise> noiseFunction = vtkSmartPointer<vtkPerlinNoise>::New();
-  double samplePointPosition_Reference[3] = {0, 0, 0};
   if (this->NoiseAmplitude > 0)
   {
-    noiseSamplerLine_Reference->SetResolution(this->NumberOfSamplesPerScanline - 1);
     noiseFunction->SetAmplitude(this->NoiseAmplitude);
     noiseFunction->SetFrequency(this->NoiseFrequency);
     noiseFunction->SetPhase(this->NoisePhase);
@@ -186,16 +341,6 @@ int vtkPlusUsSimulatorAlgo::RequestData(vtkInformation* request, vtkInformationV
   vtkSmartPointer<vtkMatrix4x4> referenceToImageMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
   vtkMatrix4x4::Invert(imageToReferenceMatrix, referenceToImageMatrix);
 
-  // Create a few variables outside the loop to avoid reallocations and to make the code easier to read
-  vtkPoints* samplePointPositions_Reference = 0;
-  // Create a buffer outside the for loop to allow reusing it
-  std::vector<double> intensities;
-  // scanline start/end positions in Image and Reference coordinate systems
-  double scanLineStartPoint_Image[4] = {0, 0, 0, 1};
-  double scanLineEndPoint_Image[4] = {0, 0, 0, 1};
-  double scanLineStartPoint_Reference[4] = {0, 0, 0, 1};
-  double scanLineEndPoint_Reference[4] = {0, 0, 0, 1};
-
   for (std::vector<PlusSpatialModel>::iterator spatialModelIt = this->SpatialModels.begin(); spatialModelIt != this->SpatialModels.end(); ++spatialModelIt)
   {
     vtkSmartPointer<vtkMatrix4x4> referenceToObjectMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
@@ -210,107 +355,52 @@ int vtkPlusUsSimulatorAlgo::RequestData(vtkInformation* request, vtkInformationV
       }
     }
     spatialModelIt->SetReferenceToObjectTransform(referenceToObjectMatrix);
-  }
-
-  for (int scanLineIndex = 0; scanLineIndex < this->NumberOfScanlines; scanLineIndex++)
-  {
-    scanConverter->GetScanLineEndPoints(scanLineIndex, scanLineStartPoint_Image, scanLineEndPoint_Image);
-    imageToReferenceMatrix->MultiplyPoint(scanLineStartPoint_Image, scanLineStartPoint_Reference);
-    imageToReferenceMatrix->MultiplyPoint(scanLineEndPoint_Image, scanLineEndPoint_Reference);
-
-    if (this->NoiseAmplitude > 0)
-    {
-      noiseSamplerLine_Reference->SetPoint1(scanLineStartPoint_Reference);
-      noiseSamplerLine_Reference->SetPoint2(scanLineEndPoint_Reference);
-      noiseSamplerLine_Reference->Update();
-      samplePointPositions_Reference = noiseSamplerLine_Reference->GetOutput()->GetPoints();
-    }
-
-    // Get model intersection positions along the scanline for all the models
-    std::deque<PlusSpatialModel::LineIntersectionInfo> lineIntersectionsWithModels;
-    for (std::vector<PlusSpatialModel>::iterator spatialModelIt = this->SpatialModels.begin(); spatialModelIt != this->SpatialModels.end(); ++spatialModelIt)
-    {
-      // Append line intersections found with this model to lineIntersectionsWithModels
-      spatialModelIt->GetLineIntersections(lineIntersectionsWithModels, scanLineStartPoint_Reference, scanLineEndPoint_Reference);
-    }
-
-    ConvertLineModelIntersectionsToSegmentDescriptor(lineIntersectionsWithModels);
 
-    int currentPixelIndex = 0;
-    int scanLineExtent[6] = {0, this->NumberOfSamplesPerScanline - 1, scanLineIndex, scanLineIndex, 0, 0};
-    unsigned char* dstPixelAddress = (unsigned char*)scanLines->GetScalarPointerForExtent(scanLineExtent);
-    double incomingBeamIntensity = this->IncomingIntensityMwPerCm2 * 1000;
-    int numIntersectionPoints = lineIntersectionsWithModels.size();
-    if (numIntersectionPoints < 1)
+    // Load models, build locators and lookup tables now, as the scanline simulation threads only read the models
+    if (spatialModelIt->PrepareForConcurrentAccess(distanceBetweenScanlineSamplePointsMm, this->NumberOfSamplesPerScanline) != PLUS_SUCCESS)
     {
-      LOG_ERROR("No intersections with any SpatialObjects. Probably no background object is specified.");
+      LOG_ERROR("Failed to prepare " << spatialModelIt->GetName() << " SpatialModel for simulation");
       return 0;
     }
-    PlusSpatialModel* previousModel = &this->TransducerSpatialModel;
-    for (vtkIdType intersectionIndex = 0; (intersectionIndex <= numIntersectionPoints) && (currentPixelIndex < this->NumberOfSamplesPerScanline); intersectionIndex++)
-    {
-      // determine end of segment position and pixel color
-      int endOfSegmentPixelIndex = currentPixelIndex;
-      double distanceOfIntersectionPointFromScanLineStartPointMm = 0; // defined here to allow for access later on in code
-      if (intersectionIndex + 1 < numIntersectionPoints)
-      {
-        distanceOfIntersectionPointFromScanLineStartPointMm = lineIntersectionsWithModels[intersectionIndex + 1].IntersectionDistanceFromStartPointMm;
-        endOfSegmentPixelIndex = distanceOfIntersectionPointFromScanLineStartPointMm / distanceBetweenScanlineSamplePointsMm;
-        if (endOfSegmentPixelIndex > this->NumberOfSamplesPerScanline)
-        {
-          // the next intersection point is out of the image
-          endOfSegmentPixelIndex = this->NumberOfSamplesPerScanline;
-        }
-      }
-      else
-      {
-        // last segment, after all the intersection points
-        endOfSegmentPixelIndex = this->NumberOfSamplesPerScanline;
-      }
-
-      int numberOfFilledPixels = endOfSegmentPixelIndex - currentPixelIndex;
-      if (numberOfFilledPixels < 1)
-      {
-        continue;
-      }
-
-      PlusSpatialModel* currentModel = NULL;
-      if (intersectionIndex < numIntersectionPoints)
-      {
-        currentModel = lineIntersectionsWithModels[intersectionIndex].Model;
-      }
-      else
-      {
-        // the segment after the last intersection point is assumed to belong to the model of the last intersection
-        currentModel = lineIntersectionsWithModels[numIntersectionPoints - 1].Model;
-      }
-
-      double outgoingBeamIntensity = 0;
-      currentModel->CalculateIntensity(intensities, numberOfFilledPixels, distanceBetweenScanlineSamplePointsMm, previousModel->GetAcousticImpedanceMegarayls(), incomingBeamIntensity, outgoingBeamIntensity, lineIntersectionsWithModels[intersectionIndex].IntersectionIncidenceAngleRad);
-      previousModel = currentModel;
+  }
 
-      if (this->NoiseAmplitude > 0)
-      {
-        for (int pixelIndex = 0; pixelIndex < numberOfFilledPixels; pixelIndex++)
-        {
-          samplePointPositions_Reference->GetPoint(currentPixelIndex + pixelIndex, samplePointPosition_Reference);
-          double noise = noiseFunction->EvaluateFunction(samplePointPosition_Reference);
-          // Noise is multiplicative: NoisySignal = signal + noise * (signal-SignalMean) = signal*(1+noise) - noise*SignalMean;
-          (*dstPixelAddress++) = std::max(std::min(this->BrightnessConversionOffset + this->BrightnessConversionScale * fastPow(intensities[pixelIndex], this->BrightnessConversionGamma) + noise, 255.0), 0.0);
-        }
-      }
-      else
-      {
-        for (int pixelIndex = 0; pixelIndex < numberOfFilledPixels; pixelIndex++)
-        {
-          (*dstPixelAddress++) = std::max(std::min(this->BrightnessConversionOffset + this->BrightnessConversionScale * fastPow(intensities[pixelIndex], this->BrightnessConversionGamma), 255.0), 0.0);
-        }
-      }
+  // Scanline start/end positions in the Reference coordinate system. The scan converter is not used in the threads.
+  std::vector<double> scanLineEndPoints_Reference(8 * this->NumberOfScanlines, 0.0);
+  double scanLineStartPoint_Image[4] = {0, 0, 0, 1};
+  double scanLineEndPoint_Image[4] = {0, 0, 0, 1};
+  for (int scanLineIndex = 0; scanLineIndex < this->NumberOfScanlines; scanLineIndex++)
+  {
+    scanConverter->GetScanLineEndPoints(scanLineIndex, scanLineStartPoint_Image, scanLineEndPoint_Image);
+    imageToReferenceMatrix->MultiplyPoint(scanLineStartPoint_Image, &scanLineEndPoints_Reference[8 * scanLineIndex]);
+    imageToReferenceMatrix->MultiplyPoint(scanLineEndPoint_Image, &scanLineEndPoints_Reference[8 * scanLineIndex + 4]);
+  }
 
-      incomingBeamIntensity = outgoingBeamIntensity;
+  int numberOfThreads = (this->NumberOfThreads > 0 ? this->NumberOfThreads : vtkMultiThreader::GetGlobalDefaultNumberOfThreads());
+  numberOfThreads = std::max(1, std::min(std::min(numberOfThreads, this->NumberOfScanlines), VTK_MAX_THREADS));
+  if (static_cast<int>(this->ThreadScratch.size()) < numberOfThreads)
+  {
+    this->ThreadScratch.resize(numberOfThreads);
+  }
 
-      currentPixelIndex += numberOfFilledPixels;
-    }
+  ScanLineSimulationJob job;
+  job.Self = this;
+  job.ScanLineEndPoints_Reference = scanLineEndPoints_Reference.empty() ? NULL : &scanLineEndPoints_Reference[0];
+  job.DistanceBetweenScanlineSamplePointsMm = distanceBetweenScanlineSamplePointsMm;
+  job.NoiseFunction = noiseFunction;
+  job.ScanLinesPixels = static_cast<unsigned char*>(scanLines->GetScalarPointer());
+  job.ScanLineIncrement = scanLines->GetIncrements()[1];
+  job.NextScanLineIndex = 0;
+  job.NextScratchIndex = 0;
+  job.ScanLineFailed = false;
+
+  this->Threader->SetNumberOfThreads(numberOfThreads);
+  this->Threader->SetSingleMethod((vtkThreadFunctionType)&SimulateScanLinesThread, &job);
+  this->Threader->SingleMethodExecute();
+
+  if (job.ScanLineFailed)
+  {
+    LOG_ERROR("No intersections with any SpatialObjects. Probably no background object is specified.");
+    return 0;
   }
 
   vtkImageData* simulatedUsImage = vtkImageData::SafeDownCast(outInfo->Get(vtkDataObject::DATA_OBJECT()));
@@ -405,6 +495,7 @@ PlusStatus vtkPlusUsSimulatorAlgo::ReadConfiguration(vtkXMLDataElement* config)
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, NoiseAmplitude, usSimulatorAlgoElement);
   XML_READ_VECTOR_ATTRIBUTE_OPTIONAL(double, 3, NoiseFrequency, usSimulatorAlgoElement);
   XML_READ_VECTOR_ATTRIBUTE_OPTIONAL(double, 3, NoisePhase, usSimulatorAlgoElement);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfThreads, usSimulatorAlgoElement);
   XML_READ_CSTRING_ATTRIBUTE_REQUIRED(ImageCoordinateFrame, usSimulatorAlgoElement);
   XML_READ_CSTRING_ATTRIBUTE_REQUIRED(ReferenceCoordinateFrame, usSimulatorAlgoElement);
 
@@ -10,10 +10,12 @@
 #include "vtkPlusUsSimulatorExport.h"
 
 #include "vtkImageAlgorithm.h"
+#include "vtkMultiThreader.h"
 
 #include "PlusSpatialModel.h"
 #include "vtkIGSIOTransformRepository.h"
 
+class vtkPerlinNoise;
 class vtkPolyDataNormals;
 class vtkTriangleFilter;
 class vtkStripper;
@@ -104,6 +106,14 @@ public:
   vtkSetVector3Macro(NoiseFrequency, double);
   vtkSetVector3Macro(NoisePhase, double);
 
+  /*!
+    Set the number of threads that simulate scanlines in parallel.
+    If the value is 0 (default) then the number of threads is determined automatically from the number of processor cores.
+  */
+  vtkSetMacro(NumberOfThreads, int);
+  /*! Get the number of threads that simulate scanlines in parallel (0 means automatic) */
+  vtkGetMacro(NumberOfThreads, int);
+
 protected:
   virtual int FillOutputPortInformation(int port, vtkInformation* info);
   virtual int RequestData(vtkInformation* request,
@@ -112,6 +122,34 @@ protected:
 
   void ConvertLineModelIntersectionsToSegmentDescriptor(std::deque<PlusSpatialModel::LineIntersectionInfo>& lineIntersectionsWithModels);
 
+  /*! Temporary data of a thread that simulates scanlines. Kept between frames to avoid reallocations. */
+  struct ScanLineScratch
+  {
+    /*! Intersections of each scanline of the currently simulated packet of neighbor scanlines */
+    std::deque<PlusSpatialModel::LineIntersectionInfo> LineIntersectionsWithModels[PlusTriangleBvh::PACKET_SIZE];
+    std::vector<double> Intensities;
+    PlusSpatialModel::LineIntersectionScratch LineIntersectionScratch;
+  };
+
+  /*! Data shared by all the threads that simulate the scanlines of a frame */
+  struct ScanLineSimulationJob;
+
+  /*!
+    Thread function that simulates scanlines until all scanlines of the job are completed.
+    Neighbor scanlines are processed in packets, so that their intersections with the models are computed together.
+  */
+  static void* SimulateScanLinesThread(vtkMultiThreader::ThreadInfo* data);
+
+  /*!
+    Compute pixel values of one scanline from its intersections with all the spatial models. Only reads the algorithm
+    and spatial model properties, therefore it can be called concurrently for different scanlines (with separate intersection
+    and intensity arrays).
+    \return PLUS_FAIL if the scanline does not intersect any spatial model
+  */
+  PlusStatus SimulateScanLine(double* scanLineStartPoint_Reference, double* scanLineEndPoint_Reference, double distanceBetweenScanlineSamplePointsMm,
+                              vtkPerlinNoise* noiseFunction, unsigned char* dstPixelAddress,
+                              std::deque<PlusSpatialModel::LineIntersectionInfo>& lineIntersectionsWithModels, std::vector<double>& intensities);
+
 protected:
   vtkPlusUsSimulatorAlgo();
   ~vtkPlusUsSimulatorAlgo();
@@ -163,6 +201,15 @@ private:
   double NoiseAmplitude;
   double NoiseFrequency[3];
   double NoisePhase[3];
+
+  /*! Number of threads that simulate scanlines in parallel. 0 means automatic (number of processor cores). */
+  int NumberOfThreads;
+
+  /*! Runs the threads that simulate the scanlines */
+  vtkSmartPointer<vtkMultiThreader> Threader;
+
+  /*! Temporary data of each scanline simulation thread */
+  std::vector<ScanLineScratch> ThreadScratch;
 };
 
 #endif // __vtkPlusUsSimulatorAlgo_h